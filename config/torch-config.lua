@@ -11,18 +11,94 @@ Parameters = {
 		spatial_order =              1,
 		temporal_order =             2,
 		simulation_time =            5.0e4 * YR2S,
+		dt_growth =                  2,
 		radiation_on =               true,
 		cooling_on =                 true,
 		debug =                      false,
+		fused_updates =              true,
+		overlap_cooling =            true,
+		autotune_steps =             0,
+		rad_subcycles =              0,
+		equilibrium_iterations =     0,
+		equilibrium_tolerance =      1.0e-4,
+		rate_table_size =            2048,
+		rate_table_check =           false,
+		check_level =                "step",
 		output_directory =           "tmp",
 		initial_conditions =         "",
+		restart_file =               "",
+		setup_cache =                "",
+		stage_directory =            "",
+		restart_every =              0,
+		restart_refine =             1,
+		max_steps =                  0,
+		wall_time =                  0,
+		restart_interval =           0,
+		restart_compression =        false,
+		trigger_ionised_mass =       0,
+		trigger_front_cells =        0,
+		trigger_max_density =        0,
+		trigger_min_interval =       0,
+		steady_every =               0,
+		steady_tolerance =           0,
+		steady_checks =              3,
+		telemetry_every =            100,
+		telemetry_address =          "",
+		trace_steps =                0,
+		hardware_counters =          false,
+		snapshot_format =            "text",
+		snapshot_variables =         "",
+		snapshot_precision =         "float64",
+		snapshot_keyframe_every =    1,
+		snapshot_delta_tolerance =   0,
+		async_output =               false,
+		io_clients =                 0,
+		radiation_processors =       false,
+		log_files =                  "single",
+		pack_output =                false,
+		compression_level =          6,
 		ncheckpoints =               100,
+		snapshot_every =             1,
+		work_counters =              false,
+		analysis_on =                false,
+		analysis_profile_bins =      0,
+		analysis_slice =             false,
+		analysis_library =           "",
+		render_every =               0,
+		render_variables =           "den,hii,temperature",
+		tracers_per_cell =           0,
+		tracer_every =               10,
+		regions =                    {},
+		preview_every =              0,
+		preview_factor =             4,
+		time_averages =              "",
+		time_average_variances =     false,
 	},
 	Grid = {
 		no_dimensions =              2,
 		no_cells_x =                 150,
 		no_cells_y =                 200,
 		no_cells_z =                 1,
+		no_procs_x =                 0,
+		no_procs_y =                 1,
+		no_procs_z =                 1,
+		halo_datatypes =             true,
+		halo_collective =            false,
+		halo_single_precision =      false,
+		halo_precision_check =       false,
+		ray_tile_size =              16,
+		one_sided_relay =            false,
+		mpi_progress_interval =      0,
+		huge_pages =                 false,
+		brick_size =                 0,
+		memory_check =               true,
+		star_slab_ratio =            1,
+		rebalance_every =            0,
+		rebalance_threshold =        1.1,
+		refinement_every =           0,
+		refinement_block_size =      16,
+		refinement_gradient =        0.1,
+		refinement_hii =             0.05,
 		geometry =                   "cylindrical",
 		side_length =                0.5 * PC2CM,
 		left_boundary_condition_x =  "reflecting",
@@ -39,6 +115,24 @@ Parameters = {
 		temperature_floor =          0.1,
 		riemann_solver =             "RotatedHLLC",
 		slope_limiter =              "albada",
+		tile_size =                  0,
+		skip_quiescent =             false,
+		cfl =                        0.5,
+		ssp_stages =                 0,
+		fallback_substeps =          2,
+		gravity_every =              0,
+		gravity_tolerance =          1.0e-6,
+		gravity_max_cycles =         20,
+		gravity_model =              "field",
+		gravity_mass =               0,
+		gravity_dispersion =         0,
+		gravity_centre_x =           0,
+		gravity_centre_y =           0,
+		gravity_centre_z =           0,
+		gravity_softening =          0,
+		gravity_acceleration_x =     0,
+		gravity_acceleration_y =     0,
+		gravity_acceleration_z =     0,
 	},
 	Radiation = {
 		K1 =                         0.2,
@@ -53,13 +147,31 @@ Parameters = {
 		temperature_hii =            10000,
 		mass_fraction_hydrogen =     1.0,
 		integration_scheme =         "implicit",
+		decoupled_iterations =       0,
+		decoupled_tolerance =        0,
+		neutral_tolerance =          0,
+		shadow_tau =                 0,
+		ionised_tolerance =          0,
+		ionised_skips =              0,
+		coarse_factor =              1,
+		coarse_radius =              0,
+		photon_groups =              0,
+		spectrum_temperature =       40000,
+		hii_solver =                 "fixed_point",
+		iteration_stats =            false,
 		collisions_on =              false,
 		coupling =                   "neq",
+		implicit_heating =           false,
 	},
 	Thermodynamics = {
 		heating_amplification =      1,
 		thermo_hii_switch =          1e-2,
 		thermo_subcycling =          true,
+		stiff_substeps =             0,
+		substep_stats =              false,
+		chemistry_steps =            0,
+		cooling_table_size =         0,
+		column_density_tolerance =   0,
 		min_temp_initial_state =     true,
 	},
 	Star = {
@@ -76,8 +188,24 @@ Parameters = {
 		photon_energy =              2.976e-11,
 		photon_rate =                4.9e+48,
 		wind_radius_in_cells =       10,
+		wind_subsamples =            0,
+		wind_boundary =              false,
 		mass_loss_rate =             9.79e+18,
 		wind_velocity =              311000000.0,
 		wind_temperature =           10000,
+		velocity_x =                 0,
+		velocity_y =                 0,
+		velocity_z =                 0,
+		extra_sources =              {},
+	},
+	Setup = {
+		name =                       "lua",
+		library =                    "",
+		number_density =             32000.0,
+		temperature =                300.0,
+		hii_fraction =               0.0,
+		core_radius =                0.01 * PC2CM,
+		power_index =                1.0,
+		offset =                     0.35 * PC2CM,
 	},
 }
@@ -34,3 +34,14 @@ function initialise(x, y, z, xs, ys, zs)
 
 	return den, pre, hii, v0, v1, v2, grav0, grav1, grav2
 end
+
+-- Optional batch form of initialise, which Torch calls instead when it is defined. xs, ys and zs hold the coordinates
+-- of a block of cells and star holds star.x, star.y and star.z. It returns an array per value returned by initialise.
+function initialise_block(xs, ys, zs, star)
+	local den, pre, hii, v0, v1, v2, grav0, grav1, grav2 = {}, {}, {}, {}, {}, {}, {}, {}, {}
+	for i = 1, #xs do
+		den[i], pre[i], hii[i], v0[i], v1[i], v2[i], grav0[i], grav1[i], grav2[i] =
+			initialise(xs[i], ys[i], zs[i], star.x, star.y, star.z)
+	end
+	return den, pre, hii, v0, v1, v2, grav0, grav1, grav2
+end
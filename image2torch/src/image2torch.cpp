@@ -5,9 +5,8 @@
  * Modified by Yoshimasa Niwa to make it much simpler
  * and support all defined color_type.
  *
- * To build, use the next instruction on OS X.
- * $ brew install libpng
- * $ clang -lz -lpng15 libpng_test.c
+ * To build, from the TORCH directory (the binary snapshots share the header code of TORCH):
+ * $ g++ -std=c++11 -O2 -fopenmp -Isrc image2torch/src/image2torch.cpp src/IO/Snapshot.cpp -lpng -lz -o bin/image2torch
  *
  * Copyright 2002-2010 Guillaume Cottenceau.
  *
@@ -18,11 +17,19 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include <png.h>
 
+#include "IO/Snapshot.hpp"
+
 int width, height;
 png_byte color_type;
 png_byte bit_depth;
@@ -30,6 +37,7 @@ png_bytep *row_pointers;
 
 void read_png_file(char *filename) {
 	FILE *fp = fopen(filename, "rb");
+	if(!fp) throw std::runtime_error("image2torch: unable to open " + std::string(filename) + ".");
 
 	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if(!png) abort();
@@ -141,51 +149,236 @@ void process_png_file() {
 	}
 }
 
-void convert(char* filename) {
-	std::ofstream file(filename, std::ios_base::out);
-	if (!file) {
-		file.close();
-		return;
+/**
+ * @brief How a colour channel of the image is turned into a fluid variable.
+ */
+struct ChannelMapping {
+	double min = 0.1; //!< Value of the channel at 0.
+	double max = 1.0; //!< Value of the channel at 255.
+	bool logarithmic = false; //!< Map the channel onto log(value) rather than value.
+
+	double operator()(png_byte c) const {
+		const double f = c/255.0;
+		return logarithmic ? min*std::pow(max/min, f) : min + (max - min)*f;
 	}
+};
+
+/**
+ * @brief Conversion settings, read from the command line.
+ */
+struct Options {
+	std::string format = ""; //!< text or binary, chosen from the extension of the output file if empty.
+	ChannelMapping density; //!< Density (g cm^-3) from the red channel.
+	ChannelMapping pressure; //!< Pressure (dyn cm^-2) from the green channel.
+	int ncells[2] = {0, 0}; //!< Cells along x and y, which pixels are averaged into (0 for one cell per pixel).
+	double sideLength = 0.5; //!< Length of the x axis (cm).
+	int geometry = (int)Geometry::CARTESIAN;
+	SnapshotPrecision precision = SnapshotPrecision::FLOAT64;
+};
+
+/**
+ * @brief The density and pressure of every cell, x fastest and the bottom row of the image first.
+ *
+ * The cells are cubic, 2D and either one per pixel or the mean of blocks of pixels.
+ */
+struct Cells {
+	int nx = 0, ny = 0;
+	double dx = 0;
+	std::vector<double> den, pre;
+};
+
+Cells mapCells(const Options& options) {
+	Cells cells;
+	cells.nx = options.ncells[0] > 0 ? options.ncells[0] : width;
+	cells.ny = options.ncells[1] > 0 ? options.ncells[1] : height;
+	if (width % cells.nx != 0 || height % cells.ny != 0 || width/cells.nx != height/cells.ny)
+		throw std::runtime_error("image2torch: the " + std::to_string(width) + "x" + std::to_string(height)
+				+ " image cannot be averaged into " + std::to_string(cells.nx) + "x" + std::to_string(cells.ny) + " square cells.");
+	const int block = width/cells.nx;
+	cells.dx = options.sideLength/cells.nx;
+	cells.den.assign((std::size_t)cells.nx*cells.ny, 0);
+	cells.pre.assign((std::size_t)cells.nx*cells.ny, 0);
+#pragma omp parallel for schedule(static)
+	for (int j = 0; j < cells.ny; ++j) {
+		for (int i = 0; i < cells.nx; ++i) {
+			double den = 0, pre = 0;
+			for (int by = 0; by < block; ++by) {
+				png_bytep row = row_pointers[height - 1 - (j*block + by)];
+				for (int bx = 0; bx < block; ++bx) {
+					png_bytep px = &(row[(i*block + bx) * 4]);
+					den += options.density(px[0]);
+					pre += options.pressure(px[1]);
+				}
+			}
+			cells.den[(std::size_t)j*cells.nx + i] = den/(block*block);
+			cells.pre[(std::size_t)j*cells.nx + i] = pre/(block*block);
+		}
+	}
+	return cells;
+}
+
+/**
+ * @brief Writes the cells as a text snapshot. The rows are formatted by all threads and written in order.
+ */
+void writeText(const std::string& filename, const Cells& cells) {
+	std::ofstream file(filename, std::ios_base::out | std::ios_base::binary);
+	if (!file)
+		throw std::runtime_error("image2torch: unable to open " + filename + ".");
 
-	// Writing data to file.
-	std::stringstream data;
-	file << std::setprecision(10) << std::scientific;
 	file << 0 << '\n';
-	file << width << '\n';
-	file << height << '\n';
+	file << cells.nx << '\n';
+	file << cells.ny << '\n';
 	file << 1 << '\n';
 
-	double den_min = 0.1;
-	double den_max = 200;
-	double pre_min = 0.1;
-	double pre_max = 0.5;
+	std::vector<std::string> rows(cells.ny);
+#pragma omp parallel for schedule(static)
+	for (int j = 0; j < cells.ny; ++j) {
+		std::string& text = rows[j];
+		char line[160];
+		for (int i = 0; i < cells.nx; ++i) {
+			const std::size_t icell = (std::size_t)j*cells.nx + i;
+			int n = snprintf(line, sizeof(line), "%.10e\t%.10e\t%.10e\t%.10e\t%d\t%d\t%d\n", (i + 0.5)*cells.dx, (j + 0.5)*cells.dx,
+					cells.den[icell], cells.pre[icell], 0, 0, 0);
+			text.append(line, n);
+		}
+	}
+	for (const std::string& text : rows)
+		file.write(text.data(), text.size());
+	if (!file)
+		throw std::runtime_error("image2torch: unable to write " + filename + ".");
+}
 
-	for (int y = height - 1 ; y >= 0; y--) {
-		png_bytep row = row_pointers[y];
-		for(int x = 0; x < width; x++) {
-			png_bytep px = &(row[x * 4]);
-			// Do something awesome for each pixel here...
-			//printf("%4d, %4d = RGBA(%3d, %3d, %3d, %3d)\n", x, y, px[0], px[1], px[2], px[3]);
-			file << 0.5*(x+0.5)/(double)(width) << '\t' << 0.5*(height-y-1.0+0.5)/(double)(height) << '\t';
-			file << den_min + (den_max-den_min)*(px[0]/255.0) << '\t';
-			//file << 0.1 + 0.9*(px[0]/255.0) << '\t';
-			file << pre_min + (pre_max-pre_min)*(px[1]/255.0) << '\t';
-			file << 0 << '\t';
-			double vx = px[0] < 2 ? 20 : 0;
-			file << 0 << '\t' << 0 << '\n';
+/**
+ * @brief Writes the cells as a binary snapshot (see SnapshotHeader) with the variables den, pre, hii, vel_x and vel_y.
+ */
+void writeBinary(const std::string& filename, const Cells& cells, const Options& options) {
+	SnapshotHeader header;
+	header.nd = 2;
+	header.ncells = std::array<int, 3>{{ cells.nx, cells.ny, 1 }};
+	header.geometry = options.geometry;
+	header.nrows = (long long)cells.nx*cells.ny;
+	header.dx = std::array<double, 3>{{ cells.dx, cells.dx, cells.dx }};
+	header.precision = options.precision;
+	header.names = {"den", "pre", "hii", "vel_x", "vel_y"};
+	header.units = {"g cm^-3", "dyn cm^-2", "", "cm s^-1", "cm s^-1"};
+	const int nvars = (int)header.names.size();
+	header.offsets.assign(nvars, 0);
+	header.scales.assign(nvars, 1);
+	header.errors.assign(nvars, 0);
+
+	const std::size_t ncells = cells.den.size();
+	std::vector<char> bytes(ncells*nvars*header.valueSize(), 0);
+	for (std::size_t icell = 0; icell < ncells; ++icell) {
+		const double values[2] = {cells.den[icell], cells.pre[icell]};
+		for (int ivar = 0; ivar < 2; ++ivar) {
+			char* dest = bytes.data() + (icell*nvars + ivar)*header.valueSize();
+			if (options.precision == SnapshotPrecision::FLOAT32) {
+				const float x = (float)values[ivar];
+				std::memcpy(dest, &x, sizeof(x));
+				header.errors[ivar] = std::max(header.errors[ivar], std::abs(values[ivar] - x));
+			}
+			else
+				std::memcpy(dest, &values[ivar], sizeof(double));
 		}
 	}
-	file.close();
+
+	std::ofstream file(filename, std::ios_base::out | std::ios_base::binary);
+	if (!file)
+		throw std::runtime_error("image2torch: unable to open " + filename + ".");
+	const std::vector<char> head = header.serialise();
+	file.write(head.data(), head.size());
+	file.write(bytes.data(), bytes.size());
+	if (!file)
+		throw std::runtime_error("image2torch: unable to write " + filename + ".");
 }
 
-int main(int argc, char *argv[]) {
-	if(argc != 3) abort();
+void showUsage() {
+	std::cerr << "image2torch <image.png> <output> [--format=text|binary] [--density=min,max[,log]] [--pressure=min,max[,log]]\n"
+			"            [--ncells=nx,ny] [--side_length=cm] [--geometry=cartesian|cylindrical] [--precision=float64|float32]\n"
+			"The red channel sets the density (g cm^-3) and the green channel the pressure (dyn cm^-2). Binary output is\n"
+			"chosen for .tsnp files, text output otherwise.\n";
+}
 
-	read_png_file(argv[1]);
-	//process_png_file();
-	convert(argv[2]);
-	//write_png_file(argv[2]);
+/**
+ * @brief Reads "min,max" or "min,max,log" into a ChannelMapping.
+ */
+ChannelMapping parseMapping(const std::string& arg) {
+	ChannelMapping mapping;
+	std::istringstream in(arg);
+	char comma = 0;
+	if (!(in >> mapping.min >> comma >> mapping.max) || comma != ',')
+		throw std::runtime_error("image2torch: could not read the mapping " + arg + ".");
+	std::string rest;
+	std::getline(in, rest);
+	mapping.logarithmic = (rest == ",log");
+	if (!rest.empty() && !mapping.logarithmic)
+		throw std::runtime_error("image2torch: could not read the mapping " + arg + ".");
+	if (mapping.logarithmic && (mapping.min <= 0 || mapping.max <= 0))
+		throw std::runtime_error("image2torch: logarithmic mappings need positive limits.");
+	return mapping;
+}
+
+Options parseOptions(int argc, char *argv[]) {
+	Options options;
+	options.density.min = 0.1;
+	options.density.max = 200;
+	options.pressure.min = 0.1;
+	options.pressure.max = 0.5;
+	for (int iarg = 3; iarg < argc; ++iarg) {
+		const std::string arg = argv[iarg];
+		const std::size_t eq = arg.find('=');
+		const std::string key = arg.substr(0, eq), value = (eq == std::string::npos) ? "" : arg.substr(eq + 1);
+		if (key == "--format" && (value == "text" || value == "binary"))
+			options.format = value;
+		else if (key == "--density")
+			options.density = parseMapping(value);
+		else if (key == "--pressure")
+			options.pressure = parseMapping(value);
+		else if (key == "--ncells") {
+			char comma = 0;
+			std::istringstream in(value);
+			if (!(in >> options.ncells[0] >> comma >> options.ncells[1]) || comma != ',' || options.ncells[0] <= 0 || options.ncells[1] <= 0)
+				throw std::runtime_error("image2torch: could not read --ncells=" + value + ".");
+		}
+		else if (key == "--side_length") {
+			options.sideLength = std::atof(value.c_str());
+			if (options.sideLength <= 0)
+				throw std::runtime_error("image2torch: --side_length must be positive.");
+		}
+		else if (key == "--geometry" && value == "cartesian")
+			options.geometry = (int)Geometry::CARTESIAN;
+		else if (key == "--geometry" && value == "cylindrical")
+			options.geometry = (int)Geometry::CYLINDRICAL;
+		else if (key == "--precision" && value == "float64")
+			options.precision = SnapshotPrecision::FLOAT64;
+		else if (key == "--precision" && value == "float32")
+			options.precision = SnapshotPrecision::FLOAT32;
+		else
+			throw std::runtime_error("image2torch: unknown option " + arg + ".");
+	}
+	return options;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 3) {
+		showUsage();
+		return 1;
+	}
+	try {
+		Options options = parseOptions(argc, argv);
+		const std::string output = argv[2];
+		const bool binary = options.format.empty() ? SnapshotHeader::isSnapshot(output) : options.format == "binary";
+		read_png_file(argv[1]);
+		const Cells cells = mapCells(options);
+		if (binary)
+			writeBinary(output, cells, options);
+		else
+			writeText(output, cells);
+	}
+	catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
 
 	return 0;
 }
@@ -0,0 +1,14 @@
+-- Sod (1978) shock tube in the code units of torch-perf.py's sod problem (density 1.0e-20 g cm^-3, pressure
+-- 1.0e-28 dyn cm^-2 and length 1.0e7 cm), with the diaphragm half way along x.
+
+X0 = 0.5e7
+
+function initialise(x, y, z, xs, ys, zs)
+	local den = 1.0e-20
+	local pre = 1.0e-28
+	if x > X0 then
+		den = 0.125e-20
+		pre = 0.1e-28
+	end
+	return den, pre, 0, 0, 0, 0, 0, 0, 0
+end
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Checks that TORCH gives bit for bit the same results on any number of processors.
+
+The default problem of config/torch-config.lua and config/torch-setup.lua, on a smaller grid split along x (or along
+the dimension --set chooses), runs to its first checkpoint on each processor count and writes a restart file there (see DataPrinter::printRestart). A restart file
+holds the exact state of every cell in the order of their grid coordinates, whatever the decomposition, so the files of
+every run must be byte for byte the same as the first run's. The exit status is 1 if any of them differs.
+
+Example:
+    torch-decomposition.py --torch=build/bin/torch --ranks=1,3,4 --set Hydrodynamics.tile_size=8
+    torch-decomposition.py --torch=build/bin/torch --set Grid.no_procs_x=1 --set Grid.no_procs_y=0
+"""
+
+import argparse
+import filecmp
+import importlib.util
+import os
+import shlex
+import subprocess
+import sys
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+TORCH_DIR = os.path.dirname(os.path.dirname(SCRIPT_DIR))
+YR2S = 3.15569e7
+
+spec = importlib.util.spec_from_file_location("torch_perf", os.path.join(SCRIPT_DIR, "torch-perf.py"))
+torch_perf = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(torch_perf)
+
+
+def parseValue(text):
+	"""Turns the value of a --set option into the bool, number or string it stands for."""
+	if text in ("true", "false"):
+		return text == "true"
+	for kind in (int, float):
+		try:
+			return kind(text)
+		except ValueError:
+			pass
+	return text
+
+
+def run(args, template, ranks):
+	"""Runs the problem on a number of processors and returns the path of the restart file of its first checkpoint."""
+	rundir = os.path.join(os.path.abspath(args.workdir), "np%d" % ranks)
+	os.makedirs(rundir, exist_ok=True)
+	outdir = os.path.join(rundir, "out")
+	overrides = {
+		"Integration.output_directory": outdir,
+		"Integration.simulation_time": 2*args.years*YR2S,
+		"Integration.ncheckpoints": 2,
+		"Integration.restart_every": 1,
+		"Grid.no_cells_x": args.cells[0],
+		"Grid.no_cells_y": args.cells[1],
+		"Star.cell_position_y": args.cells[1]//2,
+	}
+	for setting in args.set:
+		name, value = setting.split("=", 1)
+		overrides[name] = parseValue(value)
+	paramfile = os.path.join(rundir, "params.lua")
+	torch_perf.writeParameters(template, overrides, paramfile)
+
+	command = shlex.split(args.mpirun.format(np=ranks)) + [os.path.abspath(args.torch), "--paramfile=" + paramfile,
+			"--setupfile=" + os.path.join(TORCH_DIR, "config", "torch-setup.lua"), "-s"]
+	with open(os.path.join(rundir, "run.log"), "w") as log:
+		status = subprocess.call(command, stdout=log, stderr=subprocess.STDOUT, cwd=rundir)
+	if status != 0:
+		raise RuntimeError("torch-decomposition: %s failed (exit status %d), see %s" % (" ".join(command), status,
+				os.path.join(rundir, "run.log")))
+	restart = os.path.join(outdir, "restart_000001.trst")
+	if not os.path.isfile(restart):
+		raise RuntimeError("torch-decomposition: no restart file " + restart)
+	return restart
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+	parser.add_argument("--torch", default=os.path.join(TORCH_DIR, "build", "bin", "torch"), help="torch executable")
+	parser.add_argument("--template", default=os.path.join(TORCH_DIR, "config", "torch-config.lua"),
+			help="parameter file the problem overrides")
+	parser.add_argument("--ranks", default="1,3,4", help="comma separated MPI processor counts, the first the reference")
+	parser.add_argument("--cells", default="48,64", help="cells along x and y")
+	parser.add_argument("--years", type=float, default=50, help="simulated time to the checkpoint compared (yr)")
+	parser.add_argument("--set", action="append", default=[], metavar="Section.key=value",
+			help="further parameter to override, e.g. Hydrodynamics.tile_size=8")
+	parser.add_argument("--mpirun", default="mpirun -np {np}", help="MPI launcher, {np} is the processor count")
+	parser.add_argument("--workdir", default="decomposition", help="directory the runs are made in")
+	args = parser.parse_args()
+	args.cells = [int(n) for n in args.cells.split(",")]
+
+	with open(args.template) as f:
+		template = f.read()
+	ranks = [int(n) for n in args.ranks.split(",")]
+	reference = run(args, template, ranks[0])
+	failures = 0
+	print("%-10s %10s" % ("processors", "status"))
+	for n in ranks[1:]:
+		status = "ok" if filecmp.cmp(reference, run(args, template, n), shallow=False) else "FAIL"
+		failures += status != "ok"
+		print("%-10d %10s" % (n, status))
+	return 1 if failures > 0 else 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
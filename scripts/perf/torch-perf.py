@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+"""Runs the canonical TORCH performance problems for a fixed number of steps at several processor and thread counts.
+
+Each run writes log/perf.json (see Torch::writePerformance). The cell updates per second, parallel efficiency and
+memory high-water mark of every run are printed and written to a results file, and compared against a baseline
+written by an earlier --save-baseline run. The exit status is 1 if any run is slower, or uses more memory, than its
+baseline by more than the tolerance. A TORCH_COUNT_ALLOCATIONS build also reports the heap allocations per step, and
+any more of them than the baseline made is a regression too.
+
+Example:
+    torch-perf.py --torch=build/bin/torch --ranks=1,2,4 --threads=1,2 --baseline=perf-baseline.json
+"""
+
+import argparse
+import json
+import os
+import re
+import shlex
+import subprocess
+import sys
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+TORCH_DIR = os.path.dirname(os.path.dirname(SCRIPT_DIR))
+PC2CM = 3.09e18
+
+# Each problem overrides entries of config/torch-config.lua, by "Section.key".
+PROBLEMS = {
+	"sod": {
+		"description": "1D Sod shock tube (hydrodynamics only)",
+		"setup": os.path.join(SCRIPT_DIR, "sod-setup.lua"),
+		"parameters": {
+			"Integration.time_scale": 1.0e11,
+			"Integration.simulation_time": 0.2e11,
+			"Integration.radiation_on": False,
+			"Integration.cooling_on": False,
+			"Grid.no_dimensions": 1,
+			"Grid.no_cells_x": 16384,
+			"Grid.no_cells_y": 1,
+			"Grid.no_cells_z": 1,
+			"Grid.no_procs_x": 0,
+			"Grid.geometry": "cartesian",
+			"Grid.side_length": 1.0e7,
+			"Grid.left_boundary_condition_x": "outflow",
+			"Hydrodynamics.gamma": 1.4,
+			"Hydrodynamics.riemann_solver": "HLLC",
+			"Star.on": False,
+			"Setup.name": "lua",
+		},
+	},
+	"starbench": {
+		"description": "2D cylindrical STARBENCH D-type ionisation front (radiation, isothermal coupling)",
+		"setup": None,
+		"parameters": {
+			"Integration.cooling_on": False,
+			"Grid.no_dimensions": 2,
+			"Grid.no_cells_x": 256,
+			"Grid.no_cells_y": 512,
+			"Grid.side_length": 1.5 * PC2CM,
+			"Radiation.case_b_recombination_coeff": 2.7e-13,
+			"Radiation.temperature_hi": 100,
+			"Radiation.temperature_hii": 10000,
+			"Radiation.coupling": "tti",
+			"Star.on": True,
+			"Star.cell_position_y": 256,
+			"Star.photon_rate": 1.0e49,
+			"Star.mass_loss_rate": 0,
+			"Star.wind_radius_in_cells": 0,
+			"Setup.name": "uniform",
+			"Setup.number_density": 1000.0,
+			"Setup.temperature": 100.0,
+		},
+	},
+	"wind": {
+		"description": "2D cylindrical wind blown bubble in a power-law cloud (hydrodynamics, radiation, cooling)",
+		"setup": None,
+		"parameters": {
+			"Grid.no_dimensions": 2,
+			"Grid.no_cells_x": 300,
+			"Grid.no_cells_y": 400,
+			"Star.cell_position_y": 220,
+			"Star.wind_radius_in_cells": 10,
+			"Setup.name": "powerlaw_cloud",
+		},
+	},
+	"box3d": {
+		"description": "3D uniform box ionised from its centre (hydrodynamics, radiation, cooling)",
+		"setup": None,
+		"parameters": {
+			"Grid.no_dimensions": 3,
+			"Grid.no_cells_x": 64,
+			"Grid.no_cells_y": 64,
+			"Grid.no_cells_z": 64,
+			"Grid.geometry": "cartesian",
+			"Grid.side_length": 2.0 * PC2CM,
+			"Grid.left_boundary_condition_x": "outflow",
+			"Grid.left_boundary_condition_z": "outflow",
+			"Grid.right_boundary_condition_z": "outflow",
+			"Star.on": True,
+			"Star.cell_position_x": 32,
+			"Star.cell_position_y": 32,
+			"Star.cell_position_z": 32,
+			"Star.snap_to_face_left_x": False,
+			"Star.mass_loss_rate": 0,
+			"Star.wind_radius_in_cells": 0,
+			"Setup.name": "uniform",
+			"Setup.number_density": 100.0,
+			"Setup.temperature": 100.0,
+		},
+	},
+}
+
+
+def luaValue(value):
+	if isinstance(value, bool):
+		return "true" if value else "false"
+	if isinstance(value, str):
+		return '"' + value + '"'
+	return repr(value)
+
+
+def writeParameters(template, overrides, filename):
+	"""Writes a copy of the parameter file template with the overridden entries replaced."""
+	text = template
+	for name, value in overrides.items():
+		section, key = name.split(".")
+		block = re.search(r"(?ms)^\t" + section + r" = \{\n.*?^\t\},", text)
+		if block is None:
+			raise RuntimeError("torch-perf: no section " + section + " in the parameter template")
+		entry = re.compile(r"(?m)^(\t\t" + key + r"\s*=\s*)[^\n]*,$")
+		body, count = entry.subn(lambda m: m.group(1) + luaValue(value) + ",", block.group(0))
+		if count != 1:
+			raise RuntimeError("torch-perf: no entry " + name + " in the parameter template")
+		text = text[:block.start()] + body + text[block.end():]
+	with open(filename, "w") as f:
+		f.write(text)
+
+
+def runProblem(args, template, name, ranks, threads):
+	problem = PROBLEMS[name]
+	rundir = os.path.join(os.path.abspath(args.workdir), "%s-np%d-t%d" % (name, ranks, threads))
+	os.makedirs(rundir, exist_ok=True)
+	outdir = os.path.join(rundir, "out")
+	overrides = dict(problem["parameters"])
+	overrides["Integration.output_directory"] = outdir
+	overrides["Integration.max_steps"] = args.steps
+	overrides["Integration.simulation_time"] = overrides.get("Integration.simulation_time", 1.0e30)
+	overrides["Integration.ncheckpoints"] = 1
+	overrides["Integration.check_level"] = "off"
+	paramfile = os.path.join(rundir, "params.lua")
+	writeParameters(template, overrides, paramfile)
+	setupfile = problem["setup"] or os.path.join(TORCH_DIR, "config", "torch-setup.lua")
+
+	command = shlex.split(args.mpirun.format(np=ranks)) + [os.path.abspath(args.torch), "--paramfile=" + paramfile,
+			"--setupfile=" + setupfile, "-s"]
+	env = dict(os.environ)
+	env["OMP_NUM_THREADS"] = str(threads)
+	with open(os.path.join(rundir, "run.log"), "w") as log:
+		status = subprocess.call(command, stdout=log, stderr=subprocess.STDOUT, env=env, cwd=rundir)
+	if status != 0:
+		raise RuntimeError("torch-perf: %s failed (exit status %d), see %s" % (" ".join(command), status,
+				os.path.join(rundir, "run.log")))
+	with open(os.path.join(outdir, "log", "perf.json")) as f:
+		perf = json.load(f)
+	perf["problem"] = name
+	perf["ranks"] = ranks
+	perf["threads_requested"] = threads
+	return perf
+
+
+def key(result):
+	return "%s/np%d/t%d" % (result["problem"], result["ranks"], result["threads_requested"])
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+	parser.add_argument("--torch", default=os.path.join(TORCH_DIR, "build", "bin", "torch"), help="torch executable")
+	parser.add_argument("--template", default=os.path.join(TORCH_DIR, "config", "torch-config.lua"),
+			help="parameter file the problems override")
+	parser.add_argument("--problems", default=",".join(PROBLEMS), help="comma separated problems to run")
+	parser.add_argument("--ranks", default="1,2,4", help="comma separated MPI processor counts")
+	parser.add_argument("--threads", default="1", help="comma separated OpenMP thread counts")
+	parser.add_argument("--steps", type=int, default=50, help="steps taken by every run")
+	parser.add_argument("--mpirun", default="mpirun -np {np}", help="MPI launcher, {np} is the processor count")
+	parser.add_argument("--workdir", default="perf", help="directory the runs are made in")
+	parser.add_argument("--out", default="perf-results.json", help="file the results are written to")
+	parser.add_argument("--baseline", default="", help="results of an earlier run to compare against")
+	parser.add_argument("--save-baseline", action="store_true", help="write the results to --baseline as well")
+	parser.add_argument("--tolerance", type=float, default=0.1,
+			help="largest fractional loss of throughput, or gain of memory use, that is not a regression")
+	args = parser.parse_args()
+
+	with open(args.template) as f:
+		template = f.read()
+	problems = [p for p in args.problems.split(",") if p]
+	for name in problems:
+		if name not in PROBLEMS:
+			sys.exit("torch-perf: unknown problem %s (choose from %s)" % (name, ", ".join(PROBLEMS)))
+	ranks = [int(n) for n in args.ranks.split(",")]
+	threads = [int(n) for n in args.threads.split(",")]
+
+	results = []
+	print("%-10s %6s %8s %10s %16s %11s %14s" % ("problem", "ranks", "threads", "seconds", "cell updates/s",
+			"efficiency", "max RSS (MiB)"))
+	for name in problems:
+		reference = None
+		for np in ranks:
+			for nt in threads:
+				perf = runProblem(args, template, name, np, nt)
+				cores = np * nt
+				# Parallel efficiency relative to the run on the fewest cores.
+				if reference is None or cores < reference[1]:
+					reference = (perf["cell_updates_per_second"], cores)
+				perf["efficiency"] = (perf["cell_updates_per_second"] / cores) / (reference[0] / reference[1])
+				results.append(perf)
+				print("%-10s %6d %8d %10.3f %16.4g %11.3f %14.1f" % (name, np, nt, perf["seconds"],
+						perf["cell_updates_per_second"], perf["efficiency"], perf["max_rss_mib"]))
+				sys.stdout.flush()
+
+	with open(args.out, "w") as f:
+		json.dump({"steps": args.steps, "results": results}, f, indent=2)
+
+	regressions = 0
+	if args.baseline and os.path.exists(args.baseline) and not args.save_baseline:
+		with open(args.baseline) as f:
+			baseline = {key(r): r for r in json.load(f)["results"]}
+		print("\n%-24s %14s %14s %12s" % ("run", "throughput", "max RSS", "status"))
+		for result in results:
+			base = baseline.get(key(result))
+			if base is None:
+				print("%-24s %14s %14s %12s" % (key(result), "-", "-", "no baseline"))
+				continue
+			speed = result["cell_updates_per_second"] / base["cell_updates_per_second"]
+			memory = result["max_rss_mib"] / base["max_rss_mib"]
+			status = "ok"
+			if speed < 1 - args.tolerance or memory > 1 + args.tolerance:
+				status = "REGRESSION"
+				regressions += 1
+			elif result.get("allocations_per_step", 0) > base.get("allocations_per_step", float("inf")):
+				status = "ALLOCATIONS"
+				regressions += 1
+			print("%-24s %13.1f%% %13.1f%% %12s" % (key(result), 100 * (speed - 1), 100 * (memory - 1), status))
+	if args.save_baseline:
+		if not args.baseline:
+			sys.exit("torch-perf: --save-baseline needs --baseline")
+		with open(args.baseline, "w") as f:
+			json.dump({"steps": args.steps, "results": results}, f, indent=2)
+	return 1 if regressions > 0 else 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Checks a TORCH built with TORCH_SINGLE_PRECISION_STORAGE against one built in double precision.
+
+Both executables run the 2D STARBENCH D-type ionisation front of torch-perf.py for a fixed number of steps. The final
+snapshots are compared by the relative difference of the mean HII fraction (the size of the ionised region) and the
+L1 norm of the difference of every other field relative to its own L1 norm. The exit status is 1 if any of them is
+larger than the tolerance.
+
+Example:
+    torch-precision.py --torch=build/bin/torch --torch-single=build-single/bin/torch --steps=2000
+"""
+
+import argparse
+import gzip
+import importlib.util
+import os
+import shlex
+import subprocess
+import sys
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+TORCH_DIR = os.path.dirname(os.path.dirname(SCRIPT_DIR))
+
+spec = importlib.util.spec_from_file_location("torch_perf", os.path.join(SCRIPT_DIR, "torch-perf.py"))
+torch_perf = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(torch_perf)
+
+
+def run(args, template, torch, name):
+	"""Runs STARBENCH on one executable and returns the path of its last snapshot."""
+	rundir = os.path.join(os.path.abspath(args.workdir), name)
+	os.makedirs(rundir, exist_ok=True)
+	outdir = os.path.join(rundir, "out")
+	overrides = dict(torch_perf.PROBLEMS["starbench"]["parameters"])
+	overrides["Integration.output_directory"] = outdir
+	overrides["Integration.max_steps"] = args.steps
+	overrides["Integration.simulation_time"] = 1.0e30
+	overrides["Integration.ncheckpoints"] = 1
+	overrides["Integration.snapshot_format"] = "text"
+	paramfile = os.path.join(rundir, "params.lua")
+	torch_perf.writeParameters(template, overrides, paramfile)
+
+	command = shlex.split(args.mpirun.format(np=args.ranks)) + [os.path.abspath(torch), "--paramfile=" + paramfile,
+			"--setupfile=" + os.path.join(TORCH_DIR, "config", "torch-setup.lua"), "-s"]
+	with open(os.path.join(rundir, "run.log"), "w") as log:
+		status = subprocess.call(command, stdout=log, stderr=subprocess.STDOUT, cwd=rundir)
+	if status != 0:
+		raise RuntimeError("torch-precision: %s failed (exit status %d), see %s" % (" ".join(command), status,
+				os.path.join(rundir, "run.log")))
+	snapshots = sorted(f for f in os.listdir(outdir) if f.startswith("data2D_"))
+	if not snapshots:
+		raise RuntimeError("torch-precision: no snapshots in " + outdir)
+	return os.path.join(outdir, snapshots[-1])
+
+
+def readSnapshot(filename):
+	"""Returns the rows of the cells of a text snapshot, sorted by position."""
+	opener = gzip.open if filename.endswith(".gz") else open
+	with opener(filename, "rt") as f:
+		rows = [[float(x) for x in line.split()] for line in f if line.strip() and not line.startswith("#")]
+	return sorted(row for row in rows if len(row) > 3)
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+	parser.add_argument("--torch", default=os.path.join(TORCH_DIR, "build", "bin", "torch"),
+			help="torch executable built in double precision")
+	parser.add_argument("--torch-single", required=True,
+			help="torch executable built with TORCH_SINGLE_PRECISION_STORAGE")
+	parser.add_argument("--template", default=os.path.join(TORCH_DIR, "config", "torch-config.lua"),
+			help="parameter file the problem overrides")
+	parser.add_argument("--steps", type=int, default=1000, help="steps taken by both runs")
+	parser.add_argument("--ranks", type=int, default=1, help="MPI processors of both runs")
+	parser.add_argument("--mpirun", default="mpirun -np {np}", help="MPI launcher, {np} is the processor count")
+	parser.add_argument("--workdir", default="precision", help="directory the runs are made in")
+	parser.add_argument("--tolerance", type=float, default=0.01, help="largest relative difference that passes")
+	args = parser.parse_args()
+
+	with open(args.template) as f:
+		template = f.read()
+	double = readSnapshot(run(args, template, args.torch, "double"))
+	single = readSnapshot(run(args, template, args.torch_single, "single"))
+	if len(double) != len(single):
+		sys.exit("torch-precision: the snapshots have %d and %d cells" % (len(double), len(single)))
+
+	# The columns are the nd coordinates, then density, pressure, HII fraction and the nd velocities.
+	nd = (len(double[0]) - 3)//2
+	names = ["density", "pressure", "hii"] + ["velocity_" + "xyz"[i] for i in range(nd)]
+	failures = 0
+	print("%-12s %14s %10s" % ("field", "difference", "status"))
+	for i, name in enumerate(names):
+		column = nd + i
+		if name == "hii":
+			meanDouble = sum(row[column] for row in double)/len(double)
+			meanSingle = sum(row[column] for row in single)/len(single)
+			difference = abs(meanSingle - meanDouble)/meanDouble if meanDouble > 0 else abs(meanSingle)
+			name = "mean_hii"
+		else:
+			norm = sum(abs(row[column]) for row in double)
+			error = sum(abs(a[column] - b[column]) for a, b in zip(double, single))
+			difference = error/norm if norm > 0 else error
+		status = "ok" if difference <= args.tolerance else "FAIL"
+		failures += status != "ok"
+		print("%-12s %14.4e %10s" % (name, difference, status))
+	return 1 if failures > 0 else 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,139 @@
+"""Reads Torch's binary snapshots (.tsnp) through libtorchsnap, the snapshot reader Torch itself uses.
+
+The file is memory mapped, and only the rows of the cells asked for are read, so a single variable or a small box of a
+large snapshot comes back without parsing the rest of the file. The arrays are indexed [z, y, x] over the dimensions
+the snapshot has, e.g. den[j, i] in 2D, in cgs units. A delta snapshot is reconstructed when it is opened, from the
+snapshots before it in its directory back to its keyframe, and then reads as a full snapshot.
+
+	snap = Snapshot("tmp/data2D_000010.tsnp")
+	den = snap["den"]
+	hii = snap.field("hii", lo=(100, 0), hi=(200, 50))
+
+libtorchsnap.so is built alongside torch, in the lib directory of the build. Set TORCH_SNAPSHOT_LIB to its path if it
+is not found in the build directories next to this script.
+"""
+import ctypes
+import os
+
+import numpy as np
+
+_lib = None
+
+def _library():
+	global _lib
+	if _lib is not None:
+		return _lib
+	here = os.path.dirname(os.path.abspath(__file__))
+	candidates = [os.environ.get("TORCH_SNAPSHOT_LIB", "")]
+	for build in ["build", "_build", "bin"]:
+		candidates.append(os.path.join(here, "..", "..", build, "lib", "libtorchsnap.so"))
+	candidates.append("libtorchsnap.so")
+	for path in candidates:
+		if not path:
+			continue
+		try:
+			lib = ctypes.CDLL(path)
+			break
+		except OSError:
+			continue
+	else:
+		raise OSError("snapshot: unable to load libtorchsnap.so; set TORCH_SNAPSHOT_LIB to its path.")
+
+	c_int3 = ctypes.c_int*3
+	c_double3 = ctypes.c_double*3
+	lib.torchsnap_open.restype = ctypes.c_void_p
+	lib.torchsnap_open.argtypes = [ctypes.c_char_p]
+	lib.torchsnap_close.restype = None
+	lib.torchsnap_close.argtypes = [ctypes.c_void_p]
+	lib.torchsnap_error.restype = ctypes.c_char_p
+	lib.torchsnap_error.argtypes = []
+	lib.torchsnap_grid.restype = None
+	lib.torchsnap_grid.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_int), c_int3, c_int3, ctypes.POINTER(ctypes.c_int),
+		ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_double), c_double3]
+	lib.torchsnap_variable.restype = ctypes.c_int
+	lib.torchsnap_variable.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_char_p),
+		ctypes.POINTER(ctypes.c_char_p), ctypes.POINTER(ctypes.c_double)]
+	lib.torchsnap_read.restype = ctypes.c_int
+	lib.torchsnap_read.argtypes = [ctypes.c_void_p, ctypes.c_int, c_int3, c_int3, ctypes.POINTER(ctypes.c_double)]
+	_lib = lib
+	return lib
+
+def _check(lib, status):
+	if status != 0:
+		raise IOError(lib.torchsnap_error().decode())
+
+class Snapshot:
+	"""A binary snapshot, mapped until close() (or the end of a with block)."""
+
+	def __init__(self, filename):
+		lib = _library()
+		self._lib = lib
+		self._handle = lib.torchsnap_open(filename.encode())
+		if not self._handle:
+			raise IOError(lib.torchsnap_error().decode())
+		nd = ctypes.c_int()
+		ncells = (ctypes.c_int*3)()
+		offset = (ctypes.c_int*3)()
+		geometry = ctypes.c_int()
+		nvars = ctypes.c_int()
+		time = ctypes.c_double()
+		dx = (ctypes.c_double*3)()
+		lib.torchsnap_grid(self._handle, ctypes.byref(nd), ncells, offset, ctypes.byref(geometry), ctypes.byref(nvars),
+			ctypes.byref(time), dx)
+		self.filename = filename
+		self.nd = nd.value
+		self.ncells = tuple(ncells[:3])
+		self.offset = tuple(offset[:3])
+		self.geometry = ["cartesian", "cylindrical", "spherical"][geometry.value]
+		self.time = time.value
+		self.dx = tuple(dx[:3])
+		self.names = []
+		self.units = {}
+		self.errors = {}
+		for i in range(nvars.value):
+			name = ctypes.c_char_p()
+			unit = ctypes.c_char_p()
+			error = ctypes.c_double()
+			_check(lib, lib.torchsnap_variable(self._handle, i, ctypes.byref(name), ctypes.byref(unit), ctypes.byref(error)))
+			self.names.append(name.value.decode())
+			self.units[self.names[-1]] = unit.value.decode()
+			self.errors[self.names[-1]] = error.value
+
+	def close(self):
+		if self._handle:
+			self._lib.torchsnap_close(self._handle)
+			self._handle = None
+
+	def __del__(self):
+		self.close()
+
+	def __enter__(self):
+		return self
+
+	def __exit__(self, *args):
+		self.close()
+
+	def __getitem__(self, name):
+		return self.field(name)
+
+	def field(self, name, lo=None, hi=None):
+		"""Values of a variable over the box of cells [lo, hi), given as (x, y, z) grid coordinates over the snapshot's
+		dimensions (the whole grid by default), indexed [z, y, x]."""
+		if name not in self.names:
+			raise KeyError("snapshot: " + self.filename + " has no variable " + name + ".")
+		lo3 = [0, 0, 0]
+		hi3 = list(self.ncells)
+		for idim in range(self.nd):
+			if lo is not None:
+				lo3[idim] = lo[idim]
+			if hi is not None:
+				hi3[idim] = hi[idim]
+		shape = [hi3[idim] - lo3[idim] for idim in reversed(range(self.nd))]
+		values = np.empty(shape, dtype=np.float64)
+		_check(self._lib, self._lib.torchsnap_read(self._handle, self.names.index(name), (ctypes.c_int*3)(*lo3),
+			(ctypes.c_int*3)(*hi3), values.ctypes.data_as(ctypes.POINTER(ctypes.c_double))))
+		return values
+
+	def coordinates(self, axis):
+		"""Cell centres (cm) along an axis, 0 for x (or r), in the grid of the run."""
+		return (self.offset[axis] + np.arange(self.ncells[axis]) + 0.5)*self.dx[axis]
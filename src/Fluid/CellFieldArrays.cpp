@@ -0,0 +1,107 @@
+#include "CellFieldArrays.hpp"
+#include "GridCell.hpp"
+
+void CellFieldArrays::resize(std::size_t ncells) {
+	if (ncells == m_size)
+		return;
+	for (int iu = 0; iu < UID::N; ++iu) {
+		m_Q[iu].resize(ncells, 0);
+		m_U[iu].resize(ncells, 0);
+		m_UDOT[iu].resize(ncells, 0);
+	}
+	m_vol.resize(ncells, 0);
+	m_gamma.resize(ncells, 0);
+	m_soundSpeed.resize(ncells, 0);
+	m_size = ncells;
+}
+
+std::size_t CellFieldArrays::size() const {
+	return m_size;
+}
+
+/**
+ * @brief Copies the selected fields of cells [startID, endID) into the SoA arrays.
+ * @param cells The AoS GridCell storage.
+ * @param startID First GridCell ID to copy.
+ * @param endID One past the last GridCell ID to copy.
+ * @param mask Bitwise OR of FieldMask values.
+ */
+void CellFieldArrays::pack(const GridCellVector& cells, int startID, int endID, unsigned int mask) {
+	resize(cells.size());
+	for (int iu = 0; iu < UID::N; ++iu) {
+		if (mask & FieldMask::Q) {
+			double* q = m_Q[iu].data();
+			for (int id = startID; id < endID; ++id)
+				q[id] = cells[id].Q[iu];
+		}
+		if (mask & FieldMask::U) {
+			double* u = m_U[iu].data();
+			for (int id = startID; id < endID; ++id)
+				u[id] = cells[id].U[iu];
+		}
+		if (mask & FieldMask::UDOT) {
+			double* udot = m_UDOT[iu].data();
+			for (int id = startID; id < endID; ++id)
+				udot[id] = cells[id].UDOT[iu];
+		}
+	}
+	for (int id = startID; id < endID; ++id) {
+		if (mask & FieldMask::VOL)
+			m_vol[id] = cells[id].vol;
+		if (mask & FieldMask::GAMMA)
+			m_gamma[id] = cells[id].heatCapacityRatio;
+		if (mask & FieldMask::SOUNDSPEED)
+			m_soundSpeed[id] = cells[id].getSoundSpeed();
+	}
+}
+
+/**
+ * @brief Copies the selected fields of the SoA arrays back into cells [startID, endID).
+ * @param cells The AoS GridCell storage.
+ * @param startID First GridCell ID to copy.
+ * @param endID One past the last GridCell ID to copy.
+ * @param mask Bitwise OR of FieldMask values.
+ */
+void CellFieldArrays::unpack(GridCellVector& cells, int startID, int endID, unsigned int mask) const {
+	for (int iu = 0; iu < UID::N; ++iu) {
+		if (mask & FieldMask::Q) {
+			const double* q = m_Q[iu].data();
+			for (int id = startID; id < endID; ++id)
+				cells[id].Q[iu] = q[id];
+		}
+		if (mask & FieldMask::U) {
+			const double* u = m_U[iu].data();
+			for (int id = startID; id < endID; ++id)
+				cells[id].U[iu] = u[id];
+		}
+		if (mask & FieldMask::UDOT) {
+			const double* udot = m_UDOT[iu].data();
+			for (int id = startID; id < endID; ++id)
+				cells[id].UDOT[iu] = udot[id];
+		}
+	}
+	for (int id = startID; id < endID; ++id) {
+		if (mask & FieldMask::VOL)
+			cells[id].vol = m_vol[id];
+		if (mask & FieldMask::GAMMA)
+			cells[id].heatCapacityRatio = m_gamma[id];
+		if (mask & FieldMask::SOUNDSPEED)
+			cells[id].setSoundSpeed(m_soundSpeed[id]);
+	}
+}
+
+FieldLooper::FieldLooper(CellFieldArrays& fields, int startID, int endID)
+: m_fields(fields)
+, startID(startID)
+, endID(endID)
+{
+
+}
+
+ConstFieldLooper::ConstFieldLooper(const CellFieldArrays& fields, int startID, int endID)
+: m_fields(fields)
+, startID(startID)
+, endID(endID)
+{
+
+}
@@ -0,0 +1,179 @@
+/**
+ * Provides the CellFieldArrays, FieldLooper and ConstFieldLooper classes.
+ * @file CellFieldArrays.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef CELLFIELDARRAYS_HPP_
+#define CELLFIELDARRAYS_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "GridCell.hpp"
+#include "Torch/Common.hpp"
+
+/**
+ * @class AlignedAllocator
+ *
+ * @brief Minimal allocator that aligns the start of every allocation to ALIGN bytes so that field arrays start on a cache line.
+ */
+template <class T, std::size_t ALIGN>
+class AlignedAllocator {
+public:
+	using value_type = T;
+	template <class U> struct rebind { using other = AlignedAllocator<U, ALIGN>; };
+
+	AlignedAllocator() { }
+	template <class U> AlignedAllocator(const AlignedAllocator<U, ALIGN>&) { }
+
+	T* allocate(std::size_t n) {
+		void* ptr = nullptr;
+		if (posix_memalign(&ptr, ALIGN, n*sizeof(T)) != 0)
+			throw std::bad_alloc();
+		return static_cast<T*>(ptr);
+	}
+	void deallocate(T* ptr, std::size_t) {
+		std::free(ptr);
+	}
+};
+
+template <class T, class U, std::size_t ALIGN>
+bool operator==(const AlignedAllocator<T, ALIGN>&, const AlignedAllocator<U, ALIGN>&) { return true; }
+template <class T, class U, std::size_t ALIGN>
+bool operator!=(const AlignedAllocator<T, ALIGN>&, const AlignedAllocator<U, ALIGN>&) { return false; }
+
+using FieldVector = std::vector<double, AlignedAllocator<double, 64>>;
+
+/**
+ * @brief Bit flags selecting which GridCell fields are copied between the AoS cells and the SoA mirror.
+ */
+struct FieldMask {
+	enum Mask : unsigned int {Q = 1, U = 2, UDOT = 4, VOL = 8, GAMMA = 16, SOUNDSPEED = 32, ALL = 63};
+};
+
+/**
+ * @class CellIndexIterator
+ *
+ * @brief Forward iterator over a contiguous range of GridCell IDs.
+ */
+class CellIndexIterator {
+public:
+	explicit CellIndexIterator(int id) : m_id(id) { }
+	int operator*() const { return m_id; }
+	CellIndexIterator& operator++() { ++m_id; return *this; }
+	bool operator!=(const CellIndexIterator& other) const { return m_id != other.m_id; }
+	bool operator==(const CellIndexIterator& other) const { return m_id == other.m_id; }
+private:
+	int m_id;
+};
+
+/**
+ * @class CellFieldArrays
+ *
+ * @brief Structure-of-arrays storage for the most frequently streamed GridCell fields.
+ *
+ * Each fluid variable (e.g. Q[UID::DEN]) is held in its own contiguous, 64 byte aligned array indexed by GridCell ID, so
+ * sweeps that only read a handful of variables do not drag whole GridCell objects through the cache. The arrays mirror
+ * GridCellCollection::cells and are kept in step with pack()/unpack() or by writing through from the sweeps that
+ * produce the data (see Fluid::fixPrimitives).
+ *
+ * @see GridCellCollection
+ * @see FieldLooper
+ */
+class CellFieldArrays {
+public:
+	void resize(std::size_t ncells);
+	std::size_t size() const;
+
+	void pack(const GridCellVector& cells, int startID, int endID, unsigned int mask);
+	void unpack(GridCellVector& cells, int startID, int endID, unsigned int mask) const;
+
+	double* Q(int iu) { return m_Q[iu].data(); }
+	double* U(int iu) { return m_U[iu].data(); }
+	double* UDOT(int iu) { return m_UDOT[iu].data(); }
+	double* vol() { return m_vol.data(); }
+	double* heatCapacityRatio() { return m_gamma.data(); }
+	double* soundSpeed() { return m_soundSpeed.data(); }
+	const double* Q(int iu) const { return m_Q[iu].data(); }
+	const double* U(int iu) const { return m_U[iu].data(); }
+	const double* UDOT(int iu) const { return m_UDOT[iu].data(); }
+	const double* vol() const { return m_vol.data(); }
+	const double* heatCapacityRatio() const { return m_gamma.data(); }
+	const double* soundSpeed() const { return m_soundSpeed.data(); }
+
+private:
+	std::size_t m_size = 0;
+	std::array<FieldVector, UID::N> m_Q;
+	std::array<FieldVector, UID::N> m_U;
+	std::array<FieldVector, UID::N> m_UDOT;
+	FieldVector m_vol;
+	FieldVector m_gamma;
+	FieldVector m_soundSpeed;
+};
+
+/**
+ * @class FieldLooper
+ *
+ * @brief Looper-style proxy over the SoA mirror of a CellRange of GridCells.
+ *
+ * Iterating yields GridCell IDs; the field accessors return raw pointers indexed by those IDs, e.g.
+ * @code
+ * FieldLooper fl = grid.getFieldIterable(CellRange::GRID_CELLS);
+ * const double* den = fl.Q(UID::DEN);
+ * for (int id : fl)
+ *     sum += den[id];
+ * @endcode
+ */
+class FieldLooper {
+public:
+	FieldLooper(CellFieldArrays& fields, int startID, int endID);
+
+	CellIndexIterator begin() const { return CellIndexIterator(startID); }
+	CellIndexIterator end() const { return CellIndexIterator(endID); }
+	int first() const { return startID; }
+	int last() const { return endID; }
+
+	double* Q(int iu) { return m_fields.Q(iu); }
+	double* U(int iu) { return m_fields.U(iu); }
+	double* UDOT(int iu) { return m_fields.UDOT(iu); }
+	double* vol() { return m_fields.vol(); }
+	double* heatCapacityRatio() { return m_fields.heatCapacityRatio(); }
+	double* soundSpeed() { return m_fields.soundSpeed(); }
+private:
+	CellFieldArrays& m_fields;
+	int startID;
+	int endID;
+};
+
+/**
+ * @class ConstFieldLooper
+ *
+ * @brief Read-only counterpart of FieldLooper.
+ */
+class ConstFieldLooper {
+public:
+	ConstFieldLooper(const CellFieldArrays& fields, int startID, int endID);
+
+	CellIndexIterator begin() const { return CellIndexIterator(startID); }
+	CellIndexIterator end() const { return CellIndexIterator(endID); }
+	int first() const { return startID; }
+	int last() const { return endID; }
+
+	const double* Q(int iu) const { return m_fields.Q(iu); }
+	const double* U(int iu) const { return m_fields.U(iu); }
+	const double* UDOT(int iu) const { return m_fields.UDOT(iu); }
+	const double* vol() const { return m_fields.vol(); }
+	const double* heatCapacityRatio() const { return m_fields.heatCapacityRatio(); }
+	const double* soundSpeed() const { return m_fields.soundSpeed(); }
+private:
+	const CellFieldArrays& m_fields;
+	int startID;
+	int endID;
+};
+
+#endif /* CELLFIELDARRAYS_HPP_ */
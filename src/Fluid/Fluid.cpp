@@ -6,18 +6,12 @@
 #include <string>
 #include <iostream>
 
+#include "IO/Logger.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+#include "Misc/Parallel.hpp"
 #include "Torch/Constants.hpp"
 #include "GridCell.hpp"
 
-Star::Location calcContainingCore(int x, int xl, int xr, int rank) {
-	Star::Location containing_core = Star::Location::HERE;
-	if (x < xl)
-		containing_core = Star::Location::LEFT;
-	else if (x > xr)
-		containing_core = Star::Location::RIGHT;
-	return containing_core;
-}
-
 void Fluid::initialise(std::shared_ptr<Constants> c, FluidParameters fp) {
 	consts = std::move(c);
 	heatCapacityRatio = fp.heatCapacityRatio;
@@ -25,16 +19,54 @@ void Fluid::initialise(std::shared_ptr<Constants> c, FluidParameters fp) {
 }
 
 void Fluid::initialiseGrid(GridParameters gp, StarParameters sp) {
+	if (sp.on)
+		gp.starColumn = sp.position[0];
+	m_gridParameters = gp;
+	m_starParameters = sp;
+	m_primitivesCurrent = false;
+	m_uniformGamma = false;
 	grid.initialise(consts, gp);
+	// Slabs chosen by the Grid are kept when it is rebuilt, e.g. coarsened.
+	m_gridParameters.xEdges = grid.xEdges;
+	++m_gridBuilds;
+
+	// Column densities are only passed across the faces of the processor blocks, a ray that crosses an edge or corner
+	// between blocks would need ghost cells there.
+	if (sp.on) {
+		int nsplit = 0;
+		for (int nproc : MPIW::Instance().getDims())
+			nsplit += (nproc > 1);
+		if (nsplit > 1)
+			throw std::runtime_error("Fluid::initialiseGrid: ray tracing needs the grid to be split between processors along a single dimension (see no_procs_x/y/z).");
+	}
 
-	// Is the star on this processor's grid or to left or right?
-	Star::Location containing_core = Star::Location::HERE;
-	if (sp.position[0] < grid.getLeftX())
-		containing_core = Star::Location::LEFT;
-	else if (sp.position[0] > grid.getRightX())
-		containing_core = Star::Location::RIGHT;
+	placeStar(sp);
+
+	// The extra sources have no wind, so every core cell is traced, and they snap to the faces the star does.
+	m_sources.clear();
+	for (const SourceParameters& source : sp.extraSources) {
+		StarParameters ssp;
+		ssp.on = true;
+		ssp.position = source.position;
+		ssp.faceSnap = sp.faceSnap;
+		ssp.photonEnergy = sp.photonEnergy;
+		ssp.photonRate = source.photonRate;
+		m_sources.push_back(RaySource());
+		m_sources.back().star.initialise(consts, ssp, containingCore(source.position), grid.dx);
+		m_sources.back().tiles = grid.makeRayTiles(source.position, gp.rayTileSize, std::vector<int>(), grid.causalOrder(source.position));
+	}
+	if (gp.oneSidedRelay && MPIW::Instance().nProcessors() > 1)
+		grid.buildRelay();
+}
 
-	star.initialise(consts, sp, containing_core, grid.dx);
+/**
+ * @brief Puts the Star in a cell, building the causal order, wind and non-wind cells and ray tiles around it. Collective.
+ * @param sp Parameters of the Star, with the cell it is in.
+ */
+void Fluid::placeStar(const StarParameters& sp) {
+	++m_starPlacements;
+	star = Star();
+	star.initialise(consts, sp, containingCore(sp.position), grid.dx);
 
 	grid.buildCausal(sp.position);
 
@@ -47,15 +79,216 @@ void Fluid::initialiseGrid(GridParameters gp, StarParameters sp) {
 		for (int idim = 0; idim < consts->nd; ++idim)
 			dist2 += ((int)cell.xc[idim] - sp.position[idim])*(cell.xc[idim] - sp.position[idim]);
 		if (dist2 <= sp.windCellRadius*sp.windCellRadius || cellID == starCellID) {
-			grid.addOrderedIndex("CausalWind", cellID);
+			grid.addOrderedIndex(CellOrder::CAUSAL_WIND, cellID);
 		}
 		else
-			grid.addOrderedIndex("CausalNonWind", cellID);
+			grid.addOrderedIndex(CellOrder::CAUSAL_NON_WIND, cellID);
 	}
+	grid.buildRayTiles(sp.position, m_gridParameters.rayTileSize);
 
 	star.setWindCells(grid);
 }
 
+/**
+ * @brief Moves a moving Star to the cell its track has reached at a time. Collective.
+ *
+ * The Star is at its starting position at time 0 and moves in a straight line, stopping at the edges of the Grid. The
+ * ray geometry only depends on the cell the Star is in, so nothing is rebuilt until it crosses into another cell. Then
+ * the causal order (see Grid::causalOrder), wind cells and ray tiles are rebuilt around the new cell, and the caller has
+ * to recompute the ray geometry (see Radiation::initField).
+ * @param time Simulation time.
+ * @return Whether the Star has moved to another cell.
+ */
+bool Fluid::moveStar(double time) {
+	if (!star.on || !star.isMoving())
+		return false;
+	StarParameters sp = m_starParameters;
+	bool crossed = false;
+	for (int i = 0; i < consts->nd; ++i) {
+		double x = m_starParameters.position[i] + 0.5 + star.velocity[i]*time/grid.dx[i];
+		sp.position[i] = std::max(0, std::min(grid.ncells[i] - 1, (int)std::floor(x)));
+		crossed = crossed || (sp.position[i] != (int)std::floor(star.xc[i]));
+	}
+	if (!crossed)
+		return false;
+
+	placeStar(sp);
+	grid.hasColumnDensities = false;
+	grid.hasTracedColumnDensities = false;
+	if (MPIW::Instance().getRank() == 0)
+		Logger::Instance().print<SeverityType::DEBUG>("Fluid::moveStar: star moved into cell (", sp.position[0], ", ", sp.position[1], ", ", sp.position[2], ").\n");
+	return true;
+}
+
+/**
+ * @brief Changes the ionising photon rate and wind mass loss rate of the Star, e.g. to those of a stellar evolution code
+ * it is coupled to. Collective.
+ * @param photonRate Ionising photon rate (code units).
+ * @param massLossRate Wind mass loss rate (code units).
+ */
+void Fluid::setStarRates(double photonRate, double massLossRate) {
+	if (!star.on)
+		return;
+	m_starParameters.photonRate = photonRate;
+	m_starParameters.massLossRate = massLossRate;
+	star.photonRate = photonRate;
+	star.massLossRate = massLossRate;
+	star.setWindCells(grid);
+}
+
+/**
+ * @brief Puts the Star in another cell, e.g. the one an N-body code it is coupled to has moved it to. Collective.
+ *
+ * The caller re-initialises the ray geometry around the new position (see Radiation::initField).
+ * @param position Grid coordinates of the cell (only the first nd are used).
+ * @exception std::runtime_error Thrown if the Star moves with a velocity of its own or the cell is off the Grid.
+ */
+void Fluid::setStarPosition(const std::array<int, 3>& position) {
+	if (!star.on)
+		return;
+	if (star.isMoving())
+		throw std::runtime_error("Fluid::setStarPosition: a star with a velocity moves itself (see Fluid::moveStar).");
+	std::array<int, 3> cell = m_starParameters.position;
+	for (int i = 0; i < consts->nd; ++i) {
+		if (position[i] < 0 || position[i] >= grid.ncells[i])
+			throw std::runtime_error("Fluid::setStarPosition: position(=" + std::to_string(position[i]) + ") along dimension "
+					+ std::to_string(i) + " is off the grid.");
+		cell[i] = position[i];
+	}
+	if (cell == m_starParameters.position)
+		return;
+	m_starParameters.position = cell;
+	placeStar(m_starParameters);
+	grid.hasColumnDensities = false;
+	grid.hasTracedColumnDensities = false;
+}
+
+/**
+ * @brief Builds this Fluid's Grid as a coarse copy of another's, with factor times fewer cells along each side over the
+ * same processor blocks, and no Star. Collective.
+ *
+ * Only the cells and boundaries are used (see Radiation::traceCoarse), so the copy has neither the relay windows nor the
+ * neighbourhood collective of the fine Grid. Its halo exchanges are freed along with the fine Grid's.
+ * @param fine The Fluid to copy, whose Grid has been initialised.
+ * @param factor Cells of the fine Grid along each side of a coarse cell.
+ * @exception std::runtime_error Thrown if the processor blocks of the fine Grid are not a whole number of coarse cells.
+ */
+void Fluid::coarsenGrid(const Fluid& fine, int factor) {
+	consts = fine.consts;
+	heatCapacityRatio = fine.heatCapacityRatio;
+	massFractionH = fine.massFractionH;
+	GridParameters gp = fine.m_gridParameters;
+	gp.nprocs = MPIW::Instance().getDims();
+	gp.haloCollective = false;
+	gp.haloPrecisionCheck = false;
+	gp.oneSidedRelay = false;
+	gp.hugePages = false;
+	gp.brickSize = 0;
+	gp.memoryCheck = false;
+	gp.workCounters = false;
+	gp.gravityField = false;
+	double misaligned = 0;
+	for (int i = 0; i < consts->nd; ++i) {
+		if (fine.grid.coreOffset[i]%factor != 0 || fine.grid.coreCells[i]%factor != 0 || gp.ncells[i]%factor != 0)
+			misaligned = 1;
+		gp.ncells[i] /= factor;
+	}
+	for (int& edge : gp.xEdges)
+		edge /= factor;
+	// Every processor has to agree before any of them builds the Grid.
+	if (MPIW::Instance().maximum(misaligned) > 0)
+		throw std::runtime_error("Fluid::coarsenGrid: every processor block must be a whole number of coarse_factor(=" + std::to_string(factor) + ") cells along each side.");
+
+	m_gridParameters = gp;
+	m_primitivesCurrent = false;
+	m_uniformGamma = false;
+	grid.clear();
+	grid.initialise(consts, gp);
+	++m_gridBuilds;
+}
+
+/**
+ * @brief Puts this Fluid's Star in the coarse cell holding another's, with its wind radius coarsened too (see
+ * coarsenGrid). Collective.
+ * @param fine The Fluid whose Grid this one's is a coarse copy of.
+ * @param factor Cells of the fine Grid along each side of a coarse cell.
+ */
+void Fluid::coarsenStar(const Fluid& fine, int factor) {
+	StarParameters sp = fine.m_starParameters;
+	sp.extraSources.clear();
+	for (int i = 0; i < consts->nd; ++i)
+		sp.position[i] = (int)std::floor(fine.star.xc[i])/factor;
+	sp.windCellRadius /= factor;
+	m_starParameters = sp;
+	m_sources.clear();
+	placeStar(sp);
+}
+
+/**
+ * @brief Whether a cell is on this processor's part of the Grid, or to the left or right of it, along each dimension.
+ * @param position Grid coordinates of the cell.
+ */
+Star::Locations Fluid::containingCore(const std::array<int, 3>& position) const {
+	Star::Locations containing_core;
+	for (int i = 0; i < 3; ++i) {
+		containing_core[i] = Star::Location::HERE;
+		if (position[i] < grid.coreOffset[i])
+			containing_core[i] = Star::Location::LEFT;
+		else if (position[i] >= grid.coreOffset[i] + grid.coreCells[i])
+			containing_core[i] = Star::Location::RIGHT;
+	}
+	return containing_core;
+}
+
+/**
+ * @brief Rebuilds the Grid and the Star over new processor blocks along x, keeping the time and time step. Collective.
+ *
+ * The new GridCells start out in their default state, so the state of the old ones has to be carried over by the
+ * caller (see Torch::rebalance). A moving Star starts out back in its starting cell (see moveStar).
+ * @param xEdges Left edges of the processor blocks along x, then the number of cells along x.
+ */
+void Fluid::repartitionGrid(const std::vector<int>& xEdges) {
+	GridParameters gp = m_gridParameters;
+	gp.xEdges = xEdges;
+	// Every persistent exchange belongs to the old Grid's boundaries.
+	MPIW::Instance().freePersistent();
+	grid.clear();
+	initialiseGrid(gp, m_starParameters);
+}
+
+/**
+ * @brief Turns the stored gravitational force densities of the cells on or off (see Grid::storeGravity), for this Grid
+ * and the ones it is rebuilt as.
+ */
+void Fluid::storeGravity(bool on) {
+	m_gridParameters.gravityField = on;
+	grid.storeGravity(on);
+}
+
+/**
+ * @brief Fills in the heat capacity ratios of the ghost cells once those of the core cells have been set. Collective.
+ *
+ * If every core cell of every processor has the Fluid's heatCapacityRatio the ghost cells are given it as well, without
+ * any messages, and the integrators switch to kernels that use it (and 1/(heatCapacityRatio - 1)) in place of
+ * GridCell::heatCapacityRatio (see hasUniformGamma). Otherwise they are filled in by Grid::applyStaticBCs. Must be called
+ * again whenever the heat capacity ratios of the core cells are set, i.e. after the initial conditions and a repartition.
+ */
+void Fluid::initialiseHeatCapacityRatios() {
+	double differs = 0;
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS))
+		differs = std::max(differs, (double)(cell.heatCapacityRatio != heatCapacityRatio));
+	m_uniformGamma = MPIW::Instance().maximum(differs) == 0 && heatCapacityRatio > 1.0;
+
+	if (!m_uniformGamma) {
+		grid.applyStaticBCs();
+		return;
+	}
+	m_gammaMinusOne = heatCapacityRatio - 1.0;
+	m_invGammaMinusOne = 1.0/m_gammaMinusOne;
+	for (GridCell& cell : grid.getIterable(CellRange::ALL_CELLS))
+		cell.heatCapacityRatio = heatCapacityRatio;
+}
+
 /*
 void Fluid::initialiseStar(StarParameters sp) {
 	int containing_core = (int)(sp.position[0]/grid3D.coreCells[0]);
@@ -73,133 +306,435 @@ double Fluid::calcTemperature(double hii, double pre, double den) const {
 	return (pre/den)*(1.0/mu_inv)/consts->specificGasConstant;
 }
 
-double Fluid::calcSoundSpeed(double gamma, double pre, double den) {
+double Fluid::calcSoundSpeed(double gamma, double pre, double den) const {
 	return std::sqrt(gamma*pre/den);
 }
 
+/**
+ * @brief Inverse of the time a signal takes to cross a GridCell, the sum over the dimensions of (|v| + a)/dx.
+ * @param cell The GridCell.
+ * @param soundSpeed Sound speed in the GridCell.
+ */
+double Fluid::signalRate(const GridCell& cell, double soundSpeed) const {
+	double rate = 0;
+	for (int dim = 0; dim < consts->nd; ++dim)
+		rate += (std::fabs(cell.Q[UID::VEL+dim]) + soundSpeed)/grid.dx[dim];
+	return rate;
+}
+
+/**
+ * @brief Largest signalRate of this processor's cells, as cached by the last fixPrimitives(), updatePrimitives() or
+ * advanceAndFix().
+ *
+ * Valid for Hydrodynamics::calculateTimeStep until the next change to GridCell::Q.
+ */
+double Fluid::getMaxSignalRate() const {
+	return m_fastestCell.value;
+}
+
+/**
+ * @brief ID of the cell with the largest signalRate (see getMaxSignalRate), or -1 if every cell is at rest.
+ */
+int Fluid::getMaxSignalCell() const {
+	return m_fastestCell.index;
+}
+
+/**
+ * @brief Writes a GridCell's fixed primitive variables and sound speed through to the SoA mirror.
+ * @return The GridCell's signalRate.
+ */
+template <bool UNIFORM_GAMMA>
+double Fluid::cacheSoundSpeed(GridCell& cell, FieldLooper& fields) const {
+	const double soundSpeed = calcSoundSpeed(UNIFORM_GAMMA ? heatCapacityRatio : cell.heatCapacityRatio, cell.Q[UID::PRE], cell.Q[UID::DEN]);
+	cell.setSoundSpeed(soundSpeed);
+	fields.soundSpeed()[cell.id] = soundSpeed;
+	for (int iu = 0; iu < UID::N; ++iu)
+		fields.Q(iu)[cell.id] = cell.Q[iu];
+	return signalRate(cell, soundSpeed);
+}
+
 void Fluid::advSolution(const double dt) {
-	for (GridCell& cell : grid.getIterable("GridCells")) {
+	m_primitivesCurrent = false;
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+		GridCell& cell = cells[id];
 		for (int i = 0; i < UID::N; ++i) {
 			cell.U[i] += dt*cell.UDOT[i];
 			cell.UDOT[i] = 0;
 		}
-	}
+	});
 }
 
 void Fluid::fixSolution() {
-	for (GridCell& cell : grid.getIterable("GridCells")) {
-		if (!std::isfinite(cell.U[UID::DEN]) || !std::isfinite(cell.U[UID::PRE]))
-			throw std::runtime_error("Fluid::fixSolution(): Density = " + std::to_string(cell.U[UID::DEN]) + ", Energy =" + std::to_string(cell.U[UID::PRE]) + '\n');
-
-		double hii = std::max(std::min(cell.U[UID::HII]/cell.U[UID::DEN], 1.0), 0.0);
-		double adv = std::max(std::min(cell.U[UID::ADV]/cell.U[UID::DEN], 1.0), 0.0);
-		double v[3];
+	m_primitivesCurrent = false;
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	if (m_uniformGamma) {
+		Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+			fixConserved<true>(cells[id], cells[id].U);
+		});
+	}
+	else {
+		Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+			fixConserved<false>(cells[id], cells[id].U);
+		});
+	}
+}
 
-		double den = std::max(cell.U[UID::DEN], consts->dfloor);
+/**
+ * @brief Clamps the primitive variables to the floors and writes the fixed values through to the SoA mirror (CellFieldArrays),
+ * which is then valid for read-only sweeps until the next change to GridCell::Q.
+ *
+ * The sound speed of every cell is cached in the same pass, along with the largest signal rate that
+ * Hydrodynamics::calculateTimeStep needs, so the CFL condition takes no sweep of its own.
+ */
+void Fluid::fixPrimitives() {
+	m_primitivesCurrent = false;
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	m_fastestCell = Parallel::maximumLocation(fields.first(), fields.last(), 0.0, [&](int id) -> double {
+		GridCell& cell = cells[id];
+		fixPrimitives(cell);
+		return cacheSoundSpeed<false>(cell, fields);
+	});
+}
 
-		for (int dim = 0; dim < consts->nd; ++dim)
-			v[dim] = cell.U[UID::VEL+dim]/cell.U[UID::DEN];
+/**
+ * @brief Fused equivalent of globalQfromU() and fixPrimitives() in a single pass over the GridCells.
+ *
+ * Does nothing if the primitive variables are already up to date with the conserved ones, i.e. nothing but
+ * updatePrimitives() or advanceAndFix() has been called since the conserved variables last changed. Integrators that
+ * write straight into GridCell::Q must be followed by an advance, which marks them out of date.
+ */
+void Fluid::updatePrimitives() {
+	if (m_primitivesCurrent)
+		return;
+	m_primitivesCurrent = true;
+	if (m_uniformGamma)
+		updatePrimitivesKernel<true>();
+	else
+		updatePrimitivesKernel<false>();
+}
 
-		double ke = 0.0;
-		for(int dim = 0; dim < consts->nd; ++dim)
-			ke += v[dim]*v[dim];
-		ke *= 0.5*cell.U[UID::DEN];
+template <bool UNIFORM_GAMMA>
+void Fluid::updatePrimitivesKernel() {
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	m_fastestCell = Parallel::maximumLocation(fields.first(), fields.last(), 0.0, [&](int id) -> double {
+		GridCell& cell = cells[id];
+		QfromU(cell.Q, cell.U, UNIFORM_GAMMA ? heatCapacityRatio : cell.heatCapacityRatio, consts->nd);
+		fixPrimitives(cell);
+		return cacheSoundSpeed<UNIFORM_GAMMA>(cell, fields);
+	});
+}
 
-		double pre = (cell.U[UID::PRE] - ke)*(cell.heatCapacityRatio - 1.0);
-		ke *= den/cell.U[UID::DEN];
+/**
+ * @brief Fused equivalent of advSolution(dt), fixSolution(), globalQfromU() and fixPrimitives() in a single pass over the GridCells.
+ *
+ * Leaves GridCell::Q (and its SoA mirror), the sound speeds and the largest signal rate consistent with the advanced
+ * GridCell::U, so a following updatePrimitives() does nothing.
+ * @param dt Time step.
+ */
+void Fluid::advanceAndFix(const double dt) {
+	m_primitivesCurrent = true;
+	if (m_uniformGamma)
+		advanceAndFixKernel<true>(dt);
+	else
+		advanceAndFixKernel<false>(dt);
+}
 
-		if (pre < consts->pfloor) {
-			pre = consts->pfloor;
+template <bool UNIFORM_GAMMA>
+void Fluid::advanceAndFixKernel(const double dt) {
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	m_fastestCell = Parallel::maximumLocation(fields.first(), fields.last(), 0.0, [&](int id) -> double {
+		GridCell& cell = cells[id];
+		for (int i = 0; i < UID::N; ++i) {
+			cell.U[i] += dt*cell.UDOT[i];
+			cell.UDOT[i] = 0;
 		}
+		fixConserved<UNIFORM_GAMMA>(cell, cell.U);
+		QfromU(cell.Q, cell.U, UNIFORM_GAMMA ? heatCapacityRatio : cell.heatCapacityRatio, consts->nd);
+		fixPrimitives(cell);
+		return cacheSoundSpeed<UNIFORM_GAMMA>(cell, fields);
+	});
+}
 
-		double mu_inv = massFractionH*(hii + 1.0) + (1.0 - massFractionH)*0.25;
-		double temperature = pre/(mu_inv*consts->specificGasConstant*den);
-		if (temperature < consts->tfloor) {
-			pre = mu_inv*consts->specificGasConstant*den*consts->tfloor;
-		}
+/**
+ * @brief advanceAndFix(dt) restricted to the cells of a RayTile, for updating the Grid a tile at a time.
+ *
+ * The primitive variables only count as up to date again once every tile has been advanced and finishTileUpdates() has
+ * been called.
+ * @param dt Time step.
+ * @param tile The RayTile.
+ * @return The largest signalRate of the tile's cells and the ID of the cell it belongs to.
+ */
+Parallel::Extremum Fluid::advanceAndFix(const double dt, const RayTile& tile) {
+	m_primitivesCurrent = false;
+	return m_uniformGamma ? advanceAndFixKernel<true>(dt, tile) : advanceAndFixKernel<false>(dt, tile);
+}
+
+template <bool UNIFORM_GAMMA>
+Parallel::Extremum Fluid::advanceAndFixKernel(const double dt, const RayTile& tile) {
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	Parallel::Extremum fastest = {0, -1};
+	for (const std::vector<int>* cellIDs : { &tile.windIDs, &tile.nonWindIDs }) {
+		const Parallel::Extremum rate = Parallel::maximumLocation(0, (int)cellIDs->size(), 0.0, [&](int i) -> double {
+			GridCell& cell = cells[(*cellIDs)[i]];
+			for (int iu = 0; iu < UID::N; ++iu) {
+				cell.U[iu] += dt*cell.UDOT[iu];
+				cell.UDOT[iu] = 0;
+			}
+			fixConserved<UNIFORM_GAMMA>(cell, cell.U);
+			QfromU(cell.Q, cell.U, UNIFORM_GAMMA ? heatCapacityRatio : cell.heatCapacityRatio, consts->nd);
+			fixPrimitives(cell);
+			return cacheSoundSpeed<UNIFORM_GAMMA>(cell, fields);
+		});
+		if (rate.value > fastest.value)
+			fastest = Parallel::Extremum{rate.value, (*cellIDs)[rate.index]};
+	}
+	return fastest;
+}
 
-		cell.U[UID::DEN] = den;
-		cell.U[UID::PRE] = pre/(cell.heatCapacityRatio - 1.0) + ke;
-		cell.U[UID::HII] = hii*den;
-		cell.U[UID::ADV] = adv*den;
-		for (int dim = 0; dim < consts->nd; ++dim)
-			cell.U[UID::VEL+dim] = den*v[dim];
+/**
+ * @brief Marks the primitive variables up to date once every RayTile has been advanced by advanceAndFix(dt, tile).
+ * @param fastestCell The largest signal rate advanceAndFix(dt, tile) returned over the tiles, and its cell.
+ */
+void Fluid::finishTileUpdates(const Parallel::Extremum& fastestCell) {
+	m_fastestCell = fastestCell;
+	m_primitivesCurrent = true;
+}
 
-		if (cell.U[UID::DEN] == 0 || cell.U[UID::PRE] == 0)
-			throw std::runtime_error("Fluid::fixSolution: density or pressure is zero.\n" + cell.printInfo());
+/**
+ * @brief Sets the primitive variables of the GridCells to those of their conserved variables advanced by dt and fixed,
+ * leaving the conserved variables as they were, i.e. the predictor step of a second order time step.
+ *
+ * Fused equivalent of globalWfromU(), advSolution(dt), fixSolution(), globalQfromU() and globalUfromW() in a single pass,
+ * without either copy: the advanced state only lives in a local array until its primitive variables are found.
+ * @param dt Time step.
+ */
+void Fluid::predictPrimitives(const double dt) {
+	m_primitivesCurrent = false;
+	if (m_uniformGamma)
+		predictPrimitivesKernel<true>(dt);
+	else
+		predictPrimitivesKernel<false>(dt);
+}
 
-		for (double& v : cell.U) {
-			if (v != v || std::isinf(v))
-				throw std::runtime_error("Fluid::fixSolution: invalid value.\n" + cell.printInfo());
+template <bool UNIFORM_GAMMA>
+void Fluid::predictPrimitivesKernel(const double dt) {
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+		GridCell& cell = cells[id];
+		FluidArray U;
+		for (int i = 0; i < UID::N; ++i) {
+			U[i] = cell.U[i] + dt*cell.UDOT[i];
+			cell.UDOT[i] = 0;
 		}
+		fixConserved<UNIFORM_GAMMA>(cell, U);
+		QfromU(cell.Q, U, UNIFORM_GAMMA ? heatCapacityRatio : cell.heatCapacityRatio, consts->nd);
+	});
+}
+
+/**
+ * @brief Applies the density, pressure and temperature floors to conserved variables U of a GridCell, usually its own.
+ *
+ * The per cell validity checks only run at CheckLevel::PARANOID, otherwise Torch::checkValues catches invalid states.
+ * With UNIFORM_GAMMA the Fluid's heat capacity ratio is used, with the division by heatCapacityRatio - 1 done as a
+ * multiplication by its precomputed inverse.
+ */
+template <bool UNIFORM_GAMMA>
+void Fluid::fixConserved(GridCell& cell, FluidArray& U) {
+	const bool paranoid = (consts->checkLevel == CheckLevel::PARANOID);
+	if (paranoid && (!std::isfinite(U[UID::DEN]) || !std::isfinite(U[UID::PRE])))
+		throw std::runtime_error("Fluid::fixSolution(): Density = " + std::to_string(U[UID::DEN]) + ", Energy =" + std::to_string(U[UID::PRE]) + '\n');
+
+	double hii = std::max(std::min(U[UID::HII]/U[UID::DEN], 1.0), 0.0);
+	double adv = std::max(std::min(U[UID::ADV]/U[UID::DEN], 1.0), 0.0);
+	double v[3];
+
+	if (U[UID::DEN] < consts->dfloor)
+		countFloor(cell, WID::DEN_FLOOR);
+	double den = std::max(U[UID::DEN], consts->dfloor);
+
+	for (int dim = 0; dim < consts->nd; ++dim)
+		v[dim] = U[UID::VEL+dim]/U[UID::DEN];
+
+	double ke = 0.0;
+	for(int dim = 0; dim < consts->nd; ++dim)
+		ke += v[dim]*v[dim];
+	ke *= 0.5*U[UID::DEN];
+
+	double pre = (U[UID::PRE] - ke)*(UNIFORM_GAMMA ? m_gammaMinusOne : cell.heatCapacityRatio - 1.0);
+	ke *= den/U[UID::DEN];
+
+	if (pre < consts->pfloor) {
+		pre = consts->pfloor;
+		countFloor(cell, WID::PRE_FLOOR);
+	}
+
+	double mu_inv = massFractionH*(hii + 1.0) + (1.0 - massFractionH)*0.25;
+	double temperature = pre/(mu_inv*consts->specificGasConstant*den);
+	if (temperature < consts->tfloor) {
+		pre = mu_inv*consts->specificGasConstant*den*consts->tfloor;
+		countFloor(cell, WID::TEMP_FLOOR);
+	}
+
+	U[UID::DEN] = den;
+	U[UID::PRE] = (UNIFORM_GAMMA ? pre*m_invGammaMinusOne : pre/(cell.heatCapacityRatio - 1.0)) + ke;
+	U[UID::HII] = hii*den;
+	U[UID::ADV] = adv*den;
+	for (int dim = 0; dim < consts->nd; ++dim)
+		U[UID::VEL+dim] = den*v[dim];
+
+	if (!paranoid)
+		return;
+
+	if (U[UID::DEN] == 0 || U[UID::PRE] == 0)
+		throw std::runtime_error("Fluid::fixSolution: density or pressure is zero.\n" + cell.printInfo());
+
+	for (double& v : U) {
+		if (v != v || std::isinf(v))
+			throw std::runtime_error("Fluid::fixSolution: invalid value.\n" + cell.printInfo());
 	}
 }
 
-void Fluid::fixPrimitives() {
-	for (GridCell& cell : grid.getIterable("GridCells")) {
-		cell.Q[UID::HII] = std::max(std::min(cell.Q[UID::HII], 1.0), 0.0);
-		cell.Q[UID::ADV] = std::max(std::min(cell.Q[UID::ADV], 1.0), 0.0);
-		cell.Q[UID::DEN] = std::max(cell.Q[UID::DEN], consts->dfloor);
-		cell.Q[UID::PRE] = std::max(cell.Q[UID::PRE], consts->pfloor);
-		double mu_inv = massFractionH*(cell.Q[UID::HII] + 1.0) + (1.0 - massFractionH)*0.25;
-		double temperature = cell.Q[UID::PRE]/(mu_inv*consts->specificGasConstant*cell.Q[UID::DEN]);
-		if (temperature < consts->tfloor) {
-			cell.Q[UID::PRE] = mu_inv*consts->specificGasConstant*cell.U[UID::DEN]*consts->tfloor;
-		}
+void Fluid::fixPrimitives(GridCell& cell) {
+	cell.Q[UID::HII] = std::max(std::min(cell.Q[UID::HII], 1.0), 0.0);
+	cell.Q[UID::ADV] = std::max(std::min(cell.Q[UID::ADV], 1.0), 0.0);
+	if (cell.Q[UID::DEN] < consts->dfloor)
+		countFloor(cell, WID::DEN_FLOOR);
+	if (cell.Q[UID::PRE] < consts->pfloor)
+		countFloor(cell, WID::PRE_FLOOR);
+	cell.Q[UID::DEN] = std::max(cell.Q[UID::DEN], consts->dfloor);
+	cell.Q[UID::PRE] = std::max(cell.Q[UID::PRE], consts->pfloor);
+	double mu_inv = massFractionH*(cell.Q[UID::HII] + 1.0) + (1.0 - massFractionH)*0.25;
+	double temperature = cell.Q[UID::PRE]/(mu_inv*consts->specificGasConstant*cell.Q[UID::DEN]);
+	if (temperature < consts->tfloor) {
+		cell.Q[UID::PRE] = mu_inv*consts->specificGasConstant*cell.U[UID::DEN]*consts->tfloor;
+		countFloor(cell, WID::TEMP_FLOOR);
 	}
+	// Cached for the integrators' preTimeStepCalculations, as calcTemperature would find it.
+	cell.setTemperature((cell.Q[UID::PRE]/cell.Q[UID::DEN])*(1.0/mu_inv)/consts->specificGasConstant);
+}
+
+/**
+ * @brief Adds an application of a floor to the work counters of a GridCell, if the Grid counts work.
+ */
+void Fluid::countFloor(const GridCell& cell, WID::ID floor) {
+	if (grid.countsWork())
+		++grid.getWork(cell.id)[floor];
 }
 
 void Fluid::globalWfromU(){
-	for (GridCell& cell : grid.getIterable("GridCells"))
-		std::copy(std::begin(cell.U), std::end(cell.U), std::begin(cell.W));
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+		std::copy(std::begin(cells[id].U), std::end(cells[id].U), std::begin(cells[id].W));
+	});
 }
 
 void Fluid::globalUfromW() {
-	for(GridCell& cell : grid.getIterable("GridCells"))
-		std::copy(std::begin(cell.W), std::end(cell.W), std::begin(cell.U));
+	m_primitivesCurrent = false;
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+		std::copy(std::begin(cells[id].W), std::end(cells[id].W), std::begin(cells[id].U));
+	});
 }
 
-void Fluid::globalQfromU() {
-	for(GridCell& cell : grid.getIterable("GridCells"))
-		QfromU(cell.Q, cell.U, cell.heatCapacityRatio, consts->nd);
+/**
+ * @brief Sets the conserved variables of the GridCells to weight*W + (1 - weight)*U, the average with the saved state
+ * that ends a stage of a strong stability preserving Runge-Kutta step (see Torch::rungeKuttaStep).
+ *
+ * A convex combination of valid states is valid, so the floors need not be applied again.
+ * @param weight Weight of GridCell::W, in [0, 1].
+ */
+void Fluid::blendWithW(double weight) {
+	m_primitivesCurrent = false;
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+		GridCell& cell = cells[id];
+		for (int i = 0; i < UID::N; ++i)
+			cell.U[i] = weight*cell.W[i] + (1.0 - weight)*cell.U[i];
+	});
 }
 
-void Fluid::globalUfromQ() {
-	for(GridCell& cell : grid.getIterable("GridCells"))
-		UfromQ(cell.U, cell.Q, cell.heatCapacityRatio, consts->nd);
+/**
+ * @brief Keeps a copy of the conserved variables of the GridCells apart from GridCell::W, which the steps themselves
+ * use, so restoreConserved() can undo a whole step.
+ */
+void Fluid::saveConserved() {
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	m_savedU.resize(cells.size());
+	Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+		m_savedU[id] = cells[id].U;
+	});
 }
 
-double Fluid::max(UID::ID id) const {
-	double ret = 0;
-	bool first = false;
-	for (const GridCell& cell : grid.getIterable("GridCells")) {
-		if (first) {
-			first = false;
-			ret = cell.Q[id];
-		}
-		else {
-			ret = cell.Q[id] > ret ? cell.Q[id] : ret;
-		}
-	}
-	return ret;
+/**
+ * @brief Sets the conserved variables of the GridCells back to those of the last saveConserved().
+ */
+void Fluid::restoreConserved() {
+	m_primitivesCurrent = false;
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+		cells[id].U = m_savedU[id];
+		cells[id].UDOT.fill(0);
+	});
 }
 
-double Fluid::maxTemperature() const {
-	double ret = 0;
-	for (const GridCell& cell : grid.getIterable("GridCells")) {
-		double T = calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]);
-		ret = T > ret ? T : ret;
-	}
-	return ret;
+void Fluid::globalQfromU() {
+	m_primitivesCurrent = false;
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	const bool uniform = m_uniformGamma;
+	Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+		QfromU(cells[id].Q, cells[id].U, uniform ? heatCapacityRatio : cells[id].heatCapacityRatio, consts->nd);
+	});
+}
+
+void Fluid::globalUfromQ() {
+	m_primitivesCurrent = false;
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	const bool uniform = m_uniformGamma;
+	Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+		UfromQ(cells[id].U, cells[id].Q, uniform ? heatCapacityRatio : cells[id].heatCapacityRatio, consts->nd);
+	});
+}
+
+/**
+ * @brief Counts the GridCells with a NaN or infinite conserved variable, or zero primitive density or pressure.
+ *
+ * Written as a branch free reduction (v - v is zero only for finite v) so that the common, valid case is a cheap
+ * streaming pass.
+ * @return Number of invalid GridCells.
+ */
+int Fluid::countInvalidCells() const {
+	const GridCellVector& cells = grid.getCells();
+	ConstFieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	return Parallel::count(fields.first(), fields.last(), [&](int id) -> int {
+		const GridCell& cell = cells[id];
+		bool invalid = (cell.Q[UID::DEN] == 0) | (cell.Q[UID::PRE] == 0);
+		for (int i = 0; i < UID::N; ++i)
+			invalid |= !(cell.U[i] - cell.U[i] == 0);
+		return invalid;
+	});
 }
 
-double Fluid::minTemperature() const {
-	double ret = 1.0e20;
-	for (const GridCell& cell : grid.getIterable("GridCells")) {
-		double T = calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]);
-		ret = T < ret ? T : ret;
+bool Fluid::isValid(const GridCell& cell) const {
+	for (int i = 0; i < UID::N; ++i) {
+		if (!std::isfinite(cell.U[i]))
+			return false;
 	}
-	return ret;
+	return cell.Q[UID::DEN] != 0 && cell.Q[UID::PRE] != 0;
 }
 
 Grid& Fluid::getGrid() {
@@ -217,3 +752,28 @@ Star& Fluid::getStar() {
 const Star& Fluid::getStar() const {
 	return star;
 }
+
+const std::vector<RaySource>& Fluid::getSources() const {
+	return m_sources;
+}
+
+/**
+ * @brief Whether every cell has the Fluid's heatCapacityRatio, as found by the last initialiseHeatCapacityRatios.
+ */
+bool Fluid::hasUniformGamma() const {
+	return m_uniformGamma;
+}
+
+/**
+ * @brief Gets the number of times the Grid has been built, which changes whenever its cells are replaced.
+ */
+int Fluid::getGridBuilds() const {
+	return m_gridBuilds;
+}
+
+/**
+ * @brief Gets the number of times the Star has been put in a cell, which changes whenever the causal order is rebuilt.
+ */
+int Fluid::getStarPlacements() const {
+	return m_starPlacements;
+}
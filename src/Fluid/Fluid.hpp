@@ -12,7 +12,11 @@
 #define FLUID_HPP_
 
 #include <memory>
+#include <vector>
 
+#include "MPI/MPI_Wrapper.hpp"
+#include "Misc/Parallel.hpp"
+#include "Misc/Profiler.hpp"
 #include "Torch/Common.hpp"
 #include "Torch/Parameters.hpp"
 #include "Grid.hpp"
@@ -20,6 +24,22 @@
 
 class Constants;
 
+/**
+ * @class RaySource
+ *
+ * @brief An ionising source besides the Star, with the causal order it is ray traced in.
+ *
+ * Only the order is stored, the ray geometry of each cell is recomputed as it is traced so that a source costs a cell ID
+ * per cell rather than a copy of RayGeometry.
+ *
+ * @see Radiation
+ */
+class RaySource {
+public:
+	Star star; //!< Position, photon rate and location relative to this processor's part of the Grid (it has no wind).
+	std::vector<RayTile> tiles; //!< The core cells in causal order with respect to the source, split into RayTiles.
+};
+
 /**
  * @class Fluid
  *
@@ -36,30 +56,62 @@ public:
 	// Initialisers.
 	void initialise(std::shared_ptr<Constants> c, FluidParameters fp);
 	void initialiseGrid(GridParameters gp, StarParameters sp);
+	void repartitionGrid(const std::vector<int>& xEdges);
+	void storeGravity(bool on);
+	void initialiseHeatCapacityRatios();
+	bool moveStar(double time);
+	void setStarRates(double photonRate, double massLossRate);
+	void setStarPosition(const std::array<int, 3>& position);
+	void coarsenGrid(const Fluid& fine, int factor);
+	void coarsenStar(const Fluid& fine, int factor);
 
 	// Updaters.
 	void advSolution(const double dt);
 	void fixSolution();
 	void fixPrimitives();
+	void updatePrimitives();
+	void advanceAndFix(const double dt);
+	Parallel::Extremum advanceAndFix(const double dt, const RayTile& tile);
+	void finishTileUpdates(const Parallel::Extremum& fastestCell);
+	void predictPrimitives(const double dt);
 
 	// Getters/Setters.
 	Grid& getGrid();
 	const Grid& getGrid() const;
 	Star& getStar();
 	const Star& getStar() const;
+	const std::vector<RaySource>& getSources() const;
+	bool hasUniformGamma() const;
+	int getGridBuilds() const;
+	int getStarPlacements() const;
 
 	// Conversion Methods.
 	void globalWfromU();
 	void globalUfromW();
+	void blendWithW(double weight);
+	void saveConserved();
+	void restoreConserved();
 	void globalQfromU();
 	void globalUfromQ();
 
 	// Calculations.
 	double calcTemperature(double hii, double pre, double den) const;
-	double calcSoundSpeed(double gamma, double pre, double den);
-	double max(UID::ID id) const;
-	double maxTemperature() const;
-	double minTemperature() const;
+	double calcSoundSpeed(double gamma, double pre, double den) const;
+	double signalRate(const GridCell& cell, double soundSpeed) const;
+	double getMaxSignalRate() const;
+	int getMaxSignalCell() const;
+
+	// Validation.
+	int countInvalidCells() const;
+	bool isValid(const GridCell& cell) const;
+
+	// Ray tracing.
+	template <class Unpack, class Trace, class Pack>
+	void sweepRayTiles(SendID tag, Unpack unpack, Trace trace, Pack pack);
+	template <class Unpack, class Trace, class Pack>
+	void sweepRayTiles(const Star& source, const std::vector<RayTile>& tiles, SendID tag, Unpack unpack, Trace trace, Pack pack);
+	template <class Unpack, class Trace, class Pack, class Finish>
+	void sweepRayTiles(const Star& source, const std::vector<RayTile>& tiles, SendID tag, Unpack unpack, Trace trace, Pack pack, Finish finish);
 
 	double heatCapacityRatio = 0;
 	double massFractionH = 1.0; //!< Global mass fraction of hydrogen.
@@ -67,6 +119,114 @@ private:
 	std::shared_ptr<Constants> consts = nullptr;
 	Grid grid;
 	Star star;
+	std::vector<RaySource> m_sources; //!< Ionising sources besides the Star.
+	GridParameters m_gridParameters; //!< Parameters the Grid was last initialised with.
+	StarParameters m_starParameters; //!< Parameters the Star was last initialised with.
+	int m_gridBuilds = 0; //!< Number of times the Grid has been built (see initialiseGrid).
+	int m_starPlacements = 0; //!< Number of times the Star has been put in a cell (see placeStar).
+	Parallel::Extremum m_fastestCell = Parallel::Extremum{0, -1}; //!< Largest signalRate of this processor's cells at the last fixPrimitives, updatePrimitives or advanceAndFix, and its cell.
+	std::vector<FluidArray> m_savedU; //!< Conserved variables of each core cell at the last saveConserved, indexed by GridCell::id.
+	bool m_primitivesCurrent = false; //!< Whether GridCell::Q, the sound speeds and m_fastestCell are up to date with GridCell::U (see updatePrimitives).
+	bool m_uniformGamma = false; //!< Whether every cell's GridCell::heatCapacityRatio is heatCapacityRatio (see initialiseHeatCapacityRatios).
+	double m_gammaMinusOne = 0; //!< heatCapacityRatio - 1, while the heat capacity ratio is uniform.
+	double m_invGammaMinusOne = 0; //!< 1/(heatCapacityRatio - 1), while the heat capacity ratio is uniform.
+
+	void placeStar(const StarParameters& sp);
+	Star::Locations containingCore(const std::array<int, 3>& position) const;
+	template <bool UNIFORM_GAMMA> void fixConserved(GridCell& cell, FluidArray& U);
+	template <bool UNIFORM_GAMMA> void updatePrimitivesKernel();
+	template <bool UNIFORM_GAMMA> void advanceAndFixKernel(const double dt);
+	template <bool UNIFORM_GAMMA> Parallel::Extremum advanceAndFixKernel(const double dt, const RayTile& tile);
+	template <bool UNIFORM_GAMMA> void predictPrimitivesKernel(const double dt);
+	void fixPrimitives(GridCell& cell);
+	void countFloor(const GridCell& cell, WID::ID floor);
+	template <bool UNIFORM_GAMMA> double cacheSoundSpeed(GridCell& cell, FieldLooper& fields) const;
 };
 
+/**
+ * @brief Ray traces the Grid from the Star one RayTile at a time, pipelining the column densities between processors.
+ *
+ * Before a tile is traced its ghost cells on every boundary facing the star are filled from the processor there. Once it
+ * has been traced the column densities of the cells next to every boundary facing away from the star are posted to the
+ * processor there without waiting, so processors further from the star can start on a tile while this one moves on to the
+ * next. Every message is tagged with the index of its tile, which wraps around on grids with more tiles than the MPI
+ * tags hold (see MPIW::messageTag), the tiles being received in the order they are sent.
+ * @param tag Message identification tag.
+ * @param unpack Called as unpack(GridCell& ghost, PartitionManager& partition) to read a ghost cell's column densities.
+ * @param trace Called as trace(const RayTile& tile) to ray trace the cells of a tile.
+ * @param pack Called as pack(const GridCell& cell, PartitionManager& partition) to add a cell's column densities.
+ */
+template <class Unpack, class Trace, class Pack>
+void Fluid::sweepRayTiles(SendID tag, Unpack unpack, Trace trace, Pack pack) {
+	sweepRayTiles(star, grid.getRayTiles(), tag, unpack, trace, pack);
+}
+
+/**
+ * @brief Ray traces the Grid from any source (the Star or a RaySource) one of its RayTiles at a time, as above.
+ * @param source The source, which decides the boundaries the column densities are received across and sent across.
+ * @param tiles The source's tiles.
+ */
+template <class Unpack, class Trace, class Pack>
+void Fluid::sweepRayTiles(const Star& source, const std::vector<RayTile>& tiles, SendID tag, Unpack unpack, Trace trace, Pack pack) {
+	sweepRayTiles(source, tiles, tag, unpack, trace, pack, [](const RayTile&) {});
+}
+
+/**
+ * @brief Ray traces the Grid from a source one of its RayTiles at a time, as above, finishing each tile once its column
+ * densities have been posted.
+ *
+ * The finishing work of a tile overlaps with the tracing of the tiles further from the source on this and the
+ * downstream processors, and fills the time this processor would otherwise spend waiting for its next tile. It must not
+ * change anything the tracing of a later tile reads.
+ * @param finish Called as finish(const RayTile& tile) after the column densities of a tile have been sent.
+ */
+template <class Unpack, class Trace, class Pack, class Finish>
+void Fluid::sweepRayTiles(const Star& source, const std::vector<RayTile>& tiles, SendID tag, Unpack unpack, Trace trace, Pack pack, Finish finish) {
+	std::vector<Bound>& boundaries = grid.getBoundaries();
+	for (Bound& boundary : boundaries)
+		if (source.isDownstream(boundary))
+			boundary.partition.resetBuffer();
+
+	for (unsigned int itile = 0; itile < tiles.size(); ++itile) {
+		const RayTile& tile = tiles[itile];
+		for (unsigned int ib = 0; ib < boundaries.size(); ++ib) {
+			Bound& boundary = boundaries[ib];
+			if (!source.isUpstream(boundary))
+				continue;
+			ScopedTimer timer(ProfileID::RAY_RECV);
+			if (boundary.partition.hasRelay())
+				boundary.partition.getRelayData(itile);
+			else
+				boundary.partition.recvData(boundary.targetProcessor, tag, itile);
+			for (int ghostID : tile.ghostIDs[ib])
+				unpack(grid.getCell(ghostID), boundary.partition);
+		}
+
+		{
+			ScopedTimer timer(ProfileID::RAY_TILE, tile.windIDs.size() + tile.nonWindIDs.size());
+			trace(tile);
+		}
+
+		for (unsigned int ib = 0; ib < boundaries.size(); ++ib) {
+			Bound& boundary = boundaries[ib];
+			if (!source.isDownstream(boundary))
+				continue;
+			int dim = boundary.face%3;
+			for (int ghostID : tile.ghostIDs[ib])
+				pack(grid.getCell(boundary.face < 3 ? grid.right(dim, ghostID) : grid.left(dim, ghostID)), boundary.partition);
+			if (boundary.partition.hasRelay())
+				boundary.partition.putRelayData(boundary.targetProcessor, itile);
+			else
+				boundary.partition.postSendData(boundary.targetProcessor, tag, itile);
+		}
+		finish(tile);
+		MPIW::Instance().progress();
+	}
+	for (Bound& boundary : boundaries)
+		if (source.isUpstream(boundary) && boundary.partition.hasRelay())
+			boundary.partition.finishRelay(boundary.targetProcessor);
+	ScopedTimer timer(ProfileID::RAY_SEND_WAIT);
+	MPIW::Instance().waitAll();
+}
+
 #endif // FLUID_HPP_
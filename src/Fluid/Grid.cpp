@@ -1,12 +1,19 @@
 #include "Grid.hpp"
 
-#include "IO/ProgressBar.hpp"
 #include "IO/Logger.hpp"
+#include "Misc/Parallel.hpp"
+#include "Misc/Profiler.hpp"
 
 #include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <sstream>
+
+#include <unistd.h>
 
 
 static int safe_round(double val) {
@@ -33,67 +40,157 @@ const GridCell& Grid::getCell(int id) const {
 	return m_cells[id];
 }
 
-Looper Grid::getIterable(const std::string& name) {
-	return m_cellCollection.getIterable(name);
+RayGeometry& Grid::getRayGeometry(int id) {
+	return m_cellCollection.getRayGeometry(id);
+}
+
+const RayGeometry& Grid::getRayGeometry(int id) const {
+	return m_cellCollection.getRayGeometry(id);
+}
+
+HeatArray& Grid::getHeating(int id) {
+	return m_cellCollection.getHeating(id);
+}
+
+const HeatArray& Grid::getHeating(int id) const {
+	return m_cellCollection.getHeating(id);
+}
+
+/**
+ * @brief Whether the cells store their ray geometry and heating rates (see GridParameters::rayData), so getRayGeometry and
+ * the non-const getHeating may be called.
+ */
+bool Grid::storesRayData() const {
+	return m_cellCollection.storesRayData();
+}
+
+/**
+ * @brief Whether the cells count their work (see Integration.work_counters), so getWork may be called.
+ */
+bool Grid::countsWork() const {
+	return m_cellCollection.countsWork();
+}
+
+WorkArray& Grid::getWork(int id) {
+	return m_cellCollection.getWork(id);
+}
+
+const WorkArray& Grid::getWork(int id) const {
+	return m_cellCollection.getWork(id);
+}
+
+/**
+ * @brief Zeroes the work counters of every cell, e.g. once they have been written at a checkpoint.
+ */
+void Grid::resetWork() {
+	m_cellCollection.resetWork();
+}
+
+/**
+ * @brief Turns the stored gravitational force densities of the cells on (zeroed) or off (freed), e.g. once the setup's
+ * field turns out to be zero everywhere.
+ */
+void Grid::storeGravity(bool on) {
+	m_cellCollection.storeGravity(on);
+}
+
+/**
+ * @brief Whether the cells store their gravitational force density (see GridParameters::gravityField), so getGravity
+ * may be called.
+ */
+bool Grid::storesGravity() const {
+	return m_cellCollection.storesGravity();
 }
 
-ConstLooper Grid::getIterable(const std::string& name) const {
-	return m_cellCollection.getIterable(name);
+GravArray& Grid::getGravity(int id) {
+	return m_cellCollection.getGravity(id);
 }
 
-int Grid::getLeftX() const {
-	return m_leftX;
+const GravArray& Grid::getGravity(int id) const {
+	return m_cellCollection.getGravity(id);
 }
 
-int Grid::getRightX() const {
-	return m_rightX;
+Looper Grid::getIterable(CellRange range) {
+	return m_cellCollection.getIterable(range);
 }
 
-void Grid::setLeftX(int x) {
-	m_leftX = x;
+ConstLooper Grid::getIterable(CellRange range) const {
+	return m_cellCollection.getIterable(range);
 }
 
-void Grid::setRightX(int x) {
-	m_rightX = x;
+FieldLooper Grid::getFieldIterable(CellRange range) {
+	return m_cellCollection.getFieldIterable(range);
 }
 
-std::vector<GridCell>& Grid::getCells() {
+ConstFieldLooper Grid::getFieldIterable(CellRange range) const {
+	return m_cellCollection.getFieldIterable(range);
+}
+
+GridCellCollection& Grid::getCellCollection() {
+	return m_cellCollection;
+}
+
+GridCellVector& Grid::getCells() {
 	return m_cells;
 }
 
-std::vector<GridJoin>& Grid::getJoins(int dim) {
+GridJoinVector& Grid::getJoins(int dim) {
 	return m_joins[dim];
 }
 
-const std::vector<GridCell>& Grid::getCells() const {
+const GridCellVector& Grid::getCells() const {
 	return m_cells;
 }
 
-const std::vector<GridJoin>& Grid::getJoins(int dim) const {
+const GridJoinVector& Grid::getJoins(int dim) const {
 	return m_joins[dim];
 }
 
-PartitionManager& Grid::getPartitionManager() {
-	return partition;
+/**
+ * @brief IDs of the core cells in the order of their grid coordinates, x fastest, whatever order they are stored in
+ * (see flatIndex). Output and sums over the cells go through them so that neither depends on the brick_size.
+ */
+const std::vector<int>& Grid::getLexicographicIDs() const {
+	return m_lexicographicIDs;
 }
 
 std::vector<int>& Grid::getCausalIndices() {
 	return m_causalIndices;
 }
 
-std::vector<int>& Grid::getOrderedIndices(const std::string& name) {
-	if (orderedIndices.find(name) == orderedIndices.end())
-		Logger::Instance().print<SeverityType::WARNING>(name + " not found...\n");
-	return (std::vector<int>&)orderedIndices[name];
+std::vector<int>& Grid::getOrderedIndices(CellOrder order) {
+	return m_orderedIndices[(unsigned int)order];
+}
+
+/**
+ * @brief Checks whether either face of the Grid along a dimension borders another processor.
+ * @param dim Dimension.
+ * @return True if there is a PARTITION boundary along dim.
+ */
+bool Grid::isPartitioned(int dim) const {
+	for (const Bound& boundary : m_boundaries)
+		if (boundary.condition == Condition::PARTITION && boundary.face%3 == dim)
+			return true;
+	return false;
 }
 
 std::vector<Bound>& Grid::getBoundaries() {
 	return m_boundaries;
 }
 
-void Grid::addOrderedIndex(const std::string& name, int index) {
-	std::vector<int>& order = (std::vector<int>&)orderedIndices[name];
-	order.push_back(index);
+std::vector<RayTile>& Grid::getRayTiles() {
+	return m_rayTiles;
+}
+
+/**
+ * @brief Gets the exchange of the hydrodynamic variables of the PARTITION ghost cells, which applyBCs starts.
+ */
+const HaloExchange& Grid::getHydroHalo() const {
+	return m_hydroHalo;
+}
+
+void Grid::addOrderedIndex(CellOrder order, int index) {
+	m_orderedIndices[(unsigned int)order].push_back(index);
 }
 
 bool Grid::cellExists(int id) const {
@@ -152,12 +249,98 @@ GridJoin& Grid::rightJoin(int dim, GridCell& fromCell) {
 	return m_joins[dim][fromCell.rjoinID[dim]];
 }
 
+/**
+ * @brief Fills pencil with the IDs of a line of GridCells along dimension dim, bounded by a ghost cell at each end.
+ *
+ * The core cells of a pencil are found by stride arithmetic on flatIndex (or through flatIndex itself when the cells are
+ * stored in bricks), only the two ghost cells are looked up.
+ * @param dim Dimension along which the pencil runs.
+ * @param j1 Coordinate of the pencil along dimension (dim+1)%3.
+ * @param j2 Coordinate of the pencil along dimension (dim+2)%3.
+ * @param pencil Resized to coreCells[dim] + 2 and filled with GridCell IDs from left to right.
+ * @exception std::runtime_error Thrown if either end of the pencil has no ghost cell.
+ */
+void Grid::getPencil(int dim, int j1, int j2, std::vector<int>& pencil) {
+	getPencil(dim, j1, j2, 0, coreCells[dim], pencil);
+}
+
+/**
+ * @brief Fills pencil with the IDs of the core cells [start, end) of a line along dimension dim, bounded by the cell
+ * (core or ghost) on either side.
+ * @param dim Dimension along which the pencil runs.
+ * @param j1 Coordinate of the pencil along dimension (dim+1)%3.
+ * @param j2 Coordinate of the pencil along dimension (dim+2)%3.
+ * @param start Coordinate along dim of the first core cell, relative to this processor's block.
+ * @param end One past the coordinate of the last core cell.
+ * @param pencil Resized to end - start + 2 and filled with GridCell IDs from left to right.
+ * @exception std::runtime_error Thrown if either end of the pencil has no neighbouring cell.
+ */
+void Grid::getPencil(int dim, int j1, int j2, int start, int end, std::vector<int>& pencil) {
+	Coords c;
+	c[dim] = start;
+	c[(dim + 1)%3] = j1;
+	c[(dim + 2)%3] = j2;
+	const int firstID = flatIndex(c[0], c[1], c[2]);
+	const int stride = (dim == 0) ? 1 : (dim == 1 ? coreCells[0] : coreCells[0]*coreCells[1]);
+	const int n = end - start;
+
+	pencil.resize(n + 2);
+	if (m_brickSize > 0) {
+		for (int ic = 0; ic < n; ++ic) {
+			c[dim] = start + ic;
+			pencil[ic + 1] = flatIndex(c[0], c[1], c[2]);
+		}
+	}
+	else {
+		for (int ic = 0; ic < n; ++ic)
+			pencil[ic + 1] = firstID + ic*stride;
+	}
+	pencil[0] = m_cells[pencil[1]].leftID[dim];
+	pencil[n + 1] = m_cells[pencil[n]].rightID[dim];
+	if (pencil[0] == -1 || pencil[n + 1] == -1)
+		throw std::runtime_error("Grid::getPencil: pencil is not bounded by cells." + m_cells[firstID].printInfo());
+}
+
+/**
+ * @brief ID of the core cell at coordinates (ci, cj, ck) relative to this processor's block.
+ *
+ * The cells are stored x fastest, then y, then z, unless the Grid was initialised with a brick_size. Then the block is
+ * split into bricks of brickSize cells along each side (smaller at the far edges of the block), which are stored one
+ * after the other x fastest, each with its own cells x fastest, so the neighbours of a cell along y and z are near it in
+ * memory too.
+ */
 int Grid::flatIndex(int ci, int cj, int ck) {
-	return ci + coreCells[0]*(cj + coreCells[1]*ck);
+	if (m_brickSize <= 0)
+		return ci + coreCells[0]*(cj + coreCells[1]*ck);
+	const int b = m_brickSize;
+	const int bi = ci/b, bj = cj/b, bk = ck/b;
+	const int ni = std::min(b, coreCells[0] - bi*b), nj = std::min(b, coreCells[1] - bj*b), nk = std::min(b, coreCells[2] - bk*b);
+	const int brickStart = bk*b*coreCells[0]*coreCells[1] + bj*b*coreCells[0]*nk + bi*b*nj*nk;
+	return brickStart + (ci - bi*b) + ni*((cj - bj*b) + nj*(ck - bk*b));
 }
 
+/**
+ * @brief Coordinates, relative to this processor's block, of the core cell with an ID (the inverse of flatIndex).
+ */
 Coords Grid::unflatCoords(int flat_index) {
 	Coords coords;
+	if (m_brickSize > 0) {
+		const int b = m_brickSize;
+		int rest = flat_index;
+		const int bk = rest/(b*coreCells[0]*coreCells[1]);
+		rest -= bk*b*coreCells[0]*coreCells[1];
+		const int nk = std::min(b, coreCells[2] - bk*b);
+		const int bj = rest/(b*coreCells[0]*nk);
+		rest -= bj*b*coreCells[0]*nk;
+		const int nj = std::min(b, coreCells[1] - bj*b);
+		const int bi = rest/(b*nj*nk);
+		rest -= bi*b*nj*nk;
+		const int ni = std::min(b, coreCells[0] - bi*b);
+		coords[0] = bi*b + rest%ni;
+		coords[1] = bj*b + (rest/ni)%nj;
+		coords[2] = bk*b + rest/(ni*nj);
+		return coords;
+	}
 	coords[2] = (int)(0.5 + flat_index/(coreCells[0]*coreCells[1]));
 	coords[1] = (int)(0.5 + (flat_index - coords[2]*coreCells[0]*coreCells[1])/coreCells[0]);
 	coords[0] = flat_index - coreCells[0]*(coords[1] + coreCells[1]*coords[2]);
@@ -212,7 +395,7 @@ int Grid::traverseOverJoins3D(const int d1, const int d2, const int d3, const in
 int Grid::nextCell2D(const int plane, int fromCellID) {
 	int id = fromCellID;
 	Coords coords = unflatCoords(id);
-	if ((int)(m_cells[id].xc[(plane+2)%3]+1)%2 != 0) {
+	if (coords[(plane+2)%3]%2 == 0) {
 		if (coords[(plane+1)%3] != coreCells[(plane+1)%3] - 1)
 			id = traverse1D((plane+1)%3, 1, fromCellID);
 		else
@@ -240,121 +423,39 @@ int Grid::nextSnake(int fromCellID, int sourceCellID, const int dxc, const int d
 	return id;
 }
 
+/**
+ * @brief Finds the GridCell simulated by this processing core at the given grid coordinates.
+ * @return ID of the GridCell or -1 if it is not on this core.
+ */
 int Grid::locate(int cx, int cy, int cz) {
-	int cx_mod = cx - getLeftX();
-
-	if (cx_mod >= getLeftX() && cx_mod < getRightX() && cy >= 0 && cy < coreCells[1] && cz >= 0 && cz < coreCells[2])
-		return flatIndex(cx_mod, cy, cz);
-	else
+	Coords c;
+	c[0] = cx;
+	c[1] = cy;
+	c[2] = cz;
+	if (!withinGrid(c))
 		return -1;
+	return flatIndex(cx - coreOffset[0], cy - coreOffset[1], cz - coreOffset[2]);
 }
 
 Coords Grid::nearestCoord(const Coords& original) {
 	Coords nearest = original;
-	nearest[0] = std::min(std::max(getLeftX(), nearest[0]), getRightX() - 1);
-	nearest[1] = std::min(std::max(0, nearest[1]), coreCells[1] - 1);
-	nearest[2] = std::min(std::max(0, nearest[2]), coreCells[2] - 1);
+	for (int i = 0; i < 3; ++i)
+		nearest[i] = std::min(std::max(coreOffset[i], nearest[i]), coreOffset[i] + coreCells[i] - 1);
 	return nearest;
 }
 
 bool Grid::withinGrid(const Coords& coords) {
-	return coords[0] >= getLeftX() && coords[0] < getRightX() && coords[1] >= 0 && coords[1] < coreCells[1] && coords[2] >= 0 && coords[2] < coreCells[2];
+	for (int i = 0; i < 3; ++i) {
+		if (coords[i] < coreOffset[i] || coords[i] >= coreOffset[i] + coreCells[i])
+			return false;
+	}
+	return true;
 }
 
 bool Grid::joinExists(int dim, std::array<int, 3>& joinIDs) {
 	return joinIDs[dim] >= 0 && joinIDs[dim] < (int)m_joins[dim].size();
 }
 
-Coords Grid::nextSnakeCoords(const Coords& fromCoords, const Coords& sourceCoords, const int dxc, const int dyc, const int dzc) {
-	Coords nextCoords;
-	if (fromCoords[0] + dxc >= getLeftX() && fromCoords[0] + dxc < getRightX()) {
-		nextCoords[0] = fromCoords[0] + dxc;
-		nextCoords[1] = fromCoords[1];
-		nextCoords[2] = fromCoords[2];
-	}
-	else if (fromCoords[1] + dyc >= 0 && fromCoords[1] + dyc < coreCells[1]) {
-		nextCoords[0] = sourceCoords[0];
-		nextCoords[1] = fromCoords[1] + dyc;
-		nextCoords[2] = fromCoords[2];
-	}
-	else if (fromCoords[2] + dzc >= 0 && fromCoords[2] + dzc < coreCells[2]) {
-		nextCoords[0] = sourceCoords[0];
-		nextCoords[1] = sourceCoords[1];
-		nextCoords[2] = fromCoords[2] + dzc;
-	}
-	else {
-		nextCoords[0] = -1;
-		nextCoords[1] = -1;
-		nextCoords[2] = -1;
-	}
-
-	return nextCoords;
-}
-
-Coords Grid::nextCausalCoords(const Coords& fromCoords, const Coords& sourceCoords) {
-	int dir[3] = {0,0,0};
-	for (int i = 0; i < 3; ++i){
-		if (fromCoords[i] != sourceCoords[i])
-			dir[i] = (fromCoords[i]-sourceCoords[i])/std::fabs(fromCoords[i]-sourceCoords[i]);
-		else
-			dir[i] = 1;
-	}
-	Coords beginCoords = sourceCoords;
-	for (int i = 0; i < 3; ++i) {
-		if (dir[i] < 0)
-			beginCoords[i] -= 1;
-	}
-
-	Coords nextCoords = nextSnakeCoords(fromCoords, beginCoords, dir[0], dir[1], dir[2]);
-
-	if (!withinGrid(nextCoords) && dir[0] == 1 && dir[1] == 1 && dir[2] == 1) {
-		nextCoords = sourceCoords;
-		nextCoords[0] -= 1;
-		dir[0] = -1;
-	}
-	if (!withinGrid(nextCoords) && dir[0] == -1 && dir[1] == 1 && dir[2] == 1 && m_consts->nd > 1) {
-		nextCoords = sourceCoords;
-		nextCoords[1] -= 1;
-		dir[0] = 1;
-		dir[1] = -1;
-	}
-	if (!withinGrid(nextCoords) && dir[0] == 1 && dir[1] == -1 && dir[2] == 1 && m_consts->nd > 1) {
-		nextCoords = sourceCoords;
-		nextCoords[0] -= 1;
-		nextCoords[1] -= 1;
-		dir[0] = -1;
-	}
-	if (!withinGrid(nextCoords) && dir[0] == -1 && dir[1] == -1 && dir[2] == 1 && m_consts->nd > 2) {
-		nextCoords = sourceCoords;
-		nextCoords[2] -= 1;
-		dir[0] = 1;
-		dir[1] = 1;
-		dir[2] = -1;
-	}
-	if (!withinGrid(nextCoords) && dir[0] == 1 && dir[1] == 1 && dir[2] == -1 && m_consts->nd > 2) {
-		nextCoords = sourceCoords;
-		nextCoords[0] -= 1;
-		nextCoords[2] -= 1;
-		dir[0] = -1;
-	}
-	if (!withinGrid(nextCoords) && dir[0] == -1 && dir[1] == 1 && dir[2] == -1 && m_consts->nd > 2) {
-		nextCoords = sourceCoords;
-		nextCoords[1] -= 1;
-		nextCoords[2] -= 1;
-		dir[0] = 1;
-		dir[1] = -1;
-	}
-	if (!withinGrid(nextCoords) && dir[0] == 1 && dir[1] == -1 && dir[2] == -1 && m_consts->nd > 2) {
-		nextCoords = sourceCoords;
-		nextCoords[0] -= 1;
-		nextCoords[1] -= 1;
-		nextCoords[2] -= 1;
-		dir[0] = -1;
-	}
-
-	return nextCoords;
-}
-
 int Grid::nextCausal(int fromCellID, int sourceCellID, int nd) {
 	int dir[3] = {0,0,0};
 	for (int i = 0; i < 3; ++i){
@@ -426,11 +527,6 @@ void Grid::weakLink(const int dim, int lcellID, int rcellID) {
 
 		join.rcellID = rcellID;
 		join.lcellID = lcellID;
-
-		for (int i = 0; i < 3; ++i)
-			join.xj[i] = m_cells[join.rcellID].xc[i];
-		join.xj[dim] = m_cells[join.rcellID].xc[dim] - 0.5;
-		join.area = computeJoinArea(join.xj, dim, dx, geometry, m_consts->nd);
 	}
 }
 
@@ -458,11 +554,153 @@ static int calcLeftBoundaryPosition(int nx, int nproc, int iproc) {
 	return start_xc;
 }
 
+/**
+ * @brief Left edges of x slabs whose widths grow geometrically with their distance, in slabs, from the slab holding the
+ * star, from the star's slab to ratio times as wide for the slab furthest from it, then nx.
+ *
+ * The column densities are relayed outwards from the star's slab one slab after another, so narrow slabs near the star
+ * shorten the first, serial legs of the relay, and wide ones further out take the cells the near ones give up. The
+ * star's slab is the one whose place among the slabs best matches the star's place along x, and is centred on the star
+ * as far as the grid allows, the slabs either side sharing out the rest of their side of the grid.
+ * @param nx Number of cells along x.
+ * @param nslabs Number of slabs.
+ * @param starColumn Grid coordinate of the star along x.
+ * @param ratio Width of the furthest slab over that of the star's slab.
+ * @param minWidth Fewest columns a slab may have (the depth of the ghost cells).
+ * @return The edges, or nothing if nx is too small for slabs of minWidth.
+ */
+static std::vector<int> starSlabEdges(int nx, int nslabs, int starColumn, double ratio, int minWidth) {
+	if (nx < nslabs*minWidth)
+		return std::vector<int>();
+	int star = 0;
+	std::vector<double> total;
+	double bestMismatch = std::numeric_limits<double>::max();
+	for (int islab = 0; islab < nslabs; ++islab) {
+		const int far = std::max(islab, nslabs - 1 - islab);
+		std::vector<double> sums(nslabs + 1, 0);
+		for (int k = 0; k < nslabs; ++k)
+			sums[k + 1] = sums[k] + (far > 0 ? std::pow(ratio, std::abs(k - islab)/(double)far) : 1.0);
+		const double mismatch = std::abs((sums[islab] + sums[islab + 1])/(2*sums[nslabs]) - (starColumn + 0.5)/nx);
+		if (mismatch < bestMismatch) {
+			bestMismatch = mismatch;
+			star = islab;
+			total = sums;
+		}
+	}
+
+	const double width = nx*(total[star + 1] - total[star])/total[nslabs];
+	double left = (star == 0) ? 0 : (star == nslabs - 1 ? nx - width : starColumn + 0.5 - 0.5*width);
+	left = std::min(std::max(left, 0.0), nx - width);
+	std::vector<int> edges(nslabs + 1, 0);
+	edges[nslabs] = nx;
+	for (int islab = 1; islab < nslabs; ++islab) {
+		double edge;
+		if (islab <= star)
+			edge = left*total[islab]/total[star];
+		else
+			edge = left + width + (nx - left - width)*(total[islab] - total[star + 1])/(total[nslabs] - total[star + 1]);
+		edges[islab] = std::min(std::max((int)std::lround(edge), edges[islab - 1] + minWidth), nx - (nslabs - islab)*minWidth);
+	}
+	return edges;
+}
+
+/**
+ * @brief Memory this node could still give to a program, in bytes: MemAvailable of /proc/meminfo, or the free physical
+ * pages where there is no such entry.
+ */
+static double availableNodeMemory() {
+	std::ifstream meminfo("/proc/meminfo");
+	std::string key;
+	double kB;
+	while (meminfo >> key >> kB) {
+		if (key == "MemAvailable:")
+			return kB*1024.0;
+		meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+	}
+	return (double)sysconf(_SC_AVPHYS_PAGES)*(double)sysconf(_SC_PAGE_SIZE);
+}
+
+/**
+ * @brief Estimates the memory this processor's part of the Grid will take before any of it is allocated, logs the
+ * breakdown of the processor that needs most and checks that it fits in the memory available to each processor of a
+ * node. Collective.
+ * @param ncore Number of core cells of this processor.
+ * @param nghost Number of ghost cells of this processor.
+ * @param gp The GridParameters.
+ * @exception std::runtime_error Thrown if gp.memoryCheck is set and a processor needs more memory than it has.
+ */
+void Grid::checkMemory(int ncore, int nghost, const GridParameters& gp) const {
+	MPIW& mpihandler = MPIW::Instance();
+	const std::array<int, 3>& nprocs = mpihandler.getDims();
+	const double ncells = ncore + nghost;
+	const double dbl = sizeof(double);
+
+	// PARTITION faces carry the ray tracing buffers and, unless the halo is sent through datatypes, the halo buffers.
+	double partitionCells = 0;
+	for (int dim = 0; dim < m_consts->nd; ++dim)
+		if (nprocs[dim] > 1)
+			partitionCells += 2.0*(ncore/coreCells[dim]);
+	double partitionValues = 2*(spatialOrder + 1)*(UID::N + 1);
+	if (gp.haloSinglePrecision)
+		partitionValues += (spatialOrder + 1)*(UID::N + 2);
+	else if (!gp.haloDatatypes)
+		partitionValues += 2*(spatialOrder + 1)*(UID::N + 1);
+
+	double joins = 0;
+	for (int dim = 0; dim < m_consts->nd; ++dim)
+		joins += ncore + ncore/coreCells[dim];
+
+	const std::vector<std::string> names = {"cells", "joins", "ray geometry", "field arrays", "flux coefficients", "partition buffers", "output staging"};
+	std::vector<double> bytes = {
+		ncells*sizeof(GridCell),
+		joins*sizeof(GridJoin),
+		ncells*((gp.rayData ? sizeof(RayGeometry) + sizeof(HeatArray) : 0) + (gp.workCounters ? sizeof(WorkArray) : 0) +
+				(gp.gravityField ? sizeof(GravArray) : 0)),
+		ncells*(3*UID::N + 3)*dbl,
+		ncells*(2*sizeof(Vec3) + dbl) + ncore*3*sizeof(int),
+		partitionCells*partitionValues*dbl,
+		ncore*(UID::N + RID::N + TID::N + 3)*dbl
+	};
+	double total = 0;
+	for (double b : bytes)
+		total += b;
+
+	// Every processor of a node shares its memory.
+	double available = availableNodeMemory()/mpihandler.nodeSize();
+	available = mpihandler.minimum(available);
+	double largest = total;
+	largest = mpihandler.maximum(largest);
+	double sum = total;
+	sum = mpihandler.sum(sum);
+
+	// Report the breakdown of the processor that needs most.
+	std::vector<double> breakdown(bytes.size(), 0);
+	if (total == largest)
+		breakdown = bytes;
+	breakdown = mpihandler.maximum(breakdown);
+	std::ostringstream report;
+	report << std::fixed << std::setprecision(1);
+	report << "Grid::checkMemory: " << sum/1048576.0 << " MB over " << mpihandler.nProcessors() << " processors, at most ";
+	report << largest/1048576.0 << " MB each (";
+	for (std::size_t i = 0; i < names.size(); ++i)
+		report << (i > 0 ? ", " : "") << names[i] << " " << breakdown[i]/1048576.0;
+	report << ") of " << available/1048576.0 << " MB available to each.\n";
+	Logger::Instance().print<SeverityType::NOTICE>(report.str());
+
+	if (largest > available) {
+		const int suggested = (int)std::ceil(sum/available);
+		const std::string message = "Grid::checkMemory: a processor needs " + std::to_string((long long)(largest/1048576.0)) +
+				" MB but only " + std::to_string((long long)(available/1048576.0)) + " MB is available to each; try at least " +
+				std::to_string(suggested) + " processors over " + std::to_string(mpihandler.nNodes()) + " or more nodes, or set memory_check to false.";
+		if (gp.memoryCheck)
+			throw std::runtime_error(message);
+		Logger::Instance().print<SeverityType::WARNING>(message, "\n");
+	}
+}
+
 void Grid::initialise(std::shared_ptr<Constants> consts, const GridParameters& gp) {
 	m_consts = std::move(consts);
 	MPIW& mpihandler = MPIW::Instance();
-	int rproc = mpihandler.getRank();
-	int nproc = mpihandler.nProcessors();
 
 	ncells = gp.ncells;
 	sideLength = gp.sideLength;
@@ -471,24 +709,6 @@ void Grid::initialise(std::shared_ptr<Constants> consts, const GridParameters& g
 	for (int i = 0; i < m_consts->nd; ++i)
 		dx[i] = gp.sideLength/(double)gp.ncells[0];
 
-	coreCells = gp.ncells;
-	coreCells[0] = calcCoreCells(gp.ncells[0], nproc, rproc);
-	if (coreCells[0] == 0) {
-		throw std::runtime_error("Grid::initialise: zero cells in processor (" +  std::to_string(mpihandler.getRank()) + ").");
-	}
-
-	// Set Grid wall locations.
-	setLeftX(calcLeftBoundaryPosition(ncells[0], nproc, rproc));
-	setRightX(getLeftX()+coreCells[0]);
-
-	m_cellCollection.start("AllCells");
-	m_cellCollection.start("GridCells");
-	buildCells();
-	m_cellCollection.stop("GridCells");
-
-	for (GridCell& cell : m_cells)
-		cell.vol = computeCellVolume(cell.xc[0], dx, geometry, m_consts->nd);
-
 	// Parse boundary condition into enum.
 	std::pair<std::array<Condition, 3>, std::array<Condition, 3>> leftRightBC;
 	for (int i = 0; i < 3; ++i) {
@@ -496,119 +716,489 @@ void Grid::initialise(std::shared_ptr<Constants> consts, const GridParameters& g
 		leftRightBC.second[i] = m_consts->conditionParser.parseEnum(gp.rightBC[i]);
 	}
 
-	// Initialise partition manager.
-	if (mpihandler.nproc > 1)
-		partition.initialise(coreCells[1]*coreCells[2]*(spatialOrder+1)*(UID::N + 1));
+	// Split the grid into blocks over a Cartesian topology of processors.
+	std::array<int, 3> nprocs = gp.nprocs;
+	std::array<bool, 3> periodic;
+	for (int i = 0; i < 3; ++i) {
+		if (i >= m_consts->nd) {
+			if (nprocs[i] > 1)
+				throw std::runtime_error("Grid::initialise: cannot split the grid along unused dimension " + std::to_string(i) + ".");
+			nprocs[i] = 1;
+		}
+		periodic[i] = leftRightBC.first[i] == Condition::PERIODIC && leftRightBC.second[i] == Condition::PERIODIC;
+	}
+	mpihandler.createCartesian(nprocs, periodic);
+	const std::array<int, 3>& coords = mpihandler.getCoords();
+
+	for (int i = 0; i < 3; ++i) {
+		coreCells[i] = calcCoreCells(gp.ncells[i], nprocs[i], coords[i]);
+		coreOffset[i] = calcLeftBoundaryPosition(gp.ncells[i], nprocs[i], coords[i]);
+	}
+	if (!(gp.starSlabRatio > 0))
+		throw std::runtime_error("Grid::initialise: star_slab_ratio(=" + std::to_string(gp.starSlabRatio) + ") must be positive.");
+	xEdges = gp.xEdges;
+	if (xEdges.empty() && gp.starSlabRatio != 1 && gp.starColumn >= 0 && nprocs[0] > 1)
+	{
+		xEdges = starSlabEdges(gp.ncells[0], nprocs[0], gp.starColumn, gp.starSlabRatio, spatialOrder + 1);
+		std::stringstream msg;
+		msg << "Grid::initialise: x slabs of widths";
+		for (unsigned int i = 0; i + 1 < xEdges.size(); ++i)
+			msg << (i == 0 ? " " : ", ") << xEdges[i + 1] - xEdges[i];
+		msg << " around the star's column " << gp.starColumn << ".\n";
+		Logger::Instance().print<SeverityType::NOTICE>(msg.str());
+	}
+	if (!xEdges.empty()) {
+		if ((int)xEdges.size() != nprocs[0] + 1 || xEdges.front() != 0 || xEdges.back() != gp.ncells[0])
+			throw std::runtime_error("Grid::initialise: the x edges of the processor blocks do not span the grid.");
+		coreOffset[0] = xEdges[coords[0]];
+		coreCells[0] = xEdges[coords[0] + 1] - xEdges[coords[0]];
+	}
+	for (int i = 0; i < 3; ++i) {
+		if (coreCells[i] <= 0)
+			throw std::runtime_error("Grid::initialise: zero cells in processor (" +  std::to_string(mpihandler.getRank()) + ").");
+	}
+	columnWork.assign(coreCells[0], 0);
+
+	// Reserve room for the ghost cells too, so that none of the cells move once they are linked.
+	const int ncore = coreCells[0]*coreCells[1]*coreCells[2];
+	int nghost = 0;
+	for (int dim = 0; dim < m_consts->nd; ++dim)
+		nghost += 2*(ncore/coreCells[dim])*(spatialOrder + 1);
+	if (gp.brickSize < 0)
+		throw std::runtime_error("Grid::initialise: brick_size(=" + std::to_string(gp.brickSize) + ") must not be negative.");
+	m_brickSize = gp.brickSize;
+	m_cellCollection.storeRayData(gp.rayData);
+	m_cellCollection.countWork(gp.workCounters);
+	m_cellCollection.storeGravity(gp.gravityField);
+	FirstTouch::hugePages() = gp.hugePages;
+	checkMemory(ncore, nghost, gp);
+	m_cellCollection.reserve(ncore + nghost);
+
+	m_cellCollection.start(CellRange::ALL_CELLS);
+	m_cellCollection.start(CellRange::GRID_CELLS);
+	buildCells();
+	m_cellCollection.stop(CellRange::GRID_CELLS);
 
 	// Build the boundaries.
 	buildBoundaries(leftRightBC.first, leftRightBC.second);
 
 	// Link the boundaries to the Grid.
-	m_cellCollection.start("GhostCells");
+	m_cellCollection.start(CellRange::GHOST_CELLS);
 	for (unsigned int dim = 0; dim < m_boundaries.size() / 2; ++dim) {
-		m_cellCollection.start("GhostCells"+std::to_string(dim));
+		m_cellCollection.start(ghostCellRange(dim));
 		boundaryLink(m_boundaries[2*dim + 0]);
 		boundaryLink(m_boundaries[2*dim + 1]);
-		m_cellCollection.stop("GhostCells"+std::to_string(dim));
-	}
-	m_cellCollection.stop("GhostCells");
-	m_cellCollection.stop("AllCells");
-	m_cellCollection.start("DeepGhostCells");
-	MPIW::Instance().barrier();
-	MPIW::Instance().serial([&] () {
-		for (Bound& boundary : m_boundaries)
-			boundaryLinkDeeper(boundary);
-	});
-	m_cellCollection.stop("DeepGhostCells");
+		m_cellCollection.stop(ghostCellRange(dim));
+	}
+	m_cellCollection.stop(CellRange::GHOST_CELLS);
+	m_cellCollection.stop(CellRange::ALL_CELLS);
+	m_cellCollection.start(CellRange::DEEP_GHOST_CELLS);
+	for (Bound& boundary : m_boundaries)
+		boundaryLinkDeeper(boundary);
+	m_cellCollection.stop(CellRange::DEEP_GHOST_CELLS);
+
+	buildBoundarySlabs();
+	buildHaloExchange(gp.haloDatatypes, gp.haloCollective, gp.haloSinglePrecision);
+	if (gp.haloSinglePrecision && gp.haloPrecisionCheck)
+		m_hydroHalo.checkPrecision();
+	buildFluxCoefficients();
 }
 
-void Grid::buildCells() {
-	int proc_rank = MPIW::Instance().getRank();
+/**
+ * @brief Precomputes the face area over volume coefficients of the flux divergence and the radius of the geometric
+ * source term of every core GridCell, so the hydrodynamic sweeps need neither join lookups nor divisions.
+ * @exception std::runtime_error Thrown if a core GridCell is missing a GridJoin.
+ */
+void Grid::buildFluxCoefficients() {
+	leftFaceOverVolume.assign(m_cells.size(), Vec3{{ 0, 0, 0 }});
+	rightFaceOverVolume.assign(m_cells.size(), Vec3{{ 0, 0, 0 }});
+	geometricRadius.assign(m_cells.size(), 0);
+	for (GridCell& cell : getIterable(CellRange::GRID_CELLS)) {
+		std::array<double, 2> radialAreas = {{ 0, 0 }};
+		for (int dim = 0; dim < m_consts->nd; ++dim) {
+			if (!joinExists(dim, cell.ljoinID) || !joinExists(dim, cell.rjoinID))
+				throw std::runtime_error("Grid::buildFluxCoefficients: GridCell " + cell.printCoords() + " has no GridJoin along dimension " + std::to_string(dim) + ".");
+			Vec3 xj = cell.xc;
+			xj[dim] = cell.xc[dim] - 0.5;
+			const double leftArea = computeJoinArea(xj, dim, dx, geometry, m_consts->nd);
+			xj[dim] = cell.xc[dim] + 0.5;
+			const double rightArea = computeJoinArea(xj, dim, dx, geometry, m_consts->nd);
+			leftFaceOverVolume[cell.id][dim] = leftArea/cell.vol;
+			rightFaceOverVolume[cell.id][dim] = rightArea/cell.vol;
+			if (dim == 0)
+				radialAreas = {{ leftArea, rightArea }};
+		}
+		if (geometry == Geometry::CYLINDRICAL)
+			geometricRadius[cell.id] = dx[0]*cell.xc[0];
+		else if (geometry == Geometry::SPHERICAL)
+			geometricRadius[cell.id] = cell.vol/(radialAreas[1] - radialAreas[0]);
+	}
+}
 
-	int ncells = coreCells[0] * coreCells[1] * coreCells[2];
+/**
+ * @brief Removes every GridCell, GridJoin and Bound, so the Grid can be initialised again (e.g. over a new partition).
+ * The time and time step are kept.
+ */
+void Grid::clear() {
+	m_causalIndices.clear();
+	m_boundaries.clear();
+	m_rayTiles.clear();
+	columnWork.clear();
+	m_lexicographicIDs.clear();
+	leftFaceOverVolume.clear();
+	rightFaceOverVolume.clear();
+	geometricRadius.clear();
+	hasColumnDensities = false;
+	hasTracedColumnDensities = false;
+	++rebuilds;
+	m_cellCollection.clear();
+	for (std::vector<int>& indices : m_orderedIndices)
+		indices.clear();
+	for (GridJoinVector& joins : m_joins)
+		GridJoinVector().swap(joins);
+	m_hydroHalo.clear();
+	m_staticHalo.clear();
+	m_haloPending = false;
+}
 
-	Logger::Instance().print<SeverityType::NOTICE>("Building Grid3D...\n");
-	ProgressBar progBar(ncells, 1000);
+/**
+ * @brief Builds this processor's core GridCells and the GridJoins between them.
+ *
+ * Every cell and join is allocated at once and filled in from its index, split over the threads. The joins along each
+ * dimension are ordered by the cell on their right, with its x coordinate varying slowest and its z coordinate fastest.
+ */
+void Grid::buildCells() {
+	const int ncells = coreCells[0]*coreCells[1]*coreCells[2];
+	const int nd = m_consts->nd;
 
-	for (int index = 0; index < ncells; ++index){
-		double dummy;
+	Logger::Instance().print<SeverityType::NOTICE>("Building Grid3D...\n");
 
-		m_cellCollection.add();
-		Coords nextCoords = unflatCoords(index);
+	const int first = m_cellCollection.addMany(ncells);
+	Parallel::forEach(0, ncells, [&](int index) {
+		GridCell& cell = m_cells[first + index];
+		Coords coords = unflatCoords(index);
 		for (int i = 0; i < 3; ++i)
-			m_cells[index].xc[i] = nextCoords[i];
-		for (int i = 0; i < m_consts->nd; ++i)
-			m_cells[index].xc[i] += 0.5;
-		m_cells[index].xc[0] += getLeftX();
-
-		progBar.update(index);
-		if (progBar.timeToUpdate()) {
-			progBar.update(index);
-			Logger::Instance().print<SeverityType::INFO>(progBar.getFullString(), "\r");
-		}
-	}
+			cell.xc[i] = coords[i] + coreOffset[i];
+		for (int i = 0; i < nd; ++i)
+			cell.xc[i] += 0.5;
+		cell.vol = computeCellVolume(cell.xc[0], dx, geometry, nd);
+	});
+	m_lexicographicIDs.resize(ncells);
+	Parallel::forEach(0, ncells, [&](int index) {
+		m_lexicographicIDs[index] = first + flatIndex(index%coreCells[0], (index/coreCells[0])%coreCells[1], index/(coreCells[0]*coreCells[1]));
+	});
 
-	for (int i = 0; i < coreCells[0]; ++i) {
-		for (int j = 0; j < coreCells[1]; ++j) {
-			for (int k = 0; k < coreCells[2]; ++k) {
-				if (i > 0)
-					link(0, flatIndex(i-1, j, k), flatIndex(i, j, k));
-				if (j > 0)
-					link(1, flatIndex(i, j-1, k), flatIndex(i, j, k));
-				if (k > 0)
-					link(2, flatIndex(i, j, k-1), flatIndex(i, j, k));
-			}
-		}
+	for (int dim = 0; dim < 3; ++dim) {
+		std::array<int, 3> njoins = coreCells;
+		njoins[dim] -= 1;
+		const int nfaces = ncells/coreCells[dim];
+		const int firstJoin = m_joins[dim].size();
+		m_joins[dim].reserve(firstJoin + njoins[0]*njoins[1]*njoins[2] + 2*nfaces);
+		m_joins[dim].resize(firstJoin + njoins[0]*njoins[1]*njoins[2]);
+
+		Parallel::forEach(0, njoins[0]*njoins[1]*njoins[2], [&](int j) {
+			Coords rc;
+			rc[2] = j%njoins[2];
+			rc[1] = (j/njoins[2])%njoins[1];
+			rc[0] = j/(njoins[1]*njoins[2]);
+			rc[dim] += 1;
+			Coords lc = rc;
+			lc[dim] -= 1;
+			const int rcellID = first + flatIndex(rc[0], rc[1], rc[2]);
+			const int lcellID = first + flatIndex(lc[0], lc[1], lc[2]);
+			const int joinID = firstJoin + j;
+
+			m_cells[rcellID].leftID[dim] = lcellID;
+			m_cells[lcellID].rightID[dim] = rcellID;
+			m_cells[rcellID].ljoinID[dim] = joinID;
+			m_cells[lcellID].rjoinID[dim] = joinID;
+
+			GridJoin& join = m_joins[dim][joinID];
+			join.rcellID = rcellID;
+			join.lcellID = lcellID;
+		});
 	}
-
-	progBar.end();
-	Logger::Instance().print<SeverityType::NOTICE>(progBar.getFinalString(), '\n');
 }
 
+/**
+ * @brief Lists the core cells in causal order with respect to a source (see causalOrder), clearing any previous causal
+ * orders.
+ */
 void Grid::buildCausal(const Coords& sourceCoords) {
-	Coords startCoords = nearestCoord(sourceCoords);
+	m_causalIndices = causalOrder(sourceCoords);
+	for (std::vector<int>& order : m_orderedIndices)
+		order.clear();
+}
 
-	for (Coords c = startCoords; withinGrid(c); c = nextCausalCoords(c, startCoords)) {
-		m_causalIndices.push_back(flatIndex(c[0] - getLeftX(), c[1], c[2]));
+/**
+ * @brief Lists the core cells in causal order with respect to a source.
+ *
+ * The cells are visited an octant at a time, starting with the one containing the source's nearest cell and flipping
+ * the direction along x fastest, then y, then z. Each octant is swept outwards from the source along x, then y, then z,
+ * so every cell comes after the cells between it and the source.
+ */
+std::vector<int> Grid::causalOrder(const Coords& sourceCoords) {
+	Coords startCoords = nearestCoord(sourceCoords);
+	std::vector<int> order;
+	order.reserve(coreCells[0]*coreCells[1]*coreCells[2]);
+
+	for (int octant = 0; octant < 8; ++octant) {
+		// Start and end (exclusive) of the sweep along each dimension, in core coordinates.
+		int begin[3], end[3], step[3];
+		for (int i = 0; i < 3; ++i) {
+			int s = startCoords[i] - coreOffset[i];
+			if ((octant >> i) & 1) {
+				begin[i] = s - 1;
+				end[i] = -1;
+				step[i] = -1;
+			}
+			else {
+				begin[i] = s;
+				end[i] = coreCells[i];
+				step[i] = 1;
+			}
+		}
+		for (int k = begin[2]; k != end[2]; k += step[2]) {
+			for (int j = begin[1]; j != end[1]; j += step[1]) {
+				for (int i = begin[0]; i != end[0]; i += step[0])
+					order.push_back(flatIndex(i, j, k));
+			}
+		}
 	}
+	return order;
 }
 
+/**
+ * @brief Creates the Bound on each face of the Grid. Faces shared with a neighbouring processor in the Cartesian
+ * topology (see MPIW::createCartesian) become PARTITION boundaries, each with its own message buffers.
+ */
 void Grid::buildBoundaries(const std::array<Condition, 3>& leftBC, const std::array<Condition, 3>& rightBC) {
 	MPIW& mpihandler = MPIW::Instance();
-	int nproc = mpihandler.nProcessors();
-	int rproc = mpihandler.getRank();
+	const std::array<int, 3>& nprocs = mpihandler.getDims();
+	const std::array<int, 3>& coords = mpihandler.getCoords();
 
-	int left_rank = (rproc - 1 < 0) ? rproc - 1 + nproc : rproc - 1;
-	int right_rank = (rproc + 1 >= nproc) ? rproc + 1 - nproc : rproc + 1;
-	bool periodic_and_mpi = nproc > 1 && leftBC[0] == Condition::PERIODIC && rightBC[0] == Condition::PERIODIC;
+	for (int dim = 0; dim < m_consts->nd; ++dim) {
+		int left_rank = nprocs[dim] > 1 ? mpihandler.neighbour(dim, -1) : -1;
+		int right_rank = nprocs[dim] > 1 ? mpihandler.neighbour(dim, 1) : -1;
 
-	if (m_consts->nd > 0) {
-		if (mpihandler.getRank() != 0 || periodic_and_mpi)
-			m_boundaries.push_back(Bound(0, Condition::PARTITION, left_rank));
+		if (left_rank != -1) {
+			m_boundaries.push_back(Bound(dim, Condition::PARTITION, left_rank));
+			m_boundaries.back().wrapsAround = (coords[dim] == 0);
+		}
 		else
-			m_boundaries.push_back(Bound(0, leftBC[0]));
-		if (rproc != nproc - 1 || periodic_and_mpi)
-			m_boundaries.push_back(Bound(3, Condition::PARTITION, right_rank));
+			m_boundaries.push_back(Bound(dim, leftBC[dim]));
+		if (right_rank != -1) {
+			m_boundaries.push_back(Bound(dim + 3, Condition::PARTITION, right_rank));
+			m_boundaries.back().wrapsAround = (coords[dim] == nprocs[dim] - 1);
+		}
 		else
-			m_boundaries.push_back(Bound(3, rightBC[0]));
+			m_boundaries.push_back(Bound(dim + 3, rightBC[dim]));
 	}
-	if (m_consts->nd > 1) {
-		m_boundaries.push_back(Bound(1, leftBC[1]));
-		m_boundaries.push_back(Bound(4, rightBC[1]));
+
+	const int nvalues = (spatialOrder + 1)*(UID::N + 1);
+	for (Bound& boundary : m_boundaries) {
+		if (boundary.condition == Condition::PARTITION) {
+			int dim = boundary.face%3;
+			boundary.partition.initialise(coreCells[(dim + 1)%3]*coreCells[(dim + 2)%3]*nvalues);
+		}
 	}
-	if (m_consts->nd > 2) {
-		m_boundaries.push_back(Bound(2, leftBC[2]));
-		m_boundaries.push_back(Bound(5, rightBC[2]));
+}
+
+/**
+ * @brief Pairs the ghost cells of every non-PARTITION boundary with the cells they are copied from.
+ *
+ * FREE, INFLOW and OUTFLOW ghost cells copy the core cell they are joined to, PERIODIC ghost cells the cell as deep
+ * into the other side of the Grid, and REFLECTING ghost cells the core cell mirrored about the one they are joined to.
+ * INFLOW (OUTFLOW) boundaries clamp the normal velocity to point into (out of) the Grid.
+ * @exception std::runtime_error Thrown if the Grid is too small for a REFLECTING or PERIODIC boundary.
+ */
+void Grid::buildBoundarySlabs() {
+	for (Bound& boundary : m_boundaries) {
+		if (boundary.condition == Condition::PARTITION)
+			continue;
+		const int dim = boundary.face%3;
+		const bool isLeft = boundary.face < 3;
+		BoundarySlab& slab = boundary.slab;
+		slab.ghostIDs.clear();
+		slab.sourceIDs.clear();
+		slab.sign.fill(1);
+		slab.clamp.fill(0);
+		if (boundary.condition == Condition::REFLECTING)
+			slab.sign[UID::VEL+dim] = -1;
+		else if (boundary.condition == Condition::INFLOW)
+			slab.clamp[UID::VEL+dim] = isLeft ? 1 : -1;
+		else if (boundary.condition == Condition::OUTFLOW)
+			slab.clamp[UID::VEL+dim] = isLeft ? -1 : 1;
+
+		for (int ghostCellID : boundary.ghostCellIDs) {
+			const int linkCellID = isLeft ? right(dim, ghostCellID) : left(dim, ghostCellID);
+			int currCellID = linkCellID;
+			if (boundary.condition == Condition::PERIODIC) {
+				Coords cellCoords = unflatCoords(linkCellID);
+				cellCoords[dim] += isLeft ? coreCells[dim] - 1 : 1 - coreCells[dim];
+				currCellID = flatIndex(cellCoords[0], cellCoords[1], cellCoords[2]);
+			}
+			for (int currGhostID = ghostCellID; currGhostID != -1; currGhostID = isLeft ? left(dim, currGhostID) : right(dim, currGhostID)) {
+				if (boundary.condition == Condition::REFLECTING)
+					currCellID = isLeft ? right(dim, currCellID) : left(dim, currCellID);
+				if (currCellID == -1)
+					throw std::runtime_error("Grid::buildBoundarySlabs: too few cells along dimension " + std::to_string(dim) + " for the boundary on face " + std::to_string(boundary.face) + ".");
+				slab.ghostIDs.push_back(currGhostID);
+				slab.sourceIDs.push_back(currCellID);
+				if (boundary.condition == Condition::PERIODIC)
+					currCellID = isLeft ? left(dim, currCellID) : right(dim, currCellID);
+			}
+		}
 	}
 }
 
+/**
+ * @brief Sets up the persistent halo exchanges across every PARTITION boundary, in one message per neighbouring
+ * processor (see HaloExchange): the hydrodynamic variables, which are exchanged every step, and the heat capacity
+ * ratios, which only change with the initial conditions and are exchanged by applyStaticBCs.
+ *
+ * Must be called once all of the ghost cells have been built, since the persistent requests hold on to the addresses of
+ * the cells or buffers.
+ * @param useDatatypes Send and receive straight from the cells through MPI datatypes rather than packing buffers.
+ * @param useCollective Exchange with every neighbour in one neighbourhood collective rather than persistent requests.
+ * @param useFloats Send the hydrodynamic variables as floats.
+ */
+void Grid::buildHaloExchange(bool useDatatypes, bool useCollective, bool useFloats) {
+	const GridCell& cell = m_cells[0];
+	const char* base = reinterpret_cast<const char*>(&cell);
+	std::vector<HaloExchange::Field> hydroFields = {
+		{ reinterpret_cast<const char*>(cell.Q.data()) - base, UID::N }
+	};
+	std::vector<HaloExchange::Field> staticFields = {
+		{ reinterpret_cast<const char*>(&cell.heatCapacityRatio) - base, 1 }
+	};
+	m_hydroHalo.initialise(m_boundaries, m_cells, hydroFields, 0, useDatatypes, useCollective, useFloats);
+	m_staticHalo.initialise(m_boundaries, m_cells, staticFields, 1, useDatatypes, useCollective);
+}
+
+/**
+ * @brief Splits the causally ordered cells into RayTiles, which are ray traced one after the other.
+ *
+ * When the Grid is split between processors the cells are tiled across the dimensions that are not split, with
+ * tileSize cells along each. A cell's column density only depends on cells that are nearer the star along every
+ * dimension, so ordering the tiles by their distance (in tiles) from the tile nearest the star keeps the traversal causal.
+ * Every processor along the split dimension holds the same range of the other dimensions, so they all build the same tiles
+ * in the same order and a tile's column densities can be sent as soon as it has been traced. Otherwise the whole Grid
+ * is one tile.
+ *
+ * The cells of each tile are grouped into dependency levels of constant Manhattan distance (in cells) from the star.
+ * The neighbours a cell's column density is interpolated from are one cell nearer the star along each dimension they
+ * differ in, so they are always in an earlier level and the cells within a level can be traced in any order (see
+ * Parallel::forEachLevel). Must be called after the CausalWind and CausalNonWind ordered indices have been set up.
+ * @param sourceCoords Grid coordinates of the star.
+ * @param tileSize Number of cells along each side of a tile (0 for a single tile).
+ */
+void Grid::buildRayTiles(const Coords& sourceCoords, int tileSize) {
+	m_rayTiles = makeRayTiles(sourceCoords, tileSize, getOrderedIndices(CellOrder::CAUSAL_WIND), getOrderedIndices(CellOrder::CAUSAL_NON_WIND));
+}
+
+/**
+ * @brief Splits causally ordered cells into the RayTiles of a source (see buildRayTiles).
+ * @param sourceCoords Grid coordinates of the source.
+ * @param tileSize Number of cells along each side of a tile (0 for a single tile).
+ * @param windIDs Cells the source's wind fills, in causal order.
+ * @param nonWindIDs The other core cells, in causal order.
+ * @return The tiles, in the order they are ray traced.
+ */
+std::vector<RayTile> Grid::makeRayTiles(const Coords& sourceCoords, int tileSize, const std::vector<int>& windIDs,
+		const std::vector<int>& nonWindIDs) {
+	const std::array<int, 3>& nprocs = MPIW::Instance().getDims();
+	const bool split = nprocs[0]*nprocs[1]*nprocs[2] > 1;
+	std::array<int, 3> tileCells, ntiles, sourceTile;
+	for (int i = 0; i < 3; ++i) {
+		tileCells[i] = (!split || tileSize <= 0 || nprocs[i] > 1) ? coreCells[i] : std::min(tileSize, coreCells[i]);
+		ntiles[i] = (coreCells[i] + tileCells[i] - 1)/tileCells[i];
+		int sourceCell = std::max(0, std::min(coreCells[i] - 1, sourceCoords[i] - coreOffset[i]));
+		sourceTile[i] = sourceCell/tileCells[i];
+	}
+
+	// Tiles nearer the star are traced first, ties are broken by flat index so every processor agrees on the order.
+	const int ntotal = ntiles[0]*ntiles[1]*ntiles[2];
+	std::vector<int> order(ntotal), position(ntotal);
+	std::vector<int> distance(ntotal, 0);
+	for (int itile = 0; itile < ntotal; ++itile) {
+		order[itile] = itile;
+		int tc[3] = {itile%ntiles[0], (itile/ntiles[0])%ntiles[1], itile/(ntiles[0]*ntiles[1])};
+		for (int i = 0; i < 3; ++i)
+			distance[itile] += std::abs(tc[i] - sourceTile[i]);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return distance[a] < distance[b]; });
+	for (int i = 0; i < ntotal; ++i)
+		position[order[i]] = i;
+
+	auto tileOf = [&](const GridCell& cell) -> int {
+		int tc[3];
+		for (int i = 0; i < 3; ++i) {
+			int c = std::max(0, std::min(coreCells[i] - 1, (int)std::floor(cell.xc[i]) - coreOffset[i]));
+			tc[i] = c/tileCells[i];
+		}
+		return position[tc[0] + ntiles[0]*(tc[1] + ntiles[1]*tc[2])];
+	};
+
+	std::vector<RayTile> tiles(ntotal);
+	for (RayTile& tile : tiles)
+		tile.ghostIDs.resize(m_boundaries.size());
+	for (int cellID : windIDs)
+		tiles[tileOf(m_cells[cellID])].windIDs.push_back(cellID);
+	for (int cellID : nonWindIDs)
+		tiles[tileOf(m_cells[cellID])].nonWindIDs.push_back(cellID);
+	for (unsigned int ib = 0; ib < m_boundaries.size(); ++ib) {
+		if (m_boundaries[ib].condition != Condition::PARTITION)
+			continue;
+		for (int ghostID : m_boundaries[ib].ghostCellIDs)
+			tiles[tileOf(m_cells[ghostID])].ghostIDs[ib].push_back(ghostID);
+	}
+
+	auto levelOf = [&](int cellID) -> int {
+		int level = 0;
+		for (int i = 0; i < m_consts->nd; ++i)
+			level += std::abs((int)std::floor(m_cells[cellID].xc[i]) - sourceCoords[i]);
+		return level;
+	};
+	auto groupByLevel = [&](std::vector<int>& cellIDs, std::vector<int>& levels) {
+		std::stable_sort(cellIDs.begin(), cellIDs.end(), [&](int a, int b) { return levelOf(a) < levelOf(b); });
+		levels.clear();
+		for (unsigned int i = 0; i < cellIDs.size(); ++i)
+			if (i == 0 || levelOf(cellIDs[i]) != levelOf(cellIDs[i - 1]))
+				levels.push_back(i);
+		levels.push_back(cellIDs.size());
+	};
+	for (RayTile& tile : tiles) {
+		groupByLevel(tile.windIDs, tile.windLevels);
+		groupByLevel(tile.nonWindIDs, tile.nonWindLevels);
+	}
+	return tiles;
+}
+
+/**
+ * @brief Passes the ray tracing data across every PARTITION boundary through the one-sided relay of MPIW instead of
+ * messages (see PartitionManager::initialiseRelay), once the RayTiles are built. Collective.
+ */
+void Grid::buildRelay() {
+	MPIW& mpihandler = MPIW::Instance();
+	double capacity = 0;
+	for (const Bound& boundary : m_boundaries)
+		if (boundary.condition == Condition::PARTITION)
+			capacity = std::max(capacity, (double)boundary.partition.getCapacity());
+	double ntiles = m_rayTiles.size();
+	capacity = mpihandler.maximum(capacity);
+	ntiles = mpihandler.maximum(ntiles);
+	mpihandler.createRelay(PartitionManager::relayDataCount((int)capacity), PartitionManager::relaySignalCount((int)ntiles));
+	for (Bound& boundary : m_boundaries)
+		if (boundary.condition == Condition::PARTITION)
+			boundary.partition.initialiseRelay(boundary.face, (int)capacity, (int)ntiles);
+}
+
 void Grid::boundaryLink(Bound& boundary) {
 	int dim = boundary.face%3;
 	bool isLeft = boundary.face < 3;
 	int linkCellID = isLeft ? 0 : flatIndex(dim == 0 ? coreCells[0]-1 : 0, dim == 1 ? coreCells[1]-1 : 0, dim == 2 ? coreCells[2]-1 : 0);
 
-	if (boundary.condition == Condition::PARTITION)
-		m_cellCollection.start(isLeft ? "LeftPartitionCells" : "RightPartitionCells");
 	while (linkCellID != -1) {
 		int ghostCellID = m_cellCollection.add();
 		GridCell& ghostCell = m_cells[ghostCellID];
@@ -622,20 +1212,23 @@ void Grid::boundaryLink(Bound& boundary) {
 
 		linkCellID = nextCell2D(dim, linkCellID);
 	}
-	if (boundary.condition == Condition::PARTITION)
-		m_cellCollection.stop(isLeft ? "LeftPartitionCells" : "RightPartitionCells");
 }
 
-void Grid::boundaryLinkDeeper(Bound& boundary ) {
+/**
+ * @brief Adds the ghost cells beyond the first layer of a Bound, spatialOrder deep behind each of its ghost cells.
+ */
+void Grid::boundaryLinkDeeper(Bound& boundary) {
 	int dim = boundary.face%3;
 	bool isLeft = boundary.face < 3;
+	const int nghosts = boundary.ghostCellIDs.size();
+	const int first = m_cellCollection.addMany(nghosts*spatialOrder);
 
-	for (int ghostCellID : boundary.ghostCellIDs) {
-		int currGhostID = ghostCellID;
+	Parallel::forEach(0, nghosts, [&](int i) {
+		int currGhostID = boundary.ghostCellIDs[i];
 
 		for (int ig = 0; ig < spatialOrder; ++ig) {
 			int oldGhostID = currGhostID;
-			currGhostID = m_cellCollection.add();
+			currGhostID = first + i*spatialOrder + ig;
 			m_cells[currGhostID].xc[0] = -100;
 
 			if (isLeft)
@@ -643,196 +1236,115 @@ void Grid::boundaryLinkDeeper(Bound& boundary ) {
 			else
 				m_cells[oldGhostID].rightID[dim] = currGhostID;
 		}
-	}
+	});
 }
 
+/**
+ * @brief Fills in the ghost cells of every boundary, waiting for the halo exchange with neighbouring processors.
+ */
 void Grid::applyBCs() {
-	for (Bound& boundary : m_boundaries) {
-		int dim = boundary.face%3;
+	applyBCsAsync();
+	waitBCs();
+}
 
+/**
+ * @brief Fills in the ghost cells of every non-PARTITION boundary and posts the halo exchange for the PARTITION ones
+ * without waiting for it.
+ *
+ * The ghost cells of PARTITION boundaries are not valid until Grid::waitBCs has been called. Until then the core cells
+ * must not be modified, as they are still being sent.
+ */
+void Grid::applyBCsAsync() {
+	ScopedTimer timer(ProfileID::BCS_PACK);
+	for (Bound& boundary : m_boundaries) {
 		switch(boundary.condition) {
 			case(Condition::FREE):
-				if (boundary.face < 3) {
-					for (int ghostCellID : boundary.ghostCellIDs) {
-						GridCell& cell = m_cells[right(dim, ghostCellID)];
-
-						for (int currGhostID = ghostCellID; currGhostID != -1; currGhostID = left(dim, currGhostID)) {
-							GridCell& ghost = m_cells[currGhostID];
-							for(int iu = 0; iu < UID::N; iu++)
-								ghost.Q[iu] = cell.Q[iu];
-							ghost.heatCapacityRatio = cell.heatCapacityRatio;
-						}
-					}
-				}
-				else {
-					for (int ghostCellID : boundary.ghostCellIDs) {
-						GridCell& cell = m_cells[left(dim, ghostCellID)];
-
-						for (int currGhostID = ghostCellID; currGhostID != -1; currGhostID = right(dim, currGhostID)) {
-							GridCell& ghost = m_cells[currGhostID];
-							for(int iu = 0; iu < UID::N; iu++)
-								ghost.Q[iu] = cell.Q[iu];
-							ghost.heatCapacityRatio = cell.heatCapacityRatio;
-						}
-					}
-				}
-				break;
 			case(Condition::INFLOW):
-				if (boundary.face < 3) {
-					for (int ghostCellID : boundary.ghostCellIDs) {
-						GridCell& cell = m_cells[right(dim, ghostCellID)];
-
-						for (int currGhostID = ghostCellID; currGhostID != -1; currGhostID = left(dim, currGhostID)) {
-							GridCell& ghost = m_cells[currGhostID];
-							for(int iu = 0; iu < UID::N; iu++)
-								ghost.Q[iu] = cell.Q[iu];
-							if (cell.Q[UID::VEL+dim] < 0)
-								ghost.Q[UID::VEL+dim] = -1.0*cell.Q[UID::VEL+dim];
-							ghost.heatCapacityRatio = cell.heatCapacityRatio;
-						}
-					}
-				}
-				else {
-					for (int ghostCellID : boundary.ghostCellIDs) {
-						GridCell& cell = m_cells[left(dim, ghostCellID)];
-
-						for (int currGhostID = ghostCellID; currGhostID != -1; currGhostID = right(dim, currGhostID)) {
-							GridCell& ghost = m_cells[currGhostID];
-							for (int iu = 0; iu < UID::N; iu++)
-								ghost.Q[iu] = cell.Q[iu];
-							if (cell.Q[UID::VEL+dim] > 0)
-								ghost.Q[UID::VEL+dim] = -1.0*cell.Q[UID::VEL+dim];
-							ghost.heatCapacityRatio = cell.heatCapacityRatio;
-						}
-					}
-				}
-				break;
 			case(Condition::OUTFLOW):
-				if (boundary.face < 3) {
-					for (int ghostCellID : boundary.ghostCellIDs) {
-						GridCell& cell = m_cells[right(dim, ghostCellID)];
-
-						for (int currGhostID = ghostCellID; currGhostID != -1; currGhostID = left(dim, currGhostID)) {
-							GridCell& ghost = m_cells[currGhostID];
-							for (int iu = 0; iu < UID::N; iu++)
-								ghost.Q[iu] = cell.Q[iu];
-							if (cell.Q[UID::VEL+dim] > 0)
-								ghost.Q[UID::VEL+dim] = -1.0*cell.Q[UID::VEL+dim];
-							ghost.heatCapacityRatio = cell.heatCapacityRatio;
-						}
-					}
-				}
-				else {
-					for (int ghostCellID : boundary.ghostCellIDs) {
-						GridCell& cell = m_cells[left(dim, ghostCellID)];
-
-						for (int currGhostID = ghostCellID; currGhostID != -1; currGhostID = right(dim, currGhostID)) {
-							GridCell& ghost = m_cells[currGhostID];
-							for (int iu = 0; iu < UID::N; iu++)
-								ghost.Q[iu] = cell.Q[iu];
-							if(cell.Q[UID::VEL+dim] < 0)
-								ghost.Q[UID::VEL+dim] = -1.0*cell.Q[UID::VEL+dim];
-							ghost.heatCapacityRatio = cell.heatCapacityRatio;
-						}
-					}
-				}
-				break;
 			case(Condition::PERIODIC):
-				if (boundary.face < 3) {
-					for (int ghostCellID : boundary.ghostCellIDs) {
-						Coords cellCoords = unflatCoords(right(dim, ghostCellID));
-						cellCoords[dim] += coreCells[dim] - 1;
-
-						int currCellID = flatIndex(cellCoords[0], cellCoords[1], cellCoords[2]);
-						for (int currGhostID = ghostCellID; currGhostID != -1; currGhostID = left(dim, currGhostID)) {
-							GridCell& ghost = m_cells[currGhostID];
-							GridCell& cell = m_cells[currCellID];
-							for(int iu = 0; iu < UID::N; iu++)
-								ghost.Q[iu] = cell.Q[iu];
-							ghost.heatCapacityRatio = cell.heatCapacityRatio;
-							currCellID = left(dim, currCellID);
-						}
-					}
-				}
-				else {
-					for (int ghostCellID : boundary.ghostCellIDs) {
-						Coords cellCoords = unflatCoords(left(dim, ghostCellID));
-						cellCoords[dim] -= coreCells[dim] - 1;
-
-						int currCellID = flatIndex(cellCoords[0], cellCoords[1], cellCoords[2]);
-						for (int currGhostID = ghostCellID; currGhostID != -1; currGhostID = right(dim, currGhostID)) {
-							GridCell& ghost = m_cells[currGhostID];
-							GridCell& cell = m_cells[currCellID];
-							for(int iu = 0; iu < UID::N; iu++)
-								ghost.Q[iu] = cell.Q[iu];
-							ghost.heatCapacityRatio = cell.heatCapacityRatio;
-							currCellID = right(dim, currCellID);
-						}
-					}
-				}
-				break;
 			case(Condition::REFLECTING):
-				if (boundary.face < 3) {
-					for (int ghostCellID : boundary.ghostCellIDs) {
-						for (int currGhostID = ghostCellID, currCellID = right(dim, ghostCellID); currGhostID != -1; currGhostID = left(dim, currGhostID)) {
-							currCellID = right(dim, currCellID);
-							GridCell& ghost = m_cells[currGhostID];
-							GridCell& cell = m_cells[currCellID];
-
-							for (int iu = 0; iu < UID::N; iu++)
-								ghost.Q[iu] = cell.Q[iu];
-
-							ghost.Q[UID::VEL+dim] = -cell.Q[UID::VEL+dim];
-							ghost.heatCapacityRatio = cell.heatCapacityRatio;
-						}
-					}
-				}
-				else {
-					for (int ghostCellID : boundary.ghostCellIDs) {
-						for (int currGhostID = ghostCellID, currCellID = left(dim, ghostCellID); currGhostID != -1; currGhostID = right(dim, currGhostID)) {
-							currCellID = left(dim, currCellID);
-							GridCell& ghost = m_cells[currGhostID];
-							GridCell& cell = m_cells[currCellID];
-							for(int iu = 0; iu < UID::N; iu++)
-								ghost.Q[iu] = cell.Q[iu];
-							ghost.Q[UID::VEL+dim] = -cell.Q[UID::VEL+dim];
-							ghost.heatCapacityRatio = cell.heatCapacityRatio;
-						}
-					}
-				}
+				applySlab(boundary.slab);
 				break;
 			case(Condition::PARTITION):
-				MPIW& mpihandler = MPIW::Instance();
-
-				partition.resetBuffer();
-
-				for (int ghostCellID : boundary.ghostCellIDs) {
-					int currCellID = ghostCellID;
-					for (int currGhostID = ghostCellID; currGhostID != -1; currGhostID = boundary.face < 3 ? left(dim, currGhostID) : right(dim, currGhostID)) {
-						currCellID = boundary.face < 3 ? right(dim, currCellID) : left(dim, currCellID);
-						GridCell& cell = m_cells[currCellID];
-						for (int iu = 0; iu < UID::N; ++iu)
-							partition.addSendItem(cell.Q[iu]);
-						partition.addSendItem(cell.heatCapacityRatio);
-					}
-				}
-
-				bool isPeriodic = (mpihandler.getRank() == 0 && boundary.face == 0) || (mpihandler.getRank() == mpihandler.nProcessors()-1 && boundary.face == 3);
-				SendID tag = isPeriodic ? SendID::PERIODIC_MSG : SendID::PARTITION_MSG;
+				break;
+		}
+	}
+	m_hydroHalo.start();
 
-				partition.exchangeData(boundary.targetProcessor, tag);
+	m_haloPending = true;
+}
 
-				for (int ghostCellID : boundary.ghostCellIDs) {
-					for (int currGhostID = ghostCellID; currGhostID != -1; currGhostID = (boundary.face < 3) ? left(dim, currGhostID) : right(dim, currGhostID)) {
-						GridCell& ghost = m_cells[currGhostID];
-						for (int iu = 0; iu < UID::N; ++iu)
-							ghost.Q[iu] = partition.getRecvItem();
-						ghost.heatCapacityRatio = partition.getRecvItem();
-					}
-				}
-				break;
+/**
+ * @brief Copies the cells of a BoundarySlab into its ghost cells.
+ */
+void Grid::applySlab(const BoundarySlab& slab) {
+	const int* ghostIDs = slab.ghostIDs.data();
+	const int* sourceIDs = slab.sourceIDs.data();
+	Parallel::forEach(0, (int)slab.ghostIDs.size(), [&](int i) {
+		GridCell& ghost = m_cells[ghostIDs[i]];
+		const GridCell& cell = m_cells[sourceIDs[i]];
+		for (int iu = 0; iu < UID::N; ++iu) {
+			double q = slab.sign[iu]*cell.Q[iu];
+			ghost.Q[iu] = (slab.clamp[iu]*q < 0) ? -q : q;
 		}
+	});
+}
+
+/**
+ * @brief Fills in the fields of every ghost cell that only change with the initial conditions, i.e. the heat capacity
+ * ratio, which applyBCs leaves alone. Collective.
+ *
+ * Must be called once the core cells have been set up, and again whenever their heat capacity ratios change (e.g. once
+ * the Grid has been rebuilt over a new partition).
+ */
+void Grid::applyStaticBCs() {
+	waitBCs();
+	for (const Bound& boundary : m_boundaries) {
+		if (boundary.condition == Condition::PARTITION)
+			continue;
+		const BoundarySlab& slab = boundary.slab;
+		for (unsigned int i = 0; i < slab.ghostIDs.size(); ++i)
+			m_cells[slab.ghostIDs[i]].heatCapacityRatio = m_cells[slab.sourceIDs[i]].heatCapacityRatio;
 	}
+	m_staticHalo.start();
+	MPIW::Instance().waitAll();
+	m_staticHalo.finish();
+}
+
+/**
+ * @brief Waits for the halo exchange posted by Grid::applyBCsAsync and unpacks it into the PARTITION ghost cells.
+ *
+ * Does nothing if there is no exchange in flight.
+ */
+void Grid::waitBCs() {
+	if (!m_haloPending)
+		return;
+	m_haloPending = false;
+
+	// Every processor posts all of its exchanges before waiting, so the order of the faces does not matter.
+	{
+		ScopedTimer timer(ProfileID::BCS_WAIT);
+		MPIW::Instance().waitAll();
+	}
+	ScopedTimer timer(ProfileID::BCS_UNPACK);
+	m_hydroHalo.finish();
+	if (m_hydroHalo.isCheckingPrecision())
+		logHaloRounding();
+}
+
+/**
+ * @brief Logs the largest relative rounding of each hydrodynamic variable sent as a float over every processor at the
+ * halo exchange that has just finished, which is how far its ghost cells are from those of an exchange of doubles.
+ * Collective.
+ */
+void Grid::logHaloRounding() {
+	const std::vector<double> errors = MPIW::Instance().maximum(m_hydroHalo.takeRoundingErrors());
+	std::stringstream msg;
+	msg << "Grid::logHaloRounding: largest relative rounding of the single precision halo exchange of Q:";
+	for (unsigned int i = 0; i < errors.size(); ++i)
+		msg << (i == 0 ? " " : ", ") << errors[i];
+	msg << ".\n";
+	Logger::Instance().print<SeverityType::NOTICE>(msg.str());
 }
 
 /**
@@ -920,37 +1432,72 @@ int Grid::getRayPlane(const Vec3& xc, const Vec3& xs) const {
 }
 
 void Grid::calculateNearestNeighbours(const std::array<double, 3>& star_pos) {
-	for (int index = 0; index < coreCells[0]*coreCells[1]*coreCells[2]; ++index) {
-
-		int plane = getRayPlane(m_cells[index].xc, star_pos);
-		int irot[3] = {(plane+1)%3, (plane+2)%3, (plane%3)};
-		double d[3] = {0.0, 0.0, 0.0};
-		for(int i = 0; i < 3; i++)
-			d[i] = m_cells[index].xc[irot[i]] - star_pos[irot[i]];
-		int s[3] = {d[0] < -1.0/10.0 ? -1 : 1, d[1] < -1.0/10.0 ? -1 : 1, d[2] < -1.0/10.0 ? -1 : 1};
-		int LR[3] = {std::abs(d[0]) < 1.0/10.0 ? 0 : s[0], std::abs(d[1]) < 1.0/10.0 ? 0 : s[1], std::abs(d[2]) < 1.0/10.0 ? 0 : s[2]};
-		m_cells[index].neighbourIDs[0] = traverse3D(irot[0], irot[1], irot[2], 0, 0, -LR[2], index);
-		m_cells[index].neighbourIDs[1] = traverse3D(irot[0], irot[1], irot[2], 0, -LR[1], -LR[2], index);
-		m_cells[index].neighbourIDs[2] = traverse3D(irot[0], irot[1], irot[2], -LR[0], 0, -LR[2], index);
-		m_cells[index].neighbourIDs[3] = traverse3D(irot[0], irot[1], irot[2], -LR[0], -LR[1], -LR[2], index);
-		if (m_cells[index].neighbourIDs[0] == -1)
-			m_cells[index].neighbourIDs[0] = Grid::traverseOverJoins3D(irot[0], irot[1], irot[2], 0, 0, -LR[2], index);
-		if (m_cells[index].neighbourIDs[1] == -1)
-			m_cells[index].neighbourIDs[1] = Grid::traverseOverJoins3D(irot[0], irot[1], irot[2], 0, -LR[1], -LR[2], index);
-		if (m_cells[index].neighbourIDs[2] == -1)
-			m_cells[index].neighbourIDs[2] = Grid::traverseOverJoins3D(irot[0], irot[1], irot[2], -LR[0], 0, -LR[2], index);
-		if (m_cells[index].neighbourIDs[3] == -1)
-			m_cells[index].neighbourIDs[3] = Grid::traverseOverJoins3D(irot[0], irot[1], irot[2], -LR[0], -LR[1], -LR[2], index);
-
-		double ic[3] = {(int)m_cells[index].xc[irot[0]]-0.5*(s[2]*d[0]/d[2]),	(int)m_cells[index].xc[irot[1]]-0.5*(s[2]*d[1]/d[2]),	(int)m_cells[index].xc[irot[2]]-0.5*(s[2])};
-		double delta[2] = {std::abs(2.0*ic[0]-2.0*(int)m_cells[index].xc[irot[0]]+s[0]), std::abs(2.0*ic[1]-2.0*(int)m_cells[index].xc[irot[1]]+s[1])};
-		m_cells[index].neighbourWeights[0] = (std::abs(d[2]) > 0.9) ? delta[0]*delta[1] : 0;
-		m_cells[index].neighbourWeights[1] = ((std::abs(d[1]) > 0.9) && (std::abs(d[2]) > 0.9)) ? delta[0]*(1.0-delta[1]) : 0;
-		m_cells[index].neighbourWeights[2] = ((std::abs(d[0]) > 0.9) && (std::abs(d[2]) > 0.9)) ? (1.0-delta[0])*delta[1] : 0;
-		m_cells[index].neighbourWeights[3] = ((std::abs(d[0]) > 0.9) && (std::abs(d[1]) > 0.9) && (std::abs(d[2]) > 0.9)) ? (1.0-delta[0])*(1.0-delta[1]) : 0;
+	Parallel::forEach(0, coreCells[0]*coreCells[1]*coreCells[2], [&](int index) {
+		calculateNearestNeighbours(index, star_pos, m_cellCollection.getRayGeometry(index));
+	});
+}
+
+/**
+ * @brief Finds the neighbours a core cell's column density from a source is interpolated from.
+ * @param index ID of the cell.
+ * @param star_pos Grid coordinates of the source.
+ * @param ray The RayGeometry the neighbour IDs are written to.
+ * @see neighbourWeights
+ */
+void Grid::calculateNearestNeighbours(int index, const std::array<double, 3>& star_pos, RayGeometry& ray) {
+	int plane = getRayPlane(m_cells[index].xc, star_pos);
+	int irot[3] = {(plane+1)%3, (plane+2)%3, (plane%3)};
+	double d[3] = {0.0, 0.0, 0.0};
+	for(int i = 0; i < 3; i++)
+		d[i] = m_cells[index].xc[irot[i]] - star_pos[irot[i]];
+	int s[3] = {d[0] < -1.0/10.0 ? -1 : 1, d[1] < -1.0/10.0 ? -1 : 1, d[2] < -1.0/10.0 ? -1 : 1};
+	int LR[3] = {std::abs(d[0]) < 1.0/10.0 ? 0 : s[0], std::abs(d[1]) < 1.0/10.0 ? 0 : s[1], std::abs(d[2]) < 1.0/10.0 ? 0 : s[2]};
+	// A neighbour inside the block is found from the coordinates of the cell, since every cell on the way to it is a core
+	// cell too. Only the neighbours across the edge of the block are left to the traversals.
+	const Coords c = unflatCoords(index);
+	const int dc[4][3] = {{0, 0, -LR[2]}, {0, -LR[1], -LR[2]}, {-LR[0], 0, -LR[2]}, {-LR[0], -LR[1], -LR[2]}};
+	for (int in = 0; in < 4; ++in) {
+		Coords nc = c;
+		bool inBlock = true;
+		for (int i = 0; i < 3; ++i) {
+			nc[irot[i]] += dc[in][i];
+			inBlock = inBlock && nc[irot[i]] >= 0 && nc[irot[i]] < coreCells[irot[i]];
+		}
+		if (inBlock)
+			ray.neighbourIDs[in] = flatIndex(nc[0], nc[1], nc[2]);
+		else {
+			ray.neighbourIDs[in] = traverse3D(irot[0], irot[1], irot[2], dc[in][0], dc[in][1], dc[in][2], index);
+			if (ray.neighbourIDs[in] == -1)
+				ray.neighbourIDs[in] = traverseOverJoins3D(irot[0], irot[1], irot[2], dc[in][0], dc[in][1], dc[in][2], index);
+		}
 	}
 }
 
+/**
+ * @brief Calculates the weights of the neighbours of a cell (see RayGeometry::neighbourIDs) in the interpolation of its
+ * column density from a source, which depend only on the position of the cell relative to the source.
+ * @param xc Grid coordinates of the cell.
+ * @param star_pos Grid coordinates of the source.
+ * @return The weights, in the order of RayGeometry::neighbourIDs.
+ */
+std::array<double, 4> Grid::neighbourWeights(const Vec3& xc, const Vec3& star_pos) const {
+	int plane = getRayPlane(xc, star_pos);
+	int irot[3] = {(plane+1)%3, (plane+2)%3, (plane%3)};
+	double d[3] = {0.0, 0.0, 0.0};
+	for(int i = 0; i < 3; i++)
+		d[i] = xc[irot[i]] - star_pos[irot[i]];
+	int s[3] = {d[0] < -1.0/10.0 ? -1 : 1, d[1] < -1.0/10.0 ? -1 : 1, d[2] < -1.0/10.0 ? -1 : 1};
+
+	double ic[3] = {(int)xc[irot[0]]-0.5*(s[2]*d[0]/d[2]),	(int)xc[irot[1]]-0.5*(s[2]*d[1]/d[2]),	(int)xc[irot[2]]-0.5*(s[2])};
+	double delta[2] = {std::abs(2.0*ic[0]-2.0*(int)xc[irot[0]]+s[0]), std::abs(2.0*ic[1]-2.0*(int)xc[irot[1]]+s[1])};
+	std::array<double, 4> weights;
+	weights[0] = (std::abs(d[2]) > 0.9) ? delta[0]*delta[1] : 0;
+	weights[1] = ((std::abs(d[1]) > 0.9) && (std::abs(d[2]) > 0.9)) ? delta[0]*(1.0-delta[1]) : 0;
+	weights[2] = ((std::abs(d[0]) > 0.9) && (std::abs(d[2]) > 0.9)) ? (1.0-delta[0])*delta[1] : 0;
+	weights[3] = ((std::abs(d[0]) > 0.9) && (std::abs(d[1]) > 0.9) && (std::abs(d[2]) > 0.9)) ? (1.0-delta[0])*(1.0-delta[1]) : 0;
+	return weights;
+}
+
 Bound::Bound(int face, const Condition bcond, int target_proc)
 : face(face)
 , condition(bcond)
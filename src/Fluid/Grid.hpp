@@ -16,22 +16,64 @@
 #include "Torch/Constants.hpp"
 #include "Torch/Parameters.hpp"
 #include "GridCell.hpp"
+#include "HaloExchange.hpp"
 #include "PartitionManager.hpp"
 #include "GridCellCollection.hpp"
 
 class Boundary;
 
+enum class CellOrder : unsigned int {CAUSAL_WIND, CAUSAL_NON_WIND}; //!< Causally ordered lists of core cells (see Grid::getOrderedIndices).
+
+/**
+ * @class BoundarySlab
+ *
+ * @brief The ghost cells of a non-PARTITION Bound, each paired with the cell it is copied from and how every variable
+ * is transformed on the way.
+ *
+ * A copied variable is multiplied by its sign and then, if its clamp is +1 (-1), reflected to be non-negative
+ * (non-positive). This covers every condition: FREE and PERIODIC only copy, REFLECTING flips the normal velocity and
+ * INFLOW and OUTFLOW clamp it.
+ *
+ * @see Grid::buildBoundarySlabs
+ */
+class BoundarySlab {
+public:
+	std::vector<int> ghostIDs; //!< Ghost cells to fill, in the order of sourceIDs.
+	std::vector<int> sourceIDs; //!< Cell each of the ghost cells is copied from.
+	std::array<double, UID::N> sign; //!< Factor each variable is multiplied by when it is copied.
+	std::array<double, UID::N> clamp; //!< Sign each variable is reflected to (+1 or -1), or 0 to leave it.
+};
+
 class Bound {
 public:
 	int face;
 	Condition condition;
 	int targetProcessor;
+	bool wrapsAround = false; //!< PARTITION boundary across the periodic edge of the processor topology.
 	std::vector<int> ghostCellIDs;
-
+	PartitionManager partition; //!< Message buffers of the ray tracing pipelines across a PARTITION boundary.
+	BoundarySlab slab; //!< Ghost cell copies of a non-PARTITION boundary.
 
 	Bound(int face, const Condition bcond, int target_proc = 0);
 };
 
+/**
+ * @class RayTile
+ *
+ * @brief A block of the causally ordered GridCells that is ray traced in one go, so that its column densities can be
+ * passed on to the processors further from the star before the rest of the Grid has been traced.
+ *
+ * @see Grid::buildRayTiles
+ */
+class RayTile {
+public:
+	std::vector<int> windIDs; //!< CausalWind cells in the tile, in causal order and grouped by dependency level.
+	std::vector<int> nonWindIDs; //!< CausalNonWind cells in the tile, in causal order and grouped by dependency level.
+	std::vector<int> windLevels; //!< Start of each dependency level in windIDs, followed by windIDs.size().
+	std::vector<int> nonWindLevels; //!< Start of each dependency level in nonWindIDs, followed by nonWindIDs.size().
+	std::vector<std::vector<int>> ghostIDs; //!< Ghost cells of each Bound (indexed as Grid::getBoundaries) next to the tile.
+};
+
 /**
  * @class Grid
  *
@@ -45,8 +87,18 @@ class Grid {
 public:
 	std::vector<int> m_causalIndices; //!< List of indices of cells in causal order (necessary for ray-tracing).
 	std::vector<Bound> m_boundaries; //!< List of boundaries enclosing this Grid.
+	std::vector<RayTile> m_rayTiles; //!< Causally ordered blocks of cells, in the order they are ray traced.
 	std::array<int, 3> ncells = std::array<int, 3>{{ 1, 1, 1 }}; //!< Number of cells along each dimension simulated by all processing cores.
 	std::array<int, 3> coreCells = std::array<int, 3>{{ 1, 1, 1 }}; //!< Number of cells along each dimension, which are simulated by this processing core.
+	std::array<int, 3> coreOffset = std::array<int, 3>{{ 0, 0, 0 }}; //!< Grid coordinates of the corner of the part of the grid simulated by this processing core.
+	bool hasColumnDensities = false; //!< Whether the column densities of Thermodynamics (TID::COL_DEN) are up to date with the density field.
+	bool hasTracedColumnDensities = false; //!< Whether the column densities were traced for these cells and star position, through the density field of some earlier step if not the current one.
+	int rebuilds = 0; //!< Number of times the Grid was cleared to be initialised again, so per cell data kept elsewhere can tell its cell IDs are stale.
+	std::vector<int> xEdges; //!< Left edges of the processors' x slabs, then ncells[0], if the slabs are not of equal width.
+	std::vector<double> columnWork; //!< Work besides the cell updates (cooling subcycles) done in each x column of this processor's block, for the LoadBalancer.
+	std::vector<Vec3> leftFaceOverVolume; //!< Area of each core cell's left face along each dimension over its volume, indexed by GridCell::id.
+	std::vector<Vec3> rightFaceOverVolume; //!< Area of each core cell's right face along each dimension over its volume, indexed by GridCell::id.
+	std::vector<double> geometricRadius; //!< Radius dividing the pressure in the geometric source term of each core cell (CYLINDRICAL and SPHERICAL), indexed by GridCell::id.
 	std::array<double, 3> dx = std::array<double, 3>{{ 0, 0, 0 }}; //!< Cell widths in physical units (scaled to code units).
 	double sideLength = 0; //!< Length of the grid along the x-axis.
 	int spatialOrder = 0;
@@ -58,30 +110,50 @@ public:
 
 	// Initialise.
 	void initialise(std::shared_ptr<Constants> consts, const GridParameters& gp);
+	void clear();
 
 	// Update.
 	void applyBCs();
+	void applyBCsAsync();
+	void waitBCs();
+	void applySlab(const BoundarySlab& slab);
+	void applyStaticBCs();
 
 	// Getters/Setters.
 	GridCell& getCell(int id);
 	const GridCell& getCell(int id) const;
-	Looper getIterable(const std::string& name);
-	ConstLooper getIterable(const std::string& name) const;
-	const std::vector<GridCell>& getCells() const;
-	const std::vector<GridJoin>& getJoins(int dim) const;
-	std::vector<GridCell>& getCells();
-	std::vector<GridJoin>& getJoins(int dim);
-	PartitionManager& getPartitionManager();
+	RayGeometry& getRayGeometry(int id);
+	const RayGeometry& getRayGeometry(int id) const;
+	HeatArray& getHeating(int id);
+	const HeatArray& getHeating(int id) const;
+	bool storesRayData() const;
+	bool countsWork() const;
+	WorkArray& getWork(int id);
+	const WorkArray& getWork(int id) const;
+	void resetWork();
+	void storeGravity(bool on);
+	bool storesGravity() const;
+	GravArray& getGravity(int id);
+	const GravArray& getGravity(int id) const;
+	Looper getIterable(CellRange range);
+	ConstLooper getIterable(CellRange range) const;
+	FieldLooper getFieldIterable(CellRange range);
+	ConstFieldLooper getFieldIterable(CellRange range) const;
+	GridCellCollection& getCellCollection();
+	const GridCellVector& getCells() const;
+	const GridJoinVector& getJoins(int dim) const;
+	GridCellVector& getCells();
+	GridJoinVector& getJoins(int dim);
+	const std::vector<int>& getLexicographicIDs() const;
 	std::vector<int>& getCausalIndices();
-	std::vector<int>& getOrderedIndices(const std::string& name);
+	std::vector<int>& getOrderedIndices(CellOrder order);
 	std::vector<Bound>& getBoundaries();
-	int getLeftX() const;
-	int getRightX() const;
-	void setLeftX(int x);
-	void setRightX(int x);
+	std::vector<RayTile>& getRayTiles();
+	const HaloExchange& getHydroHalo() const;
 
 	// Queries.
 	bool cellExists(int id) const;
+	bool isPartitioned(int dim) const;
 
 	// Traversal.
 	int left(int dim, int fromCellID);
@@ -102,8 +174,6 @@ public:
 	Coords nearestCoord(const Coords& original);
 	bool joinExists(int dim, std::array<int, 3>& joinIDs);
 	bool withinGrid(const Coords& coords);
-	Coords nextSnakeCoords(const Coords& fromCoords, const Coords& sourceCoords, const int dxc, const int dyc, const int dyz);
-	Coords nextCausalCoords(const Coords& fromCoords, const Coords& sourceCoords);
 	int traverse1D(const int dim, const int dc, int fromCellID);
 	int traverse3D(const int d1, const int d2, const int d3, const int dc1, const int dc2, const int dc3, int fromCellID);
 	int traverseOverJoins1D(const int dim, const int dc, int fromCellID);
@@ -111,34 +181,49 @@ public:
 	int nextCell2D(const int plane, int fromCellID);
 	int nextSnake(int fromCellID, int sourceCellID, const int dxc, const int dyc, const int dyz, int nd);
 	int nextCausal(int fromCellID, int sourceCellID, int nd);
+	void getPencil(int dim, int j1, int j2, std::vector<int>& pencil);
+	void getPencil(int dim, int j1, int j2, int start, int end, std::vector<int>& pencil);
 
 	// Coord transform.
 	int flatIndex(int ci, int cj, int ck);
 	Coords unflatCoords(int flat_index);
 
 	// Creation.
-	void addOrderedIndex(const std::string& name, int index);
+	void addOrderedIndex(CellOrder order, int index);
 	void weakLink(const int dim, int lcellID, int rcellID);
 	void link(const int dim, int lcellID, int rcellID);
 	void boundaryLink(Bound& boundary);
 	void boundaryLinkDeeper(Bound& boundary);
+	void checkMemory(int ncore, int nghost, const GridParameters& gp) const;
 	void buildCells();
 	void buildCausal(const Coords& sourceCoords);
+	std::vector<int> causalOrder(const Coords& sourceCoords);
 	void buildBoundaries(const std::array<Condition, 3>& leftBC, const std::array<Condition, 3>& rightBC);
+	void buildBoundarySlabs();
+	void buildHaloExchange(bool useDatatypes, bool useCollective, bool useFloats);
+	void logHaloRounding();
+	void buildFluxCoefficients();
+	void buildRayTiles(const Coords& sourceCoords, int tileSize);
+	std::vector<RayTile> makeRayTiles(const Coords& sourceCoords, int tileSize, const std::vector<int>& windIDs, const std::vector<int>& nonWindIDs);
+	void buildRelay();
 	double computeCellVolume(double rc, const Vec3& dx, Geometry geometry, int nd);
 	double computeJoinArea(const Vec3& xj, const int dim, const Vec3& dx, Geometry geometry, int nd);
 	int getRayPlane(const Vec3& xc, const Vec3& xs) const;
 	void calculateNearestNeighbours(const std::array<double, 3>& star_pos);
+	void calculateNearestNeighbours(int index, const std::array<double, 3>& star_pos, RayGeometry& ray);
+	std::array<double, 4> neighbourWeights(const Vec3& xc, const Vec3& star_pos) const;
 
 private:
 	std::shared_ptr<Constants> m_consts = nullptr;
-	PartitionManager partition;
 	GridCellCollection m_cellCollection;
-	std::vector<GridCell>& m_cells = m_cellCollection.getCellVector();
-	std::map<std::string, std::vector<int>> orderedIndices;
-	std::array<std::vector<GridJoin>, 3> m_joins = std::array<std::vector<GridJoin>, 3>{{ std::vector<GridJoin>(), std::vector<GridJoin>(), std::vector<GridJoin>() }};
-	int m_leftX = 0;
-	int m_rightX = 0;
+	GridCellVector& m_cells = m_cellCollection.getCellVector();
+	std::array<std::vector<int>, 2> m_orderedIndices; //!< The cells of each CellOrder.
+	std::array<GridJoinVector, 3> m_joins = std::array<GridJoinVector, 3>{{ GridJoinVector(), GridJoinVector(), GridJoinVector() }};
+	bool m_haloPending = false; //!< Whether a halo exchange posted by applyBCsAsync has yet to be unpacked.
+	HaloExchange m_hydroHalo; //!< Exchange of the hydrodynamic variables of the PARTITION ghost cells.
+	HaloExchange m_staticHalo; //!< Exchange of the fields of the PARTITION ghost cells that only change with the initial conditions.
+	int m_brickSize = 0; //!< Number of cells along each side of the bricks the core cells are stored in (0 for x fastest, see flatIndex).
+	std::vector<int> m_lexicographicIDs; //!< IDs of the core cells in the order of their coordinates, x fastest.
 };
 
 
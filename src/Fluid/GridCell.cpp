@@ -8,23 +8,13 @@
  * @brief The default GridJoin constructor.
  * Provides all attributes with safe values.
  */
-GridJoin::GridJoin() {
-	for(int i = 0; i < UID::N; ++i)
-		F[i] = 0;
-}
+GridJoin::GridJoin() { }
 
 /**
  * @brief Default GridCell constructor.
  * Provides all attributes with safe values.
  */
 GridCell::GridCell() {
-	for (int dim = 0; dim < 3; ++dim) {
-		for (int iu = 0; iu < UID::N; ++iu) {
-			QL[dim][iu] = 0;
-			QR[dim][iu] = 0;
-		}
-		GRAV[dim] = 0;
-	}
 	for (int i = 0; i < UID::N; ++i) {
 		UDOT[i] = 0;
 		U[i] = 0;
@@ -35,8 +25,6 @@ GridCell::GridCell() {
 		R[i] = 0;
 	for (int i = 0; i < TID::N; ++i)
 		T[i] = 0;
-	for (int i = 0; i < HID::N; ++i)
-		H[i] = 0;
 }
 
 void GridCell::setSoundSpeed(double a) {
@@ -47,6 +35,18 @@ double GridCell::getSoundSpeed() const {
 	return m_soundSpeed;
 }
 
+void GridCell::setTemperature(double T) {
+	m_temperature = T;
+}
+
+/**
+ * @brief Gas temperature of the primitive variables, as found by Fluid::fixPrimitives, which every pass that brings
+ * GridCell::Q up to date ends with. The same as temperature(massFracH, specGasConst) until GridCell::Q next changes.
+ */
+double GridCell::getTemperature() const {
+	return m_temperature;
+}
+
 std::string GridCell::printCoords() const {
 	std::stringstream out;
 	out << xc[0] << ", " << xc[1] << ", " << xc[2] << '\n';
@@ -60,56 +60,25 @@ std::string GridCell::printInfo() const {
 	out << "xc[2] = " << xc[2] << '\n';
 	out << "den = " << Q[UID::DEN] << '\n';
 	out << "pre = " << Q[UID::PRE] << '\n';
-	out << "vel+0 = " << Q[UID::VEL+0] << '\n';
-	out << "vel+1 = " << Q[UID::VEL+1] << '\n';
-	out << "vel+2 = " << Q[UID::VEL+2] << '\n';
+	for (int dim = 0; dim < TORCH_MAX_DIMENSIONS; ++dim)
+		out << "vel+" << dim << " = " << Q[UID::VEL+dim] << '\n';
 	out << "hii = " << Q[UID::HII] << '\n';
 	out << "adv = " << Q[UID::ADV] << '\n';
 
-	for (int i = 0; i < 3; ++i)
-		out << "l_den[" << i << "] = " << QL[i][UID::DEN] << '\n';
-	for (int i = 0; i < 3; ++i)
-		out << "l_pre[" << i << "] = " << QL[i][UID::PRE] << '\n';
-	for (int j = 0; j < 3; ++j) {
-		for (int i = 0; i < 3; ++i)
-			out << "l_vel" << j << "[" << i << "] = " << QL[i][UID::VEL+j] << '\n';
-	}
-	for (int i = 0; i < 3; ++i)
-		out << "l_hii[" << i << "] = " << QL[i][UID::HII] << '\n';
-	for (int i = 0; i < 3; ++i)
-			out << "l_adv[" << i << "] = " << QL[i][UID::ADV] << '\n';
-
-	for (int i = 0; i < 3; ++i)
-		out << "r_den[" << i << "] = " << QR[i][UID::DEN] << '\n';
-	for (int i = 0; i < 3; ++i)
-		out << "r_pre[" << i << "] = " << QR[i][UID::PRE] << '\n';
-	for (int j = 0; j < 3; ++j) {
-		for (int i = 0; i < 3; ++i)
-			out << "r_vel" << j << "[" << i << "] = " << QR[i][UID::VEL+j] << '\n';
-	}
-	for (int i = 0; i < 3; ++i)
-		out << "r_hii[" << i << "] = " << QR[i][UID::HII] << '\n';
-	for (int i = 0; i < 3; ++i)
-		out << "r_adv[" << i << "] = " << QR[i][UID::ADV] << '\n';
-
 	out << "u_den = " << U[UID::DEN] << '\n';
 	out << "u_pre = " << U[UID::PRE] << '\n';
-	out << "u_vel+0 = " << U[UID::VEL+0] << '\n';
-	out << "u_vel+1 = " << U[UID::VEL+1] << '\n';
-	out << "u_vel+2 = " << U[UID::VEL+2] << '\n';
+	for (int dim = 0; dim < TORCH_MAX_DIMENSIONS; ++dim)
+		out << "u_vel+" << dim << " = " << U[UID::VEL+dim] << '\n';
 	out << "u_hii = " << U[UID::HII] << '\n';
 	out << "u_adv = " << U[UID::ADV] << '\n';
 	out << "heatCapacityRatio = " << heatCapacityRatio << '\n';
-	out << "tau = " << R[RID::TAU] << '\n';
-	out << "tau_a = " << R[RID::TAU_A] << '\n';
-	out << "dtau = " << R[RID::DTAU] << '\n';
-	out << "dtau_a = " << R[RID::DTAU_A] << '\n';
-	out << "NN[0] = " << neighbourIDs[0] << '\n';
-	out << "NN[1] = " << neighbourIDs[1] << '\n';
-	out << "NN[2] = " << neighbourIDs[2] << '\n';
-	out << "NN[3] = " << neighbourIDs[3] << '\n';
-	for (int i = 0; i < 4; ++i)
-		out << "NN_weights[" << i << "] = " << neighbourWeights[i] << '\n';
+	if (RADIATION_BUILT) {
+		out << "tau = " << R[RID::TAU] << '\n';
+		out << "tau_a = " << R[RID::TAU_A] << '\n';
+		out << "dtau = " << R[RID::DTAU] << '\n';
+		out << "dtau_a = " << R[RID::DTAU_A] << '\n';
+	}
+	out << "id = " << id << '\n';
 	for (int i = 0; i < 3; ++i)
 		out << "ljoinID[" << i << "] = " << ljoinID[i] << '\n';
 	for (int i = 0; i < 3; ++i)
@@ -122,6 +91,15 @@ std::string GridCell::printInfo() const {
 	return out.str();
 }
 
+std::string RayGeometry::printInfo() const {
+	std::stringstream out;
+	out << "ds = " << ds << '\n';
+	out << "shellVol = " << shellVol << '\n';
+	for (int i = 0; i < 4; ++i)
+		out << "NN[" << i << "] = " << neighbourIDs[i] << '\n';
+	return out.str();
+}
+
 /**
  * @brief Setter for GridCell::U.
  * @param index
@@ -160,55 +138,3 @@ double GridCell::temperature(const double massFracH, const double specGasConst)
 	return (Q[UID::PRE]/Q[UID::DEN])*(1.0/mu_inv)/specGasConst;
 }
 
-void UfromQ(FluidArray& u, const FluidArray& q, double gamma, int nd) {
-	double ke = 0;
-	u[UID::DEN] = q[UID::DEN];
-	for(int dim = 0; dim < nd; ++dim){
-		u[UID::VEL+dim] = q[UID::VEL+dim]*q[UID::DEN];
-		ke += 0.5*q[UID::DEN]*q[UID::VEL+dim]*q[UID::VEL+dim];
-	}
-	u[UID::PRE] = q[UID::PRE]/(gamma - 1.0) + ke;
-	u[UID::HII] = q[UID::HII]*q[UID::DEN];
-	u[UID::ADV] = q[UID::ADV]*q[UID::DEN];
-}
-
-void QfromU(FluidArray& q, const FluidArray& u, double gamma, int nd) {
-	q[UID::DEN] = u[UID::DEN];
-	double ke = 0;
-	for (int dim = 0; dim < nd; ++dim) {
-		q[UID::VEL+dim] = u[UID::VEL+dim]/u[UID::DEN];
-		ke += 0.5*u[UID::VEL+dim]*u[UID::VEL+dim]/u[UID::DEN];
-	}
-	q[UID::PRE] = (u[UID::PRE] - ke)*(gamma - 1.0);
-	q[UID::HII] = u[UID::HII]/u[UID::DEN];
-	q[UID::ADV] = u[UID::ADV]/u[UID::DEN];
-}
-
-void FfromU(FluidArray& f, const FluidArray& u, double gamma, int nd, int dim) {
-	f[UID::DEN] = u[UID::VEL+dim];
-	double ke = 0, pressure;
-	for(int id = 0; id < nd; ++id) {
-		f[UID::VEL+(dim+id)%nd] = u[UID::VEL+(dim+id)%nd]*u[UID::VEL+dim]/u[UID::DEN];
-		ke += 0.5*u[UID::VEL+id]*u[UID::VEL+id]/u[UID::DEN];
-	}
-	pressure = (u[UID::PRE] - ke)*(gamma - 1.0);
-	f[UID::VEL+dim] += pressure;
-	f[UID::PRE] = u[UID::VEL+dim]*(u[UID::PRE] + pressure)/u[UID::DEN];
-	f[UID::HII] = u[UID::VEL+dim]*u[UID::HII]/u[UID::DEN];
-	f[UID::ADV] = u[UID::VEL+dim]*u[UID::ADV]/u[UID::DEN];
-}
-void FfromQ(FluidArray& f, const FluidArray& q, double gamma, int nd, const int dim) {
-	f[UID::DEN] = q[UID::DEN]*q[UID::VEL+dim];
-	double ke = 0;
-	for(int id = 0; id < nd; ++id) {
-		ke += q[UID::VEL+id]*q[UID::VEL+id];
-		f[UID::VEL+(dim+id)%nd] = q[UID::DEN]*q[UID::VEL+(dim+id)%nd]*q[UID::VEL+dim];
-	}
-	ke *= 0.5*q[UID::DEN];
-	f[UID::VEL+dim] += q[UID::PRE];
-	double g2 = gamma/(gamma - 1.0);
-	f[UID::PRE] = q[UID::VEL+dim]*(g2*q[UID::PRE] + ke);
-	f[UID::HII] = q[UID::DEN]*q[UID::VEL+dim]*q[UID::HII];
-	f[UID::ADV] = q[UID::DEN]*q[UID::VEL+dim]*q[UID::ADV];
-}
-
@@ -23,21 +23,44 @@
 
 #include <array>
 #include <string>
+#include <vector>
 
+#include "Misc/FirstTouchAllocator.hpp"
 #include "Torch/Common.hpp"
 
-void UfromQ(FluidArray& u, const FluidArray& q, double gamma, int nd);
-void QfromU(FluidArray& q, const FluidArray& u, double gamma, int nd);
-void FfromQ(FluidArray& f, const FluidArray& u, double gamma, int nd, int dim);
-void FfromU(FluidArray& f, const FluidArray& u, double gamma, int nd, int dim);
-
 class GridJoin;
 class GridCell;
+
+/**
+ * @class RayGeometry
+ *
+ * @brief Cold per-cell data used only by the ray tracers in Radiation and Thermodynamics.
+ *
+ * Kept out of GridCell (in GridCellCollection, indexed by GridCell::id) so that the hydrodynamic sweeps do not stream it.
+ * The weights of the neighbours depend only on the position of the cell relative to the star, so the ray tracers
+ * recompute them as they go (see Grid::neighbourWeights) rather than storing them. Its distance from the star is stored,
+ * as every ray trace and heating calculation reads it, and set with the rest by Radiation::initField whenever the star
+ * moves.
+ */
+class RayGeometry {
+public:
+	StorageReal ds = 0; //!< Path length of the ray from the star through this GridCell.
+	StorageReal shellVol = 0; //!< Volume of the spherical shell of width ds centred on the star.
+	StorageReal dist2 = 0; //!< Squared distance of this GridCell from the star (cell widths squared).
+	StorageReal rsqrd = 0; //!< Squared distance of this GridCell from the star.
+	std::array<int, 4> neighbourIDs = std::array<int, 4> {{ -1, -1, -1, -1 }}; //!< the GridCell IDs (see Grid) of the neighbouring GridCells that are used to calculate this cell's optical depth.
+
+	std::string printInfo() const;
+};
+
 /**
  * @class GridCell
  *
  * @brief A GridCell holds fluid and radiation state information and geometric properties (volume, shell volume and cell path length).
  *
+ * Only the data touched every step lives here. Ray geometry (RayGeometry), heating diagnostics (HeatArray) and any stored
+ * gravitational force density (GravArray) are stored separately in GridCellCollection and looked up with GridCell::id.
+ *
  * @version 0.8, 24/11/2014
  */
 class GridCell {
@@ -46,25 +69,19 @@ public:
 	std::array<int, 3> ljoinID = std::array<int, 3> {{ -1, -1, -1 }}; //!< Contains pointers to GridJoins that lie on the left side of this GridCell.
 	std::array<int, 3> rightID = std::array<int, 3> {{ -1, -1, -1 }}; //!< Contains pointers to GridCells that lie on the right side of this GridCell.
 	std::array<int, 3> leftID = std::array<int, 3> {{ -1, -1, -1 }}; //!< Contains pointers to GridCells that lie on the left side of this GridCell.
-	std::array<double, 3> GRAV;
 	FluidArray UDOT; //!< Contains rate of change of conservative fluid variable values.
 	FluidArray U; //!< Contains conservative fluid variable values.
 	FluidArray Q; //!< Contains primitive fluid variable values.
 	FluidArray W; //!< Contains a copy of GridCell::U for 2nd order time-stepping.
 	RadArray R; //!< Contains radiation variable values: optical depth in cell and along path of the ray from source.
 	ThermoArray T; //!< Contains thermadynamic variable values.
-	HeatArray H;
 	Vec3 xc = Vec3{{ -10, -10, -10 }}; //!< Grid coordinates for this GridCell.
-	Array2D<double, 3, UID::N> QL; //!< Reconstructed states on left faces.
-	Array2D<double, 3, UID::N> QR; //!< Reconstructed states on right faces.
 	double vol = 0; //!< Volume of GridCell.
-	double ds = 0; //!< Length of segment of the ray that passed from the Star through the centre of this cell.
-	double shellVol = 0; //!< Volume of spherical shell with radius from Star to this GridCell and width this->ds.
 	double heatCapacityRatio = 0;
 	double m_soundSpeed = 0;
+	double m_temperature = 0; //!< Gas temperature of the primitive variables, as of the last Fluid::fixPrimitives of this cell.
 	double T_min = 0; //!< Minimum temperature of this cell set by initial conditions.
-	std::array<int, 4> neighbourIDs = std::array<int, 4> {{ -1, -1, -1, -1 }}; //!< the GridCell IDs (see Grid) of the neighbouring GridCells that are used to calculate this cell's optical depth.
-	std::array<double, 4> neighbourWeights = std::array<double, 4> {{ 0, 0, 0, 0 }}; //!< Weighting of each neighbouring cell's contribution to the optical depth to this cell.
+	int id = -1; //!< Index of this GridCell in its GridCellCollection, also used to look up its cold data.
 
 	// Structors.
 	GridCell();
@@ -80,6 +97,8 @@ public:
 	double get_U(const int index);
 	void setSoundSpeed(double a);
 	double getSoundSpeed() const;
+	void setTemperature(double T);
+	double getTemperature() const;
 
 	// Misc. methods.
 	double temperature(const double massFracH, const double specGasConst) const;
@@ -87,9 +106,9 @@ public:
 
 /**
  * @class GridJoin
- * @brief The GridJoin class contains flux information.
+ * @brief The GridJoin class describes the face between two GridCells.
  *
- * A GridJoin holds links to GridCells that lie either side of it and contains flux information. The GridCells either side of this will receive the flux in this GridJoin, which is calculated by the Riemann solver in the Hydro integrator.
+ * A GridJoin holds links to GridCells that lie either side of it, and nothing else. The fluxes through a face are not stored: Hydrodynamics::sweepPencils adds them to the neighbouring cells as soon as they are calculated. Nor is its area, which only Grid::buildFluxCoefficients needs and finds from the position of the cell.
  *
  * @see GridCell
  */
@@ -99,9 +118,64 @@ public:
 
 	int lcellID = -1; //!< Pointer to GridCell on the left.
 	int rcellID = -1; //!< Pointer to GridCell on the right.
-	FluidArray F; //!< Contains flux to be added to GridJoin::rcell and subtracted from GridJoin::lcell fluid variables (GridCell::U).
-	Vec3 xj = Vec3{{ 0, 0, 0 }}; //!< The grid coordinates of the GridJoin in a Grid.
-	double area = 0; //!< The area of the GridJoin.
 };
 
+// The conversions are inline so that they are compiled into the kernels that call them, including each instruction set
+// of a TORCH_KERNEL_CLONES kernel.
+inline void UfromQ(FluidArray& u, const FluidArray& q, double gamma, int nd) {
+	double ke = 0;
+	u[UID::DEN] = q[UID::DEN];
+	for(int dim = 0; dim < nd; ++dim){
+		u[UID::VEL+dim] = q[UID::VEL+dim]*q[UID::DEN];
+		ke += 0.5*q[UID::DEN]*q[UID::VEL+dim]*q[UID::VEL+dim];
+	}
+	u[UID::PRE] = q[UID::PRE]/(gamma - 1.0) + ke;
+	u[UID::HII] = q[UID::HII]*q[UID::DEN];
+	u[UID::ADV] = q[UID::ADV]*q[UID::DEN];
+}
+
+inline void QfromU(FluidArray& q, const FluidArray& u, double gamma, int nd) {
+	q[UID::DEN] = u[UID::DEN];
+	double ke = 0;
+	for (int dim = 0; dim < nd; ++dim) {
+		q[UID::VEL+dim] = u[UID::VEL+dim]/u[UID::DEN];
+		ke += 0.5*u[UID::VEL+dim]*u[UID::VEL+dim]/u[UID::DEN];
+	}
+	q[UID::PRE] = (u[UID::PRE] - ke)*(gamma - 1.0);
+	q[UID::HII] = u[UID::HII]/u[UID::DEN];
+	q[UID::ADV] = u[UID::ADV]/u[UID::DEN];
+}
+
+inline void FfromU(FluidArray& f, const FluidArray& u, double gamma, int nd, int dim) {
+	f[UID::DEN] = u[UID::VEL+dim];
+	double ke = 0, pressure;
+	for(int id = 0; id < nd; ++id) {
+		f[UID::VEL+(dim+id)%nd] = u[UID::VEL+(dim+id)%nd]*u[UID::VEL+dim]/u[UID::DEN];
+		ke += 0.5*u[UID::VEL+id]*u[UID::VEL+id]/u[UID::DEN];
+	}
+	pressure = (u[UID::PRE] - ke)*(gamma - 1.0);
+	f[UID::VEL+dim] += pressure;
+	f[UID::PRE] = u[UID::VEL+dim]*(u[UID::PRE] + pressure)/u[UID::DEN];
+	f[UID::HII] = u[UID::VEL+dim]*u[UID::HII]/u[UID::DEN];
+	f[UID::ADV] = u[UID::VEL+dim]*u[UID::ADV]/u[UID::DEN];
+}
+
+inline void FfromQ(FluidArray& f, const FluidArray& q, double gamma, int nd, const int dim) {
+	f[UID::DEN] = q[UID::DEN]*q[UID::VEL+dim];
+	double ke = 0;
+	for(int id = 0; id < nd; ++id) {
+		ke += q[UID::VEL+id]*q[UID::VEL+id];
+		f[UID::VEL+(dim+id)%nd] = q[UID::DEN]*q[UID::VEL+(dim+id)%nd]*q[UID::VEL+dim];
+	}
+	ke *= 0.5*q[UID::DEN];
+	f[UID::VEL+dim] += q[UID::PRE];
+	double g2 = gamma/(gamma - 1.0);
+	f[UID::PRE] = q[UID::VEL+dim]*(g2*q[UID::PRE] + ke);
+	f[UID::HII] = q[UID::DEN]*q[UID::VEL+dim]*q[UID::HII];
+	f[UID::ADV] = q[UID::DEN]*q[UID::VEL+dim]*q[UID::ADV];
+}
+
+using GridCellVector = std::vector<GridCell, FirstTouchAllocator<GridCell>>;
+using GridJoinVector = std::vector<GridJoin, FirstTouchAllocator<GridJoin>>;
+
 #endif // GRIDCELL_HPP_
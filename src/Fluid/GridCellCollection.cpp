@@ -8,114 +8,245 @@
 #include "GridCellCollection.hpp"
 #include "IO/Logger.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
-void GridCellCollection::start(const std::string& name) {
-	std::map<std::string, std::pair<int, int>>::iterator it = guards.find(name);
-	if (it == guards.end()) {
-		guardsStarted.push_back(name);
-		std::pair<int, int> newGuards;
-		newGuards.first = cells.size();
-		newGuards.second = cells.size();
-		guards[name] = newGuards;
+const int GridCellCollection::nranges;
+
+void GridCellCollection::start(CellRange range) {
+	unsigned int ir = (unsigned int)range;
+	if (!hasGuards[ir]) {
+		guardsStarted.push_back(range);
+		hasGuards[ir] = true;
+		guards[ir] = std::pair<int, int>(cells.size(), cells.size());
 	}
 }
 
 int GridCellCollection::add() {
 	cells.emplace_back();
-	for (const std::string& name : guardsStarted)
-		guards[name].second += 1;
+	cells.back().id = cells.size() - 1;
+	if (storingRayData) {
+		rayGeometry.emplace_back();
+		heating.emplace_back();
+		heating.back().fill(0);
+	}
+	if (countingWork)
+		work.push_back(WorkArray());
+	if (storingGravity)
+		gravity.push_back(GravArray());
+	for (CellRange range : guardsStarted)
+		guards[(unsigned int)range].second += 1;
 	return cells.size()-1;
 }
 
-void GridCellCollection::stop(const std::string& name) {
+/**
+ * @brief Adds n default GridCells at once, to every started iterable.
+ * @return ID of the first new GridCell (the rest follow it).
+ */
+int GridCellCollection::addMany(int n) {
+	int first = cells.size();
+	cells.resize(first + n);
+	if (storingRayData) {
+		rayGeometry.resize(first + n);
+		HeatArray zero;
+		zero.fill(0);
+		heating.resize(first + n, zero);
+	}
+	if (countingWork)
+		work.resize(first + n, WorkArray());
+	if (storingGravity)
+		gravity.resize(first + n, GravArray());
+	for (int id = first; id < first + n; ++id)
+		cells[id].id = id;
+	for (CellRange range : guardsStarted)
+		guards[(unsigned int)range].second += n;
+	return first;
+}
+
+/**
+ * @brief Reserves room for n GridCells, so adding up to n does not move them.
+ */
+void GridCellCollection::reserve(int n) {
+	cells.reserve(n);
+	if (storingRayData) {
+		rayGeometry.reserve(n);
+		heating.reserve(n);
+	}
+	if (countingWork)
+		work.reserve(n);
+	if (storingGravity)
+		gravity.reserve(n);
+}
+
+/**
+ * @brief Removes every GridCell and range, freeing their memory.
+ */
+void GridCellCollection::clear() {
+	GridCellVector().swap(cells);
+	std::vector<RayGeometry>().swap(rayGeometry);
+	std::vector<HeatArray>().swap(heating);
+	std::vector<WorkArray>().swap(work);
+	std::vector<GravArray>().swap(gravity);
+	guardsStarted.clear();
+	hasGuards.fill(false);
+	guards.fill(std::pair<int, int>(0, 0));
+}
+
+void GridCellCollection::stop(CellRange range) {
 	for (int i = guardsStarted.size() - 1; i >= 0; --i) {
-		if (guardsStarted[i] == name)
+		if (guardsStarted[i] == range)
 			guardsStarted.erase(guardsStarted.begin() + i);
 	}
 }
 
-std::vector<GridCell>& GridCellCollection::getCellVector() {
+GridCellVector& GridCellCollection::getCellVector() {
 	return cells;
 }
 
-Looper GridCellCollection::getIterable(const std::string& name) {
-	std::map<std::string, std::pair<int, int>>::iterator it = guards.find(name);
-	if (it != guards.end()) {
-		std::pair<int, int>& iterGuards = it->second;
-		return Looper(cells, iterGuards.first, iterGuards.second);
-	}
-	else {
-		Logger::Instance().print<SeverityType::WARNING>("GridCellCollection::getIteratable: invalid iterable: ", name, '\n');
-		return Looper(cells, 0, 0);
-	}
+/**
+ * @brief Turns the ray geometry and heating rates of the cells added from now on on or off. Only Radiation and
+ * Thermodynamics use them, so a run without either need not store them.
+ */
+void GridCellCollection::storeRayData(bool on) {
+	storingRayData = on;
 }
 
-Looper GridCellCollection::getIterable() {
-	return Looper(cells, 0, cells.size());
+bool GridCellCollection::storesRayData() const {
+	return storingRayData;
 }
 
-ConstLooper GridCellCollection::getIterable(const std::string& name) const {
-	std::map<std::string, std::pair<int, int>>::const_iterator it = guards.find(name);
-	if (it != guards.end()) {
-		std::pair<int, int>& iterGuards = (std::pair<int, int>&)it->second;
-		return ConstLooper(cells, iterGuards.first, iterGuards.second);
-	}
-	else {
-		Logger::Instance().print<SeverityType::WARNING>("GridCellCollection::getIteratable: invalid iterable: ", name, '\n');
-		return ConstLooper(cells, 0, 0);
-	}
+RayGeometry& GridCellCollection::getRayGeometry(int id) {
+	return rayGeometry[id];
 }
 
-ConstLooper GridCellCollection::getIterable() const {
-	return ConstLooper(cells, 0, cells.size());
+const RayGeometry& GridCellCollection::getRayGeometry(int id) const {
+	return rayGeometry[id];
 }
 
-ConstLooper::ConstLooper(const std::vector<GridCell>& cells, int startID, int endID)
-: m_cells(cells)
-, startID(startID)
-, endID(endID)
-{
+HeatArray& GridCellCollection::getHeating(int id) {
+	return heating[id];
+}
 
+/**
+ * @brief Gets the heating rates of a cell, which are zero if the cells do not store them (see storeRayData).
+ */
+const HeatArray& GridCellCollection::getHeating(int id) const {
+	static const HeatArray none = HeatArray();
+	return storingRayData ? heating[id] : none;
 }
 
-std::vector<GridCell>::const_iterator ConstLooper::begin() const {
-	return std::vector<GridCell>::const_iterator(m_cells.begin()+startID);
+/**
+ * @brief Turns the work counters of the cells added from now on on or off.
+ */
+void GridCellCollection::countWork(bool on) {
+	countingWork = on;
 }
-std::vector<GridCell>::const_iterator ConstLooper::cbegin() const {
-	return std::vector<GridCell>::const_iterator(m_cells.cbegin()+startID);
+
+bool GridCellCollection::countsWork() const {
+	return countingWork;
 }
-std::vector<GridCell>::const_iterator ConstLooper::end() const {
-	return std::vector<GridCell>::const_iterator(m_cells.begin()+endID);
+
+WorkArray& GridCellCollection::getWork(int id) {
+	return work[id];
 }
-std::vector<GridCell>::const_iterator ConstLooper::cend() const {
-	return std::vector<GridCell>::const_iterator(m_cells.cbegin()+endID);
+
+const WorkArray& GridCellCollection::getWork(int id) const {
+	return work[id];
 }
 
-Looper::Looper(std::vector<GridCell>& cells, int startID, int endID)
-: m_cells(cells)
-, startID(startID)
-, endID(endID)
-{
+/**
+ * @brief Zeroes the work counters of every cell.
+ */
+void GridCellCollection::resetWork() {
+	std::fill(work.begin(), work.end(), WorkArray());
+}
 
+/**
+ * @brief Turns the stored gravitational force densities on, zeroed for every cell there already is and kept for those
+ * added from now on, or off, freeing them. Only the FIELD gravity model reads them (see GravityField).
+ */
+void GridCellCollection::storeGravity(bool on) {
+	storingGravity = on;
+	if (on)
+		gravity.assign(cells.size(), GravArray());
+	else
+		std::vector<GravArray>().swap(gravity);
 }
 
-std::vector<GridCell>::iterator Looper::begin() {
-	return std::vector<GridCell>::iterator(m_cells.begin()+startID);
+bool GridCellCollection::storesGravity() const {
+	return storingGravity;
 }
-std::vector<GridCell>::const_iterator Looper::begin() const {
-	return std::vector<GridCell>::const_iterator(m_cells.begin()+startID);
+
+GravArray& GridCellCollection::getGravity(int id) {
+	return gravity[id];
 }
-std::vector<GridCell>::const_iterator Looper::cbegin() const {
-	return std::vector<GridCell>::const_iterator(m_cells.cbegin()+startID);
+
+const GravArray& GridCellCollection::getGravity(int id) const {
+	return gravity[id];
 }
-std::vector<GridCell>::iterator Looper::end() {
-	return std::vector<GridCell>::iterator(m_cells.begin()+endID);
+
+Looper GridCellCollection::getIterable(CellRange range) {
+	std::pair<int, int> iterGuards = getGuards(range);
+	return Looper(cells, iterGuards.first, iterGuards.second);
 }
-std::vector<GridCell>::const_iterator Looper::end() const {
-	return std::vector<GridCell>::const_iterator(m_cells.begin()+endID);
+
+Looper GridCellCollection::getIterable() {
+	return Looper(cells, 0, cells.size());
 }
-std::vector<GridCell>::const_iterator Looper::cend() const {
-	return std::vector<GridCell>::const_iterator(m_cells.cbegin()+endID);
+
+ConstLooper GridCellCollection::getIterable(CellRange range) const {
+	std::pair<int, int> iterGuards = getGuards(range);
+	return ConstLooper(cells, iterGuards.first, iterGuards.second);
 }
 
+ConstLooper GridCellCollection::getIterable() const {
+	return ConstLooper(cells, 0, cells.size());
+}
+
+std::pair<int, int> GridCellCollection::getGuards(CellRange range) const {
+	return guards[(unsigned int)range];
+}
+
+CellFieldArrays& GridCellCollection::getFieldArrays() {
+	fields.resize(cells.size());
+	return fields;
+}
+
+FieldLooper GridCellCollection::getFieldIterable(CellRange range) {
+	std::pair<int, int> iterGuards = getGuards(range);
+	fields.resize(cells.size());
+	return FieldLooper(fields, iterGuards.first, iterGuards.second);
+}
+
+ConstFieldLooper GridCellCollection::getFieldIterable(CellRange range) const {
+	std::pair<int, int> iterGuards = getGuards(range);
+	if (fields.size() != cells.size())
+		throw std::runtime_error("GridCellCollection::getFieldIterable: field arrays have not been packed.\n");
+	return ConstFieldLooper(fields, iterGuards.first, iterGuards.second);
+}
+
+void GridCellCollection::packFields(CellRange range, unsigned int mask) {
+	std::pair<int, int> iterGuards = getGuards(range);
+	fields.pack(cells, iterGuards.first, iterGuards.second, mask);
+}
+
+void GridCellCollection::unpackFields(CellRange range, unsigned int mask) {
+	std::pair<int, int> iterGuards = getGuards(range);
+	fields.resize(cells.size());
+	fields.unpack(cells, iterGuards.first, iterGuards.second, mask);
+}
+
+ConstLooper::ConstLooper(const GridCellVector& cells, int startID, int endID)
+: m_begin(cells.data() + startID)
+, m_end(cells.data() + endID)
+{
+
+}
+
+Looper::Looper(GridCellVector& cells, int startID, int endID)
+: m_begin(cells.data() + startID)
+, m_end(cells.data() + endID)
+{
+
+}
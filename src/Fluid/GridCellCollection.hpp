@@ -8,63 +8,125 @@
 #ifndef GRIDCELLCOLLECTION_HPP_
 #define GRIDCELLCOLLECTION_HPP_
 
-#include <map>
-#include <string>
+#include <array>
+#include <utility>
 #include <vector>
 
+#include "CellFieldArrays.hpp"
 #include "GridCell.hpp"
 
 class Looper;
 class ConstLooper;
 
+/**
+ * @brief Contiguous ranges of GridCell IDs, which are marked out with GridCellCollection::start and stop while the
+ * cells are added.
+ */
+enum class CellRange : unsigned int {ALL_CELLS, GRID_CELLS, GHOST_CELLS, GHOST_CELLS_X, GHOST_CELLS_Y, GHOST_CELLS_Z, DEEP_GHOST_CELLS};
+
+/**
+ * @brief The range of ghost cells of the boundaries along a dimension.
+ */
+inline CellRange ghostCellRange(int dim) {
+	return (CellRange)((unsigned int)CellRange::GHOST_CELLS_X + dim);
+}
+
 class GridCellCollection {
 public:
-	void start(const std::string& name);
-	void stop(const std::string& name);
+	static const int nranges = 7; //!< Number of CellRange values.
+
+	void start(CellRange range);
+	void stop(CellRange range);
 	int add();
-	std::vector<GridCell>& getCellVector();
+	int addMany(int n);
+	void reserve(int n);
+	void clear();
+	GridCellVector& getCellVector();
 
-	void addIndexOrder(const std::string& name, const std::vector<int>& order);
+	// Cold data.
+	void storeRayData(bool on);
+	bool storesRayData() const;
+	RayGeometry& getRayGeometry(int id);
+	const RayGeometry& getRayGeometry(int id) const;
+	HeatArray& getHeating(int id);
+	const HeatArray& getHeating(int id) const;
+	void countWork(bool on);
+	bool countsWork() const;
+	WorkArray& getWork(int id);
+	const WorkArray& getWork(int id) const;
+	void resetWork();
+	void storeGravity(bool on);
+	bool storesGravity() const;
+	GravArray& getGravity(int id);
+	const GravArray& getGravity(int id) const;
 
-	Looper getIterable(const std::string& name);
+	Looper getIterable(CellRange range);
 	Looper getIterable();
-	ConstLooper getIterable(const std::string& name) const;
+	ConstLooper getIterable(CellRange range) const;
 	ConstLooper getIterable() const;
 
+	// Structure-of-arrays mirror.
+	CellFieldArrays& getFieldArrays();
+	FieldLooper getFieldIterable(CellRange range);
+	ConstFieldLooper getFieldIterable(CellRange range) const;
+	void packFields(CellRange range, unsigned int mask);
+	void unpackFields(CellRange range, unsigned int mask);
+
 private:
-	std::vector<GridCell> cells;
-	std::vector<std::string> guardsStarted;
-	std::map<std::string, std::pair<int, int>> guards;
+	GridCellVector cells;
+	CellFieldArrays fields;
+	std::vector<RayGeometry> rayGeometry;
+	std::vector<HeatArray> heating;
+	bool storingRayData = true; //!< Whether the cells keep RayGeometry and HeatArrays.
+	std::vector<WorkArray> work; //!< Work counters of every cell, empty unless countingWork.
+	bool countingWork = false; //!< Whether the cells keep WorkArrays.
+	std::vector<GravArray> gravity; //!< Gravitational force density of every cell, empty unless storingGravity.
+	bool storingGravity = false; //!< Whether the cells keep GravArrays.
+	std::vector<CellRange> guardsStarted; //!< Ranges that grow as cells are added.
+	std::array<bool, nranges> hasGuards = std::array<bool, nranges>(); //!< Whether each range has been started.
+	std::array<std::pair<int, int>, nranges> guards = std::array<std::pair<int, int>, nranges>(); //!< First and one past the last ID of each range.
+
+	std::pair<int, int> getGuards(CellRange range) const;
 };
 
+/**
+ * @class ConstLooper
+ *
+ * @brief A contiguous range of GridCells, iterated over with plain pointers.
+ */
 class ConstLooper {
 public:
-	ConstLooper(const std::vector<GridCell>& cells, int startID, int endID);
+	ConstLooper(const GridCellVector& cells, int startID, int endID);
 
-	std::vector<GridCell>::const_iterator begin() const;
-	std::vector<GridCell>::const_iterator cbegin() const;
-	std::vector<GridCell>::const_iterator end() const;
-	std::vector<GridCell>::const_iterator cend() const;
+	const GridCell* begin() const { return m_begin; }
+	const GridCell* cbegin() const { return m_begin; }
+	const GridCell* end() const { return m_end; }
+	const GridCell* cend() const { return m_end; }
+	int size() const { return (int)(m_end - m_begin); }
 private:
-	const std::vector<GridCell>& m_cells;
-	int startID;
-	int endID;
+	const GridCell* m_begin;
+	const GridCell* m_end;
 };
 
+/**
+ * @class Looper
+ *
+ * @brief A contiguous range of GridCells, iterated over with plain pointers.
+ */
 class Looper {
 public:
-	Looper(std::vector<GridCell>& cells, int startID, int endID);
-
-	std::vector<GridCell>::iterator begin();
-	std::vector<GridCell>::const_iterator begin() const;
-	std::vector<GridCell>::const_iterator cbegin() const;
-	std::vector<GridCell>::iterator end();
-	std::vector<GridCell>::const_iterator end() const;
-	std::vector<GridCell>::const_iterator cend() const;
+	Looper(GridCellVector& cells, int startID, int endID);
+
+	GridCell* begin() { return m_begin; }
+	const GridCell* begin() const { return m_begin; }
+	const GridCell* cbegin() const { return m_begin; }
+	GridCell* end() { return m_end; }
+	const GridCell* end() const { return m_end; }
+	const GridCell* cend() const { return m_end; }
+	int size() const { return (int)(m_end - m_begin); }
 private:
-	std::vector<GridCell>& m_cells;
-	int startID;
-	int endID;
+	GridCell* m_begin;
+	GridCell* m_end;
 };
 
 
@@ -0,0 +1,82 @@
+#include "GridStatistics.hpp"
+
+#include "Grid.hpp"
+#include "GridCell.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @brief Registers a quantity to be reduced over the core cells of every processor.
+ * @return Index of the statistic, which GridStatistics::get takes.
+ */
+int GridStatistics::add(Reduction reduction, const Quantity& quantity) {
+	m_statistics.push_back(Statistic{reduction, quantity});
+	m_values.push_back(0);
+	m_slots.clear();
+	if (reduction == Reduction::SUM)
+		++m_nsums;
+	return (int)m_statistics.size() - 1;
+}
+
+/**
+ * @brief Evaluates every statistic over the core cells in a single pass and reduces them over the processors in a single
+ * reduction. Collective, and every processor must have registered the same statistics.
+ *
+ * A minimum is taken as the maximum of the negated quantity. The minimum and maximum of a Grid without cells are
+ * infinite.
+ */
+void GridStatistics::compute(const Grid& grid) {
+	const int n = size();
+	if (m_slots.empty()) {
+		int sum = 0, extreme = m_nsums;
+		for (const Statistic& statistic : m_statistics)
+			m_slots.push_back(statistic.reduction == Reduction::SUM ? sum++ : extreme++);
+	}
+	const double lowest = -std::numeric_limits<double>::infinity();
+	std::vector<double> local(n);
+	for (int i = 0; i < n; ++i)
+		local[m_slots[i]] = m_statistics[i].reduction == Reduction::SUM ? 0 : lowest;
+
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		for (int i = 0; i < n; ++i) {
+			const Statistic& statistic = m_statistics[i];
+			double& x = local[m_slots[i]];
+			switch (statistic.reduction) {
+			case Reduction::SUM:
+				x += statistic.quantity(cell);
+				break;
+			case Reduction::MIN:
+				x = std::max(x, -statistic.quantity(cell));
+				break;
+			case Reduction::MAX:
+				x = std::max(x, statistic.quantity(cell));
+				break;
+			}
+		}
+	}
+
+	const std::vector<double> global = MPIW::Instance().sumAndMaximum(local, m_nsums);
+	for (int i = 0; i < n; ++i)
+		m_values[i] = m_statistics[i].reduction == Reduction::MIN ? -global[m_slots[i]] : global[m_slots[i]];
+}
+
+/**
+ * @brief Gets the result of a statistic as of the last GridStatistics::compute.
+ * @exception std::runtime_error Thrown if index is not that of a registered statistic.
+ */
+double GridStatistics::get(int index) const {
+	if (index < 0 || index >= size())
+		throw std::runtime_error("GridStatistics::get: index(=" + std::to_string(index) + ") is not that of a registered statistic.");
+	return m_values[index];
+}
+
+/**
+ * @brief Gets the number of registered statistics.
+ */
+int GridStatistics::size() const {
+	return (int)m_statistics.size();
+}
@@ -0,0 +1,48 @@
+/** Provides the GridStatistics class.
+ *
+ * @file GridStatistics.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef GRIDSTATISTICS_HPP_
+#define GRIDSTATISTICS_HPP_
+
+#include <functional>
+#include <vector>
+
+class Grid;
+class GridCell;
+
+/**
+ * @class GridStatistics
+ *
+ * @brief Global sums, minima and maxima of quantities of the Grid's cells, measured together.
+ *
+ * A caller registers each quantity it needs, a function of a cell, along with how it is reduced and gets back the
+ * index of its result. GridStatistics::compute then evaluates every quantity over the core cells in a single pass and
+ * reduces all of them over the processors in a single MPIW::sumAndMaximum, so adding a statistic to the output, the
+ * telemetry or an output trigger costs neither another traversal of the Grid nor another collective.
+ */
+class GridStatistics {
+public:
+	enum class Reduction {SUM, MIN, MAX};
+	typedef std::function<double(const GridCell&)> Quantity; //!< A quantity of a core cell.
+
+	int add(Reduction reduction, const Quantity& quantity);
+	void compute(const Grid& grid);
+	double get(int index) const;
+	int size() const;
+
+private:
+	struct Statistic {
+		Reduction reduction;
+		Quantity quantity;
+	};
+	std::vector<Statistic> m_statistics; //!< Registered quantities, in the order they were added.
+	int m_nsums = 0; //!< Number of sums.
+	std::vector<int> m_slots; //!< Position of each statistic in the reduction, where the sums come first.
+	std::vector<double> m_values; //!< Result of each statistic as of the last compute.
+};
+
+#endif // GRIDSTATISTICS_HPP_
@@ -0,0 +1,281 @@
+/**
+ * Provides the HaloExchange class.
+ * @file HaloExchange.cpp
+ *
+ * @author Harrison Steggles
+ */
+
+#include "HaloExchange.hpp"
+#include "Grid.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+
+/**
+ * @brief Works out the cells exchanged with every neighbouring processor and sets up one persistent exchange with each.
+ *
+ * The faces shared with a neighbour are concatenated in the order of the face of the receiving processor they fill, so
+ * the two processors agree on the order of the message even when they share both faces along a dimension. Must be
+ * called once all of the ghost cells have been built, since the persistent requests hold on to the addresses of the
+ * cells or buffers.
+ * @param boundaries The Bounds of the Grid, whose PARTITION ones are exchanged.
+ * @param cells The cells of the Grid.
+ * @param fields Fields of the cells exchanged.
+ * @param channel Message sub-tag of the exchange, which tells it apart from the other phases' exchanges.
+ * @param useDatatypes Send and receive straight from the cells through MPI datatypes rather than packing buffers.
+ * @param useCollective Exchange with every neighbour in one neighbourhood collective rather than persistent requests,
+ * in which case every processor must initialise its exchanges in the same order. Collective if so.
+ * @param useFloats Pack the fields as floats, which are always packed into buffers whatever useDatatypes.
+ */
+void HaloExchange::initialise(const std::vector<Bound>& boundaries, GridCellVector& cells, const std::vector<Field>& fields,
+		int channel, bool useDatatypes, bool useCollective, bool useFloats) {
+	clear();
+	m_cells = &cells;
+	m_fields = fields;
+	m_useDatatypes = useDatatypes && !useFloats;
+	m_useFloats = useFloats;
+	for (const Field& field : fields)
+		m_itemsPerCell += field.length;
+
+	// The faces shared with each neighbour, by the face of the neighbour they are sent to and by their own face.
+	std::map<int, std::map<int, const Bound*>> sendFaces, recvFaces;
+	for (const Bound& boundary : boundaries) {
+		if (boundary.condition != Condition::PARTITION)
+			continue;
+		sendFaces[boundary.targetProcessor][(boundary.face + 3)%6] = &boundary;
+		recvFaces[boundary.targetProcessor][boundary.face] = &boundary;
+	}
+
+	m_neighbours.resize(sendFaces.size());
+	int ineighbour = 0;
+	for (const auto& faces : sendFaces) {
+		Neighbour& neighbour = m_neighbours[ineighbour++];
+		neighbour.rank = faces.first;
+		// A ghost cell's column of ghosts along the dimension of its face is filled from the column of core cells next to it.
+		auto addColumns = [&](const Bound& boundary, std::vector<int>& ids, bool core) {
+			const int dim = boundary.face%3;
+			const bool isLeft = boundary.face < 3;
+			const GridCell* base = cells.data();
+			for (int ghostCellID : boundary.ghostCellIDs) {
+				int currCellID = ghostCellID;
+				for (int currGhostID = ghostCellID; currGhostID != -1; currGhostID = isLeft ? base[currGhostID].leftID[dim] : base[currGhostID].rightID[dim]) {
+					currCellID = isLeft ? base[currCellID].rightID[dim] : base[currCellID].leftID[dim];
+					ids.push_back(core ? currCellID : currGhostID);
+				}
+			}
+		};
+		for (const auto& face : faces.second)
+			addColumns(*face.second, neighbour.sendIDs, true);
+		for (const auto& face : recvFaces[neighbour.rank])
+			addColumns(*face.second, neighbour.recvIDs, false);
+	}
+
+	MPIW& mpihandler = MPIW::Instance();
+	std::vector<std::ptrdiff_t> offsets;
+	std::vector<int> lengths;
+	for (const Field& field : fields) {
+		offsets.push_back(field.offset);
+		lengths.push_back(field.length);
+	}
+	if (useCollective) {
+		std::vector<int> ranks, sendTypes, recvTypes, sendCounts, recvCounts;
+		for (const Neighbour& neighbour : m_neighbours) {
+			ranks.push_back(neighbour.rank);
+			if (m_useDatatypes) {
+				sendTypes.push_back(mpihandler.createCellType(sizeof(GridCell), offsets, lengths, neighbour.sendIDs));
+				recvTypes.push_back(mpihandler.createCellType(sizeof(GridCell), offsets, lengths, neighbour.recvIDs));
+			}
+			sendCounts.push_back(bufferCount(neighbour.sendIDs.size()));
+			recvCounts.push_back(bufferCount(neighbour.recvIDs.size()));
+		}
+		if (m_useDatatypes)
+			m_collective = mpihandler.createNeighbourExchange(ranks, cells.data(), sendTypes, recvTypes);
+		else {
+			m_sendBuffer.assign(std::accumulate(sendCounts.begin(), sendCounts.end(), 0), 0);
+			m_recvBuffer.assign(std::accumulate(recvCounts.begin(), recvCounts.end(), 0), 0);
+			m_collective = mpihandler.createNeighbourExchange(ranks, m_sendBuffer.data(), sendCounts, m_recvBuffer.data(), recvCounts);
+		}
+		return;
+	}
+	for (Neighbour& neighbour : m_neighbours) {
+		if (m_useDatatypes) {
+			int sendType = mpihandler.createCellType(sizeof(GridCell), offsets, lengths, neighbour.sendIDs);
+			int recvType = mpihandler.createCellType(sizeof(GridCell), offsets, lengths, neighbour.recvIDs);
+			neighbour.partition.initialiseExchange(neighbour.rank, SendID::PARTITION_MSG, channel, channel, cells.data(), sendType, recvType);
+		}
+		else {
+			const int count = bufferCount(neighbour.sendIDs.size());
+			neighbour.partition.initialise(count);
+			neighbour.partition.initialiseExchange(neighbour.rank, SendID::PARTITION_MSG, channel, channel, count);
+		}
+	}
+}
+
+/**
+ * @brief Forgets every neighbour, e.g. before the Grid is rebuilt over a new partition.
+ */
+void HaloExchange::clear() {
+	m_neighbours.clear();
+	m_fields.clear();
+	m_itemsPerCell = 0;
+	m_useFloats = false;
+	m_isCheckingPrecision = false;
+	m_roundingErrors.clear();
+	m_cells = nullptr;
+	m_collective = -1;
+	m_sendBuffer.clear();
+	m_recvBuffer.clear();
+}
+
+/**
+ * @brief Gets the number of doubles of the buffer of the fields of a number of cells.
+ */
+int HaloExchange::bufferCount(std::size_t ncells) const {
+	const int values = (int)ncells*m_itemsPerCell;
+	return m_useFloats ? (values + 1)/2 : values;
+}
+
+/**
+ * @brief Gets the start of the block of fields packed for a neighbour.
+ */
+double* HaloExchange::getSendBuffer(int ineighbour) {
+	if (m_collective < 0)
+		return m_neighbours[ineighbour].partition.getSendBuffer();
+	double* buffer = m_sendBuffer.data();
+	for (int i = 0; i < ineighbour; ++i)
+		buffer += bufferCount(m_neighbours[i].sendIDs.size());
+	return buffer;
+}
+
+/**
+ * @brief Gets the start of the block of fields received from a neighbour.
+ */
+const double* HaloExchange::getRecvBuffer(int ineighbour) const {
+	if (m_collective < 0)
+		return m_neighbours[ineighbour].partition.getRecvBuffer();
+	const double* buffer = m_recvBuffer.data();
+	for (int i = 0; i < ineighbour; ++i)
+		buffer += bufferCount(m_neighbours[i].recvIDs.size());
+	return buffer;
+}
+
+/**
+ * @brief Packs the fields of the cells sent to every neighbour and starts the exchanges, which complete in the next
+ * MPIW::waitAll. Collective if the exchange is a neighbourhood collective.
+ */
+void HaloExchange::start() {
+	if (m_isCheckingPrecision)
+		m_roundingErrors.assign(m_itemsPerCell, 0);
+	for (unsigned int i = 0; i < m_neighbours.size(); ++i) {
+		Neighbour& neighbour = m_neighbours[i];
+		if (m_useFloats) {
+			float* buffer = reinterpret_cast<float*>(getSendBuffer(i));
+			for (int cellID : neighbour.sendIDs) {
+				const char* cell = reinterpret_cast<const char*>(&(*m_cells)[cellID]);
+				int item = 0;
+				for (const Field& field : m_fields) {
+					const double* values = reinterpret_cast<const double*>(cell + field.offset);
+					for (int j = 0; j < field.length; ++j, ++item) {
+						*buffer = (float)values[j];
+						if (m_isCheckingPrecision && values[j] != 0)
+							m_roundingErrors[item] = std::max(m_roundingErrors[item], std::abs((*buffer - values[j])/values[j]));
+						++buffer;
+					}
+				}
+			}
+		}
+		else if (!m_useDatatypes) {
+			double* buffer = getSendBuffer(i);
+			for (int cellID : neighbour.sendIDs) {
+				const char* cell = reinterpret_cast<const char*>(&(*m_cells)[cellID]);
+				for (const Field& field : m_fields) {
+					const double* values = reinterpret_cast<const double*>(cell + field.offset);
+					buffer = std::copy(values, values + field.length, buffer);
+				}
+			}
+		}
+		if (m_collective < 0)
+			neighbour.partition.startExchange();
+	}
+	if (m_collective >= 0)
+		MPIW::Instance().startNeighbourExchange(m_collective);
+}
+
+/**
+ * @brief Unpacks the fields received from every neighbour into the ghost cells, once MPIW::waitAll has returned.
+ */
+void HaloExchange::finish() {
+	if (m_useDatatypes)
+		return;
+	for (unsigned int i = 0; i < m_neighbours.size(); ++i) {
+		if (m_useFloats) {
+			const float* buffer = reinterpret_cast<const float*>(getRecvBuffer(i));
+			for (int ghostID : m_neighbours[i].recvIDs) {
+				char* cell = reinterpret_cast<char*>(&(*m_cells)[ghostID]);
+				for (const Field& field : m_fields) {
+					std::copy(buffer, buffer + field.length, reinterpret_cast<double*>(cell + field.offset));
+					buffer += field.length;
+				}
+			}
+			continue;
+		}
+		const double* buffer = getRecvBuffer(i);
+		for (int ghostID : m_neighbours[i].recvIDs) {
+			char* cell = reinterpret_cast<char*>(&(*m_cells)[ghostID]);
+			for (const Field& field : m_fields) {
+				std::copy(buffer, buffer + field.length, reinterpret_cast<double*>(cell + field.offset));
+				buffer += field.length;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Measures the rounding of the values packed by the next start, which takeRoundingErrors returns.
+ */
+void HaloExchange::checkPrecision() {
+	m_isCheckingPrecision = true;
+}
+
+/**
+ * @brief Whether a measurement of the rounding is waiting to be taken by takeRoundingErrors.
+ */
+bool HaloExchange::isCheckingPrecision() const {
+	return m_isCheckingPrecision;
+}
+
+/**
+ * @brief Gets the largest relative difference between each double of a cell's fields and the float it was sent as, over
+ * the cells sent at the exchange started after checkPrecision (all zero if the fields are sent as doubles or nothing
+ * was sent), and stops measuring.
+ */
+std::vector<double> HaloExchange::takeRoundingErrors() {
+	m_isCheckingPrecision = false;
+	std::vector<double> errors(m_itemsPerCell, 0);
+	if (m_roundingErrors.size() == errors.size())
+		errors = m_roundingErrors;
+	m_roundingErrors.clear();
+	return errors;
+}
+
+/**
+ * @brief Gets the number of messages an exchange sends, one per neighbouring processor (carried by one collective if
+ * the exchange is a neighbourhood collective).
+ */
+int HaloExchange::getMessageCount() const {
+	return (int)m_neighbours.size();
+}
+
+/**
+ * @brief Gets the number of doubles an exchange sends to all of the neighbouring processors together (half the number
+ * of values if they are sent as floats).
+ */
+long HaloExchange::getSendCount() const {
+	long count = 0;
+	for (const Neighbour& neighbour : m_neighbours)
+		count += bufferCount(neighbour.sendIDs.size());
+	return count;
+}
@@ -0,0 +1,85 @@
+/**
+ * Provides the HaloExchange class.
+ * @file HaloExchange.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef HALOEXCHANGE_HPP_
+#define HALOEXCHANGE_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include "GridCell.hpp"
+#include "PartitionManager.hpp"
+
+class Bound;
+
+/**
+ * @class HaloExchange
+ *
+ * @brief Exchanges a set of fields of the cells next to every PARTITION Bound with the neighbouring processors, in a
+ * single message per neighbouring processor whatever the number of faces it shares with this one.
+ *
+ * The cells each neighbour is sent, the ghost cells it fills and the order of both are worked out once, when the
+ * exchange is initialised, so an exchange only has to pack the fields, start the persistent requests and, once they
+ * have completed, unpack them. Each phase of a step that needs a halo (e.g. the hydrodynamic sweeps) has an exchange
+ * of its own, with its own fields and channel.
+ *
+ * The messages to the neighbours are either persistent point to point requests or a single neighbourhood collective
+ * over a graph of this processor's neighbours, which leaves the MPI library to schedule the transfers together.
+ *
+ * An exchange may pack its fields as floats, two to each double of the buffers, halving the bytes sent for ghost cells
+ * that only need to be accurate to single precision. The rounding of the values sent can be measured at an exchange
+ * (see checkPrecision), which is the difference the ghost cells see from an exchange of doubles.
+ */
+class HaloExchange {
+public:
+	/**
+	 * @brief A block of consecutive doubles of a GridCell exchanged in the halo.
+	 */
+	struct Field {
+		std::ptrdiff_t offset; //!< Offset of the first double in bytes from the start of a GridCell.
+		int length; //!< Number of doubles.
+	};
+
+	void initialise(const std::vector<Bound>& boundaries, GridCellVector& cells, const std::vector<Field>& fields, int channel,
+			bool useDatatypes, bool useCollective, bool useFloats = false);
+	void clear();
+	void start();
+	void finish();
+	void checkPrecision();
+	bool isCheckingPrecision() const;
+	std::vector<double> takeRoundingErrors();
+	int getMessageCount() const;
+	long getSendCount() const;
+private:
+	/**
+	 * @brief The cells exchanged with one neighbouring processor.
+	 */
+	struct Neighbour {
+		int rank = 0; //!< Rank of the neighbouring processor.
+		std::vector<int> sendIDs; //!< Core cells sent to the neighbour, in message order.
+		std::vector<int> recvIDs; //!< Ghost cells filled from the neighbour, in message order.
+		PartitionManager partition; //!< Buffers and persistent requests of the exchange.
+	};
+
+	GridCellVector* m_cells = nullptr; //!< Cells the IDs index into.
+	std::vector<Field> m_fields; //!< Fields exchanged.
+	int m_itemsPerCell = 0; //!< Number of doubles exchanged per cell.
+	bool m_useDatatypes = false; //!< Whether the fields are sent straight from the cells through MPI datatypes.
+	bool m_useFloats = false; //!< Whether the fields are packed as floats.
+	bool m_isCheckingPrecision = false; //!< Whether the next start measures the rounding of the packed floats.
+	std::vector<double> m_roundingErrors; //!< Largest relative rounding of each double of a cell at the measured exchange.
+	std::vector<Neighbour> m_neighbours; //!< Neighbouring processors, in order of rank.
+	int m_collective = -1; //!< Handle of the neighbourhood collective (-1 for persistent requests).
+	std::vector<double> m_sendBuffer; //!< Blocks sent to every neighbour by the neighbourhood collective, in order.
+	std::vector<double> m_recvBuffer; //!< Blocks received from every neighbour by the neighbourhood collective, in order.
+
+	int bufferCount(std::size_t ncells) const;
+	double* getSendBuffer(int ineighbour);
+	const double* getRecvBuffer(int ineighbour) const;
+};
+
+#endif // HALOEXCHANGE_HPP_
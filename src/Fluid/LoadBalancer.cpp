@@ -0,0 +1,99 @@
+#include "LoadBalancer.hpp"
+
+#include "Grid.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @param threshold Largest ratio of the slowest processor's time to the mean left alone (at least 1).
+ */
+void LoadBalancer::initialise(double threshold) {
+	if (threshold < 1)
+		throw std::runtime_error("LoadBalancer::initialise: rebalance_threshold(=" + std::to_string(threshold) + ") must be at least 1.");
+	m_threshold = threshold;
+}
+
+/**
+ * @brief Ratio of the slowest processor's time to the mean at the last check.
+ */
+double LoadBalancer::getImbalance() const {
+	return m_imbalance;
+}
+
+/**
+ * @brief Predicted ratio of the slowest processor's time to the mean for the slabs chosen at the last check.
+ */
+double LoadBalancer::getPredictedImbalance() const {
+	return m_predicted;
+}
+
+/**
+ * @brief Measures the balance of the work since the last check and chooses new x slabs if it is poor. Collective.
+ *
+ * Grid::columnWork is reset for the next check.
+ * @param grid The Grid.
+ * @param seconds Time this processor has spent computing since the last check (s).
+ * @param minWidth Fewest columns a slab may have (the depth of the ghost cells).
+ * @return Left edges of the new slabs, then the number of cells along x, or nothing if the Grid should be left alone.
+ */
+std::vector<int> LoadBalancer::partition(Grid& grid, double seconds, int minWidth) {
+	MPIW& mpihandler = MPIW::Instance();
+	const int nslabs = mpihandler.getDims()[0];
+	const int nx = grid.ncells[0];
+
+	// Share this processor's time out between its columns, by their cells and the extra work done in them.
+	const double columnCells = (double)grid.coreCells[1]*grid.coreCells[2];
+	double weight = 0;
+	for (double work : grid.columnWork)
+		weight += columnCells + work;
+	std::vector<double> cost(nx, 0);
+	for (int i = 0; i < grid.coreCells[0]; ++i)
+		cost[grid.coreOffset[0] + i] = seconds*(columnCells + grid.columnWork[i])/weight;
+	std::fill(grid.columnWork.begin(), grid.columnWork.end(), 0);
+
+	double maxSeconds = seconds, meanSeconds = seconds;
+	maxSeconds = mpihandler.maximum(maxSeconds);
+	meanSeconds = mpihandler.sum(meanSeconds)/mpihandler.nProcessors();
+	m_imbalance = (meanSeconds > 0) ? maxSeconds/meanSeconds : 1;
+	m_predicted = m_imbalance;
+	if (nslabs == 1)
+		return std::vector<int>();
+
+	// The cost of a column belongs to its place in the Grid, not to a processor, so it is averaged over the checks to
+	// stop a noisy measurement moving the slabs back and forth.
+	cost = mpihandler.sum(cost);
+	if (m_columnCost.size() == cost.size()) {
+		for (int ix = 0; ix < nx; ++ix)
+			cost[ix] = 0.5*(cost[ix] + m_columnCost[ix]);
+	}
+	m_columnCost = cost;
+	if (m_imbalance <= m_threshold || nx < nslabs*minWidth)
+		return std::vector<int>();
+
+	// Cut the running total of the cost into equal parts, keeping every slab at least minWidth wide.
+	std::vector<double> total(nx + 1, 0);
+	for (int ix = 0; ix < nx; ++ix)
+		total[ix + 1] = total[ix] + cost[ix];
+	std::vector<int> xEdges(nslabs + 1, 0);
+	xEdges[nslabs] = nx;
+	for (int islab = 1; islab < nslabs; ++islab) {
+		const double target = islab*total[nx]/nslabs;
+		int edge = std::lower_bound(total.begin(), total.end(), target) - total.begin();
+		if (edge > 0 && target - total[edge - 1] < total[edge] - target)
+			--edge;
+		xEdges[islab] = std::min(std::max(edge, xEdges[islab - 1] + minWidth), nx - (nslabs - islab)*minWidth);
+	}
+
+	double maxSlab = 0;
+	for (int islab = 0; islab < nslabs; ++islab)
+		maxSlab = std::max(maxSlab, total[xEdges[islab + 1]] - total[xEdges[islab]]);
+	// A migration that would remove less than a quarter of the excess is not worth its cost.
+	const double predicted = maxSlab/(total[nx]/nslabs);
+	if (predicted > 1 + 0.75*(m_imbalance - 1))
+		return std::vector<int>();
+	m_predicted = predicted;
+	return xEdges;
+}
@@ -0,0 +1,43 @@
+/** Provides the LoadBalancer class.
+ *
+ * @file LoadBalancer.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef LOADBALANCER_HPP_
+#define LOADBALANCER_HPP_
+
+#include <vector>
+
+class Grid;
+
+/**
+ * @class LoadBalancer
+ *
+ * @brief Chooses the x slabs of the Grid each processor simulates so that they take the same time to integrate.
+ *
+ * Cooling subcycles and the implicit ionisation fraction iterations make the cells near an ionisation front or a wind
+ * shell much more expensive than the rest, so slabs of equal width leave most processors waiting for the one holding
+ * the front. At each check the time every processor spent computing (excluding its waits for other processors) is
+ * shared out between its x columns by their cells plus the extra work recorded in Grid::columnWork, the costs of the
+ * columns are summed over the processors and averaged with the earlier checks, and the slab edges are moved to split
+ * the total evenly. The Grid is only repartitioned if the slowest processor is more than the threshold slower than the
+ * mean and the new slabs are predicted to be much better balanced, so the time step loop only pays for a migration
+ * that pays for itself.
+ */
+class LoadBalancer {
+public:
+	void initialise(double threshold);
+	std::vector<int> partition(Grid& grid, double seconds, int minWidth);
+	double getImbalance() const;
+	double getPredictedImbalance() const;
+
+private:
+	double m_threshold = 1.1; //!< Largest ratio of the slowest processor's time to the mean left alone.
+	double m_imbalance = 1; //!< Ratio of the slowest processor's time to the mean at the last check.
+	double m_predicted = 1; //!< Predicted ratio for the slabs chosen at the last check.
+	std::vector<double> m_columnCost; //!< Time taken by each x column, averaged over the checks (s).
+};
+
+#endif // LOADBALANCER_HPP_
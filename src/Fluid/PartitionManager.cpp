@@ -9,58 +9,133 @@
 
 #include <iostream>
 #include <stdexcept>
-
-
-PartitionManager::~PartitionManager() {
-	if (send_buffer)
-		delete[] send_buffer;
-	if (recv_buffer)
-		delete[] recv_buffer;
-}
+#include <string>
 
 void PartitionManager::initialise(int ncells) {
-	nelements = ncells;
-	send_buffer = new double[nelements];
-	recv_buffer = new double[nelements];
+	send_buffer.resize(ncells);
+	recv_buffer.resize(ncells);
+	m_recvData = recv_buffer.data();
 }
 
 void PartitionManager::resetBuffer() {
 	m_bufferCount = 0;
 	m_recvCount = 0;
 	m_sendCount = 0;
+	m_postedCount = 0;
 }
 
 void PartitionManager::addSendItem(double val) {
-	if (m_bufferCount < (int)nelements)
+	if (m_sendCount < (int)send_buffer.size())
 		send_buffer[m_sendCount++] = val;
 }
 
 double PartitionManager::getRecvItem() {
 	if (m_recvCount < m_bufferCount)
-		return recv_buffer[m_recvCount++];
+		return m_recvData[m_recvCount++];
 	else
 		throw std::runtime_error("PartitionManager::getRecvItem(): trying to receive item that doesn't exist.");
 }
 
-void PartitionManager::exchangeData(int destination, SendID tag) {
-	MPIW::Instance().exchange(send_buffer, recv_buffer, m_sendCount, destination, tag);
-	m_bufferCount = m_sendCount;
-	m_recvCount = 0;
-	m_sendCount = 0;
+/**
+ * @brief Gets the send buffer, so a persistent exchange set up with a count can be packed without bounds checks.
+ */
+double* PartitionManager::getSendBuffer() {
+	return send_buffer.data();
+}
+
+/**
+ * @brief Gets the receive buffer, which holds the items of the last completed buffered exchange.
+ */
+const double* PartitionManager::getRecvBuffer() const {
+	return recv_buffer.data();
 }
 
 void PartitionManager::sendData(int destination, SendID tag) {
-	MPIW::Instance().send(&m_sendCount, 1, destination, tag);
-	MPIW::Instance().send(send_buffer, m_sendCount, destination, tag);
+	MPIW::Instance().send(send_buffer.data(), m_sendCount, destination, tag);
 	m_sendCount = 0;
+	m_postedCount = 0;
 	m_recvCount = 0;
 	m_bufferCount = 0;
 }
 
-void PartitionManager::recvData(int source, SendID tag) {
+/**
+ * @brief Receives a message sent with sendData or postSendData. The number of items is taken from the message itself.
+ * @param source Rank of the sending processor.
+ * @param tag Message identification tag.
+ * @param channel Message sub-tag the message was posted with.
+ */
+void PartitionManager::recvData(int source, SendID tag, int channel) {
+	m_recvCount = 0;
+	m_bufferCount = MPIW::Instance().receive(recv_buffer.data(), (int)recv_buffer.size(), source, tag, channel);
+	m_recvData = recv_buffer.data();
+}
+
+/**
+ * @brief Non-blocking version of sendData, which may be matched by recvData.
+ *
+ * Only the items added since the last post (or resetBuffer) are sent, so a buffer can be filled and posted piece by
+ * piece. The posted items must not be overwritten, i.e. resetBuffer must not be called, before the next MPIW::waitAll.
+ * @param destination Rank of the receiving processor.
+ * @param tag Message identification tag.
+ * @param channel Message sub-tag, which tells apart pieces of the buffer with the same tag.
+ */
+void PartitionManager::postSendData(int destination, SendID tag, int channel) {
+	MPIW::Instance().postSend(send_buffer.data() + m_postedCount, m_sendCount - m_postedCount, destination, tag, channel);
+	m_postedCount = m_sendCount;
 	m_recvCount = 0;
-	MPIW::Instance().receive(&m_bufferCount, 1, source, tag);
-	MPIW::Instance().receive(recv_buffer, m_bufferCount, source, tag);
+	m_bufferCount = 0;
+}
+
+/**
+ * @brief Sets up a persistent exchange of a fixed number of buffered items with the processor on the other side of the
+ * boundary.
+ *
+ * Both processors must exchange the same number of items, which holds for the two sides of a partition boundary.
+ * @param destination Rank of the processor on the other side of the boundary.
+ * @param tag Message identification tag.
+ * @param sendChannel Channel the other processor receives on.
+ * @param recvChannel Channel this processor receives on.
+ * @param count Number of items exchanged each way.
+ * @exception std::runtime_error Thrown if count does not fit in the buffers.
+ */
+void PartitionManager::initialiseExchange(int destination, SendID tag, int sendChannel, int recvChannel, int count) {
+	if (count > (int)send_buffer.size() || count > (int)recv_buffer.size())
+		throw std::runtime_error("PartitionManager::initialiseExchange: " + std::to_string(count) + " items do not fit in the buffers.");
+	m_recvRequest = MPIW::Instance().createPersistentReceive(recv_buffer.data(), count, destination, tag, recvChannel);
+	m_sendRequest = MPIW::Instance().createPersistentSend(send_buffer.data(), count, destination, tag, sendChannel);
+	m_exchangeCount = count;
+}
+
+/**
+ * @brief Sets up a persistent exchange that sends and receives straight from an array through datatypes made by
+ * MPIW::createCellType, so nothing is copied through the buffers.
+ * @param base Start of the array the datatypes index into.
+ * @param sendType Handle of the datatype describing the items sent.
+ * @param recvType Handle of the datatype describing the items received.
+ * @see initialiseExchange
+ */
+void PartitionManager::initialiseExchange(int destination, SendID tag, int sendChannel, int recvChannel, void* base, int sendType, int recvType) {
+	m_recvRequest = MPIW::Instance().createPersistentReceive(base, recvType, destination, tag, recvChannel);
+	m_sendRequest = MPIW::Instance().createPersistentSend(base, sendType, destination, tag, sendChannel);
+	m_exchangeCount = 0;
+}
+
+/**
+ * @brief Starts the persistent exchange set up by initialiseExchange, which completes in the next MPIW::waitAll.
+ *
+ * For a buffered exchange the send buffer must already be packed.
+ * @exception std::runtime_error Thrown if initialiseExchange has not been called.
+ */
+void PartitionManager::startExchange() {
+	if (m_sendRequest == -1 || m_recvRequest == -1)
+		throw std::runtime_error("PartitionManager::startExchange: exchange has not been initialised.");
+	MPIW::Instance().start(m_recvRequest);
+	MPIW::Instance().start(m_sendRequest);
+	m_bufferCount = m_exchangeCount;
+	m_recvCount = 0;
+	m_sendCount = 0;
+	m_postedCount = 0;
+	m_recvData = recv_buffer.data();
 }
 
 int PartitionManager::getBufferCount() {
@@ -74,3 +149,111 @@ int PartitionManager::getSendCount() {
 int PartitionManager::getRecvCount() {
 	return m_recvCount;
 }
+
+/**
+ * @brief Gets the number of items the buffers hold.
+ */
+int PartitionManager::getCapacity() const {
+	return (int)send_buffer.size();
+}
+
+/**
+ * @brief Number of doubles of the receive regions of the one-sided relay of every processor.
+ * @param capacity Number of doubles of each region, the largest buffer of any boundary of any processor.
+ */
+long long PartitionManager::relayDataCount(int capacity) {
+	return 12*(long long)capacity;
+}
+
+/**
+ * @brief Number of signal slots of the one-sided relay of every processor.
+ * @param ntiles Number of RayTiles of every source.
+ */
+long long PartitionManager::relaySignalCount(int ntiles) {
+	return 6*(1 + 2*(long long)ntiles);
+}
+
+/**
+ * @brief Passes the ray tracing data across the boundary through the one-sided relay, which must be set up with
+ * MPIW::createRelay of relayDataCount(capacity) doubles and relaySignalCount(ntiles) slots, instead of messages.
+ * @param face Face of the Grid the boundary is on.
+ * @param capacity Number of doubles of each receive region, the same on every processor.
+ * @param ntiles Number of RayTiles of every source, the same on every processor.
+ * @exception std::runtime_error Thrown if the buffers do not fit in a receive region.
+ */
+void PartitionManager::initialiseRelay(int face, int capacity, int ntiles) {
+	if ((int)send_buffer.size() > capacity)
+		throw std::runtime_error("PartitionManager::initialiseRelay: " + std::to_string(send_buffer.size()) + " items do not fit in the relay.");
+	m_relayFace = face;
+	m_relayCapacity = capacity;
+	m_relayTiles = ntiles;
+	m_sweepsSent = 0;
+	m_sweepsReceived = 0;
+}
+
+/**
+ * @brief Whether the ray tracing data goes through the one-sided relay (see initialiseRelay).
+ */
+bool PartitionManager::hasRelay() const {
+	return m_relayFace >= 0;
+}
+
+long long PartitionManager::relayRegion(int face, long long sweep) const {
+	return (2*face + sweep%2)*(long long)m_relayCapacity;
+}
+
+long long PartitionManager::relaySlot(int face, long long sweep, int tile) const {
+	return face*(1 + 2*(long long)m_relayTiles) + 1 + (sweep%2)*m_relayTiles + tile;
+}
+
+long long PartitionManager::ackSlot(int face) const {
+	return face*(1 + 2*(long long)m_relayTiles);
+}
+
+/**
+ * @brief Relay version of postSendData: puts the items added since the last put (or resetBuffer) into the receiving
+ * processor's region and raises the tile's signal there, without the receiver taking part. The buffer may be reused
+ * as soon as this returns.
+ * @param destination Rank of the receiving processor.
+ * @param tile Index of the RayTile, 0 starting a sweep.
+ */
+void PartitionManager::putRelayData(int destination, int tile) {
+	MPIW& mpihandler = MPIW::Instance();
+	if (tile == 0) {
+		++m_sweepsSent;
+		if (m_sweepsSent > 2)
+			mpihandler.relayWait(ackSlot(m_relayFace), m_sweepsSent - 2);
+	}
+	const int face = (m_relayFace + 3)%6;
+	const int count = m_sendCount - m_postedCount;
+	mpihandler.relayPut(send_buffer.data() + m_postedCount, count, destination, relayRegion(face, m_sweepsSent) + m_postedCount);
+	mpihandler.relaySignal((m_sweepsSent << 32) + count, destination, relaySlot(face, m_sweepsSent, tile));
+	m_postedCount = m_sendCount;
+	m_recvCount = 0;
+	m_bufferCount = 0;
+}
+
+/**
+ * @brief Relay version of recvData: waits for the tile's signal and reads its items straight from the receive region.
+ * @param tile Index of the RayTile, 0 starting a sweep.
+ */
+void PartitionManager::getRelayData(int tile) {
+	MPIW& mpihandler = MPIW::Instance();
+	if (tile == 0) {
+		++m_sweepsReceived;
+		m_relayRead = 0;
+	}
+	const long long signal = mpihandler.relayWait(relaySlot(m_relayFace, m_sweepsReceived, tile), m_sweepsReceived << 32);
+	m_bufferCount = (int)(signal & 0xffffffffLL);
+	m_recvCount = 0;
+	m_recvData = mpihandler.relayBuffer() + relayRegion(m_relayFace, m_sweepsReceived) + m_relayRead;
+	m_relayRead += m_bufferCount;
+}
+
+/**
+ * @brief Tells the sending processor that every tile of the sweep has been read, so it may fill the region again.
+ * @param source Rank of the sending processor.
+ */
+void PartitionManager::finishRelay(int source) {
+	MPIW::Instance().relaySignal(m_sweepsReceived, source, ackSlot((m_relayFace + 3)%6));
+}
@@ -8,30 +8,71 @@
 #ifndef PARTITIONMANAGER_HPP_
 #define PARTITIONMANAGER_HPP_
 
+#include <vector>
+
 #include "MPI/MPI_Wrapper.hpp"
 
+/**
+ * @class PartitionManager
+ *
+ * @brief Send and receive buffers for the messages passed across one partition boundary of a Grid.
+ *
+ * The ray tracing data can instead go through the one-sided relay of MPIW (see initialiseRelay), which lays out the
+ * windows of every processor the same way: face f receives into two regions of capacity doubles, at (2f + p)*capacity
+ * for sweeps of parity p, and has 1 + 2*ntiles signal slots from f*(1 + 2*ntiles): the number of sweeps the processor
+ * across the face has finished reading, then a slot per sweep parity and RayTile raised to (sweep << 32) + count once
+ * the tile's count doubles are in place. Sweeps alternate between the regions, so a sender only waits for the receiver
+ * to finish reading the sweep before last.
+ */
 class PartitionManager {
 public:
-	~PartitionManager();
-
 	void initialise(int ncells);
+	void initialiseExchange(int destination, SendID tag, int sendChannel, int recvChannel, int count);
+	void initialiseExchange(int destination, SendID tag, int sendChannel, int recvChannel, void* base, int sendType, int recvType);
 
 	void resetBuffer();
 	void addSendItem(double val);
 	double getRecvItem();
+	double* getSendBuffer();
+	const double* getRecvBuffer() const;
 	void sendData(int destination, SendID tag);
-	void recvData(int source, SendID tag);
-	void exchangeData(int destination, SendID tag);
+	void recvData(int source, SendID tag, int channel = 0);
+	void postSendData(int destination, SendID tag, int channel = 0);
+	void startExchange();
 	int getBufferCount();
 	int getSendCount();
 	int getRecvCount();
+	int getCapacity() const;
+
+	// One-sided relay.
+	static long long relayDataCount(int capacity);
+	static long long relaySignalCount(int ntiles);
+	void initialiseRelay(int face, int capacity, int ntiles);
+	bool hasRelay() const;
+	void putRelayData(int destination, int tile);
+	void getRelayData(int tile);
+	void finishRelay(int source);
 private:
-	unsigned int nelements = 0;
 	int m_bufferCount = 0;
 	int m_recvCount = 0;
 	int m_sendCount = 0;
-	double* send_buffer = nullptr;
-	double* recv_buffer = nullptr;
+	int m_postedCount = 0; //!< Number of items in the send buffer already posted by postSendData.
+	int m_sendRequest = -1; //!< Persistent send set up by initialiseExchange.
+	int m_recvRequest = -1; //!< Persistent receive set up by initialiseExchange.
+	int m_exchangeCount = 0; //!< Number of buffered items in each persistent exchange (0 if exchanged through datatypes).
+	std::vector<double> send_buffer;
+	std::vector<double> recv_buffer;
+	const double* m_recvData = nullptr; //!< Items getRecvItem reads: the receive buffer, or a receive region of the relay.
+	int m_relayFace = -1; //!< Face of the Grid the boundary is on, if it uses the one-sided relay (-1 if not).
+	int m_relayCapacity = 0; //!< Number of doubles of each receive region of the relay.
+	int m_relayTiles = 0; //!< Number of RayTiles of every source.
+	long long m_sweepsSent = 0; //!< Number of sweeps that have put data across the boundary.
+	long long m_sweepsReceived = 0; //!< Number of sweeps that have read data from across the boundary.
+	int m_relayRead = 0; //!< Items of the current sweep read from the receive region so far.
+
+	long long relayRegion(int face, long long sweep) const;
+	long long relaySlot(int face, long long sweep, int tile) const;
+	long long ackSlot(int face) const;
 };
 
 
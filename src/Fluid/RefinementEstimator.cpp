@@ -0,0 +1,165 @@
+#include "RefinementEstimator.hpp"
+
+#include "Grid.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+#include "Torch/Common.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+
+/**
+ * @brief Position of a block along the Morton (Z-order) curve, found by interleaving the bits of its coordinates.
+ */
+std::uint64_t mortonKey(const std::array<int, 3>& block, int nd) {
+	std::uint64_t key = 0;
+	for (int bit = 0; bit < 21; ++bit) {
+		for (int dim = 0; dim < nd; ++dim)
+			key |= (std::uint64_t)((block[dim] >> bit) & 1) << (nd*bit + dim);
+	}
+	return key;
+}
+
+}
+
+/**
+ * @param nd Number of dimensions.
+ * @param blockSize Number of cells along each side of a block (at least 2).
+ * @param gradientThreshold Largest relative jump in density or pressure left unrefined (positive).
+ * @param hiiThreshold Ionisation fractions between this and one minus it are refined (between 0 and 0.5).
+ */
+void RefinementEstimator::initialise(int nd, int blockSize, double gradientThreshold, double hiiThreshold) {
+	if (blockSize < 2)
+		throw std::runtime_error("RefinementEstimator::initialise: refinement_block_size(=" + std::to_string(blockSize) + ") must be at least 2.");
+	if (gradientThreshold <= 0)
+		throw std::runtime_error("RefinementEstimator::initialise: refinement_gradient(=" + std::to_string(gradientThreshold) + ") must be positive.");
+	if (hiiThreshold <= 0 || hiiThreshold >= 0.5)
+		throw std::runtime_error("RefinementEstimator::initialise: refinement_hii(=" + std::to_string(hiiThreshold) + ") must lie between 0 and 0.5.");
+	m_nd = nd;
+	m_blockSize = blockSize;
+	m_gradientThreshold = gradientThreshold;
+	m_hiiThreshold = hiiThreshold;
+}
+
+/**
+ * @brief Number of cells along each side of a block.
+ */
+int RefinementEstimator::getBlockSize() const {
+	return m_blockSize;
+}
+
+/**
+ * @brief Number of blocks in the Grid at the last estimate.
+ */
+int RefinementEstimator::getBlockCount() const {
+	return m_blockCount;
+}
+
+/**
+ * @brief Number of blocks flagged for refinement at the last estimate.
+ */
+int RefinementEstimator::getFlaggedCount() const {
+	return m_flaggedCount;
+}
+
+/**
+ * @brief Cells of the two level mesh over the cells of the Grid refined uniformly to the same resolution.
+ */
+double RefinementEstimator::getCellRatio() const {
+	return m_cellRatio;
+}
+
+/**
+ * @brief Ratio of the slowest processor's cells to the mean if the blocks were dealt out along the Morton curve.
+ */
+double RefinementEstimator::getMortonImbalance() const {
+	return m_mortonImbalance;
+}
+
+/**
+ * @brief Relative jump |Q(i+1) - Q(i-1)|/(Q(i+1) + Q(i-1)) of a primitive variable across a cell.
+ */
+double RefinementEstimator::relativeJump(const Grid& grid, int cellID, int dim, int var) const {
+	const GridCell& cell = grid.getCell(cellID);
+	if (cell.leftID[dim] == -1 || cell.rightID[dim] == -1)
+		return 0;
+	const double ql = grid.getCell(cell.leftID[dim]).Q[var];
+	const double qr = grid.getCell(cell.rightID[dim]).Q[var];
+	return (ql + qr > 0) ? std::fabs(qr - ql)/(ql + qr) : 0;
+}
+
+bool RefinementEstimator::needsRefinement(const Grid& grid, int cellID) const {
+	const double hii = grid.getCell(cellID).Q[UID::HII];
+	if (hii > m_hiiThreshold && hii < 1 - m_hiiThreshold)
+		return true;
+	for (int dim = 0; dim < m_nd; ++dim) {
+		if (relativeJump(grid, cellID, dim, UID::DEN) > m_gradientThreshold || relativeJump(grid, cellID, dim, UID::PRE) > m_gradientThreshold)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Flags the blocks of the Grid that need refining and estimates the saving of a refined mesh. Collective.
+ * @param grid The Grid, whose ghost cells are used as the last step left them.
+ */
+void RefinementEstimator::estimate(const Grid& grid) {
+	MPIW& mpihandler = MPIW::Instance();
+	std::array<int, 3> nblocks = std::array<int, 3>{{ 1, 1, 1 }};
+	for (int dim = 0; dim < m_nd; ++dim)
+		nblocks[dim] = (grid.ncells[dim] + m_blockSize - 1)/m_blockSize;
+	const int nb = nblocks[0]*nblocks[1]*nblocks[2];
+
+	// The cells of each block and the number of them that need refining, summed over the processors.
+	std::vector<double> cells(2*nb, 0);
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		int ib = 0;
+		for (int dim = m_nd - 1; dim >= 0; --dim)
+			ib = ib*nblocks[dim] + (int)std::floor(cell.xc[dim])/m_blockSize;
+		cells[2*ib] += 1;
+		if (needsRefinement(grid, cell.id))
+			cells[2*ib + 1] += 1;
+	}
+	cells = mpihandler.sum(cells);
+
+	// Each refined block holds its coarse cells and 2^nd - 1 times as many fine ones.
+	const int factor = 1 << m_nd;
+	std::vector<std::pair<std::uint64_t, double>> curve;
+	curve.reserve(nb);
+	double total = 0, meshCells = 0;
+	m_flaggedCount = 0;
+	for (int ib = 0; ib < nb; ++ib) {
+		const bool flagged = cells[2*ib + 1] > 0;
+		const double cost = cells[2*ib]*(flagged ? factor : 1);
+		m_flaggedCount += flagged;
+		total += cells[2*ib];
+		meshCells += cost;
+		const std::array<int, 3> block = std::array<int, 3>{{ ib % nblocks[0], (ib/nblocks[0]) % nblocks[1], ib/(nblocks[0]*nblocks[1]) }};
+		curve.push_back(std::make_pair(mortonKey(block, m_nd), cost));
+	}
+	m_blockCount = nb;
+	m_cellRatio = (total > 0) ? meshCells/(total*factor) : 1;
+
+	// Deal the blocks out along the curve, starting a new processor once its share of the cost is reached.
+	std::sort(curve.begin(), curve.end());
+	const int nproc = mpihandler.nProcessors();
+	const double mean = meshCells/nproc;
+	double slowest = 0, load = 0, assigned = 0;
+	int iproc = 0;
+	for (const std::pair<std::uint64_t, double>& block : curve) {
+		if (iproc < nproc - 1 && load > 0 && assigned + load + 0.5*block.second > (iproc + 1)*mean) {
+			slowest = std::max(slowest, load);
+			assigned += load;
+			load = 0;
+			++iproc;
+		}
+		load += block.second;
+	}
+	slowest = std::max(slowest, load);
+	m_mortonImbalance = (mean > 0) ? slowest/mean : 1;
+}
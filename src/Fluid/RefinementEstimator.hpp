@@ -0,0 +1,53 @@
+/** Provides the RefinementEstimator class.
+ *
+ * @file RefinementEstimator.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef REFINEMENTESTIMATOR_HPP_
+#define REFINEMENTESTIMATOR_HPP_
+
+#include <vector>
+
+class Grid;
+
+/**
+ * @class RefinementEstimator
+ *
+ * @brief Measures how much of the Grid a block-structured adaptive mesh would refine, and what it would save.
+ *
+ * The Grid is split into cubes of blockSize cells along each dimension, and a block is flagged if any of its cells
+ * has a density or pressure jump between its neighbours larger than the gradient threshold, or an ionisation fraction
+ * between the HII threshold and one minus it (an ionisation front). A two level mesh that refines the flagged blocks by
+ * two along each dimension is then compared against refining the whole uniform Grid to the same resolution, and the
+ * balance of the block costs dealt out along their Morton (Z-order) curve to the processors is estimated.
+ *
+ * TORCH itself still integrates a single uniform Grid: the estimate only tells a run whether its fronts and shells are
+ * compact enough for a refined mesh to pay for itself.
+ */
+class RefinementEstimator {
+public:
+	void initialise(int nd, int blockSize, double gradientThreshold, double hiiThreshold);
+	void estimate(const Grid& grid);
+	int getBlockSize() const;
+	int getBlockCount() const;
+	int getFlaggedCount() const;
+	double getCellRatio() const;
+	double getMortonImbalance() const;
+
+private:
+	int m_nd = 1; //!< Number of dimensions.
+	int m_blockSize = 16; //!< Number of cells along each side of a block.
+	double m_gradientThreshold = 0.1; //!< Largest relative jump in density or pressure left unrefined.
+	double m_hiiThreshold = 0.05; //!< Ionisation fractions between this and one minus it are refined.
+	int m_blockCount = 0; //!< Number of blocks in the Grid at the last estimate.
+	int m_flaggedCount = 0; //!< Number of blocks flagged for refinement at the last estimate.
+	double m_cellRatio = 1; //!< Cells of the two level mesh over the cells of the uniformly refined Grid.
+	double m_mortonImbalance = 1; //!< Ratio of the slowest processor's cells to the mean for a Morton partition of the blocks.
+
+	bool needsRefinement(const Grid& grid, int cellID) const;
+	double relativeJump(const Grid& grid, int cellID, int dim, int var) const;
+};
+
+#endif // REFINEMENTESTIMATOR_HPP_
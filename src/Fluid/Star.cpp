@@ -4,13 +4,16 @@
 #include <array>
 #include <cmath>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
 
 #include "MPI/MPI_Wrapper.hpp"
 #include "Torch/Constants.hpp"
 #include "GridCell.hpp"
 #include "Grid.hpp"
 
-void Star::initialise(std::shared_ptr<Constants> c, StarParameters sp, Location containing_core, const Vec3& delta_x) {
+void Star::initialise(std::shared_ptr<Constants> c, StarParameters sp, const Locations& containing_core, const Vec3& delta_x) {
 	consts = std::move(c);
 
 	std::array<double, 3> mod;
@@ -34,20 +37,115 @@ void Star::initialise(std::shared_ptr<Constants> c, StarParameters sp, Location
 	photonEnergy = sp.photonEnergy;
 	photonRate = sp.photonRate;
 	windCellRadius = sp.windCellRadius;
+	windSubsamples = sp.windSubsamples;
+	windBoundary = sp.windBoundary;
 	massLossRate = sp.massLossRate;
 	windVelocity = sp.windVelocity;
 	windTemperature = sp.windTemperature;
+	for (int i = 0; i < consts->nd; ++i) {
+		velocity[i] = sp.velocity[i];
+		if (velocity[i] != 0 && mod[i] != 0)
+			throw std::runtime_error("Star::initialise: a star snapped to a face cannot move away from it (velocity along dimension " + std::to_string(i) + ").");
+	}
+}
+
+/**
+ * @brief Whether the Star is inside (or on the edge of) this processor's part of the Grid.
+ */
+bool Star::isHere() const {
+	for (Location location : core) {
+		if (location != Location::HERE)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Whether the Star moves through the Grid.
+ */
+bool Star::isMoving() const {
+	return velocity[0] != 0 || velocity[1] != 0 || velocity[2] != 0;
 }
 
+/**
+ * @brief Whether rays from the Star enter this processor's part of the Grid through a PARTITION boundary, in which case
+ * the column densities on the boundary have to be received before ray tracing.
+ */
+bool Star::isUpstream(const Bound& boundary) const {
+	if (boundary.condition != Condition::PARTITION || boundary.wrapsAround)
+		return false;
+	Location location = core[boundary.face%3];
+	return boundary.face < 3 ? location == Location::LEFT : location == Location::RIGHT;
+}
+
+/**
+ * @brief Whether rays from the Star leave this processor's part of the Grid through a PARTITION boundary, in which case
+ * the column densities next to the boundary have to be sent on after ray tracing.
+ */
+bool Star::isDownstream(const Bound& boundary) const {
+	return boundary.condition == Condition::PARTITION && !boundary.wrapsAround && !isUpstream(boundary);
+}
+
+/**
+ * @brief Fraction of a cell inside the sphere of windCellRadius around the Star, measured at windSubsamples points
+ * along each dimension of the cell.
+ */
+double Star::windFraction(const GridCell& cell) const {
+	const int n = windSubsamples;
+	const int nd = consts->nd;
+	const int npoints = (nd == 1) ? n : ((nd == 2) ? n*n : n*n*n);
+	int inside = 0;
+	for (int ipoint = 0; ipoint < npoints; ++ipoint) {
+		double dist2 = 0;
+		for (int idim = 0, k = ipoint; idim < nd; ++idim, k /= n) {
+			double x = cell.xc[idim] - 0.5 + (k % n + 0.5)/n - xc[idim];
+			dist2 += x*x;
+		}
+		if (dist2 <= windCellRadius*windCellRadius)
+			++inside;
+	}
+	return (double)inside/npoints;
+}
+
+/**
+ * @brief Shares the mass loss rate out between the CAUSAL_WIND cells, by their volume and, if windSubsamples is set,
+ * the fraction of each inside the wind radius. Collective.
+ *
+ * The volumes of the wind cells are gathered and summed in the order of their grid coordinates, so the rates do not
+ * depend on how the wind is split between processors.
+ */
 void Star::setWindCells(Grid& grid) {
-	double volume = 0;
+	const std::vector<int>& windIDs = grid.getOrderedIndices(CellOrder::CAUSAL_WIND);
+	windWeights.clear();
+	if (windSubsamples > 0 && windCellRadius > 0) {
+		for (int cellID : windIDs)
+			windWeights.push_back(windFraction(grid.getCell(cellID)));
+	}
 
-	for (int cellID : grid.getOrderedIndices("CausalWind"))
-		volume += grid.getCell(cellID).vol;
-	volume = MPIW::Instance().sum(volume);
+	// Pairs of the global index and weighted volume of each wind cell.
+	std::vector<double> local;
+	local.reserve(2*windIDs.size());
+	for (std::size_t i = 0; i < windIDs.size(); ++i) {
+		const GridCell& cell = grid.getCell(windIDs[i]);
+		local.push_back(((double)(int)cell.xc[2]*grid.ncells[1] + (int)cell.xc[1])*grid.ncells[0] + (int)cell.xc[0]);
+		local.push_back((windWeights.empty() ? 1 : windWeights[i])*cell.vol);
+	}
+	MPIW& mpihandler = MPIW::Instance();
+	const std::vector<double> all = mpihandler.exchange(std::vector<std::vector<double>>(mpihandler.nProcessors(), local));
+	std::vector<std::pair<double, double>> volumes;
+	volumes.reserve(all.size()/2);
+	for (std::size_t i = 0; i + 1 < all.size(); i += 2)
+		volumes.emplace_back(all[i], all[i + 1]);
+	std::sort(volumes.begin(), volumes.end());
+	double volume = 0;
+	for (const std::pair<double, double>& cell : volumes)
+		volume += cell.second;
 
 	mdot = massLossRate/volume;
 	edot = 0.5*mdot*windVelocity*windVelocity;
+	// The wind of a moving star carries the star's momentum and kinetic energy too.
+	if (isMoving())
+		edot += 0.5*mdot*(velocity[0]*velocity[0] + velocity[1]*velocity[1] + velocity[2]*velocity[2]);
 }
 
 int Star::getWindCellRadius() const {
@@ -56,20 +154,28 @@ int Star::getWindCellRadius() const {
 
 void Star::injectEnergyMomentum(Grid& grid) {
 	if (mdot != 0) {
-		for (int cellID : grid.getOrderedIndices("CausalWind")) {
-			GridCell& cell = grid.getCell(cellID);
-
-			cell.UDOT[UID::DEN] += mdot;
-			cell.UDOT[UID::PRE] += edot;
-			cell.UDOT[UID::HII] += (cell.U[UID::HII]/cell.U[UID::DEN])*mdot;
-			cell.UDOT[UID::ADV] += mdot;
+		const std::vector<int>& windIDs = grid.getOrderedIndices(CellOrder::CAUSAL_WIND);
+		for (std::size_t i = 0; i < windIDs.size(); ++i) {
+			GridCell& cell = grid.getCell(windIDs[i]);
+			const double weight = windWeights.empty() ? 1 : windWeights[i];
+			if (weight == 0)
+				continue;
+
+			cell.UDOT[UID::DEN] += weight*mdot;
+			cell.UDOT[UID::PRE] += weight*edot;
+			cell.UDOT[UID::HII] += (cell.U[UID::HII]/cell.U[UID::DEN])*weight*mdot;
+			cell.UDOT[UID::ADV] += weight*mdot;
+			if (isMoving()) {
+				for (int idim = 0; idim < consts->nd; ++idim)
+					cell.UDOT[UID::VEL+idim] += weight*mdot*velocity[idim];
+			}
 		}
 	}
 }
 
 void Star::fixDensityPressure(Grid& grid) {
 	if (mdot != 0) {
-		for (int cellID : grid.getOrderedIndices("CausalWind")) {
+		for (int cellID : grid.getOrderedIndices(CellOrder::CAUSAL_WIND)) {
 			GridCell& cell = grid.getCell(cellID);
 
 			double dist2 = 0;
@@ -93,3 +199,17 @@ void Star::fixDensityPressure(Grid& grid) {
 	}
 }
 
+/**
+ * @brief Holds the CAUSAL_WIND cells at the state of the free wind as an internal boundary: sets their conserved
+ * variables (see fixDensityPressure) and drops their rates of change, so the advance of the step leaves them there.
+ *
+ * Called in place of injectEnergyMomentum once the fluxes and source terms of a hydrodynamic (sub-)step are summed.
+ */
+void Star::holdWind(Grid& grid) {
+	fixDensityPressure(grid);
+	for (int cellID : grid.getOrderedIndices(CellOrder::CAUSAL_WIND)) {
+		GridCell& cell = grid.getCell(cellID);
+		for (int iu = 0; iu < UID::N; ++iu)
+			cell.UDOT[iu] = 0;
+	}
+}
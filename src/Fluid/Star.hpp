@@ -21,10 +21,12 @@
 
 #include <array>
 #include <memory>
+#include <vector>
 
 #include "Torch/Common.hpp"
 #include "Torch/Parameters.hpp"
 
+class Bound;
 class GridCell;
 class Grid;
 class Constants;
@@ -41,32 +43,45 @@ class Constants;
 class Star {
 public:
 	enum class Location : unsigned int { LEFT, HERE, RIGHT };
+	using Locations = std::array<Location, 3>;
 	std::array<double, 3> xc = std::array<double, 3>{{ 0, 0, 0 }};
 
-	void initialise(std::shared_ptr<Constants> c, StarParameters sp, Location containing_core, const Vec3& delta_x);
+	void initialise(std::shared_ptr<Constants> c, StarParameters sp, const Locations& containing_core, const Vec3& delta_x);
+
+	bool isHere() const;
+	bool isMoving() const;
+	bool isUpstream(const Bound& boundary) const;
+	bool isDownstream(const Bound& boundary) const;
 
 	void setWindCells(Grid& grid);
 
 	void injectEnergyMomentum(Grid& grid);
 
 	void fixDensityPressure(Grid& grid);
+	void holdWind(Grid& grid);
 
 	int getWindCellRadius() const;
 
 	bool on = false;
 	Vec3 dx =  Vec3{{ 0, 0, 0 }};
+	Vec3 velocity = Vec3{{ 0, 0, 0 }}; //!< Velocity the Star moves through the Grid with (see Fluid::moveStar).
 	double photonEnergy = 0;
 	double photonRate = 0;
 	double massLossRate = 0;
 	double windVelocity = 0;
 	double windTemperature = 0;
 	int windCellRadius = 0;
-	Location core = Location::HERE;
+	int windSubsamples = 0; //!< Sample points along each dimension of a wind cell measuring the fraction of it inside the wind radius (0 for equal shares).
+	bool windBoundary = false; //!< Hold the wind cells at the state of the free wind instead of injecting the wind into them (see holdWind).
+	Locations core = Locations{{ Location::HERE, Location::HERE, Location::HERE }}; //!< Location of the Star relative to this processor's part of the Grid along each dimension.
 
 private:
 	std::shared_ptr<Constants> consts = nullptr;
 	double mdot = 0;
 	double edot = 0;
+	std::vector<double> windWeights; //!< Share of the wind of each CAUSAL_WIND cell, in their order (empty for equal shares).
+
+	double windFraction(const GridCell& cell) const;
 };
 
 #endif // STAR_HPP_
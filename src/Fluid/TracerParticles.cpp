@@ -0,0 +1,288 @@
+#include "TracerParticles.hpp"
+
+#include "Fluid.hpp"
+#include "IO/FrameContainer.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+#include "Torch/Converter.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+const int RECORD_DOUBLES = 4; //!< A particle sent to another processor: its ID and Grid coordinates.
+const int SAMPLE_FLOATS = 10; //!< Position, density, pressure, HII fraction, temperature and velocity of a sample.
+
+template <class T>
+void appendValue(std::vector<char>& bytes, const T& value) {
+	const char* p = reinterpret_cast<const char*>(&value);
+	bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+}
+
+/**
+ * @brief Puts perCell particles in every core cell, spread through it along a low discrepancy sequence.
+ *
+ * A particle's ID is perCell times the index of its cell in the whole Grid (x fastest) plus its index in the cell, so
+ * the same particles are seeded whatever the decomposition.
+ * @param nd Number of dimensions.
+ * @param perCell Number of particles in each cell.
+ */
+void TracerParticles::seed(Grid& grid, int nd, int perCell) {
+	m_nd = nd;
+	m_ids.clear();
+	for (std::vector<double>& x : m_x)
+		x.clear();
+	// The additive recurrence of the powers of 1/phi, with phi the root of x^4 = x + 1, fills a cell evenly in up to three
+	// dimensions.
+	const std::array<double, 3> alpha = std::array<double, 3>{{ 0.8191725134, 0.6710436067, 0.5497004779 }};
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		std::array<int, 3> c;
+		for (int i = 0; i < 3; ++i)
+			c[i] = (int)std::floor(cell.xc[i]);
+		const long long cellIndex = c[0] + (long long)grid.ncells[0]*(c[1] + (long long)grid.ncells[1]*c[2]);
+		for (int k = 0; k < perCell; ++k) {
+			std::array<double, 3> x = std::array<double, 3>{{ cell.xc[0], cell.xc[1], cell.xc[2] }};
+			for (int i = 0; i < nd; ++i) {
+				const double offset = 0.5 + (k + 1)*alpha[i];
+				x[i] = c[i] + (offset - std::floor(offset));
+			}
+			append(cellIndex*perCell + k, x);
+		}
+	}
+	bin(grid);
+}
+
+/**
+ * @brief Moves the particles with the velocity of their cells over a step, then hands those that left this
+ * processor's block to its neighbours. Collective.
+ * @param dt Time step.
+ */
+void TracerParticles::advect(Grid& grid, double dt) {
+	for (std::size_t ip = 0; ip < m_ids.size(); ++ip) {
+		const GridCell& cell = grid.getCell(m_cellIDs[ip]);
+		for (int i = 0; i < m_nd; ++i)
+			m_x[i][ip] += cell.U[UID::VEL+i]/cell.U[UID::DEN]*dt/grid.dx[i];
+	}
+	applyEdges(grid);
+	migrate(grid);
+	bin(grid);
+}
+
+/**
+ * @brief Sends every particle to the processor whose block it is in, after the Grid has been repartitioned. Collective.
+ */
+void TracerParticles::redistribute(Grid& grid) {
+	MPIW& mpihandler = MPIW::Instance();
+	const int nproc = mpihandler.nProcessors();
+	std::vector<int> block(6);
+	for (int i = 0; i < 3; ++i) {
+		block[i] = grid.coreOffset[i];
+		block[3 + i] = grid.coreCells[i];
+	}
+	const std::vector<int> blocks = mpihandler.allGather(block);
+
+	std::vector<std::vector<double>> outgoing(nproc);
+	for (std::size_t ip = 0; ip < m_ids.size(); ++ip) {
+		int owner = 0;
+		for (int iproc = 0; iproc < nproc; ++iproc) {
+			bool isInside = true;
+			for (int i = 0; i < 3; ++i) {
+				const int c = (int)std::floor(m_x[i][ip]);
+				isInside = isInside && c >= blocks[6*iproc + i] && c < blocks[6*iproc + i] + blocks[6*iproc + 3 + i];
+			}
+			if (isInside) {
+				owner = iproc;
+				break;
+			}
+		}
+		outgoing[owner].push_back((double)m_ids[ip]);
+		for (int i = 0; i < 3; ++i)
+			outgoing[owner].push_back(m_x[i][ip]);
+	}
+	const std::vector<double> received = mpihandler.exchange(outgoing);
+	m_ids.clear();
+	for (std::vector<double>& x : m_x)
+		x.clear();
+	for (std::size_t r = 0; r < received.size(); r += RECORD_DOUBLES)
+		append((long long)received[r], std::array<double, 3>{{ received[r + 1], received[r + 2], received[r + 3] }});
+	bin(grid);
+}
+
+/**
+ * @brief Appends a sample of every particle to a FrameContainer as a frame. Collective.
+ * @param name Name of the frame.
+ * @param fluid The Fluid the particles are in, whose primitive variables are brought up to date.
+ * @param converter Converts the sample to cgs units.
+ */
+void TracerParticles::write(FrameContainer& container, const std::string& name, Fluid& fluid, const Converter& converter) const {
+	fluid.updatePrimitives();
+	const Grid& grid = fluid.getGrid();
+	std::vector<char> part;
+	part.reserve(m_ids.size()*(sizeof(std::int64_t) + SAMPLE_FLOATS*sizeof(float)));
+	for (std::size_t ip = 0; ip < m_ids.size(); ++ip) {
+		const GridCell& cell = grid.getCell(m_cellIDs[ip]);
+		appendValue<std::int64_t>(part, m_ids[ip]);
+		for (int i = 0; i < 3; ++i)
+			appendValue<float>(part, (float)converter.fromCodeUnits(m_x[i][ip]*grid.dx[i], 0, 1, 0));
+		appendValue<float>(part, (float)converter.fromCodeUnits(cell.Q[UID::DEN], 1, -3, 0));
+		appendValue<float>(part, (float)converter.fromCodeUnits(cell.Q[UID::PRE], 1, -1, -2));
+		appendValue<float>(part, (float)cell.Q[UID::HII]);
+		appendValue<float>(part, (float)fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]));
+		for (int i = 0; i < 3; ++i)
+			appendValue<float>(part, (float)(i < m_nd ? converter.fromCodeUnits(cell.Q[UID::VEL+i], 0, 1, -1) : 0.0));
+	}
+	container.append(name, converter.fromCodeUnits(grid.currentTime, 0, 0, 1), part);
+}
+
+/**
+ * @brief Gets the number of particles on all processors. Collective.
+ */
+long long TracerParticles::count() const {
+	double n = (double)m_ids.size();
+	return (long long)MPIW::Instance().sum(n);
+}
+
+/**
+ * @brief Wraps, mirrors or drops the particles that left the Grid through a face that is not shared with another
+ * processor.
+ */
+void TracerParticles::applyEdges(Grid& grid) {
+	std::vector<char> isRemoved(m_ids.size(), 0);
+	for (const Bound& boundary : grid.getBoundaries()) {
+		if (boundary.condition == Condition::PARTITION)
+			continue;
+		const int dim = boundary.face%3;
+		const bool isLeft = boundary.face < 3;
+		const double n = grid.ncells[dim];
+		for (std::size_t ip = 0; ip < m_ids.size(); ++ip) {
+			double& x = m_x[dim][ip];
+			if (isLeft ? x >= 0 : x < n)
+				continue;
+			if (boundary.condition == Condition::PERIODIC)
+				x += isLeft ? n : -n;
+			else if (boundary.condition == Condition::REFLECTING)
+				x = isLeft ? -x : 2*n - x;
+			else
+				isRemoved[ip] = 1;
+		}
+	}
+	removeIf(isRemoved);
+}
+
+/**
+ * @brief Hands the particles that left this processor's block to the processors across its faces, a dimension at a
+ * time. Collective.
+ */
+void TracerParticles::migrate(Grid& grid) {
+	MPIW& mpihandler = MPIW::Instance();
+	std::vector<Bound>& boundaries = grid.getBoundaries();
+	for (int dim = 0; dim < m_nd; ++dim) {
+		std::vector<std::vector<double>> outgoing(boundaries.size()), incoming(boundaries.size());
+		std::vector<double> sendCounts(boundaries.size(), 0), recvCounts(boundaries.size(), 0);
+		std::vector<char> isRemoved(m_ids.size(), 0);
+		for (std::size_t ib = 0; ib < boundaries.size(); ++ib) {
+			const Bound& boundary = boundaries[ib];
+			if (boundary.condition != Condition::PARTITION || boundary.face%3 != dim)
+				continue;
+			const bool isLeft = boundary.face < 3;
+			const double lo = grid.coreOffset[dim], hi = grid.coreOffset[dim] + grid.coreCells[dim];
+			for (std::size_t ip = 0; ip < m_ids.size(); ++ip) {
+				const double x = m_x[dim][ip];
+				if (isLeft ? x >= lo : x < hi)
+					continue;
+				outgoing[ib].push_back((double)m_ids[ip]);
+				for (int i = 0; i < 3; ++i) {
+					double xi = m_x[i][ip];
+					// Across the periodic edge of the processor topology the particle comes in at the other end of the Grid.
+					if (i == dim && boundary.wrapsAround)
+						xi += isLeft ? grid.ncells[dim] : -grid.ncells[dim];
+					outgoing[ib].push_back(xi);
+				}
+				isRemoved[ip] = 1;
+			}
+			sendCounts[ib] = (double)outgoing[ib].size();
+			// A message leaves through this face and arrives through the opposite face of the neighbour.
+			mpihandler.postReceive(&recvCounts[ib], 1, boundary.targetProcessor, SendID::TRACER_MSG, (boundary.face + 3)%6);
+			mpihandler.postSend(&sendCounts[ib], 1, boundary.targetProcessor, SendID::TRACER_MSG, boundary.face);
+		}
+		mpihandler.waitAll();
+		for (std::size_t ib = 0; ib < boundaries.size(); ++ib) {
+			const Bound& boundary = boundaries[ib];
+			if (boundary.condition != Condition::PARTITION || boundary.face%3 != dim)
+				continue;
+			incoming[ib].resize((std::size_t)recvCounts[ib]);
+			mpihandler.postReceive(incoming[ib].data(), (int)incoming[ib].size(), boundary.targetProcessor, SendID::TRACER_MSG, (boundary.face + 3)%6);
+			mpihandler.postSend(outgoing[ib].data(), (int)outgoing[ib].size(), boundary.targetProcessor, SendID::TRACER_MSG, boundary.face);
+		}
+		mpihandler.waitAll();
+		removeIf(isRemoved);
+		for (const std::vector<double>& records : incoming) {
+			for (std::size_t r = 0; r < records.size(); r += RECORD_DOUBLES)
+				append((long long)records[r], std::array<double, 3>{{ records[r + 1], records[r + 2], records[r + 3] }});
+		}
+	}
+}
+
+/**
+ * @brief Finds the cell of every particle and sorts the particles by it, so that the particles of a cell are together.
+ */
+void TracerParticles::bin(Grid& grid) {
+	const std::size_t np = m_ids.size();
+	std::vector<int> cellIDs(np);
+	for (std::size_t ip = 0; ip < np; ++ip) {
+		cellIDs[ip] = grid.locate((int)std::floor(m_x[0][ip]), (int)std::floor(m_x[1][ip]), (int)std::floor(m_x[2][ip]));
+		if (cellIDs[ip] < 0)
+			throw std::runtime_error("TracerParticles::bin: particle " + std::to_string(m_ids[ip]) + " is outside this processor's block.");
+	}
+
+	const int ncore = grid.coreCells[0]*grid.coreCells[1]*grid.coreCells[2];
+	m_cellStarts.assign(ncore + 1, 0);
+	for (int id : cellIDs)
+		++m_cellStarts[id + 1];
+	for (int id = 0; id < ncore; ++id)
+		m_cellStarts[id + 1] += m_cellStarts[id];
+
+	std::vector<int> next(m_cellStarts.begin(), m_cellStarts.end() - 1);
+	std::vector<long long> ids(np);
+	std::array<std::vector<double>, 3> x;
+	for (std::vector<double>& xi : x)
+		xi.resize(np);
+	m_cellIDs.resize(np);
+	for (std::size_t ip = 0; ip < np; ++ip) {
+		const int to = next[cellIDs[ip]]++;
+		ids[to] = m_ids[ip];
+		for (int i = 0; i < 3; ++i)
+			x[i][to] = m_x[i][ip];
+		m_cellIDs[to] = cellIDs[ip];
+	}
+	m_ids.swap(ids);
+	m_x.swap(x);
+}
+
+void TracerParticles::append(long long id, const std::array<double, 3>& x) {
+	m_ids.push_back(id);
+	for (int i = 0; i < 3; ++i)
+		m_x[i].push_back(x[i]);
+}
+
+/**
+ * @brief Removes the particles flagged in isRemoved, keeping the order of the rest. Their cells are found again by bin.
+ */
+void TracerParticles::removeIf(const std::vector<char>& isRemoved) {
+	std::size_t kept = 0;
+	for (std::size_t ip = 0; ip < m_ids.size(); ++ip) {
+		if (isRemoved[ip])
+			continue;
+		m_ids[kept] = m_ids[ip];
+		for (int i = 0; i < 3; ++i)
+			m_x[i][kept] = m_x[i][ip];
+		++kept;
+	}
+	m_ids.resize(kept);
+	for (std::vector<double>& x : m_x)
+		x.resize(kept);
+}
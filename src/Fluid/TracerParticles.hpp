@@ -0,0 +1,61 @@
+/** Provides the TracerParticles class.
+ *
+ * @file TracerParticles.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef TRACERPARTICLES_HPP_
+#define TRACERPARTICLES_HPP_
+
+#include <array>
+#include <string>
+#include <vector>
+
+class Converter;
+class FrameContainer;
+class Fluid;
+class Grid;
+
+/**
+ * @class TracerParticles
+ *
+ * @brief Passive particles that move with the gas, sampling its state so that the history of a parcel of gas can be
+ * followed without writing full snapshots at a high cadence.
+ *
+ * Each processor holds the particles inside its part of the Grid as a structure of arrays, sorted by the core cell they
+ * are in. A particle moves with the velocity of its cell over each step. The CFL condition keeps it within a cell of
+ * where it was, so one that leaves the processor's block is handed to the processor across that face of the block
+ * (Bound::targetProcessor), a dimension at a time so that a particle crossing an edge or corner reaches the right
+ * processor in one step. At the edges of the Grid a particle wraps around a periodic boundary, is mirrored at a
+ * reflecting one and is dropped at any other. After the Grid is repartitioned the particles are sent straight to the
+ * processors whose blocks they are in.
+ *
+ * A sample of every particle is appended to a FrameContainer as a frame of records, each an int64 ID followed by the
+ * position (cm), density (g cm-3), pressure (dyne cm-2), HII fraction, temperature (K) and velocity (cm s-1) as
+ * float32s. The IDs do not depend on the decomposition, so scripts/tracer_series can gather the time series of each
+ * particle.
+ */
+class TracerParticles {
+public:
+	void seed(Grid& grid, int nd, int perCell);
+	void advect(Grid& grid, double dt);
+	void redistribute(Grid& grid);
+	void write(FrameContainer& container, const std::string& name, Fluid& fluid, const Converter& converter) const;
+	long long count() const;
+
+private:
+	int m_nd = 1; //!< Number of dimensions.
+	std::vector<long long> m_ids; //!< ID of each particle.
+	std::array<std::vector<double>, 3> m_x; //!< Grid coordinates of each particle.
+	std::vector<int> m_cellIDs; //!< Core cell each particle is in, as of the last bin.
+	std::vector<int> m_cellStarts; //!< First particle in each core cell, followed by the number of particles.
+
+	void applyEdges(Grid& grid);
+	void migrate(Grid& grid);
+	void bin(Grid& grid);
+	void append(long long id, const std::array<double, 3>& x);
+	void removeIf(const std::vector<char>& isRemoved);
+};
+
+#endif // TRACERPARTICLES_HPP_
@@ -0,0 +1,68 @@
+#include "AnalysisHook.hpp"
+
+#include <stdexcept>
+
+#include <dlfcn.h>
+
+#include "Fluid/Fluid.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+#include "Torch/Constants.hpp"
+#include "Torch/Converter.hpp"
+
+AnalysisHook::AnalysisHook(const std::string& library) {
+	m_handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (m_handle == nullptr)
+		throw std::runtime_error("AnalysisHook: unable to load " + library + ": " + dlerror());
+	m_analyse = reinterpret_cast<void (*)(const AnalysisBlock*)>(dlsym(m_handle, "torch_analyse"));
+	if (m_analyse == nullptr) {
+		dlclose(m_handle);
+		throw std::runtime_error("AnalysisHook: " + library + " does not export torch_analyse.");
+	}
+}
+
+AnalysisHook::~AnalysisHook() {
+	if (m_handle != nullptr)
+		dlclose(m_handle);
+}
+
+/**
+ * @brief Hands this processor's core cells to the plug-in, without copying them. Collective if the plug-in is.
+ * @param name Suffix of the checkpoint's output files.
+ * @param consts The Constants, for the number of dimensions and the unit conversions.
+ * @param fluid The Fluid, whose primitive variables are up to date.
+ */
+void AnalysisHook::analyse(const std::string& name, const Constants& consts, const Fluid& fluid) const {
+	const Grid& grid = fluid.getGrid();
+	const Converter& converter = consts.converter;
+	const ConstFieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	const GridCell& first = grid.getCells()[fields.first()];
+
+	AnalysisBlock block;
+	block.name = name.c_str();
+	block.rank = MPIW::Instance().getRank();
+	block.nprocs = MPIW::Instance().nProcessors();
+	block.nd = consts.nd;
+	block.time = grid.currentTime*converter.time().fromCode;
+	for (int i = 0; i < 3; ++i) {
+		block.ncells[i] = grid.ncells[i];
+		block.coreCells[i] = grid.coreCells[i];
+		block.coreOffset[i] = grid.coreOffset[i];
+		block.dx[i] = grid.dx[i]*converter.length().fromCode;
+		block.star[i] = fluid.getStar().xc[i];
+	}
+	block.n = fields.last() - fields.first();
+	block.stride = (long)sizeof(GridCell);
+	block.xc = first.xc.data();
+	block.Q = first.Q.data();
+	block.R = first.R.data();
+	block.T = first.T.data();
+	block.nQ = UID::N;
+	block.nR = RID::N;
+	block.nT = TID::N;
+	block.densityUnit = converter.density().fromCode;
+	block.pressureUnit = converter.pressure().fromCode;
+	block.velocityUnit = converter.velocity().fromCode;
+	block.lengthUnit = converter.length().fromCode;
+	block.timeUnit = converter.time().fromCode;
+	m_analyse(&block);
+}
@@ -0,0 +1,74 @@
+/** Provides the AnalysisBlock interface and the AnalysisHook class.
+ *
+ * @file AnalysisHook.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef ANALYSISHOOK_HPP_
+#define ANALYSISHOOK_HPP_
+
+#include <string>
+
+class Constants;
+class Fluid;
+
+/**
+ * @brief A processor's part of the Grid at a checkpoint, as handed to an analysis plug-in (see AnalysisHook).
+ *
+ * The variable arrays point straight into the GridCells rather than at copies, so they are only valid during the call
+ * and must not be written to. The values of a cell follow on from each other, and the first value of the next cell
+ * starts stride bytes further on, so Q is a NumPy view of shape (n, nQ) and strides (stride, 8), for instance. The
+ * cells are in storage order, so the grid coordinates in xc place them. The variables are in code units, which the unit
+ * factors convert to cgs units.
+ */
+struct AnalysisBlock {
+	const char* name; //!< Suffix of the checkpoint's output files.
+	int rank; //!< Rank of this processor.
+	int nprocs; //!< Number of processors.
+	int nd; //!< Number of dimensions.
+	double time; //!< Simulation time (s).
+	int ncells[3]; //!< Number of cells of the whole Grid along each dimension.
+	int coreCells[3]; //!< Number of cells of this processor along each dimension.
+	int coreOffset[3]; //!< Grid coordinates of the corner of this processor's cells.
+	double dx[3]; //!< Cell widths (cm).
+	double star[3]; //!< Grid coordinates of the Star.
+	int n; //!< Number of cells of this processor.
+	long stride; //!< Bytes from the values of a cell to those of the next.
+	const double* xc; //!< Grid coordinates of the centre of each cell (3 values per cell, in cell widths).
+	const double* Q; //!< Primitive variables of each cell (nQ values per cell: den, pre, hii, adv, vel_x, vel_y, vel_z).
+	const double* R; //!< Radiation variables of each cell (nR values per cell: hii_a, tau, tau_a, dtau, dtau_a, heat).
+	const double* T; //!< Thermodynamic variables of each cell (nT values per cell: col_den, dcol_den, heat, rate).
+	int nQ; //!< Number of primitive variables.
+	int nR; //!< Number of radiation variables.
+	int nT; //!< Number of thermodynamic variables.
+	double densityUnit; //!< g cm^-3 per code unit of density.
+	double pressureUnit; //!< dyne cm^-2 per code unit of pressure.
+	double velocityUnit; //!< cm s^-1 per code unit of velocity.
+	double lengthUnit; //!< cm per code unit of length.
+	double timeUnit; //!< s per code unit of time.
+};
+
+/**
+ * @class AnalysisHook
+ *
+ * @brief An in-situ analysis computed by a shared object at every checkpoint, which is loaded for the lifetime of this
+ * object.
+ *
+ * The shared object must export a function with C linkage, void torch_analyse(const AnalysisBlock* block), which every
+ * processor calls with its own cells. It may embed Python to hand the arrays to NumPy without copying them, and it may
+ * communicate over MPI_COMM_WORLD, since every processor calls it at the same point.
+ */
+class AnalysisHook {
+public:
+	AnalysisHook(const std::string& library);
+	~AnalysisHook();
+	AnalysisHook(const AnalysisHook&) = delete;
+	AnalysisHook& operator=(const AnalysisHook&) = delete;
+	void analyse(const std::string& name, const Constants& consts, const Fluid& fluid) const;
+private:
+	void* m_handle = nullptr;
+	void (*m_analyse)(const AnalysisBlock*) = nullptr;
+};
+
+#endif // ANALYSISHOOK_HPP_
@@ -0,0 +1,201 @@
+#include "AsyncWriter.hpp"
+
+#include "BlockGZ.hpp"
+#include "FrameContainer.hpp"
+#include "Logger.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+#include "Misc/Allocations.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+/**
+ * @brief Header of a message from a compute processor to its I/O processor, followed by the filename and the text.
+ */
+struct IOHeader {
+	int rank; //!< Compute rank of the sender.
+	int level; //!< zlib compression level.
+	int nameLength; //!< Length of the filename, or -1 for the last message of the run.
+};
+
+std::vector<char> packMessage(int level, const std::string& filename, bool stop, const std::vector<char>& text) {
+	IOHeader header;
+	header.rank = MPIW::Instance().getRank();
+	header.level = level;
+	header.nameLength = stop ? -1 : (int)filename.size();
+	std::vector<char> message(sizeof(IOHeader) + filename.size() + text.size());
+	std::memcpy(message.data(), &header, sizeof(IOHeader));
+	std::copy(filename.begin(), filename.end(), message.begin() + sizeof(IOHeader));
+	std::copy(text.begin(), text.end(), message.begin() + sizeof(IOHeader) + filename.size());
+	return message;
+}
+
+}
+
+AsyncWriter::~AsyncWriter() {
+	for (PendingFile& file : m_pending) {
+		if (file.contents.valid())
+			file.contents.wait();
+	}
+}
+
+/**
+ * @brief Starts formatting and compressing this processor's part of a file on a background thread.
+ * @param filename Name of the file, written by the next flush().
+ * @param format Makes the text of this processor's part. It runs on another thread, so it must own (i.e. capture by
+ * value) everything it reads that the simulation may change.
+ * @param level zlib compression level.
+ */
+void AsyncWriter::submit(const std::string& filename, std::function<std::string()> format, int level) {
+	PendingFile file;
+	file.filename = filename;
+	file.level = level;
+	// The blocks are compressed serially, leaving the OpenMP threads to the simulation, or by the I/O processor.
+	const bool compress = !MPIW::Instance().hasIOServer();
+	file.contents = std::async(std::launch::async, [format, level, compress]() {
+		Allocations::excludeThread();
+		if (!compress) {
+			const std::string text = format();
+			return std::vector<char>(text.begin(), text.end());
+		}
+		return BlockGZ::compress(format(), level, false);
+	});
+	m_pending.push_back(std::move(file));
+}
+
+/**
+ * @brief Starts formatting and compressing this processor's part of a frame of a FrameContainer on a background
+ * thread, appended by the next flush().
+ * @param container The FrameContainer, which must outlive the next flush().
+ * @param name Name of the frame.
+ * @param time Simulation time of the frame (s).
+ * @param format Makes the text of this processor's part (see submit).
+ * @param level zlib compression level.
+ */
+void AsyncWriter::submitFrame(FrameContainer& container, const std::string& name, double time, std::function<std::string()> format, int level) {
+	PendingFile file;
+	file.filename = name;
+	file.level = level;
+	file.container = &container;
+	file.time = time;
+	file.contents = std::async(std::launch::async, [format, level]() { return BlockGZ::compress(format(), level, false); });
+	m_pending.push_back(std::move(file));
+}
+
+/**
+ * @brief Whether every submitted file is ready to be written.
+ */
+bool AsyncWriter::isIdle() const {
+	for (const PendingFile& file : m_pending) {
+		if (file.contents.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Writes every submitted file, first waiting for any still being formatted. Collective; with an I/O processor
+ * the files are only sent to it.
+ */
+void AsyncWriter::flush() {
+	if (!isIdle()) {
+		auto start = std::chrono::steady_clock::now();
+		for (PendingFile& file : m_pending)
+			file.contents.wait();
+		std::chrono::duration<double> waited = std::chrono::steady_clock::now() - start;
+		Logger::Instance().print<SeverityType::NOTICE>("AsyncWriter::flush: waited ", waited.count(), " s for the previous output.\n");
+	}
+
+	// Every processor must join every collective write, so errors are only rethrown once all files are written.
+	std::exception_ptr error = nullptr;
+	for (PendingFile& file : m_pending) {
+		std::vector<char> contents;
+		try {
+			contents = file.contents.get();
+		}
+		catch (...) {
+			if (error == nullptr)
+				error = std::current_exception();
+		}
+		if (file.container != nullptr)
+			file.container->append(file.filename, file.time, contents);
+		else if (MPIW::Instance().hasIOServer())
+			MPIW::Instance().postIO(packMessage(file.level, file.filename, false, contents));
+		else
+			MPIW::Instance().writeOrdered(file.filename, std::vector<char>(), contents.data(), (int)contents.size());
+	}
+	m_pending.clear();
+	if (error != nullptr)
+		std::rethrow_exception(error);
+}
+
+/**
+ * @brief Writes the files sent by the compute processors this I/O processor serves, until they have all called
+ * stopServer(). Collective over the I/O processors.
+ *
+ * Each file is written once every compute processor served has sent its part of it, which they do in the same order.
+ */
+void AsyncWriter::serve() {
+	MPIW& mpihandler = MPIW::Instance();
+	std::vector<std::deque<std::vector<char>>> queues;
+	std::vector<int> ranks;
+	bool stopped = false;
+	while (!stopped) {
+		std::vector<char> message = mpihandler.receiveIO();
+		IOHeader header;
+		std::memcpy(&header, message.data(), sizeof(IOHeader));
+		std::size_t client = std::find(ranks.begin(), ranks.end(), header.rank) - ranks.begin();
+		if (client == ranks.size()) {
+			ranks.push_back(header.rank);
+			queues.emplace_back();
+		}
+		queues[client].push_back(std::move(message));
+		if ((int)ranks.size() < mpihandler.nIOClients())
+			continue;
+
+		// Write every file that all the clients have sent.
+		for (;;) {
+			bool ready = true;
+			for (const std::deque<std::vector<char>>& queue : queues)
+				ready = ready && !queue.empty();
+			if (!ready)
+				break;
+			std::memcpy(&header, queues[0].front().data(), sizeof(IOHeader));
+			if (header.nameLength < 0) {
+				stopped = true;
+				break;
+			}
+			const std::string filename(queues[0].front().data() + sizeof(IOHeader), header.nameLength);
+			std::vector<int> order(ranks.size());
+			for (std::size_t i = 0; i < order.size(); ++i)
+				order[i] = i;
+			std::sort(order.begin(), order.end(), [&ranks](int a, int b) { return ranks[a] < ranks[b]; });
+			std::vector<int> partRanks;
+			std::vector<std::vector<char>> parts;
+			for (int i : order) {
+				const std::vector<char>& part = queues[i].front();
+				const std::size_t start = sizeof(IOHeader) + filename.size();
+				partRanks.push_back(ranks[i]);
+				parts.push_back(BlockGZ::compress(std::string(part.begin() + start, part.end()), header.level, true));
+				queues[i].pop_front();
+			}
+			mpihandler.writeParts(filename, partRanks, parts);
+		}
+	}
+}
+
+/**
+ * @brief Tells this processor's I/O processor that the run is over and waits for the output sent to it to leave. Call
+ * after the last flush(), if there is an I/O processor.
+ */
+void AsyncWriter::stopServer() {
+	MPIW::Instance().postIO(packMessage(0, "", true, std::vector<char>()));
+	MPIW::Instance().waitIO();
+}
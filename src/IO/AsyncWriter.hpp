@@ -0,0 +1,62 @@
+/** Provides the AsyncWriter class.
+ *
+ * @file AsyncWriter.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef ASYNCWRITER_HPP_
+#define ASYNCWRITER_HPP_
+
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+class FrameContainer;
+
+/**
+ * @class AsyncWriter
+ *
+ * @brief Formats and gzips output files on background threads while the simulation carries on.
+ *
+ * Every processor hands over a function producing the text of its part of a file, which is run and compressed into
+ * gzip members (see BlockGZ) on its own thread. The members are written by flush(), which waits for any that are
+ * unfinished and then writes every file collectively, each processor's members in rank order (a series of gzip members
+ * is a valid gzip file, as made by the serial appends of the text writers).
+ *
+ * Only the calling thread makes MPI calls, so all processors must submit the same files in the same order and call
+ * flush() together.
+ *
+ * A file may also be appended to a FrameContainer as a frame (see submitFrame), which is always compressed on the
+ * processor that made it.
+ *
+ * If some processors are set aside as I/O processors (see MPIW::splitIO and Integration.io_clients), the background
+ * threads only format the text, and flush() sends it to this processor's I/O processor and returns without waiting. The
+ * I/O processors run serve(), which compresses the text of each of their compute processors and writes it, every
+ * consecutive run of ranks in one piece, until stopServer() tells them the run is over.
+ */
+class AsyncWriter {
+public:
+	~AsyncWriter();
+
+	void submit(const std::string& filename, std::function<std::string()> format, int level);
+	void submitFrame(FrameContainer& container, const std::string& name, double time, std::function<std::string()> format, int level);
+	void flush();
+	bool isIdle() const;
+
+	static void serve();
+	static void stopServer();
+
+private:
+	struct PendingFile {
+		std::string filename; //!< Name of the file, or of the frame if it goes to a container.
+		int level;
+		FrameContainer* container = nullptr; //!< Container the file is appended to as a frame, if any.
+		double time = 0; //!< Simulation time of the frame (s).
+		std::future<std::vector<char>> contents;
+	};
+	std::vector<PendingFile> m_pending;
+};
+
+#endif // ASYNCWRITER_HPP_
@@ -0,0 +1,75 @@
+#include "BlockGZ.hpp"
+
+#include "Misc/Parallel.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <zlib.h>
+
+namespace {
+
+/**
+ * @brief Compresses n bytes into a single gzip member.
+ */
+std::vector<char> compressMember(const char* data, std::size_t n, int level) {
+	z_stream stream;
+	stream.zalloc = Z_NULL;
+	stream.zfree = Z_NULL;
+	stream.opaque = Z_NULL;
+	// 16 added to the window bits selects a gzip header and trailer.
+	if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		throw std::runtime_error("BlockGZ::compress: unable to initialise zlib with level " + std::to_string(level) + ".");
+
+	std::vector<char> member(deflateBound(&stream, n));
+	stream.next_in = (Bytef*)data;
+	stream.avail_in = n;
+	stream.next_out = (Bytef*)member.data();
+	stream.avail_out = member.size();
+	int status = deflate(&stream, Z_FINISH);
+	member.resize(stream.total_out);
+	deflateEnd(&stream);
+	if (status != Z_STREAM_END)
+		throw std::runtime_error("BlockGZ::compress: zlib failed to compress.");
+	return member;
+}
+
+}
+
+namespace BlockGZ {
+
+/**
+ * @brief Compresses text into a series of gzip members, one per blockSize bytes.
+ * @param text Text to compress.
+ * @param level zlib compression level, from 0 (none) to 9 (best).
+ * @param threaded Compress the blocks with the OpenMP threads (only from the thread running the simulation, as the
+ * threads are shared with it).
+ * @return The compressed data (a single empty member if text is empty).
+ */
+std::vector<char> compress(const std::string& text, int level, bool threaded) {
+	const int nblocks = std::max<int>(1, (text.size() + blockSize - 1)/blockSize);
+	std::vector<std::vector<char>> members(nblocks);
+	auto compressBlock = [&](int i) {
+		std::size_t start = i*blockSize;
+		std::size_t n = std::min(blockSize, text.size() - start);
+		members[i] = compressMember(text.data() + start, n, level);
+	};
+	if (threaded && nblocks > 1)
+		Parallel::forEachDynamic(0, nblocks, compressBlock);
+	else {
+		for (int i = 0; i < nblocks; ++i)
+			compressBlock(i);
+	}
+
+	std::size_t size = 0;
+	for (const std::vector<char>& member : members)
+		size += member.size();
+	std::vector<char> compressed;
+	compressed.reserve(size);
+	for (const std::vector<char>& member : members)
+		compressed.insert(compressed.end(), member.begin(), member.end());
+	return compressed;
+}
+
+}
@@ -0,0 +1,30 @@
+/** Provides the BlockGZ compressor.
+ *
+ * @file BlockGZ.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef BLOCKGZ_HPP_
+#define BLOCKGZ_HPP_
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Block-parallel gzip compression (as done by pigz).
+ *
+ * The text is cut into blocks of blockSize bytes that are deflated independently, and each block becomes a complete
+ * gzip member. A series of gzip members is a valid gzip file, which gzip, zcat, zlib's gzread and Python's gzip module
+ * read as the concatenation of the members. Each member can also be decompressed on its own, so a reader may seek to
+ * any member boundary.
+ */
+namespace BlockGZ {
+
+const std::size_t blockSize = 1 << 20; //!< Uncompressed bytes per gzip member.
+
+std::vector<char> compress(const std::string& text, int level, bool threaded);
+
+}
+
+#endif // BLOCKGZ_HPP_
@@ -0,0 +1,65 @@
+/** Provides the CellOwners class.
+ *
+ * @file CellOwners.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef CELLOWNERS_HPP_
+#define CELLOWNERS_HPP_
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "Fluid/Grid.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+
+/**
+ * @brief Finds the processor simulating a cell from the parts of the grid of every processor, which are gathered on
+ * construction (collective).
+ */
+class CellOwners {
+public:
+	explicit CellOwners(const Grid& grid) : m_ncells(grid.ncells) {
+		std::vector<int> local(grid.coreOffset.begin(), grid.coreOffset.end());
+		local.insert(local.end(), grid.coreCells.begin(), grid.coreCells.end());
+		std::vector<int> parts = MPIW::Instance().allGather(local);
+		int nproc = (int)parts.size()/6;
+
+		for (int i = 0; i < 3; ++i) {
+			for (int r = 0; r < nproc; ++r)
+				m_splits[i].push_back(parts[6*r + i]);
+			std::sort(m_splits[i].begin(), m_splits[i].end());
+			m_splits[i].erase(std::unique(m_splits[i].begin(), m_splits[i].end()), m_splits[i].end());
+		}
+		m_owners.assign(m_splits[0].size()*m_splits[1].size()*m_splits[2].size(), -1);
+		for (int r = 0; r < nproc; ++r)
+			m_owners[index({{ parts[6*r], parts[6*r + 1], parts[6*r + 2] }})] = r;
+	}
+
+	/**
+	 * @brief Rank of the processor simulating the cell at grid coordinates xc, or -1 if xc is outside the grid.
+	 */
+	int find(const std::array<int, 3>& xc) const {
+		for (int i = 0; i < 3; ++i) {
+			if (xc[i] < 0 || xc[i] >= m_ncells[i])
+				return -1;
+		}
+		return m_owners[index(xc)];
+	}
+
+private:
+	std::array<int, 3> m_ncells;
+	std::array<std::vector<int>, 3> m_splits; //!< Sorted coordinates at which the processors' parts of the grid start.
+	std::vector<int> m_owners; //!< Rank of each part, indexed by the position of its start in m_splits.
+
+	std::size_t index(const std::array<int, 3>& xc) const {
+		std::array<std::size_t, 3> part;
+		for (int i = 0; i < 3; ++i)
+			part[i] = std::upper_bound(m_splits[i].begin(), m_splits[i].end(), xc[i]) - m_splits[i].begin() - 1;
+		return (part[0]*m_splits[1].size() + part[1])*m_splits[2].size() + part[2];
+	}
+};
+
+#endif // CELLOWNERS_HPP_
@@ -1,6 +1,12 @@
 #include "Checkpointer.hpp"
 
+#include "Fluid/Fluid.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+
 #include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
 #include <iostream>
 
 Checkpointer::Checkpointer(double maxTime, int ncheckpoints)
@@ -28,3 +34,154 @@ bool Checkpointer::update(double currentTime, double& timeToNextCheckpoint) {
 int Checkpointer::getCount() {
 	return checkpointCount;
 }
+
+/**
+ * @param budget Wall clock time the run may take (s, 0 for no limit).
+ * @param restartInterval Wall clock time between restart files (s, 0 for none).
+ */
+WallClockLimit::WallClockLimit(double budget, double restartInterval)
+	: budget(budget)
+	, restartInterval(restartInterval)
+{
+
+}
+
+void WallClockLimit::stepTaken(double seconds) {
+	longestStep = std::max(longestStep, seconds);
+}
+
+/**
+ * @param elapsed Wall clock time of the run once the restart file was written (s).
+ * @param seconds Wall clock time the restart file took to write (s).
+ */
+void WallClockLimit::restartWritten(double elapsed, double seconds) {
+	lastRestart = elapsed;
+	restartSeconds = seconds;
+}
+
+bool WallClockLimit::isRestartDue(double elapsed) const {
+	return restartInterval > 0 && elapsed - lastRestart >= restartInterval;
+}
+
+bool WallClockLimit::isStopDue(double elapsed) const {
+	return budget > 0 && elapsed + 2.0*longestStep + restartSeconds >= budget;
+}
+
+/**
+ * @param ionisedChange Fraction the ionised mass changes by that triggers an output (0 for none).
+ * @param frontCells Number of cells the ionisation front moves by that triggers an output (0 for none).
+ * @param densityChange Fraction the largest density changes by that triggers an output (0 for none).
+ * @param minInterval Least simulation time between outputs.
+ * @exception std::runtime_error Thrown if any of them is negative.
+ */
+OutputTrigger::OutputTrigger(double ionisedChange, double frontCells, double densityChange, double minInterval)
+	: thresholds{{ ionisedChange, frontCells, densityChange }}
+	, minInterval(minInterval)
+{
+	if (ionisedChange < 0 || frontCells < 0 || densityChange < 0 || minInterval < 0)
+		throw std::runtime_error("OutputTrigger: trigger_ionised_mass, trigger_front_cells, trigger_max_density and trigger_min_interval must not be negative.");
+}
+
+bool OutputTrigger::isOn() const {
+	return thresholds[HII_MASS] > 0 || thresholds[FRONT] > 0 || thresholds[MAX_DENSITY] > 0;
+}
+
+/**
+ * @brief Whether the minimum interval since the last output has passed, so the measures are worth taking.
+ */
+bool OutputTrigger::isWaitOver(double currentTime) const {
+	return isOn() && currentTime - lastTime >= minInterval;
+}
+
+bool OutputTrigger::isTriggered(const std::array<double, Measure::N>& measures) const {
+	if (thresholds[HII_MASS] > 0 && std::abs(measures[HII_MASS] - lastMeasures[HII_MASS]) > thresholds[HII_MASS]*lastMeasures[HII_MASS])
+		return true;
+	if (thresholds[FRONT] > 0 && std::abs(measures[FRONT] - lastMeasures[FRONT]) > thresholds[FRONT])
+		return true;
+	return thresholds[MAX_DENSITY] > 0 && std::abs(measures[MAX_DENSITY] - lastMeasures[MAX_DENSITY]) > thresholds[MAX_DENSITY]*lastMeasures[MAX_DENSITY];
+}
+
+/**
+ * @brief Records the simulation time and measures of an output, checkpoint or triggered, which the next changes are
+ * measured from.
+ */
+void OutputTrigger::outputWritten(double currentTime, const std::array<double, Measure::N>& measures) {
+	lastTime = currentTime;
+	lastMeasures = measures;
+}
+
+/**
+ * @param every Number of steps between the checks (0 for none).
+ * @param tolerance Relative rate of change below which a check is quiet (code units).
+ * @param checks Number of quiet checks in a row that make the run steady.
+ * @exception std::runtime_error Thrown if every or tolerance is negative or checks is not positive.
+ */
+SteadyStateMonitor::SteadyStateMonitor(int every, double tolerance, int checks)
+	: every(every)
+	, tolerance(tolerance)
+	, checks(checks)
+{
+	if (every < 0 || tolerance < 0)
+		throw std::runtime_error("SteadyStateMonitor: steady_every and steady_tolerance must not be negative.");
+	if (checks < 1)
+		throw std::runtime_error("SteadyStateMonitor: steady_checks(=" + std::to_string(checks) + ") must be positive.");
+}
+
+bool SteadyStateMonitor::isOn() const {
+	return every > 0 && tolerance > 0;
+}
+
+/**
+ * @brief Whether a check is due after a number of steps of the run.
+ */
+bool SteadyStateMonitor::isDue(long steps) const {
+	return isOn() && steps % every == 0;
+}
+
+/**
+ * @brief Measures the rate of change since the last check and takes a new copy of the density and ionisation fraction.
+ * Collective.
+ * @return Whether the rate has been below the tolerance for steady_checks checks in a row.
+ */
+bool SteadyStateMonitor::update(const Fluid& fluid) {
+	const Grid& grid = fluid.getGrid();
+	const bool isCopyValid = gridBuilds == fluid.getGridBuilds();
+	std::vector<double> sums(3, 0);
+	if (isCopyValid) {
+		int i = 0;
+		for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+			const double mass = cell.Q[UID::DEN]*cell.vol;
+			sums[0] += std::abs(cell.Q[UID::DEN] - lastDensity[i])*cell.vol;
+			sums[1] += std::abs(cell.Q[UID::HII] - lastHII[i])*mass;
+			sums[2] += mass;
+			++i;
+		}
+	}
+	// Every processor takes part in the sum, so they all agree on whether the copy was valid.
+	sums.push_back(isCopyValid ? 0 : 1);
+	sums = MPIW::Instance().sum(sums);
+
+	const double interval = grid.currentTime - lastTime;
+	const bool isMeasured = sums[3] == 0 && sums[2] > 0 && interval > 0;
+	if (isMeasured) {
+		rate = std::max(sums[0], sums[1])/sums[2]/interval;
+		quietChecks = rate < tolerance ? quietChecks + 1 : 0;
+	}
+
+	lastDensity.clear();
+	lastHII.clear();
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		lastDensity.push_back(cell.Q[UID::DEN]);
+		lastHII.push_back(cell.Q[UID::HII]);
+	}
+	gridBuilds = fluid.getGridBuilds();
+	lastTime = grid.currentTime;
+	return isMeasured && quietChecks >= checks;
+}
+
+/**
+ * @brief Gets the relative rate of change at the last check (code units).
+ */
+double SteadyStateMonitor::getRate() const {
+	return rate;
+}
@@ -1,4 +1,9 @@
 
+#include <array>
+#include <vector>
+
+class Fluid;
+
 static double dummy_checkpoint;
 
 class Checkpointer {
@@ -11,3 +16,84 @@ private:
 	double checkpointDelta;
 	double maxTime;
 };
+
+/**
+ * @class WallClockLimit
+ *
+ * @brief Decides when a run with a wall clock budget writes its restart files and when it stops, so that a batch job
+ * ends with a restart file rather than being killed.
+ *
+ * The run stops once the time left is less than twice its longest step so far plus the time its last restart file
+ * took to write.
+ */
+class WallClockLimit {
+public:
+	WallClockLimit(double budget, double restartInterval);
+	void stepTaken(double seconds);
+	void restartWritten(double elapsed, double seconds);
+	bool isRestartDue(double elapsed) const;
+	bool isStopDue(double elapsed) const;
+private:
+	double budget; //!< Wall clock time the run may take (s, 0 for no limit).
+	double restartInterval; //!< Wall clock time between restart files (s, 0 for none).
+	double lastRestart = 0; //!< Wall clock time the last restart file was written at (s).
+	double longestStep = 0; //!< Wall clock time of the longest step so far (s).
+	double restartSeconds = 0; //!< Wall clock time the last restart file took to write (s).
+};
+
+/**
+ * @class OutputTrigger
+ *
+ * @brief Decides when the output is written between the checkpoints because the solution has changed enough since the
+ * last output, so the fast phases of a run get more frames than its slow ones.
+ *
+ * The changes are measured on the in-situ reductions of DataPrinter::measureChange: the ionised mass, the ionisation
+ * front radius (in cells) and the largest density. An output is triggered once the ionised mass or largest density
+ * has changed by more than a fraction of its value at the last output, or the front has moved by more than a number
+ * of cells, but not within a minimum interval of simulation time of the last output. The checkpoints bound the interval
+ * from above.
+ */
+class OutputTrigger {
+public:
+	enum Measure {HII_MASS, FRONT, MAX_DENSITY, N};
+	OutputTrigger(double ionisedChange, double frontCells, double densityChange, double minInterval);
+	bool isOn() const;
+	bool isWaitOver(double currentTime) const;
+	bool isTriggered(const std::array<double, Measure::N>& measures) const;
+	void outputWritten(double currentTime, const std::array<double, Measure::N>& measures);
+private:
+	std::array<double, Measure::N> thresholds; //!< Change of each measure that triggers an output (0 for none).
+	double minInterval; //!< Least simulation time between outputs.
+	double lastTime = 0; //!< Simulation time of the last output.
+	std::array<double, Measure::N> lastMeasures = std::array<double, Measure::N>{{ 0, 0, 0 }}; //!< Measures at the last output.
+};
+
+/**
+ * @class SteadyStateMonitor
+ *
+ * @brief Decides when a run has reached a steady state and can stop before its end time, e.g. a D-type front that
+ * has stalled in pressure equilibrium.
+ *
+ * Every few steps the density and ionisation fraction are compared with a copy taken at the last check. The relative
+ * rate of change is the larger of the mass weighted changes of the two, over the total mass and the simulation time
+ * between the checks. The run is steady once that rate has stayed below a tolerance for a number of checks in a row.
+ * The copy is taken afresh whenever the Grid is rebuilt (see Fluid::getGridBuilds), since its cells move.
+ */
+class SteadyStateMonitor {
+public:
+	SteadyStateMonitor(int every, double tolerance, int checks);
+	bool isOn() const;
+	bool isDue(long steps) const;
+	bool update(const Fluid& fluid);
+	double getRate() const;
+private:
+	int every; //!< Number of steps between the checks (0 for none).
+	double tolerance; //!< Relative rate of change below which a check is quiet.
+	int checks; //!< Number of quiet checks in a row that make the run steady.
+	int quietChecks = 0; //!< Number of quiet checks in a row so far.
+	int gridBuilds = -1; //!< Builds of the Grid when the copy was taken.
+	double lastTime = 0; //!< Simulation time the copy was taken at.
+	double rate = 0; //!< Relative rate of change at the last check.
+	std::vector<double> lastDensity; //!< Density of every cell at the last check.
+	std::vector<double> lastHII; //!< Ionisation fraction of every cell at the last check.
+};
@@ -4,24 +4,213 @@
 #include "Integrators/Hydro.hpp"
 #include "Torch/Constants.hpp"
 #include "Fluid/GridCell.hpp"
+#include "Fluid/GridStatistics.hpp"
 #include "Fluid/Star.hpp"
 #include "Torch/Converter.hpp"
+#include "Torch/Parameters.hpp"
+#include "BlockGZ.hpp"
+#include "CellOwners.hpp"
+#include "Logger.hpp"
+#include "OutputStaging.hpp"
+#include "Restart.hpp"
+#include "SnapshotWriter.hpp"
 #include "StreamGZ.hpp"
+#include "TextFormat.hpp"
 #include "MPI/MPI_Wrapper.hpp"
+#include "Misc/Parallel.hpp"
+#include "Misc/Profiler.hpp"
 
+#include <algorithm>
+#include <array>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iomanip>
+#include <limits>
 #include <string>
 
-void DataPrinter::initialise(std::shared_ptr<Constants> c, std::string output_directory) {
+void DataPrinter::initialise(std::shared_ptr<Constants> c, std::string output_directory, SnapshotFormat format, bool async,
+		int level) {
 	consts = std::move(c);
 	dir2D = output_directory;
+	snapshotFormat = format;
+	asyncOutput = async;
+	if (level < 0 || level > 9)
+		throw std::runtime_error("DataPrinter::initialise: compression_level(=" + std::to_string(level) + ") must be in [0, 9].");
+	compressionLevel = level;
 	printing_on = dir2D != "";
 }
 
+/**
+ * @brief Configures the variables and precision of the binary and HDF5 snapshots (see printSnapshot).
+ * @param variables Names of the variables, separated by commas or spaces, out of den, pre, hii and vel_x, vel_y and
+ * vel_z up to the number of dimensions. Empty for all of them.
+ * @param precision Storage of the values.
+ * @param keyframeEvery Data2D snapshots from one written in full to the next, the others holding only the blocks of
+ * cells that changed (see DeltaSnapshotWriter). 1 writes them all in full.
+ * @param deltaTolerance Largest change of a value left out of the deltas, relative to its variable's largest magnitude.
+ * @exception std::runtime_error Thrown if the snapshots are delta encoded but not binary.
+ */
+void DataPrinter::initialiseSnapshots(const std::string& variables, SnapshotPrecision precision, int keyframeEvery, double deltaTolerance) {
+	snapshotVariables = parseSnapshotVariables(variables, "snapshot_variables");
+	snapshotPrecision = precision;
+	if (snapshotFormat != SnapshotFormat::TEXT)
+		snapshotWriter = SnapshotWriterFactory::create(snapshotFormat, precision, compressionLevel);
+	deltaWriter.reset();
+	if (keyframeEvery != 1) {
+		if (snapshotFormat != SnapshotFormat::BINARY)
+			throw std::runtime_error("DataPrinter::initialiseSnapshots: snapshot_keyframe_every(=" + std::to_string(keyframeEvery) + ") needs binary snapshots.");
+		deltaWriter.reset(new DeltaSnapshotWriter(precision, keyframeEvery, deltaTolerance));
+	}
+}
+
+/**
+ * @brief Names of the snapshot variables in a list, separated by commas or spaces, out of den, pre, hii and vel_x,
+ * vel_y and vel_z up to the number of dimensions. All of them if the list is empty.
+ * @param parameter Name of the parameter the list comes from, for the error message.
+ * @exception std::runtime_error Thrown if the list has an unknown variable.
+ */
+std::vector<std::string> DataPrinter::parseSnapshotVariables(const std::string& variables, const std::string& parameter) const {
+	const char* axes[3] = {"x", "y", "z"};
+	std::vector<std::string> all = {"den", "pre", "hii"};
+	for (int idim = 0; idim < consts->nd; ++idim)
+		all.push_back(std::string("vel_") + axes[idim]);
+
+	std::string list = variables;
+	std::replace(list.begin(), list.end(), ',', ' ');
+	std::istringstream names(list);
+	std::vector<std::string> chosen;
+	for (std::string name; names >> name;) {
+		if (std::find(all.begin(), all.end(), name) == all.end())
+			throw std::runtime_error("DataPrinter::parseSnapshotVariables: " + parameter + " has an unknown variable [" + name + "].");
+		chosen.push_back(name);
+	}
+	return chosen.empty() ? all : chosen;
+}
+
+/**
+ * @brief Configures the regions of the grid written as binary snapshots of their own (see printRegions), with the
+ * precision of the snapshots.
+ * @param params The regions, as Integration.regions of the parameter file.
+ * @exception std::runtime_error Thrown if a region has unknown units or variables, a cadence below 1 or an upper corner
+ * that is not above its lower corner.
+ */
+void DataPrinter::initialiseRegions(const std::vector<RegionParameters>& params) {
+	regions.clear();
+	for (std::size_t i = 0; i < params.size(); ++i) {
+		const RegionParameters& param = params[i];
+		const std::string name = "regions[" + std::to_string(i + 1) + "]";
+		if (param.units != "cells" && param.units != "cm")
+			throw std::runtime_error("DataPrinter::initialiseRegions: " + name + ".units(=" + param.units + ") must be cells or cm.");
+		if (param.every < 1)
+			throw std::runtime_error("DataPrinter::initialiseRegions: " + name + ".every(=" + std::to_string(param.every) + ") must be positive.");
+		Region region;
+		region.lower = param.lower;
+		region.upper = param.upper;
+		for (int idim = 0; idim < consts->nd; ++idim) {
+			if (region.upper[idim] <= region.lower[idim])
+				throw std::runtime_error("DataPrinter::initialiseRegions: " + name + " must have its upper corner above its lower corner.");
+		}
+		region.inCells = param.units == "cells";
+		region.relativeToStar = param.relativeToStar;
+		region.every = param.every;
+		region.variables = parseSnapshotVariables(param.variables, name + ".variables");
+		regions.push_back(region);
+	}
+}
+
+/**
+ * @brief Configures the downsampled previews of the grid (see printPreview).
+ * @param every Steps between the previews, 0 for none.
+ * @param factor Cells along each dimension averaged into a cell of the previews.
+ * @exception std::runtime_error Thrown if every is negative or factor is below 2.
+ */
+void DataPrinter::initialisePreview(int every, int factor) {
+	if (every < 0)
+		throw std::runtime_error("DataPrinter::initialisePreview: preview_every(=" + std::to_string(every) + ") must not be negative.");
+	if (factor < 2)
+		throw std::runtime_error("DataPrinter::initialisePreview: preview_factor(=" + std::to_string(factor) + ") must be at least 2.");
+	previewEvery = every;
+	previewFactor = factor;
+}
+
+/**
+ * @brief Configures the time averages of the cells written at every checkpoint (see printTimeAverages).
+ * @param variables Variables averaged, separated by commas or spaces, out of the snapshot variables and ne and ne2 (the
+ * electron density and its square), or empty for none.
+ * @param variances Write the variances about the averages too.
+ * @exception std::runtime_error Thrown if the list has an unknown variable.
+ */
+void DataPrinter::initialiseTimeAverages(const std::string& variables, bool variances) {
+	std::string list = variables;
+	std::replace(list.begin(), list.end(), ',', ' ');
+	std::istringstream names(list);
+	averageVariables.clear();
+	averageUIDs.clear();
+	for (std::string name; names >> name;) {
+		if (name == "ne" || name == "ne2")
+			averageUIDs.push_back(name == "ne" ? -1 : -2);
+		else {
+			SnapshotFields fields;
+			std::vector<double> scale;
+			addSnapshotVariables(parseSnapshotVariables(name, "time_averages"), fields, averageUIDs, scale);
+		}
+		averageVariables.push_back(name);
+	}
+	averageVariances = variances;
+	averageWeight = 0;
+	averageMeans.clear();
+	averageSquares.clear();
+}
+
+/**
+ * @brief Configures whether the data2D and heating text files of the checkpoints are appended as frames to one
+ * data2D.tpk and one heating.tpk file (see FrameContainer) instead of being written to a file each.
+ * @param pack Append the checkpoints to the containers.
+ * @param suffix Suffix of the names of the containers, so that a restarted run does not start those of the run it
+ * carries on from afresh.
+ * @exception std::runtime_error Thrown if pack is set for a snapshot_format other than text.
+ */
+void DataPrinter::initialisePacking(bool pack, const std::string& suffix) {
+	dataPack.reset();
+	heatingPack.reset();
+	if (!pack || !printing_on)
+		return;
+	if (snapshotFormat != SnapshotFormat::TEXT)
+		throw std::runtime_error("DataPrinter::initialisePacking: pack_output needs the text snapshot_format.");
+	dataPack.reset(new FrameContainer(dir2D + "/data2D" + suffix + ".tpk"));
+	heatingPack.reset(new FrameContainer(dir2D + "/heating" + suffix + ".tpk"));
+}
+
+/**
+ * @brief Configures whether the records of the restart files are compressed (a version 3 file, see RestartCodec)
+ * rather than written as they are.
+ * @param compress Compress the records.
+ */
+void DataPrinter::initialiseRestarts(bool compress) {
+	compressRestarts = compress;
+}
+
+/**
+ * @brief Configures the in-situ analysis written at every checkpoint (see printAnalysis).
+ * @param on Append the reductions of the Grid to analysis.txt.
+ * @param profileBins Number of radial bins of the profiles written to profile_*.txt (0 for none).
+ * @param slice Write the plane of cells through the Star of a 3D Grid to slice_*.txt.gz.
+ * @param library Shared object of an analysis plug-in to hand the cells to (see AnalysisHook), or empty for none.
+ */
+void DataPrinter::initialiseAnalysis(bool on, int profileBins, bool slice, const std::string& library) {
+	if (profileBins < 0)
+		throw std::runtime_error("DataPrinter::initialiseAnalysis: analysis_profile_bins(=" + std::to_string(profileBins) + ") must not be negative.");
+	analysis_on = on;
+	analysisProfileBins = profileBins;
+	analysisSlice = slice;
+	analysisHook.reset(library.empty() ? nullptr : new AnalysisHook(library));
+}
+
 void DataPrinter::printSTARBENCH(const Radiation& rad, const Hydrodynamics& hydro, Fluid& fluid) {
 	MPIW& mpihandler = MPIW::Instance();
 	const Grid& grid = fluid.getGrid();
@@ -35,24 +224,27 @@ void DataPrinter::printSTARBENCH(const Radiation& rad, const Hydrodynamics& hydr
 				if (!out)
 					throw std::runtime_error("DataPrinter::printStarbench: unable to open" + os.str());
 				out << std::setprecision(10) << std::fixed;
-				for (const GridCell& cell : grid.getIterable("GridCells")){
+				const Converter& converter = consts->converter;
+				const double length = converter.length().fromCode, velocity = converter.velocity().fromCode*0.001;
+				for (int cellID : grid.getLexicographicIDs()) {
+					const GridCell& cell = grid.getCell(cellID);
 					double x1 = 0, x2 = 0, v1 = 0, v2 = 0;
 					if (consts->nd > 1) {
-						x1 = consts->converter.CM_2_PC(consts->converter.fromCodeUnits(cell.xc[1]*grid.dx[1], 0, 1, 0));
-						v1 = consts->converter.fromCodeUnits(cell.Q[UID::VEL+1], 0, 1, -1)*0.001;
+						x1 = converter.CM_2_PC(cell.xc[1]*grid.dx[1]*length);
+						v1 = cell.Q[UID::VEL+1]*velocity;
 					}
 					if (consts->nd > 2) {
-						x2 = consts->converter.CM_2_PC(consts->converter.fromCodeUnits(cell.xc[2]*grid.dx[2], 0, 1, 0));
-						v2 = consts->converter.fromCodeUnits(cell.Q[UID::VEL+2], 0, 1, -1)*0.001;
+						x2 = converter.CM_2_PC(cell.xc[2]*grid.dx[2]*length);
+						v2 = cell.Q[UID::VEL+2]*velocity;
 					}
-					out << fortranformat(consts->converter.CM_2_PC(consts->converter.fromCodeUnits(cell.xc[0]*grid.dx[0], 0, 1, 0)), 16, 7, 3);
+					out << fortranformat(converter.CM_2_PC(cell.xc[0]*grid.dx[0]*length), 16, 7, 3);
 					out << fortranformat(x1, 16, 7, 3);
 					out << fortranformat(x2, 16, 7, 3);
-					out	<< fortranformat(consts->converter.fromCodeUnits(cell.Q[UID::DEN], 1, -3, 0), 16, 7, 3);
+					out	<< fortranformat(cell.Q[UID::DEN]*converter.density().fromCode, 16, 7, 3);
 					out << fortranformat(cell.Q[UID::HII], 16, 7, 3);
-					out << fortranformat(consts->converter.fromCodeUnits(cell.Q[UID::PRE], 1, -1, -2), 16, 7, 3);
+					out << fortranformat(cell.Q[UID::PRE]*converter.pressure().fromCode, 16, 7, 3);
 					out << fortranformat((rad.THI + cell.Q[UID::HII]*(rad.THII - rad.THI)), 16, 7, 3);
-					out << fortranformat(consts->converter.fromCodeUnits(cell.Q[UID::VEL+0], 0, 1, -1)*0.001, 16, 7, 3);
+					out << fortranformat(cell.Q[UID::VEL+0]*velocity, 16, 7, 3);
 					out << fortranformat(v1, 16, 7, 3);
 					out << fortranformat(v2, 16, 7, 3);
 					out << '\n';
@@ -111,7 +303,8 @@ void DataPrinter::printBinary2D(const int step, const double t, const Grid& grid
 	const int nbuff = grid.coreCells[0]*grid.coreCells[1]*grid.coreCells[2]*ncols;
 	double* buff = new double[nbuff];
 	int i = 0;
-	for (const GridCell& cell : grid.getIterable("GridCells")){
+	for (int cellID : grid.getLexicographicIDs()) {
+		const GridCell& cell = grid.getCell(cellID);
 		for (int id = 0; id < consts->nd; ++id)
 			buff[i++] = cell.xc[id];
 		buff[i++] = cell.Q[UID::DEN];
@@ -127,6 +320,413 @@ void DataPrinter::printBinary2D(const int step, const double t, const Grid& grid
 	delete[] buff;
 }
 
+/**
+ * @brief The SnapshotFields of this processor's box of cells, with no variables yet.
+ */
+SnapshotFields DataPrinter::stageFields(const double t, const Grid& grid) const {
+	const Converter& converter = consts->converter;
+	SnapshotFields fields;
+	fields.time = converter.fromCodeUnits(t, 0, 0, 1);
+	fields.nd = consts->nd;
+	fields.geometry = (int)grid.geometry;
+	fields.ncells = grid.ncells;
+	for (int idim = 0; idim < consts->nd; ++idim)
+		fields.dx[idim] = converter.fromCodeUnits(grid.dx[idim], 0, 1, 0);
+	fields.boxCells = grid.coreCells;
+	fields.boxOffset = grid.coreOffset;
+	return fields;
+}
+
+/**
+ * @brief Position of a core GridCell among the cells of this processor's box, x fastest.
+ */
+int DataPrinter::boxIndex(const GridCell& cell, const Grid& grid) const {
+	const int ncore = grid.coreCells[0]*grid.coreCells[1]*grid.coreCells[2];
+	int icell = 0;
+	for (int idim = 2; idim >= 0; --idim)
+		icell = icell*grid.coreCells[idim] + (int)std::floor(cell.xc[idim]) - grid.coreOffset[idim];
+	if (icell < 0 || icell >= ncore)
+		throw std::runtime_error("DataPrinter::boxIndex: GridCell outside of the processor's box.");
+	return icell;
+}
+
+/**
+ * @brief Writes the variables chosen by initialiseSnapshots to data2D_<append_name> through the SnapshotWriter of the
+ * snapshot_format, e.g. a binary snapshot (.tsnp) or an HDF5 file (.h5).
+ *
+ * The cells are written in the order of their grid coordinates, so the coordinates themselves are left out.
+ * @param append_name Suffix of the file name.
+ * @param t Simulation time.
+ * @param grid The Grid.
+ * @see SnapshotWriter
+ */
+void DataPrinter::printSnapshot(const std::string& append_name, const double t, const Grid& grid) const {
+	if (!printing_on)
+		return;
+	if (!snapshotWriter)
+		throw std::runtime_error("DataPrinter::printSnapshot: snapshots are not initialised (see initialiseSnapshots).");
+	SnapshotFields fields = stageFields(t, grid);
+	std::vector<int> vars;
+	std::vector<double> scale;
+	addSnapshotVariables(snapshotVariables, fields, vars, scale);
+
+	const int nvars = (int)vars.size();
+	const int ncore = grid.coreCells[0]*grid.coreCells[1]*grid.coreCells[2];
+	fields.values.resize((std::size_t)ncore*nvars);
+	int ncopied = 0;
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		const int icell = boxIndex(cell, grid);
+		for (int ivar = 0; ivar < nvars; ++ivar)
+			fields.values[(std::size_t)icell*nvars + ivar] = cell.Q[vars[ivar]]*scale[ivar];
+		++ncopied;
+	}
+	if (ncopied != ncore)
+		throw std::runtime_error("DataPrinter::printSnapshot: buffer not filled.");
+
+	const SnapshotWriter& writer = deltaWriter ? *deltaWriter : *snapshotWriter;
+	writer.write(dir2D + "/data2D_" + append_name + writer.extension(), fields);
+}
+
+/**
+ * @brief Writes the boxes of the grid configured by initialiseRegions that are due at this step to binary snapshots
+ * region<i>_<step>.tsnp, e.g. a small box around the Star at a much higher cadence than the checkpoints. Collective.
+ *
+ * A box is clipped to the grid, and moves with the Star if it is relative to it. Its snapshot's header has the grid
+ * coordinates of its first cell (SnapshotHeader::offset), and only the processors whose part of the grid overlaps the
+ * box write to the file.
+ * @param step Number of steps taken.
+ * @param t Simulation time.
+ * @param fluid The Fluid.
+ */
+void DataPrinter::printRegions(const long step, const double t, const Fluid& fluid) const {
+	if (!printing_on || regions.empty())
+		return;
+	ScopedTimer timer(ProfileID::PRINT_2D);
+	const Grid& grid = fluid.getGrid();
+	const Star& star = fluid.getStar();
+	for (std::size_t iregion = 0; iregion < regions.size(); ++iregion) {
+		const Region& region = regions[iregion];
+		if (step % region.every != 0)
+			continue;
+
+		// The box of the region in grid coordinates, and its intersection with this processor's part of the grid.
+		std::array<int, 3> lower = {{ 0, 0, 0 }}, upper = {{ 1, 1, 1 }};
+		bool empty = false;
+		for (int idim = 0; idim < consts->nd; ++idim) {
+			double lo = region.lower[idim], hi = region.upper[idim];
+			if (!region.inCells) {
+				const double dx = consts->converter.fromCodeUnits(grid.dx[idim], 0, 1, 0);
+				lo /= dx;
+				hi /= dx;
+			}
+			const double origin = region.relativeToStar ? std::floor(star.xc[idim]) : 0;
+			lower[idim] = (int)std::max(0.0, origin + std::floor(lo));
+			upper[idim] = (int)std::min((double)grid.ncells[idim], origin + std::ceil(hi));
+			empty = empty || upper[idim] <= lower[idim];
+		}
+		if (empty)
+			continue;
+
+		SnapshotFields fields = stageFields(t, grid);
+		fields.isRegion = true;
+		fields.origin = lower;
+		for (int idim = 0; idim < 3; ++idim) {
+			fields.ncells[idim] = upper[idim] - lower[idim];
+			const int boxLower = std::max(lower[idim], grid.coreOffset[idim]);
+			const int boxUpper = std::min(upper[idim], grid.coreOffset[idim] + grid.coreCells[idim]);
+			fields.boxOffset[idim] = std::max(0, boxLower - lower[idim]);
+			fields.boxCells[idim] = std::max(0, boxUpper - boxLower);
+		}
+		std::vector<int> vars;
+		std::vector<double> scale;
+		addSnapshotVariables(region.variables, fields, vars, scale);
+
+		const int nvars = (int)vars.size();
+		const int nbox = fields.boxCells[0]*fields.boxCells[1]*fields.boxCells[2];
+		fields.values.resize((std::size_t)nbox*nvars);
+		for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+			int icell = 0;
+			bool inBox = true;
+			for (int idim = 2; idim >= 0; --idim) {
+				const int x = (int)std::floor(cell.xc[idim]) - lower[idim] - fields.boxOffset[idim];
+				inBox = inBox && x >= 0 && x < fields.boxCells[idim];
+				icell = icell*fields.boxCells[idim] + x;
+			}
+			if (!inBox)
+				continue;
+			for (int ivar = 0; ivar < nvars; ++ivar)
+				fields.values[(std::size_t)icell*nvars + ivar] = cell.Q[vars[ivar]]*scale[ivar];
+		}
+
+		std::ostringstream os;
+		os << dir2D << "/region" << iregion + 1 << "_" << std::setfill('0') << std::setw(8) << step << ".tsnp";
+		BinarySnapshotWriter(snapshotPrecision).write(os.str(), fields);
+	}
+}
+
+/**
+ * @brief Writes the grid averaged over blocks of previewFactor cells along each dimension to a binary snapshot
+ * preview_<step>.tsnp, with the snapshot variables, every previewEvery steps, to watch a run at a much higher cadence
+ * than the full snapshots. Collective.
+ *
+ * The averages conserve what the cells hold: the density and pressure are averaged over the volume of the cells, and the
+ * HII fraction and velocities over their mass. The blocks at the upper edges of the grid hold the remaining cells if
+ * previewFactor does not divide the grid, although the header gives every block previewFactor times the width of a cell.
+ * Each processor sums its own cells and owns the blocks whose first cell it simulates, so the sums of the few blocks
+ * that straddle its part of the grid are sent to their owners, and every processor writes its blocks to the file.
+ * @param step Number of steps taken.
+ * @param t Simulation time.
+ * @param fluid The Fluid.
+ */
+void DataPrinter::printPreview(const long step, const double t, const Fluid& fluid) const {
+	if (!printing_on || previewEvery == 0 || step % previewEvery != 0)
+		return;
+	ScopedTimer timer(ProfileID::PRINT_2D);
+	MPIW& mpihandler = MPIW::Instance();
+	const Grid& grid = fluid.getGrid();
+
+	// The grid of blocks, and the blocks whose first cell is in this processor's part of the grid.
+	SnapshotFields fields = stageFields(t, grid);
+	fields.isRegion = true;
+	fields.origin = {{ 0, 0, 0 }};
+	std::array<int, 3> factor = {{ 1, 1, 1 }};
+	for (int idim = 0; idim < 3; ++idim) {
+		if (idim < consts->nd) {
+			factor[idim] = previewFactor;
+			fields.dx[idim] *= previewFactor;
+		}
+		fields.ncells[idim] = (grid.ncells[idim] + factor[idim] - 1)/factor[idim];
+		const int lower = (grid.coreOffset[idim] + factor[idim] - 1)/factor[idim];
+		const int upper = std::min(fields.ncells[idim], (grid.coreOffset[idim] + grid.coreCells[idim] + factor[idim] - 1)/factor[idim]);
+		fields.boxOffset[idim] = lower;
+		fields.boxCells[idim] = std::max(0, upper - lower);
+	}
+	std::vector<int> vars;
+	std::vector<double> scale;
+	addSnapshotVariables(snapshotVariables, fields, vars, scale);
+	const int nvars = (int)vars.size();
+	std::vector<bool> byMass(nvars);
+	for (int ivar = 0; ivar < nvars; ++ivar)
+		byMass[ivar] = vars[ivar] != UID::DEN && vars[ivar] != UID::PRE;
+
+	// Sums of each block: its volume, its mass and each variable times the volume or mass of the cells.
+	const int nsums = nvars + 2;
+	const int nbox = fields.boxCells[0]*fields.boxCells[1]*fields.boxCells[2];
+	std::vector<double> sums((std::size_t)nbox*nsums, 0.0);
+	std::map<long, std::vector<double>> straddling; // Sums of the blocks owned by other processors, by block index.
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		std::array<int, 3> block;
+		bool owned = true;
+		long iblock = 0;
+		int ibox = 0;
+		for (int idim = 2; idim >= 0; --idim) {
+			block[idim] = (int)std::floor(cell.xc[idim])/factor[idim];
+			const int x = block[idim] - fields.boxOffset[idim];
+			owned = owned && x >= 0 && x < fields.boxCells[idim];
+			iblock = iblock*fields.ncells[idim] + block[idim];
+			ibox = ibox*fields.boxCells[idim] + x;
+		}
+		double* sum = nullptr;
+		if (owned)
+			sum = &sums[(std::size_t)ibox*nsums];
+		else {
+			std::vector<double>& partial = straddling[iblock];
+			partial.resize(nsums, 0.0);
+			sum = partial.data();
+		}
+		const double mass = cell.Q[UID::DEN]*cell.vol;
+		sum[0] += cell.vol;
+		sum[1] += mass;
+		for (int ivar = 0; ivar < nvars; ++ivar)
+			sum[2 + ivar] += cell.Q[vars[ivar]]*(byMass[ivar] ? mass : cell.vol);
+	}
+
+	// Each straddling block goes to the processor simulating its first cell, preceded by its index.
+	const CellOwners owners(grid);
+	std::vector<std::vector<double>> outgoing(mpihandler.nProcessors());
+	for (const auto& entry : straddling) {
+		std::array<int, 3> first;
+		long iblock = entry.first;
+		for (int idim = 0; idim < 3; ++idim) {
+			first[idim] = (int)(iblock%fields.ncells[idim])*factor[idim];
+			iblock /= fields.ncells[idim];
+		}
+		std::vector<double>& out = outgoing[owners.find(first)];
+		out.push_back((double)entry.first);
+		out.insert(out.end(), entry.second.begin(), entry.second.end());
+	}
+	const std::vector<double> incoming = mpihandler.exchange(outgoing);
+	for (std::size_t i = 0; i + nsums < incoming.size(); i += nsums + 1) {
+		long iblock = (long)incoming[i];
+		int ibox = 0, stride = 1;
+		for (int idim = 0; idim < 3; ++idim) {
+			ibox += ((int)(iblock%fields.ncells[idim]) - fields.boxOffset[idim])*stride;
+			stride *= fields.boxCells[idim];
+			iblock /= fields.ncells[idim];
+		}
+		for (int isum = 0; isum < nsums; ++isum)
+			sums[(std::size_t)ibox*nsums + isum] += incoming[i + 1 + isum];
+	}
+
+	fields.values.resize((std::size_t)nbox*nvars);
+	for (int ibox = 0; ibox < nbox; ++ibox) {
+		const double* sum = &sums[(std::size_t)ibox*nsums];
+		for (int ivar = 0; ivar < nvars; ++ivar) {
+			const double weight = byMass[ivar] ? sum[1] : sum[0];
+			fields.values[(std::size_t)ibox*nvars + ivar] = weight > 0 ? sum[2 + ivar]/weight*scale[ivar] : 0;
+		}
+	}
+
+	std::ostringstream os;
+	os << dir2D << "/preview_" << std::setfill('0') << std::setw(8) << step << ".tsnp";
+	BinarySnapshotWriter(snapshotPrecision).write(os.str(), fields);
+}
+
+/**
+ * @brief Adds the state the step of length dt ended with to the running time averages of the core cells, and to their
+ * sums of squared deviations if the variances are written (West's weighted update, so long windows lose no precision).
+ *
+ * The averages are in code units, ne and ne2 being those of the hydrogen ionised. They start afresh, with a warning,
+ * if rebalancing has moved this processor's box since the last step.
+ * @param dt Length of the step.
+ * @param rad The Radiation, for the mass fraction of hydrogen.
+ * @param fluid The Fluid.
+ */
+void DataPrinter::accumulateTimeAverages(const double dt, const Radiation& rad, const Fluid& fluid) {
+	if (averageVariables.empty() || dt <= 0)
+		return;
+	ScopedTimer timer(ProfileID::PRINT_ANALYSIS);
+	const Grid& grid = fluid.getGrid();
+	const GridCellVector& cells = grid.getCells();
+	const ConstFieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	const int first = fields.first();
+	const int nvars = (int)averageVariables.size();
+	const std::size_t nvalues = (std::size_t)(fields.last() - first)*nvars;
+	if (averageMeans.size() != nvalues || grid.coreOffset != averageOffset || grid.coreCells != averageCells) {
+		if (averageWeight > 0)
+			Logger::Instance().print<SeverityType::WARNING>("DataPrinter::accumulateTimeAverages: the box of the processor has moved, so its time averages start afresh.\n");
+		averageWeight = 0;
+		averageMeans.assign(nvalues, 0.0);
+		averageSquares.assign(averageVariances ? nvalues : 0, 0.0);
+		averageOffset = grid.coreOffset;
+		averageCells = grid.coreCells;
+	}
+
+	const double electrons = rad.massFractionH/consts->hydrogenMass;
+	averageWeight += dt;
+	const double fraction = dt/averageWeight;
+	const bool variances = averageVariances;
+	const std::vector<int>& vars = averageUIDs;
+	Parallel::forEach(first, fields.last(), [&](int id) {
+		const GridCell& cell = cells[id];
+		const std::size_t i0 = (std::size_t)(id - first)*nvars;
+		for (int ivar = 0; ivar < nvars; ++ivar) {
+			double x;
+			if (vars[ivar] >= 0)
+				x = cell.Q[vars[ivar]];
+			else {
+				x = cell.Q[UID::HII]*cell.Q[UID::DEN]*electrons;
+				if (vars[ivar] == -2)
+					x *= x;
+			}
+			double& mean = averageMeans[i0 + ivar];
+			const double deviation = x - mean;
+			mean += fraction*deviation;
+			if (variances)
+				averageSquares[i0 + ivar] += dt*deviation*(x - mean);
+		}
+	});
+}
+
+/**
+ * @brief Writes the time averages of the cells, and their variances if they are on, since the last time they were
+ * written (or since the start of the run) to a binary snapshot, average_<append_name>.tsnp, in cgs units, and starts
+ * them afresh. Collective.
+ *
+ * The variances are named after their variable with a _var suffix. Nothing is written if no time has passed.
+ * @param append_name Suffix of the file name.
+ * @param t Simulation time.
+ * @param fluid The Fluid.
+ */
+void DataPrinter::printTimeAverages(const std::string& append_name, const double t, const Fluid& fluid) {
+	if (!printing_on || averageVariables.empty() || MPIW::Instance().maximum(averageWeight) <= 0)
+		return;
+	ScopedTimer timer(ProfileID::PRINT_ANALYSIS);
+	const Grid& grid = fluid.getGrid();
+	const Converter& converter = consts->converter;
+	SnapshotFields fields = stageFields(t, grid);
+	std::vector<int> vars;
+	std::vector<double> scale;
+	for (const std::string& name : averageVariables) {
+		if (name == "ne" || name == "ne2") {
+			fields.names.push_back(name);
+			fields.units.push_back(name == "ne" ? "cm^-3" : "cm^-6");
+			scale.push_back(converter.fromCodeUnits(1, 0, name == "ne" ? -3 : -6, 0));
+		}
+		else
+			addSnapshotVariables({name}, fields, vars, scale);
+	}
+	const int nvars = (int)averageVariables.size();
+	if (averageVariances) {
+		for (int ivar = 0; ivar < nvars; ++ivar) {
+			fields.names.push_back(fields.names[ivar] + "_var");
+			fields.units.push_back(fields.units[ivar].empty() ? "" : "(" + fields.units[ivar] + ")^2");
+		}
+	}
+
+	const int nvalues = averageVariances ? 2*nvars : nvars;
+	const int first = grid.getFieldIterable(CellRange::GRID_CELLS).first();
+	fields.values.resize((std::size_t)grid.coreCells[0]*grid.coreCells[1]*grid.coreCells[2]*nvalues, 0.0);
+	if (averageWeight > 0) {
+		for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+			const std::size_t icell = (std::size_t)boxIndex(cell, grid)*nvalues;
+			const std::size_t i0 = (std::size_t)(cell.id - first)*nvars;
+			for (int ivar = 0; ivar < nvars; ++ivar) {
+				fields.values[icell + ivar] = averageMeans[i0 + ivar]*scale[ivar];
+				if (averageVariances)
+					fields.values[icell + nvars + ivar] = averageSquares[i0 + ivar]/averageWeight*scale[ivar]*scale[ivar];
+			}
+		}
+	}
+	BinarySnapshotWriter(snapshotPrecision).write(dir2D + "/average_" + append_name + ".tsnp", fields);
+
+	averageWeight = 0;
+	std::fill(averageMeans.begin(), averageMeans.end(), 0.0);
+	std::fill(averageSquares.begin(), averageSquares.end(), 0.0);
+}
+
+/**
+ * @brief Adds the names and units of some of the snapshot variables to fields, with the primitive variable (UID) and
+ * cgs scale of each.
+ */
+void DataPrinter::addSnapshotVariables(const std::vector<std::string>& names, SnapshotFields& fields, std::vector<int>& vars,
+		std::vector<double>& scale) const {
+	const Converter& converter = consts->converter;
+	for (const std::string& name : names) {
+		fields.names.push_back(name);
+		if (name == "den") {
+			vars.push_back(UID::DEN);
+			fields.units.push_back("g cm^-3");
+			scale.push_back(converter.density().fromCode);
+		}
+		else if (name == "pre") {
+			vars.push_back(UID::PRE);
+			fields.units.push_back("dyn cm^-2");
+			scale.push_back(converter.pressure().fromCode);
+		}
+		else if (name == "hii") {
+			vars.push_back(UID::HII);
+			fields.units.push_back("");
+			scale.push_back(1.0);
+		}
+		else {
+			vars.push_back(UID::VEL + (name[4] - 'x'));
+			fields.units.push_back("cm s^-1");
+			scale.push_back(converter.velocity().fromCode);
+		}
+	}
+}
+
 /**
  * @brief Prints primitive variables for a 2D slice of the simulation grid in the Grid object pointed to by grid.s
  * @param step Number to append to the output filename.
@@ -137,76 +737,146 @@ void DataPrinter::printBinary2D(const int step, const double t, const Grid& grid
  * @param mpih Provides MPI information for printing with multiple cores.
  */
 void DataPrinter::print2D(const std::string& append_name, const double t, const Grid& grid) const {
+	ScopedTimer timer(ProfileID::PRINT_2D);
 	MPIW& mpihandler = MPIW::Instance();
 	if (!printing_on)
 		return;
-	mpihandler.serial([&] () {
-		// Creating filename.
-		std::ostringstream os;
-		os << dir2D << "/data2D_";
-		os << append_name << ".txt.gz";
-
-		OutputStreamGZ file(os.str().c_str(), std::ios_base::app);
-		if (!file)
-			throw std::runtime_error("DataPrinter::print2D: unable to open" + os.str());
-
-		// Writing data to file.
-		std::stringstream data;
-		file << std::setprecision(10) << std::scientific;
-		if (mpihandler.getRank() == 0) {
-			file << consts->converter.fromCodeUnits(t, 0, 0, 1) << '\n';
-			file << grid.ncells[0] << '\n';
-			file << grid.ncells[1] << '\n';
-			file << grid.ncells[2] << '\n';
-		}
-		for (const GridCell& cell : grid.getIterable("GridCells")){
-			for (int idim = 0; idim < consts->nd; ++idim)
-				file << consts->converter.fromCodeUnits(cell.xc[idim]*grid.dx[idim], 0, 1, 0) << '\t';
-			file << consts->converter.fromCodeUnits(cell.Q[UID::DEN], 1, -3, 0);
-			file << '\t' << consts->converter.fromCodeUnits(cell.Q[UID::PRE], 1, -1, -2);
-			file << '\t' << cell.Q[UID::HII];
-			for (int idim = 0; idim < consts->nd; ++idim)
-				file << '\t' << consts->converter.fromCodeUnits(cell.Q[UID::VEL+idim], 0, 1, -1);
-			file << '\n';
-		}
-		file.close();
+	if (snapshotFormat != SnapshotFormat::TEXT) {
+		printSnapshot(append_name, t, grid);
+		return;
+	}
+	// Creating filename.
+	std::ostringstream os;
+	os << dir2D << "/data2D_";
+	os << append_name << ".txt.gz";
+
+	std::shared_ptr<const std::vector<double>> rows = std::make_shared<std::vector<double>>(stage2D(grid));
+	const std::array<int, 3> ncells = grid.ncells;
+	const bool isRoot = mpihandler.getRank() == 0;
+	const bool threaded = !asyncOutput;
+	writeText(os.str(), dataPack.get(), append_name, t, [this, rows, t, ncells, isRoot, threaded]() -> std::string {
+		std::string text;
+		format2D(text, t, ncells, *rows, isRoot, threaded);
+		return text;
 	});
 }
 
-void DataPrinter::printMinMax(const std::string& filename, const Grid& grid) const {
-	enum MMID {DEN, PRE, HII, VEL, HIIDEN = 6, TEM, KE, N};
-	double maxQ[MMID::N];
-	double minQ[MMID::N];
-	double tempQ[MMID::N];
+/**
+ * @brief Copies the data written by DataPrinter::print2D out of this processor's GridCells.
+ * @param grid The Grid.
+ * @param plane Only copy the cells of this z plane (all cells if negative).
+ * @return A row of nd coordinates, the density, pressure, HII fraction and nd velocities (in code units) per GridCell.
+ */
+std::vector<double> DataPrinter::stage2D(const Grid& grid, int plane) const {
+	const int nd = consts->nd;
+	std::vector<double> rows;
+	rows.reserve((std::size_t)grid.coreCells[0]*grid.coreCells[1]*(plane < 0 ? grid.coreCells[2] : 1)*(2*nd + 3));
+	for (int cellID : grid.getLexicographicIDs()) {
+		const GridCell& cell = grid.getCell(cellID);
+		if (plane >= 0 && (int)std::floor(cell.xc[2]) != plane)
+			continue;
+		stage2DRow(cell, grid, rows);
+	}
+	return rows;
+}
 
-	int i = 0;
-	for (const GridCell& cell : grid.getIterable("GridCells")){
-		tempQ[MMID::DEN] = cell.Q[UID::DEN];
-		tempQ[MMID::PRE] = cell.Q[UID::PRE];
-		tempQ[MMID::HII] = cell.Q[UID::HII];
-		tempQ[MMID::VEL+0] = cell.Q[UID::VEL+0];
-		tempQ[MMID::VEL+1] = cell.Q[UID::VEL+1];
-		tempQ[MMID::VEL+2] = cell.Q[UID::VEL+2];
-		tempQ[MMID::HIIDEN] = tempQ[MMID::HII]*tempQ[MMID::DEN];
-		tempQ[MMID::TEM] = (tempQ[MMID::PRE]/tempQ[MMID::DEN])/(consts->specificGasConstant*(tempQ[MMID::HII]+1));
-		tempQ[MMID::KE] = 0;
-		for (int idim = 0; idim < consts->nd; ++idim)
-			tempQ[MMID::KE] += 0.5*tempQ[MMID::DEN]*tempQ[MMID::VEL+idim]*tempQ[MMID::VEL+idim];
-
-		if (i == 0) {
-			for (int mmid = 0; mmid < MMID::N; ++mmid) {
-				maxQ[mmid] = tempQ[mmid];
-				minQ[mmid] = tempQ[mmid];
-			}
-			++i;
+/**
+ * @brief Appends the row of DataPrinter::stage2D of a GridCell to rows.
+ */
+void DataPrinter::stage2DRow(const GridCell& cell, const Grid& grid, std::vector<double>& rows) const {
+	const int nd = consts->nd;
+	for (int idim = 0; idim < nd; ++idim)
+		rows.push_back(cell.xc[idim]*grid.dx[idim]);
+	rows.push_back(cell.Q[UID::DEN]);
+	rows.push_back(cell.Q[UID::PRE]);
+	rows.push_back(cell.Q[UID::HII]);
+	for (int idim = 0; idim < nd; ++idim)
+		rows.push_back(cell.Q[UID::VEL+idim]);
+}
+
+/**
+ * @brief Appends the header of a data2D or heating file, the time (s) and the number of grid cells along each dimension.
+ */
+static void appendHeader(std::string& out, const double time, const std::array<int, 3>& ncells) {
+	char number[TextFormat::maxScientific];
+	out.append(number, TextFormat::scientific(time, number) - number);
+	out += '\n';
+	for (int i = 0; i < 3; ++i)
+		out += std::to_string(ncells[i]) + '\n';
+}
+
+/**
+ * @brief Writes rows made by DataPrinter::stage2D as the text of a data2D file, in cgs units, every number as
+ * std::scientific with a precision of 10 formats it (see TextFormat).
+ * @param out Text to append to.
+ * @param t Simulation time.
+ * @param ncells Number of grid cells along each dimension.
+ * @param rows Rows from DataPrinter::stage2D.
+ * @param isRoot Whether to write the header (only the root processor's part of the file has one).
+ * @param threaded Format the rows with the OpenMP threads (not in the background, see TextFormat::appendRows).
+ */
+void DataPrinter::format2D(std::string& out, const double t, const std::array<int, 3>& ncells, const std::vector<double>& rows,
+		const bool isRoot, const bool threaded) const {
+	const int nd = consts->nd;
+	const Converter& converter = consts->converter;
+	if (isRoot)
+		appendHeader(out, converter.fromCodeUnits(t, 0, 0, 1), ncells);
+	const int nvars = 2*nd + 3;
+	const double length = converter.length().fromCode, density = converter.density().fromCode;
+	const double pressure = converter.pressure().fromCode, velocity = converter.velocity().fromCode;
+	TextFormat::appendRows(out, rows, nvars, nvars*(TextFormat::maxScientific + 1), threaded, [&](const double* row, char* p) {
+		for (int idim = 0; idim < nd; ++idim) {
+			p = TextFormat::scientific(row[idim]*length, p);
+			*p++ = '\t';
 		}
-		else {
-			for (int mmid = 0; mmid < MMID::N; ++mmid) {
-				maxQ[mmid] = std::max(maxQ[mmid], tempQ[mmid]);
-				minQ[mmid] = std::min(minQ[mmid], tempQ[mmid]);
-			}
+		p = TextFormat::scientific(row[nd]*density, p);
+		*p++ = '\t';
+		p = TextFormat::scientific(row[nd + 1]*pressure, p);
+		*p++ = '\t';
+		p = TextFormat::scientific(row[nd + 2], p);
+		for (int idim = 0; idim < nd; ++idim) {
+			*p++ = '\t';
+			p = TextFormat::scientific(row[nd + 3 + idim]*velocity, p);
 		}
+		*p++ = '\n';
+		return p;
+	});
+}
+
+/**
+ * @brief Appends the smallest and largest density, pressure, HII fraction, velocity components, ionised density,
+ * temperature and kinetic energy density of the Grid to a file, in cgs units. Collective, measured together by a
+ * GridStatistics.
+ */
+void DataPrinter::printMinMax(const std::string& filename, const Grid& grid) const {
+	enum MMID {DEN, PRE, HII, VEL, HIIDEN = VEL + 3, TEM, KE, N};
+	const double specificGasConstant = consts->specificGasConstant;
+	const int nd = consts->nd;
+	GridStatistics stats;
+	std::array<GridStatistics::Quantity, MMID::N> quantities;
+	quantities[MMID::DEN] = [](const GridCell& cell) { return cell.Q[UID::DEN]; };
+	quantities[MMID::PRE] = [](const GridCell& cell) { return cell.Q[UID::PRE]; };
+	quantities[MMID::HII] = [](const GridCell& cell) { return cell.Q[UID::HII]; };
+	for (int idim = 0; idim < 3; ++idim)
+		quantities[MMID::VEL+idim] = [=](const GridCell& cell) { return idim < nd ? cell.Q[UID::VEL+idim] : 0.0; };
+	quantities[MMID::HIIDEN] = [](const GridCell& cell) { return cell.Q[UID::HII]*cell.Q[UID::DEN]; };
+	quantities[MMID::TEM] = [=](const GridCell& cell) {
+		return (cell.Q[UID::PRE]/cell.Q[UID::DEN])/(specificGasConstant*(cell.Q[UID::HII] + 1));
+	};
+	quantities[MMID::KE] = [=](const GridCell& cell) {
+		double ke = 0;
+		for (int idim = 0; idim < nd; ++idim)
+			ke += 0.5*cell.Q[UID::DEN]*cell.Q[UID::VEL+idim]*cell.Q[UID::VEL+idim];
+		return ke;
+	};
+	std::array<int, MMID::N> minQ, maxQ;
+	for (int mmid = 0; mmid < MMID::N; ++mmid) {
+		minQ[mmid] = stats.add(GridStatistics::Reduction::MIN, quantities[mmid]);
+		maxQ[mmid] = stats.add(GridStatistics::Reduction::MAX, quantities[mmid]);
 	}
+	stats.compute(grid);
+	if (MPIW::Instance().getRank() != 0)
+		return;
 
 	// Creating filename.
 	std::ostringstream os;
@@ -222,15 +892,15 @@ void DataPrinter::printMinMax(const std::string& filename, const Grid& grid) con
 	file << "==================================================" << '\n';
 	file << "Time: " << grid.currentTime << '\n';
 	file << "==================================================" << '\n';
-	file << "Density:     " << consts->converter.fromCodeUnits(minQ[MMID::DEN], 1, -3, 0) << '\t' << consts->converter.fromCodeUnits(maxQ[MMID::DEN], 1, -3, 0) << '\n';
-	file << "Pressure:    " << consts->converter.fromCodeUnits(minQ[MMID::PRE], 1, -1, -2) << '\t' << consts->converter.fromCodeUnits(maxQ[MMID::PRE], 1, -1, -2) << '\n';
-	file << "HII:         " << minQ[MMID::HII] << '\t' << maxQ[MMID::HII] << '\n';
-	file << "VEL[0]:      " << consts->converter.fromCodeUnits(minQ[MMID::VEL+0], 0, 1, -1) << '\t' << consts->converter.fromCodeUnits(maxQ[MMID::VEL+0], 0, 1, -1) << '\n';
-	file << "VEL[1]:      " << consts->converter.fromCodeUnits(minQ[MMID::VEL+1], 0, 1, -1) << '\t' << consts->converter.fromCodeUnits(maxQ[MMID::VEL+1], 0, 1, -1) << '\n';
-	file << "VEL[2]:      " << consts->converter.fromCodeUnits(minQ[MMID::VEL+2], 0, 1, -1) << '\t' << consts->converter.fromCodeUnits(maxQ[MMID::VEL+2], 0, 1, -1) << '\n';
-	file << "HII Density: " << consts->converter.fromCodeUnits(minQ[MMID::HIIDEN], 1, -3, 0) << '\t' << consts->converter.fromCodeUnits(maxQ[MMID::HIIDEN], 1, -3, 0) << '\n';
-	file << "Temperature: " << minQ[MMID::TEM] << '\t' << maxQ[MMID::TEM] << '\n';
-	file << "K. Energy:   " << consts->converter.fromCodeUnits(minQ[MMID::KE], 1, -1, -2) << '\t' << consts->converter.fromCodeUnits(maxQ[MMID::KE], 1, -1, -2) << std::endl;
+	const Converter& converter = consts->converter;
+	file << "Density:     " << converter.fromCodeUnits(stats.get(minQ[MMID::DEN]), 1, -3, 0) << '\t' << converter.fromCodeUnits(stats.get(maxQ[MMID::DEN]), 1, -3, 0) << '\n';
+	file << "Pressure:    " << converter.fromCodeUnits(stats.get(minQ[MMID::PRE]), 1, -1, -2) << '\t' << converter.fromCodeUnits(stats.get(maxQ[MMID::PRE]), 1, -1, -2) << '\n';
+	file << "HII:         " << stats.get(minQ[MMID::HII]) << '\t' << stats.get(maxQ[MMID::HII]) << '\n';
+	for (int idim = 0; idim < 3; ++idim)
+		file << "VEL[" << idim << "]:      " << converter.fromCodeUnits(stats.get(minQ[MMID::VEL+idim]), 0, 1, -1) << '\t' << converter.fromCodeUnits(stats.get(maxQ[MMID::VEL+idim]), 0, 1, -1) << '\n';
+	file << "HII Density: " << converter.fromCodeUnits(stats.get(minQ[MMID::HIIDEN]), 1, -3, 0) << '\t' << converter.fromCodeUnits(stats.get(maxQ[MMID::HIIDEN]), 1, -3, 0) << '\n';
+	file << "Temperature: " << stats.get(minQ[MMID::TEM]) << '\t' << stats.get(maxQ[MMID::TEM]) << '\n';
+	file << "K. Energy:   " << converter.fromCodeUnits(stats.get(minQ[MMID::KE]), 1, -1, -2) << '\t' << converter.fromCodeUnits(stats.get(maxQ[MMID::KE]), 1, -1, -2) << std::endl;
 
 	file.close();
 }
@@ -322,99 +992,550 @@ void InputOutput::printIF(const double t, const Radiation& rad, const Grid& grid
 }
  */
 
-void DataPrinter::printHeating(const std::string& append_name, const double t, const Grid& grid) const {
-	MPIW& mpihandler = MPIW::Instance();
-	mpihandler.serial([&] () {
-		/* creating filename */
-		std::ostringstream os;
-		os << dir2D << "/heating_";
-		os << append_name << ".txt.gz";
-		/* opening new file for appending data */
-		OutputStreamGZ file(os.str().c_str(), std::ios_base::app | std::ios_base::binary);
-		if (!file)
-			throw std::runtime_error("DataPrinter::printHeating: unable to open" + os.str());
-		/* writing data to file */
-		std::stringstream data;
-		file << std::setprecision(10) << std::scientific;
-		if (mpihandler.getRank() == 0) {
-			file << consts->converter.fromCodeUnits(t, 0, 0, 1) << '\n';
-			file << grid.ncells[0] << '\n';
-			file << grid.ncells[1] << '\n';
-			file << grid.ncells[2] << '\n';
-		}
-		for (const GridCell& cell : grid.getIterable("GridCells")){
-			for (int idim = 0; idim < consts->nd; ++idim)
-				file << cell.xc[idim] << '\t';
-			file << consts->converter.fromCodeUnits(cell.H[0], 1, -1, -3);
-			for (int i = 1; i < HID::N; ++i)
-				file << '\t' << consts->converter.fromCodeUnits(cell.H[i], 1, -1, -3);
-			file << '\n';
+/**
+ * @brief Writes the snapshots of a checkpoint: the data2D file, the heating file and, if the Grid counts work, the work
+ * file (see DataPrinter::print2D, Grid::countsWork).
+ *
+ * Every product is staged in the same pass over this processor's cells, and the text files are written together, in a
+ * single round over the processors unless they are written in the background or packed. Text heating files have rows of
+ * the nd grid coordinates and the HID::N heating rates, work files of the nd grid coordinates and the WID::N counters
+ * (the HII fraction solver iterations, cooling subcycles and density, pressure and temperature floors applied since they
+ * were last reset); the other snapshot formats go through the SnapshotWriter, in the order of the cells' grid
+ * coordinates. Collective.
+ * @param append_name Suffix of the file names.
+ * @param t Simulation time.
+ * @param grid The Grid.
+ */
+void DataPrinter::printCheckpoint(const std::string& append_name, const double t, const Grid& grid) const {
+	ScopedTimer timer(ProfileID::PRINT_CHECKPOINT);
+	if (!printing_on)
+		return;
+	if (snapshotFormat != SnapshotFormat::TEXT) {
+		printCheckpointSnapshots(append_name, t, grid);
+		return;
+	}
+	const int nd = consts->nd;
+	const bool work = grid.countsWork();
+	const std::size_t ncore = (std::size_t)grid.coreCells[0]*grid.coreCells[1]*grid.coreCells[2];
+	std::shared_ptr<std::vector<double>> dataRows = std::make_shared<std::vector<double>>();
+	std::shared_ptr<std::vector<double>> heatingRows = std::make_shared<std::vector<double>>();
+	std::shared_ptr<std::vector<double>> workRows = std::make_shared<std::vector<double>>();
+	dataRows->reserve(ncore*(2*nd + 3));
+	heatingRows->reserve(ncore*(nd + HID::N));
+	if (work)
+		workRows->reserve(ncore*(nd + WID::N));
+	for (int cellID : grid.getLexicographicIDs()) {
+		const GridCell& cell = grid.getCell(cellID);
+		stage2DRow(cell, grid, *dataRows);
+		for (int idim = 0; idim < nd; ++idim)
+			heatingRows->push_back(cell.xc[idim]);
+		const HeatArray& heating = grid.getHeating(cell.id);
+		heatingRows->insert(heatingRows->end(), heating.begin(), heating.end());
+		if (work) {
+			for (int idim = 0; idim < nd; ++idim)
+				workRows->push_back(cell.xc[idim]);
+			const WorkArray& counts = grid.getWork(cell.id);
+			workRows->insert(workRows->end(), counts.begin(), counts.end());
 		}
+	}
+
+	const std::array<int, 3> ncells = grid.ncells;
+	const bool isRoot = MPIW::Instance().getRank() == 0;
+	const bool threaded = !asyncOutput;
+	std::vector<TextOutput> outputs;
+	outputs.push_back(TextOutput{ dir2D + "/data2D_" + append_name + ".txt.gz", dataPack.get(),
+		[this, dataRows, t, ncells, isRoot, threaded]() -> std::string {
+			std::string text;
+			format2D(text, t, ncells, *dataRows, isRoot, threaded);
+			return text;
+		} });
+	outputs.push_back(TextOutput{ dir2D + "/heating_" + append_name + ".txt.gz", heatingPack.get(),
+		[this, heatingRows, t, ncells, isRoot, threaded]() -> std::string {
+			std::string text;
+			formatHeating(text, t, ncells, *heatingRows, isRoot, threaded);
+			return text;
+		} });
+	if (work) {
+		outputs.push_back(TextOutput{ dir2D + "/work_" + append_name + ".txt.gz", nullptr,
+			[this, workRows, t, ncells, isRoot]() -> std::string {
+				std::ostringstream text;
+				formatWork(text, t, ncells, *workRows, isRoot);
+				return text.str();
+			} });
+	}
+	writeTexts(append_name, t, outputs);
+}
+
+/**
+ * @brief Writes the snapshots of DataPrinter::printCheckpoint through the SnapshotWriter of the snapshot_format, staging
+ * the variables of every file in the same pass over this processor's cells.
+ * @param append_name Suffix of the file names.
+ * @param t Simulation time.
+ * @param grid The Grid.
+ */
+void DataPrinter::printCheckpointSnapshots(const std::string& append_name, const double t, const Grid& grid) const {
+	if (!snapshotWriter)
+		throw std::runtime_error("DataPrinter::printCheckpointSnapshots: snapshots are not initialised (see initialiseSnapshots).");
+	const char* heatingNames[HID::N] = {"imlc", "nmlc", "rhii", "cehi", "ciec", "nmc", "euvh", "fuvh", "irh", "crh", "tot"};
+	const char* workNames[WID::N] = {"hii_iterations", "cooling_substeps", "den_floors", "pre_floors", "temp_floors"};
+	const bool work = grid.countsWork();
+	const std::size_t ncore = (std::size_t)grid.coreCells[0]*grid.coreCells[1]*grid.coreCells[2];
+
+	std::vector<int> vars;
+	std::vector<double> scale;
+	SnapshotFields dataFields = stageFields(t, grid);
+	addSnapshotVariables(snapshotVariables, dataFields, vars, scale);
+	const int nvars = (int)vars.size();
+	dataFields.values.resize(ncore*nvars);
+	SnapshotFields heatingFields = stageFields(t, grid);
+	for (int i = 0; i < HID::N; ++i) {
+		heatingFields.names.push_back(heatingNames[i]);
+		heatingFields.units.push_back("erg cm^-3 s^-1");
+	}
+	heatingFields.values.resize(ncore*HID::N);
+	SnapshotFields workFields = stageFields(t, grid);
+	if (work) {
+		for (int i = 0; i < WID::N; ++i) {
+			workFields.names.push_back(workNames[i]);
+			workFields.units.push_back("");
+		}
+		workFields.values.resize(ncore*WID::N);
+	}
+
+	const double heatingRate = consts->converter.heatingRate().fromCode;
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		const std::size_t icell = boxIndex(cell, grid);
+		for (int ivar = 0; ivar < nvars; ++ivar)
+			dataFields.values[icell*nvars + ivar] = cell.Q[vars[ivar]]*scale[ivar];
+		const HeatArray& heating = grid.getHeating(cell.id);
+		for (int i = 0; i < HID::N; ++i)
+			heatingFields.values[icell*HID::N + i] = heating[i]*heatingRate;
+		if (work) {
+			const WorkArray& counts = grid.getWork(cell.id);
+			for (int i = 0; i < WID::N; ++i)
+				workFields.values[icell*WID::N + i] = counts[i];
+		}
+	}
+
+	const std::string extension = snapshotWriter->extension();
+	(deltaWriter ? *deltaWriter : *snapshotWriter).write(dir2D + "/data2D_" + append_name + extension, dataFields);
+	snapshotWriter->write(dir2D + "/heating_" + append_name + extension, heatingFields);
+	if (work)
+		snapshotWriter->write(dir2D + "/work_" + append_name + extension, workFields);
+}
+
+/**
+ * @brief Writes heating rows staged by DataPrinter::printCheckpoint as the text of a heating file, in cgs units, every
+ * number as std::scientific with a precision of 10 formats it (see TextFormat).
+ * @param out Text to append to.
+ * @param t Simulation time.
+ * @param ncells Number of grid cells along each dimension.
+ * @param rows Rows of the nd grid coordinates and the HID::N heating rates (in code units) per GridCell.
+ * @param isRoot Whether to write the header (only the root processor's part of the file has one).
+ * @param threaded Format the rows with the OpenMP threads (not in the background, see TextFormat::appendRows).
+ */
+void DataPrinter::formatHeating(std::string& out, const double t, const std::array<int, 3>& ncells, const std::vector<double>& rows,
+		const bool isRoot, const bool threaded) const {
+	const int nd = consts->nd;
+	const Converter& converter = consts->converter;
+	if (isRoot)
+		appendHeader(out, converter.fromCodeUnits(t, 0, 0, 1), ncells);
+	const int nvars = nd + HID::N;
+	const double heatingRate = converter.heatingRate().fromCode;
+	TextFormat::appendRows(out, rows, nvars, nvars*(TextFormat::maxScientific + 1), threaded, [&](const double* row, char* p) {
+		for (int idim = 0; idim < nd; ++idim) {
+			p = TextFormat::scientific(row[idim], p);
+			*p++ = '\t';
+		}
+		p = TextFormat::scientific(row[nd]*heatingRate, p);
+		for (int j = 1; j < HID::N; ++j) {
+			*p++ = '\t';
+			p = TextFormat::scientific(row[nd + j]*heatingRate, p);
+		}
+		*p++ = '\n';
+		return p;
 	});
 }
 
-void DataPrinter::printVariables(const int step, const double t, const Grid& grid) const {
+/**
+ * @brief Writes work rows staged by DataPrinter::printCheckpoint as the text of a work file, with the header of the
+ * heating files.
+ * @param out Stream to write to.
+ * @param t Simulation time.
+ * @param ncells Number of grid cells along each dimension.
+ * @param rows Rows of the nd grid coordinates and the WID::N work counters per GridCell.
+ * @param isRoot Whether to write the header (only the root processor's part of the file has one).
+ */
+void DataPrinter::formatWork(std::ostream& out, const double t, const std::array<int, 3>& ncells, const std::vector<double>& rows, const bool isRoot) const {
+	const int nd = consts->nd;
+	if (isRoot) {
+		out << std::setprecision(10) << std::scientific << consts->converter.fromCodeUnits(t, 0, 0, 1) << '\n';
+		out << ncells[0] << '\n' << ncells[1] << '\n' << ncells[2] << '\n';
+	}
+	out << std::fixed << std::setprecision(1);
+	const int nvars = nd + WID::N;
+	for (std::size_t i = 0; i + nvars <= rows.size(); i += nvars) {
+		const double* row = &rows[i];
+		for (int idim = 0; idim < nd; ++idim)
+			out << row[idim] << '\t';
+		out << row[nd];
+		for (int j = 1; j < WID::N; ++j)
+			out << '\t' << row[nd + j];
+		out << '\n';
+	}
+}
+
+/**
+ * @brief Writes the exact state of every core GridCell and of the integration to restart_<append_name>.trst, which
+ * all processors write at once, each compressing its own records first if compressRestarts is set.
+ * @param append_name Suffix of the file name.
+ * @param grid The Grid, at the end of a step.
+ * @param steps Number of steps taken.
+ * @param checkpoint Number of checkpoints passed.
+ * @param splitPhase Operator splitting phase of the next step.
+ * @param deltatime Time step the limiters allowed at the last step, before a checkpoint cut it short, which the steps
+ * after a restart grow from.
+ * @see RestartHeader
+ */
+void DataPrinter::printRestart(const std::string& append_name, const Grid& grid, const long steps, const int checkpoint,
+		const int splitPhase, const double deltatime) const {
+	ScopedTimer timer(ProfileID::PRINT_RESTART);
+	if (!printing_on)
+		return;
+	const Converter& converter = consts->converter;
+	RestartHeader header;
+	header.nd = consts->nd;
+	header.ncells = grid.ncells;
+	header.checkpoint = checkpoint;
+	header.splitPhase = splitPhase;
+	header.nrecords = (long long)grid.ncells[0]*grid.ncells[1]*grid.ncells[2];
+	header.steps = steps;
+	header.time = grid.currentTime;
+	header.deltatime = deltatime;
+	header.sideLength = grid.sideLength;
+	header.scales = std::array<double, 3>{{ converter.fromCodeUnits(1.0, 1, 0, 0), converter.fromCodeUnits(1.0, 0, 1, 0),
+		converter.fromCodeUnits(1.0, 0, 0, 1) }};
+
+	// This processor's box of records, x fastest.
+	const int ncore = grid.coreCells[0]*grid.coreCells[1]*grid.coreCells[2];
+	std::vector<double> records((std::size_t)ncore*RestartHeader::recordSize);
+	int i = 0;
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		RestartHeader::pack(grid, cell, &records[(std::size_t)boxIndex(cell, grid)*RestartHeader::recordSize]);
+		++i;
+	}
+	if (i != ncore)
+		throw std::runtime_error("DataPrinter::printRestart: buffer not filled.");
+
+	std::ostringstream os;
+	os << dir2D << "/restart_" << append_name << ".trst";
+	if (compressRestarts) {
+		header.fileVersion = RestartHeader::compressedVersion;
+		const std::vector<char> part = RestartCodec::encode(records, grid.coreOffset, grid.coreCells);
+		OutputStaging::Instance().writeOrdered(os.str(), header.serialise(), part.data(), (int)part.size());
+		return;
+	}
+	OutputStaging::Instance().writeBox(os.str(), header.serialise(), (const char*)records.data(),
+			RestartHeader::recordSize*sizeof(double), grid.ncells, grid.coreCells, grid.coreOffset);
+}
+
+/**
+ * @brief Writes the in-situ analysis of the Grid: the time series, radial profiles and slice configured by
+ * initialiseAnalysis. Collective.
+ *
+ * The analysis is reduced over the processors, so it can be written at every checkpoint for a fraction of the cost and
+ * size of a data2D snapshot, which can then be written rarely (see Integration.snapshot_every). An analysis plug-in is
+ * called even if nothing is written to disk.
+ * @param append_name Suffix of the names of the profile and slice files.
+ * @param rad The Radiation, for the hydrogen mass fraction.
+ * @param fluid The Fluid, whose primitive variables are up to date.
+ */
+void DataPrinter::printAnalysis(const std::string& append_name, const Radiation& rad, const Fluid& fluid) const {
+	ScopedTimer timer(ProfileID::PRINT_ANALYSIS);
+	if (analysisHook)
+		analysisHook->analyse(append_name, *consts, fluid);
+	if (!printing_on)
+		return;
+	if (analysis_on)
+		printTimeSeries(rad, fluid);
+	if (analysisProfileBins > 0)
+		printProfiles(append_name, fluid);
+	if (analysisSlice && consts->nd == 3)
+		printSlice(append_name, fluid);
+}
+
+/**
+ * @brief Distance of a GridCell's centre from the Star (from the origin if there is no Star), in code units.
+ */
+double DataPrinter::distanceToStar(const GridCell& cell, const Fluid& fluid) const {
+	const Grid& grid = fluid.getGrid();
+	const Star& star = fluid.getStar();
+	double r2 = 0;
+	for (int idim = 0; idim < consts->nd; ++idim) {
+		const double x = (cell.xc[idim] - (star.on ? star.xc[idim] : 0))*grid.dx[idim];
+		r2 += x*x;
+	}
+	return std::sqrt(r2);
+}
+
+/**
+ * @brief Measures the ionised mass, the ionisation front radius in cell widths and the largest density of the Grid, in
+ * code units, in the order of OutputTrigger::Measure. Collective.
+ *
+ * The front radius is that of DataPrinter::printTimeSeries, over the width of a cell along x.
+ */
+std::array<double, 3> DataPrinter::measureChange(const Fluid& fluid) const {
+	ScopedTimer timer(ProfileID::PRINT_ANALYSIS);
+	const Grid& grid = fluid.getGrid();
+	GridStatistics stats;
+	const int ionisedMass = stats.add(GridStatistics::Reduction::SUM, [](const GridCell& cell) {
+		return cell.Q[UID::HII]*cell.Q[UID::DEN]*cell.vol;
+	});
+	const int front = stats.add(GridStatistics::Reduction::MAX, [&](const GridCell& cell) {
+		return cell.Q[UID::HII] >= 0.5 ? distanceToStar(cell, fluid) : 0.0;
+	});
+	const int maxDensity = stats.add(GridStatistics::Reduction::MAX, [](const GridCell& cell) {
+		return cell.Q[UID::DEN];
+	});
+	stats.compute(grid);
+	return std::array<double, 3>{{ stats.get(ionisedMass), stats.get(front)/grid.dx[0], stats.get(maxDensity) }};
+}
+
+/**
+ * @brief Appends the total mass, ionised mass and volume, ionisation front radius, emission measure and kinetic
+ * energy of the Grid to analysis.txt, in cgs units.
+ *
+ * The front radius is the distance from the Star of the furthest cell that is at least half ionised. The volumes are
+ * those of the Grid's geometry, so they are per unit length (or area) of the missing dimensions of 1D and 2D
+ * cartesian grids.
+ */
+void DataPrinter::printTimeSeries(const Radiation& rad, const Fluid& fluid) const {
 	MPIW& mpihandler = MPIW::Instance();
-	mpihandler.serial([&] () {
-		/* creating filename */
-		std::ostringstream os;
-		os << dir2D << "/heating_";
-		os << step << ".txt.gz";
-		/* opening new file for appending data */
-		OutputStreamGZ file(os.str().c_str(), std::ios_base::app | std::ios_base::binary);
-		if (!file)
-			throw std::runtime_error("DataPrinter::printVariables: unable to open" + os.str());
-		/* writing data to file */
-		std::stringstream data;
-		file << std::setprecision(10) << std::scientific;
-		if (mpihandler.getRank() == 0) {
-			file << consts->converter.fromCodeUnits(t, 0, 0, 1) << '\n';
-			file << grid.ncells[0] << '\n';
-			file << grid.ncells[1] << '\n';
-			file << grid.ncells[2] << '\n';
-		}
-		for (const GridCell& cell : grid.getIterable("GridCells")){
-			for (int idim = 0; idim < consts->nd; ++idim)
-				file << cell.xc[idim] << '\t';
-			file << cell.H[0];
-			for (int i = 1; i < HID::N; ++i)
-				file << '\t' << cell.H[i];
-			file << '\n';
-		}
+	const Grid& grid = fluid.getGrid();
+	const Converter& converter = consts->converter;
+	const int nd = consts->nd;
+	const double hydrogenMass = consts->hydrogenMass, massFractionH = rad.massFractionH;
+	GridStatistics stats;
+	const int mass = stats.add(GridStatistics::Reduction::SUM, [](const GridCell& cell) {
+		return cell.Q[UID::DEN]*cell.vol;
+	});
+	const int ionisedMass = stats.add(GridStatistics::Reduction::SUM, [](const GridCell& cell) {
+		return cell.Q[UID::HII]*cell.Q[UID::DEN]*cell.vol;
+	});
+	const int ionisedVolume = stats.add(GridStatistics::Reduction::SUM, [](const GridCell& cell) {
+		return cell.Q[UID::HII]*cell.vol;
+	});
+	const int emissionMeasure = stats.add(GridStatistics::Reduction::SUM, [=](const GridCell& cell) {
+		const double nHII = cell.Q[UID::HII]*massFractionH*cell.Q[UID::DEN]/hydrogenMass;
+		return nHII*nHII*cell.vol;
+	});
+	const int kineticEnergy = stats.add(GridStatistics::Reduction::SUM, [=](const GridCell& cell) {
+		double v2 = 0;
+		for (int idim = 0; idim < nd; ++idim)
+			v2 += cell.Q[UID::VEL+idim]*cell.Q[UID::VEL+idim];
+		return 0.5*cell.Q[UID::DEN]*cell.vol*v2;
 	});
+	const int front = stats.add(GridStatistics::Reduction::MAX, [&](const GridCell& cell) {
+		return cell.Q[UID::HII] >= 0.5 ? distanceToStar(cell, fluid) : 0.0;
+	});
+	stats.compute(grid);
+	if (mpihandler.getRank() != 0)
+		return;
+
+	const std::string filename = dir2D + "/analysis.txt";
+	const bool isNew = !std::ifstream(filename);
+	std::ofstream file(filename, std::ios_base::app);
+	if (!file)
+		throw std::runtime_error("DataPrinter::printTimeSeries: unable to open " + filename);
+	if (isNew)
+		file << "# time(s) mass(g) ionised_mass(g) ionised_volume(cm3) front_radius(cm) emission_measure(cm-3) kinetic_energy(erg)\n";
+	file << std::setprecision(10) << std::scientific;
+	file << converter.fromCodeUnits(grid.currentTime, 0, 0, 1);
+	file << '\t' << converter.fromCodeUnits(stats.get(mass), 1, 0, 0);
+	file << '\t' << converter.fromCodeUnits(stats.get(ionisedMass), 1, 0, 0);
+	file << '\t' << converter.fromCodeUnits(stats.get(ionisedVolume), 0, 3, 0);
+	file << '\t' << converter.fromCodeUnits(stats.get(front), 0, 1, 0);
+	file << '\t' << converter.fromCodeUnits(stats.get(emissionMeasure), 0, -3, 0);
+	file << '\t' << converter.fromCodeUnits(stats.get(kineticEnergy), 1, 2, -2) << '\n';
 }
 
-void DataPrinter::printVariable(const int step, const double t, const Grid& grid) const {
+/**
+ * @brief Writes the spherically averaged density, pressure, HII fraction and radial velocity about the Star to
+ * profile_<append_name>.txt, in cgs units.
+ *
+ * The bins are equally wide out to the furthest cell centre. The density is the mass of a bin over its volume, the
+ * pressure and HII fraction are volume weighted and the radial velocity is mass weighted. Empty bins are left out.
+ * @param append_name Suffix of the file name.
+ * @param fluid The Fluid.
+ */
+void DataPrinter::printProfiles(const std::string& append_name, const Fluid& fluid) const {
 	MPIW& mpihandler = MPIW::Instance();
-	mpihandler.serial([&] () {
-		/* creating filename */
-		std::ostringstream os;
-		os << dir2D << "/var_";
-		os << step << ".txt.gz";
-		/* opening new file for appending data */
-		OutputStreamGZ file(os.str().c_str(), std::ios_base::app | std::ios_base::binary);
-		if (!file)
-			throw std::runtime_error("DataPrinter::printVariable: unable to open" + os.str());
-		/* writing data to file */
-		std::stringstream data;
-		file << std::setprecision(10) << std::scientific;
-		if (mpihandler.getRank() == 0) {
-			file << consts->converter.fromCodeUnits(t, 0, 0, 1) << '\n';
-			file << grid.ncells[0] << '\n';
-			file << grid.ncells[1] << '\n';
-			file << grid.ncells[2] << '\n';
-		}
-		for (const GridCell& cell : grid.getIterable("GridCells")){
+	const Grid& grid = fluid.getGrid();
+	const Converter& converter = consts->converter;
+	const Star& star = fluid.getStar();
+	const int nbins = analysisProfileBins;
+
+	double rmax = 0;
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS))
+		rmax = std::max(rmax, distanceToStar(cell, fluid));
+	rmax = mpihandler.maximum(rmax);
+
+	enum PID {VOL, MASS, PRE, HII, MOM, N};
+	std::vector<double> bins(nbins*PID::N, 0);
+	for (int cellID : grid.getLexicographicIDs()) {
+		const GridCell& cell = grid.getCell(cellID);
+		const double r = distanceToStar(cell, fluid);
+		const int ib = (rmax > 0) ? std::min(nbins - 1, (int)(nbins*r/rmax)) : 0;
+		double vr = 0;
+		if (r > 0) {
 			for (int idim = 0; idim < consts->nd; ++idim)
-				file << cell.xc[idim] << '\t';
-			file << cell.H[0] << '\n';
+				vr += cell.Q[UID::VEL+idim]*(cell.xc[idim] - (star.on ? star.xc[idim] : 0))*grid.dx[idim]/r;
+		}
+		double* bin = &bins[ib*PID::N];
+		bin[PID::VOL] += cell.vol;
+		bin[PID::MASS] += cell.Q[UID::DEN]*cell.vol;
+		bin[PID::PRE] += cell.Q[UID::PRE]*cell.vol;
+		bin[PID::HII] += cell.Q[UID::HII]*cell.vol;
+		bin[PID::MOM] += cell.Q[UID::DEN]*cell.vol*vr;
+	}
+	bins = mpihandler.sum(bins);
+	if (mpihandler.getRank() != 0)
+		return;
+
+	const std::string filename = dir2D + "/profile_" + append_name + ".txt";
+	std::ofstream file(filename);
+	if (!file)
+		throw std::runtime_error("DataPrinter::printProfiles: unable to open " + filename);
+	file << std::setprecision(10) << std::scientific;
+	file << converter.fromCodeUnits(grid.currentTime, 0, 0, 1) << '\n';
+	file << "# radius(cm) density(g/cm3) pressure(dyn/cm2) hii velocity_r(cm/s)\n";
+	for (int ib = 0; ib < nbins; ++ib) {
+		const double* bin = &bins[ib*PID::N];
+		if (bin[PID::VOL] <= 0)
+			continue;
+		file << converter.fromCodeUnits((ib + 0.5)*rmax/nbins, 0, 1, 0);
+		file << '\t' << converter.fromCodeUnits(bin[PID::MASS]/bin[PID::VOL], 1, -3, 0);
+		file << '\t' << converter.fromCodeUnits(bin[PID::PRE]/bin[PID::VOL], 1, -1, -2);
+		file << '\t' << bin[PID::HII]/bin[PID::VOL];
+		file << '\t' << converter.fromCodeUnits(bin[PID::MASS] > 0 ? bin[PID::MOM]/bin[PID::MASS] : 0, 0, 1, -1) << '\n';
+	}
+}
+
+/**
+ * @brief Writes the z plane of cells through the Star (the middle plane if there is no Star) of a 3D Grid to
+ * slice_<append_name>.txt.gz, in the format of DataPrinter::print2D with one cell along z.
+ * @param append_name Suffix of the file name.
+ * @param fluid The Fluid.
+ */
+void DataPrinter::printSlice(const std::string& append_name, const Fluid& fluid) const {
+	MPIW& mpihandler = MPIW::Instance();
+	const Grid& grid = fluid.getGrid();
+	const Star& star = fluid.getStar();
+	int plane = star.on ? (int)std::floor(star.xc[2]) : grid.ncells[2]/2;
+	plane = std::max(0, std::min(grid.ncells[2] - 1, plane));
+	const std::array<int, 3> ncells = std::array<int, 3>{{ grid.ncells[0], grid.ncells[1], 1 }};
+	const double t = grid.currentTime;
+	const std::string filename = dir2D + "/slice_" + append_name + ".txt.gz";
+
+	if (asyncOutput) {
+		std::shared_ptr<const std::vector<double>> rows = std::make_shared<std::vector<double>>(stage2D(grid, plane));
+		const bool isRoot = mpihandler.getRank() == 0;
+		asyncWriter.submit(filename, [this, rows, t, ncells, isRoot]() -> std::string {
+			std::string text;
+			format2D(text, t, ncells, *rows, isRoot, false);
+			return text;
+		}, compressionLevel);
+		return;
+	}
+
+	std::string text;
+	format2D(text, t, ncells, stage2D(grid, plane), mpihandler.getRank() == 0, true);
+	appendCompressed(filename, text);
+}
+
+/**
+ * @brief Compresses every processor's text with the OpenMP threads and appends it to a gzip file in rank order.
+ * @param filename Name of the file.
+ * @param text This processor's text.
+ */
+void DataPrinter::appendCompressed(const std::string& filename, const std::string& text) const {
+	appendCompressed(std::vector<std::string>(1, filename), std::vector<std::vector<char>>(1, BlockGZ::compress(text, compressionLevel, true)));
+}
+
+/**
+ * @brief Appends every processor's compressed part of each file to it in rank order, all of the files in a single round
+ * over the processors.
+ * @param filenames Names of the files.
+ * @param parts This processor's gzip members of each file.
+ */
+void DataPrinter::appendCompressed(const std::vector<std::string>& filenames, const std::vector<std::vector<char>>& parts) const {
+	MPIW::Instance().serial([&] () {
+		for (unsigned int i = 0; i < filenames.size(); ++i) {
+			std::ofstream file(filenames[i], std::ios_base::app | std::ios_base::binary);
+			if (!file)
+				throw std::runtime_error("DataPrinter::appendCompressed: unable to open " + filenames[i]);
+			file.write(parts[i].data(), parts[i].size());
 		}
 	});
 }
 
-void DataPrinter::printWeights(const Grid& grid) const {
+/**
+ * @brief Writes gzipped text made by every processor to a file in rank order, or appends it to a container as a frame,
+ * in the background with async_output. Collective.
+ * @param filename Name of the file, if there is no container.
+ * @param container Container the text is appended to, or nullptr to write the file.
+ * @param append_name Name of the frame in the container.
+ * @param t Simulation time.
+ * @param format Makes this processor's text, capturing by value everything it reads (see AsyncWriter::submit).
+ */
+void DataPrinter::writeText(const std::string& filename, FrameContainer* container, const std::string& append_name, const double t,
+		std::function<std::string()> format) const {
+	const double time = consts->converter.fromCodeUnits(t, 0, 0, 1);
+	if (asyncOutput && container != nullptr)
+		asyncWriter.submitFrame(*container, append_name, time, format, compressionLevel);
+	else if (asyncOutput)
+		asyncWriter.submit(filename, format, compressionLevel);
+	else if (container != nullptr)
+		container->append(append_name, time, BlockGZ::compress(format(), compressionLevel, true));
+	else
+		appendCompressed(filename, format());
+}
+
+/**
+ * @brief Writes several text outputs as DataPrinter::writeText would, but the files of all of them in a single round
+ * over the processors unless they are written in the background. Collective.
+ * @param append_name Name of the frames in the containers.
+ * @param t Simulation time.
+ * @param outputs The outputs.
+ */
+void DataPrinter::writeTexts(const std::string& append_name, const double t, const std::vector<TextOutput>& outputs) const {
+	std::vector<std::string> filenames;
+	std::vector<std::vector<char>> parts;
+	for (const TextOutput& output : outputs) {
+		if (asyncOutput || output.container != nullptr)
+			writeText(output.filename, output.container, append_name, t, output.format);
+		else {
+			filenames.push_back(output.filename);
+			parts.push_back(BlockGZ::compress(output.format(), compressionLevel, true));
+		}
+	}
+	if (!filenames.empty())
+		appendCompressed(filenames, parts);
+}
+
+/**
+ * @brief Writes any output still being formatted in the background (see Integration.async_output). Collective, and
+ * waits for the output if it is not ready.
+ */
+void DataPrinter::flush() {
+	ScopedTimer timer(ProfileID::PRINT_FLUSH);
+	asyncWriter.flush();
+}
+
+void DataPrinter::printWeights(const Grid& grid, const Vec3& starPos) const {
 	std::ofstream ofile("tmp/weights.dat", std::ios::app);
-	for (const GridCell& cell : grid.getIterable("GridCells")){
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)){
+		const RayGeometry& ray = grid.getRayGeometry(cell.id);
 		ofile << "{ ";
 		for (int i = 0; i < 3; ++i) {
 			if (cell.xc[i] < 10)
@@ -427,18 +1548,18 @@ void DataPrinter::printWeights(const Grid& grid) const {
 		ofile << std::fixed << std::setprecision(3);
 		for (int i = 0; i < 4; ++i) {
 			std::ostringstream os;
-			if (cell.neighbourIDs[i] != -1) {
-				double diff = grid.getCell(cell.neighbourIDs[i]).xc[0]-cell.xc[0];
+			if (ray.neighbourIDs[i] != -1) {
+				double diff = grid.getCell(ray.neighbourIDs[i]).xc[0]-cell.xc[0];
 				if (diff > 0)
 					os << "(+x)";
 				else if (diff < 0)
 					os << "(-x)";
-				diff = grid.getCell(cell.neighbourIDs[i]).xc[1]-cell.xc[1];
+				diff = grid.getCell(ray.neighbourIDs[i]).xc[1]-cell.xc[1];
 				if (diff > 0)
 					os << "(+y)";
 				else if (diff < 0)
 					os << "(-y)";
-				diff = grid.getCell(cell.neighbourIDs[i]).xc[2]-cell.xc[2];
+				diff = grid.getCell(ray.neighbourIDs[i]).xc[2]-cell.xc[2];
 				if (diff > 0)
 					os << "(+z)";
 				else if (diff < 0)
@@ -454,8 +1575,8 @@ void DataPrinter::printWeights(const Grid& grid) const {
 			ofile << os.str() << " ";
 		}
 		ofile << "} = { ";
-		for (int i = 0; i < 4; ++i)
-			ofile << cell.neighbourWeights[i] << " ";
+		for (double weight : grid.neighbourWeights(cell.xc, starPos))
+			ofile << weight << " ";
 		ofile << "}\n";
 	}
 	ofile.close();
@@ -473,7 +1594,7 @@ void InputOutput::printCellPathLength(const Grid& grid) const {
 		}
 		ofile << "}:   ds = ";
 		ofile << std::fixed << std::setprecision(5);
-		ofile << cell.ds << '\n';
+		ofile << grid.getRayGeometry(cell.id).ds << '\n';
 	}
 	ofile.close();
 }
@@ -8,12 +8,22 @@
 #ifndef DATAPRINTER_HPP_
 #define DATAPRINTER_HPP_
 
+#include <array>
+#include <functional>
+#include <iosfwd>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "AnalysisHook.hpp"
+#include "AsyncWriter.hpp"
+#include "FrameContainer.hpp"
+#include "SnapshotWriter.hpp"
+#include "Torch/Common.hpp"
+
 class PrintParameters;
+struct RegionParameters;
 class Converter;
 class Fluid;
 class Radiation;
@@ -21,6 +31,7 @@ class Hydrodynamics;
 class Constants;
 class Fluid;
 class Grid;
+class GridCell;
 
 /**
  * @class DataPrinter
@@ -29,18 +40,34 @@ class Grid;
  */
 class DataPrinter {
 public:
-	void initialise(std::shared_ptr<Constants> c, std::string output_directory);
+	void initialise(std::shared_ptr<Constants> c, std::string output_directory, SnapshotFormat format = SnapshotFormat::TEXT, bool async = false,
+			int level = 6);
+	void initialiseAnalysis(bool on, int profileBins, bool slice, const std::string& library = "");
+	void initialiseSnapshots(const std::string& variables, SnapshotPrecision precision, int keyframeEvery = 1, double deltaTolerance = 0);
+	void initialisePacking(bool pack, const std::string& suffix = "");
+	void initialiseRestarts(bool compress);
+	void initialiseRegions(const std::vector<RegionParameters>& regions);
+	void initialisePreview(int every, int factor);
+	void initialiseTimeAverages(const std::string& variables, bool variances);
 
 	//Output.
 	void freqPrint(const Radiation& rad, const Grid& grid) const;
 	void printSTARBENCH(const Radiation& rad, const Hydrodynamics& hydro, Fluid& fluid);
 	void printBinary2D(const int step, const double t, const Grid& grid) const;
 	void print2D(const std::string& append_name, const double t, const Grid& grid) const;
+	void printSnapshot(const std::string& append_name, const double t, const Grid& grid) const;
+	void printRestart(const std::string& append_name, const Grid& grid, const long steps, const int checkpoint,
+			const int splitPhase, const double deltatime) const;
 	void printMinMax(const std::string& filename, const Grid& grid) const;
-	void printHeating(const std::string& append_name, const double t, const Grid& grid) const;
-	void printVariables(const int step, const double t, const Grid& grid) const;
-	void printVariable(const int step, const double t, const Grid& grid) const;
-	void printWeights(const Grid& grid) const;
+	void printCheckpoint(const std::string& append_name, const double t, const Grid& grid) const;
+	void printWeights(const Grid& grid, const Vec3& starPos) const;
+	void printAnalysis(const std::string& append_name, const Radiation& rad, const Fluid& fluid) const;
+	void printRegions(const long step, const double t, const Fluid& fluid) const;
+	void printPreview(const long step, const double t, const Fluid& fluid) const;
+	void accumulateTimeAverages(const double dt, const Radiation& rad, const Fluid& fluid);
+	void printTimeAverages(const std::string& append_name, const double t, const Fluid& fluid);
+	std::array<double, 3> measureChange(const Fluid& fluid) const;
+	void flush();
 
 	//Input.
 	void fileToMap(const std::string& myString, std::map<double,double> myMap) const;
@@ -53,11 +80,81 @@ public:
 	void reduceToPrint(const double currTime, double& dt) const;
 
 private:
+	/**
+	 * @brief A text file, or a frame of a container, waiting to be formatted and written (see DataPrinter::writeText).
+	 */
+	struct TextOutput {
+		std::string filename; //!< Name of the file, if there is no container.
+		FrameContainer* container; //!< Container the text is appended to, or nullptr to write the file.
+		std::function<std::string()> format; //!< Makes this processor's text.
+	};
+
+	/**
+	 * @brief A box of the grid written at its own cadence (see printRegions).
+	 */
+	struct Region {
+		std::array<double, 3> lower; //!< Lower corner of the box, in cells or cm.
+		std::array<double, 3> upper; //!< Upper corner of the box, in cells or cm.
+		bool inCells = true; //!< The corners are grid coordinates rather than distances (cm).
+		bool relativeToStar = false; //!< The corners are measured from the cell of the Star.
+		int every = 1; //!< Steps between the outputs.
+		std::vector<std::string> variables; //!< Variables written, in order.
+	};
+
+	std::vector<double> stage2D(const Grid& grid, int plane = -1) const;
+	void stage2DRow(const GridCell& cell, const Grid& grid, std::vector<double>& rows) const;
+	void format2D(std::string& out, const double t, const std::array<int, 3>& ncells, const std::vector<double>& rows,
+			const bool isRoot, const bool threaded) const;
+	SnapshotFields stageFields(const double t, const Grid& grid) const;
+	int boxIndex(const GridCell& cell, const Grid& grid) const;
+	std::vector<std::string> parseSnapshotVariables(const std::string& variables, const std::string& parameter) const;
+	void addSnapshotVariables(const std::vector<std::string>& names, SnapshotFields& fields, std::vector<int>& vars,
+			std::vector<double>& scale) const;
+	void printCheckpointSnapshots(const std::string& append_name, const double t, const Grid& grid) const;
+	void formatHeating(std::string& out, const double t, const std::array<int, 3>& ncells, const std::vector<double>& rows,
+			const bool isRoot, const bool threaded) const;
+	void formatWork(std::ostream& out, const double t, const std::array<int, 3>& ncells, const std::vector<double>& rows, const bool isRoot) const;
+	void appendCompressed(const std::string& filename, const std::string& text) const;
+	void appendCompressed(const std::vector<std::string>& filenames, const std::vector<std::vector<char>>& parts) const;
+	void writeText(const std::string& filename, FrameContainer* container, const std::string& append_name, const double t,
+			std::function<std::string()> format) const;
+	void writeTexts(const std::string& append_name, const double t, const std::vector<TextOutput>& outputs) const;
+	void printTimeSeries(const Radiation& rad, const Fluid& fluid) const;
+	void printProfiles(const std::string& append_name, const Fluid& fluid) const;
+	void printSlice(const std::string& append_name, const Fluid& fluid) const;
+	double distanceToStar(const GridCell& cell, const Fluid& fluid) const;
+
 	std::shared_ptr<Constants> consts = nullptr;
 	std::string dir2D = "tmp/";
 	std::vector<double> printTimes;
 	std::vector<bool> printDone;
 	bool printing_on = true;
+	SnapshotFormat snapshotFormat = SnapshotFormat::TEXT;
+	int compressionLevel = 6; //!< zlib level of the gzipped text output.
+	std::vector<std::string> snapshotVariables; //!< Variables of the binary and HDF5 snapshots, in order (see printSnapshot).
+	SnapshotPrecision snapshotPrecision = SnapshotPrecision::FLOAT64; //!< Storage of the values of the binary and HDF5 snapshots.
+	std::unique_ptr<SnapshotWriter> snapshotWriter; //!< Writes the snapshots of every format but TEXT.
+	std::unique_ptr<SnapshotWriter> deltaWriter; //!< Writes the data2D snapshots as keyframes and deltas, if they are delta encoded.
+	std::vector<Region> regions; //!< Boxes of the grid written as binary snapshots of their own (see printRegions).
+	int previewEvery = 0; //!< Steps between the downsampled previews of the grid (0 for none, see printPreview).
+	int previewFactor = 4; //!< Cells along each dimension averaged into a cell of the previews.
+	std::vector<std::string> averageVariables; //!< Variables averaged over time, in order (none to average nothing, see printTimeAverages).
+	std::vector<int> averageUIDs; //!< Primitive variable (UID) of each averaged variable, or -1 for ne and -2 for ne2.
+	bool averageVariances = false; //!< Write the variances about the time averages too.
+	double averageWeight = 0; //!< Time the averages are over so far.
+	std::vector<double> averageMeans; //!< Running averages of each core cell, by ID from the first, variable fastest.
+	std::vector<double> averageSquares; //!< Sums of the time-weighted squared deviations from the averages, as averageMeans.
+	std::array<int, 3> averageOffset = {{ 0, 0, 0 }}; //!< Grid coordinates of the first cell of the box averaged.
+	std::array<int, 3> averageCells = {{ 0, 0, 0 }}; //!< Cells of the box averaged along each dimension.
+	bool asyncOutput = false; //!< Format and compress the text output in the background (see AsyncWriter).
+	bool analysis_on = false; //!< Write the time series of the in-situ analysis at every checkpoint (see printAnalysis).
+	int analysisProfileBins = 0; //!< Number of radial bins of the analysis profiles (0 for none).
+	bool analysisSlice = false; //!< Write the analysis slice through the Star of 3D grids.
+	std::unique_ptr<AnalysisHook> analysisHook; //!< Plug-in handed the cells at every checkpoint, if there is one.
+	std::unique_ptr<FrameContainer> dataPack; //!< Container the data2D text snapshots are appended to, if they are packed.
+	std::unique_ptr<FrameContainer> heatingPack; //!< Container the heating text files are appended to, if they are packed.
+	bool compressRestarts = false; //!< Compress the records of the restart files (see RestartCodec).
+	mutable AsyncWriter asyncWriter; //!< Last member, so it finishes with the output before anything it uses goes.
 };
 
 struct PrintParameters {
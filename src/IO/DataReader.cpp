@@ -8,22 +8,232 @@
 #include <math.h>
 #include <limits>
 #include <algorithm>
-#include <fstream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include <zlib.h>
 
 #include "DataReader.hpp"
+#include "CellOwners.hpp"
+#include "MappedFile.hpp"
+#include "Restart.hpp"
+#include "SnapshotReader.hpp"
 #include "Fluid/Fluid.hpp"
+#include "Torch/Converter.hpp"
 #include "Torch/Parameters.hpp"
 #include "MPI/MPI_Wrapper.hpp"
 
+namespace {
+
+const int TEXT_HEADER_LINES = 4; //!< Lines of the time and number of cells along each dimension at the top of a data text file.
+
+/**
+ * @brief The start of a data text file, which may be gzipped.
+ */
+struct TextHead {
+	std::string text; //!< Up to the first 64 KiB of the (inflated) text.
+	bool isCompressed = false; //!< Whether the file is gzipped.
+};
+
+TextHead readHead(const std::string& filename, const std::string& caller) {
+	gzFile file = gzopen(filename.c_str(), "rb");
+	if (file == nullptr)
+		throw std::runtime_error(caller + ": invalid input file " + filename + ".");
+	TextHead head;
+	std::vector<char> bytes(1 << 16);
+	int n = gzread(file, bytes.data(), (unsigned int)bytes.size());
+	head.isCompressed = (gzdirect(file) == 0);
+	gzclose(file);
+	if (n < 0)
+		throw std::runtime_error(caller + ": unable to read " + filename + ".");
+	head.text.assign(bytes.data(), n);
+	return head;
+}
+
+/**
+ * @brief Reads the (inflated) text of a file that may be gzipped in large blocks, reading and inflating the next block
+ * on a background thread while the caller parses the last.
+ */
+class ReadAhead {
+public:
+	static const std::size_t blockSize = 1 << 22;
+
+	ReadAhead(const std::string& filename, const std::string& caller)
+		: m_failure(caller + ": unable to inflate " + filename + ".")
+	{
+		m_file = gzopen(filename.c_str(), "rb");
+		if (m_file == nullptr)
+			throw std::runtime_error(caller + ": invalid input file " + filename + ".");
+		gzbuffer(m_file, 1 << 20);
+		prefetch();
+	}
+	~ReadAhead() {
+		if (m_next.valid())
+			m_next.wait();
+		gzclose(m_file);
+	}
+	ReadAhead(const ReadAhead&) = delete;
+	ReadAhead& operator=(const ReadAhead&) = delete;
+
+	/**
+	 * @brief Moves the next block of text into block.
+	 * @return False at the end of the file.
+	 */
+	bool next(std::vector<char>& block) {
+		block = m_next.get();
+		if (block.empty())
+			return false;
+		prefetch();
+		return true;
+	}
+
+private:
+	gzFile m_file = nullptr;
+	std::string m_failure; //!< Message of the exception thrown if the file cannot be inflated.
+	std::future<std::vector<char>> m_next; //!< The block being read ahead.
+
+	void prefetch() {
+		gzFile file = m_file;
+		const std::string failure = m_failure;
+		m_next = std::async(std::launch::async, [file, failure]() -> std::vector<char> {
+			std::vector<char> block(blockSize);
+			int n = gzread(file, block.data(), (unsigned int)block.size());
+			if (n < 0)
+				throw std::runtime_error(failure);
+			block.resize(n);
+			return block;
+		});
+	}
+};
+
+/**
+ * @brief Position just after the header of a data text file.
+ */
+std::size_t headerLength(const std::string& text, const std::string& filename) {
+	std::size_t pos = 0;
+	for (int i = 0; i < TEXT_HEADER_LINES; ++i) {
+		pos = text.find('\n', pos);
+		if (pos == std::string::npos)
+			throw std::runtime_error("DataReader::readGrid: " + filename + " has a truncated header.");
+		++pos;
+	}
+	return pos;
+}
+
+/**
+ * @brief Reads this processor's block of the rows of a data text file, following every row with a null character.
+ *
+ * Each processor reads its own share of a plain text file. A gzipped file is inflated once, by the root processor with a
+ * ReadAhead, which sends each processor its share.
+ */
+std::vector<char> readRows(const std::string& filename) {
+	MPIW& mpihandler = MPIW::Instance();
+	TextHead head = readHead(filename, "DataReader::readGrid");
+	std::size_t start = headerLength(head.text, filename);
+	std::vector<char> rows;
+	if (!head.isCompressed)
+		rows = mpihandler.readLines(filename, (long long)start);
+	else {
+		std::vector<char> text;
+		if (mpihandler.getRank() == 0) {
+			ReadAhead reader(filename, "DataReader::readGrid");
+			for (std::vector<char> block; reader.next(block);)
+				text.insert(text.end(), block.begin(), block.end());
+			text.erase(text.begin(), text.begin() + std::min(start, text.size()));
+		}
+		rows = mpihandler.scatterLines(text, 0);
+	}
+	rows.push_back('\0');
+	return rows;
+}
+
+/**
+ * @brief Parses the next number on a line of a data text file.
+ *
+ * A number with at most 19 significant digits is built from its digits when both they and the power of ten are exact
+ * doubles (Clinger's fast path), making the result correctly rounded. Anything else is left to strtod, so the
+ * results are the same as reading the text with operator>>.
+ * @param p Position in the text, moved past the number. The text must end with a null character.
+ * @param end End of the line.
+ * @param value The number.
+ * @return Whether there was a number before the end of the line.
+ */
+bool parseNumber(const char*& p, const char* end, double& value) {
+	static const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+		1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		++p;
+	if (p == end)
+		return false;
+
+	const char* start = p;
+	const char* q = p;
+	bool negative = (*q == '-');
+	if (*q == '-' || *q == '+')
+		++q;
+	std::uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool hasDigits = false, isExact = true;
+	for (; q < end && *q >= '0' && *q <= '9'; ++q) {
+		hasDigits = true;
+		mantissa = 10*mantissa + (*q - '0');
+		digits += (mantissa != 0);
+	}
+	if (q < end && *q == '.') {
+		for (++q; q < end && *q >= '0' && *q <= '9'; ++q) {
+			hasDigits = true;
+			mantissa = 10*mantissa + (*q - '0');
+			digits += (mantissa != 0);
+			--exponent;
+		}
+	}
+	if (hasDigits && q < end && (*q == 'e' || *q == 'E')) {
+		const char* e = q + 1;
+		bool negativeExp = (*e == '-');
+		if (*e == '-' || *e == '+')
+			++e;
+		int exp10 = 0;
+		if (e < end && *e >= '0' && *e <= '9') {
+			for (; e < end && *e >= '0' && *e <= '9'; ++e)
+				exp10 = std::min(10*exp10 + (*e - '0'), 100000);
+			exponent += negativeExp ? -exp10 : exp10;
+			q = e;
+		}
+	}
+	isExact = hasDigits && digits <= 19 && mantissa <= (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22 &&
+			(q == end || *q == ' ' || *q == '\t' || *q == '\r' || *q == '\n');
+	if (isExact) {
+		double x = (double)mantissa;
+		x = (exponent < 0) ? x/powersOfTen[-exponent] : x*powersOfTen[exponent];
+		value = negative ? -x : x;
+		p = q;
+		return true;
+	}
+
+	char* stop = nullptr;
+	value = std::strtod(start, &stop);
+	if (stop == start)
+		return false;
+	p = stop;
+	return true;
+}
+
+}
+
 DataParameters DataReader::readDataParameters(const std::string& filename) {
+	if (SnapshotHeader::isSnapshot(filename))
+		return readSnapshotParameters(filename);
 	DataParameters dp;
 	MPIW& mpihandler = MPIW::Instance();
 
 	mpihandler.serial([&] () {
 		if (filename.compare("") != 0) {
-			std::ifstream myfile(filename, std::ios_base::in);
-			if (!myfile)
-				throw std::runtime_error("DataReader::readDataParameters: invalid input file " + filename + ".");
+			std::istringstream myfile(readHead(filename, "DataReader::readDataParameters").text);
 			myfile >> dp.time >> dp.ncells[0] >> dp.ncells[1] >> dp.ncells[2];
 
 			if (dp.ncells[1] == 1)
@@ -59,75 +269,176 @@ DataParameters DataReader::readDataParameters(const std::string& filename) {
 			dp.dx = *(std::min_element(std::begin(dx), std::end(dx)));
 
 			dp.sideLength = dp.dx*dp.ncells[0];
-
-			myfile.close();
 		}
 	});
 
 	return dp;
 }
 
+/**
+ * @brief Reads the initial conditions of this processor's part of the Grid from a data text file, which may be gzipped.
+ *
+ * Each processor parses a contiguous block of the file's rows and sends every row to the processor simulating its
+ * cell, so the work of reading the file is shared out rather than repeated by every processor.
+ * @param filename Name of the file.
+ * @param dp The file's DataParameters.
+ * @param fluid The Fluid.
+ */
 void DataReader::readGrid(const std::string& filename, const DataParameters& dp, Fluid& fluid) {
+	if (SnapshotHeader::isSnapshot(filename)) {
+		readSnapshot(filename, dp, fluid);
+		return;
+	}
+	if (filename.compare("") == 0)
+		return;
 	MPIW& mpihandler = MPIW::Instance();
 	Grid& grid = fluid.getGrid();
 
-	mpihandler.serial([&] () {
-		if (filename.compare("") != 0) {
-			std::ifstream myfile(filename, std::ios_base::in);
-			if (!myfile)
-				throw std::runtime_error("DataReader::readGrid: invalid input file " + filename + ".");
-
-			int nc = fluid.getGrid().ncells[0]*fluid.getGrid().ncells[1]*fluid.getGrid().ncells[2];
-
-			std::string ignore;
-			myfile >> ignore >> ignore >> ignore >> ignore;
-
-			for (int i = 0; i < nc; ++i) {
-				std::array<int, 3> xc;
-				for (int idim = 0; idim < dp.nd; ++idim) {
-					double x;
-					myfile >> x;
-					xc[idim] = (x/dp.dx);
-				}
-				for (int idim = dp.nd; idim < 3; ++idim)
-					xc[idim] = 0;
-
-				double density, pressure, hii;
-				myfile >> density;
-				myfile >> pressure;
-				myfile >> hii;
-
-				std::array<double, 3> velocity;
-				for (int idim = 0; idim < dp.nd; ++idim)
-					myfile >> velocity[idim];
-
-
-
-				if (xc[0] < fluid.getGrid().getLeftX() || xc[0] > fluid.getGrid().getRightX())
-					continue;
+	const std::vector<char> text = readRows(filename);
+	const CellOwners owners(grid);
+	const int nvars = 2*dp.nd + 3;
+	const int stride = 3 + nvars - dp.nd; // Grid coordinates followed by the density, pressure, HII fraction and velocities.
+
+	std::vector<std::vector<double>> outgoing(mpihandler.nProcessors());
+	std::vector<double> row(nvars);
+	const char* p = text.data();
+	const char* textEnd = text.data() + text.size() - 1;
+	while (p < textEnd) {
+		const char* lineEnd = std::find(p, textEnd, '\n');
+		int n = 0;
+		while (n < nvars && parseNumber(p, lineEnd, row[n]))
+			++n;
+		if (n != nvars && !(n == 0 && p == lineEnd))
+			throw std::runtime_error("DataReader::readGrid: " + filename + " has a malformed row.");
+		if (n == nvars) {
+			std::array<int, 3> xc = std::array<int, 3>{{ 0, 0, 0 }};
+			for (int idim = 0; idim < dp.nd; ++idim)
+				xc[idim] = (row[idim]/dp.dx);
 
-				int cellID = grid.locate((int)xc[0], (int)xc[1], (int)xc[2]);
-				if (cellID != -1) {
-					GridCell& cell = grid.getCell(cellID);
+			int owner = owners.find(xc);
+			if (owner != -1) {
+				std::vector<double>& block = outgoing[owner];
+				block.insert(block.end(), xc.begin(), xc.end());
+				block.insert(block.end(), row.begin() + dp.nd, row.end());
+			}
+		}
+		p = std::min(lineEnd + 1, textEnd);
+	}
+
+	const std::vector<double> received = mpihandler.exchange(outgoing);
+	for (std::size_t i = 0; i + stride <= received.size(); i += stride) {
+		const double* cellRow = &received[i];
+		int cellID = grid.locate((int)cellRow[0], (int)cellRow[1], (int)cellRow[2]);
+		if (cellID == -1)
+			throw std::runtime_error("DataReader::readGrid: received a row for a cell of another processor.");
+		GridCell& cell = grid.getCell(cellID);
+
+		cell.Q[UID::DEN] = cellRow[3];
+		cell.Q[UID::PRE] = cellRow[4];
+		cell.Q[UID::HII] = cellRow[5];
+
+		for (int idim = 0; idim < dp.nd; ++idim)
+			cell.Q[UID::VEL+idim] = cellRow[6 + idim];
+		cell.heatCapacityRatio = fluid.heatCapacityRatio;
+	}
+}
 
-					cell.Q[UID::DEN] = density;
-					cell.Q[UID::PRE] = pressure;
-					cell.Q[UID::HII] = hii;
+/**
+ * @brief Reads the grid geometry and time from the header of a binary snapshot.
+ * @param filename Name of the snapshot.
+ * @see SnapshotHeader
+ */
+DataParameters DataReader::readSnapshotParameters(const std::string& filename) {
+	SnapshotReader reader(filename);
+	const SnapshotHeader& header = reader.header();
+	DataParameters dp;
+	dp.time = header.time;
+	dp.ncells = header.ncells;
+	dp.nd = header.nd;
+	dp.dx = *std::min_element(header.dx.begin(), header.dx.begin() + header.nd);
+	dp.sideLength = dp.dx*dp.ncells[0];
+	return dp;
+}
 
-					for (int idim = 0; idim < dp.nd; ++idim)
-						cell.Q[UID::VEL+idim] = velocity[idim];
-					cell.heatCapacityRatio = fluid.heatCapacityRatio;
-				}
-			}
-			myfile.close();
+/**
+ * @brief Reads the cells of this processor's part of the Grid from a binary snapshot. Each processor maps the file into
+ * memory and copies out the rows of its own cells, which it finds from their grid coordinates.
+ * @param filename Name of the snapshot.
+ * @param dp The snapshot's DataParameters.
+ * @param fluid The Fluid.
+ * @see SnapshotHeader
+ */
+void DataReader::readSnapshot(const std::string& filename, const DataParameters& dp, Fluid& fluid) {
+	Grid& grid = fluid.getGrid();
+	SnapshotReader reader(filename);
+	const SnapshotHeader& header = reader.header();
+	if (header.nd != dp.nd)
+		throw std::runtime_error("DataReader::readSnapshot: " + filename + " does not match the grid dimensions.");
+
+	const char* axes[3] = {"x", "y", "z"};
+	const bool hasCoordinates = !reader.isGridOrder();
+	std::array<int, 3> posCol, velCol;
+	for (int idim = 0; idim < dp.nd; ++idim) {
+		posCol[idim] = hasCoordinates ? header.column(axes[idim]) : 0;
+		velCol[idim] = header.column(std::string("vel_") + axes[idim]);
+	}
+	const int denCol = header.column("den");
+	const int preCol = header.column("pre");
+	const int hiiCol = header.column("hii");
+	if (denCol < 0 || preCol < 0 || hiiCol < 0 ||
+			std::any_of(posCol.begin(), posCol.begin() + dp.nd, [](int c) { return c < 0; }) ||
+			std::any_of(velCol.begin(), velCol.begin() + dp.nd, [](int c) { return c < 0; }))
+		throw std::runtime_error("DataReader::readSnapshot: " + filename + " is missing a variable.");
+
+	auto readCell = [&](GridCell& cell, const char* row) {
+		cell.Q[UID::DEN] = header.value(row, denCol);
+		cell.Q[UID::PRE] = header.value(row, preCol);
+		cell.Q[UID::HII] = header.value(row, hiiCol);
+		for (int idim = 0; idim < dp.nd; ++idim)
+			cell.Q[UID::VEL+idim] = header.value(row, velCol[idim]);
+		cell.heatCapacityRatio = fluid.heatCapacityRatio;
+	};
+
+	if (!hasCoordinates) {
+		// The rows are in x-fastest order of the grid coordinates, so each cell finds its own.
+		for (GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+			std::array<int, 3> xc;
+			for (int idim = 0; idim < 3; ++idim)
+				xc[idim] = (int)std::floor(cell.xc[idim]);
+			readCell(cell, reader.row(xc));
 		}
-	});
+		return;
+	}
+	for (long long i = 0; i < header.nrows; ++i) {
+		const char* row = reader.row(i);
+		std::array<int, 3> xc = std::array<int, 3>{{ 0, 0, 0 }};
+		for (int idim = 0; idim < dp.nd; ++idim)
+			xc[idim] = (header.value(row, posCol[idim])/dp.dx);
+
+		int cellID = grid.locate(xc[0], xc[1], xc[2]);
+		if (cellID != -1)
+			readCell(grid.getCell(cellID), row);
+	}
 }
 
-void DataReader::patchGrid(const std::string& filename, const std::array<int, 3>& offset, Fluid& fluid ) {
+/**
+ * @brief Replaces the cells of the Grid covered by a patch with the means of the patch cells inside them.
+ *
+ * The patch may be a data text file (gzipped or not), whose cell widths and coordinates are in code units, or a binary
+ * snapshot, whose cells are found directly (see patchSnapshot). The patch's cell width must divide the Grid's.
+ * @param filename Name of the patch.
+ * @param offset Grid coordinates of the Grid cell holding the patch's first cell.
+ * @param converter Converter of the code units, for the cell widths of a snapshot.
+ * @param fluid The Fluid, whose primitive variables are still in cgs units.
+ */
+void DataReader::patchGrid(const std::string& filename, const std::array<int, 3>& offset, const Converter& converter, Fluid& fluid) {
 	MPIW& mpihandler = MPIW::Instance();
 	Grid& grid = fluid.getGrid();
 
+	if (SnapshotHeader::isSnapshot(filename)) {
+		patchSnapshot(filename, offset, converter, fluid);
+		return;
+	}
 	DataParameters dp = readDataParameters(filename);
 
 	mpihandler.serial([&] () {
@@ -147,88 +458,349 @@ void DataReader::patchGrid(const std::string& filename, const std::array<int, 3>
 					throw std::runtime_error("DataReader::patchGrid: number of cells covered by patch not an integer.");
 			}
 
-			int r = std::pow((int)(ratio + 0.5), dp.nd);
-
-			std::ifstream myfile(filename, std::ios_base::in);
-			if (!myfile)
-				throw std::runtime_error("DataReader::patchGrid: invalid input file " + filename + ".");
-
-			std::string ignore;
-
-			myfile >> ignore >> ignore >> ignore >> ignore;
-
-			int npatchcells = dp.ncells[0]*dp.ncells[1]*dp.ncells[2];
-
-			for (int i = 0; i < npatchcells; ++i) {
-				std::array<int, 3> xc;
-				for (int idim = 0; idim < dp.nd; ++idim) {
-					double x;
-					myfile >> x;
-					xc[idim] = (x/fluid.getGrid().dx[0]) + offset[idim];
+			const double r = std::pow((int)(ratio + 0.5), dp.nd);
+			const int nvars = 2*dp.nd + 3;
+			std::vector<double> row(nvars);
+			std::unordered_set<int> patched; // Cells already zeroed for the sum of the patch cells inside them.
+			int skipped = 0;
+
+			// Adds each whole row of the text to the cell of the Grid it falls in.
+			auto parseRows = [&] (const char* p, const char* textEnd) {
+				while (p < textEnd) {
+					const char* lineEnd = std::find(p, textEnd, '\n');
+					if (skipped < TEXT_HEADER_LINES) {
+						++skipped;
+						p = std::min(lineEnd + 1, textEnd);
+						continue;
+					}
+					int n = 0;
+					while (n < nvars && parseNumber(p, lineEnd, row[n]))
+						++n;
+					if (n != nvars && !(n == 0 && p == lineEnd))
+						throw std::runtime_error("DataReader::patchGrid: " + filename + " has a malformed row.");
+					if (n == nvars) {
+						std::array<int, 3> xc = std::array<int, 3>{{ 0, 0, 0 }};
+						for (int idim = 0; idim < dp.nd; ++idim)
+							xc[idim] = (row[idim]/fluid.getGrid().dx[0]) + offset[idim];
+						int cellID = grid.locate((int)xc[0], (int)xc[1], (int)xc[2]);
+						if (cellID != -1) {
+							GridCell& cell = grid.getCell(cellID);
+							if (patched.insert(cellID).second) {
+								cell.Q[UID::DEN] = 0;
+								cell.Q[UID::PRE] = 0;
+								cell.Q[UID::HII] = 0;
+								for (int idim = 0; idim < dp.nd; ++idim)
+									cell.Q[UID::VEL+idim] = 0;
+							}
+							cell.Q[UID::DEN] += row[dp.nd]/r;
+							cell.Q[UID::PRE] += row[dp.nd + 1]/r;
+							cell.Q[UID::HII] += row[dp.nd + 2]/r;
+							for (int idim = 0; idim < dp.nd; ++idim)
+								cell.Q[UID::VEL+idim] += row[dp.nd + 3 + idim]/r;
+						}
+					}
+					p = std::min(lineEnd + 1, textEnd);
 				}
-				for (int idim = dp.nd; idim < 3; ++idim) {
-					xc[idim] = 0;
-				}
-				myfile >> ignore >> ignore >> ignore;
-				for (int idim = 0; idim < dp.nd; ++idim)
-					myfile >> ignore;
-
-				if (xc[0] < fluid.getGrid().getLeftX() || xc[0] > fluid.getGrid().getRightX())
-					continue;
+			};
+
+			// The rows of each block are parsed while the next is inflated, holding back the last unfinished line.
+			ReadAhead reader(filename, "DataReader::patchGrid");
+			std::vector<char> text;
+			for (std::vector<char> block; reader.next(block);) {
+				text.insert(text.end(), block.begin(), block.end());
+				std::vector<char>::iterator last = std::find(text.rbegin(), text.rend(), '\n').base();
+				parseRows(text.data(), text.data() + (last - text.begin()));
+				text.erase(text.begin(), last);
+			}
+			text.push_back('\0');
+			parseRows(text.data(), text.data() + text.size() - 1);
+		}
+	});
+}
 
-				int cellID = grid.locate((int)xc[0], (int)xc[1], (int)xc[2]);
-				if (cellID != -1) {
-					GridCell& cell = grid.getCell(cellID);
-					cell.Q[UID::DEN] = 0;
-					cell.Q[UID::PRE] = 0;
-					cell.Q[UID::HII] = 0;
-					for (int idim = 0; idim < dp.nd; ++idim)
-						cell.Q[UID::VEL+idim] = 0;
+/**
+ * @brief Patches the Grid from a binary snapshot. Each processor maps the file into memory and copies out only the rows
+ * of the patch cells inside its own cells, which it finds from their grid coordinates, so no processor reads the rest
+ * of the file.
+ * @see DataReader::patchGrid
+ */
+void DataReader::patchSnapshot(const std::string& filename, const std::array<int, 3>& offset, const Converter& converter, Fluid& fluid) {
+	Grid& grid = fluid.getGrid();
+	SnapshotReader reader(filename);
+	const SnapshotHeader& header = reader.header();
+	const int nd = (grid.ncells[1] == 1) ? 1 : (grid.ncells[2] == 1) ? 2 : 3;
+	if (header.nd != nd)
+		throw std::runtime_error("DataReader::patchGrid: patch ndims != grid ndims.");
+	if (!reader.isGridOrder())
+		throw std::runtime_error("DataReader::patchGrid: " + filename + " is a version 1 snapshot, whose rows are not in grid order.");
+
+	// How many patch cells fit along each side of a grid cell?
+	const double ratio = converter.fromCodeUnits(grid.dx[0], 0, 1, 0)/header.dx[0];
+	const int n = (int)std::lround(ratio);
+	if (n < 1 || std::abs(ratio - n) > 1.0e-9*ratio)
+		throw std::runtime_error("DataReader::patchGrid: ratio of cell sizes not an integer.");
+	std::array<int, 3> covered = std::array<int, 3>{{ 1, 1, 1 }};
+	for (int idim = 0; idim < nd; ++idim) {
+		if (header.ncells[idim] % n != 0)
+			throw std::runtime_error("DataReader::patchGrid: number of cells covered by patch not an integer.");
+		covered[idim] = header.ncells[idim]/n;
+	}
+
+	const char* axes[3] = {"x", "y", "z"};
+	std::array<int, 3> velCol = std::array<int, 3>{{ 0, 0, 0 }};
+	for (int idim = 0; idim < nd; ++idim)
+		velCol[idim] = header.column(std::string("vel_") + axes[idim]);
+	const int denCol = header.column("den");
+	const int preCol = header.column("pre");
+	const int hiiCol = header.column("hii");
+	if (denCol < 0 || preCol < 0 || hiiCol < 0 || std::any_of(velCol.begin(), velCol.begin() + nd, [](int c) { return c < 0; }))
+		throw std::runtime_error("DataReader::patchGrid: " + filename + " is missing a variable.");
+
+	const double r = std::pow(n, nd);
+	const std::array<int, 3> fine = std::array<int, 3>{{ n, nd > 1 ? n : 1, nd > 2 ? n : 1 }};
+	for (GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		std::array<int, 3> xc = std::array<int, 3>{{ 0, 0, 0 }};
+		bool inside = true;
+		for (int idim = 0; idim < nd; ++idim) {
+			xc[idim] = (int)std::floor(cell.xc[idim]) - offset[idim];
+			inside = inside && xc[idim] >= 0 && xc[idim] < covered[idim];
+		}
+		if (!inside)
+			continue;
+
+		cell.Q[UID::DEN] = 0;
+		cell.Q[UID::PRE] = 0;
+		cell.Q[UID::HII] = 0;
+		for (int idim = 0; idim < nd; ++idim)
+			cell.Q[UID::VEL+idim] = 0;
+		for (int k = xc[2]*fine[2]; k < (xc[2] + 1)*fine[2]; ++k) {
+			for (int j = xc[1]*fine[1]; j < (xc[1] + 1)*fine[1]; ++j) {
+				for (int i = xc[0]*fine[0]; i < (xc[0] + 1)*fine[0]; ++i) {
+					const char* row = reader.row(std::array<int, 3>{{ i, j, k }});
+					cell.Q[UID::DEN] += header.value(row, denCol)/r;
+					cell.Q[UID::PRE] += header.value(row, preCol)/r;
+					cell.Q[UID::HII] += header.value(row, hiiCol)/r;
+					for (int idim = 0; idim < nd; ++idim)
+						cell.Q[UID::VEL+idim] += header.value(row, velCol[idim])/r;
 				}
 			}
+		}
+	}
+}
 
-			myfile.close();
-			myfile.open(filename, std::ios_base::in);
+/**
+ * @brief Reads the header of a restart file.
+ * @param filename Name of the restart file.
+ * @see RestartHeader
+ */
+RestartHeader DataReader::readRestartHeader(const std::string& filename) {
+	MappedFile file(filename);
+	return RestartHeader::deserialise(file.data(), file.size(), filename);
+}
 
-			myfile >> ignore >> ignore >> ignore >> ignore;
+/**
+ * @brief Restores the exact state of this processor's GridCells from a restart file. Each processor maps the file
+ * into memory and copies out the records of its own cells, found from their grid coordinates (or by searching a
+ * version 1 file, or by decompressing the parts of a version 3 file that overlap its cells), so no communication is needed and the file may have been written by any number of processors.
+ * @param filename Name of the restart file.
+ * @param fluid The Fluid, whose Grid must have the dimensions in the file's header.
+ * @see RestartHeader
+ */
+void DataReader::readRestart(const std::string& filename, Fluid& fluid) {
+	Grid& grid = fluid.getGrid();
+	MappedFile file(filename);
+	const RestartHeader header = RestartHeader::deserialise(file.data(), file.size(), filename);
+	if (header.ncells != grid.ncells)
+		throw std::runtime_error("DataReader::readRestart: " + filename + " does not match the grid dimensions.");
+
+	if (header.fileVersion == RestartHeader::compressedVersion) {
+		int nread = 0;
+		RestartCodec::decode(file.data(), file.size(), grid.coreOffset, grid.coreCells, filename, [&](const double* record) {
+			const std::array<int, 3> xc = RestartHeader::coordinates(record);
+			const int cellID = grid.locate(xc[0], xc[1], xc[2]);
+			if (cellID == -1)
+				throw std::runtime_error("DataReader::readRestart: " + filename + " has a record out of place.");
+			RestartHeader::unpack(record, grid, grid.getCell(cellID));
+			++nread;
+		});
+		if (nread != grid.coreCells[0]*grid.coreCells[1]*grid.coreCells[2])
+			throw std::runtime_error("DataReader::readRestart: " + filename + " does not hold every GridCell.");
+		return;
+	}
+	std::vector<double> record(RestartHeader::recordSize);
+	const std::size_t recordBytes = RestartHeader::recordSize*sizeof(double);
+	if (header.fileVersion > 1) {
+		// The records are in x-fastest order of the grid coordinates, so each cell finds its own.
+		for (GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+			std::array<int, 3> xc;
+			long long irecord = 0;
+			for (int idim = 2; idim >= 0; --idim) {
+				xc[idim] = (int)cell.xc[idim];
+				irecord = irecord*header.ncells[idim] + xc[idim];
+			}
+			std::memcpy(record.data(), file.data() + RestartHeader::size + irecord*recordBytes, recordBytes);
+			if (RestartHeader::coordinates(record.data()) != xc)
+				throw std::runtime_error("DataReader::readRestart: " + filename + " has a record out of order.");
+			RestartHeader::unpack(record.data(), grid, cell);
+		}
+		return;
+	}
+	int nread = 0;
+	for (long long i = 0; i < header.nrecords; ++i) {
+		std::memcpy(record.data(), file.data() + RestartHeader::size + i*recordBytes, recordBytes);
+		const std::array<int, 3> xc = RestartHeader::coordinates(record.data());
+		int cellID = grid.locate(xc[0], xc[1], xc[2]);
+		if (cellID != -1) {
+			RestartHeader::unpack(record.data(), grid, grid.getCell(cellID));
+			++nread;
+		}
+	}
+	if (nread != grid.coreCells[0]*grid.coreCells[1]*grid.coreCells[2])
+		throw std::runtime_error("DataReader::readRestart: " + filename + " does not hold every GridCell.");
+}
 
-			for (int i = 0; i < npatchcells; ++i) {
-				std::array<int, 3> xc;
-				for (int idim = 0; idim < dp.nd; ++idim) {
-					double x;
-					myfile >> x;
-					xc[idim] = (x/fluid.getGrid().dx[0]) + offset[idim];
-				}
-				for (int idim = dp.nd; idim < 3; ++idim) {
-					xc[idim] = 0;
+/**
+ * @brief Sets this processor's GridCells from a restart file of a grid factor times coarser along each dimension, so a
+ * run may start coarse and carry on at a finer resolution.
+ *
+ * Every field of a record but the heat capacity ratio and minimum temperature is interpolated linearly within its
+ * coarse cell, with the slope along each dimension limited by minmod of the differences to the neighbouring coarse
+ * cells (none at the edges of the grid), so no new extrema appear. The offsets of the fine cells from the centre of
+ * their coarse cell are weighted by their volumes to sum to zero, which makes the interpolation of the conserved
+ * variables conservative in every geometry. The optical depths and column densities across a cell are divided by
+ * factor; the rest are taken as they are, and the primitive variables are found again from the conserved ones at the
+ * first step. Each processor reads the coarse cells that cover its own and their neighbours, so no communication is
+ * needed.
+ * @param filename Name of the restart file.
+ * @param factor Number of fine cells along each side of a coarse cell.
+ * @param fluid The Fluid, whose Grid must have factor times the cells in the file's header along each dimension.
+ * @exception std::runtime_error Thrown if the file does not match the Grid or lacks a record.
+ * @see DataReader::readRestart
+ */
+void DataReader::prolongRestart(const std::string& filename, int factor, Fluid& fluid) {
+	Grid& grid = fluid.getGrid();
+	MappedFile file(filename);
+	const RestartHeader header = RestartHeader::deserialise(file.data(), file.size(), filename);
+	const int nd = header.nd;
+	for (int idim = 0; idim < 3; ++idim) {
+		if (header.ncells[idim]*(idim < nd ? factor : 1) != grid.ncells[idim])
+			throw std::runtime_error("DataReader::prolongRestart: the grid is not " + std::to_string(factor) + " times as fine as " + filename + ".");
+	}
+
+	// The coarse cells covering this processor's block, and one more either side for the slopes.
+	const int recordSize = RestartHeader::recordSize;
+	std::array<int, 3> lo = {{ 0, 0, 0 }}, nbox = {{ 1, 1, 1 }};
+	for (int idim = 0; idim < nd; ++idim) {
+		lo[idim] = std::max(0, grid.coreOffset[idim]/factor - 1);
+		const int hi = std::min(header.ncells[idim], (grid.coreOffset[idim] + grid.coreCells[idim] - 1)/factor + 2);
+		nbox[idim] = hi - lo[idim];
+	}
+	const long long ncoarse = (long long)nbox[0]*nbox[1]*nbox[2];
+	std::vector<double> coarse(ncoarse*recordSize);
+	std::vector<char> isRead(ncoarse, 0);
+	auto boxIndex = [&](const std::array<int, 3>& xc) -> long long {
+		long long index = 0;
+		for (int idim = 2; idim >= 0; --idim) {
+			if (xc[idim] < lo[idim] || xc[idim] >= lo[idim] + nbox[idim])
+				return -1;
+			index = index*nbox[idim] + xc[idim] - lo[idim];
+		}
+		return index;
+	};
+	auto store = [&](const double* values) {
+		const long long index = boxIndex(RestartHeader::coordinates(values));
+		if (index >= 0) {
+			std::copy(values, values + recordSize, &coarse[index*recordSize]);
+			isRead[index] = 1;
+		}
+	};
+	const std::size_t recordBytes = recordSize*sizeof(double);
+	std::vector<double> record(recordSize);
+	if (header.fileVersion == RestartHeader::compressedVersion)
+		RestartCodec::decode(file.data(), file.size(), lo, nbox, filename, store);
+	else if (header.fileVersion > 1) {
+		for (int z = lo[2]; z < lo[2] + nbox[2]; ++z) {
+			for (int y = lo[1]; y < lo[1] + nbox[1]; ++y) {
+				for (int x = lo[0]; x < lo[0] + nbox[0]; ++x) {
+					const long long irecord = ((long long)z*header.ncells[1] + y)*header.ncells[0] + x;
+					std::memcpy(record.data(), file.data() + RestartHeader::size + irecord*recordBytes, recordBytes);
+					store(record.data());
 				}
+			}
+		}
+	}
+	else {
+		for (long long i = 0; i < header.nrecords; ++i) {
+			std::memcpy(record.data(), file.data() + RestartHeader::size + i*recordBytes, recordBytes);
+			store(record.data());
+		}
+	}
+	if (std::find(isRead.begin(), isRead.end(), 0) != isRead.end())
+		throw std::runtime_error("DataReader::prolongRestart: " + filename + " does not hold every GridCell.");
+
+	// Relative volume of the fine cells at a radius rc (in fine cell widths), which only varies along the first dimension.
+	const Geometry geometry = grid.geometry;
+	auto volume = [&](double rc) {
+		if (geometry == Geometry::CYLINDRICAL)
+			return rc;
+		else if (geometry == Geometry::SPHERICAL)
+			return 3.0*rc*rc + 0.25;
+		return 1.0;
+	};
+	auto offset = [&](int j) {
+		return (j + 0.5)/factor - 0.5;
+	};
+
+	// Q, U, R, T and the gravity are interpolated.
+	const int first = 3, last = 3 + 2*UID::N + RID::N + TID::N + TORCH_MAX_DIMENSIONS;
+	std::vector<int> perCell;
+	if (RADIATION_BUILT)
+		perCell = {3 + 2*UID::N + RID::DTAU, 3 + 2*UID::N + RID::DTAU_A};
+	if (THERMO_BUILT)
+		perCell.push_back(3 + 2*UID::N + RID::N + TID::DCOL_DEN);
+	for (GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		std::array<int, 3> parent, xc;
+		std::array<double, 3> delta = {{ 0, 0, 0 }};
+		for (int idim = 0; idim < 3; ++idim) {
+			xc[idim] = (int)cell.xc[idim];
+			parent[idim] = idim < nd ? xc[idim]/factor : xc[idim];
+			if (idim < nd)
+				delta[idim] = offset(xc[idim]%factor);
+		}
+		if (geometry != Geometry::CARTESIAN) {
+			double weighted = 0, total = 0;
+			for (int j = 0; j < factor; ++j) {
+				const double v = volume(parent[0]*factor + j + 0.5);
+				weighted += v*offset(j);
+				total += v;
+			}
+			delta[0] -= weighted/total;
+		}
 
-				double density, pressure, hii;
-				myfile >> density;
-				myfile >> pressure;
-				myfile >> hii;
-
-				std::array<double, 3> velocity;
-				for (int idim = 0; idim < dp.nd; ++idim)
-					myfile >> velocity[idim];
+		const double* centre = &coarse[boxIndex(parent)*recordSize];
+		std::array<const double*, 3> left = {{ nullptr, nullptr, nullptr }}, right = {{ nullptr, nullptr, nullptr }};
+		for (int idim = 0; idim < nd; ++idim) {
+			std::array<int, 3> neighbour = parent;
+			neighbour[idim] = parent[idim] - 1;
+			const long long l = boxIndex(neighbour);
+			neighbour[idim] = parent[idim] + 1;
+			const long long r = boxIndex(neighbour);
+			left[idim] = (parent[idim] > 0 && l >= 0) ? &coarse[l*recordSize] : nullptr;
+			right[idim] = (parent[idim] < header.ncells[idim] - 1 && r >= 0) ? &coarse[r*recordSize] : nullptr;
+		}
 
-				if (xc[0] < fluid.getGrid().getLeftX() || xc[0] > fluid.getGrid().getRightX())
+		std::copy(centre, centre + recordSize, record.begin());
+		for (int k = first; k < last; ++k) {
+			for (int idim = 0; idim < nd; ++idim) {
+				if (left[idim] == nullptr || right[idim] == nullptr)
 					continue;
-
-				int cellID = grid.locate((int)xc[0], (int)xc[1], (int)xc[2]);
-				if (cellID != -1) {
-					GridCell& cell = grid.getCell(cellID);
-					cell.Q[UID::DEN] += density/r;
-					cell.Q[UID::PRE] += pressure/r;
-					cell.Q[UID::HII] += hii/r;
-
-					for (int idim = 0; idim < dp.nd; ++idim)
-						cell.Q[UID::VEL+idim] += velocity[idim]/r;
-				}
+				const double dl = centre[k] - left[idim][k], dr = right[idim][k] - centre[k];
+				const double slope = (dl*dr <= 0) ? 0 : (std::abs(dl) < std::abs(dr) ? dl : dr);
+				record[k] += slope*delta[idim];
 			}
-			myfile.close();
 		}
-	});
+		for (int k : perCell)
+			record[k] /= factor;
+		RestartHeader::unpack(record.data(), grid, cell);
+	}
 }
-
-
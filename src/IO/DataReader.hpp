@@ -11,8 +11,10 @@
 #include <string>
 #include <array>
 
+class Converter;
 class Fluid;
 class DataParameters;
+class RestartHeader;
 
 /**
  * @class DataPrinter
@@ -23,10 +25,15 @@ class DataReader {
 public:
 	static DataParameters readDataParameters(const std::string& filename);
 	static void readGrid(const std::string& filename, const DataParameters& dp,  Fluid& fluid);
-	static void patchGrid(const std::string& filename, const std::array<int, 3>& offset, Fluid& fluid );
+	static void patchGrid(const std::string& filename, const std::array<int, 3>& offset, const Converter& converter, Fluid& fluid);
+	static RestartHeader readRestartHeader(const std::string& filename);
+	static void readRestart(const std::string& filename, Fluid& fluid);
+	static void prolongRestart(const std::string& filename, int factor, Fluid& fluid);
 
 private:
-
+	static DataParameters readSnapshotParameters(const std::string& filename);
+	static void readSnapshot(const std::string& filename, const DataParameters& dp, Fluid& fluid);
+	static void patchSnapshot(const std::string& filename, const std::array<int, 3>& offset, const Converter& converter, Fluid& fluid);
 };
 
 
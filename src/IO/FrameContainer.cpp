@@ -0,0 +1,130 @@
+#include "FrameContainer.hpp"
+
+#include "MPI/MPI_Wrapper.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const char MAGIC[8] = {'T', 'O', 'R', 'C', 'H', 'P', 'A', 'K'};
+const char FRAME_MAGIC[8] = {'T', 'O', 'R', 'C', 'H', 'F', 'R', 'M'};
+const char INDEX_MAGIC[8] = {'T', 'O', 'R', 'C', 'H', 'I', 'D', 'X'};
+const std::int32_t VERSION = 1;
+const int HEADER_SIZE = 16; //!< Magic, version and padding at the start of the file.
+const int NAME_SIZE = 32; //!< Bytes of a frame's name, padded with zeros.
+const int RECORD_SIZE = 8 + NAME_SIZE + 8 + 8; //!< Record header in front of each frame.
+const int ENTRY_SIZE = NAME_SIZE + 8 + 8 + 8; //!< Entry of the index.
+const int FOOTER_SIZE = 8 + 8 + 8; //!< Offset of the index, number of frames and magic.
+
+template <class T>
+void appendValue(std::vector<char>& bytes, const T& value) {
+	const char* p = reinterpret_cast<const char*>(&value);
+	bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+void appendName(std::vector<char>& bytes, const std::string& name) {
+	std::vector<char> padded(NAME_SIZE, '\0');
+	std::copy(name.begin(), name.end(), padded.begin());
+	bytes.insert(bytes.end(), padded.begin(), padded.end());
+}
+
+}
+
+/**
+ * @brief Names the file, which is started afresh by the first append().
+ * @param filename Name of the file.
+ */
+FrameContainer::FrameContainer(const std::string& filename)
+: m_filename(filename)
+{ }
+
+/**
+ * @brief Gets the name of the file.
+ */
+const std::string& FrameContainer::filename() const {
+	return m_filename;
+}
+
+/**
+ * @brief Gets the number of frames in the file.
+ */
+int FrameContainer::nFrames() const {
+	return (int)m_entries.size();
+}
+
+/**
+ * @brief Appends a frame made of every processor's part in rank order and rewrites the index after it. Collective.
+ * @param name Name of the frame (at most 31 characters), e.g. the suffix the checkpoint's file would have.
+ * @param time Simulation time of the frame (s).
+ * @param part This processor's part of the frame.
+ * @exception std::runtime_error Thrown if the name is too long.
+ */
+void FrameContainer::append(const std::string& name, double time, const std::vector<char>& part) {
+	if ((int)name.size() >= NAME_SIZE)
+		throw std::runtime_error("FrameContainer::append: frame name [" + name + "] is longer than " + std::to_string(NAME_SIZE - 1) + " characters.");
+	if (!m_isOpen)
+		open();
+
+	MPIW& mpihandler = MPIW::Instance();
+	long long size = 0;
+	for (int partSize : mpihandler.allGather(std::vector<int>(1, (int)part.size())))
+		size += partSize;
+
+	std::vector<char> record(FRAME_MAGIC, FRAME_MAGIC + 8);
+	appendName(record, name);
+	appendValue<double>(record, time);
+	appendValue<std::int64_t>(record, size);
+	const long long written = mpihandler.writeOrderedAt(m_filename, m_end, record, part.data(), (int)part.size());
+
+	Entry entry;
+	entry.name = name;
+	entry.time = time;
+	entry.offset = m_end + RECORD_SIZE;
+	entry.size = size;
+	m_entries.push_back(entry);
+	m_end += written;
+	if (mpihandler.getRank() == 0)
+		writeIndex();
+}
+
+/**
+ * @brief Starts the file, on the root processor, with nothing but its header.
+ */
+void FrameContainer::open() {
+	if (MPIW::Instance().getRank() == 0) {
+		std::ofstream file(m_filename, std::ios_base::binary | std::ios_base::trunc);
+		if (!file)
+			throw std::runtime_error("FrameContainer::open: unable to open " + m_filename);
+		std::vector<char> header(MAGIC, MAGIC + 8);
+		appendValue<std::int32_t>(header, VERSION);
+		appendValue<std::int32_t>(header, 0);
+		file.write(header.data(), header.size());
+	}
+	m_end = HEADER_SIZE;
+	m_isOpen = true;
+}
+
+/**
+ * @brief Writes the index and footer after the last frame.
+ */
+void FrameContainer::writeIndex() const {
+	std::vector<char> bytes;
+	bytes.reserve(m_entries.size()*ENTRY_SIZE + FOOTER_SIZE);
+	for (const Entry& entry : m_entries) {
+		appendName(bytes, entry.name);
+		appendValue<double>(bytes, entry.time);
+		appendValue<std::int64_t>(bytes, entry.offset);
+		appendValue<std::int64_t>(bytes, entry.size);
+	}
+	appendValue<std::int64_t>(bytes, m_end);
+	appendValue<std::int64_t>(bytes, (std::int64_t)m_entries.size());
+	bytes.insert(bytes.end(), INDEX_MAGIC, INDEX_MAGIC + 8);
+	std::fstream file(m_filename, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	if (!file)
+		throw std::runtime_error("FrameContainer::writeIndex: unable to open " + m_filename);
+	file.seekp(m_end);
+	file.write(bytes.data(), bytes.size());
+}
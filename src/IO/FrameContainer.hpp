@@ -0,0 +1,55 @@
+/** Provides the FrameContainer class.
+ *
+ * @file FrameContainer.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef FRAMECONTAINER_HPP_
+#define FRAMECONTAINER_HPP_
+
+#include <string>
+#include <vector>
+
+/**
+ * @class FrameContainer
+ *
+ * @brief A single file that the output of every checkpoint is appended to as a frame, with an index of the frames at
+ * its end for random access.
+ *
+ * The file starts with the 8 byte magic TORCHPAK and an int32 version and padding. Each frame is a record header (the
+ * magic TORCHFRM, a 32 byte name, the double time in s and the int64 size of the frame) followed by the frame, which
+ * holds exactly what the file of the checkpoint would (e.g. the gzip members of a data2D file). After the last frame
+ * comes the index, a record of the name, time, int64 offset and size of each frame, then a footer of the int64 offset of
+ * the index, the int64 number of frames and the magic TORCHIDX. The next frame overwrites the index and is followed by a
+ * longer one, so the file is only ever appended to. A reader reads the footer, then the index, then seeks straight to
+ * the frames it wants; if the footer is lost (e.g. the run is killed while appending) the record headers still lead
+ * from one frame to the next.
+ *
+ * All processors must append the same frames in the same order.
+ */
+class FrameContainer {
+public:
+	FrameContainer(const std::string& filename);
+
+	void append(const std::string& name, double time, const std::vector<char>& part);
+	const std::string& filename() const;
+	int nFrames() const;
+
+private:
+	struct Entry {
+		std::string name;
+		double time;
+		long long offset; //!< Offset of the frame itself, after its record header.
+		long long size;
+	};
+	std::string m_filename;
+	bool m_isOpen = false; //!< Whether the file was started, by the first append.
+	std::vector<Entry> m_entries; //!< Index of the frames, the same on every processor.
+	long long m_end = 0; //!< Offset of the end of the last frame.
+
+	void open();
+	void writeIndex() const;
+};
+
+#endif // FRAMECONTAINER_HPP_
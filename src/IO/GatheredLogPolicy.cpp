@@ -0,0 +1,127 @@
+#include "GatheredLogPolicy.hpp"
+
+#include "MPI/MPI_Wrapper.hpp"
+
+#include <cstring>
+
+/**
+ * @param directory Directory of the log files.
+ * @param perNode Whether each node writes a file of its own processors' messages, rather than rank 0 writing one file.
+ * @param capacity Most bytes of messages a processor holds between the calls of Logger::collect.
+ */
+GatheredLogPolicy::GatheredLogPolicy(const std::string& directory, bool perNode, std::size_t capacity)
+: m_directory(directory)
+, m_capacity(capacity)
+{
+	MPIW& mpihandler = MPIW::Instance();
+	m_rank = mpihandler.getRank();
+	m_collector = perNode ? mpihandler.nodeLeader() : 0;
+	if (m_rank == m_collector) {
+		m_senders = (perNode ? mpihandler.nodeSize() : mpihandler.nProcessors()) - 1;
+		const std::string filename = perNode ? directory + "/torch.log.node" + std::to_string(m_rank) : directory + "/torch.log";
+		m_sink.reset(new AsyncLogPolicy(std::unique_ptr<FileLogPolicy>(new FileLogPolicy(filename))));
+	}
+}
+
+GatheredLogPolicy::~GatheredLogPolicy() {
+	close_ostream();
+}
+
+void GatheredLogPolicy::open_ostream() {
+	if (m_sink != nullptr)
+		m_sink->open_ostream();
+}
+
+void GatheredLogPolicy::close_ostream() {
+	if (m_sink != nullptr)
+		m_sink->close_ostream();
+	if (m_fatalLog != nullptr)
+		m_fatalLog->close_ostream();
+}
+
+void GatheredLogPolicy::write(const std::string& msg) {
+	const std::string tagged = "[rank " + std::to_string(m_rank) + "] " + msg;
+	if (m_sink != nullptr) {
+		m_sink->write(tagged);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const std::string fatal = "<FATAL_ERROR>";
+	if (msg.compare(0, fatal.size(), fatal) == 0) {
+		// The run is about to abort, so the messages would never reach the collector.
+		if (m_fatalLog == nullptr) {
+			m_fatalLog.reset(new FileLogPolicy(m_directory + "/torch.log" + std::to_string(m_rank)));
+			m_fatalLog->open_ostream();
+		}
+		for (std::size_t start = 0; start < m_pending.size(); start += std::strlen(&m_pending[start]) + 1)
+			m_fatalLog->write(&m_pending[start]);
+		m_fatalLog->write(tagged);
+		m_pending.clear();
+		return;
+	}
+	if (m_pending.size() + tagged.size() + 1 > m_capacity) {
+		++m_dropped;
+		return;
+	}
+	m_pending.insert(m_pending.end(), tagged.begin(), tagged.end());
+	m_pending.push_back('\0');
+}
+
+void GatheredLogPolicy::flush() {
+	if (m_sink != nullptr)
+		m_sink->flush();
+}
+
+/**
+ * @brief Sends the buffered messages to the collector, or, on the collector, writes those that have arrived. The final
+ * call waits until the collector has written every processor's messages.
+ *
+ * Each batch starts with 'F' if it is a processor's last and 'M' otherwise. A processor's batches arrive in the order
+ * they were sent, so its last one follows all the others.
+ */
+void GatheredLogPolicy::collect(bool isFinal) {
+	MPIW& mpihandler = MPIW::Instance();
+	std::vector<char> batch;
+	if (m_sink == nullptr) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			batch.swap(m_pending);
+			if (m_dropped > 0) {
+				const std::string notice = "[rank " + std::to_string(m_rank) + "] <WARNING>: GatheredLogPolicy: dropped " +
+						std::to_string(m_dropped) + " messages, as too many were logged between steps.\n";
+				batch.insert(batch.end(), notice.begin(), notice.end());
+				batch.push_back('\0');
+				m_dropped = 0;
+			}
+		}
+		if (batch.empty() && !isFinal)
+			return;
+		batch.insert(batch.begin(), isFinal ? 'F' : 'M');
+		mpihandler.postLog(std::move(batch), m_collector);
+		if (isFinal)
+			mpihandler.waitLog();
+		return;
+	}
+
+	int finals = 0;
+	while (mpihandler.receiveLog(batch, isFinal && finals < m_senders)) {
+		if (!batch.empty() && batch[0] == 'F')
+			++finals;
+		writeBatch(batch);
+	}
+	if (isFinal)
+		m_sink->flush();
+}
+
+/**
+ * @brief Writes the messages of a batch from another processor to the log file.
+ */
+void GatheredLogPolicy::writeBatch(const std::vector<char>& batch) {
+	std::size_t start = 1;
+	while (start < batch.size()) {
+		const char* msg = &batch[start];
+		const std::size_t length = strnlen(msg, batch.size() - start);
+		m_sink->write(std::string(msg, length));
+		start += length + 1;
+	}
+}
@@ -0,0 +1,58 @@
+/** Provides the GatheredLogPolicy class.
+ *
+ * @file GatheredLogPolicy.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef GATHEREDLOGPOLICY_HPP_
+#define GATHEREDLOGPOLICY_HPP_
+
+#include "Logger.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @class GatheredLogPolicy
+ *
+ * @brief Writes the logs of many processors to one file, rather than a file per processor, so a large run does not
+ * create thousands of files or load the file system's metadata server whenever every processor warns.
+ *
+ * Every message is tagged with the rank it came from, e.g. "[rank 12] <WARNING>: ...". One processor, the collector,
+ * writes the file: rank 0 for log/torch.log, or with one file per node the node's first processor for
+ * log/torch.log.node<rank>. The others buffer their messages, up to a limit beyond which they are dropped and counted,
+ * and Logger::collect sends each buffer to the collector as a single message without waiting, between steps. The
+ * collector writes what has arrived at the same calls, on a background thread (see AsyncLogPolicy), so a message from
+ * another processor appears in the file up to a step late and its line header records when it was written.
+ *
+ * A fatal error is about to abort the run, so its processor writes the message and everything it still holds to its
+ * own log/torch.log<rank> instead.
+ */
+class GatheredLogPolicy : public LogPolicyInterface {
+public:
+	GatheredLogPolicy(const std::string& directory, bool perNode, std::size_t capacity = 1 << 20);
+	~GatheredLogPolicy();
+	void open_ostream();
+	void close_ostream();
+	void write(const std::string& msg);
+	void flush();
+	void collect(bool isFinal);
+private:
+	std::string m_directory; //!< Directory of the log files.
+	int m_rank = 0; //!< Rank of this processor.
+	int m_collector = 0; //!< Rank of the processor that writes this processor's messages.
+	int m_senders = 0; //!< Number of processors whose messages this one writes, other than itself.
+	std::unique_ptr<LogPolicyInterface> m_sink; //!< The log file (collector only).
+	std::unique_ptr<FileLogPolicy> m_fatalLog; //!< This processor's own log file, opened at a fatal error.
+	std::vector<char> m_pending; //!< Messages waiting to be sent to the collector, each ending in a null.
+	std::size_t m_capacity; //!< Most bytes of messages waiting to be sent.
+	unsigned long m_dropped = 0; //!< Messages dropped since the last batch, as the buffer was full.
+	std::mutex m_mutex;
+
+	void writeBatch(const std::vector<char>& batch);
+};
+
+#endif // GATHEREDLOGPOLICY_HPP_
@@ -1,8 +1,23 @@
 #include "Logger.hpp"
 
+#include "Misc/Allocations.hpp"
+
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
+namespace {
+
+/**
+ * @brief Whether msg is an ERROR or FATAL_ERROR message, after the "[rank n] " tag of a GatheredLogPolicy if it has one.
+ */
+bool isError(const std::string& msg) {
+	const std::size_t start = msg.compare(0, 6, "[rank ") == 0 ? msg.find("] ") + 2 : 0;
+	return msg.compare(start, 8, "<ERROR>:") == 0 || msg.compare(start, 14, "<FATAL_ERROR>:") == 0;
+}
+
+}
+
 void FileLogPolicy::open_ostream() {
 	m_outStream->open( filename.c_str(), std::ios_base::binary | std::ios_base::out );
 	if ( !m_outStream->is_open())
@@ -66,36 +81,161 @@ void ConsoleLogPolicy::write(const std::string& msg) {
 	(*m_outStream) << msg << std::flush;
 }
 
+/**
+ * @param sink Policy the messages are written to.
+ * @param capacity Largest number of messages waiting to be written.
+ */
+AsyncLogPolicy::AsyncLogPolicy(std::unique_ptr<LogPolicyInterface> sink, std::size_t capacity)
+: m_sink(std::move(sink))
+, m_ring(std::max(capacity, (std::size_t)1))
+{
+	if (m_sink == nullptr)
+		throw std::runtime_error("AsyncLogPolicy::AsyncLogPolicy: no policy to write to.");
+}
+
+AsyncLogPolicy::~AsyncLogPolicy() {
+	close_ostream();
+}
+
+void AsyncLogPolicy::open_ostream() {
+	m_sink->open_ostream();
+	m_isStopping = false;
+	m_thread = std::thread(&AsyncLogPolicy::writeMessages, this);
+}
+
+void AsyncLogPolicy::close_ostream() {
+	if (m_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_isStopping = true;
+		}
+		m_hasMessages.notify_one();
+		m_thread.join();
+		m_sink->close_ostream();
+	}
+}
+
+void AsyncLogPolicy::write(const std::string& msg) {
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_size == m_ring.size()) {
+			if (!isError(msg) || !m_thread.joinable()) {
+				++m_dropped;
+				return;
+			}
+			m_isDrained.wait(lock, [this]() { return m_size < m_ring.size(); });
+		}
+		m_ring[(m_head + m_size) % m_ring.size()] = msg;
+		++m_size;
+	}
+	m_hasMessages.notify_one();
+}
+
+void AsyncLogPolicy::flush() {
+	if (!m_thread.joinable())
+		return;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_isDrained.wait(lock, [this]() { return m_size == 0 && !m_isWriting; });
+	m_sink->flush();
+}
+
+/**
+ * @brief Runs on the background thread, writing the buffered messages in batches until the policy is closed.
+ */
+void AsyncLogPolicy::writeMessages() {
+	Allocations::excludeThread();
+	std::vector<std::string> batch;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_hasMessages.wait(lock, [this]() { return m_size > 0 || m_dropped > 0 || m_isStopping; });
+		if (m_size == 0 && m_dropped == 0 && m_isStopping)
+			break;
+		batch.clear();
+		for (; m_size > 0; --m_size, m_head = (m_head + 1) % m_ring.size())
+			batch.push_back(std::move(m_ring[m_head]));
+		unsigned long dropped = m_dropped;
+		m_dropped = 0;
+		m_isWriting = true;
+		lock.unlock();
+
+		for (const std::string& msg : batch)
+			m_sink->write(msg);
+		if (dropped > 0)
+			m_sink->write("<WARNING>: AsyncLogPolicy: dropped " + std::to_string(dropped) + " messages, as the log could not keep up.\n");
+
+		lock.lock();
+		m_isWriting = false;
+		m_isDrained.notify_all();
+	}
+}
+
 Logger::~Logger() {
 	for (auto& it : m_policies)
 		it.second->close_ostream();
 }
 
 void Logger::registerLogPolicy(const std::string& name, std::unique_ptr<LogPolicyInterface> policy) {
+	std::lock_guard<std::mutex> lock(m_writeMutex);
 	if (policy != nullptr) {
 		policy->open_ostream();
 		m_policies[name] = std::move(policy);
 	}
+	updateMaxLogLevel();
 }
 
 void Logger::unregisterLogPolicy(const std::string& name) {
+	std::lock_guard<std::mutex> lock(m_writeMutex);
 	m_policies.erase(name);
+	updateMaxLogLevel();
+}
+
+/**
+ * @brief Lets every policy pass on the messages it has buffered for other processors (see GatheredLogPolicy). Called by
+ * the main thread between steps, outside the parallel loops.
+ * @param isFinal Whether this is the last call of the run, which waits until every message has been written. Collective.
+ */
+void Logger::collect(bool isFinal) {
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+	for (auto& it : m_policies)
+		it.second->collect(isFinal);
 }
 
 void Logger::setLogLevel(SeverityType severity) {
+	std::lock_guard<std::mutex> lock(m_writeMutex);
 	for (auto& it : m_policies)
 		it.second->setLogLevel(severity);
+	updateMaxLogLevel();
 }
 
 void Logger::setLogLevel(SeverityType severity, const std::string& policy) {
+	std::lock_guard<std::mutex> lock(m_writeMutex);
 	auto it = m_policies.find(policy);
 	if (it != m_policies.end())
 		it->second->setLogLevel(severity);
+	updateMaxLogLevel();
 }
 
-void Logger::print_impl(SeverityType severity, std::unique_ptr<LogPolicyInterface>& policy) {
-	if (static_cast<int>(severity) <= policy->getLogLevel())
-		policy->write(m_logStream.str() );
+void Logger::updateMaxLogLevel() {
+	int level = 0;
+	for (auto& it : m_policies)
+		level = std::max(level, it.second->getLogLevel());
+	m_maxLogLevel.store(level);
+}
+
+/**
+ * @brief Writes a formatted message to every policy logging its severity. Errors are flushed straight away, as the
+ * run may be about to abort.
+ */
+void Logger::write(SeverityType severity, const std::string& msg) {
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+	for (auto& it : m_policies) {
+		if (static_cast<int>(severity) <= it.second->getLogLevel())
+			it.second->write(msg);
+	}
+	if (severity <= SeverityType::ERROR) {
+		for (auto& it : m_policies)
+			it.second->flush();
+	}
 }
 
 
@@ -8,6 +8,8 @@
 #ifndef LOGGER_HPP_
 #define LOGGER_HPP_
 
+#include <atomic>
+#include <condition_variable>
 #include <ctime>
 #include <memory>
 #include <mutex>
@@ -17,9 +19,19 @@
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <thread>
+#include <vector>
 
 enum class SeverityType : unsigned int { FATAL_ERROR = 1, ERROR, WARNING, NOTICE, INFO, DEBUG };
 
+/**
+ * Most verbose severity compiled in, e.g. -DTORCH_LOG_LEVEL=NOTICE removes every INFO and DEBUG print (the arguments
+ * of such calls are still evaluated, so they should be cheap).
+ */
+#ifndef TORCH_LOG_LEVEL
+#define TORCH_LOG_LEVEL DEBUG
+#endif
+
 /**
  * @class LogPolicyInterface
  * @brief Interface skeleton for any logging policy.
@@ -30,6 +42,8 @@ public:
 	virtual void open_ostream() = 0;
 	virtual void close_ostream() = 0;
 	virtual void write(const std::string& msg) = 0;
+	virtual void flush() {};
+	virtual void collect(bool /*isFinal*/) {}
 	virtual int getLogLevel() final {return logLevel;};
 	virtual void setLogLevel(SeverityType level) final {logLevel = static_cast<int>(level);};
 private:
@@ -50,7 +64,7 @@ public:
 
 	std::string getLoglineHeader();
 private:
-	unsigned m_logLineNumber;
+	unsigned m_logLineNumber = 0;
 	std::string filename = "";
 	std::unique_ptr< std::ofstream > m_outStream;
 };
@@ -70,6 +84,41 @@ private:
 	std::ostream* m_outStream;
 };
 
+/**
+ * @class AsyncLogPolicy
+ * @brief Hands the logs to another policy on a background thread, so that a slow file system or terminal never stalls
+ * the simulation.
+ *
+ * write() only moves the message into a bounded ring buffer. If the buffer is full the message is dropped, and the
+ * number dropped is logged once the background thread catches up, except for ERROR and FATAL_ERROR messages, which wait
+ * for room instead. flush() waits until every buffered message is
+ * written. The wrapped policy sees the messages a little later than they were made, so the line headers of a
+ * FileLogPolicy record the time they were written.
+ */
+class AsyncLogPolicy : public LogPolicyInterface {
+public:
+	AsyncLogPolicy(std::unique_ptr<LogPolicyInterface> sink, std::size_t capacity = 4096);
+	~AsyncLogPolicy();
+	void open_ostream();
+	void close_ostream();
+	void write(const std::string& msg);
+	void flush();
+private:
+	std::unique_ptr<LogPolicyInterface> m_sink;
+	std::vector<std::string> m_ring; //!< Messages waiting to be written, m_size of them from m_head on.
+	std::size_t m_head = 0;
+	std::size_t m_size = 0;
+	unsigned long m_dropped = 0; //!< Messages dropped since the last report, as the buffer was full.
+	bool m_isWriting = false;
+	bool m_isStopping = false;
+	std::mutex m_mutex;
+	std::condition_variable m_hasMessages;
+	std::condition_variable m_isDrained;
+	std::thread m_thread;
+
+	void writeMessages();
+};
+
 /**
  * @class Logger
  *
@@ -86,63 +135,70 @@ public:
 	void setLogLevel(SeverityType severity, const std::string& policy);
 	void registerLogPolicy(const std::string& name, std::unique_ptr<LogPolicyInterface> policy);
 	void unregisterLogPolicy(const std::string& name);
+	void collect(bool isFinal = false);
 
 	~Logger();
 
 	template< SeverityType severity , typename...Args >
-	void print( Args...args );
+	void print( const Args&...args );
 private:
-	SeverityType logLevel = SeverityType::DEBUG;
-	std::stringstream m_logStream;
 	std::map<std::string, std::unique_ptr<LogPolicyInterface>> m_policies;
 	std::mutex m_writeMutex;
+	std::atomic<int> m_maxLogLevel{0}; //!< Most verbose level of any policy, so other messages aren't formatted.
 
 	Logger( ) {};
 	Logger( Logger const& );
 	void operator=( Logger const& );
 
+	void updateMaxLogLevel();
+	void write(SeverityType severity, const std::string& msg);
+
 	//Core printing functionality
-	void print_impl(SeverityType severity, std::unique_ptr<LogPolicyInterface>& policy);
+	static void print_impl(std::ostream&) {}
 	template<typename First, typename...Rest>
-	void print_impl(SeverityType severity, std::unique_ptr<LogPolicyInterface>& policy, First parm1, Rest...parm);
+	static void print_impl(std::ostream& out, const First& parm1, const Rest&...parm);
 };
 
+/**
+ * @brief Formats a message and writes it to every policy logging its severity. Messages more verbose than
+ * TORCH_LOG_LEVEL compile to nothing, and the message is only formatted if some policy will write it.
+ */
 template< SeverityType severity , typename...Args >
-void Logger::print( Args...args ) {
-	m_writeMutex.lock();
+void Logger::print( const Args&...args ) {
+	if (static_cast<unsigned int>(severity) > static_cast<unsigned int>(SeverityType::TORCH_LOG_LEVEL))
+		return;
+	if (static_cast<int>(severity) > m_maxLogLevel.load(std::memory_order_relaxed))
+		return;
 
+	std::ostringstream message;
 	switch( severity ) {
 		case SeverityType::DEBUG:
-			m_logStream << "<DEBUG>: ";
+			message << "<DEBUG>: ";
 			break;
 		case SeverityType::INFO:
-			m_logStream << "<INFO>: ";
+			message << "<INFO>: ";
 			break;
 		case SeverityType::NOTICE:
-			m_logStream << "<NOTICE>: ";
+			message << "<NOTICE>: ";
 			break;
 		case SeverityType::WARNING:
-			m_logStream << "<WARNING>: ";
+			message << "<WARNING>: ";
 			break;
 		case SeverityType::ERROR:
-			m_logStream << "<ERROR>: ";
+			message << "<ERROR>: ";
 			break;
 		case SeverityType::FATAL_ERROR:
-			m_logStream << "<FATAL_ERROR>: ";
+			message << "<FATAL_ERROR>: ";
 			break;
 	};
-	for (auto& it : m_policies) {
-		print_impl(severity, it.second, args...);
-	}
-	m_logStream.str("");
-
-	m_writeMutex.unlock();
+	print_impl(message, args...);
+	write(severity, message.str());
 }
 
 template<typename First, typename...Rest >
-void Logger::print_impl(SeverityType severity, std::unique_ptr<LogPolicyInterface>& policy, First parm1, Rest...parm) {
-	m_logStream << parm1;
-	print_impl(severity, policy, parm...);
+void Logger::print_impl(std::ostream& out, const First& parm1, const Rest&...parm) {
+	out << parm1;
+	print_impl(out, parm...);
 }
 
 
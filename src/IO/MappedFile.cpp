@@ -0,0 +1,34 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @param filename Name of the file.
+ * @exception std::runtime_error Thrown if the file cannot be opened or mapped.
+ */
+MappedFile::MappedFile(const std::string& filename) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1)
+		throw std::runtime_error("MappedFile: unable to open " + filename + ".");
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		throw std::runtime_error("MappedFile: unable to stat " + filename + ".");
+	}
+	m_size = st.st_size;
+	if (m_size > 0)
+		m_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (m_data == MAP_FAILED)
+		throw std::runtime_error("MappedFile: unable to map " + filename + ".");
+}
+
+MappedFile::~MappedFile() {
+	if (m_data != nullptr && m_data != MAP_FAILED)
+		munmap(m_data, m_size);
+}
@@ -0,0 +1,36 @@
+/** Provides the MappedFile class.
+ *
+ * @file MappedFile.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef MAPPEDFILE_HPP_
+#define MAPPEDFILE_HPP_
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @class MappedFile
+ *
+ * @brief Read-only memory map of a whole file, unmapped when it goes out of scope.
+ *
+ * Only the pages that are read are loaded, so the readers of the binary snapshots and restarts copy out the rows they
+ * need without reading the rest of the file.
+ */
+class MappedFile {
+public:
+	explicit MappedFile(const std::string& filename);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data() const { return static_cast<const char*>(m_data); }
+	std::size_t size() const { return m_size; }
+private:
+	void* m_data = nullptr;
+	std::size_t m_size = 0;
+};
+
+#endif // MAPPEDFILE_HPP_
@@ -0,0 +1,320 @@
+#include "OutputStaging.hpp"
+
+#include "FileManagement.hpp"
+#include "Logger.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+#include "Misc/Allocations.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+/**
+ * @brief Writes all of n bytes at an offset of a file, however many calls it takes.
+ */
+bool pwriteAll(int fd, const char* data, long long n, long long offset) {
+	while (n > 0) {
+		const ssize_t written = pwrite(fd, data, (std::size_t)n, (off_t)offset);
+		if (written <= 0)
+			return false;
+		data += written;
+		n -= written;
+		offset += written;
+	}
+	return true;
+}
+
+/**
+ * @brief Reads all of n bytes at an offset of a file, however many calls it takes.
+ */
+bool preadAll(int fd, char* data, long long n, long long offset) {
+	while (n > 0) {
+		const ssize_t nread = pread(fd, data, (std::size_t)n, (off_t)offset);
+		if (nread <= 0)
+			return false;
+		data += nread;
+		n -= nread;
+		offset += nread;
+	}
+	return true;
+}
+
+/**
+ * @brief CRC-32 of a buffer of any size.
+ */
+uLong checksum(const char* data, std::size_t n) {
+	uLong crc = crc32(0L, Z_NULL, 0);
+	const std::size_t chunk = 1 << 30;
+	for (std::size_t i = 0; i < n; i += chunk)
+		crc = crc32(crc, reinterpret_cast<const Bytef*>(data + i), (uInt)std::min(chunk, n - i));
+	return crc;
+}
+
+}
+
+OutputStaging::~OutputStaging() {
+	if (m_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_isStopping = true;
+		}
+		m_hasJobs.notify_one();
+		m_thread.join();
+	}
+}
+
+/**
+ * @brief Stages the files in a directory, which every processor makes if it does not exist (as it is a different one
+ * on each node), and starts the background thread. Collective.
+ * @param directory Staging directory (empty to write the files straight to the output directory).
+ * @exception std::runtime_error Thrown if a processor cannot make the directory.
+ */
+void OutputStaging::initialise(const std::string& directory) {
+	finish();
+	m_directory = directory;
+	if (m_directory.empty())
+		return;
+	double failed = FileManagement::makeDirectoryPath(m_directory) != 0 ? 1 : 0;
+	if (MPIW::Instance().maximum(failed) > 0)
+		throw std::runtime_error("OutputStaging::initialise: unable to make stage_directory(=" + m_directory + ").");
+	if (!m_thread.joinable())
+		m_thread = std::thread(&OutputStaging::drainParts, this);
+}
+
+bool OutputStaging::isOn() const {
+	return !m_directory.empty();
+}
+
+/**
+ * @brief Writes a file like MPIW::writeBox, through the staging directory if there is one. Collective.
+ * @see MPIW::writeBox
+ */
+void OutputStaging::writeBox(const std::string& filename, const std::vector<char>& header, const char* data, int cellBytes,
+		const std::array<int, 3>& ncells, const std::array<int, 3>& boxCells, const std::array<int, 3>& boxOffset) {
+	MPIW& mpihandler = MPIW::Instance();
+	if (isOn()) {
+		Job job;
+		if (mpihandler.getRank() == 0 && !header.empty())
+			job.extents.push_back(Extent{0, (long long)header.size()});
+		// The rows of the box along x, merged where they run on into each other.
+		const long long rowBytes = (long long)boxCells[0]*cellBytes;
+		for (int k = 0; k < boxCells[2]; ++k) {
+			for (int j = 0; j < boxCells[1]; ++j) {
+				const long long cell = ((long long)(boxOffset[2] + k)*ncells[1] + boxOffset[1] + j)*ncells[0] + boxOffset[0];
+				const long long offset = (long long)header.size() + cell*cellBytes;
+				if (!job.extents.empty() && job.extents.back().offset + job.extents.back().bytes == offset)
+					job.extents.back().bytes += rowBytes;
+				else if (rowBytes > 0)
+					job.extents.push_back(Extent{offset, rowBytes});
+			}
+		}
+		const long long bytes = rowBytes*boxCells[1]*boxCells[2];
+		const long long size = (long long)header.size() + (long long)ncells[0]*ncells[1]*ncells[2]*cellBytes;
+		if (stage(filename, job, header, data, bytes, size))
+			return;
+	}
+	mpihandler.writeBox(filename, header, data, cellBytes, ncells, boxCells, boxOffset);
+}
+
+/**
+ * @brief Writes a file like MPIW::writeOrdered, through the staging directory if there is one. Collective.
+ * @see MPIW::writeOrdered(const std::string&, const std::vector<char>&, const char*, int) const
+ */
+void OutputStaging::writeOrdered(const std::string& filename, const std::vector<char>& header, const char* data, int count) {
+	MPIW& mpihandler = MPIW::Instance();
+	if (isOn()) {
+		const std::vector<int> counts = mpihandler.allGather(std::vector<int>{count});
+		long long offset = (long long)header.size(), size = (long long)header.size();
+		for (int r = 0; r < (int)counts.size(); ++r) {
+			if (r < mpihandler.getRank())
+				offset += counts[r];
+			size += counts[r];
+		}
+		Job job;
+		if (mpihandler.getRank() == 0 && !header.empty())
+			job.extents.push_back(Extent{0, (long long)header.size()});
+		if (count > 0) {
+			if (!job.extents.empty() && job.extents.back().offset + job.extents.back().bytes == offset)
+				job.extents.back().bytes += count;
+			else
+				job.extents.push_back(Extent{offset, (long long)count});
+		}
+		if (stage(filename, job, header, data, count, size))
+			return;
+	}
+	mpihandler.writeOrdered(filename, header, data, count);
+}
+
+/**
+ * @brief Writes this processor's part of a file to the staging directory and queues it. Collective.
+ * @param filename Name of the file in the output directory.
+ * @param job Extents of the part, to which the names are added.
+ * @param header Header of the file, part of the root processor's part if its first extent is at 0.
+ * @param data This processor's bytes after the header.
+ * @param bytes Number of bytes of data.
+ * @param size Size of the whole file.
+ * @return Whether the file was staged (if not, on any processor, it is to be written straight to the output directory).
+ */
+bool OutputStaging::stage(const std::string& filename, Job& job, const std::vector<char>& header, const char* data,
+		long long bytes, long long size) {
+	MPIW& mpihandler = MPIW::Instance();
+	poll();
+	job.staged = filename + ".staged";
+	job.part = m_directory + "/torch_" + std::to_string((long long)getpid()) + "_" + std::to_string(m_count++) + ".part";
+	// A file left over by an earlier run must not be written into.
+	if (mpihandler.getRank() == 0)
+		std::remove(job.staged.c_str());
+
+	double failed = 0;
+	{
+		std::ofstream out(job.part, std::ios::binary);
+		if (!job.extents.empty() && job.extents.front().offset == 0 && !header.empty())
+			out.write(header.data(), header.size());
+		out.write(data, bytes);
+		failed = out ? 0 : 1;
+	}
+	if (mpihandler.maximum(failed) > 0) {
+		std::remove(job.part.c_str());
+		Logger::Instance().print<SeverityType::WARNING>("OutputStaging::stage: unable to stage ", filename, " in ", m_directory,
+				", so it is written directly.\n");
+		return false;
+	}
+
+	m_pending.push_back(Pending{filename, size});
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_hasJobs.notify_one();
+	return true;
+}
+
+/**
+ * @brief Renames the staged files whose parts every processor has drained, in the order they were staged. Collective.
+ */
+void OutputStaging::poll() {
+	if (m_pending.empty())
+		return;
+	MPIW& mpihandler = MPIW::Instance();
+	std::vector<double> failures;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		failures.assign(m_failed.begin(), m_failed.end());
+	}
+	double ndrained = (double)failures.size();
+	const int n = (int)mpihandler.minimum(ndrained);
+	if (n == 0)
+		return;
+	failures.resize(n);
+	failures = mpihandler.maximum(failures);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_failed.erase(m_failed.begin(), m_failed.begin() + n);
+	}
+
+	for (int i = 0; i < n; ++i) {
+		const Pending file = m_pending.front();
+		m_pending.pop_front();
+		const std::string staged = file.filename + ".staged";
+		if (failures[i] > 0) {
+			Logger::Instance().print<SeverityType::WARNING>("OutputStaging::poll: unable to drain ", file.filename,
+					", its parts are left in ", m_directory, ".\n");
+			continue;
+		}
+		if (mpihandler.getRank() == 0 && (truncate(staged.c_str(), (off_t)file.size) != 0 || std::rename(staged.c_str(), file.filename.c_str()) != 0))
+			Logger::Instance().print<SeverityType::WARNING>("OutputStaging::poll: unable to rename ", staged, ".\n");
+	}
+}
+
+/**
+ * @brief Waits until every part this processor staged is drained and renames the files. Collective.
+ */
+void OutputStaging::finish() {
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_isDrained.wait(lock, [this]() { return m_jobs.empty() && !m_isDraining; });
+	}
+	poll();
+}
+
+/**
+ * @brief Runs on the background thread, draining the queued parts in order until the OutputStaging is destroyed.
+ */
+void OutputStaging::drainParts() {
+	Allocations::excludeThread();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_hasJobs.wait(lock, [this]() { return !m_jobs.empty() || m_isStopping; });
+		if (m_jobs.empty())
+			break;
+		const Job job = m_jobs.front();
+		m_jobs.pop_front();
+		m_isDraining = true;
+		lock.unlock();
+		const bool isDrained = drain(job) || drain(job);
+		if (isDrained)
+			std::remove(job.part.c_str());
+		lock.lock();
+		m_failed.push_back(isDrained ? 0 : 1);
+		m_isDraining = false;
+		if (m_jobs.empty())
+			m_isDrained.notify_all();
+	}
+}
+
+/**
+ * @brief Copies a part into its extents of the staged file, syncs it and checks that the extents read back with the
+ * CRC-32 of the part.
+ * @return Whether the part was copied intact.
+ */
+bool OutputStaging::drain(const Job& job) {
+	std::vector<char> bytes;
+	{
+		std::ifstream in(job.part, std::ios::binary | std::ios::ate);
+		if (!in)
+			return false;
+		bytes.resize((std::size_t)in.tellg());
+		in.seekg(0);
+		in.read(bytes.data(), bytes.size());
+		if (!in)
+			return false;
+	}
+	long long total = 0;
+	for (const Extent& extent : job.extents)
+		total += extent.bytes;
+	if (total != (long long)bytes.size())
+		return false;
+
+	const int out = open(job.staged.c_str(), O_WRONLY | O_CREAT, 0644);
+	if (out < 0)
+		return false;
+	bool isWritten = true;
+	long long pos = 0;
+	for (const Extent& extent : job.extents) {
+		isWritten = isWritten && pwriteAll(out, bytes.data() + pos, extent.bytes, extent.offset);
+		pos += extent.bytes;
+	}
+	isWritten = fsync(out) == 0 && isWritten;
+	if (close(out) != 0 || !isWritten)
+		return false;
+
+	const uLong expected = checksum(bytes.data(), bytes.size());
+	const int in = open(job.staged.c_str(), O_RDONLY);
+	if (in < 0)
+		return false;
+	bool isRead = true;
+	pos = 0;
+	for (const Extent& extent : job.extents) {
+		isRead = isRead && preadAll(in, bytes.data() + pos, extent.bytes, extent.offset);
+		pos += extent.bytes;
+	}
+	close(in);
+	return isRead && checksum(bytes.data(), bytes.size()) == expected;
+}
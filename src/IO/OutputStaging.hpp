@@ -0,0 +1,98 @@
+/** Provides the OutputStaging class.
+ *
+ * @file OutputStaging.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef OUTPUTSTAGING_HPP_
+#define OUTPUTSTAGING_HPP_
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @class OutputStaging
+ *
+ * @brief Stages the binary snapshots and restart files on a node-local directory (stage_directory) and drains them to
+ * the output directory on a background thread, so a run only waits for its local disk.
+ *
+ * writeBox and writeOrdered stand in for those of MPIW. Every processor writes the bytes it would have written to the
+ * shared file, the header included on the root processor, to a part file of its own in the staging directory, and
+ * queues it. The background thread copies each part to its offsets in <file>.staged in the output directory, syncs it,
+ * reads it back and compares a CRC-32 of what it reads with one of the part, trying twice before giving up, and then
+ * deletes the part. The thread makes no MPI calls: poll(), called by every staged write and by finish(), finds the
+ * files every processor has drained and the root processor renames each to its own name, so a file only ever appears
+ * whole. A file that failed to drain is warned about and its parts are left in the staging directory.
+ *
+ * Without a staging directory the writes go straight to MPIW.
+ */
+class OutputStaging {
+public:
+	static OutputStaging& Instance() {
+		static OutputStaging instance;
+		return instance;
+	}
+	~OutputStaging();
+
+	void initialise(const std::string& directory);
+	bool isOn() const;
+
+	void writeBox(const std::string& filename, const std::vector<char>& header, const char* data, int cellBytes,
+			const std::array<int, 3>& ncells, const std::array<int, 3>& boxCells, const std::array<int, 3>& boxOffset);
+	void writeOrdered(const std::string& filename, const std::vector<char>& header, const char* data, int count);
+	void poll();
+	void finish();
+
+private:
+	/**
+	 * @brief Bytes of a part that go to an offset of the file, following the previous extent's in the part.
+	 */
+	struct Extent {
+		long long offset;
+		long long bytes;
+	};
+
+	/**
+	 * @brief A processor's part of a staged file, waiting for the background thread.
+	 */
+	struct Job {
+		std::string part; //!< Part file in the staging directory.
+		std::string staged; //!< File in the output directory the part is copied into.
+		std::vector<Extent> extents;
+	};
+
+	/**
+	 * @brief A staged file waiting for every processor to drain its part.
+	 */
+	struct Pending {
+		std::string filename;
+		long long size; //!< Size of the whole file.
+	};
+
+	std::string m_directory; //!< Staging directory (empty for none).
+	long long m_count = 0; //!< Files staged by this processor so far, which number its part files.
+	std::deque<Pending> m_pending; //!< Staged files not yet renamed, in the order they were staged.
+
+	std::mutex m_mutex;
+	std::condition_variable m_hasJobs;
+	std::condition_variable m_isDrained;
+	std::deque<Job> m_jobs; //!< Parts waiting to be drained.
+	std::vector<char> m_failed; //!< Whether each part drained since the last poll failed, in order.
+	bool m_isDraining = false;
+	bool m_isStopping = false;
+	std::thread m_thread;
+
+	OutputStaging() = default;
+	bool stage(const std::string& filename, Job& job, const std::vector<char>& header, const char* data, long long bytes,
+			long long size);
+	void drainParts();
+	static bool drain(const Job& job);
+};
+
+#endif // OUTPUTSTAGING_HPP_
@@ -14,12 +14,21 @@
 
 #include "selene/include/selene.h"
 
-std::string parseString(sel::Selector selector) {
+/**
+ * @brief Runs a Lua script held in memory, e.g. one sent by MPIW::broadcastFile, as if it were loaded from filename.
+ * @return Whether the script loaded and ran.
+ */
+inline bool loadLuaText(lua_State* state, const std::string& text, const std::string& filename) {
+	const std::string chunkname = "@" + filename;
+	return luaL_loadbuffer(state, text.data(), text.size(), chunkname.c_str()) == 0 && lua_pcall(state, 0, LUA_MULTRET, 0) == 0;
+}
+
+inline std::string parseString(sel::Selector selector) {
 	std::string str = selector;
 	return str;
 }
 
-bool exists(sel::Selector selector) {
+inline bool exists(sel::Selector selector) {
 	std::string str = selector;
 
 	return !(str.compare("") == 0);
@@ -34,7 +43,7 @@ void parseLuaVariable(sel::Selector selector, T& var) {
 }
 
 template<>
-void parseLuaVariable(sel::Selector selector, std::string& var) {
+inline void parseLuaVariable(sel::Selector selector, std::string& var) {
 	if (exists(selector))
 		var = parseString(selector);
 	else
@@ -0,0 +1,300 @@
+#include "Restart.hpp"
+
+#include "Fluid/Grid.hpp"
+#include "Fluid/GridCell.hpp"
+#include "Misc/Parallel.hpp"
+#include "Torch/Common.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <zlib.h>
+
+namespace {
+
+const char MAGIC[8] = {'T', 'O', 'R', 'C', 'H', 'R', 'S', 'T'};
+
+template <class T>
+void append(std::vector<char>& bytes, const T& value) {
+	const char* p = reinterpret_cast<const char*>(&value);
+	bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+template <class T>
+T extract(const char* bytes, std::size_t& pos) {
+	T value;
+	std::memcpy(&value, bytes + pos, sizeof(T));
+	pos += sizeof(T);
+	return value;
+}
+
+/**
+ * @brief Transposes, XORs with the previous value of each variable and byte shuffles n records (see RestartCodec).
+ */
+std::vector<unsigned char> shuffle(const double* records, std::size_t n) {
+	const int nvars = RestartHeader::recordSize;
+	std::vector<unsigned char> bytes(n*nvars*sizeof(double));
+	unsigned char* out = bytes.data();
+	for (int iv = 0; iv < nvars; ++iv) {
+		std::uint64_t previous = 0;
+		for (std::size_t i = 0; i < n; ++i) {
+			std::uint64_t bits;
+			std::memcpy(&bits, &records[i*nvars + iv], sizeof(bits));
+			const std::uint64_t delta = bits^previous;
+			previous = bits;
+			for (int ib = 0; ib < 8; ++ib)
+				out[ib*n + i] = (unsigned char)(delta >> (8*ib));
+		}
+		out += 8*n;
+	}
+	return bytes;
+}
+
+/**
+ * @brief Reverses shuffle.
+ */
+void unshuffle(const unsigned char* bytes, std::size_t n, double* records) {
+	const int nvars = RestartHeader::recordSize;
+	for (int iv = 0; iv < nvars; ++iv) {
+		std::uint64_t previous = 0;
+		for (std::size_t i = 0; i < n; ++i) {
+			std::uint64_t delta = 0;
+			for (int ib = 0; ib < 8; ++ib)
+				delta |= (std::uint64_t)bytes[ib*n + i] << (8*ib);
+			previous ^= delta;
+			std::memcpy(&records[i*nvars + iv], &previous, sizeof(previous));
+		}
+		bytes += 8*n;
+	}
+}
+
+}
+
+const int RestartHeader::version;
+const int RestartHeader::size;
+const int RestartHeader::recordSize = 3 + 2*UID::N + RID::N + TID::N + TORCH_MAX_DIMENSIONS + 2;
+
+/**
+ * @brief Packs the header into the bytes found at the start of a restart file.
+ */
+std::vector<char> RestartHeader::serialise() const {
+	std::vector<char> bytes(MAGIC, MAGIC + 8);
+	bytes.reserve(size);
+	append<std::int32_t>(bytes, fileVersion);
+	append<std::int32_t>(bytes, size);
+	append<std::int32_t>(bytes, UID::N);
+	append<std::int32_t>(bytes, RID::N);
+	append<std::int32_t>(bytes, TID::N);
+	append<std::int32_t>(bytes, recordSize);
+	append<std::int32_t>(bytes, nd);
+	for (int i = 0; i < 3; ++i)
+		append<std::int32_t>(bytes, ncells[i]);
+	append<std::int32_t>(bytes, checkpoint);
+	append<std::int32_t>(bytes, splitPhase);
+	append<std::int64_t>(bytes, nrecords);
+	append<std::int64_t>(bytes, steps);
+	append<double>(bytes, time);
+	append<double>(bytes, deltatime);
+	append<double>(bytes, sideLength);
+	for (int i = 0; i < 3; ++i)
+		append<double>(bytes, scales[i]);
+	return bytes;
+}
+
+/**
+ * @brief Unpacks and checks the header at the start of a restart file.
+ * @param bytes Contents of the restart file.
+ * @param nbytes Size of the restart file.
+ * @param filename Name of the restart file, for error messages.
+ */
+RestartHeader RestartHeader::deserialise(const char* bytes, std::size_t nbytes, const std::string& filename) {
+	if (nbytes < (std::size_t)size || !std::equal(MAGIC, MAGIC + 8, bytes))
+		throw std::runtime_error("RestartHeader::deserialise: " + filename + " is not a Torch restart file.");
+	std::size_t pos = 8;
+	const int fileVersion = extract<std::int32_t>(bytes, pos);
+	if ((fileVersion != 1 && fileVersion != version && fileVersion != compressedVersion) || extract<std::int32_t>(bytes, pos) != size)
+		throw std::runtime_error("RestartHeader::deserialise: " + filename + " has an unsupported restart version.");
+	if (extract<std::int32_t>(bytes, pos) != UID::N || extract<std::int32_t>(bytes, pos) != RID::N ||
+			extract<std::int32_t>(bytes, pos) != TID::N || extract<std::int32_t>(bytes, pos) != recordSize)
+		throw std::runtime_error("RestartHeader::deserialise: " + filename + " was written by a build with different cell variables.");
+
+	RestartHeader header;
+	header.fileVersion = fileVersion;
+	header.nd = extract<std::int32_t>(bytes, pos);
+	for (int i = 0; i < 3; ++i)
+		header.ncells[i] = extract<std::int32_t>(bytes, pos);
+	header.checkpoint = extract<std::int32_t>(bytes, pos);
+	header.splitPhase = extract<std::int32_t>(bytes, pos);
+	header.nrecords = extract<std::int64_t>(bytes, pos);
+	header.steps = extract<std::int64_t>(bytes, pos);
+	header.time = extract<double>(bytes, pos);
+	header.deltatime = extract<double>(bytes, pos);
+	header.sideLength = extract<double>(bytes, pos);
+	for (int i = 0; i < 3; ++i)
+		header.scales[i] = extract<double>(bytes, pos);
+
+	if (fileVersion != compressedVersion && nbytes < size + header.nrecords*recordSize*sizeof(double))
+		throw std::runtime_error("RestartHeader::deserialise: " + filename + " is truncated.");
+	return header;
+}
+
+/**
+ * @brief Copies the state of a GridCell of a Grid into a record of recordSize doubles, with a zero gravitational force
+ * density if the Grid does not store one (see Grid::storesGravity).
+ */
+void RestartHeader::pack(const Grid& grid, const GridCell& cell, double* record) {
+	record = std::copy(cell.xc.begin(), cell.xc.end(), record);
+	record = std::copy(cell.Q.begin(), cell.Q.end(), record);
+	record = std::copy(cell.U.begin(), cell.U.end(), record);
+	record = std::copy(cell.R.begin(), cell.R.end(), record);
+	record = std::copy(cell.T.begin(), cell.T.end(), record);
+	if (grid.storesGravity())
+		record = std::copy(grid.getGravity(cell.id).begin(), grid.getGravity(cell.id).end(), record);
+	else
+		record = std::fill_n(record, TORCH_MAX_DIMENSIONS, 0.0);
+	*record++ = cell.heatCapacityRatio;
+	*record++ = cell.T_min;
+}
+
+/**
+ * @brief Restores the state of a GridCell of a Grid from a record made by RestartHeader::pack (but not its coordinates),
+ * leaving out the gravitational force density if the Grid does not store one.
+ */
+void RestartHeader::unpack(const double* record, Grid& grid, GridCell& cell) {
+	record += 3;
+	std::copy(record, record + UID::N, cell.Q.begin());
+	record += UID::N;
+	std::copy(record, record + UID::N, cell.U.begin());
+	record += UID::N;
+	std::copy(record, record + RID::N, cell.R.begin());
+	record += RID::N;
+	std::copy(record, record + TID::N, cell.T.begin());
+	record += TID::N;
+	if (grid.storesGravity())
+		std::copy(record, record + TORCH_MAX_DIMENSIONS, grid.getGravity(cell.id).begin());
+	record += TORCH_MAX_DIMENSIONS;
+	cell.heatCapacityRatio = *record++;
+	cell.T_min = *record++;
+}
+
+/**
+ * @brief Grid coordinates (the GridCell indices along each dimension) of the cell in a record.
+ */
+std::array<int, 3> RestartHeader::coordinates(const double* record) {
+	std::array<int, 3> xc;
+	for (int i = 0; i < 3; ++i)
+		xc[i] = (int)record[i];
+	return xc;
+}
+
+/**
+ * @brief Compresses the records of this processor's box of cells into its part of a version 3 restart file.
+ * @param records Records of the box, x fastest.
+ * @param boxOffset Grid coordinates of the first cell of the box.
+ * @param boxCells Number of cells of the box along each dimension.
+ * @return The part.
+ */
+std::vector<char> RestartCodec::encode(const std::vector<double>& records, const std::array<int, 3>& boxOffset,
+		const std::array<int, 3>& boxCells) {
+	const std::size_t nrecords = records.size()/RestartHeader::recordSize;
+	const int nblocks = (int)((nrecords + blockRecords - 1)/blockRecords);
+	std::vector<std::vector<char>> blocks(nblocks);
+	Parallel::forEachDynamic(0, nblocks, [&](int iblock) {
+		const std::size_t first = (std::size_t)iblock*blockRecords;
+		const std::size_t n = std::min<std::size_t>(blockRecords, nrecords - first);
+		const std::vector<unsigned char> shuffled = shuffle(&records[first*RestartHeader::recordSize], n);
+		uLongf size = compressBound(shuffled.size());
+		std::vector<char> block;
+		append<std::int64_t>(block, n);
+		append<std::int64_t>(block, 0);
+		const std::size_t start = block.size();
+		block.resize(start + size);
+		if (compress2((Bytef*)&block[start], &size, shuffled.data(), shuffled.size(), Z_BEST_SPEED) != Z_OK)
+			throw std::runtime_error("RestartCodec::encode: zlib failed to compress.");
+		block.resize(start + size);
+		const std::int64_t compressedSize = size;
+		std::memcpy(&block[8], &compressedSize, sizeof(compressedSize));
+		blocks[iblock] = std::move(block);
+	});
+
+	std::vector<char> part;
+	for (int i = 0; i < 3; ++i)
+		append<std::int32_t>(part, boxOffset[i]);
+	for (int i = 0; i < 3; ++i)
+		append<std::int32_t>(part, boxCells[i]);
+	append<std::int64_t>(part, nblocks);
+	for (const std::vector<char>& block : blocks)
+		part.insert(part.end(), block.begin(), block.end());
+	return part;
+}
+
+/**
+ * @brief Decompresses the records of a version 3 restart file that belong to a box of cells.
+ *
+ * Only the parts whose boxes overlap the box are decompressed, so each processor reads little more than its own cells
+ * whatever the number of processors that wrote the file.
+ * @param bytes Contents of the restart file.
+ * @param nbytes Size of the restart file.
+ * @param coreOffset Grid coordinates of the first cell of the box.
+ * @param coreCells Number of cells of the box along each dimension.
+ * @param filename Name of the restart file, for error messages.
+ * @param visit Called with every record of a cell in the box.
+ * @exception std::runtime_error Thrown if the file is truncated or its data corrupt.
+ */
+void RestartCodec::decode(const char* bytes, std::size_t nbytes, const std::array<int, 3>& coreOffset,
+		const std::array<int, 3>& coreCells, const std::string& filename, const std::function<void(const double*)>& visit) {
+	const std::string truncated = "RestartCodec::decode: " + filename + " is truncated.";
+	std::size_t pos = RestartHeader::size;
+	while (pos < nbytes) {
+		if (pos + 6*4 + 8 > nbytes)
+			throw std::runtime_error(truncated);
+		std::array<int, 3> boxOffset, boxCells;
+		for (int i = 0; i < 3; ++i)
+			boxOffset[i] = extract<std::int32_t>(bytes, pos);
+		for (int i = 0; i < 3; ++i)
+			boxCells[i] = extract<std::int32_t>(bytes, pos);
+		const long long nblocks = extract<std::int64_t>(bytes, pos);
+
+		// The blocks of the part, found by their sizes.
+		std::vector<std::size_t> starts;
+		std::vector<long long> counts, sizes;
+		for (long long iblock = 0; iblock < nblocks; ++iblock) {
+			if (pos + 16 > nbytes)
+				throw std::runtime_error(truncated);
+			counts.push_back(extract<std::int64_t>(bytes, pos));
+			sizes.push_back(extract<std::int64_t>(bytes, pos));
+			starts.push_back(pos);
+			pos += sizes.back();
+			if (pos > nbytes)
+				throw std::runtime_error(truncated);
+		}
+		bool overlaps = true;
+		for (int i = 0; i < 3; ++i)
+			overlaps = overlaps && boxOffset[i] < coreOffset[i] + coreCells[i] && coreOffset[i] < boxOffset[i] + boxCells[i];
+		if (!overlaps)
+			continue;
+
+		std::vector<std::vector<double>> records(nblocks);
+		Parallel::forEachDynamic(0, (int)nblocks, [&](int iblock) {
+			const std::size_t n = counts[iblock];
+			std::vector<unsigned char> shuffled(n*RestartHeader::recordSize*sizeof(double));
+			uLongf size = shuffled.size();
+			if (uncompress(shuffled.data(), &size, (const Bytef*)bytes + starts[iblock], sizes[iblock]) != Z_OK || size != shuffled.size())
+				throw std::runtime_error("RestartCodec::decode: " + filename + " has a corrupt block.");
+			records[iblock].resize(n*RestartHeader::recordSize);
+			unshuffle(shuffled.data(), n, records[iblock].data());
+		});
+		for (const std::vector<double>& block : records) {
+			for (std::size_t i = 0; i < block.size(); i += RestartHeader::recordSize) {
+				const std::array<int, 3> xc = RestartHeader::coordinates(&block[i]);
+				bool inside = true;
+				for (int idim = 0; idim < 3; ++idim)
+					inside = inside && xc[idim] >= coreOffset[idim] && xc[idim] < coreOffset[idim] + coreCells[idim];
+				if (inside)
+					visit(&block[i]);
+			}
+		}
+	}
+}
@@ -0,0 +1,104 @@
+/** Provides the RestartHeader class.
+ *
+ * @file Restart.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef RESTART_HPP_
+#define RESTART_HPP_
+
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+class Grid;
+class GridCell;
+
+/**
+ * @class RestartHeader
+ *
+ * @brief Describes the layout of a binary restart (.trst) file.
+ *
+ * A restart file holds the exact state of every core GridCell at the end of a step, in code units, so that a run can
+ * carry on from it as if it had never stopped. It is the header followed by one record of recordSize native doubles per
+ * GridCell: its grid coordinates, then Q, U, R and T, the gravitational force density (zero unless the Grid stores it),
+ * heatCapacityRatio and T_min (see RestartHeader::pack). The records are in the order of the cells' grid coordinates,
+ * x fastest, so each processor finds the records of its own cells from their coordinates alone and a run may restart on
+ * a different number of processors.
+ *
+ * Version 1 files, which are still read, hold the records of each processor contiguously and in rank order, so they
+ * are searched for each processor's cells. Version 3 files hold the same records compressed by RestartCodec.
+ *
+ * The header, in native byte order, is:
+ * - char[8]    "TORCHRST"
+ * - int32      format version
+ * - int32      header size in bytes (the offset of the first record)
+ * - int32[4]   UID::N, RID::N, TID::N and doubles per record, which must match the build reading the file
+ * - int32      number of dimensions
+ * - int32[3]   number of cells along each dimension
+ * - int32      checkpoint count
+ * - int32      operator splitting phase (which component goes first in the next step)
+ * - int64      number of records
+ * - int64      step count
+ * - float64    time and the time step allowed at the last step, before a checkpoint cut it short (code units)
+ * - float64    side length (code units)
+ * - float64[3] mass, length and time scales of the code units (cgs)
+ *
+ * @see DataPrinter::printRestart
+ * @see DataReader::readRestart
+ */
+class RestartHeader {
+public:
+	static const int version = 2;
+	static const int compressedVersion = 3; //!< Version of files whose records are compressed by RestartCodec.
+	static const int size = 8 + 12*4 + 2*8 + 6*8;
+	static const int recordSize;
+
+	int fileVersion = version; //!< Format version of the file the header was read from.
+	int nd = 0;
+	std::array<int, 3> ncells = std::array<int, 3>{{ 1, 1, 1 }};
+	int checkpoint = 0;
+	int splitPhase = 0;
+	long long nrecords = 0;
+	long long steps = 0;
+	double time = 0;
+	double deltatime = 0;
+	double sideLength = 0;
+	std::array<double, 3> scales = std::array<double, 3>{{ 0, 0, 0 }}; //!< Code units of mass, length and time in cgs.
+
+	std::vector<char> serialise() const;
+	static RestartHeader deserialise(const char* bytes, std::size_t nbytes, const std::string& filename);
+
+	static void pack(const Grid& grid, const GridCell& cell, double* record);
+	static void unpack(const double* record, Grid& grid, GridCell& cell);
+	static std::array<int, 3> coordinates(const double* record);
+};
+
+/**
+ * @class RestartCodec
+ *
+ * @brief Losslessly compresses the records of a restart file, which follow the header of a version 3 file instead of
+ * the raw records.
+ *
+ * Each processor compresses the records of its own box of cells (x fastest) into a part of the file, and the parts
+ * follow the header in rank order. A part is its box, as int32[3] offset and int32[3] number of cells along each
+ * dimension, the int64 number of blocks and the blocks. A block is up to blockRecords consecutive records, as the int64
+ * number of records, the int64 size of the compressed data and the data. The records of a block are transposed so
+ * that each variable is contiguous, each double is XORed with the previous one of its variable (neighbouring cells
+ * have similar values, so the leading bits of the XOR are mostly zero), the bytes are shuffled so that those of the
+ * same significance are contiguous, and the result is deflated by zlib at its fastest level. The blocks are
+ * compressed and decompressed independently by the OpenMP threads, and the doubles come back bit for bit.
+ */
+class RestartCodec {
+public:
+	static const int blockRecords = 8192;
+
+	static std::vector<char> encode(const std::vector<double>& records, const std::array<int, 3>& boxOffset,
+			const std::array<int, 3>& boxCells);
+	static void decode(const char* bytes, std::size_t nbytes, const std::array<int, 3>& coreOffset,
+			const std::array<int, 3>& coreCells, const std::string& filename, const std::function<void(const double*)>& visit);
+};
+
+#endif // RESTART_HPP_
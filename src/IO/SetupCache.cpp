@@ -0,0 +1,159 @@
+#include "SetupCache.hpp"
+
+#include "FileManagement.hpp"
+#include "Logger.hpp"
+#include "MappedFile.hpp"
+#include "Restart.hpp"
+#include "Fluid/Fluid.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * @param directory Directory the entries are kept in.
+ * @param key Description of everything the set up cells depend on, the same on every processor.
+ */
+SetupCache::SetupCache(const std::string& directory, const std::string& key)
+: m_key(key)
+, m_hash(hash(key))
+{
+	char name[17];
+	std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)m_hash);
+	m_entry = directory + "/" + name;
+}
+
+/**
+ * @brief Directory of the entry of this cache's key.
+ */
+const std::string& SetupCache::getEntry() const {
+	return m_entry;
+}
+
+/**
+ * @brief The 64-bit FNV-1a hash of a text.
+ */
+std::uint64_t SetupCache::hash(const std::string& text) {
+	std::uint64_t h = 14695981039346656037ULL;
+	for (unsigned char c : text) {
+		h ^= c;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+std::string SetupCache::filename() const {
+	return m_entry + "/rank_" + std::to_string(MPIW::Instance().getRank()) + ".tsetup";
+}
+
+SetupCache::FileHeader SetupCache::makeHeader(const Fluid& fluid) const {
+	const Grid& grid = fluid.getGrid();
+	FileHeader header;
+	std::memcpy(header.magic, "TSETUP01", sizeof(header.magic));
+	header.hash = m_hash;
+	header.recordSize = RestartHeader::recordSize;
+	header.rayBytes = grid.storesRayData() ? (std::int32_t)sizeof(RayGeometry) : 0;
+	header.ncells = grid.getIterable(CellRange::GRID_CELLS).size();
+	for (int i = 0; i < 3; ++i) {
+		header.offset[i] = grid.coreOffset[i];
+		header.cells[i] = grid.coreCells[i];
+	}
+	return header;
+}
+
+/**
+ * @brief Sets the core cells and their RayGeometry from the entry, if every processor has a file in it that matches its
+ * block. Collective.
+ * @return Whether the cells were loaded (if not, they are left as they were).
+ */
+bool SetupCache::load(Fluid& fluid) const {
+	Grid& grid = fluid.getGrid();
+	const FileHeader expected = makeHeader(fluid);
+	const std::size_t recordBytes = RestartHeader::recordSize*sizeof(double);
+	const std::size_t size = sizeof(FileHeader) + expected.ncells*(recordBytes + expected.rayBytes);
+	std::unique_ptr<MappedFile> file;
+	double missing = 0;
+	try {
+		file.reset(new MappedFile(filename()));
+		FileHeader header;
+		if (file->size() != size)
+			missing = 1;
+		else {
+			std::memcpy(&header, file->data(), sizeof(FileHeader));
+			missing = std::memcmp(&header, &expected, sizeof(FileHeader)) == 0 ? 0 : 1;
+		}
+	}
+	catch (const std::runtime_error&) {
+		missing = 1;
+	}
+	if (MPIW::Instance().maximum(missing) > 0)
+		return false;
+
+	const char* records = file->data() + sizeof(FileHeader);
+	const char* rays = records + expected.ncells*recordBytes;
+	std::vector<double> record(RestartHeader::recordSize);
+	long long i = 0;
+	for (GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		std::memcpy(record.data(), records + i*recordBytes, recordBytes);
+		RestartHeader::unpack(record.data(), grid, cell);
+		if (expected.rayBytes > 0)
+			std::memcpy(&grid.getRayGeometry(cell.id), rays + i*expected.rayBytes, expected.rayBytes);
+		++i;
+	}
+	return true;
+}
+
+/**
+ * @brief Writes the core cells and their RayGeometry to the entry. Collective.
+ *
+ * Each file is written under a temporary name and then renamed, so a run reading the entry at the same time never sees
+ * half a file. A cache that cannot be written is only warned about.
+ */
+void SetupCache::store(const Fluid& fluid) const {
+	MPIW& mpihandler = MPIW::Instance();
+	double failed = 0;
+	if (mpihandler.getRank() == 0) {
+		if (FileManagement::makeDirectoryPath(m_entry) != 0)
+			failed = 1;
+		else {
+			std::ofstream keyFile(m_entry + "/key.txt");
+			keyFile << m_key;
+			failed = keyFile ? 0 : 1;
+		}
+	}
+	mpihandler.barrier();
+	if (mpihandler.maximum(failed) > 0) {
+		Logger::Instance().print<SeverityType::WARNING>("SetupCache::store: unable to create ", m_entry, ".\n");
+		return;
+	}
+
+	const Grid& grid = fluid.getGrid();
+	const FileHeader header = makeHeader(fluid);
+	std::vector<char> bytes(sizeof(FileHeader) + header.ncells*(RestartHeader::recordSize*sizeof(double) + header.rayBytes));
+	std::memcpy(bytes.data(), &header, sizeof(FileHeader));
+	double* records = reinterpret_cast<double*>(bytes.data() + sizeof(FileHeader));
+	char* rays = bytes.data() + sizeof(FileHeader) + header.ncells*RestartHeader::recordSize*sizeof(double);
+	long long i = 0;
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		RestartHeader::pack(grid, cell, records + i*RestartHeader::recordSize);
+		if (header.rayBytes > 0)
+			std::memcpy(rays + i*header.rayBytes, &grid.getRayGeometry(cell.id), header.rayBytes);
+		++i;
+	}
+
+	const std::string name = filename();
+	const std::string temporary = name + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary);
+		out.write(bytes.data(), bytes.size());
+		failed = out ? 0 : 1;
+	}
+	if (failed == 0 && std::rename(temporary.c_str(), name.c_str()) != 0)
+		failed = 1;
+	if (mpihandler.maximum(failed) > 0)
+		Logger::Instance().print<SeverityType::WARNING>("SetupCache::store: unable to write ", m_entry, ".\n");
+}
@@ -0,0 +1,63 @@
+/** Provides the SetupCache class.
+ *
+ * @file SetupCache.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef SETUPCACHE_HPP_
+#define SETUPCACHE_HPP_
+
+#include <cstdint>
+#include <string>
+
+class Fluid;
+
+/**
+ * @class SetupCache
+ *
+ * @brief Caches the initial state of the cells and their ray geometry, as a run has them once it is set up, so runs
+ * with the same initial conditions load them instead of evaluating the setup again (setup_cache).
+ *
+ * The cache is content addressed: an entry is a directory named by a 64-bit FNV-1a hash of a key describing everything
+ * the set up cells depend on (the setup script, the grid and its processor blocks, the units, floors and the star's
+ * position, see Torch::setupKey), so runs that differ only in what they do after the setup, e.g. the star's photon rate
+ * or mass loss rate, share it. The root processor writes the key next to the files of an entry, so the entries can be
+ * told apart. Every processor writes the restart records (see RestartHeader::pack) of its core cells, after the
+ * conversion to code units, the floors and Radiation::initField, followed by their RayGeometry, to a file of its own,
+ * which a later run maps and copies out. An entry is only used if every processor finds its file and it matches its
+ * block; otherwise every processor sets its cells up as usual.
+ */
+class SetupCache {
+public:
+	SetupCache(const std::string& directory, const std::string& key);
+
+	bool load(Fluid& fluid) const;
+	void store(const Fluid& fluid) const;
+	const std::string& getEntry() const;
+
+	static std::uint64_t hash(const std::string& text);
+
+private:
+	/**
+	 * @brief The start of a processor's file, which the records and RayGeometry follow.
+	 */
+	struct FileHeader {
+		char magic[8]; //!< "TSETUP01".
+		std::uint64_t hash = 0; //!< Hash of the key.
+		std::int32_t recordSize = 0; //!< Doubles in each record (see RestartHeader::recordSize).
+		std::int32_t rayBytes = 0; //!< Bytes of each RayGeometry (0 if the Grid stores none).
+		std::int64_t ncells = 0; //!< Core cells of the processor's block.
+		std::int32_t offset[3] = {0, 0, 0}; //!< Grid coordinates of the block's first cell.
+		std::int32_t cells[3] = {0, 0, 0}; //!< Cells of the block along each dimension.
+	};
+
+	std::string m_key; //!< Description of the set up cells.
+	std::uint64_t m_hash = 0; //!< Hash of m_key.
+	std::string m_entry; //!< Directory of the entry.
+
+	std::string filename() const;
+	FileHeader makeHeader(const Fluid& fluid) const;
+};
+
+#endif // SETUPCACHE_HPP_
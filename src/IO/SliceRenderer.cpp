@@ -0,0 +1,208 @@
+#include "SliceRenderer.hpp"
+
+#include "FileManagement.hpp"
+#include "Fluid/Fluid.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+#include "Misc/Profiler.hpp"
+#include "Torch/Constants.hpp"
+#include "Torch/Converter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <zlib.h>
+
+namespace {
+
+const int NCOLOURS = 5;
+const unsigned char COLOUR_MAP[NCOLOURS][3] = {
+	{ 0, 0, 4 }, { 87, 16, 110 }, { 188, 55, 84 }, { 249, 142, 9 }, { 252, 255, 164 }
+}; //!< Control points of the colour map from the bottom of the scale to the top, black through purple and orange to yellow.
+
+/**
+ * @brief Colours a value between 0 and 1 by interpolating between the control points of the colour map.
+ */
+void colour(double f, unsigned char* rgb) {
+	f = std::max(0.0, std::min(1.0, f))*(NCOLOURS - 1);
+	const int i = std::min((int)f, NCOLOURS - 2);
+	const double w = f - i;
+	for (int c = 0; c < 3; ++c)
+		rgb[c] = (unsigned char)std::lround((1 - w)*COLOUR_MAP[i][c] + w*COLOUR_MAP[i + 1][c]);
+}
+
+/**
+ * @brief Appends a PNG chunk: its length, type, data and the CRC of its type and data.
+ */
+void appendChunk(std::string& png, const char* type, const std::string& data) {
+	const uint32_t length = data.size();
+	for (int shift = 24; shift >= 0; shift -= 8)
+		png.push_back((char)((length >> shift) & 0xff));
+	const std::string body = std::string(type, 4) + data;
+	png += body;
+	const uint32_t crc = crc32(crc32(0, Z_NULL, 0), (const Bytef*)body.data(), body.size());
+	for (int shift = 24; shift >= 0; shift -= 8)
+		png.push_back((char)((crc >> shift) & 0xff));
+}
+
+/**
+ * @brief Writes an 8 bit RGB image, rows from the top, as a PNG file.
+ */
+void writePNG(const std::string& filename, int width, int height, const std::vector<unsigned char>& rgb) {
+	// Each row starts with its filter type, 0 for none.
+	std::string rows;
+	rows.reserve((std::size_t)height*(3*width + 1));
+	for (int j = 0; j < height; ++j) {
+		rows.push_back(0);
+		rows.append((const char*)&rgb[(std::size_t)j*3*width], 3*width);
+	}
+	uLongf size = compressBound(rows.size());
+	std::string deflated(size, '\0');
+	if (compress2((Bytef*)&deflated[0], &size, (const Bytef*)rows.data(), rows.size(), 6) != Z_OK)
+		throw std::runtime_error("SliceRenderer: zlib failed to compress " + filename + ".");
+	deflated.resize(size);
+
+	std::string header;
+	for (uint32_t value : { (uint32_t)width, (uint32_t)height })
+		for (int shift = 24; shift >= 0; shift -= 8)
+			header.push_back((char)((value >> shift) & 0xff));
+	// Bit depth 8, colour type 2 (RGB), deflate, no filtering beyond the row filters, no interlacing.
+	header += std::string("\x08\x02\x00\x00\x00", 5);
+
+	std::string png("\x89PNG\r\n\x1a\n", 8);
+	appendChunk(png, "IHDR", header);
+	appendChunk(png, "IDAT", deflated);
+	appendChunk(png, "IEND", "");
+
+	std::ofstream file(filename, std::ios_base::binary);
+	if (!file)
+		throw std::runtime_error("SliceRenderer: unable to open " + filename);
+	file.write(png.data(), png.size());
+}
+
+}
+
+/**
+ * @brief Configures the frames.
+ * @param c The Constants.
+ * @param outputDirectory Directory the render directory of images is made in.
+ * @param every Number of steps between frames (0 for none).
+ * @param variables Variables to render, separated by commas or spaces, out of den, pre, hii and temperature.
+ * @exception std::runtime_error Thrown if a variable is unknown, every is negative or the Grid is 1D.
+ */
+void SliceRenderer::initialise(std::shared_ptr<Constants> c, const std::string& outputDirectory, int every, const std::string& variables) {
+	consts = std::move(c);
+	if (every < 0)
+		throw std::runtime_error("SliceRenderer::initialise: render_every(=" + std::to_string(every) + ") must not be negative.");
+	m_every = every;
+	if (m_every == 0)
+		return;
+	if (consts->nd < 2)
+		throw std::runtime_error("SliceRenderer::initialise: render_every needs a 2D or 3D grid.");
+
+	const std::vector<std::string> all = {"den", "pre", "hii", "temperature"};
+	std::string list = variables;
+	std::replace(list.begin(), list.end(), ',', ' ');
+	std::istringstream names(list);
+	m_variables.clear();
+	for (std::string name; names >> name;) {
+		if (std::find(all.begin(), all.end(), name) == all.end())
+			throw std::runtime_error("SliceRenderer::initialise: render_variables has an unknown variable [" + name + "].");
+		m_variables.push_back(name);
+	}
+	if (m_variables.empty())
+		throw std::runtime_error("SliceRenderer::initialise: render_variables is empty.");
+	m_ranges.assign(m_variables.size(), std::array<double, 2>{{ 0, 0 }});
+	m_frame = 0;
+
+	m_directory = outputDirectory + "/render";
+	if (MPIW::Instance().getRank() == 0)
+		FileManagement::makeDirectoryPath(m_directory);
+}
+
+/**
+ * @brief Whether a frame is rendered after a step.
+ */
+bool SliceRenderer::isDue(long step) const {
+	return m_every > 0 && step % m_every == 0;
+}
+
+/**
+ * @brief Renders the next frame of every variable to render/<variable>_<frame>.png. Collective.
+ * @param fluid The Fluid, whose primitive variables are up to date.
+ */
+void SliceRenderer::render(const Fluid& fluid) {
+	ScopedTimer timer(ProfileID::PRINT_RENDER);
+	const Grid& grid = fluid.getGrid();
+	const Star& star = fluid.getStar();
+	const Converter& converter = consts->converter;
+	int plane = -1;
+	if (consts->nd == 3) {
+		plane = star.on ? (int)std::floor(star.xc[2]) : grid.ncells[2]/2;
+		plane = std::max(0, std::min(grid.ncells[2] - 1, plane));
+	}
+
+	const int width = grid.ncells[0], height = grid.ncells[1];
+	const std::size_t npixels = (std::size_t)width*height;
+	const int nvars = m_variables.size();
+	std::vector<double> pixels(nvars*npixels, 0);
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		if (plane >= 0 && (int)std::floor(cell.xc[2]) != plane)
+			continue;
+		// The top row of the image is the largest y.
+		const std::size_t pixel = (std::size_t)(height - 1 - (int)std::floor(cell.xc[1]))*width + (int)std::floor(cell.xc[0]);
+		for (int iv = 0; iv < nvars; ++iv) {
+			const std::string& name = m_variables[iv];
+			double value;
+			if (name == "den")
+				value = cell.Q[UID::DEN]*converter.density().fromCode;
+			else if (name == "pre")
+				value = cell.Q[UID::PRE]*converter.pressure().fromCode;
+			else if (name == "hii")
+				value = cell.Q[UID::HII];
+			else
+				value = fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]);
+			pixels[iv*npixels + pixel] = value;
+		}
+	}
+	pixels = MPIW::Instance().sum(pixels);
+
+	const int frame = m_frame++;
+	if (MPIW::Instance().getRank() != 0)
+		return;
+	std::vector<unsigned char> rgb(3*npixels);
+	for (int iv = 0; iv < nvars; ++iv) {
+		const double* values = &pixels[iv*npixels];
+		const bool isLog = m_variables[iv] != "hii";
+		std::array<double, 2>& range = m_ranges[iv];
+		if (frame == 0) {
+			range = std::array<double, 2>{{ 0, 1 }};
+			if (isLog) {
+				double lo = std::numeric_limits<double>::max(), hi = -lo;
+				for (std::size_t i = 0; i < npixels; ++i) {
+					if (values[i] > 0) {
+						lo = std::min(lo, std::log10(values[i]));
+						hi = std::max(hi, std::log10(values[i]));
+					}
+				}
+				if (lo <= hi)
+					range = std::array<double, 2>{{ lo, hi }};
+			}
+			// A uniform first frame gets a scale a decade (or a tenth) either side of its value.
+			if (range[1] <= range[0])
+				range = std::array<double, 2>{{ range[0] - (isLog ? 1 : 0.1), range[0] + (isLog ? 1 : 0.1) }};
+		}
+		for (std::size_t i = 0; i < npixels; ++i) {
+			const double v = isLog ? (values[i] > 0 ? std::log10(values[i]) : range[0]) : values[i];
+			colour((v - range[0])/(range[1] - range[0]), &rgb[3*i]);
+		}
+		char suffix[16];
+		std::snprintf(suffix, sizeof(suffix), "_%06d.png", frame);
+		writePNG(m_directory + "/" + m_variables[iv] + suffix, width, height, rgb);
+	}
+}
@@ -0,0 +1,45 @@
+/** Provides the SliceRenderer class.
+ *
+ * @file SliceRenderer.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef SLICERENDERER_HPP_
+#define SLICERENDERER_HPP_
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Constants;
+class Fluid;
+
+/**
+ * @class SliceRenderer
+ *
+ * @brief Renders a plane of cells to a PNG image per variable every few steps, as the frames of a movie.
+ *
+ * The plane is the whole Grid in 2D and the z plane through the Star (as DataPrinter::printSlice) in 3D, one pixel per
+ * cell with x to the right and y up. Every processor rasterises its own cells into the plane, the planes are summed onto
+ * every processor in a single reduction and the root processor colours and writes them. Density, pressure and
+ * temperature are coloured on a log scale and the HII fraction on a linear one, over the range of the first frame, so
+ * every frame of a run has the same colour scale.
+ */
+class SliceRenderer {
+public:
+	void initialise(std::shared_ptr<Constants> c, const std::string& outputDirectory, int every, const std::string& variables);
+	bool isDue(long step) const;
+	void render(const Fluid& fluid);
+
+private:
+	std::shared_ptr<Constants> consts = nullptr;
+	std::string m_directory = ""; //!< Directory the images are written to.
+	int m_every = 0; //!< Number of steps between frames (0 for none).
+	std::vector<std::string> m_variables; //!< Variables rendered, in order.
+	std::vector<std::array<double, 2>> m_ranges; //!< Range of the colour scale of each variable, set by the first frame.
+	int m_frame = 0; //!< Index of the next frame.
+};
+
+#endif // SLICERENDERER_HPP_
@@ -0,0 +1,229 @@
+#include "Snapshot.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const char MAGIC[8] = {'T', 'O', 'R', 'C', 'H', 'S', 'N', 'P'};
+const int FIXED_SIZE_V1 = 8 + 8*sizeof(std::int32_t) + sizeof(std::int64_t) + 4*sizeof(double);
+const int FIXED_SIZE_V2 = FIXED_SIZE_V1 + sizeof(std::int32_t);
+const int FIXED_SIZE_V3 = FIXED_SIZE_V2 + 3*sizeof(std::int32_t);
+const int FIXED_SIZE = FIXED_SIZE_V3 + sizeof(std::int64_t) + SnapshotHeader::baseSize;
+const int VARIABLE_SIZE_V1 = 2*SnapshotHeader::labelSize;
+const int VARIABLE_SIZE = VARIABLE_SIZE_V1 + 3*sizeof(double);
+
+template <class T>
+void append(std::vector<char>& bytes, const T& value) {
+	const char* p = reinterpret_cast<const char*>(&value);
+	bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+void appendLabel(std::vector<char>& bytes, const std::string& label, int size = SnapshotHeader::labelSize) {
+	std::vector<char> padded(size, '\0');
+	std::copy_n(label.begin(), std::min<std::size_t>(label.size(), size - 1), padded.begin());
+	bytes.insert(bytes.end(), padded.begin(), padded.end());
+}
+
+template <class T>
+T extract(const char* bytes, std::size_t& pos) {
+	T value;
+	std::memcpy(&value, bytes + pos, sizeof(T));
+	pos += sizeof(T);
+	return value;
+}
+
+std::string extractLabel(const char* bytes, std::size_t& pos, int size = SnapshotHeader::labelSize) {
+	const char* start = bytes + pos;
+	pos += size;
+	return std::string(start, std::find(start, start + size, '\0'));
+}
+
+}
+
+const int SnapshotHeader::version;
+const int SnapshotHeader::labelSize;
+const int SnapshotHeader::baseSize;
+const int SnapshotHeader::blockHeaderSize;
+
+/**
+ * @brief Size of the header in bytes.
+ */
+int SnapshotHeader::size() const {
+	if (fileVersion == 1)
+		return FIXED_SIZE_V1 + VARIABLE_SIZE_V1*(int)names.size();
+	if (fileVersion == 2)
+		return FIXED_SIZE_V2 + VARIABLE_SIZE*(int)names.size();
+	if (fileVersion == 3)
+		return FIXED_SIZE_V3 + VARIABLE_SIZE*(int)names.size();
+	return FIXED_SIZE + VARIABLE_SIZE*(int)names.size();
+}
+
+/**
+ * @brief Size of each stored value in bytes.
+ */
+int SnapshotHeader::valueSize() const {
+	if (precision == SnapshotPrecision::FLOAT32)
+		return sizeof(float);
+	if (precision == SnapshotPrecision::QUANTISED)
+		return sizeof(std::uint16_t);
+	return sizeof(double);
+}
+
+/**
+ * @brief Whether the snapshot holds only the blocks of cells that changed since another snapshot.
+ */
+bool SnapshotHeader::isDelta() const {
+	return !base.empty();
+}
+
+/**
+ * @brief Column of the named variable in each row.
+ * @param name Name of the variable.
+ * @return Index of the column, or -1 if there is no such variable.
+ */
+int SnapshotHeader::column(const std::string& name) const {
+	auto it = std::find(names.begin(), names.end(), name);
+	return it != names.end() ? (int)(it - names.begin()) : -1;
+}
+
+/**
+ * @brief Decodes a value of a row.
+ * @param row Start of the row.
+ * @param column Column of the variable.
+ */
+double SnapshotHeader::value(const char* row, int column) const {
+	const char* p = row + (std::size_t)column*valueSize();
+	if (precision == SnapshotPrecision::FLOAT32) {
+		float x;
+		std::memcpy(&x, p, sizeof(x));
+		return x;
+	}
+	if (precision == SnapshotPrecision::QUANTISED) {
+		std::uint16_t q;
+		std::memcpy(&q, p, sizeof(q));
+		return offsets[column] + scales[column]*q;
+	}
+	double x;
+	std::memcpy(&x, p, sizeof(x));
+	return x;
+}
+
+/**
+ * @brief Packs the header into the bytes found at the start of a snapshot.
+ */
+std::vector<char> SnapshotHeader::serialise() const {
+	if (names.size() != units.size() || names.size() != offsets.size() || names.size() != scales.size() || names.size() != errors.size())
+		throw std::runtime_error("SnapshotHeader::serialise: every variable needs a unit, offset, scale and error.");
+	if (fileVersion != version)
+		throw std::runtime_error("SnapshotHeader::serialise: only version " + std::to_string(version) + " snapshots are written.");
+	if ((int)base.size() >= baseSize)
+		throw std::runtime_error("SnapshotHeader::serialise: base(=" + base + ") must be shorter than " + std::to_string(baseSize) + " characters.");
+	std::vector<char> bytes(MAGIC, MAGIC + 8);
+	bytes.reserve(size());
+	append<std::int32_t>(bytes, version);
+	append<std::int32_t>(bytes, size());
+	append<std::int32_t>(bytes, nd);
+	for (int i = 0; i < 3; ++i)
+		append<std::int32_t>(bytes, ncells[i]);
+	append<std::int32_t>(bytes, geometry);
+	append<std::int32_t>(bytes, (int)names.size());
+	append<std::int64_t>(bytes, nrows);
+	append<double>(bytes, time);
+	for (int i = 0; i < 3; ++i)
+		append<double>(bytes, dx[i]);
+	append<std::int32_t>(bytes, (int)precision);
+	for (int i = 0; i < 3; ++i)
+		append<std::int32_t>(bytes, offset[i]);
+	append<std::int64_t>(bytes, nblocks);
+	appendLabel(bytes, base, baseSize);
+	for (unsigned int i = 0; i < names.size(); ++i) {
+		appendLabel(bytes, names[i]);
+		appendLabel(bytes, units[i]);
+		append<double>(bytes, offsets[i]);
+		append<double>(bytes, scales[i]);
+		append<double>(bytes, errors[i]);
+	}
+	return bytes;
+}
+
+/**
+ * @brief Unpacks the header at the start of a snapshot.
+ * @param bytes Contents of the snapshot.
+ * @param nbytes Size of the snapshot.
+ * @param filename Name of the snapshot, for error messages.
+ */
+SnapshotHeader SnapshotHeader::deserialise(const char* bytes, std::size_t nbytes, const std::string& filename) {
+	if (nbytes < (std::size_t)FIXED_SIZE_V1 || !std::equal(MAGIC, MAGIC + 8, bytes))
+		throw std::runtime_error("SnapshotHeader::deserialise: " + filename + " is not a Torch snapshot.");
+	std::size_t pos = 8;
+	SnapshotHeader header;
+	header.fileVersion = extract<std::int32_t>(bytes, pos);
+	if (header.fileVersion < 1 || header.fileVersion > version)
+		throw std::runtime_error("SnapshotHeader::deserialise: " + filename + " has an unsupported snapshot version.");
+	int headerSize = extract<std::int32_t>(bytes, pos);
+
+	header.nd = extract<std::int32_t>(bytes, pos);
+	for (int i = 0; i < 3; ++i)
+		header.ncells[i] = extract<std::int32_t>(bytes, pos);
+	header.geometry = extract<std::int32_t>(bytes, pos);
+	int nvars = extract<std::int32_t>(bytes, pos);
+	header.nrows = extract<std::int64_t>(bytes, pos);
+	if (header.nrows < 0)
+		throw std::runtime_error("SnapshotHeader::deserialise: " + filename + " has a negative number of rows.");
+	header.time = extract<double>(bytes, pos);
+	for (int i = 0; i < 3; ++i)
+		header.dx[i] = extract<double>(bytes, pos);
+	const bool isV1 = header.fileVersion == 1;
+	const int fixedSize = isV1 ? FIXED_SIZE_V1 : (header.fileVersion == 2 ? FIXED_SIZE_V2 : (header.fileVersion == 3 ? FIXED_SIZE_V3 : FIXED_SIZE));
+	if (nvars < 0 || nbytes < (std::size_t)(fixedSize + (isV1 ? VARIABLE_SIZE_V1 : VARIABLE_SIZE)*nvars))
+		throw std::runtime_error("SnapshotHeader::deserialise: " + filename + " has a truncated header.");
+	if (!isV1) {
+		int precision = extract<std::int32_t>(bytes, pos);
+		if (precision < 0 || precision > (int)SnapshotPrecision::QUANTISED)
+			throw std::runtime_error("SnapshotHeader::deserialise: " + filename + " has an unknown precision.");
+		header.precision = (SnapshotPrecision)precision;
+	}
+	if (header.fileVersion > 2) {
+		for (int i = 0; i < 3; ++i)
+			header.offset[i] = extract<std::int32_t>(bytes, pos);
+	}
+	if (header.fileVersion > 3) {
+		header.nblocks = extract<std::int64_t>(bytes, pos);
+		header.base = extractLabel(bytes, pos, baseSize);
+		if (header.nblocks < 0)
+			throw std::runtime_error("SnapshotHeader::deserialise: " + filename + " has a negative number of blocks.");
+		if (header.nblocks > 0 && header.base.empty())
+			throw std::runtime_error("SnapshotHeader::deserialise: " + filename + " has blocks but no snapshot they apply to.");
+	}
+	for (int i = 0; i < nvars; ++i) {
+		header.names.push_back(extractLabel(bytes, pos));
+		header.units.push_back(extractLabel(bytes, pos));
+		header.offsets.push_back(isV1 ? 0 : extract<double>(bytes, pos));
+		header.scales.push_back(isV1 ? 1 : extract<double>(bytes, pos));
+		header.errors.push_back(isV1 ? 0 : extract<double>(bytes, pos));
+	}
+
+	if (header.size() != headerSize)
+		throw std::runtime_error("SnapshotHeader::deserialise: " + filename + " has an inconsistent header size.");
+	// The blocks and rows are checked against the bytes left for them by division, so corrupt counts cannot overflow the
+	// sizes.
+	const std::size_t headerBytes = (std::size_t)header.size();
+	const std::size_t rowBytes = (std::size_t)nvars*header.valueSize();
+	if (nbytes < headerBytes || (std::size_t)header.nblocks > (nbytes - headerBytes)/blockHeaderSize)
+		throw std::runtime_error("SnapshotHeader::deserialise: " + filename + " is truncated.");
+	const std::size_t dataBytes = nbytes - headerBytes - (std::size_t)header.nblocks*blockHeaderSize;
+	if (rowBytes > 0 && (std::size_t)header.nrows > dataBytes/rowBytes)
+		throw std::runtime_error("SnapshotHeader::deserialise: " + filename + " is truncated.");
+	return header;
+}
+
+/**
+ * @brief Whether a file name has the binary snapshot extension, .tsnp.
+ */
+bool SnapshotHeader::isSnapshot(const std::string& filename) {
+	const std::string ext = ".tsnp";
+	return filename.size() >= ext.size() && filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
+}
@@ -0,0 +1,91 @@
+/** Provides the SnapshotHeader class.
+ *
+ * @file Snapshot.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef SNAPSHOT_HPP_
+#define SNAPSHOT_HPP_
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "Torch/Common.hpp"
+
+/**
+ * @class SnapshotHeader
+ *
+ * @brief Describes the layout of a binary snapshot (.tsnp) file.
+ *
+ * A snapshot is the header followed by one row of nvars values per grid cell, in cgs units. The rows are in the order
+ * of the cells' grid coordinates, x fastest, so the coordinates are not stored: the centre of the cell of row
+ * i + ncells[0]*(j + ncells[1]*k) is ((i + 0.5)*dx[0], (j + 0.5)*dx[1], (k + 0.5)*dx[2]). The values are stored as
+ * native doubles, floats or unsigned 16 bit integers (see SnapshotPrecision), and each variable declares the largest
+ * absolute difference between its stored and simulated values. The header, in native byte order, is:
+ * - char[8]    "TORCHSNP"
+ * - int32      format version
+ * - int32      header size in bytes (the offset of the first row)
+ * - int32      number of dimensions
+ * - int32[3]   number of cells along each dimension
+ * - int32      geometry (the value of the Geometry enum)
+ * - int32      number of variables per row
+ * - int64      number of rows
+ * - float64    time (s)
+ * - float64[3] cell widths (cm)
+ * - int32      precision (the value of the SnapshotPrecision enum)
+ * - int32[3]   grid coordinates of the first cell in the grid of the run, which is not 0 for a region of the grid
+ * - int64      number of blocks of a delta snapshot (0 for a full one)
+ * - char[64]   name of the snapshot a delta snapshot applies to, in the same directory (empty for a full one)
+ * - char[16] name, char[16] unit, float64 offset, float64 scale and float64 error of each variable, where the value is
+ *   offset + scale*q for a stored integer q, and error is the largest absolute error of the stored values
+ *
+ * A delta snapshot holds only some blocks of cells, those that changed since the snapshot it applies to, which may be a
+ * delta itself (see DeltaSnapshotWriter). Each block is an int32[3] of the grid coordinates of its first cell and an
+ * int32[3] of its cells along each dimension, followed by its rows, x fastest; nrows counts the rows of every block.
+ * SnapshotReader reconstructs the full snapshot.
+ *
+ * Version 3 snapshots, which are still read, are full snapshots.
+ * Version 2 snapshots, which are still read, have no grid coordinates of the first cell (they are all 0).
+ * Version 1 snapshots, which are still read, store native doubles, have no precision or per variable offset, scale and
+ * error, and hold the rows of each processor in rank order with the cell centres as their first nd variables.
+ *
+ * @see BinarySnapshotWriter::write
+ * @see DataReader::readSnapshot
+ */
+class SnapshotHeader {
+public:
+	static const int version = 4;
+	static const int labelSize = 16; //!< Bytes reserved for each variable name and unit.
+	static const int baseSize = 64; //!< Bytes reserved for the name of the snapshot a delta applies to.
+	static const int blockHeaderSize = 6*4; //!< Bytes before the rows of each block of a delta snapshot.
+
+	int fileVersion = version; //!< Format version of the file the header was read from.
+	double time = 0;
+	int nd = 0;
+	std::array<int, 3> ncells = std::array<int, 3>{{ 1, 1, 1 }};
+	int geometry = 0;
+	long long nrows = 0;
+	std::array<double, 3> dx = std::array<double, 3>{{ 0, 0, 0 }};
+	std::array<int, 3> offset = std::array<int, 3>{{ 0, 0, 0 }}; //!< Grid coordinates of the first cell in the grid of the run.
+	SnapshotPrecision precision = SnapshotPrecision::FLOAT64; //!< How the values are stored.
+	long long nblocks = 0; //!< Blocks of cells of a delta snapshot (0 for a full one).
+	std::string base; //!< Name of the snapshot a delta snapshot applies to (empty for a full one).
+	std::vector<std::string> names; //!< Name of each variable, e.g. "den".
+	std::vector<std::string> units; //!< cgs unit of each variable, e.g. "g cm^-3".
+	std::vector<double> offsets; //!< Value of each QUANTISED variable stored as 0.
+	std::vector<double> scales; //!< Difference between the values of each QUANTISED variable stored as consecutive integers.
+	std::vector<double> errors; //!< Largest absolute error of the stored values of each variable.
+
+	int size() const;
+	int valueSize() const;
+	bool isDelta() const;
+	int column(const std::string& name) const;
+	double value(const char* row, int column) const;
+	std::vector<char> serialise() const;
+	static SnapshotHeader deserialise(const char* bytes, std::size_t nbytes, const std::string& filename);
+	static bool isSnapshot(const std::string& filename);
+};
+
+#endif // SNAPSHOT_HPP_
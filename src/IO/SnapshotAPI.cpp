@@ -0,0 +1,80 @@
+#include "SnapshotAPI.h"
+
+#include "SnapshotReader.hpp"
+
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+struct TorchSnapshot {
+	explicit TorchSnapshot(const std::string& filename) : reader(filename) { }
+	SnapshotReader reader;
+};
+
+namespace {
+
+thread_local std::string lastError;
+
+/**
+ * @brief Runs a call of the interface, keeping an exception for torchsnap_error instead of letting it through to C.
+ * @return 0, or -1 if the call threw.
+ */
+template <class Call>
+int guard(const char* name, Call call) {
+	try {
+		call();
+		return 0;
+	}
+	catch (std::exception& e) {
+		lastError = std::string(name) + ": " + e.what();
+		return -1;
+	}
+}
+
+}
+
+TorchSnapshot* torchsnap_open(const char* filename) {
+	std::unique_ptr<TorchSnapshot> snapshot;
+	guard("torchsnap_open", [&]() { snapshot.reset(new TorchSnapshot(filename)); });
+	return snapshot.release();
+}
+
+void torchsnap_close(TorchSnapshot* snapshot) {
+	delete snapshot;
+}
+
+const char* torchsnap_error(void) {
+	return lastError.c_str();
+}
+
+void torchsnap_grid(const TorchSnapshot* snapshot, int* nd, int ncells[3], int offset[3], int* geometry, int* nvars, double* time,
+		double dx[3]) {
+	const SnapshotHeader& header = snapshot->reader.header();
+	*nd = header.nd;
+	*geometry = header.geometry;
+	*nvars = (int)header.names.size();
+	*time = header.time;
+	for (int i = 0; i < 3; ++i) {
+		ncells[i] = header.ncells[i];
+		offset[i] = header.offset[i];
+		dx[i] = header.dx[i];
+	}
+}
+
+int torchsnap_variable(const TorchSnapshot* snapshot, int variable, const char** name, const char** unit, double* error) {
+	return guard("torchsnap_variable", [&]() {
+		const SnapshotHeader& header = snapshot->reader.header();
+		if (variable < 0 || variable >= (int)header.names.size())
+			throw std::runtime_error("variable(=" + std::to_string(variable) + ") is out of range.");
+		*name = header.names[variable].c_str();
+		*unit = header.units[variable].c_str();
+		*error = header.errors[variable];
+	});
+}
+
+int torchsnap_read(const TorchSnapshot* snapshot, int variable, const int lo[3], const int hi[3], double* values) {
+	return guard("torchsnap_read", [&]() {
+		snapshot->reader.readBox(variable, std::array<int, 3>{{ lo[0], lo[1], lo[2] }}, std::array<int, 3>{{ hi[0], hi[1], hi[2] }}, values);
+	});
+}
@@ -0,0 +1,49 @@
+/** Provides the C interface of the snapshot library, libtorchsnap, for analysis programs (see scripts/torchpack/snapshot.py).
+ *
+ * @file SnapshotAPI.h
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef SNAPSHOTAPI_H_
+#define SNAPSHOTAPI_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief A binary snapshot (.tsnp) mapped into memory, whose values are only read from the file when asked for. A delta
+ * snapshot is reconstructed in memory when it is opened.
+ *
+ * The functions returning int return 0 on success and -1 on failure, whose reason torchsnap_error gives.
+ */
+typedef struct TorchSnapshot TorchSnapshot;
+
+/** Maps a snapshot (NULL on failure). */
+TorchSnapshot* torchsnap_open(const char* filename);
+/** Unmaps a snapshot. */
+void torchsnap_close(TorchSnapshot* snapshot);
+/** Reason for the last failure of the calling thread. */
+const char* torchsnap_error(void);
+
+/**
+ * Grid of a snapshot: its number of dimensions, cells along each dimension, grid coordinates of its first cell in the
+ * grid of the run (not 0 for a region output), geometry (0 cartesian, 1 cylindrical, 2 spherical), variables per cell,
+ * time (s) and cell widths (cm).
+ */
+void torchsnap_grid(const TorchSnapshot* snapshot, int* nd, int ncells[3], int offset[3], int* geometry, int* nvars, double* time,
+		double dx[3]);
+/** Name, cgs unit and largest absolute storage error of a variable, in [0, nvars). */
+int torchsnap_variable(const TorchSnapshot* snapshot, int variable, const char** name, const char** unit, double* error);
+/**
+ * Decodes a variable of the box of cells [lo, hi) into values, x fastest, only reading the rows of the box. The
+ * bounds along the dimensions the snapshot does not have are 0 and 1.
+ */
+int torchsnap_read(const TorchSnapshot* snapshot, int variable, const int lo[3], const int hi[3], double* values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SNAPSHOTAPI_H_
@@ -0,0 +1,130 @@
+#include "SnapshotReader.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+/**
+ * @param filename Name of the snapshot.
+ * @exception std::runtime_error Thrown if the file cannot be mapped or is not a valid snapshot.
+ */
+SnapshotReader::SnapshotReader(const std::string& filename)
+: m_filename(filename)
+, m_file(filename)
+, m_header(SnapshotHeader::deserialise(m_file.data(), m_file.size(), filename))
+, m_rowSize(m_header.names.size()*m_header.valueSize())
+, m_data(m_file.data() + m_header.size())
+{
+	if (m_header.isDelta())
+		reconstruct();
+}
+
+/**
+ * @brief Rebuilds the rows of a delta snapshot from the snapshot it applies to, reconstructed in turn if it is a delta,
+ * and the blocks of this one.
+ * @exception std::runtime_error Thrown if the snapshot it applies to does not have the same grid and variables, or a
+ * block lies outside the grid.
+ */
+void SnapshotReader::reconstruct() {
+	const std::size_t slash = m_filename.find_last_of('/');
+	const std::string baseName = (slash == std::string::npos ? "" : m_filename.substr(0, slash + 1)) + m_header.base;
+	SnapshotReader base(baseName);
+	const SnapshotHeader& baseHeader = base.header();
+	if (!base.isGridOrder() || baseHeader.ncells != m_header.ncells || baseHeader.names != m_header.names ||
+			baseHeader.precision != m_header.precision)
+		throw std::runtime_error("SnapshotReader::reconstruct: " + m_filename + " does not have the grid and variables of " + baseName + ".");
+	const long long nrows = (long long)m_header.ncells[0]*m_header.ncells[1]*m_header.ncells[2];
+	if (base.m_rows.empty())
+		m_rows.assign(base.m_data, base.m_data + nrows*m_rowSize);
+	else
+		m_rows = std::move(base.m_rows);
+
+	const char* p = m_data;
+	long long nstored = 0;
+	for (long long iblock = 0; iblock < m_header.nblocks; ++iblock) {
+		std::int32_t lo[3], n[3];
+		std::memcpy(lo, p, sizeof(lo));
+		std::memcpy(n, p + sizeof(lo), sizeof(n));
+		p += SnapshotHeader::blockHeaderSize;
+		for (int idim = 0; idim < 3; ++idim) {
+			if (lo[idim] < 0 || n[idim] < 1 || lo[idim] + n[idim] > m_header.ncells[idim])
+				throw std::runtime_error("SnapshotReader::reconstruct: block " + std::to_string(iblock) + " of " + m_filename + " is outside the grid.");
+		}
+		nstored += (long long)n[0]*n[1]*n[2];
+		if (nstored > m_header.nrows)
+			throw std::runtime_error("SnapshotReader::reconstruct: " + m_filename + " has more rows in its blocks than its header.");
+		for (int k = lo[2]; k < lo[2] + n[2]; ++k)
+			for (int j = lo[1]; j < lo[1] + n[1]; ++j) {
+				const long long irow = lo[0] + m_header.ncells[0]*(j + (long long)m_header.ncells[1]*k);
+				std::memcpy(m_rows.data() + irow*m_rowSize, p, n[0]*m_rowSize);
+				p += n[0]*m_rowSize;
+			}
+	}
+	m_header.nrows = nrows;
+	m_header.nblocks = 0;
+	m_header.base.clear();
+	m_data = m_rows.data();
+}
+
+const SnapshotHeader& SnapshotReader::header() const {
+	return m_header;
+}
+
+const std::string& SnapshotReader::filename() const {
+	return m_filename;
+}
+
+/**
+ * @brief Whether the rows are in x-fastest order of the grid coordinates, which version 1 snapshots are not.
+ */
+bool SnapshotReader::isGridOrder() const {
+	return m_header.fileVersion > 1;
+}
+
+/**
+ * @brief Start of a row, to decode with SnapshotHeader::value.
+ * @param irow Index of the row.
+ */
+const char* SnapshotReader::row(long long irow) const {
+	return m_data + irow*m_rowSize;
+}
+
+/**
+ * @brief Start of the row of the cell at some grid coordinates, in a snapshot in grid order.
+ * @param xc Grid coordinates of the cell, 0 along the dimensions the snapshot does not have.
+ */
+const char* SnapshotReader::row(const std::array<int, 3>& xc) const {
+	long long irow = 0;
+	for (int idim = 2; idim >= 0; --idim)
+		irow = irow*m_header.ncells[idim] + xc[idim];
+	return row(irow);
+}
+
+/**
+ * @brief Decodes the values of a variable in the box of cells [lo, hi), x fastest.
+ * @param column Column of the variable (see SnapshotHeader::column).
+ * @param lo Grid coordinates of the first cell of the box.
+ * @param hi Grid coordinates one past the last cell of the box, 1 along the dimensions the snapshot does not have.
+ * @param values Space for (hi[0] - lo[0])*(hi[1] - lo[1])*(hi[2] - lo[2]) values.
+ * @exception std::runtime_error Thrown if the rows are not in grid order, or the column or box is out of range.
+ */
+void SnapshotReader::readBox(int column, const std::array<int, 3>& lo, const std::array<int, 3>& hi, double* values) const {
+	if (!isGridOrder())
+		throw std::runtime_error("SnapshotReader::readBox: " + m_filename + " is a version 1 snapshot, whose rows are not in grid order.");
+	if (column < 0 || column >= (int)m_header.names.size())
+		throw std::runtime_error("SnapshotReader::readBox: column(=" + std::to_string(column) + ") is out of range.");
+	for (int idim = 0; idim < 3; ++idim) {
+		if (lo[idim] < 0 || hi[idim] > m_header.ncells[idim] || lo[idim] >= hi[idim])
+			throw std::runtime_error("SnapshotReader::readBox: box is outside the " + std::to_string(m_header.ncells[0]) + "x" +
+					std::to_string(m_header.ncells[1]) + "x" + std::to_string(m_header.ncells[2]) + " cells of " + m_filename + ".");
+	}
+	std::size_t i = 0;
+	std::array<int, 3> xc;
+	for (xc[2] = lo[2]; xc[2] < hi[2]; ++xc[2])
+		for (xc[1] = lo[1]; xc[1] < hi[1]; ++xc[1]) {
+			xc[0] = lo[0];
+			const char* first = row(xc);
+			for (int n = 0; n < hi[0] - lo[0]; ++n)
+				values[i++] = m_header.value(first + n*m_rowSize, column);
+		}
+}
@@ -0,0 +1,54 @@
+/** Provides the SnapshotReader class.
+ *
+ * @file SnapshotReader.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef SNAPSHOTREADER_HPP_
+#define SNAPSHOTREADER_HPP_
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "Snapshot.hpp"
+
+/**
+ * @class SnapshotReader
+ *
+ * @brief Maps a binary snapshot into memory and decodes the rows, or a box of one variable, without reading the rest of
+ * the file.
+ *
+ * A delta snapshot is reconstructed when it is opened, from the snapshots it builds on back to the last full one, and
+ * then reads as that full snapshot, its header holding every row and no blocks.
+ *
+ * Shared by DataReader, which copies out the rows of each processor's cells, and the snapshot library that the Python
+ * analysis scripts call (see SnapshotAPI.h).
+ *
+ * @see SnapshotHeader
+ */
+class SnapshotReader {
+public:
+	explicit SnapshotReader(const std::string& filename);
+
+	const SnapshotHeader& header() const;
+	const std::string& filename() const;
+	bool isGridOrder() const;
+	const char* row(long long irow) const;
+	const char* row(const std::array<int, 3>& xc) const;
+	void readBox(int column, const std::array<int, 3>& lo, const std::array<int, 3>& hi, double* values) const;
+
+private:
+	std::string m_filename;
+	MappedFile m_file;
+	SnapshotHeader m_header;
+	std::size_t m_rowSize = 0; //!< Bytes in a row.
+	std::vector<char> m_rows; //!< Rows of a reconstructed delta snapshot (empty for a full one).
+	const char* m_data = nullptr; //!< Start of the rows.
+
+	void reconstruct();
+};
+
+#endif // SNAPSHOTREADER_HPP_
@@ -0,0 +1,396 @@
+#include "SnapshotWriter.hpp"
+#include "OutputStaging.hpp"
+#include "Snapshot.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef TORCH_HDF5
+#include <hdf5.h>
+#endif
+
+namespace {
+
+/**
+ * @brief The header of a full snapshot of the fields, with no offsets, scales or errors yet.
+ */
+SnapshotHeader headerOf(const SnapshotFields& fields, SnapshotPrecision precision) {
+	SnapshotHeader header;
+	header.time = fields.time;
+	header.nd = fields.nd;
+	header.ncells = fields.ncells;
+	header.offset = fields.origin;
+	header.geometry = fields.geometry;
+	header.nrows = (long long)fields.ncells[0]*fields.ncells[1]*fields.ncells[2];
+	header.dx = fields.dx;
+	header.precision = precision;
+	header.names = fields.names;
+	header.units = fields.units;
+	return header;
+}
+
+template <class T>
+void append(std::vector<char>& bytes, const T& value) {
+	const char* p = reinterpret_cast<const char*>(&value);
+	bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+}
+
+BinarySnapshotWriter::BinarySnapshotWriter(SnapshotPrecision precision) : m_precision(precision) {}
+
+std::string BinarySnapshotWriter::extension() const {
+	return ".tsnp";
+}
+
+/**
+ * @brief Writes the fields to a binary snapshot, which all processors write at once.
+ *
+ * FLOAT32 values are rounded to the nearest float and QUANTISED values to the nearest of 65536 levels spread evenly over
+ * each variable's range, and the largest error of each variable is written to the header.
+ * @param filename Name of the file.
+ * @param fields This processor's box of cells.
+ * @see SnapshotHeader
+ */
+void BinarySnapshotWriter::write(const std::string& filename, const SnapshotFields& fields) const {
+	MPIW& mpihandler = MPIW::Instance();
+	SnapshotHeader header = headerOf(fields, m_precision);
+
+	const int nvars = (int)fields.names.size();
+	const std::vector<double>& data = fields.values;
+	header.offsets.assign(nvars, 0);
+	header.scales.assign(nvars, 1);
+	std::vector<double> errors(nvars, 0);
+	std::vector<char> bytes(data.size()*header.valueSize());
+	if (m_precision == SnapshotPrecision::FLOAT64)
+		std::memcpy(bytes.data(), data.data(), bytes.size());
+	else if (m_precision == SnapshotPrecision::FLOAT32) {
+		for (std::size_t i = 0; i < data.size(); ++i) {
+			const float x = (float)data[i];
+			std::memcpy(bytes.data() + i*sizeof(float), &x, sizeof(float));
+			errors[i%nvars] = std::max(errors[i%nvars], std::abs(data[i] - x));
+		}
+	}
+	else {
+		std::vector<double> lo(nvars, std::numeric_limits<double>::max()), hi(nvars, std::numeric_limits<double>::lowest());
+		for (std::size_t i = 0; i < data.size(); ++i) {
+			lo[i%nvars] = std::min(lo[i%nvars], data[i]);
+			hi[i%nvars] = std::max(hi[i%nvars], data[i]);
+		}
+		lo = mpihandler.minimum(lo);
+		hi = mpihandler.maximum(hi);
+		const double levels = std::numeric_limits<std::uint16_t>::max();
+		for (int ivar = 0; ivar < nvars; ++ivar) {
+			header.offsets[ivar] = lo[ivar];
+			header.scales[ivar] = (hi[ivar] - lo[ivar])/levels;
+		}
+		for (std::size_t i = 0; i < data.size(); ++i) {
+			const int ivar = i%nvars;
+			const double scaled = header.scales[ivar] > 0 ? (data[i] - lo[ivar])/header.scales[ivar] : 0;
+			const std::uint16_t q = (std::uint16_t)std::min(levels, std::max(0.0, std::round(scaled)));
+			std::memcpy(bytes.data() + i*sizeof(q), &q, sizeof(q));
+			errors[ivar] = std::max(errors[ivar], std::abs(data[i] - (header.offsets[ivar] + header.scales[ivar]*q)));
+		}
+	}
+	header.errors = mpihandler.maximum(errors);
+
+	if (fields.isRegion)
+		mpihandler.writeRegion(filename, header.serialise(), bytes.data(), nvars*header.valueSize(), fields.ncells,
+				fields.boxCells, fields.boxOffset);
+	else
+		OutputStaging::Instance().writeBox(filename, header.serialise(), bytes.data(), nvars*header.valueSize(), fields.ncells,
+				fields.boxCells, fields.boxOffset);
+}
+
+const int DeltaSnapshotWriter::BLOCK;
+
+/**
+ * @param precision Storage of the values, FLOAT64 or FLOAT32.
+ * @param keyframeEvery Snapshots from one keyframe to the next (1 for every snapshot in full).
+ * @param tolerance Largest change of a value, relative to the largest magnitude of its variable on the grid, that is
+ * left out of the deltas (0 to write every change).
+ * @exception std::runtime_error Thrown if keyframeEvery is less than 1, tolerance is negative or precision is QUANTISED.
+ */
+DeltaSnapshotWriter::DeltaSnapshotWriter(SnapshotPrecision precision, int keyframeEvery, double tolerance)
+	: m_keyframes(precision)
+	, m_precision(precision)
+	, m_keyframeEvery(keyframeEvery)
+	, m_tolerance(tolerance)
+{
+	if (keyframeEvery < 1)
+		throw std::runtime_error("DeltaSnapshotWriter::DeltaSnapshotWriter: snapshot_keyframe_every(=" + std::to_string(keyframeEvery) + ") must be at least 1.");
+	if (tolerance < 0)
+		throw std::runtime_error("DeltaSnapshotWriter::DeltaSnapshotWriter: snapshot_delta_tolerance(=" + std::to_string(tolerance) + ") must not be negative.");
+	if (precision == SnapshotPrecision::QUANTISED)
+		throw std::runtime_error("DeltaSnapshotWriter::DeltaSnapshotWriter: delta snapshots are stored as float64 or float32, not quantised.");
+}
+
+std::string DeltaSnapshotWriter::extension() const {
+	return ".tsnp";
+}
+
+/**
+ * @brief The value as it is stored.
+ */
+double DeltaSnapshotWriter::stored(double value) const {
+	return m_precision == SnapshotPrecision::FLOAT32 ? (double)(float)value : value;
+}
+
+/**
+ * @brief Writes the next snapshot of the series, a keyframe or a delta from the previous snapshot. Collective.
+ * @param filename Name of the file, in the same directory as the rest of the series.
+ * @param fields This processor's box of cells.
+ * @exception std::runtime_error Thrown if the fields are of a region.
+ */
+void DeltaSnapshotWriter::write(const std::string& filename, const SnapshotFields& fields) const {
+	if (fields.isRegion)
+		throw std::runtime_error("DeltaSnapshotWriter::write: regions are written in full.");
+	MPIW& mpihandler = MPIW::Instance();
+	const std::size_t slash = filename.find_last_of('/');
+	const std::string name = (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+	double boxChanged = (fields.boxCells != m_boxCells || fields.boxOffset != m_boxOffset || fields.values.size() != m_stored.size()) ? 1 : 0;
+	boxChanged = mpihandler.maximum(boxChanged);
+	if (m_sinceKeyframe == 0 || m_sinceKeyframe >= m_keyframeEvery || boxChanged > 0) {
+		m_keyframes.write(filename, fields);
+		m_stored.resize(fields.values.size());
+		for (std::size_t i = 0; i < fields.values.size(); ++i)
+			m_stored[i] = stored(fields.values[i]);
+		m_boxCells = fields.boxCells;
+		m_boxOffset = fields.boxOffset;
+		m_previous = name;
+		m_sinceKeyframe = 1;
+		return;
+	}
+
+	const int nvars = (int)fields.names.size();
+	const std::array<int, 3>& box = fields.boxCells;
+	std::array<int, 3> nblocks;
+	for (int idim = 0; idim < 3; ++idim)
+		nblocks[idim] = (box[idim] + BLOCK - 1)/BLOCK;
+	std::vector<double> thresholds(nvars, 0);
+	for (std::size_t i = 0; i < fields.values.size(); ++i)
+		thresholds[i%nvars] = std::max(thresholds[i%nvars], std::abs(fields.values[i]));
+	thresholds = mpihandler.maximum(thresholds);
+	for (double& threshold : thresholds)
+		threshold *= m_tolerance;
+	std::vector<char> bytes;
+	double counts[2] = {0, 0}; // Blocks and rows written.
+	for (int b = 0; b < nblocks[0]*nblocks[1]*nblocks[2]; ++b) {
+		const std::array<int, 3> lo = {{ BLOCK*(b%nblocks[0]), BLOCK*((b/nblocks[0])%nblocks[1]), BLOCK*(b/(nblocks[0]*nblocks[1])) }};
+		std::array<int, 3> n;
+		for (int idim = 0; idim < 3; ++idim)
+			n[idim] = std::min(BLOCK, box[idim] - lo[idim]);
+		// The values of each row of the block, [first, last) of fields.values.
+		std::vector<std::pair<std::size_t, std::size_t>> rows;
+		for (int k = lo[2]; k < lo[2] + n[2]; ++k)
+			for (int j = lo[1]; j < lo[1] + n[1]; ++j) {
+				const std::size_t first = (((std::size_t)k*box[1] + j)*box[0] + lo[0])*nvars;
+				rows.push_back(std::make_pair(first, first + (std::size_t)n[0]*nvars));
+			}
+
+		bool changed = false;
+		for (std::size_t r = 0; r < rows.size() && !changed; ++r)
+			for (std::size_t i = rows[r].first; i < rows[r].second && !changed; ++i) {
+				const double x = stored(fields.values[i]);
+				changed = !(std::abs(x - m_stored[i]) <= thresholds[i%nvars]);
+			}
+		if (!changed)
+			continue;
+
+		for (int idim = 0; idim < 3; ++idim)
+			append<std::int32_t>(bytes, fields.boxOffset[idim] + lo[idim]);
+		for (int idim = 0; idim < 3; ++idim)
+			append<std::int32_t>(bytes, n[idim]);
+		for (const auto& row : rows)
+			for (std::size_t i = row.first; i < row.second; ++i) {
+				m_stored[i] = stored(fields.values[i]);
+				if (m_precision == SnapshotPrecision::FLOAT32)
+					append<float>(bytes, (float)fields.values[i]);
+				else
+					append<double>(bytes, fields.values[i]);
+			}
+		counts[0] += 1;
+		counts[1] += n[0]*n[1]*n[2];
+	}
+
+	SnapshotHeader header = headerOf(fields, m_precision);
+	const std::vector<double> totals = mpihandler.sum(std::vector<double>(counts, counts + 2));
+	header.nblocks = (long long)totals[0];
+	header.nrows = (long long)totals[1];
+	header.base = m_previous;
+	header.offsets.assign(nvars, 0);
+	header.scales.assign(nvars, 1);
+	std::vector<double> errors(nvars, 0);
+	for (std::size_t i = 0; i < fields.values.size(); ++i)
+		errors[i%nvars] = std::max(errors[i%nvars], std::abs(fields.values[i] - m_stored[i]));
+	header.errors = mpihandler.maximum(errors);
+	OutputStaging::Instance().writeOrdered(filename, header.serialise(), bytes.data(), (int)bytes.size());
+	m_previous = name;
+	++m_sinceKeyframe;
+}
+
+#ifdef TORCH_HDF5
+namespace {
+
+hid_t checked(hid_t id, const std::string& what) {
+	if (id < 0)
+		throw std::runtime_error("HDF5SnapshotWriter::write: unable to " + what + ".");
+	return id;
+}
+
+void writeAttribute(hid_t loc, const char* name, hid_t type, const void* data, hsize_t n) {
+	hid_t space = checked(n == 1 ? H5Screate(H5S_SCALAR) : H5Screate_simple(1, &n, NULL), "create the dataspace of " + std::string(name));
+	hid_t attr = checked(H5Acreate2(loc, name, type, space, H5P_DEFAULT, H5P_DEFAULT), "create attribute " + std::string(name));
+	checked(H5Awrite(attr, type, data), "write attribute " + std::string(name));
+	H5Aclose(attr);
+	H5Sclose(space);
+}
+
+void writeAttribute(hid_t loc, const char* name, const std::string& text) {
+	hid_t type = H5Tcopy(H5T_C_S1);
+	H5Tset_size(type, std::max<std::size_t>(text.size(), 1));
+	writeAttribute(loc, name, type, text.empty() ? " " : text.c_str(), 1);
+	H5Tclose(type);
+}
+
+/**
+ * @brief Creates the attributes of the file and an empty dataset for every variable.
+ */
+void createLayout(hid_t file, const SnapshotFields& fields, SnapshotPrecision precision, int compressionLevel) {
+	int ncells[3], geometry = fields.geometry, nd = fields.nd;
+	hsize_t dims[3], chunk[3];
+	// Chunks of about 64k cells, with the same number along each simulated dimension.
+	const int side = std::max(1, (int)std::pow(65536.0, 1.0/std::max(1, fields.nd)));
+	for (int i = 0; i < 3; ++i) {
+		ncells[i] = fields.ncells[i];
+		dims[2 - i] = fields.ncells[i];
+		chunk[2 - i] = (i < fields.nd) ? std::min(fields.ncells[i], side) : 1;
+	}
+	writeAttribute(file, "time", H5T_NATIVE_DOUBLE, &fields.time, 1);
+	writeAttribute(file, "nd", H5T_NATIVE_INT, &nd, 1);
+	writeAttribute(file, "ncells", H5T_NATIVE_INT, ncells, 3);
+	writeAttribute(file, "dx", H5T_NATIVE_DOUBLE, fields.dx.data(), 3);
+	writeAttribute(file, "geometry", H5T_NATIVE_INT, &geometry, 1);
+
+	hid_t space = checked(H5Screate_simple(3, dims, NULL), "create the dataspace of the datasets");
+	hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_chunk(dcpl, 3, chunk);
+	if (compressionLevel > 0)
+		H5Pset_deflate(dcpl, compressionLevel);
+	const hid_t type = (precision == SnapshotPrecision::FLOAT32) ? H5T_IEEE_F32LE : H5T_IEEE_F64LE;
+	for (std::size_t ivar = 0; ivar < fields.names.size(); ++ivar) {
+		hid_t dset = checked(H5Dcreate2(file, fields.names[ivar].c_str(), type, space, H5P_DEFAULT, dcpl, H5P_DEFAULT),
+				"create dataset " + fields.names[ivar]);
+		writeAttribute(dset, "unit", fields.units[ivar]);
+		H5Dclose(dset);
+	}
+	H5Pclose(dcpl);
+	H5Sclose(space);
+}
+
+/**
+ * @brief Writes this processor's box of every variable into its dataset.
+ * @param dxpl Transfer property list of the writes.
+ */
+void writeBoxes(hid_t file, const SnapshotFields& fields, hid_t dxpl) {
+	hsize_t start[3], count[3];
+	for (int i = 0; i < 3; ++i) {
+		start[2 - i] = fields.boxOffset[i];
+		count[2 - i] = fields.boxCells[i];
+	}
+	const std::size_t nvars = fields.names.size();
+	const std::size_t nbox = (std::size_t)fields.boxCells[0]*fields.boxCells[1]*fields.boxCells[2];
+	std::vector<double> column(nbox);
+	hid_t memspace = checked(H5Screate_simple(3, count, NULL), "create the dataspace of the box");
+	for (std::size_t ivar = 0; ivar < nvars; ++ivar) {
+		for (std::size_t icell = 0; icell < nbox; ++icell)
+			column[icell] = fields.values[icell*nvars + ivar];
+		hid_t dset = checked(H5Dopen2(file, fields.names[ivar].c_str(), H5P_DEFAULT), "open dataset " + fields.names[ivar]);
+		hid_t filespace = H5Dget_space(dset);
+		H5Sselect_hyperslab(filespace, H5S_SELECT_SET, start, NULL, count, NULL);
+		checked(H5Dwrite(dset, H5T_NATIVE_DOUBLE, memspace, filespace, dxpl, column.data()), "write dataset " + fields.names[ivar]);
+		H5Sclose(filespace);
+		H5Dclose(dset);
+	}
+	H5Sclose(memspace);
+}
+
+}
+
+HDF5SnapshotWriter::HDF5SnapshotWriter(SnapshotPrecision precision, int compressionLevel)
+	: m_precision(precision)
+	, m_compressionLevel(compressionLevel)
+{}
+
+std::string HDF5SnapshotWriter::extension() const {
+	return ".h5";
+}
+
+/**
+ * @brief Writes the fields to an HDF5 file.
+ * @param filename Name of the file.
+ * @param fields This processor's box of cells.
+ */
+void HDF5SnapshotWriter::write(const std::string& filename, const SnapshotFields& fields) const {
+#ifdef H5_HAVE_PARALLEL
+	// Collective buffering gathers the boxes into a few large contiguous writes.
+	MPI_Info info;
+	MPI_Info_create(&info);
+	MPI_Info_set(info, (char*)"romio_cb_write", (char*)"enable");
+	hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+	H5Pset_fapl_mpio(fapl, MPI_Comm_f2c(MPIW::Instance().communicator()), info);
+	hid_t file = checked(H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl), "create " + filename);
+	createLayout(file, fields, m_precision, m_compressionLevel);
+	hid_t dxpl = H5Pcreate(H5P_DATASET_XFER);
+	H5Pset_dxpl_mpio(dxpl, H5FD_MPIO_COLLECTIVE);
+	writeBoxes(file, fields, dxpl);
+	H5Pclose(dxpl);
+	H5Fclose(file);
+	H5Pclose(fapl);
+	MPI_Info_free(&info);
+#else
+	// A serial HDF5 library: the root processor creates the file, then each processor in turn writes its boxes.
+	MPIW& mpihandler = MPIW::Instance();
+	mpihandler.serial([&] () {
+		hid_t file;
+		if (mpihandler.getRank() == 0) {
+			file = checked(H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT), "create " + filename);
+			createLayout(file, fields, m_precision, m_compressionLevel);
+		}
+		else
+			file = checked(H5Fopen(filename.c_str(), H5F_ACC_RDWR, H5P_DEFAULT), "open " + filename);
+		writeBoxes(file, fields, H5P_DEFAULT);
+		H5Fclose(file);
+	});
+#endif
+}
+#endif
+
+/**
+ * @param format SnapshotFormat of the files (not TEXT, which DataPrinter writes itself).
+ * @param precision Storage of the values.
+ * @param compressionLevel zlib level of the formats that compress (0 for none).
+ */
+std::unique_ptr<SnapshotWriter> SnapshotWriterFactory::create(SnapshotFormat format, SnapshotPrecision precision, int compressionLevel) {
+	if (format == SnapshotFormat::BINARY)
+		return std::unique_ptr<SnapshotWriter>(new BinarySnapshotWriter(precision));
+	else if (format == SnapshotFormat::HDF5) {
+#ifdef TORCH_HDF5
+		if (precision == SnapshotPrecision::QUANTISED)
+			throw std::runtime_error("SnapshotWriterFactory::create: hdf5 snapshots are stored as float64 or float32, not quantised.");
+		return std::unique_ptr<SnapshotWriter>(new HDF5SnapshotWriter(precision, compressionLevel));
+#else
+		(void)compressionLevel;
+		throw std::runtime_error("SnapshotWriterFactory::create: hdf5 snapshots need TORCH built with TORCH_HDF5.");
+#endif
+	}
+	else
+		throw std::runtime_error("SnapshotWriterFactory::create: no SnapshotWriter for this snapshot_format.");
+}
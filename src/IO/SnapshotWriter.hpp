@@ -0,0 +1,135 @@
+/** Provides the SnapshotWriter classes.
+ *
+ * @file SnapshotWriter.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef SNAPSHOTWRITER_HPP_
+#define SNAPSHOTWRITER_HPP_
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Torch/Common.hpp"
+
+/**
+ * @class SnapshotFields
+ *
+ * @brief The variables of this processor's box of cells, ready to be written by a SnapshotWriter.
+ *
+ * The grid written may be a region of the grid of the run, starting at the cell origin, in which case boxOffset is
+ * relative to the region and a processor's box may be empty.
+ */
+struct SnapshotFields {
+	double time = 0; //!< Simulation time (s).
+	int nd = 0; //!< Number of dimensions.
+	int geometry = 0; //!< Value of the Geometry enum.
+	std::array<int, 3> ncells = std::array<int, 3>{{ 1, 1, 1 }}; //!< Number of cells of the Grid along each dimension.
+	std::array<int, 3> origin = std::array<int, 3>{{ 0, 0, 0 }}; //!< Grid coordinates of the first cell in the grid of the run.
+	bool isRegion = false; //!< Only the processors with cells in the box write (binary snapshots only).
+	std::array<double, 3> dx = std::array<double, 3>{{ 0, 0, 0 }}; //!< Cell widths (cm).
+	std::array<int, 3> boxCells = std::array<int, 3>{{ 1, 1, 1 }}; //!< Number of cells of this processor's box along each dimension.
+	std::array<int, 3> boxOffset = std::array<int, 3>{{ 0, 0, 0 }}; //!< Grid coordinates of the corner of this processor's box.
+	std::vector<std::string> names; //!< Name of each variable, e.g. "den".
+	std::vector<std::string> units; //!< cgs unit of each variable, e.g. "g cm^-3".
+	std::vector<double> values; //!< names.size() values per cell of the box in cgs units, cells x fastest.
+};
+
+/**
+ * @class SnapshotWriter
+ *
+ * @brief Writes the SnapshotFields of every processor to one file. Collective.
+ */
+class SnapshotWriter {
+public:
+	virtual ~SnapshotWriter() {}
+	virtual std::string extension() const = 0;
+	virtual void write(const std::string& filename, const SnapshotFields& fields) const = 0;
+};
+
+/**
+ * @class BinarySnapshotWriter
+ *
+ * @brief Writes TORCH binary snapshots (.tsnp), whose layout is described by SnapshotHeader.
+ */
+class BinarySnapshotWriter : public SnapshotWriter {
+public:
+	explicit BinarySnapshotWriter(SnapshotPrecision precision);
+	std::string extension() const override;
+	void write(const std::string& filename, const SnapshotFields& fields) const override;
+
+private:
+	SnapshotPrecision m_precision;
+};
+
+/**
+ * @class DeltaSnapshotWriter
+ *
+ * @brief Writes a series of binary snapshots of the same variables, every keyframeEvery-th of them (a keyframe) in
+ * full and the others as deltas holding only the blocks of cells that have changed since the previous snapshot.
+ *
+ * Each processor splits its box into blocks of up to BLOCK cells along each dimension, and writes a block if any of its
+ * stored values differs from the one the series holds for it so far by more than the tolerance times the largest
+ * magnitude of its variable on the grid, or at all with no tolerance. The series therefore reconstructs (see SnapshotReader) exactly the values
+ * this writer compares against, and the error of each variable in a delta's header covers the cells it leaves out.
+ * A snapshot is a keyframe whenever any processor's box has changed since the last one, e.g. after a repartition.
+ */
+class DeltaSnapshotWriter : public SnapshotWriter {
+public:
+	static const int BLOCK = 8; //!< Most cells of a block along each dimension.
+
+	DeltaSnapshotWriter(SnapshotPrecision precision, int keyframeEvery, double tolerance);
+	std::string extension() const override;
+	void write(const std::string& filename, const SnapshotFields& fields) const override;
+
+private:
+	BinarySnapshotWriter m_keyframes; //!< Writes the keyframes.
+	SnapshotPrecision m_precision;
+	int m_keyframeEvery; //!< Snapshots from one keyframe to the next.
+	double m_tolerance; //!< Largest relative change of a value left out of a delta.
+	mutable int m_sinceKeyframe = 0; //!< Snapshots written since the last keyframe (0 before the first).
+	mutable std::string m_previous; //!< Name of the previous snapshot, without its directory.
+	mutable std::array<int, 3> m_boxCells = std::array<int, 3>{{ 0, 0, 0 }}; //!< This processor's box at the last keyframe.
+	mutable std::array<int, 3> m_boxOffset = std::array<int, 3>{{ 0, 0, 0 }};
+	mutable std::vector<double> m_stored; //!< Values of this processor's box as the series holds them so far.
+
+	double stored(double value) const;
+};
+
+#ifdef TORCH_HDF5
+/**
+ * @class HDF5SnapshotWriter
+ *
+ * @brief Writes snapshots as HDF5 files (.h5).
+ *
+ * Every variable is a chunked dataset of shape (ncells[2], ncells[1], ncells[0]), so x is the fastest index, with its
+ * cgs unit as the string attribute "unit". The root group has the attributes "time" (s), "nd", "ncells", "dx" (cm) and
+ * "geometry". With a parallel HDF5 library all processors write their boxes at once with collective MPI-IO; otherwise
+ * they take turns to write theirs into the file.
+ */
+class HDF5SnapshotWriter : public SnapshotWriter {
+public:
+	HDF5SnapshotWriter(SnapshotPrecision precision, int compressionLevel);
+	std::string extension() const override;
+	void write(const std::string& filename, const SnapshotFields& fields) const override;
+
+private:
+	SnapshotPrecision m_precision;
+	int m_compressionLevel; //!< Deflate level of the datasets (0 for none).
+};
+#endif
+
+/**
+ * @class SnapshotWriterFactory
+ *
+ * @brief Creates SnapshotWriters.
+ */
+class SnapshotWriterFactory {
+public:
+	static std::unique_ptr<SnapshotWriter> create(SnapshotFormat format, SnapshotPrecision precision, int compressionLevel);
+};
+
+#endif // SNAPSHOTWRITER_HPP_
@@ -29,14 +29,14 @@
 #ifndef STREAMGZ_HPP_
 #define STREAMGZ_HPP_
 
-#include <libio.h>
+#include <cstdio>
 #include <zlib.h>
 #include <iostream>
 
 class StreambufGZ : public std::streambuf {
 private:
-	static const int bufferSize = 47+256;    // size of data buff
-	// totals 512 bytes under g++ for igzstream at the end.
+	static const int bufferSize = 1 << 16;   // size of data buff
+	// large enough that gzwrite is not called every few hundred bytes.
 
 	gzFile           file;               // file handle for compressed file
 	char             buffer[bufferSize]; // data buffer
@@ -0,0 +1,59 @@
+#include "TelemetryPublisher.hpp"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+TelemetryPublisher::~TelemetryPublisher() {
+	if (m_socket >= 0)
+		close(m_socket);
+}
+
+/**
+ * @brief Opens a non-blocking UDP socket to an address.
+ * @param address host:port of the monitor, e.g. "localhost:9870".
+ * @exception std::runtime_error Thrown if the address is malformed or cannot be resolved, or the socket cannot be opened.
+ */
+void TelemetryPublisher::open(const std::string& address) {
+	const std::size_t colon = address.rfind(':');
+	if (colon == std::string::npos || colon == 0 || colon + 1 == address.size())
+		throw std::runtime_error("TelemetryPublisher::open: telemetry_address(=" + address + ") must be host:port.");
+	const std::string host = address.substr(0, colon), port = address.substr(colon + 1);
+
+	addrinfo hints = addrinfo();
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	addrinfo* info = nullptr;
+	const int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &info);
+	if (status != 0)
+		throw std::runtime_error("TelemetryPublisher::open: unable to resolve " + address + ": " + gai_strerror(status));
+
+	for (addrinfo* ai = info; ai != nullptr && m_socket < 0; ai = ai->ai_next) {
+		m_socket = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (m_socket < 0)
+			continue;
+		if (fcntl(m_socket, F_SETFL, O_NONBLOCK) != 0 || connect(m_socket, ai->ai_addr, ai->ai_addrlen) != 0) {
+			close(m_socket);
+			m_socket = -1;
+		}
+	}
+	freeaddrinfo(info);
+	if (m_socket < 0)
+		throw std::runtime_error("TelemetryPublisher::open: unable to open a UDP socket to " + address + ".");
+}
+
+bool TelemetryPublisher::isOpen() const {
+	return m_socket >= 0;
+}
+
+/**
+ * @brief Sends a packet as a single datagram if it can be sent at once, otherwise drops it.
+ */
+void TelemetryPublisher::publish(const std::string& packet) const {
+	if (m_socket >= 0)
+		send(m_socket, packet.data(), packet.size(), MSG_DONTWAIT);
+}
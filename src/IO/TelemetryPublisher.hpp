@@ -0,0 +1,35 @@
+/** Provides the TelemetryPublisher class.
+ *
+ * @file TelemetryPublisher.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef TELEMETRYPUBLISHER_HPP_
+#define TELEMETRYPUBLISHER_HPP_
+
+#include <string>
+
+/**
+ * @class TelemetryPublisher
+ *
+ * @brief Sends packets of run diagnostics as UDP datagrams to a monitoring address, without ever blocking.
+ *
+ * The socket is non-blocking and nobody has to be listening: a packet that cannot be sent at once, or that nobody
+ * receives, is dropped, so a dashboard watching many runs can come and go without affecting them.
+ */
+class TelemetryPublisher {
+public:
+	TelemetryPublisher() { }
+	~TelemetryPublisher();
+	TelemetryPublisher(const TelemetryPublisher&) = delete;
+	TelemetryPublisher& operator=(const TelemetryPublisher&) = delete;
+
+	void open(const std::string& address);
+	bool isOpen() const;
+	void publish(const std::string& packet) const;
+private:
+	int m_socket = -1; //!< UDP socket, connected to the address (-1 if closed).
+};
+
+#endif // TELEMETRYPUBLISHER_HPP_
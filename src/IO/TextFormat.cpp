@@ -0,0 +1,114 @@
+#include "TextFormat.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+/**
+ * @brief Powers of ten up to the largest that scientific multiplies by at once.
+ */
+struct PowersOfTen {
+	static const int N = 28;
+	long double p[N];
+	PowersOfTen() {
+		p[0] = 1;
+		for (int i = 1; i < N; ++i)
+			p[i] = p[i - 1]*10;
+	}
+};
+
+const PowersOfTen powers;
+
+/**
+ * @brief Scales value by 10^k, counting the roundings in ops.
+ */
+long double scale(long double value, int k, int& ops) {
+	while (k >= PowersOfTen::N) {
+		value *= powers.p[PowersOfTen::N - 1];
+		k -= PowersOfTen::N - 1;
+		++ops;
+	}
+	while (k <= -PowersOfTen::N) {
+		value /= powers.p[PowersOfTen::N - 1];
+		k += PowersOfTen::N - 1;
+		++ops;
+	}
+	value = k >= 0 ? value*powers.p[k] : value/powers.p[-k];
+	return value;
+}
+
+}
+
+namespace TextFormat {
+
+/**
+ * @brief Writes a number as std::ostream does with std::scientific and std::setprecision(10), i.e. as printf's %.10e.
+ *
+ * The eleven significant digits are the value scaled by a power of ten in long double, rounded to the nearest integer.
+ * The few values within the rounding error of the scaling from halfway between two integers, where the digits could
+ * differ from the correctly rounded ones printf writes, are written by snprintf instead, as are infinities and NaNs.
+ * @return The end of the characters written, at most maxScientific.
+ */
+char* scientific(double value, char* out) {
+	if (!std::isfinite(value))
+		return out + std::snprintf(out, maxScientific + 1, "%.10e", value);
+	char* start = out;
+	const double original = value;
+	if (std::signbit(value)) {
+		*out++ = '-';
+		value = -value;
+	}
+	if (value == 0) {
+		std::memcpy(out, "0.0000000000e+00", 16);
+		return out + 16;
+	}
+
+	int exponent = (int)std::floor(std::log10(value));
+	int ops = 1;
+	long double scaled = scale(value, 10 - exponent, ops);
+	// log10 may be out by one either side of a power of ten.
+	if (scaled < 1.0e10L) {
+		scaled *= 10;
+		--exponent;
+		++ops;
+	}
+	else if (scaled >= 1.0e11L) {
+		scaled /= 10;
+		++exponent;
+		++ops;
+	}
+	const long double whole = std::floor(scaled);
+	const long double fraction = scaled - whole;
+	const long double tolerance = 1.0e11L*(ops + 1)*std::numeric_limits<long double>::epsilon();
+	if (std::abs(fraction - 0.5L) <= tolerance)
+		return start + std::snprintf(start, maxScientific + 1, "%.10e", original);
+	std::uint64_t digits = (std::uint64_t)whole + (fraction > 0.5L ? 1 : 0);
+	if (digits >= 100000000000ULL) {
+		digits /= 10;
+		++exponent;
+	}
+
+	char mantissa[11];
+	for (int i = 10; i >= 0; --i) {
+		mantissa[i] = (char)('0' + digits%10);
+		digits /= 10;
+	}
+	*out++ = mantissa[0];
+	*out++ = '.';
+	std::memcpy(out, mantissa + 1, 10);
+	out += 10;
+	*out++ = 'e';
+	*out++ = exponent < 0 ? '-' : '+';
+	const int e = std::abs(exponent);
+	if (e >= 100)
+		*out++ = (char)('0' + e/100);
+	*out++ = (char)('0' + (e/10)%10);
+	*out++ = (char)('0' + e%10);
+	return out;
+}
+
+}
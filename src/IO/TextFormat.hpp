@@ -0,0 +1,72 @@
+/** Provides the TextFormat formatters.
+ *
+ * @file TextFormat.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef TEXTFORMAT_HPP_
+#define TEXTFORMAT_HPP_
+
+#include <string>
+#include <vector>
+
+#include "Misc/Parallel.hpp"
+
+/**
+ * @brief Fast formatting of the numbers of the text output into character buffers, byte for byte as std::ostream
+ * formats them, and of blocks of rows at once on the OpenMP threads.
+ *
+ * The streams look up the locale and fill a stream buffer for every number, which makes formatting a text snapshot
+ * cost several times its compression.
+ */
+namespace TextFormat {
+
+const int maxScientific = 18; //!< Most characters of a number written by scientific, e.g. -1.2345678901e-123.
+const int rowsPerBlock = 4096; //!< Rows formatted together by a thread in appendRows.
+
+char* scientific(double value, char* out);
+
+/**
+ * @brief Appends rows of nvars values to text, formatting blocks of rowsPerBlock rows into buffers of their own.
+ * @param text Text the rows are appended to, in order.
+ * @param rows The values, row after row.
+ * @param nvars Values per row.
+ * @param maxRowLength Most characters formatRow writes for a row.
+ * @param threaded Format the blocks with the OpenMP threads (only from the thread running the simulation, as the
+ * threads are shared with it).
+ * @param formatRow Writes a row, given its first value and the start of its characters, and returns the end of them.
+ */
+template <class FormatRow>
+void appendRows(std::string& text, const std::vector<double>& rows, int nvars, int maxRowLength, bool threaded,
+		FormatRow formatRow) {
+	const long nrows = (long)(rows.size()/nvars);
+	const int nblocks = (int)((nrows + rowsPerBlock - 1)/rowsPerBlock);
+	std::vector<std::vector<char>> blocks(nblocks);
+	auto formatBlock = [&](int b) {
+		const long first = (long)b*rowsPerBlock, last = std::min(nrows, first + rowsPerBlock);
+		std::vector<char>& block = blocks[b];
+		block.resize((std::size_t)(last - first)*maxRowLength);
+		char* out = block.data();
+		for (long i = first; i < last; ++i)
+			out = formatRow(&rows[(std::size_t)i*nvars], out);
+		block.resize(out - block.data());
+	};
+	if (threaded && nblocks > 1)
+		Parallel::forEach(0, nblocks, formatBlock);
+	else {
+		for (int b = 0; b < nblocks; ++b)
+			formatBlock(b);
+	}
+
+	std::size_t size = text.size();
+	for (const std::vector<char>& block : blocks)
+		size += block.size();
+	text.reserve(size);
+	for (const std::vector<char>& block : blocks)
+		text.append(block.data(), block.size());
+}
+
+}
+
+#endif // TEXTFORMAT_HPP_
@@ -0,0 +1,60 @@
+#include "WarningTally.hpp"
+
+#include "Logger.hpp"
+#include "Misc/Parallel.hpp"
+
+#include <algorithm>
+
+/**
+ * @param what Where the warning comes from and what it is, e.g. "Radiation::update_HIIfrac: slow iteration".
+ * @param measure Name of the value recorded with each cell, e.g. "niter".
+ */
+WarningTally::WarningTally(const std::string& what, const std::string& measure)
+: m_what(what)
+, m_measure(measure)
+, m_slots(1)
+{ }
+
+/**
+ * @brief Makes a slot for each of the threads that may record, discarding any counts.
+ */
+void WarningTally::initialise(int nthreads) {
+	m_slots.assign(std::max(nthreads, 1), Slot());
+}
+
+/**
+ * @brief Counts a cell in the calling thread's slot.
+ * @param value Value of the measure in the cell.
+ * @param where Grid coordinates of the cell.
+ */
+void WarningTally::record(double value, const std::array<double, 3>& where) {
+	Slot& slot = m_slots[Parallel::threadID()];
+	if (slot.count == 0 || value > slot.worst) {
+		slot.worst = value;
+		slot.where = where;
+	}
+	++slot.count;
+}
+
+/**
+ * @brief Logs the cells counted since the last report, if any, and starts the count again. Called by the main thread
+ * outside the threaded loops.
+ * @return Number of cells counted.
+ */
+long WarningTally::report() {
+	Slot total;
+	for (Slot& slot : m_slots) {
+		if (slot.count > 0 && (total.count == 0 || slot.worst > total.worst)) {
+			total.worst = slot.worst;
+			total.where = slot.where;
+		}
+		total.count += slot.count;
+		slot = Slot();
+	}
+	if (total.count > 0) {
+		Logger::Instance().print<SeverityType::WARNING>(m_what, " in ", total.count, total.count == 1 ? " cell" : " cells",
+				", max ", m_measure, " ", total.worst, ", worst cell (", total.where[0], ", ", total.where[1], ", ",
+				total.where[2], ").\n");
+	}
+	return total.count;
+}
@@ -0,0 +1,45 @@
+/** Provides the WarningTally class.
+ *
+ * @file WarningTally.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef WARNINGTALLY_HPP_
+#define WARNINGTALLY_HPP_
+
+#include <array>
+#include <string>
+#include <vector>
+
+/**
+ * @class WarningTally
+ *
+ * @brief Counts a warning raised by the cells of a threaded loop and logs one summary of it, rather than a line per
+ * cell, e.g. "Radiation::update_HIIfrac: slow iteration in 312 cells, max niter 50012, worst cell (12.5, 40.5, 0.5)".
+ *
+ * Each thread counts into its own slot, keeping the largest value of the measure and the cell that gave it, so
+ * recording takes no lock and formats nothing. WarningTally::report sums the slots and logs the summary from the main
+ * thread, once a step.
+ */
+class WarningTally {
+public:
+	WarningTally(const std::string& what, const std::string& measure);
+	void initialise(int nthreads);
+	void record(double value, const std::array<double, 3>& where);
+	long report();
+private:
+	/**
+	 * @brief One thread's count since the last report.
+	 */
+	struct Slot {
+		long count = 0; //!< Number of cells recorded.
+		double worst = 0; //!< Largest value of the measure.
+		std::array<double, 3> where = std::array<double, 3>{{ 0, 0, 0 }}; //!< Grid coordinates of the cell with the largest value.
+	};
+	std::string m_what; //!< Where the warning comes from and what it is.
+	std::string m_measure; //!< Name of the measure recorded with each cell.
+	std::vector<Slot> m_slots; //!< Count of each thread.
+};
+
+#endif // WARNINGTALLY_HPP_
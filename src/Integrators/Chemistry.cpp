@@ -0,0 +1,210 @@
+#include "Chemistry.hpp"
+
+#include "Fluid/Fluid.hpp"
+#include "Fluid/Grid.hpp"
+#include "Fluid/GridCell.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+#include "Misc/Parallel.hpp"
+#include "Torch/Converter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @param converter Converts the rate coefficients to code units.
+ * @param massFractionH Mass fraction of hydrogen.
+ * @param hydrogenMass Mass of a hydrogen atom (code units).
+ * @param steps ROS2 steps per time step (0 turns the chemistry off).
+ * @exception std::runtime_error Thrown if steps is negative.
+ */
+void Chemistry::initialise(const Converter& converter, double massFractionH, double hydrogenMass, int steps) {
+	if (steps < 0)
+		throw std::runtime_error("Chemistry::initialise: chemistry_steps(=" + std::to_string(steps) + ") must not be negative.");
+	m_steps = steps;
+	m_massFractionH = massFractionH;
+	m_hydrogenMass = hydrogenMass;
+	m_kDust = converter.toCodeUnits(3.0e-17, 0.0, 3.0, -1.0);
+	m_kH2 = converter.toCodeUnits(3.3e-11, 0.0, 0.0, -1.0);
+	m_shieldColumn = converter.toCodeUnits(1.0e14, 0.0, -2.0, 0.0);
+	m_k0 = converter.toCodeUnits(5.0e-16, 0.0, 3.0, -1.0);
+	m_k1 = converter.toCodeUnits(5.0e-10, 0.0, 3.0, -1.0);
+	m_kCHx = converter.toCodeUnits(5.0e-10, 0.0, 0.0, -1.0);
+	m_kCO = converter.toCodeUnits(1.0e-10, 0.0, 0.0, -1.0);
+	m_abundances.clear();
+}
+
+bool Chemistry::isOn() const {
+	return m_steps > 0;
+}
+
+int Chemistry::getSteps() const {
+	return m_steps;
+}
+
+/**
+ * @brief Abundances of a cell, which has been integrated at least once.
+ */
+const Chemistry::Abundances& Chemistry::getAbundances(int cellID) const {
+	return m_abundances[cellID];
+}
+
+/**
+ * @brief Mean abundances of some of the cells across every processor, weighted by their hydrogen nuclei. Collective.
+ */
+Chemistry::Abundances Chemistry::meanAbundances(Fluid& fluid, const std::vector<int>& cellIDs) const {
+	Grid& grid = fluid.getGrid();
+	std::vector<double> sums(SID::N + 1, 0);
+	for (int cellID : cellIDs) {
+		if (cellID >= (int)m_abundances.size())
+			continue;
+		const double nH = grid.getCell(cellID).Q[UID::DEN];
+		for (int s = 0; s < SID::N; ++s)
+			sums[s] += nH*m_abundances[cellID][s];
+		sums[SID::N] += nH;
+	}
+	sums = MPIW::Instance().sum(sums);
+	Abundances mean;
+	for (int s = 0; s < SID::N; ++s)
+		mean[s] = sums[SID::N] > 0 ? sums[s]/sums[SID::N] : 0;
+	return mean;
+}
+
+/**
+ * @brief Integrates the abundances of some of the cells over dt, BATCH cells at a time, in m_steps ROS2 steps.
+ * @param dt Time step.
+ * @param fluid The Fluid.
+ * @param cellIDs The cells, whose temperatures and column densities are up to date.
+ * @param field Finds the FUV field of a cell.
+ */
+void Chemistry::integrate(double dt, Fluid& fluid, const std::vector<int>& cellIDs, const Field& field) const {
+	if (m_steps == 0)
+		return;
+	Grid& grid = fluid.getGrid();
+	if (m_abundances.size() != grid.getCells().size())
+		m_abundances.assign(grid.getCells().size(), Abundances{{0, 0}});
+
+	const int nbatches = ((int)cellIDs.size() + BATCH - 1)/BATCH;
+	const double h = dt/m_steps;
+	Parallel::forEach(0, nbatches, [&](int b) {
+		Batch batch;
+		batch.n = std::min(BATCH, (int)cellIDs.size() - b*BATCH);
+		for (int l = 0; l < BATCH; ++l) {
+			// The lanes past the end of the cells repeat the last, so every loop runs over the whole batch.
+			const int cellID = cellIDs[b*BATCH + std::min(l, batch.n - 1)];
+			const GridCell& cell = grid.getCell(cellID);
+			double G0 = 0, Av = 0;
+			field(cell, G0, Av);
+			const double nH = m_massFractionH*cell.Q[UID::DEN]/m_hydrogenMass;
+			const double T = cell.getTemperature();
+			batch.xHI[l] = std::max(0.0, 1.0 - cell.Q[UID::HII]);
+			batch.formH2[l] = m_kDust*std::sqrt(T/100.0)*nH;
+			batch.dissH2[l] = m_kH2*G0*std::exp(-3.74*Av);
+			batch.columnH[l] = cell.T[TID::COL_DEN];
+			const double photoCHx = m_kCHx*G0*std::exp(-2.5*Av);
+			const double formCHx = m_k1*m_xO*nH;
+			batch.formCO[l] = m_k0*nH*formCHx/(formCHx + photoCHx);
+			batch.dissCO[l] = m_kCO*G0*std::exp(-2.5*Av);
+			for (int s = 0; s < SID::N; ++s)
+				batch.y[s][l] = m_abundances[cellID][s];
+		}
+		for (int i = 0; i < m_steps; ++i)
+			step(batch, h);
+		for (int l = 0; l < batch.n; ++l) {
+			const int cellID = cellIDs[b*BATCH + l];
+			for (int s = 0; s < SID::N; ++s)
+				m_abundances[cellID][s] = batch.y[s][l];
+		}
+	});
+}
+
+/**
+ * @brief Rates of change of the abundances of a batch, at the H2 self-shielding factors shield.
+ */
+void Chemistry::rates(const Batch& batch, const double y[SID::N][BATCH], const double shield[BATCH], double f[SID::N][BATCH]) const {
+	for (int l = 0; l < BATCH; ++l) {
+		f[SID::H2][l] = batch.formH2[l]*(batch.xHI[l] - 2.0*y[SID::H2][l]) - batch.dissH2[l]*shield[l]*y[SID::H2][l];
+		f[SID::CO][l] = batch.formCO[l]*(m_xC - y[SID::CO][l])*y[SID::H2][l] - batch.dissCO[l]*y[SID::CO][l];
+	}
+}
+
+/**
+ * @brief Jacobian of Chemistry::rates, J[i][j] being the derivative of the rate of species i by the abundance of j.
+ */
+void Chemistry::jacobian(const Batch& batch, const double y[SID::N][BATCH], const double shield[BATCH],
+		double J[SID::N][SID::N][BATCH]) const {
+	for (int l = 0; l < BATCH; ++l) {
+		J[SID::H2][SID::H2][l] = -2.0*batch.formH2[l] - batch.dissH2[l]*shield[l];
+		J[SID::H2][SID::CO][l] = 0;
+		J[SID::CO][SID::H2][l] = batch.formCO[l]*(m_xC - y[SID::CO][l]);
+		J[SID::CO][SID::CO][l] = -batch.formCO[l]*y[SID::H2][l] - batch.dissCO[l];
+	}
+}
+
+/**
+ * @brief Takes a ROS2 step of length h,
+ *
+ * (I - gamma*h*J)*k1 = f(y), (I - gamma*h*J)*k2 = f(y + h*k1) - 2*k1, y += 1.5*h*k1 + 0.5*h*k2,
+ *
+ * with gamma = 1 + 1/sqrt(2), solving both systems with the one elimination of the matrix. The H2 self-shielding
+ * factor is held at its value at the start of the step, and the abundances are kept between 0 and the most that the
+ * hydrogen and carbon allow.
+ */
+void Chemistry::step(Batch& batch, double h) const {
+	const double gamma = 1.0 + 1.0/std::sqrt(2.0);
+	double shield[BATCH];
+	for (int l = 0; l < BATCH; ++l) {
+		const double columnH2 = batch.y[SID::H2][l]*batch.columnH[l];
+		shield[l] = columnH2 > m_shieldColumn ? std::pow(columnH2/m_shieldColumn, -0.75) : 1.0;
+	}
+
+	// W = I - gamma*h*J, reduced to upper triangular form without pivoting: its diagonal dominates, as J's does.
+	double W[SID::N][SID::N][BATCH];
+	double L[SID::N][SID::N][BATCH];
+	jacobian(batch, batch.y, shield, W);
+	for (int i = 0; i < SID::N; ++i)
+		for (int j = 0; j < SID::N; ++j)
+			for (int l = 0; l < BATCH; ++l)
+				W[i][j][l] = (i == j ? 1.0 : 0.0) - gamma*h*W[i][j][l];
+	for (int k = 0; k < SID::N; ++k)
+		for (int i = k + 1; i < SID::N; ++i)
+			for (int l = 0; l < BATCH; ++l) {
+				L[i][k][l] = W[i][k][l]/W[k][k][l];
+				for (int j = k; j < SID::N; ++j)
+					W[i][j][l] -= L[i][k][l]*W[k][j][l];
+			}
+	auto solve = [&](double x[SID::N][BATCH]) {
+		for (int k = 0; k < SID::N; ++k)
+			for (int i = k + 1; i < SID::N; ++i)
+				for (int l = 0; l < BATCH; ++l)
+					x[i][l] -= L[i][k][l]*x[k][l];
+		for (int i = SID::N - 1; i >= 0; --i)
+			for (int l = 0; l < BATCH; ++l) {
+				for (int j = i + 1; j < SID::N; ++j)
+					x[i][l] -= W[i][j][l]*x[j][l];
+				x[i][l] /= W[i][i][l];
+			}
+	};
+
+	double k1[SID::N][BATCH];
+	double k2[SID::N][BATCH];
+	double y1[SID::N][BATCH];
+	rates(batch, batch.y, shield, k1);
+	solve(k1);
+	for (int s = 0; s < SID::N; ++s)
+		for (int l = 0; l < BATCH; ++l)
+			y1[s][l] = batch.y[s][l] + h*k1[s][l];
+	rates(batch, y1, shield, k2);
+	for (int s = 0; s < SID::N; ++s)
+		for (int l = 0; l < BATCH; ++l)
+			k2[s][l] -= 2.0*k1[s][l];
+	solve(k2);
+	for (int l = 0; l < BATCH; ++l) {
+		const double maxH2 = 0.5*batch.xHI[l];
+		const double H2 = batch.y[SID::H2][l] + 1.5*h*k1[SID::H2][l] + 0.5*h*k2[SID::H2][l];
+		const double CO = batch.y[SID::CO][l] + 1.5*h*k1[SID::CO][l] + 0.5*h*k2[SID::CO][l];
+		batch.y[SID::H2][l] = H2 < 0 ? 0 : (H2 > maxH2 ? maxH2 : H2);
+		batch.y[SID::CO][l] = CO < 0 ? 0 : (CO > m_xC ? m_xC : CO);
+	}
+}
@@ -0,0 +1,90 @@
+/** Provides the Chemistry class.
+ *
+ * @file Chemistry.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef CHEMISTRY_HPP_
+#define CHEMISTRY_HPP_
+
+#include <array>
+#include <functional>
+#include <vector>
+
+#include "Torch/Common.hpp"
+
+class Converter;
+class Fluid;
+class GridCell;
+
+/**
+ * @class Chemistry
+ *
+ * @brief Integrates a small stiff network of molecular abundances (see SID) of many cells at once, for the cooling of
+ * molecular clouds.
+ *
+ * The network is the H2 and CO model of Nelson & Langer (1997): H2 forms on dust grains and is photodissociated by the
+ * far ultraviolet field, shielding itself, and CO forms from C+ through the CHx radicals, which the field may destroy
+ * first, and is photodissociated in turn. The field is the FUV flux of the star in Habing units, G0, attenuated by the
+ * visual extinction of the column to the star.
+ *
+ * The cells are integrated BATCH at a time with the two stage, second order, L-stable Rosenbrock method ROS2 of Verwer
+ * et al. (1999) and the analytic Jacobian of the network. Each step solves a linear system the size of the network
+ * for every cell of the batch, and the batch's arrays are laid out with the cells innermost, so every loop runs across
+ * the cells and vectorises. A fixed number of steps spans the time step, which the L-stability keeps stable however
+ * stiff the network, so every cell costs the same and the batches are shared evenly between the threads.
+ *
+ * The abundances are held per cell, indexed by cell ID, and start atomic. They stay with the cell rather than being
+ * advected, and start again when the Grid is rebuilt.
+ */
+class Chemistry {
+public:
+	static const int BATCH = 8; //!< Cells integrated together.
+	using Abundances = std::array<double, SID::N>; //!< Number densities of the species relative to hydrogen nuclei.
+	typedef std::function<void(const GridCell& cell, double& G0, double& Av)> Field; //!< Finds the FUV field of a cell.
+
+	void initialise(const Converter& converter, double massFractionH, double hydrogenMass, int steps);
+	bool isOn() const;
+	int getSteps() const;
+	void integrate(double dt, Fluid& fluid, const std::vector<int>& cellIDs, const Field& field) const;
+	const Abundances& getAbundances(int cellID) const;
+	Abundances meanAbundances(Fluid& fluid, const std::vector<int>& cellIDs) const;
+
+private:
+	/**
+	 * @brief The state of a batch of cells, with the cells innermost.
+	 */
+	struct Batch {
+		int n = 0; //!< Number of cells in the batch.
+		double y[SID::N][BATCH]; //!< Abundances.
+		double xHI[BATCH]; //!< Fraction of the hydrogen nuclei that are neutral.
+		double formH2[BATCH]; //!< Rate coefficient of H2 formation on dust, times nH.
+		double dissH2[BATCH]; //!< Unshielded H2 photodissociation rate.
+		double columnH[BATCH]; //!< Hydrogen nuclei column density to the star.
+		double formCO[BATCH]; //!< Rate coefficient of CO formation from C+ and H2, times nH and the CHx branching ratio.
+		double dissCO[BATCH]; //!< CO photodissociation rate.
+	};
+
+	void rates(const Batch& batch, const double y[SID::N][BATCH], const double shield[BATCH], double f[SID::N][BATCH]) const;
+	void jacobian(const Batch& batch, const double y[SID::N][BATCH], const double shield[BATCH],
+			double J[SID::N][SID::N][BATCH]) const;
+	void step(Batch& batch, double h) const;
+
+	int m_steps = 0; //!< ROS2 steps per time step (0 for no chemistry).
+	double m_massFractionH = 1.0;
+	double m_hydrogenMass = 0;
+	double m_kDust = 0; //!< H2 formation on dust at 100 K (cm3 s-1 in code units).
+	double m_kH2 = 0; //!< Unshielded H2 photodissociation rate at G0 = 1 (code units).
+	double m_shieldColumn = 0; //!< H2 column density beyond which H2 shields itself (code units).
+	double m_k0 = 0; //!< C+ + H2 -> CHx rate coefficient (code units).
+	double m_k1 = 0; //!< CHx + O -> CO rate coefficient (code units).
+	double m_kCHx = 0; //!< CHx photodissociation rate at G0 = 1 (code units).
+	double m_kCO = 0; //!< Unshielded CO photodissociation rate at G0 = 1 (code units).
+	static constexpr double m_xC = 1.41e-4; //!< Carbon abundance.
+	static constexpr double m_xO = 3.16e-4; //!< Oxygen abundance.
+
+	mutable std::vector<Abundances> m_abundances; //!< Abundances of each cell, indexed by cell ID.
+};
+
+#endif // CHEMISTRY_HPP_
@@ -0,0 +1,628 @@
+#include "Gravity.hpp"
+
+#include "Fluid/Grid.hpp"
+#include "Fluid/GridCell.hpp"
+#include "IO/Logger.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+#include "Misc/Parallel.hpp"
+#include "Misc/Profiler.hpp"
+#include "Torch/Constants.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+const int preSweeps = 2; //!< Gauss-Seidel sweeps before a level hands its residual to the coarser one.
+const int postSweeps = 2; //!< Gauss-Seidel sweeps after a level takes the correction of the coarser one.
+const double bottomTolerance = 1.0e-4; //!< Largest residual the conjugate gradients leave on the coarsest serial level, relative to its source term.
+const int maxSerialCycles = 10; //!< Most V-cycles of the serial levels in a coarse solve.
+const double serialTolerance = 1.0e-3; //!< Largest residual a coarse solve leaves, relative to its source term.
+
+}
+
+int Gravity::Level::index(int i, int j, int k) const {
+	return (i + ghosts[0])*stride[0] + (j + ghosts[1])*stride[1] + (k + ghosts[2])*stride[2];
+}
+
+/**
+ * @param c Constants of the run.
+ * @param leftBC Boundary conditions of the left sides of the Grid.
+ * @param rightBC Boundary conditions of the right sides of the Grid.
+ * @param tolerance Largest residual left by a solve, relative to the largest source term.
+ * @param maxCycles Most V-cycles of a solve.
+ */
+void Gravity::initialise(std::shared_ptr<Constants> c, const std::array<Condition, 3>& leftBC, const std::array<Condition, 3>& rightBC,
+		double tolerance, int maxCycles) {
+	if (tolerance <= 0)
+		throw std::runtime_error("Gravity::initialise: gravity_tolerance(=" + std::to_string(tolerance) + ") must be positive.");
+	if (maxCycles < 1)
+		throw std::runtime_error("Gravity::initialise: gravity_max_cycles(=" + std::to_string(maxCycles) + ") must be positive.");
+	consts = c;
+	m_nd = consts->nd;
+	m_tolerance = tolerance;
+	m_maxCycles = maxCycles;
+	m_leftBC = leftBC;
+	m_rightBC = rightBC;
+	m_isFixed = false;
+	for (int dim = 0; dim < m_nd; ++dim) {
+		const bool periodic = leftBC[dim] == Condition::PERIODIC && rightBC[dim] == Condition::PERIODIC;
+		if (!periodic && (leftBC[dim] != Condition::REFLECTING || rightBC[dim] != Condition::REFLECTING))
+			m_isFixed = true;
+	}
+	m_levels.clear();
+	m_serial.clear();
+}
+
+/**
+ * @brief Largest residual relative to the largest source term after the last solve.
+ */
+double Gravity::getResidual() const {
+	return m_residual;
+}
+
+/**
+ * @brief A level with zeroed fields, whose sides are taken from the boundary conditions or, for a distributed level,
+ * shared with the neighbouring processors.
+ */
+Gravity::Level Gravity::makeLevel(bool distributed, int scale, const std::array<int, 3>& n, const std::array<int, 3>& offset) const {
+	MPIW& mpihandler = MPIW::Instance();
+	Level level;
+	level.distributed = distributed;
+	level.scale = scale;
+	level.n = n;
+	level.offset = offset;
+	for (int dim = 0; dim < 3; ++dim)
+		level.ghosts[dim] = (dim < m_nd) ? 1 : 0;
+	level.stride[1] = n[0] + 2*level.ghosts[0];
+	level.stride[2] = level.stride[1]*(n[1] + 2*level.ghosts[1]);
+	const int size = level.stride[2]*(n[2] + 2*level.ghosts[2]);
+	level.phi.assign(size, 0);
+	level.rhs.assign(size, 0);
+	level.res.assign(size, 0);
+
+	for (int dim = 0; dim < 3; ++dim) {
+		const bool periodic = m_leftBC[dim] == Condition::PERIODIC && m_rightBC[dim] == Condition::PERIODIC;
+		for (int side = 0; side < 2; ++side) {
+			const Condition bc = (side == 0) ? m_leftBC[dim] : m_rightBC[dim];
+			Face& face = level.faces[dim + 3*side];
+			if (dim >= m_nd)
+				face = Face::MIRROR;
+			else if (distributed && mpihandler.getDims()[dim] > 1 && mpihandler.neighbour(dim, side == 0 ? -1 : 1) != -1)
+				face = Face::OPEN;
+			else if (periodic)
+				face = Face::PERIODIC;
+			else if (bc == Condition::REFLECTING)
+				face = Face::MIRROR;
+			else
+				face = Face::FIXED;
+		}
+	}
+	return level;
+}
+
+/**
+ * @brief Builds the levels for this processor's block of the Grid. Collective.
+ *
+ * The distributed levels are halved while every processor's block is an even number of cells (of at least four) from
+ * an even corner along every simulated dimension. The coarsest of them is gathered into the first serial level, which
+ * is halved while it can be in the same way.
+ * @exception std::runtime_error Thrown if the Grid is not Cartesian.
+ */
+void Gravity::build(Grid& grid) {
+	if (grid.geometry != Geometry::CARTESIAN)
+		throw std::runtime_error("Gravity::build: self-gravity needs a cartesian grid.");
+	MPIW& mpihandler = MPIW::Instance();
+	m_coreCells = grid.coreCells;
+	m_coreOffset = grid.coreOffset;
+	m_dx = grid.dx;
+
+	m_cellIDs.resize((std::size_t)m_coreCells[0]*m_coreCells[1]*m_coreCells[2]);
+	for (int k = 0; k < m_coreCells[2]; ++k)
+		for (int j = 0; j < m_coreCells[1]; ++j)
+			for (int i = 0; i < m_coreCells[0]; ++i)
+				m_cellIDs[i + m_coreCells[0]*(j + m_coreCells[1]*k)] = grid.flatIndex(i, j, k);
+
+	auto canHalve = [&](const std::array<int, 3>& n, const std::array<int, 3>& offset) {
+		for (int dim = 0; dim < m_nd; ++dim)
+			if (n[dim] < 4 || n[dim]%2 != 0 || offset[dim]%2 != 0)
+				return false;
+		return true;
+	};
+	auto halved = [&](const std::array<int, 3>& a) {
+		std::array<int, 3> b = a;
+		for (int dim = 0; dim < m_nd; ++dim)
+			b[dim] = a[dim]/2;
+		return b;
+	};
+
+	m_levels.clear();
+	m_levels.push_back(makeLevel(true, 1, m_coreCells, m_coreOffset));
+	for (;;) {
+		const Level& fine = m_levels.back();
+		double halves = canHalve(fine.n, fine.offset) ? 1 : 0;
+		if (mpihandler.minimum(halves) == 0)
+			break;
+		m_levels.push_back(makeLevel(true, 2*fine.scale, halved(fine.n), halved(fine.offset)));
+	}
+
+	const int scale = m_levels.back().scale;
+	std::array<int, 3> n = grid.ncells;
+	for (int dim = 0; dim < 3; ++dim)
+		n[dim] = (dim < m_nd) ? grid.ncells[dim]/scale : 1;
+	m_serial.clear();
+	m_serial.push_back(makeLevel(false, scale, n, std::array<int, 3>{{ 0, 0, 0 }}));
+	while (canHalve(m_serial.back().n, m_serial.back().offset)) {
+		const Level& fine = m_serial.back();
+		m_serial.push_back(makeLevel(false, 2*fine.scale, halved(fine.n), fine.offset));
+	}
+	Logger::Instance().print<SeverityType::INFO>("Gravity::build: ", m_levels.size(), " distributed and ", m_serial.size(),
+			" serial multigrid levels.\n");
+}
+
+/**
+ * @brief Sets the source term of the finest level, 4 pi G rho, and the monopole of the gas. Collective.
+ */
+void Gravity::setSource(Grid& grid) {
+	MPIW& mpihandler = MPIW::Instance();
+	Level& level = m_levels[0];
+	const double fourPiG = 4*consts->pi*consts->gravitationalConst;
+	double volume = 1;
+	for (int dim = 0; dim < m_nd; ++dim)
+		volume *= m_dx[dim];
+
+	// Mass and its first moments.
+	std::vector<double> moments(4, 0);
+	for (int k = 0; k < level.n[2]; ++k) {
+		for (int j = 0; j < level.n[1]; ++j) {
+			for (int i = 0; i < level.n[0]; ++i) {
+				const GridCell& cell = grid.getCell(m_cellIDs[i + level.n[0]*(j + level.n[1]*k)]);
+				const double mass = cell.U[UID::DEN]*volume;
+				level.rhs[level.index(i, j, k)] = fourPiG*cell.U[UID::DEN];
+				moments[0] += mass;
+				for (int dim = 0; dim < m_nd; ++dim)
+					moments[1 + dim] += mass*cell.xc[dim]*m_dx[dim];
+			}
+		}
+	}
+	moments = mpihandler.sum(moments);
+	m_mass = moments[0];
+	for (int dim = 0; dim < 3; ++dim)
+		m_centre[dim] = (dim < m_nd && m_mass > 0) ? moments[1 + dim]/m_mass : 0;
+	// A reflecting side doubles the mass, with the centre of mass on the mirror, as seen from the opposite side.
+	for (int dim = 0; dim < m_nd; ++dim) {
+		const bool leftMirror = m_leftBC[dim] == Condition::REFLECTING, rightMirror = m_rightBC[dim] == Condition::REFLECTING;
+		if (leftMirror != rightMirror) {
+			m_mass *= 2;
+			m_centre[dim] = leftMirror ? 0 : grid.ncells[dim]*m_dx[dim];
+		}
+	}
+
+	if (!m_isFixed) {
+		double ncells = 1;
+		for (int dim = 0; dim < m_nd; ++dim)
+			ncells *= grid.ncells[dim];
+		const double mean = fourPiG*moments[0]/(volume*ncells);
+		for (int k = 0; k < level.n[2]; ++k)
+			for (int j = 0; j < level.n[1]; ++j)
+				for (int i = 0; i < level.n[0]; ++i)
+					level.rhs[level.index(i, j, k)] -= mean;
+	}
+}
+
+/**
+ * @brief Potential of the monopole on a side of the Grid, at the face of a cell next to it.
+ * @param level Level of the cell.
+ * @param dim Dimension the side is normal to.
+ * @param side 0 for the left side, 1 for the right.
+ * @param i, j, k Coordinates of the cell within the level's box.
+ */
+double Gravity::boundaryPotential(const Level& level, int dim, int side, int i, int j, int k) const {
+	const std::array<int, 3> c = {{ i, j, k }};
+	double r2 = 0;
+	for (int d = 0; d < m_nd; ++d) {
+		const double xc = (d == dim) ? level.offset[d] + (side == 0 ? 0 : level.n[d]) : level.offset[d] + c[d] + 0.5;
+		const double x = xc*level.scale*m_dx[d] - m_centre[d];
+		r2 += x*x;
+	}
+	const double G = consts->gravitationalConst;
+	const double r = std::max(std::sqrt(r2), 0.5*m_dx[0]);
+	if (m_nd == 3)
+		return -G*m_mass/r;
+	else if (m_nd == 2)
+		return 2*G*m_mass*std::log(r);
+	else
+		return 2*consts->pi*G*m_mass*r;
+}
+
+/**
+ * @brief Fills the ghost cells of a field of a level, one dimension at a time so the corners are filled too.
+ *
+ * Collective for the distributed levels, whose faces are swapped with the neighbouring processors.
+ * @param level The level.
+ * @param field Its phi or res.
+ * @param homogeneous Whether the potential is zero on the FIXED sides (for the corrections of the coarser levels).
+ */
+void Gravity::fillGhosts(Level& level, std::vector<double>& field, bool homogeneous) {
+	MPIW& mpihandler = MPIW::Instance();
+	for (int dim = 0; dim < m_nd; ++dim) {
+		const int e1 = (dim + 1)%3, e2 = (dim + 2)%3;
+		const int m1 = level.n[e1] + 2*level.ghosts[e1], m2 = level.n[e2] + 2*level.ghosts[e2];
+		// Index of the cell a along dim, and p, q (counted from the first ghost) along the other two dimensions.
+		auto at = [&](int a, int p, int q) {
+			std::array<int, 3> c;
+			c[dim] = a;
+			c[e1] = p - level.ghosts[e1];
+			c[e2] = q - level.ghosts[e2];
+			return level.index(c[0], c[1], c[2]);
+		};
+		const int last = level.n[dim] - 1;
+
+		bool isShared = false;
+		for (int side = 0; side < 2; ++side) {
+			if (level.faces[dim + 3*side] != Face::OPEN)
+				continue;
+			isShared = true;
+			const int rank = mpihandler.neighbour(dim, side == 0 ? -1 : 1);
+			const int inner = (side == 0) ? 0 : last;
+			m_sendBuffers[side].resize(m1*m2);
+			m_recvBuffers[side].resize(m1*m2);
+			for (int q = 0; q < m2; ++q)
+				for (int p = 0; p < m1; ++p)
+					m_sendBuffers[side][p + m1*q] = field[at(inner, p, q)];
+			// Channel 0 travels right and channel 1 travels left.
+			mpihandler.postReceive(m_recvBuffers[side].data(), m1*m2, rank, SendID::GRAVITY_MSG, side == 0 ? 0 : 1);
+			mpihandler.postSend(m_sendBuffers[side].data(), m1*m2, rank, SendID::GRAVITY_MSG, side == 0 ? 1 : 0);
+		}
+		if (isShared)
+			mpihandler.waitAll();
+
+		for (int side = 0; side < 2; ++side) {
+			const Face face = level.faces[dim + 3*side];
+			const int ghost = (side == 0) ? -1 : last + 1;
+			const int inner = (side == 0) ? 0 : last;
+			for (int q = 0; q < m2; ++q) {
+				for (int p = 0; p < m1; ++p) {
+					double& value = field[at(ghost, p, q)];
+					if (face == Face::OPEN)
+						value = m_recvBuffers[side][p + m1*q];
+					else if (face == Face::PERIODIC)
+						value = field[at(side == 0 ? last : 0, p, q)];
+					else if (face == Face::MIRROR)
+						value = field[at(inner, p, q)];
+					else {
+						double boundary = 0;
+						if (!homogeneous) {
+							std::array<int, 3> c;
+							c[dim] = inner;
+							c[e1] = p - level.ghosts[e1];
+							c[e2] = q - level.ghosts[e2];
+							boundary = boundaryPotential(level, dim, side, c[0], c[1], c[2]);
+						}
+						value = 2*boundary - field[at(inner, p, q)];
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @brief Red-black Gauss-Seidel sweeps of a level's potential, colouring the cells by their global coordinates.
+ */
+void Gravity::smooth(Level& level, bool homogeneous, int sweeps) {
+	std::array<double, 3> invh2 = {{ 0, 0, 0 }};
+	double diagonal = 0;
+	for (int dim = 0; dim < m_nd; ++dim) {
+		invh2[dim] = 1.0/((level.scale*m_dx[dim])*(level.scale*m_dx[dim]));
+		diagonal += 2*invh2[dim];
+	}
+	const int parity = level.offset[0] + level.offset[1] + level.offset[2];
+	for (int sweep = 0; sweep < sweeps; ++sweep) {
+		for (int colour = 0; colour < 2; ++colour) {
+			fillGhosts(level, level.phi, homogeneous);
+			Parallel::forEach(0, level.n[1]*level.n[2], [&](int row) {
+				const int j = row%level.n[1], k = row/level.n[1];
+				const int first = (parity + j + k + colour)%2;
+				for (int i = first; i < level.n[0]; i += 2) {
+					const int id = level.index(i, j, k);
+					double sum = -level.rhs[id];
+					for (int dim = 0; dim < m_nd; ++dim)
+						sum += invh2[dim]*(level.phi[id - level.stride[dim]] + level.phi[id + level.stride[dim]]);
+					level.phi[id] = sum/diagonal;
+				}
+			});
+		}
+	}
+}
+
+/**
+ * @brief Sets the residual of a level's potential.
+ * @return Largest residual of this processor's cells.
+ */
+double Gravity::residual(Level& level, bool homogeneous) {
+	std::array<double, 3> invh2 = {{ 0, 0, 0 }};
+	for (int dim = 0; dim < m_nd; ++dim)
+		invh2[dim] = 1.0/((level.scale*m_dx[dim])*(level.scale*m_dx[dim]));
+	fillGhosts(level, level.phi, homogeneous);
+	std::vector<double> rowMax(level.n[1]*level.n[2], 0);
+	Parallel::forEach(0, level.n[1]*level.n[2], [&](int row) {
+		const int j = row%level.n[1], k = row/level.n[1];
+		for (int i = 0; i < level.n[0]; ++i) {
+			const int id = level.index(i, j, k);
+			double laplacian = 0;
+			for (int dim = 0; dim < m_nd; ++dim)
+				laplacian += invh2[dim]*(level.phi[id - level.stride[dim]] - 2*level.phi[id] + level.phi[id + level.stride[dim]]);
+			level.res[id] = level.rhs[id] - laplacian;
+			rowMax[row] = std::max(rowMax[row], std::abs(level.res[id]));
+		}
+	});
+	return rowMax.empty() ? 0 : *std::max_element(rowMax.begin(), rowMax.end());
+}
+
+/**
+ * @brief Sets the source term of a coarse level to the mean residual of its cells' children, and zeroes its potential.
+ */
+void Gravity::restrictResidual(const Level& fine, Level& coarse) const {
+	std::fill(coarse.phi.begin(), coarse.phi.end(), 0);
+	const int children = 1 << m_nd;
+	Parallel::forEach(0, coarse.n[1]*coarse.n[2], [&](int row) {
+		const int j = row%coarse.n[1], k = row/coarse.n[1];
+		for (int i = 0; i < coarse.n[0]; ++i) {
+			double sum = 0;
+			for (int child = 0; child < children; ++child) {
+				const std::array<int, 3> c = {{ 2*i + (child & 1), m_nd > 1 ? 2*j + ((child >> 1) & 1) : j, m_nd > 2 ? 2*k + ((child >> 2) & 1) : k }};
+				sum += fine.res[fine.index(c[0], c[1], c[2])];
+			}
+			coarse.rhs[coarse.index(i, j, k)] = sum/children;
+		}
+	});
+}
+
+/**
+ * @brief Adds the linear interpolation of a coarse level's correction to the potential of the fine level.
+ */
+void Gravity::prolongAdd(Level& coarse, Level& fine) {
+	fillGhosts(coarse, coarse.phi, true);
+	const int corners = 1 << m_nd;
+	Parallel::forEach(0, fine.n[1]*fine.n[2], [&](int row) {
+		const int j = row%fine.n[1], k = row/fine.n[1];
+		const std::array<int, 3> parent = {{ 0, m_nd > 1 ? j/2 : j, m_nd > 2 ? k/2 : k }};
+		const std::array<int, 3> step = {{ 0, (j%2 == 0) ? -1 : 1, (k%2 == 0) ? -1 : 1 }};
+		for (int i = 0; i < fine.n[0]; ++i) {
+			double value = 0;
+			for (int corner = 0; corner < corners; ++corner) {
+				std::array<int, 3> c = {{ i/2, parent[1], parent[2] }};
+				double weight = 1;
+				for (int dim = 0; dim < m_nd; ++dim) {
+					const bool far = (corner >> dim) & 1;
+					const int s = (dim == 0) ? ((i%2 == 0) ? -1 : 1) : step[dim];
+					c[dim] += far ? s : 0;
+					weight *= far ? 0.25 : 0.75;
+				}
+				value += weight*coarse.phi[coarse.index(c[0], c[1], c[2])];
+			}
+			fine.phi[fine.index(i, j, k)] += value;
+		}
+	});
+}
+
+/**
+ * @brief A V-cycle from distributed level l. Collective.
+ *
+ * The coarsest distributed level gathers its residual into the first serial level, and takes the correction every
+ * processor solves for there.
+ */
+void Gravity::cycle(int l) {
+	Level& level = m_levels[l];
+	const bool homogeneous = l > 0;
+	if (l + 1 < (int)m_levels.size()) {
+		smooth(level, homogeneous, preSweeps);
+		residual(level, homogeneous);
+		Level& coarse = m_levels[l + 1];
+		restrictResidual(level, coarse);
+		cycle(l + 1);
+		prolongAdd(coarse, level);
+		smooth(level, homogeneous, postSweeps);
+		return;
+	}
+
+	residual(level, homogeneous);
+	std::vector<double> block = {
+		(double)level.offset[0], (double)level.offset[1], (double)level.offset[2],
+		(double)level.n[0], (double)level.n[1], (double)level.n[2]
+	};
+	for (int k = 0; k < level.n[2]; ++k)
+		for (int j = 0; j < level.n[1]; ++j)
+			for (int i = 0; i < level.n[0]; ++i)
+				block.push_back(level.res[level.index(i, j, k)]);
+	MPIW& mpihandler = MPIW::Instance();
+	const std::vector<double> blocks = mpihandler.exchange(std::vector<std::vector<double>>(mpihandler.nproc, block));
+
+	Level& top = m_serial[0];
+	std::size_t pos = 0;
+	while (pos < blocks.size()) {
+		const int oi = (int)blocks[pos], oj = (int)blocks[pos + 1], ok = (int)blocks[pos + 2];
+		const int ni = (int)blocks[pos + 3], nj = (int)blocks[pos + 4], nk = (int)blocks[pos + 5];
+		pos += 6;
+		for (int k = 0; k < nk; ++k)
+			for (int j = 0; j < nj; ++j)
+				for (int i = 0; i < ni; ++i)
+					top.rhs[top.index(oi + i, oj + j, ok + k)] = blocks[pos++];
+	}
+	solveSerial();
+
+	for (int k = 0; k < level.n[2]; ++k)
+		for (int j = 0; j < level.n[1]; ++j)
+			for (int i = 0; i < level.n[0]; ++i)
+				level.phi[level.index(i, j, k)] += top.phi[top.index(level.offset[0] + i, level.offset[1] + j, level.offset[2] + k)];
+	smooth(level, homogeneous, postSweeps);
+}
+
+/**
+ * @brief A V-cycle from serial level l.
+ */
+void Gravity::cycleSerial(int l) {
+	Level& level = m_serial[l];
+	if (l + 1 == (int)m_serial.size()) {
+		solveBottom(level);
+		return;
+	}
+	smooth(level, true, preSweeps);
+	residual(level, true);
+	Level& coarse = m_serial[l + 1];
+	restrictResidual(level, coarse);
+	cycleSerial(l + 1);
+	prolongAdd(coarse, level);
+	smooth(level, true, postSweeps);
+}
+
+/**
+ * @brief Solves the coarsest serial level from zero by conjugate gradients, which need far fewer iterations than
+ * Gauss-Seidel sweeps when a Grid of an odd number of cells leaves it large.
+ *
+ * The residual of the search direction (level.res, so its ghost cells can be filled) is minimised for minus the
+ * Laplacian, which is symmetric and positive (semi-)definite for all the sides.
+ */
+void Gravity::solveBottom(Level& level) {
+	std::array<double, 3> invh2 = {{ 0, 0, 0 }};
+	for (int dim = 0; dim < m_nd; ++dim)
+		invh2[dim] = 1.0/((level.scale*m_dx[dim])*(level.scale*m_dx[dim]));
+	const int ncells = level.n[0]*level.n[1]*level.n[2];
+	std::vector<int> ids(ncells);
+	for (int k = 0; k < level.n[2]; ++k)
+		for (int j = 0; j < level.n[1]; ++j)
+			for (int i = 0; i < level.n[0]; ++i)
+				ids[i + level.n[0]*(j + level.n[1]*k)] = level.index(i, j, k);
+
+	std::fill(level.phi.begin(), level.phi.end(), 0);
+	std::vector<double>& p = level.res;
+	std::fill(p.begin(), p.end(), 0);
+	std::vector<double> r(ncells), q(ncells);
+	double rr = 0, rhsMax = 0;
+	for (int c = 0; c < ncells; ++c) {
+		r[c] = -level.rhs[ids[c]];
+		p[ids[c]] = r[c];
+		rr += r[c]*r[c];
+		rhsMax = std::max(rhsMax, std::abs(r[c]));
+	}
+	for (int iteration = 0; iteration < 2*ncells && rhsMax > 0; ++iteration) {
+		fillGhosts(level, p, true);
+		double pq = 0;
+		for (int c = 0; c < ncells; ++c) {
+			const int id = ids[c];
+			double laplacian = 0;
+			for (int dim = 0; dim < m_nd; ++dim)
+				laplacian += invh2[dim]*(p[id - level.stride[dim]] - 2*p[id] + p[id + level.stride[dim]]);
+			q[c] = -laplacian;
+			pq += p[id]*q[c];
+		}
+		if (pq <= 0)
+			break;
+		const double alpha = rr/pq;
+		double rrNext = 0, rMax = 0;
+		for (int c = 0; c < ncells; ++c) {
+			level.phi[ids[c]] += alpha*p[ids[c]];
+			r[c] -= alpha*q[c];
+			rrNext += r[c]*r[c];
+			rMax = std::max(rMax, std::abs(r[c]));
+		}
+		if (rMax <= bottomTolerance*rhsMax)
+			break;
+		const double beta = rrNext/rr;
+		rr = rrNext;
+		for (int c = 0; c < ncells; ++c)
+			p[ids[c]] = r[c] + beta*p[ids[c]];
+	}
+}
+
+/**
+ * @brief Solves for the correction of the first serial level from zero, which every processor does alike.
+ */
+void Gravity::solveSerial() {
+	Level& top = m_serial[0];
+	std::fill(top.phi.begin(), top.phi.end(), 0);
+	double rhsMax = 0;
+	for (double value : top.rhs)
+		rhsMax = std::max(rhsMax, std::abs(value));
+	if (rhsMax == 0)
+		return;
+	for (int c = 0; c < maxSerialCycles; ++c) {
+		cycleSerial(0);
+		if (residual(top, true) <= serialTolerance*rhsMax)
+			break;
+	}
+}
+
+/**
+ * @brief Sets the gravitational force density of every core cell, -rho grad(phi), from the potential.
+ */
+void Gravity::setForces(Grid& grid) {
+	Level& level = m_levels[0];
+	fillGhosts(level, level.phi, false);
+	Parallel::forEach(0, level.n[1]*level.n[2], [&](int row) {
+		const int j = row%level.n[1], k = row/level.n[1];
+		for (int i = 0; i < level.n[0]; ++i) {
+			const int id = level.index(i, j, k);
+			const GridCell& cell = grid.getCell(m_cellIDs[i + level.n[0]*row]);
+			GravArray& force = grid.getGravity(cell.id);
+			for (int dim = 0; dim < TORCH_MAX_DIMENSIONS; ++dim) {
+				force[dim] = (dim < m_nd) ?
+						-cell.U[UID::DEN]*(level.phi[id + level.stride[dim]] - level.phi[id - level.stride[dim]])/(2*m_dx[dim]) : 0;
+			}
+		}
+	});
+}
+
+/**
+ * @brief Solves for the potential of the gas, starting from the last solution, and sets Grid::getGravity. Collective.
+ *
+ * The levels are rebuilt from a zero potential whenever this processor's block has changed (see Torch::rebalance).
+ * @param grid The Grid.
+ * @return Number of V-cycles taken.
+ */
+int Gravity::solve(Grid& grid) {
+	ScopedTimer timer(ProfileID::GRAVITY);
+	MPIW& mpihandler = MPIW::Instance();
+	if (m_levels.empty() || grid.coreCells != m_coreCells || grid.coreOffset != m_coreOffset)
+		build(grid);
+	setSource(grid);
+	Level& level = m_levels[0];
+
+	double rhsMax = 0;
+	for (double value : level.rhs)
+		rhsMax = std::max(rhsMax, std::abs(value));
+	rhsMax = mpihandler.maximum(rhsMax);
+	if (rhsMax == 0)
+		std::fill(level.phi.begin(), level.phi.end(), 0);
+
+	int cycles = 0;
+	while (rhsMax > 0) {
+		double resMax = residual(level, false);
+		m_residual = mpihandler.maximum(resMax)/rhsMax;
+		if (m_residual <= m_tolerance || cycles == m_maxCycles)
+			break;
+		cycle(0);
+		++cycles;
+		if (!m_isFixed) {
+			// The potential of a periodic or closed box is only defined up to a constant, which is kept at zero.
+			double sum = 0, ncells = (double)level.n[0]*level.n[1]*level.n[2];
+			for (int k = 0; k < level.n[2]; ++k)
+				for (int j = 0; j < level.n[1]; ++j)
+					for (int i = 0; i < level.n[0]; ++i)
+						sum += level.phi[level.index(i, j, k)];
+			sum = mpihandler.sum(sum);
+			ncells = mpihandler.sum(ncells);
+			for (double& value : level.phi)
+				value -= sum/ncells;
+		}
+	}
+	if (m_residual > m_tolerance)
+		Logger::Instance().print<SeverityType::WARNING>("Gravity::solve: residual of ", m_residual, " after ", cycles,
+				" V-cycles, above gravity_tolerance(=", m_tolerance, ").\n");
+
+	setForces(grid);
+	return cycles;
+}
@@ -0,0 +1,100 @@
+/** Provides the Gravity class.
+ *
+ * @file Gravity.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef GRAVITY_HPP_
+#define GRAVITY_HPP_
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "Torch/Common.hpp"
+
+class Constants;
+class Grid;
+
+/**
+ * @class Gravity
+ *
+ * @brief Solves Poisson's equation for the gravitational potential of the gas with a geometric multigrid over the
+ * processors' blocks of the Grid, and sets the gravitational force density (Grid::getGravity) of every core cell from it.
+ *
+ * The cell centred potential takes V-cycles of red-black Gauss-Seidel smoothing, averaging restriction and linear
+ * prolongation, starting from the previous solution, until the largest residual is below the tolerance times the
+ * largest source term. The blocks are halved together for as long as every processor's block can be, so those levels
+ * only swap the faces of the blocks with the neighbouring processors. The coarsest of them is then gathered onto every
+ * processor, which solves it with a multigrid of its own.
+ *
+ * Periodic boundaries are periodic for the potential too and reflecting ones mirror it. On any other boundary the
+ * potential is that of the gas's monopole (with its mirror images in the reflecting boundaries): -GM/r in 3D, and the
+ * potentials of a line and a sheet of the same mass in 2D and 1D. If no boundary fixes the potential the mean density is
+ * taken out of the source term, so the potential of a periodic box is that of the density contrast.
+ */
+class Gravity {
+public:
+	void initialise(std::shared_ptr<Constants> c, const std::array<Condition, 3>& leftBC, const std::array<Condition, 3>& rightBC,
+			double tolerance, int maxCycles);
+	int solve(Grid& grid);
+	double getResidual() const;
+
+private:
+	enum class Face : unsigned int {OPEN, PERIODIC, MIRROR, FIXED}; //!< Treatment of the potential at a side of a level.
+
+	/**
+	 * @brief A level of the multigrid: a box of cells with one ghost cell on each side along the simulated dimensions.
+	 */
+	struct Level {
+		bool distributed = true; //!< Whether the level is split over the processors' blocks (else every processor holds it all).
+		int scale = 1; //!< Width of the level's cells in cells of the Grid.
+		std::array<int, 3> n = std::array<int, 3>{{ 1, 1, 1 }}; //!< Cells of the box along each dimension, without ghosts.
+		std::array<int, 3> offset = std::array<int, 3>{{ 0, 0, 0 }}; //!< Coordinates of the box's first cell within the level.
+		std::array<int, 3> ghosts = std::array<int, 3>{{ 0, 0, 0 }}; //!< Ghost cells on each side along each dimension.
+		std::array<int, 3> stride = std::array<int, 3>{{ 1, 1, 1 }}; //!< Distance in the arrays between neighbours along each dimension.
+		std::array<Face, 6> faces; //!< Treatment of the left then right side along each dimension (OPEN for a processor's neighbour).
+		std::vector<double> phi; //!< Potential (or its correction on the coarser levels).
+		std::vector<double> rhs; //!< Source term.
+		std::vector<double> res; //!< Residual.
+
+		int index(int i, int j, int k) const;
+	};
+
+	std::shared_ptr<Constants> consts = nullptr;
+	int m_nd = 1; //!< Number of dimensions.
+	double m_tolerance = 1.0e-6; //!< Largest residual left, relative to the largest source term.
+	int m_maxCycles = 20; //!< Most V-cycles of a solve.
+	double m_residual = 0; //!< Largest residual relative to the largest source term after the last solve.
+	std::array<Condition, 3> m_leftBC; //!< Boundary conditions of the left sides of the Grid.
+	std::array<Condition, 3> m_rightBC; //!< Boundary conditions of the right sides of the Grid.
+	bool m_isFixed = false; //!< Whether any boundary fixes the potential (else the mean density is taken out).
+	std::array<int, 3> m_coreCells = std::array<int, 3>{{ 0, 0, 0 }}; //!< Block the levels were built for.
+	std::array<int, 3> m_coreOffset = std::array<int, 3>{{ 0, 0, 0 }}; //!< Corner of the block the levels were built for.
+	std::array<double, 3> m_dx = std::array<double, 3>{{ 0, 0, 0 }}; //!< Cell widths of the Grid.
+	std::vector<int> m_cellIDs; //!< Core cell of each cell of the finest level, x fastest.
+	std::vector<Level> m_levels; //!< Levels split over the processors, finest first.
+	std::vector<Level> m_serial; //!< Levels every processor holds, finest (the gathered coarsest distributed level) first.
+	double m_mass = 0; //!< Mass of the gas and its mirror images (per unit length or area in 2D and 1D).
+	std::array<double, 3> m_centre = std::array<double, 3>{{ 0, 0, 0 }}; //!< Centre of mass of the gas and its mirror images.
+	std::array<std::vector<double>, 2> m_sendBuffers; //!< Faces sent to the left and right neighbours.
+	std::array<std::vector<double>, 2> m_recvBuffers; //!< Faces received from the left and right neighbours.
+
+	void build(Grid& grid);
+	Level makeLevel(bool distributed, int scale, const std::array<int, 3>& n, const std::array<int, 3>& offset) const;
+	void setSource(Grid& grid);
+	void fillGhosts(Level& level, std::vector<double>& field, bool homogeneous);
+	double boundaryPotential(const Level& level, int dim, int side, int i, int j, int k) const;
+	void smooth(Level& level, bool homogeneous, int sweeps);
+	double residual(Level& level, bool homogeneous);
+	void restrictResidual(const Level& fine, Level& coarse) const;
+	void prolongAdd(Level& coarse, Level& fine);
+	void cycle(int l);
+	void cycleSerial(int l);
+	void solveBottom(Level& level);
+	void solveSerial();
+	void setForces(Grid& grid);
+};
+
+#endif // GRAVITY_HPP_
@@ -0,0 +1,157 @@
+/** Provides the GravityField parameters and the gravity providers of the source term kernel.
+ *
+ * @file GravityField.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef GRAVITYFIELD_HPP_
+#define GRAVITYFIELD_HPP_
+
+#include <cmath>
+
+#include "Torch/Common.hpp"
+#include "Fluid/Grid.hpp"
+#include "Fluid/GridCell.hpp"
+
+/**
+ * @brief The external gravitational field of a run, in code units.
+ *
+ * Every model but FIELD is a force density worked out from a cell's position and density as the source terms are added
+ * (see Hydrodynamics::sourceKernel), so the cells need not store one. Positions are those the setups are given, the
+ * grid coordinates of the cell centres times the cell widths. FIELD keeps the force density the setup gave each cell, or
+ * the self-gravity of the gas (see Gravity), in the Grid (see Grid::storeGravity).
+ */
+struct GravityField {
+	GravityModel model = GravityModel::FIELD;
+	int nd = 1; //!< Number of simulated dimensions, along which the analytic fields act.
+	Vec3 dx = Vec3{{ 0, 0, 0 }}; //!< Cell widths.
+	Vec3 centre = Vec3{{ 0, 0, 0 }}; //!< Position of the point mass or of the centre of the isothermal sphere.
+	double strength = 0; //!< G times the point mass, or twice the square of the velocity dispersion of the isothermal sphere.
+	double softening2 = 0; //!< Square of the softening length added to the square of the distance from the centre.
+	Vec3 acceleration = Vec3{{ 0, 0, 0 }}; //!< Acceleration of the UNIFORM model.
+};
+
+/**
+ * @brief Gravity providers, which give the gravitational force density of a GridCell. Each is a template argument of
+ * Hydrodynamics::sourceKernel, which skips the gravity altogether for those that are not active.
+ */
+namespace GravityProvider {
+
+/**
+ * @brief The force densities stored in the Grid.
+ */
+class Field {
+public:
+	static constexpr bool active = true;
+
+	Field(const GravityField&, const Grid& grid) : m_grid(grid) {}
+
+	const GravArray& force(const GridCell& cell) const {
+		return m_grid.getGravity(cell.id);
+	}
+
+private:
+	const Grid& m_grid;
+};
+
+/**
+ * @brief No gravity.
+ */
+class None {
+public:
+	static constexpr bool active = false;
+
+	None(const GravityField&, const Grid&) {}
+
+	GravArray force(const GridCell&) const {
+		return GravArray();
+	}
+};
+
+/**
+ * @brief Base of the providers whose field is central, with the displacement of a cell from the centre.
+ */
+class Central {
+public:
+	Central(const GravityField& field, const Grid&) : m_field(field) {}
+
+protected:
+	const GravityField& m_field;
+
+	/**
+	 * @brief Displacement of a cell from the centre along the simulated dimensions (zero along the rest), and its square
+	 * softened.
+	 */
+	GravArray displacement(const GridCell& cell, double& r2) const {
+		GravArray d = GravArray();
+		r2 = m_field.softening2;
+		for (int i = 0; i < m_field.nd; ++i) {
+			d[i] = cell.xc[i]*m_field.dx[i] - m_field.centre[i];
+			r2 += d[i]*d[i];
+		}
+		return d;
+	}
+};
+
+/**
+ * @brief A point mass, -rho G M d/(|d|^2 + eps^2)^(3/2).
+ */
+class PointMass : public Central {
+public:
+	static constexpr bool active = true;
+
+	using Central::Central;
+
+	GravArray force(const GridCell& cell) const {
+		double r2;
+		GravArray f = displacement(cell, r2);
+		const double scale = r2 > 0 ? -cell.Q[UID::DEN]*m_field.strength/(r2*std::sqrt(r2)) : 0;
+		for (double& fi : f)
+			fi *= scale;
+		return f;
+	}
+};
+
+/**
+ * @brief A singular isothermal sphere, -rho 2 sigma^2 d/(|d|^2 + eps^2).
+ */
+class IsothermalSphere : public Central {
+public:
+	static constexpr bool active = true;
+
+	using Central::Central;
+
+	GravArray force(const GridCell& cell) const {
+		double r2;
+		GravArray f = displacement(cell, r2);
+		const double scale = r2 > 0 ? -cell.Q[UID::DEN]*m_field.strength/r2 : 0;
+		for (double& fi : f)
+			fi *= scale;
+		return f;
+	}
+};
+
+/**
+ * @brief A uniform field, rho g.
+ */
+class Uniform {
+public:
+	static constexpr bool active = true;
+
+	Uniform(const GravityField& field, const Grid&) : m_field(field) {}
+
+	GravArray force(const GridCell& cell) const {
+		GravArray f = GravArray();
+		for (int i = 0; i < m_field.nd; ++i)
+			f[i] = cell.Q[UID::DEN]*m_field.acceleration[i];
+		return f;
+	}
+
+private:
+	const GravityField& m_field;
+};
+
+}
+
+#endif // GRAVITYFIELD_HPP_
@@ -2,67 +2,113 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include "Fluid/Fluid.hpp"
 #include "Fluid/Grid.hpp"
 #include "Fluid/GridCell.hpp"
 #include "Fluid/Star.hpp"
 #include "MPI/MPI_Wrapper.hpp"
+#include "Misc/Parallel.hpp"
+#include "Misc/Profiler.hpp"
 #include "Torch/Constants.hpp"
 
 Hydrodynamics::Hydrodynamics()
 : Integrator("Hydrodynamics")
 { }
 
+/**
+ * @brief Nothing to do: the Fluid conversion passes cache the sound speeds along with the primitive variables.
+ */
 void Hydrodynamics::preTimeStepCalculations(Fluid& fluid) const {
-	for (GridCell& cell : fluid.getGrid().getIterable("GridCells"))
-		cell.setSoundSpeed(fluid.calcSoundSpeed(cell.heatCapacityRatio, cell.Q[UID::PRE], cell.Q[UID::DEN]));
+	(void)fluid;
 }
 
 void Hydrodynamics::initialise(std::shared_ptr<Constants> c) {
 	m_consts = std::move(c);
-	m_riemannSolver = std::move(RiemannSolverFactory::create("default", m_consts->nd));
+	setRiemannSolver(std::move(RiemannSolverFactory::create("default", m_consts->nd)));
+	m_fallbackSolver = std::move(RiemannSolverFactory::create("HLL", m_consts->nd));
+	m_fallbackSolver->setCheckFluxes(m_consts->checkLevel == CheckLevel::PARANOID);
 	m_slopeLimiter = std::move(SlopeLimiterFactory::create("default"));
 }
 
+/**
+ * @brief Applies the boundary conditions and accumulates the fluxes into GridCell::UDOT.
+ *
+ * This is the only place the ghost cells' primitive variables are filled during a step: once per stage, just before the
+ * sweeps that read them, and spatialOrder + 1 layers deep, as many as the reconstruction reaches. The conversions
+ * between the conserved and primitive variables and the other integrators only update the core cells. The halo exchange
+ * with neighbouring processors is left in flight while calcFluxes sweeps the dimensions that do not need it.
+ * @param dt Time step.
+ * @param fluid The Fluid.
+ */
 void Hydrodynamics::integrate(double dt, Fluid& fluid) const {
-	fluid.getGrid().applyBCs();
+	fluid.getGrid().applyBCsAsync();
 	calcFluxes(fluid);
 }
 
 void Hydrodynamics::setRiemannSolver(std::unique_ptr<RiemannSolver> riemannSolver) {
 	m_riemannSolver = std::move(riemannSolver);
+	if (m_consts != nullptr)
+		m_riemannSolver->setCheckFluxes(m_consts->checkLevel == CheckLevel::PARANOID);
 }
 
 void Hydrodynamics::setSlopeLimiter(std::unique_ptr<SlopeLimiter> slopeLimiter) {
 	m_slopeLimiter = std::move(slopeLimiter);
 }
 
-void Hydrodynamics::piecewiseLinear(FluidArray& Q_l, FluidArray& Q_c, FluidArray& Q_r, FluidArray& left_interp, FluidArray& right_interp) const {
-	for (int iq = 0; iq < UID::N; ++iq) {
-		double dQdr = m_slopeLimiter->calculate(Q_c[iq] - Q_l[iq], Q_r[iq] - Q_c[iq]);
-		left_interp[iq] = Q_c[iq] - 0.5*dQdr;
-		right_interp[iq] = Q_c[iq] + 0.5*dQdr;
-	}
+/**
+ * @brief Sets the CFL number, the fraction of the time a signal takes to cross a cell that the time step may be.
+ * @exception std::runtime_error Thrown if cfl is not in (0, 1].
+ */
+void Hydrodynamics::setCFL(double cfl) {
+	if (!(cfl > 0 && cfl <= 1))
+		throw std::runtime_error("Hydrodynamics::setCFL: cfl(=" + std::to_string(cfl) + ") must be in (0, 1].");
+	m_cfl = cfl;
 }
 
-void Hydrodynamics::reconstruct(Fluid& fluid) const {
-	for (GridCell& cell : fluid.getGrid().getIterable("GridCells")) {
-		for (int dim = 0; dim < m_consts->nd; ++dim) {
-			GridCell& left = fluid.getGrid().left(dim, cell);
-			GridCell& right = fluid.getGrid().right(dim, cell);
-			piecewiseLinear(left.Q, cell.Q, right.Q, cell.QL[dim], cell.QR[dim]);
-		}
+/**
+ * @brief Finds the fluxes without reconstruction and with the HLL solver, the most diffusive and robust choice, while
+ * isFallback is set, for retaking a step that left invalid cells (see Torch::guardHydroStep).
+ */
+void Hydrodynamics::setFallback(bool isFallback) {
+	m_isFallback = isFallback;
+}
+
+/**
+ * @brief Sweeps the fluxes in tiles of tileSize cells along each side (see Hydrodynamics::sweepTiles).
+ * @param tileSize Number of cells along each side of a tile (0 sweeps whole pencils, one dimension at a time).
+ * @exception std::runtime_error Thrown if tileSize is negative.
+ */
+void Hydrodynamics::setTileSize(int tileSize) {
+	if (tileSize < 0)
+		throw std::runtime_error("Hydrodynamics::setTileSize: tile_size(=" + std::to_string(tileSize) + ") must not be negative.");
+	m_tileSize = tileSize;
+}
+
+/**
+ * @brief Skips the tiles whose fluxes cancel exactly (see Hydrodynamics::markActiveTiles) in a Cartesian Grid, such as the
+ * static uniform medium ahead of a shock. The fluxes are then swept in tiles, of quiescentTileSize cells along each
+ * side if the tile size is 0. The results do not depend on it.
+ */
+void Hydrodynamics::setSkipQuiescent(bool skipQuiescent) {
+	m_skipQuiescent = skipQuiescent;
+}
+
+void Hydrodynamics::piecewiseLinear(FluidArray& Q_l, FluidArray& Q_c, FluidArray& Q_r, FluidArray& left_interp, FluidArray& right_interp) const {
+	FluidArray dl, dr, dQdr;
+	for (int iq = 0; iq < UID::N; ++iq) {
+		dl[iq] = Q_c[iq] - Q_l[iq];
+		dr[iq] = Q_r[iq] - Q_c[iq];
 	}
-	for (int dim = 0; dim < m_consts->nd; ++dim) {
-		for (GridCell& cell : fluid.getGrid().getIterable("GhostCells"+std::to_string(dim))) {
-			GridCell& left = fluid.getGrid().left(dim, cell);
-			GridCell& right = fluid.getGrid().right(dim, cell);
-			piecewiseLinear(left.Q, cell.Q, right.Q, cell.QL[dim], cell.QR[dim]);
-		}
+	m_slopeLimiter->limit(dl.data(), dr.data(), dQdr.data(), UID::N);
+	for (int iq = 0; iq < UID::N; ++iq) {
+		left_interp[iq] = Q_c[iq] - 0.5*dQdr[iq];
+		right_interp[iq] = Q_c[iq] + 0.5*dQdr[iq];
 	}
 }
 
@@ -74,83 +120,613 @@ double Hydrodynamics::soundSpeed(const double pre, const double den, const doubl
 	return std::sqrt(soundSpeedSqrd(pre, den, gamma));
 }
 
+/**
+ * @brief Calculates the CFL limited time step.
+ *
+ * The largest signal rate of the cells is cached by the conversion pass (Fluid::fixPrimitives, Fluid::updatePrimitives
+ * or Fluid::advanceAndFix) that must have followed the last change to the primitive variables.
+ * @param dt_max Maximum time step.
+ * @param fluid The Fluid.
+ * @return The time step.
+ */
 double Hydrodynamics::calculateTimeStep(double dt_max, Fluid& fluid) const {
-	double tmin = dt_max;
-	for (GridCell& cell : fluid.getGrid().getIterable("GridCells")) {
-		double inv_t = 0;
-		double ss = soundSpeed(cell.Q[UID::PRE], cell.Q[UID::DEN], fluid.heatCapacityRatio);
-		for (int dim = 0; dim < m_consts->nd; ++dim)
-			inv_t += (fabs(cell.Q[UID::VEL+dim]) + ss)/fluid.getGrid().dx[dim];
-		if (inv_t == 0)
-			inv_t = 1.0/dt_max;
-		tmin = std::min(tmin, 0.5/inv_t);
+	const double rate = fluid.getMaxSignalRate();
+	const bool isLimiting = rate > 0 && m_cfl/rate < dt_max;
+	timeStepLimiter.criterion = isLimiting ? TimeStepCriterion::CFL : TimeStepCriterion::MAX;
+	timeStepLimiter.cellID = isLimiting ? fluid.getMaxSignalCell() : -1;
+	return isLimiting ? m_cfl/rate : dt_max;
+}
+
+/**
+ * @brief Number of cell updates one step of dt would cost this processor under hierarchical local time stepping.
+ *
+ * Each cell is put in the power of two bin k of dt its own CFL time step allows, dt*2^k (up to 2^10), and would only
+ * be updated every 2^k steps, so it counts as 2^-k updates. The ratio of the cells to the sum over the processors
+ * bounds the speed up of the hydrodynamics that local time stepping could give.
+ * @param dt The smallest CFL time step of the Grid, which the fastest bin takes.
+ * @param fluid The Fluid.
+ * @return The cell updates per step.
+ */
+double Hydrodynamics::localTimeStepUpdates(double dt, const Fluid& fluid) const {
+	const int maxBin = 10;
+	double updates = 0;
+	for (const GridCell& cell : fluid.getGrid().getIterable(CellRange::GRID_CELLS)) {
+		const double rate = fluid.signalRate(cell, fluid.calcSoundSpeed(cell.heatCapacityRatio, cell.Q[UID::PRE], cell.Q[UID::DEN]));
+		const double dt_cell = (rate > 0) ? m_cfl/rate : dt*std::ldexp(1.0, maxBin);
+		int bin = 0;
+		while (bin < maxBin && dt_cell >= dt*std::ldexp(1.0, bin + 1))
+			++bin;
+		updates += std::ldexp(1.0, -bin);
 	}
-	return std::min(tmin, dt_max);
+	return updates;
+}
+
+/**
+ * @brief Selects the flux and source term kernels that are specialised on the number of dimensions, spatial order and
+ * geometry of the simulation.
+ *
+ * Must be called once the Grid has been set up and before the first call to integrate or updateSourceTerms.
+ * @param spatialOrder Spatial order of the reconstruction: 0 for none, 1 for piecewise linear and 2 for piecewise
+ * parabolic (see Hydrodynamics::piecewiseParabolic), which needs a Grid with three ghost cells deep.
+ * @param geometry Geometry of the Grid.
+ * @exception std::runtime_error Thrown if the number of dimensions or spatial order is not supported.
+ */
+void Hydrodynamics::specialise(int spatialOrder, Geometry geometry) {
+	static const Kernel fluxKernels[3][3][2] = {
+		{ { &Hydrodynamics::fluxKernel<1, 0, false>, &Hydrodynamics::fluxKernel<1, 0, true> },
+		  { &Hydrodynamics::fluxKernel<1, 1, false>, &Hydrodynamics::fluxKernel<1, 1, true> },
+		  { &Hydrodynamics::fluxKernel<1, 2, false>, &Hydrodynamics::fluxKernel<1, 2, true> } },
+		{ { &Hydrodynamics::fluxKernel<2, 0, false>, &Hydrodynamics::fluxKernel<2, 0, true> },
+		  { &Hydrodynamics::fluxKernel<2, 1, false>, &Hydrodynamics::fluxKernel<2, 1, true> },
+		  { &Hydrodynamics::fluxKernel<2, 2, false>, &Hydrodynamics::fluxKernel<2, 2, true> } },
+		{ { &Hydrodynamics::fluxKernel<3, 0, false>, &Hydrodynamics::fluxKernel<3, 0, true> },
+		  { &Hydrodynamics::fluxKernel<3, 1, false>, &Hydrodynamics::fluxKernel<3, 1, true> },
+		  { &Hydrodynamics::fluxKernel<3, 2, false>, &Hydrodynamics::fluxKernel<3, 2, true> } }
+	};
+
+	if (m_consts->nd < 1 || m_consts->nd > 3)
+		throw std::runtime_error("Hydrodynamics::specialise: invalid number of dimensions(=" + std::to_string(m_consts->nd) + "). Valid values = {1, 2, 3}.");
+	if (spatialOrder < 0 || spatialOrder > 2)
+		throw std::runtime_error("Hydrodynamics::specialise: invalid order(=" + std::to_string(spatialOrder) + "). Valid orders = {0, 1, 2}.");
+	m_fluxKernel = fluxKernels[m_consts->nd - 1][spatialOrder][0];
+	m_uniformGammaFluxKernel = fluxKernels[m_consts->nd - 1][spatialOrder][1];
+	m_fallbackFluxKernel = fluxKernels[m_consts->nd - 1][0][0];
+	m_uniformGammaFallbackFluxKernel = fluxKernels[m_consts->nd - 1][0][1];
+
+	m_geometry = geometry;
+	selectSourceKernel();
+}
+
+/**
+ * @brief Sets the external gravitational field and selects the source term kernel that works it out (see
+ * GravityProvider). The field is read from the Grid until this is called.
+ * @param gravity The field, in code units.
+ */
+void Hydrodynamics::setGravity(const GravityField& gravity) {
+	m_gravity = gravity;
+	selectSourceKernel();
+}
+
+/**
+ * @brief Selects the source term kernel specialised on the geometry of the Grid and the gravity model.
+ */
+void Hydrodynamics::selectSourceKernel() {
+	static const Kernel sourceKernels[3][5] = {
+		{ &Hydrodynamics::sourceKernel<Geometry::CARTESIAN, GravityProvider::Field>,
+		  &Hydrodynamics::sourceKernel<Geometry::CARTESIAN, GravityProvider::None>,
+		  &Hydrodynamics::sourceKernel<Geometry::CARTESIAN, GravityProvider::PointMass>,
+		  &Hydrodynamics::sourceKernel<Geometry::CARTESIAN, GravityProvider::IsothermalSphere>,
+		  &Hydrodynamics::sourceKernel<Geometry::CARTESIAN, GravityProvider::Uniform> },
+		{ &Hydrodynamics::sourceKernel<Geometry::CYLINDRICAL, GravityProvider::Field>,
+		  &Hydrodynamics::sourceKernel<Geometry::CYLINDRICAL, GravityProvider::None>,
+		  &Hydrodynamics::sourceKernel<Geometry::CYLINDRICAL, GravityProvider::PointMass>,
+		  &Hydrodynamics::sourceKernel<Geometry::CYLINDRICAL, GravityProvider::IsothermalSphere>,
+		  &Hydrodynamics::sourceKernel<Geometry::CYLINDRICAL, GravityProvider::Uniform> },
+		{ &Hydrodynamics::sourceKernel<Geometry::SPHERICAL, GravityProvider::Field>,
+		  &Hydrodynamics::sourceKernel<Geometry::SPHERICAL, GravityProvider::None>,
+		  &Hydrodynamics::sourceKernel<Geometry::SPHERICAL, GravityProvider::PointMass>,
+		  &Hydrodynamics::sourceKernel<Geometry::SPHERICAL, GravityProvider::IsothermalSphere>,
+		  &Hydrodynamics::sourceKernel<Geometry::SPHERICAL, GravityProvider::Uniform> }
+	};
+	m_sourceKernel = sourceKernels[(unsigned int)m_geometry][(unsigned int)m_gravity.model];
 }
 
+/**
+ * @brief Calculates the fluxes through every cell face and accumulates them into GridCell::UDOT.
+ *
+ * The fluxes are computed pencil by pencil along each dimension (see Hydrodynamics::sweepPencils) so that the cells
+ * either side of a face are found by stride arithmetic rather than through the GridJoin cell IDs, or, with a tile size,
+ * tile by tile (see Hydrodynamics::sweepTiles). Dimensions without a PARTITION boundary are swept first, then
+ * Grid::waitBCs is called before the remaining dimensions are swept, so a halo exchange posted by Grid::applyBCsAsync
+ * overlaps with the interior sweeps. Every cell still adds the fluxes of its dimensions in order, whatever the
+ * decomposition (see Hydrodynamics::fluxKernel). If the Fluid has a uniform heat capacity ratio (see Fluid::hasUniformGamma) the
+ * sweeps use it in place of the GridCell::heatCapacityRatio of the cells either side of each face.
+ * @param fluid The Fluid.
+ * @exception std::runtime_error Thrown if Hydrodynamics::specialise has not been called.
+ */
 void Hydrodynamics::calcFluxes(Fluid& fluid) const {
+	ScopedTimer timer(ProfileID::HYDRO_FLUXES, fluid.getGrid().getIterable(CellRange::GRID_CELLS).size());
+	if (m_fluxKernel == nullptr)
+		throw std::runtime_error("Hydrodynamics::calcFluxes: no flux kernel selected, call Hydrodynamics::specialise first.");
+	if (m_isFallback)
+		(this->*(fluid.hasUniformGamma() ? m_uniformGammaFallbackFluxKernel : m_fallbackFluxKernel))(fluid);
+	else
+		(this->*(fluid.hasUniformGamma() ? m_uniformGammaFluxKernel : m_fluxKernel))(fluid);
+}
+
+template <int ND, int ORDER, bool UNIFORM_GAMMA>
+void Hydrodynamics::fluxKernel(Fluid& fluid) const {
+	Grid& grid = fluid.getGrid();
+	const bool skip = m_skipQuiescent && m_geometry == Geometry::CARTESIAN;
+	const int tileSize = (m_tileSize == 0 && skip) ? quiescentTileSize : m_tileSize;
+	if (skip)
+		markActiveTiles(ND, tileSize, ORDER + 1, UNIFORM_GAMMA, grid);
+	else
+		m_activeTiles.clear();
+
+	// The dimensions before the first partitioned one are added to GridCell::UDOT as they are swept. Those after it that
+	// are not partitioned are solved before Grid::waitBCs too, but their fluxes are held and only added in their turn
+	// after it, so every cell sums the fluxes of its dimensions in order and a run gives the same results on any number of
+	// processors. The held products are the ones the sweep would have added, so this relies on them not being contracted
+	// into FMAs (TORCH_MULTIVERSION builds with -ffp-contract=off).
+	unsigned before = 0, held = 0, after = 0;
+	bool isSplit = false;
+	for (int dim = 0; dim < ND; ++dim) {
+		isSplit = isSplit || grid.isPartitioned(dim);
+		if (!isSplit)
+			before |= 1u << dim;
+		else if (grid.isPartitioned(dim))
+			after |= 1u << dim;
+		else
+			held |= 1u << dim;
+	}
+	const std::size_t ncore = grid.getIterable(CellRange::GRID_CELLS).size();
+	for (int dim = 0; dim < ND; ++dim)
+		if (held & (1u << dim))
+			m_heldFluxes[dim].resize(2*ncore);
+
+	if (tileSize > 0) {
+		sweepTiles<ORDER, UNIFORM_GAMMA>(ND, tileSize, before | held, held, 0, fluid);
+		grid.waitBCs();
+		sweepTiles<ORDER, UNIFORM_GAMMA>(ND, tileSize, after, 0, held, fluid);
+		return;
+	}
+	for (int dim = 0; dim < ND; ++dim)
+		if ((before | held) & (1u << dim))
+			sweepPencils<ORDER, UNIFORM_GAMMA>(dim, (held & (1u << dim)) != 0, fluid);
+	grid.waitBCs();
+	for (int dim = 0; dim < ND; ++dim) {
+		if (after & (1u << dim))
+			sweepPencils<ORDER, UNIFORM_GAMMA>(dim, false, fluid);
+		else if (held & (1u << dim))
+			Parallel::forEach(0, (int)ncore, [&](int id) { addHeldFluxes(dim, id, grid); });
+	}
+}
+
+/**
+ * @brief Adds the fluxes through the faces of a core cell along dim held by a sweep (see Hydrodynamics::fluxKernel) to its
+ * GridCell::UDOT, the left face before the right as Hydrodynamics::sweepPencil adds them.
+ */
+void Hydrodynamics::addHeldFluxes(int dim, int cellID, Grid& grid) const {
+	GridCell& cell = grid.getCells()[cellID];
+	const FluidArray& left = m_heldFluxes[dim][2*cellID];
+	const FluidArray& right = m_heldFluxes[dim][2*cellID + 1];
+	for (int i = 0; i < UID::N; ++i)
+		cell.UDOT[i] += left[i];
+	for (int i = 0; i < UID::N; ++i)
+		cell.UDOT[i] -= right[i];
+}
+
+/**
+ * @brief Sizes the buffers of a SweepWorkspace for pencils of up to n core cells, reconstructed to the given order.
+ *
+ * The heat capacity ratio of every face is set to uniformGamma once here if it is positive, otherwise it is filled in
+ * for each pencil from the cells.
+ */
+void Hydrodynamics::SweepWorkspace::resize(int n, int order, double uniformGamma) {
+	const std::size_t nvalues = (n + 2)*UID::N;
+	if (order == 1) {
+		dl.resize(nvalues);
+		dr.resize(nvalues);
+		slope.resize(nvalues);
+	}
+	else if (order == 2) {
+		// The parabolae of the n + 2 cells of a pencil need the slopes of one more cell and the values of two more at each end.
+		dl.resize(nvalues + 2*UID::N);
+		dr.resize(nvalues + 2*UID::N);
+		slope.resize(nvalues + 2*UID::N);
+		q.resize(nvalues + 4*UID::N);
+		edges.resize(nvalues + UID::N);
+		Q_m.resize(nvalues);
+		Q_p.resize(nvalues);
+	}
+	Q_l.resize(n + 1);
+	Q_r.resize(n + 1);
+	F.assign(n + 1, FluidArray());
+	a_l2.resize(n + 1);
+	a_r2.resize(n + 1);
+	if (uniformGamma > 0)
+		gamma.assign(n + 1, uniformGamma);
+	else
+		gamma.resize(n + 1);
+}
+
+/**
+ * @brief Solves the Riemann problem on every face along dimension dim and adds the fluxes to the neighbouring cells.
+ *
+ * A pencil (see Grid::getPencil) is a line of cells along dim that is bounded by a ghost cell at each end, so the only
+ * lookups that are not strided are the ghost cells and the face areas. Every GridCell belongs to exactly one pencil along
+ * dim, so the pencils are shared out between threads, each with its own SweepWorkspace, which the sweeps reuse.
+ * @param dim Dimension to sweep along.
+ * @param hold Hold the fluxes in m_heldFluxes rather than adding them (see Hydrodynamics::fluxKernel).
+ * @param fluid The Fluid.
+ * @see Hydrodynamics::sweepPencil
+ */
+template <int ORDER, bool UNIFORM_GAMMA>
+void Hydrodynamics::sweepPencils(int dim, bool hold, Fluid& fluid) const {
+	Grid& grid = fluid.getGrid();
+	const std::array<int, 3>& ncore = grid.coreCells;
+	m_workspaces.resize(Parallel::maxThreads());
+	for (SweepWorkspace& ws : m_workspaces)
+		ws.resize(ncore[dim], ORDER, UNIFORM_GAMMA ? fluid.heatCapacityRatio : 0);
+
+	const int n1 = ncore[(dim + 1)%3];
+	const int npencils = n1*ncore[(dim + 2)%3];
+	Parallel::forEach(0, npencils, [&](int ipencil) {
+		SweepWorkspace& ws = m_workspaces[Parallel::threadID()];
+		grid.getPencil(dim, ipencil%n1, ipencil/n1, ws.pencil);
+		sweepPencil<ORDER, UNIFORM_GAMMA>(dim, grid, ws, hold ? m_heldFluxes[dim].data() : nullptr);
+		if (Parallel::threadID() == 0)
+			MPIW::Instance().progress();
+	});
+}
+
+/**
+ * @brief Sweeps the faces of the Grid tile by tile along some of the dimensions, and adds the fluxes held along others.
+ *
+ * A tile is a block of up to tile_size cells along each dimension. The dimensions of a tile are taken in order, one
+ * after the other, while its cells are still in cache, along pencils that only run across the tile. The faces on the
+ * sides of a tile are solved by both of the tiles they separate, each adding the flux to its own cells only, so the
+ * tiles can be shared out between threads. Every cell still has the fluxes of its dimensions added in the order
+ * Hydrodynamics::sweepPencils adds them. The tiles that Hydrodynamics::markActiveTiles found quiescent are skipped.
+ * @param nd Number of dimensions.
+ * @param tileSize Number of cells along each side of a tile.
+ * @param sweep Bit mask of the dimensions to sweep.
+ * @param hold Bit mask of the swept dimensions whose fluxes are held in m_heldFluxes rather than added.
+ * @param add Bit mask of the dimensions whose held fluxes are added.
+ * @param fluid The Fluid.
+ */
+template <int ORDER, bool UNIFORM_GAMMA>
+void Hydrodynamics::sweepTiles(int nd, int tileSize, unsigned sweep, unsigned hold, unsigned add, Fluid& fluid) const {
 	Grid& grid = fluid.getGrid();
+	const std::array<int, 3>& ncore = grid.coreCells;
+	if ((sweep | add) == 0)
+		return;
+
+	std::array<int, 3> ntiles;
+	for (int i = 0; i < 3; ++i)
+		ntiles[i] = (ncore[i] + tileSize - 1)/tileSize;
+	m_workspaces.resize(Parallel::maxThreads());
+	for (SweepWorkspace& ws : m_workspaces)
+		ws.resize(tileSize, ORDER, UNIFORM_GAMMA ? fluid.heatCapacityRatio : 0);
 
-	if (grid.spatialOrder == 1)
-		reconstruct(fluid);
-	for (int dim = 0; dim < m_consts->nd; ++dim){
-		for (GridJoin& join  : grid.getJoins(dim)) {
-			GridCell& left = grid.joinedLeft(join);
-			GridCell& right = grid.joinedRight(join);
-			if (fluid.getGrid().spatialOrder == 1) {
-				double a_l2 = soundSpeedSqrd(left.QR[dim][UID::PRE], left.QR[dim][UID::DEN], left.heatCapacityRatio);
-				double a_r2 = soundSpeedSqrd(right.QL[dim][UID::PRE], right.QL[dim][UID::DEN], right.heatCapacityRatio);
-				m_riemannSolver->solve(join.F, left.QR[dim], right.QL[dim], a_l2, a_r2, left.heatCapacityRatio, dim);
+	Parallel::forEach(0, ntiles[0]*ntiles[1]*ntiles[2], [&](int itile) {
+		if (!m_activeTiles.empty() && !m_activeTiles[itile])
+			return;
+		SweepWorkspace& ws = m_workspaces[Parallel::threadID()];
+		const std::array<int, 3> tile = std::array<int, 3>{{ itile%ntiles[0], (itile/ntiles[0])%ntiles[1], itile/(ntiles[0]*ntiles[1]) }};
+		std::array<int, 3> lo, hi;
+		for (int i = 0; i < 3; ++i) {
+			lo[i] = tile[i]*tileSize;
+			hi[i] = std::min(ncore[i], lo[i] + tileSize);
+		}
+		for (int dim = 0; dim < nd; ++dim) {
+			if (add & (1u << dim)) {
+				for (int k = lo[2]; k < hi[2]; ++k)
+					for (int j = lo[1]; j < hi[1]; ++j)
+						for (int i = lo[0]; i < hi[0]; ++i)
+							addHeldFluxes(dim, grid.flatIndex(i, j, k), grid);
+			}
+			if (!(sweep & (1u << dim)))
+				continue;
+			FluidArray* held = (hold & (1u << dim)) ? m_heldFluxes[dim].data() : nullptr;
+			const int d1 = (dim + 1)%3, d2 = (dim + 2)%3;
+			for (int j2 = lo[d2]; j2 < hi[d2]; ++j2) {
+				for (int j1 = lo[d1]; j1 < hi[d1]; ++j1) {
+					grid.getPencil(dim, j1, j2, lo[dim], hi[dim], ws.pencil);
+					sweepPencil<ORDER, UNIFORM_GAMMA>(dim, grid, ws, held);
+				}
 			}
-			else if (fluid.getGrid().spatialOrder == 0) {
-				double a_l2 = soundSpeedSqrd(left.Q[UID::PRE], left.Q[UID::DEN], left.heatCapacityRatio);
-				double a_r2 = soundSpeedSqrd(right.Q[UID::PRE], right.Q[UID::DEN], right.heatCapacityRatio);
-				m_riemannSolver->solve(join.F, left.Q, right.Q, a_l2, a_r2, left.heatCapacityRatio, dim);
+		}
+		if (Parallel::threadID() == 0)
+			MPIW::Instance().progress();
+	});
+}
+
+/**
+ * @brief Marks the tiles (see Hydrodynamics::sweepTiles) that have fluxes to add to their cells in m_activeTiles.
+ *
+ * A tile is quiescent if its cells and the halo cells around it, as far as the reconstruction of its faces reaches,
+ * hold exactly the same primitive variables (and heat capacity ratio, unless uniformGamma), whatever their velocity.
+ * Every face of such a tile then has the same states and flux, and in a Cartesian Grid the face area over volume
+ * coefficients either side of a cell are equal, so the fluxes added to a cell's GridCell::UDOT, which is zero when the
+ * sweeps start, cancel exactly and the tile can be skipped without changing the results. A tile whose halo runs past
+ * the core cells is never quiescent, so the ghost cells need not be filled yet. The tiles are compared every sweep,
+ * which costs a read of each cell (and stops at the first difference), much less than its reconstruction and Riemann
+ * problems.
+ * @param nd Number of dimensions.
+ * @param tileSize Number of cells along each side of a tile.
+ * @param halo Number of cells beyond a tile that its reconstruction reaches (spatialOrder + 1).
+ * @param uniformGamma Whether the Fluid has a uniform heat capacity ratio, so the cells' own are not read.
+ * @param grid The Grid.
+ */
+void Hydrodynamics::markActiveTiles(int nd, int tileSize, int halo, bool uniformGamma, Grid& grid) const {
+	const GridCellVector& cells = grid.getCells();
+	const std::array<int, 3>& ncore = grid.coreCells;
+	std::array<int, 3> ntiles;
+	for (int i = 0; i < 3; ++i)
+		ntiles[i] = (ncore[i] + tileSize - 1)/tileSize;
+	m_activeTiles.assign(ntiles[0]*ntiles[1]*ntiles[2], 1);
+
+	Parallel::forEach(0, ntiles[0]*ntiles[1]*ntiles[2], [&](int itile) {
+		const std::array<int, 3> tile = std::array<int, 3>{{ itile%ntiles[0], (itile/ntiles[0])%ntiles[1], itile/(ntiles[0]*ntiles[1]) }};
+		std::array<int, 3> lo, hi;
+		for (int i = 0; i < 3; ++i) {
+			lo[i] = tile[i]*tileSize;
+			hi[i] = std::min(ncore[i], lo[i] + tileSize);
+			if (i < nd) {
+				lo[i] -= halo;
+				hi[i] += halo;
+				if (lo[i] < 0 || hi[i] > ncore[i])
+					return;
 			}
-			else {
-				throw std::runtime_error("Hydrodynamics::calcFluxes: invalid order(=" + std::to_string(fluid.getGrid().spatialOrder) + "). Valid orders = {0, 1}.");
+		}
+		const GridCell& first = cells[grid.flatIndex(lo[0], lo[1], lo[2])];
+		for (int k = lo[2]; k < hi[2]; ++k) {
+			for (int j = lo[1]; j < hi[1]; ++j) {
+				for (int i = lo[0]; i < hi[0]; ++i) {
+					const GridCell& cell = cells[grid.flatIndex(i, j, k)];
+					if (std::memcmp(cell.Q.data(), first.Q.data(), sizeof(cell.Q)) != 0
+							|| (!uniformGamma && cell.heatCapacityRatio != first.heatCapacityRatio))
+						return;
+				}
 			}
 		}
-	}
+		m_activeTiles[itile] = 0;
+	});
 }
 
-void Hydrodynamics::updateSourceTerms(double dt, Fluid& fluid) const {
-	bool rtp = (fluid.getGrid().geometry == Geometry::SPHERICAL);
-	bool rzp = (fluid.getGrid().geometry == Geometry::CYLINDRICAL);
+/**
+ * @brief Solves the Riemann problem on every face of the pencil in ws and adds the fluxes to its core cells.
+ *
+ * At first and second order the face states are reconstructed on the fly: the left and right differences of every cell
+ * in the pencil are laid out contiguously, limited by a single SlopeLimiter::limit call and turned into face states in
+ * local buffers, so nothing is written back to the cells. At ORDER 2 the face states are the edges of the parabolae of
+ * Hydrodynamics::piecewiseParabolic. The face states of a pencil are handed to RiemannSolver::solveBatch
+ * in one call. The cells at the ends of the pencil do not have fluxes added to GridCell::UDOT; the left face of a cell is
+ * added before its right face, which keeps the summation order of the per cell loop this replaces. With UNIFORM_GAMMA
+ * the heat capacity ratios in ws are already filled in and the cells' own are not read.
+ * @param dim Dimension the pencil runs along.
+ * @param grid The Grid.
+ * @param ws Workspace holding the pencil (see Grid::getPencil), sized for it.
+ * @param held Fluxes through the left and right faces of each core cell, indexed by 2*GridCell::id and 2*GridCell::id + 1,
+ * which the fluxes are written to instead of being added to GridCell::UDOT (nullptr to add them).
+ */
+template <int ORDER, bool UNIFORM_GAMMA>
+void Hydrodynamics::sweepPencil(int dim, Grid& grid, SweepWorkspace& ws, FluidArray* held) const {
+	GridCellVector& cells = grid.getCells();
+	const std::vector<int>& pencil = ws.pencil;
+	const int ncells = (int)pencil.size();
+	const int nfaces = ncells - 1;
+	const std::size_t nvalues = ncells*UID::N;
+	std::vector<double>& dl = ws.dl;
+	std::vector<double>& dr = ws.dr;
+	std::vector<double>& slope = ws.slope;
+	std::vector<FluidArray>& Q_l = ws.Q_l;
+	std::vector<FluidArray>& Q_r = ws.Q_r;
+	std::vector<FluidArray>& F = ws.F;
+	std::vector<double>& a_l2 = ws.a_l2;
+	std::vector<double>& a_r2 = ws.a_r2;
+	std::vector<double>& gamma = ws.gamma;
 
-	Grid& grid = fluid.getGrid();
+	if (ORDER == 1) {
+		for (int k = 0; k < ncells; ++k) {
+			const FluidArray& Q_lc = cells[k == 0 ? cells[pencil[0]].leftID[dim] : pencil[k - 1]].Q;
+			const FluidArray& Q_c = cells[pencil[k]].Q;
+			const FluidArray& Q_rc = cells[k == ncells - 1 ? cells[pencil[k]].rightID[dim] : pencil[k + 1]].Q;
+			for (int iq = 0; iq < UID::N; ++iq) {
+				dl[k*UID::N + iq] = Q_c[iq] - Q_lc[iq];
+				dr[k*UID::N + iq] = Q_rc[iq] - Q_c[iq];
+			}
+		}
+
+		m_slopeLimiter->limit(dl.data(), dr.data(), slope.data(), nvalues);
 
-	for (GridCell& cell : grid.getIterable("GridCells")) {
-		//Fluxes.
-		for (int dim = 0; dim < m_consts->nd; ++dim) {
-			for (int i = 0; i < UID::N; ++i) {
-				if (!grid.joinExists(dim, cell.ljoinID) || !grid.joinExists(dim, cell.rjoinID))
-					throw std::runtime_error("Hydrodynamics::updateSourceTerms: ljoin[dim] or rjoin[dim] is nullptr." + cell.printInfo());
-				cell.UDOT[i] += (grid.leftJoin(dim, cell).area/cell.vol)*grid.leftJoin(dim, cell).F[i];
-				cell.UDOT[i] -= (grid.rightJoin(dim, cell).area/cell.vol)*grid.rightJoin(dim, cell).F[i];
+		// Right face state of cell k is the left state of face k, left face state of cell k+1 its right state.
+		for (int iface = 0; iface < nfaces; ++iface) {
+			const FluidArray& Q_lc = cells[pencil[iface]].Q;
+			const FluidArray& Q_rc = cells[pencil[iface + 1]].Q;
+			for (int iq = 0; iq < UID::N; ++iq) {
+				Q_l[iface][iq] = Q_lc[iq] + 0.5*slope[iface*UID::N + iq];
+				Q_r[iface][iq] = Q_rc[iq] - 0.5*slope[(iface + 1)*UID::N + iq];
 			}
 		}
+	}
+	else if (ORDER == 2) {
+		piecewiseParabolic(dim, grid, ws);
+		for (int iface = 0; iface < nfaces; ++iface) {
+			for (int iq = 0; iq < UID::N; ++iq) {
+				Q_l[iface][iq] = ws.Q_p[iface*UID::N + iq];
+				Q_r[iface][iq] = ws.Q_m[(iface + 1)*UID::N + iq];
+			}
+		}
+	}
+	else {
+		for (int iface = 0; iface < nfaces; ++iface) {
+			Q_l[iface] = cells[pencil[iface]].Q;
+			Q_r[iface] = cells[pencil[iface + 1]].Q;
+		}
+	}
 
-		for (int i = 0; i < 3; ++i) {
-			cell.UDOT[UID::VEL+i] += cell.GRAV[i];
-			cell.UDOT[UID::PRE] += cell.Q[UID::VEL+i]*cell.GRAV[i];
+	if (UNIFORM_GAMMA) {
+		const double g = gamma[0];
+		for (int iface = 0; iface < nfaces; ++iface) {
+			a_l2[iface] = soundSpeedSqrd(Q_l[iface][UID::PRE], Q_l[iface][UID::DEN], g);
+			a_r2[iface] = soundSpeedSqrd(Q_r[iface][UID::PRE], Q_r[iface][UID::DEN], g);
+		}
+	}
+	else {
+		for (int iface = 0; iface < nfaces; ++iface) {
+			const GridCell& left = cells[pencil[iface]];
+			const GridCell& right = cells[pencil[iface + 1]];
+			a_l2[iface] = soundSpeedSqrd(Q_l[iface][UID::PRE], Q_l[iface][UID::DEN], left.heatCapacityRatio);
+			a_r2[iface] = soundSpeedSqrd(Q_r[iface][UID::PRE], Q_r[iface][UID::DEN], right.heatCapacityRatio);
+			gamma[iface] = left.heatCapacityRatio;
 		}
+	}
 
-		//Geometric.
-		if (rzp) {
-			double r = fluid.getGrid().dx[0]*cell.xc[0];
-			cell.UDOT[UID::VEL+0] += cell.Q[UID::PRE]/r;
+	(m_isFallback ? m_fallbackSolver : m_riemannSolver)->solveBatch(nfaces, F.data(), Q_l.data(), Q_r.data(), a_l2.data(), a_r2.data(), gamma.data(), dim);
+
+	if (held != nullptr) {
+		for (int iface = 0; iface < nfaces; ++iface) {
+			if (iface != 0) {
+				const double coeff = grid.rightFaceOverVolume[pencil[iface]][dim];
+				FluidArray& flux = held[2*pencil[iface] + 1];
+				for (int i = 0; i < UID::N; ++i)
+					flux[i] = coeff*F[iface][i];
+			}
+			if (iface != nfaces - 1) {
+				const double coeff = grid.leftFaceOverVolume[pencil[iface + 1]][dim];
+				FluidArray& flux = held[2*pencil[iface + 1]];
+				for (int i = 0; i < UID::N; ++i)
+					flux[i] = coeff*F[iface][i];
+			}
+		}
+		return;
+	}
+	for (int iface = 0; iface < nfaces; ++iface) {
+		GridCell& left = cells[pencil[iface]];
+		GridCell& right = cells[pencil[iface + 1]];
+		if (iface != 0) {
+			const double coeff = grid.rightFaceOverVolume[left.id][dim];
+			for (int i = 0; i < UID::N; ++i)
+				left.UDOT[i] -= coeff*F[iface][i];
 		}
-		else if (rtp) {
-			double r, area1, area2;
-			area1 = grid.rightJoin(0, cell).area;
-			area2 = grid.leftJoin(0, cell).area;
-			r = cell.vol/(area1 - area2);
-			cell.UDOT[UID::VEL+0] += cell.Q[UID::PRE]/r;
+		if (iface != nfaces - 1) {
+			const double coeff = grid.leftFaceOverVolume[right.id][dim];
+			for (int i = 0; i < UID::N; ++i)
+				right.UDOT[i] += coeff*F[iface][i];
 		}
+	}
+}
+
+/**
+ * @brief Reconstructs the primitive variables of every cell of the pencil in ws as a parabola (the piecewise parabolic
+ * method of Colella & Woodward 1984), leaving its left and right edge states in ws.Q_m and ws.Q_p.
+ *
+ * The value at each face is interpolated to fourth order from the two cells either side of it, with their slopes limited
+ * by the SlopeLimiter, then the parabola of each cell is made monotone: a cell at an extremum is flattened to its mean
+ * and an edge that would make the parabola overshoot is pulled in until the other edge is an extremum. The stencil
+ * reaches three cells beyond the core cells, two past the ghost cells at the ends of the pencil, which are found through
+ * GridCell::leftID and GridCell::rightID. Every stage is a loop over the variables of contiguous cells that the compiler
+ * can vectorise.
+ * @param dim Dimension the pencil runs along.
+ * @param grid The Grid.
+ * @param ws Workspace holding the pencil (see Grid::getPencil), sized for it.
+ */
+void Hydrodynamics::piecewiseParabolic(int dim, Grid& grid, SweepWorkspace& ws) const {
+	const GridCellVector& cells = grid.getCells();
+	const std::vector<int>& pencil = ws.pencil;
+	const int ncells = (int)pencil.size();
+	const int N = UID::N;
+	double* q = ws.q.data();
+	double* dl = ws.dl.data();
+	double* dr = ws.dr.data();
+	double* slope = ws.slope.data();
+	double* edges = ws.edges.data();
+	double* Q_m = ws.Q_m.data();
+	double* Q_p = ws.Q_p.data();
+
+	// Cell m of q is cell m - 2 of the pencil.
+	const int left1 = cells[pencil[0]].leftID[dim];
+	const int right1 = cells[pencil[ncells - 1]].rightID[dim];
+	const int ends[4] = { cells[left1].leftID[dim], left1, right1, cells[right1].rightID[dim] };
+	for (int m = 0; m < ncells + 4; ++m) {
+		const int id = m < 2 ? ends[m] : (m < ncells + 2 ? pencil[m - 2] : ends[m - ncells]);
+		for (int iq = 0; iq < N; ++iq)
+			q[m*N + iq] = cells[id].Q[iq];
+	}
+
+	// Slope s belongs to cell s + 1 of q.
+	const int nslopes = (ncells + 2)*N;
+	for (int i = 0; i < nslopes; ++i) {
+		dl[i] = q[i + N] - q[i];
+		dr[i] = q[i + 2*N] - q[i + N];
+	}
+	m_slopeLimiter->limit(dl, dr, slope, nslopes);
+
+	// Face f lies between cells f + 1 and f + 2 of q, so cell k of the pencil has faces k and k + 1.
+	const int nedges = (ncells + 1)*N;
+	for (int i = 0; i < nedges; ++i)
+		edges[i] = 0.5*(q[i + N] + q[i + 2*N]) - (slope[i + N] - slope[i])/6.0;
 
+	const int nvalues = ncells*N;
+	for (int i = 0; i < nvalues; ++i) {
+		const double a = q[i + 2*N];
+		double a_m = edges[i];
+		double a_p = edges[i + N];
+		const double da = a_p - a_m;
+		const double a6 = 6.0*(a - 0.5*(a_m + a_p));
+		if ((a_p - a)*(a - a_m) <= 0) {
+			a_m = a;
+			a_p = a;
+		}
+		else if (da*a6 > da*da)
+			a_m = 3.0*a - 2.0*a_p;
+		else if (da*a6 < -da*da)
+			a_p = 3.0*a - 2.0*a_m;
+		Q_m[i] = a_m;
+		Q_p[i] = a_p;
 	}
+}
+
+void Hydrodynamics::updateSourceTerms(double dt, Fluid& fluid) const {
+	if (m_sourceKernel == nullptr)
+		throw std::runtime_error("Hydrodynamics::updateSourceTerms: no source kernel selected, call Hydrodynamics::specialise first.");
+	(this->*m_sourceKernel)(fluid);
+
+	if (fluid.getStar().on && fluid.getStar().windBoundary)
+		fluid.getStar().holdWind(fluid.getGrid());
+	else if (fluid.getStar().on)
+		fluid.getStar().injectEnergyMomentum(fluid.getGrid());
+}
 
-	if (fluid.getStar().on)
-		fluid.getStar().injectEnergyMomentum(grid);
+/**
+ * @brief Adds the gravitational and geometric source terms to GridCell::UDOT.
+ *
+ * The fluxes have already been added to UDOT by calcFluxes. The gravitational force density of each cell comes from
+ * the GRAVITY provider (see GravityProvider), inlined here.
+ * @param fluid The Fluid.
+ */
+template <Geometry GEOMETRY, class GRAVITY>
+void Hydrodynamics::sourceKernel(Fluid& fluid) const {
+	Grid& grid = fluid.getGrid();
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	const GRAVITY gravity(m_gravity, grid);
+
+	Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+		GridCell& cell = cells[id];
+		if (GRAVITY::active) {
+			const GravArray& force = gravity.force(cell);
+			for (int i = 0; i < TORCH_MAX_DIMENSIONS; ++i) {
+				cell.UDOT[UID::VEL+i] += force[i];
+				cell.UDOT[UID::PRE] += cell.Q[UID::VEL+i]*force[i];
+			}
+		}
+
+		//Geometric.
+		if (GEOMETRY == Geometry::CYLINDRICAL || GEOMETRY == Geometry::SPHERICAL)
+			cell.UDOT[UID::VEL+0] += cell.Q[UID::PRE]/grid.geometricRadius[id];
+	});
 }
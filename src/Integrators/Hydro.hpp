@@ -7,14 +7,18 @@
 #ifndef HYDRO_HPP_
 #define HYDRO_HPP_
 
+#include <array>
 #include <memory>
+#include <vector>
 
 #include "Torch/Common.hpp"
+#include "GravityField.hpp"
 #include "Integrator.hpp"
 #include "Riemann.hpp"
 #include "SlopeLimiter.hpp"
 
 class Fluid;
+class Grid;
 class HydroParameters;
 class Constants;
 
@@ -35,26 +39,75 @@ public:
 	~Hydrodynamics() {}
 
 	void initialise(std::shared_ptr<Constants> c);
+	void specialise(int spatialOrder, Geometry geometry);
+	void setGravity(const GravityField& gravity);
 
 	virtual void preTimeStepCalculations(Fluid& fluid) const;
 	virtual double calculateTimeStep(double dt_max, Fluid& fluid) const;
+	double localTimeStepUpdates(double dt, const Fluid& fluid) const;
 	virtual void integrate(double dt, Fluid& fluid) const;
 	virtual void updateSourceTerms(double dt, Fluid& fluid) const;
 
 	void setRiemannSolver(std::unique_ptr<RiemannSolver> riemannSolver);
 	void setSlopeLimiter(std::unique_ptr<SlopeLimiter> slopeLimiter);
+	void setTileSize(int tileSize);
+	void setSkipQuiescent(bool skipQuiescent);
+	void setCFL(double cfl);
+	void setFallback(bool isFallback);
 
 	// Calculation methods.
 	void piecewiseLinear(FluidArray& Q_l, FluidArray& Q_c, FluidArray& Q_r, FluidArray& left_interp, FluidArray& right_interp) const;
-	void reconstruct(Fluid& fluid) const;
 
 	void calcFluxes(Fluid& fluid) const;
 	void fixIC(Fluid& fluid) const;
 
 private:
+	using Kernel = void (Hydrodynamics::*)(Fluid& fluid) const;
+
+	/**
+	 * @brief Buffers of the pencils a thread sweeps.
+	 */
+	struct SweepWorkspace {
+		std::vector<int> pencil;
+		std::vector<double> dl, dr, slope;
+		std::vector<double> q, edges, Q_m, Q_p; //!< Cell values, interpolated faces and limited edge states of the parabolae.
+		std::vector<FluidArray> Q_l, Q_r, F;
+		std::vector<double> a_l2, a_r2, gamma;
+
+		void resize(int n, int order, double uniformGamma);
+	};
+
 	std::shared_ptr<Constants> m_consts = nullptr;
+	double m_cfl = 0.5; //!< Fraction of the time a signal takes to cross a cell that the time step may be.
 	std::unique_ptr<RiemannSolver> m_riemannSolver = nullptr;
 	std::unique_ptr<SlopeLimiter> m_slopeLimiter = nullptr;
+	Kernel m_fluxKernel = nullptr; //!< Flux kernel specialised on the number of dimensions and spatial order (0, 1 or 2).
+	Kernel m_uniformGammaFluxKernel = nullptr; //!< m_fluxKernel for a Fluid with a uniform heat capacity ratio (see Fluid::hasUniformGamma).
+	Kernel m_fallbackFluxKernel = nullptr; //!< First order m_fluxKernel, for the fallback steps (see setFallback).
+	Kernel m_uniformGammaFallbackFluxKernel = nullptr; //!< First order m_uniformGammaFluxKernel, for the fallback steps.
+	std::unique_ptr<RiemannSolver> m_fallbackSolver = nullptr; //!< HLL solver of the fallback steps.
+	bool m_isFallback = false; //!< Whether the fluxes are found at first order with m_fallbackSolver (see setFallback).
+	Kernel m_sourceKernel = nullptr; //!< Source term kernel specialised on the Grid geometry and the gravity model.
+	Geometry m_geometry = Geometry::CARTESIAN; //!< Geometry of the Grid (see specialise).
+	GravityField m_gravity; //!< External gravitational field (see setGravity).
+	int m_tileSize = 0; //!< Number of cells along each side of the tiles the fluxes are swept in (0 sweeps whole pencils).
+	bool m_skipQuiescent = false; //!< Whether the tiles of a uniform state are skipped (see setSkipQuiescent).
+	mutable std::vector<SweepWorkspace> m_workspaces; //!< SweepWorkspace of each thread, kept between sweeps so that a step allocates none.
+	mutable std::vector<char> m_activeTiles; //!< Whether each tile has fluxes to add this sweep (empty if none are skipped, see markActiveTiles).
+	mutable std::array<std::vector<FluidArray>, 3> m_heldFluxes; //!< Fluxes through the left and right faces of each core cell, solved along a dimension before Grid::waitBCs and held until their turn (see fluxKernel).
+
+	static const int quiescentTileSize = 16; //!< Cells along each side of the tiles swept to skip the quiescent ones, if tile_size is 0.
+
+	// Specialised kernels (see Hydrodynamics::specialise).
+	template <int ND, int ORDER, bool UNIFORM_GAMMA> void fluxKernel(Fluid& fluid) const;
+	template <int ORDER, bool UNIFORM_GAMMA> void sweepPencils(int dim, bool hold, Fluid& fluid) const;
+	template <int ORDER, bool UNIFORM_GAMMA> void sweepTiles(int nd, int tileSize, unsigned sweep, unsigned hold, unsigned add, Fluid& fluid) const;
+	void markActiveTiles(int nd, int tileSize, int halo, bool uniformGamma, Grid& grid) const;
+	template <int ORDER, bool UNIFORM_GAMMA> void sweepPencil(int dim, Grid& grid, SweepWorkspace& ws, FluidArray* held) const;
+	void addHeldFluxes(int dim, int cellID, Grid& grid) const;
+	void piecewiseParabolic(int dim, Grid& grid, SweepWorkspace& ws) const;
+	template <Geometry GEOMETRY, class GRAVITY> void sourceKernel(Fluid& fluid) const;
+	void selectSourceKernel();
 
 	// Calculation methods.
 	double soundSpeedSqrd(const double pre, const double den, const double gamma) const;
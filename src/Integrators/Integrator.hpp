@@ -12,6 +12,20 @@
 
 class Fluid;
 
+/**
+ * @brief Criterion that limited the time step of an Integrator: its dt_max, the CFL condition, the heating time of the
+ * non-equilibrium radiation coupling, the K1, K3 and K4 conditions of the radiation [Mackey 2012] or the cooling time.
+ */
+enum class TimeStepCriterion : unsigned int {MAX, CFL, HEATING, K1, K3, K4, COOLING, N};
+
+/**
+ * @brief What limited the time step of an Integrator on this processor at its last calculateTimeStep.
+ */
+struct TimeStepLimiter {
+	TimeStepCriterion criterion = TimeStepCriterion::MAX;
+	int cellID = -1; //!< ID of the limiting GridCell (-1 unless a cell limited it).
+};
+
 /**
  * @class Integrator
  *
@@ -31,7 +45,16 @@ public:
 	virtual std::string getComponentName() final {
 		return componentName;
 	}
+	const TimeStepLimiter& getTimeStepLimiter() const {
+		return timeStepLimiter;
+	}
+	void setTimeStepLimiter(const TimeStepLimiter& limiter) const {
+		timeStepLimiter = limiter;
+	}
 	std::string componentName = "DefaultComponentName";
+
+protected:
+	mutable TimeStepLimiter timeStepLimiter; //!< Set by calculateTimeStep.
 };
 
 
@@ -14,6 +14,10 @@
 #include "Fluid/Star.hpp"
 #include "IO/Logger.hpp"
 #include "MPI/MPI_Wrapper.hpp"
+#include "Misc/CpuDispatch.hpp"
+#include "Misc/Parallel.hpp"
+#include "Misc/Profiler.hpp"
+#include "Thermodynamics.hpp"
 #include "Torch/Converter.hpp"
 #include "Torch/Parameters.hpp"
 
@@ -37,6 +41,29 @@ void Radiation::initialise(std::shared_ptr<Constants> c, RadiationParameters rp)
 	minX = rp.minX;
 	photoIonCrossSection = rp.photoIonCrossSection;
 	tau0 = rp.tau0;
+	decoupledIterations = rp.decoupledIterations;
+	decoupledTolerance = rp.decoupledTolerance;
+	neutralTolerance = rp.neutralTolerance;
+	shadowTau = rp.shadowTau;
+	ionisedTolerance = rp.ionisedTolerance;
+	ionisedSkips = rp.ionisedSkips;
+	implicitHeating = rp.implicitHeating;
+	if (decoupledIterations < 0)
+		throw std::runtime_error("Radiation::initialise: decoupled_iterations(=" + std::to_string(decoupledIterations) + ") must not be negative.");
+	if (neutralTolerance < 0 || neutralTolerance >= 1)
+		throw std::runtime_error("Radiation::initialise: neutral_tolerance(=" + std::to_string(neutralTolerance) + ") must be in [0, 1).");
+	if (shadowTau < 0)
+		throw std::runtime_error("Radiation::initialise: shadow_tau(=" + std::to_string(shadowTau) + ") must not be negative.");
+	if (ionisedTolerance < 0 || ionisedTolerance >= 1)
+		throw std::runtime_error("Radiation::initialise: ionised_tolerance(=" + std::to_string(ionisedTolerance) + ") must be in [0, 1).");
+	if (ionisedSkips < 0)
+		throw std::runtime_error("Radiation::initialise: ionised_skips(=" + std::to_string(ionisedSkips) + ") must not be negative.");
+	coarseFactor = rp.coarseFactor;
+	coarseRadius = rp.coarseRadius;
+	if (coarseFactor < 1)
+		throw std::runtime_error("Radiation::initialise: coarse_factor(=" + std::to_string(coarseFactor) + ") must be at least 1.");
+	if (coarseFactor > 1 && coarseRadius < 2*coarseFactor)
+		throw std::runtime_error("Radiation::initialise: coarse_radius(=" + std::to_string(coarseRadius) + ") must be at least twice coarse_factor.");
 
 	if (rp.coupling.compare("neq") == 0)
 		coupling = Coupling::NON_EQUILIBRIUM;
@@ -45,6 +72,17 @@ void Radiation::initialise(std::shared_ptr<Constants> c, RadiationParameters rp)
 	else
 		coupling = Coupling::OFF;
 
+	if (rp.hiiSolver.compare("newton") == 0)
+		hiiSolver = HIISolver::NEWTON;
+	else if (rp.hiiSolver.compare("fixed_point") == 0)
+		hiiSolver = HIISolver::FIXED_POINT;
+	else
+		throw std::runtime_error("Radiation::initialise: hii_solver(=" + rp.hiiSolver + ") must be \"fixed_point\" or \"newton\".");
+	iterationStats = rp.iterationStats;
+	m_iterationCounts.assign(Parallel::maxThreads(), IterationHistogram{});
+	m_shadowedCounts.assign(Parallel::maxThreads(), 0);
+	m_slowIterations.initialise(Parallel::maxThreads());
+
 	if (rp.scheme.compare("implicit2") == 0)
 		scheme = Scheme::IMPLICIT2;
 	else if (rp.scheme.compare("explicit") == 0)
@@ -53,13 +91,50 @@ void Radiation::initialise(std::shared_ptr<Constants> c, RadiationParameters rp)
 		scheme = Scheme::IMPLICIT;
 
 	initRecombinationHummer(m_consts->converter);
+	initRateTables(rp.rateTableSize, rp.rateTableCheck);
+	initPhotonGroups(rp.photonGroups, rp.spectrumTemperature);
 }
 
 void Radiation::integrate(double dt, Fluid& fluid) const {
-	if (scheme == Scheme::IMPLICIT)
-		transferRadiation(dt, fluid);
+	integrate(dt, fluid, std::function<void(const RayTile&)>());
+}
+
+/**
+ * @brief Integrates as above, then finishes each RayTile with finishTile.
+ *
+ * The coupled implicit scheme with the Star on solves the HII fractions of a tile as it traces it, so each tile is
+ * finished as soon as its column densities have been sent (see Fluid::sweepRayTiles) and the finishing work overlaps
+ * with the rest of the sweep, here and on the processors further from the star. The other schemes finish every tile
+ * once the whole Grid has been integrated. The time spent finishing the tiles is counted as radiation transfer.
+ * @param dt Time step.
+ * @param fluid The Fluid.
+ * @param finishTile Called as finishTile(const RayTile& tile), once for each of the Grid's tiles (may be empty).
+ */
+void Radiation::integrate(double dt, Fluid& fluid, const std::function<void(const RayTile&)>& finishTile) const {
+	ScopedTimer timer(ProfileID::RADIATION_TRANSFER, fluid.getGrid().getIterable(CellRange::GRID_CELLS).size());
+	for (IterationHistogram& counts : m_iterationCounts)
+		counts.fill(0);
+
+	bool isFinished = false;
+	if (scheme == Scheme::IMPLICIT && decoupledIterations > 0)
+		transferRadiationDecoupled(dt, fluid);
+	else if (scheme == Scheme::IMPLICIT) {
+		transferRadiation(dt, fluid, finishTile);
+		isFinished = fluid.getStar().on;
+	}
 	else
 		transferRadiation2(dt, fluid);
+	// The HII fractions have changed.
+	m_cellRatesCurrent = false;
+
+	if (iterationStats && scheme != Scheme::EXPLICIT)
+		printIterationStats();
+	m_slowIterations.report();
+
+	if (finishTile && !isFinished) {
+		for (const RayTile& tile : fluid.getGrid().getRayTiles())
+			finishTile(tile);
+	}
 }
 
 int Radiation::getRayPlane(Vec3& xc, Vec3& xs) const {
@@ -75,31 +150,62 @@ int Radiation::getRayPlane(Vec3& xc, Vec3& xs) const {
 	return plane;
 }
 
+/**
+ * @brief Traces the column densities of a Thermodynamics in the ray tracing sweeps of the radiation, so that it need not
+ * make its own (see sweepColumnDensities).
+ * @param thermodynamics The Thermodynamics, or nullptr to stop tracing its column densities.
+ */
+void Radiation::fuseColumnDensities(const Thermodynamics* thermodynamics) {
+	m_thermodynamics = thermodynamics;
+}
+
+/**
+ * @brief Whether the radiation sweeps trace the column densities of thermodynamics (see fuseColumnDensities).
+ */
+bool Radiation::fusesColumnDensities(const Thermodynamics& thermodynamics) const {
+	return m_thermodynamics == &thermodynamics;
+}
+
 void Radiation::initField(Fluid& fluid) const {
-	static bool time = 0;
 	Grid& grid = fluid.getGrid();
+	if (!grid.storesRayData())
+		return;
 
 	grid.calculateNearestNeighbours(fluid.getStar().xc);
-	if (time == 0) {
-		for (GridCell& cell : grid.getIterable("GridCells")){
-			cell.ds = cellPathLength(cell.xc, fluid.getStar().xc, grid.dx);
-			double r_sqrd = 0;
-			for(int i = 0; i < m_consts->nd; ++i)
-				r_sqrd += (cell.xc[i] - fluid.getStar().xc[i])*(cell.xc[i] - fluid.getStar().xc[i])*grid.dx[i]*grid.dx[i];
-			cell.shellVol = shellVolume(cell.ds, r_sqrd);
+	// Each cell writes only its own geometry and optical depths.
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+	Parallel::forEach(fields.first(), fields.last(), [&](int id) {
+		GridCell& cell = cells[id];
+		RayGeometry& ray = grid.getRayGeometry(cell.id);
+		ray.ds = cellPathLength(cell.xc, fluid.getStar().xc, grid.dx);
+		double dist2 = 0, r_sqrd = 0;
+		for(int i = 0; i < m_consts->nd; ++i) {
+			dist2 += (cell.xc[i] - fluid.getStar().xc[i])*(cell.xc[i] - fluid.getStar().xc[i]);
+			r_sqrd += (cell.xc[i] - fluid.getStar().xc[i])*(cell.xc[i] - fluid.getStar().xc[i])*grid.dx[i]*grid.dx[i];
+		}
+		ray.dist2 = dist2;
+		ray.rsqrd = r_sqrd;
+		ray.shellVol = shellVolume(ray.ds, r_sqrd);
+		// The geometry is also that of the cooling, which may be built without the radiation.
+		if (RADIATION_BUILT) {
 			double nH = massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass;
-			cell.R[RID::DTAU] = calc_dtau((1.0 - cell.Q[UID::HII])*nH, cell.ds);
-			cell.R[RID::DTAU_A] = calc_dtau((1.0 - cell.R[RID::HII_A])*nH, cell.ds);
-			++time;
+			cell.R[RID::DTAU] = calc_dtau((1.0 - cell.Q[UID::HII])*nH, ray.ds);
+			cell.R[RID::DTAU_A] = calc_dtau((1.0 - cell.R[RID::HII_A])*nH, ray.ds);
 		}
-	}
+	});
+	// Indexed by cell ID, so they are traced again once the state of the new cells is known (see preTimeStepCalculations).
+	m_sourceRates.clear();
+	m_sourceRatesAvg.clear();
+	m_cellRatesCurrent = false;
+	m_equilibriumSkips.clear();
 }
 
 double Radiation::calc_dtau(double nHI, double ds) const {
 	return nHI*photoIonCrossSection*ds;
 }
 
-double Radiation::cellPathLength(Vec3& xc, Vec3& sc, Vec3& dx) const {
+double Radiation::cellPathLength(const Vec3& xc, const Vec3& sc, const Vec3& dx) const {
 	double denom;
 	double d[3] = {0.0, 0.0, 0.0};
 	for(int i = 0; i < m_consts->nd; ++i)
@@ -178,6 +284,156 @@ void Radiation::doric(double dt, double& HII_avg, double& HII, double Api, doubl
 	}
 }
 
+/**
+ * @brief doric for n cells at once, with the same results.
+ *
+ * The exponentials of the whole batch are taken first, in a loop of their own, so that a compiler with a vector math
+ * library can vectorise them, and the updates follow in a second loop without branches. Both are compiled for each
+ * instruction set of TORCH_KERNEL_CLONES.
+ * @param n Number of cells.
+ * @param dt Time step.
+ * @param Api Photoionisation rate of each cell.
+ * @param nHII_aB Product of the HII number density and recombination rate coefficient of each cell.
+ * @param nHII_Aci Product of the HII number density and collisional ionisation rate coefficient of each cell.
+ * @param HII_avg Set to the time averaged HII fraction of each cell.
+ * @param HII The HII fraction of each cell, updated to the end of the step.
+ */
+TORCH_KERNEL_CLONES
+void Radiation::doricBatch(int n, double dt, const double* Api, const double* nHII_aB, const double* nHII_Aci, double* HII_avg, double* HII) const {
+	const double epsilon = 1.0e-8;
+	// HII_avg holds the exponentials until the updates overwrite them.
+	for (int i = 0; i < n; ++i)
+		HII_avg[i] = std::exp(-dt*(Api[i] + nHII_Aci[i] + nHII_aB[i]));
+	for (int i = 0; i < n; ++i) {
+		const double inv_ti = Api[i] + nHII_Aci[i] + nHII_aB[i];
+		const double xeq = (nHII_aB[i] == 0.0) ? 1.0 : (Api[i] + nHII_Aci[i])/inv_ti;
+		const bool frozen = dt*inv_ti < 1.0e-8;
+		const double exp_mdt_inv_ti = HII_avg[i];
+		const double HII_old = HII[i];
+		double x = frozen ? HII_old : xeq + (HII_old-xeq)*exp_mdt_inv_ti;
+		x = std::max(std::min(x, 1.0), 0.0);
+		x = (1.0 - x < epsilon) ? 1.0 - epsilon : x;
+		double x_avg = xeq + (HII_old-xeq)*(1.0-exp_mdt_inv_ti)/(dt*inv_ti);
+		x_avg = std::max(std::min(x_avg, 1.0), 0.0);
+		x_avg = (1.0 - x_avg < epsilon) ? 1.0 - epsilon : x_avg;
+		HII[i] = x;
+		HII_avg[i] = frozen ? x : x_avg;
+	}
+}
+
+/**
+ * @brief Derivative of the time averaged HII fraction returned by doric with respect to the trial HII_avg it is given.
+ * @param dt Time step.
+ * @param HII_avg Trial time averaged HII fraction.
+ * @param HII HII fraction at the start of the step.
+ * @param Api Photoionisation rate at HII_avg.
+ * @param dApi Derivative of Api with respect to HII_avg.
+ * @param nH_aB Hydrogen number density times the recombination rate coefficient.
+ * @param nH_Aci Hydrogen number density times the collisional ionisation rate.
+ * @return d(HII_avg out)/d(HII_avg in), zero wherever doric clamps its result.
+ */
+/**
+ * @brief Updates the HII fraction of a cell the Star's photons do not reach with the exact solution over dt of
+ * dx/dt = n_H x (A_ci (1 - x) - alphaB x), i.e. HIIfracRate without photoionisation, whose rates are fixed over the step.
+ *
+ * With r = n_H A_ci, s = n_H (A_ci + alphaB) and phi = (e^(r dt) - 1)/r, x(dt) = x (1 + r phi)/(1 + s x phi) and its
+ * time average is ln(1 + s x phi)/(s dt). The error from dropping a photoionisation rate A_pi is at most dt*A_pi.
+ * @param dt Time step.
+ * @param n_H Hydrogen number density.
+ * @param alphaB Case B recombination rate coefficient.
+ * @param A_ci Collisional ionisation rate coefficient.
+ * @param HII_avg Set to the time averaged HII fraction.
+ * @param HII The HII fraction, updated to the end of the step.
+ * @return Whether the update was made, which it is not if collisional ionisation is too fast for the closed form.
+ */
+bool Radiation::shadowedHIIfrac(double dt, double n_H, double alphaB, double A_ci, double& HII_avg, double& HII) const {
+	const double r = n_H*A_ci;
+	const double s = n_H*(A_ci + alphaB);
+	if (r*dt > 50.0)
+		return false;
+	const double phi = (r*dt > 1.0e-12) ? std::expm1(r*dt)/r : dt;
+	const double z = s*HII*phi;
+	if (z < 1.0e-12) {
+		HII_avg = HII;
+		return true;
+	}
+	HII_avg = std::log1p(z)/(s*dt);
+	HII = HII*(1.0 + r*phi)/(1.0 + z);
+	return true;
+}
+
+double Radiation::doricDerivative(double dt, double HII_avg, double HII, double Api, double dApi, double nH_aB, double nH_Aci) const {
+	double inv_ti = Api + HII_avg*(nH_Aci + nH_aB);
+	double dinv_ti = dApi + nH_Aci + nH_aB;
+	double z = dt*inv_ti;
+	if (z < 1.0e-8)
+		return 0;
+	double xeq = 1.0, dxeq = 0.0;
+	if (HII_avg*nH_aB != 0.0) {
+		xeq = (Api + HII_avg*nH_Aci)/inv_ti;
+		dxeq = ((dApi + nH_Aci) - xeq*dinv_ti)/inv_ti;
+	}
+	double exp_mz = std::exp(-z);
+	double f = (1.0 - exp_mz)/z;
+	double df = (exp_mz - f)/z;
+	double avg = xeq + (HII - xeq)*f;
+	if (avg <= 0.0 || avg >= 1.0 - 1.0e-8)
+		return 0;
+	return dxeq*(1.0 - f) + (HII - xeq)*df*dt*dinv_ti;
+}
+
+/**
+ * @brief Solves HII_avg = doric(HII_avg) with Newton's method, falling back on bisection whenever a Newton step would
+ * leave the bracket around the root.
+ *
+ * The residual HII_avg - doric(HII_avg) is never positive at 0 and never negative at 1, so the root is always bracketed.
+ * The convergence criteria are those of the fixed point iteration in Radiation::update_HIIfrac.
+ * @param dt Time step.
+ * @param n_H Hydrogen number density.
+ * @param alphaB Recombination rate coefficient.
+ * @param A_ci Collisional ionisation rate.
+ * @param photo The star's PhotoRate of the cell, at its time averaged optical depth.
+ * @param A_src Photoionisation rate of the other sources, held fixed.
+ * @param HII_avg Time averaged HII fraction: the initial guess on entry, the solution on return.
+ * @param HII HII fraction: at the start of the step on entry, at the end of it on return.
+ * @param A_pi Photoionisation rate at the solution.
+ * @return Number of iterations taken, or 0 if the solve did not converge.
+ */
+int Radiation::solveHIIavgNewton(double dt, double n_H, double alphaB, double A_ci, const PhotoRate& photo, double A_src,
+		double& HII_avg, double& HII, double& A_pi) const {
+	const int maxIterations = 200;
+	double convergence2 = 1.0e-3;
+	double convergence_frac = 1.0e-5;
+	double HII_start = HII;
+	double lo = 0.0, hi = 1.0;
+	double x = HII_avg;
+	for (int niter = 1; niter <= maxIterations; ++niter) {
+		A_pi = photoionisationRate(photo, (1.0-x)*n_H) + A_src;
+		double G = x;
+		HII = HII_start;
+		doric(dt, G, HII, A_pi, x*n_H*alphaB, x*n_H*A_ci);
+
+		if (std::fabs((G-x)/G) < convergence2 || G < convergence_frac || A_pi == 0) {
+			HII_avg = G;
+			return niter;
+		}
+
+		double F = x - G;
+		if (F < 0)
+			lo = x;
+		else
+			hi = x;
+		double dApi = photoionisationRateDerivative(photo, x, n_H);
+		double dF = 1.0 - doricDerivative(dt, x, HII_start, A_pi, dApi, n_H*alphaB, n_H*A_ci);
+		double x_new = dF > 0 ? x - F/dF : lo;
+		if (!(x_new > lo && x_new < hi))
+			x_new = 0.5*(lo + hi);
+		x = x_new;
+	}
+	HII_avg = x;
+	return 0;
+}
+
 /**
  * @brief Cubic spline fit for Hummer (1994) HII recombination cooling rate data.
  */
@@ -206,6 +462,26 @@ void Radiation::initRecombinationHummer(const Converter& converter) {
 	m_recombinationHII_CoolingRates = std::unique_ptr<LinearSplineData>(new LinearSplineData(cool));
 }
 
+/**
+ * @brief Resamples the recombination splines onto uniform log(T) tables over their data ranges (if size > 0).
+ * @param size Number of points in each table.
+ * @param check Log the largest difference between each table and its spline.
+ */
+void Radiation::initRateTables(int size, bool check) {
+	if (size <= 0)
+		return;
+	const LinearSplineData* cool = m_recombinationHII_CoolingRates.get();
+	const LinearSplineData* recomb = m_recombinationHII_RecombRates.get();
+	m_recombinationCoolingTable = std::unique_ptr<UniformLogTable>(new UniformLogTable(
+			[cool](double T) { return cool->interpolate(T); }, cool->getMinX(), cool->getMaxX(), size));
+	m_recombinationRateTable = std::unique_ptr<UniformLogTable>(new UniformLogTable(
+			[recomb](double T) { return recomb->interpolate(T); }, recomb->getMinX(), recomb->getMaxX(), size));
+	if (check && MPIW::Instance().getRank() == 0) {
+		Logger::Instance().print<SeverityType::NOTICE>("Radiation::initRateTables: max. relative error: recombination cooling = ",
+				m_recombinationCoolingTable->maxRelativeError(), ", recombination rate = ", m_recombinationRateTable->maxRelativeError(), '\n');
+	}
+}
+
 /**
  * Cubic spline interpolation of the recombination rate coefficient of ionised hydrogen.
  * @param T Gas temperature.
@@ -214,6 +490,8 @@ void Radiation::initRecombinationHummer(const Converter& converter) {
 double Radiation::recombinationRateCoefficient(double T) const {
 	//return m_alphaB*pow(T/10000, -0.7); // cm3.s-1
 	//return m_alphaB; // cm3.s-1
+	if (m_recombinationRateTable)
+		return m_recombinationRateTable->interpolate(T);
 	return m_recombinationHII_RecombRates->interpolate(T);
 }
 
@@ -223,10 +501,55 @@ double Radiation::recombinationRateCoefficient(double T) const {
  * @return Recombination cooling rate of HII.
  */
 double Radiation::recombinationCoolingRate(double nH, double HIIFRAC, double T) const {
-	double rate = m_recombinationHII_CoolingRates->interpolate(T);
+	double rate = m_recombinationCoolingTable ? m_recombinationCoolingTable->interpolate(T) : m_recombinationHII_CoolingRates->interpolate(T);
 	return HIIFRAC*HIIFRAC*nH*nH*m_consts->boltzmannConst*T*rate;
 }
 
+/**
+ * @brief Splits a black body spectrum into PhotonGroups between the hydrogen ionisation threshold and the HeII edge.
+ *
+ * The bins divide 1 to 4 Rydberg equally in log energy. Each takes its share of the photons in that range, and its
+ * photon weighted mean cross-section, taken to fall as the cube of the energy from photoIonCrossSection at the
+ * threshold, and energy above the threshold, from Simpson's rule over the Planck photon spectrum x^2/(exp(x*Ry/kT) - 1).
+ * @param ngroups Number of bins (0 for the grey approximation).
+ * @param temperature Temperature of the black body (K).
+ * @exception std::runtime_error Thrown if ngroups is not in [0, MAX_PHOTON_GROUPS] or the temperature is not positive.
+ */
+void Radiation::initPhotonGroups(int ngroups, double temperature) {
+	photonGroups = ngroups;
+	m_groups = PhotonGroups();
+	if (ngroups < 0 || ngroups > MAX_PHOTON_GROUPS)
+		throw std::runtime_error("Radiation::initPhotonGroups: photon_groups(=" + std::to_string(ngroups) + ") must be in [0, " + std::to_string(MAX_PHOTON_GROUPS) + "].");
+	if (ngroups == 0)
+		return;
+	if (temperature <= 0)
+		throw std::runtime_error("Radiation::initPhotonGroups: spectrum_temperature(=" + std::to_string(temperature) + ") must be positive.");
+
+	const double theta = m_consts->rydbergEnergy/(m_consts->boltzmannConst*temperature);
+	const int nsteps = 64;
+	double total = 0;
+	for (int k = 0; k < ngroups; ++k) {
+		const double x0 = std::pow(4.0, k/(double)ngroups);
+		const double x1 = std::pow(4.0, (k + 1)/(double)ngroups);
+		const double h = (x1 - x0)/nsteps;
+		double photons = 0, crossSection = 0, excess = 0;
+		for (int i = 0; i <= nsteps; ++i) {
+			const double x = x0 + i*h;
+			const double weight = (i == 0 || i == nsteps) ? 1 : (i%2 == 1 ? 4 : 2);
+			const double n = weight*x*x/std::expm1(x*theta);
+			photons += n;
+			crossSection += n/(x*x*x);
+			excess += n*(x - 1.0);
+		}
+		m_groups.fraction.push_back(photons*h);
+		m_groups.crossSection.push_back(crossSection/photons);
+		m_groups.excessEnergy.push_back(m_consts->rydbergEnergy*excess/photons);
+		total += photons*h;
+	}
+	for (double& fraction : m_groups.fraction)
+		fraction /= total;
+}
+
 /**
  * @brief Calculates the collisional ionisation rate of hydrogen.
  * Uses the fitted formula from Voronov (1997,ADANDT,65,1).
@@ -240,33 +563,185 @@ double Radiation::collisionalIonisationRate(double T) const {
 	return m_consts->voronov_A*(1.+m_consts->voronov_P*std::sqrt(U))*std::exp(m_consts->voronov_K*log(U) - U)/(m_consts->voronov_X + U); //cm^3/s
 }
 
+/**
+ * @brief Photoionisation rate per neutral hydrogen atom of a cell, the photons it absorbs per unit time and volume over
+ * its neutral hydrogen number density.
+ *
+ * The share absorbed, 1 - exp(-delT), is taken as -expm1(-delT) so that it keeps its precision in optically thin cells.
+ * @param nHI Neutral hydrogen number density.
+ * @param T Optical depth to the cell.
+ * @param delT Optical depth through the cell.
+ * @param shellVol Shell volume of the cell.
+ * @param photonRate Ionising photon rate of the star.
+ */
 double Radiation::photoionisationRate(double nHI, double T, double delT, double shellVol, double photonRate) const {
 	if (nHI == 0 || shellVol == 0)
 		return 0.0;
-	else {
-		double emT = std::exp(-T);
-		double emdT = std::exp(-delT);
-		return photonRate*emT*(1.0-emdT)/(nHI*shellVol);
+	else if (photonGroups > 0)
+		return photonRate*sumPhotonGroups(T, delT).absorbed/(nHI*shellVol);
+	else
+		return -photonRate*std::exp(-T)*std::expm1(-delT)/(nHI*shellVol);
+}
+
+/**
+ * @brief Evaluates the parts of a cell's photoionisation rate that do not depend on its HII fraction, once for all the
+ * iterations of a solve.
+ * @param tau Optical depth to the cell.
+ * @param ray The cell's RayGeometry.
+ * @param photonRate Ionising photon rate of the star.
+ */
+Radiation::PhotoRate Radiation::photoRate(double tau, const RayGeometry& ray, double photonRate) const {
+	PhotoRate photo;
+	photo.tau = tau;
+	photo.flux = ray.shellVol == 0 ? 0 : (photonGroups > 0 ? photonRate : photonRate*std::exp(-tau))/ray.shellVol;
+	photo.crossSectionDs = photoIonCrossSection*ray.ds;
+	return photo;
+}
+
+/**
+ * @brief photoionisationRate of a cell from its PhotoRate, which leaves one expm1 and a division to be evaluated when
+ * grey.
+ * @param photo The cell's PhotoRate.
+ * @param nHI Neutral hydrogen number density.
+ */
+double Radiation::photoionisationRate(const PhotoRate& photo, double nHI) const {
+	if (nHI == 0 || photo.flux == 0)
+		return 0.0;
+	const double delT = nHI*photo.crossSectionDs;
+	if (photonGroups > 0)
+		return photo.flux*sumPhotonGroups(photo.tau, delT).absorbed/nHI;
+	return -photo.flux*std::expm1(-delT)/nHI;
+}
+
+/**
+ * @brief Derivative of photoionisationRate with respect to the HII fraction of the cell.
+ * @param photo The cell's PhotoRate.
+ * @param HII HII fraction of the cell.
+ * @param nH Hydrogen number density.
+ */
+double Radiation::photoionisationRateDerivative(const PhotoRate& photo, double HII, double nH) const {
+	double y = 1.0 - HII;
+	if (y*nH == 0 || photo.flux == 0)
+		return 0.0;
+	double delT = y*nH*photo.crossSectionDs;
+	double K = photo.flux/nH;
+	if (photonGroups > 0) {
+		const GroupSums sums = sumPhotonGroups(photo.tau, delT);
+		return (K*sums.absorbed/y - K*photo.crossSectionDs*nH*sums.dAbsorbed)/y;
+	}
+	double emdT = std::exp(-delT);
+	double A = -K*std::expm1(-delT)/y;
+	return (A - K*photo.crossSectionDs*nH*emdT)/y;
+}
+
+/**
+ * @brief Sums the absorption and photoheating of the PhotonGroups by a cell.
+ *
+ * The cross-sections do not depend on the position, so the optical depths of every bin are fixed multiples of the
+ * grey ones the ray trace carries. The exponentials of all the bins are taken in a loop of their own, so that a
+ * compiler with a vector math library can vectorise them, and are summed in a second loop; both are compiled for each
+ * instruction set of TORCH_KERNEL_CLONES.
+ * @param T Grey optical depth to the cell.
+ * @param delT Grey optical depth through the cell.
+ */
+TORCH_KERNEL_CLONES
+Radiation::GroupSums Radiation::sumPhotonGroups(double T, double delT) const {
+	const int n = photonGroups;
+	const double* fraction = m_groups.fraction.data();
+	const double* crossSection = m_groups.crossSection.data();
+	const double* excessEnergy = m_groups.excessEnergy.data();
+	double reaching[MAX_PHOTON_GROUPS], leaving[MAX_PHOTON_GROUPS];
+	for (int k = 0; k < n; ++k) {
+		reaching[k] = fraction[k]*std::exp(-crossSection[k]*T);
+		leaving[k] = std::exp(-crossSection[k]*delT);
+	}
+	GroupSums sums = GroupSums();
+	for (int k = 0; k < n; ++k) {
+		const double absorbed = reaching[k]*(1.0 - leaving[k]);
+		sums.absorbed += absorbed;
+		sums.dAbsorbed += crossSection[k]*reaching[k]*leaving[k];
+		sums.heating += absorbed*excessEnergy[k];
 	}
+	return sums;
+}
+
+/**
+ * @brief Mean energy above the ionisation threshold of the photons a cell absorbs: the Star's photon energy less the
+ * Rydberg energy if grey, otherwise that of the PhotonGroups it absorbs at its optical depths, which hardens with depth.
+ */
+double Radiation::meanExcessEnergy(const GridCell& cell, const Star& star) const {
+	if (photonGroups == 0)
+		return star.photonEnergy - m_consts->rydbergEnergy;
+	const GroupSums sums = sumPhotonGroups(cell.R[RID::TAU], cell.R[RID::DTAU]);
+	return sums.absorbed > 0 ? sums.heating/sums.absorbed : 0;
 }
 
 double Radiation::HIIfracRate(double A_pi, double A_ci, double A_rr, double nH, double frac) const {
 	return (1.0-frac)*(A_pi + frac*nH*A_ci) - frac*frac*nH*A_rr;
 }
 
+/**
+ * @brief Calculates the rate coefficients of a non-wind cell from its temperature, primitive variables and column
+ * densities.
+ * @param T Gas temperature of the cell.
+ */
+Radiation::CellRates Radiation::cellRates(const GridCell& cell, double T, Fluid& fluid) const {
+	CellRates rates = CellRates();
+	double n_H = massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass;
+	double nHI = (1.0-cell.Q[UID::HII])*n_H;
+	rates.T = T;
+	rates.alphaB = recombinationRateCoefficient(rates.T);
+	rates.A_ci = collisionalIonisationRate(rates.T);
+	rates.A_pi = photoionisationRate(nHI, cell.R[RID::TAU], cell.R[RID::DTAU], fluid.getGrid().getRayGeometry(cell.id).shellVol, fluid.getStar().photonRate);
+	if (!m_sourceRates.empty())
+		rates.A_pi += m_sourceRates[cell.id];
+	return rates;
+}
+
+/**
+ * @brief Net heating rate of a cell's gas at a temperature, its HII fraction and photoionisation rate held fixed: the
+ * heating rate of preTimeStepCalculations at T.
+ */
+double Radiation::netHeatingRate(const GridCell& cell, double n_H, double A_pi, double excessEnergy, double T) const {
+	double photoion = n_H*(1.0-cell.Q[UID::HII])*A_pi*excessEnergy;
+	double recombination = recombinationCoolingRate(n_H, cell.Q[UID::HII], T);
+	double collisions = cell.Q[UID::HII]*(1.0-cell.Q[UID::HII])*n_H*n_H*collisionalIonisationRate(T);
+	double rate = photoion - recombination - collisions;
+	if (T < cell.T_min + 200 && rate < 0.0)
+		rate = std::min(0.0, rate*(T - cell.T_min) / 200.0);
+	return rate*heatingAmplification;
+}
+
+/**
+ * @brief Calculates the heating rates of the non-wind cells, and keeps their temperatures and rate coefficients for
+ * calculateTimeStep and the HII fraction updates of the next integrate.
+ *
+ * The primitive variables and column densities are not changed between here and the end of the next integrate of the
+ * HII fractions, so the rates of each cell are only calculated once.
+ */
 void Radiation::preTimeStepCalculations(Fluid& fluid) const {
 	Grid& grid = fluid.getGrid();
-	for (int cellID : grid.getOrderedIndices("CausalNonWind")) {
+	// The rates of the extra sources are left by the last radiation step, unless the cells have been rebuilt since.
+	if (fluid.getStar().on && !fluid.getSources().empty() && m_sourceRates.empty())
+		traceSources(fluid);
+	const std::vector<int>& cellIDs = grid.getOrderedIndices(CellOrder::CAUSAL_NON_WIND);
+	m_cellRates.resize(grid.getCells().size());
+	if (m_equilibriumSkips.size() != grid.getCells().size())
+		m_equilibriumSkips.assign(grid.getCells().size(), 0);
+	Parallel::forEach(0, (int)cellIDs.size(), [&](int i) {
+		const int cellID = cellIDs[i];
 		GridCell& cell = grid.getCell(cellID);
+		HeatArray& heating = grid.getHeating(cellID);
+		// The primitive variables have just been fixed (see Fluid::fixPrimitives), which finds the temperature.
+		CellRates& rates = m_cellRates[cellID] = cellRates(cell, cell.getTemperature(), fluid);
 
 		double n_H = (massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass);
-		double excessEnergy = fluid.getStar().photonEnergy - m_consts->rydbergEnergy;
-		double T = fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]);
-		double nHI = (1.0-cell.Q[UID::HII])*n_H;
-		double A_pi = photoionisationRate(nHI, cell.R[RID::TAU], cell.R[RID::DTAU], cell.shellVol, fluid.getStar().photonRate);
+		double excessEnergy = meanExcessEnergy(cell, fluid.getStar());
+		double T = rates.T;
+		double A_pi = rates.A_pi;
 		double photoion = n_H*(1.0-cell.Q[UID::HII])*A_pi*excessEnergy;
 		double recombination = recombinationCoolingRate(n_H, cell.Q[UID::HII], T);
-		double collisions = cell.Q[UID::HII]*(1.0-cell.Q[UID::HII])*n_H*n_H*collisionalIonisationRate(T);
+		double collisions = cell.Q[UID::HII]*(1.0-cell.Q[UID::HII])*n_H*n_H*rates.A_ci;
 		double rate = photoion - recombination - collisions;
 		double softrate = rate;
 		if (T < cell.T_min + 200 && rate < 0.0)
@@ -274,9 +749,13 @@ void Radiation::preTimeStepCalculations(Fluid& fluid) const {
 		softrate *= heatingAmplification;
 
 		cell.R[RID::HEAT] = softrate;
+		if (implicitHeating && coupling == Coupling::NON_EQUILIBRIUM) {
+			const double dT = 1.0e-4*T;
+			rates.dHeatdT = (netHeatingRate(cell, n_H, A_pi, excessEnergy, T + dT) - softrate)/dT;
+		}
 
-		cell.H[HID::EUVH] = photoion * (softrate / rate);
-		cell.H[HID::RHII] = -recombination * (softrate / rate);
+		heating[HID::EUVH] = photoion * (softrate / rate);
+		heating[HID::RHII] = -recombination * (softrate / rate);
 
 		if (rate != rate) {
 			std::stringstream out;
@@ -292,116 +771,385 @@ void Radiation::preTimeStepCalculations(Fluid& fluid) const {
 			out << "collis = " << collisions << '\n';
 			throw std::runtime_error(out.str());
 		}
-	}
+	});
+	m_cellRatesCurrent = true;
 }
 
 double Radiation::calculateTimeStep(double dt_max, Fluid& fluid) const {
 	Grid& grid = fluid.getGrid();
-	static bool once = false;
 	double dt = dt_max, dtc, dt1, dt2, dt3, dt4;
+	timeStepLimiter = TimeStepLimiter();
 	if (fluid.getStar().on) {
-		for (int cellID : grid.getOrderedIndices("CausalNonWind")) {
+		// Before any cell is ionised the first step is bounded by the recombination time of the cell nearest the Star,
+		// which only the processor holding the Star has, whatever the decomposition.
+		const bool isStarHere = fluid.getStar().isHere();
+		for (int cellID : grid.getOrderedIndices(CellOrder::CAUSAL_NON_WIND)) {
 			GridCell& cell = grid.getCell(cellID);
 
 			dtc = dt1 = dt2 = dt3 = dt4 = dt_max;
-			if (coupling == Coupling::NON_EQUILIBRIUM) {
+			if (coupling == Coupling::NON_EQUILIBRIUM && !implicitHeating) {
 				if (cell.R[RID::HEAT] != 0)
 					dtc = std::abs(cell.U[UID::PRE]/cell.R[RID::HEAT]);
 			}
+			// Calculated by preTimeStepCalculations, unless the state has changed since.
+			const CellRates rates = m_cellRatesCurrent ? m_cellRates[cellID] :
+					cellRates(cell, fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]), fluid);
 			if (K1 != 0.0) {
-				double T = fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]);
-				if (!once) {
-					dt1 = K1*m_consts->hydrogenMass/(massFractionH*cell.Q[UID::DEN]*recombinationRateCoefficient(T));
-					once = true;
+				if (isFirstTimeStep && isStarHere) {
+					dt1 = K1*m_consts->hydrogenMass/(massFractionH*cell.Q[UID::DEN]*rates.alphaB);
+					isFirstTimeStep = false;
 				}
 				else if (cell.Q[UID::HII] != 0) {
-					dt1 = K1*m_consts->hydrogenMass/(massFractionH*cell.Q[UID::DEN]*cell.Q[UID::HII]*recombinationRateCoefficient(T));
+					dt1 = K1*m_consts->hydrogenMass/(massFractionH*cell.Q[UID::DEN]*cell.Q[UID::HII]*rates.alphaB);
 				}
 			}
 			if(K2 != 0.0)
 				dt2 = dt_max;
-			if(K3 != 0.0) {
-				double nH = massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass;
-				double nHI = (1.0-cell.Q[UID::HII])*nH;
-				double A_pi = photoionisationRate(nHI, cell.R[RID::TAU], cell.R[RID::DTAU], cell.shellVol, fluid.getStar().photonRate);
-				double A_ci = collisionalIonisationRate(fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]));
-				double A_rr = recombinationRateCoefficient(fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]));
-				double fracRate = HIIfracRate(A_pi, A_ci, A_rr, nH, cell.Q[UID::HII]);
-				if (fracRate != 0.0)
-					dt3 = K3*std::max(0.05, 1.0 - cell.Q[UID::HII])/std::fabs(fracRate);
-			}
-			if(K4 != 0.0) {
+			if (K3 != 0.0 || K4 != 0.0) {
 				double nH = massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass;
-				double nHI = (1.0-cell.Q[UID::HII])*nH;
-				double A_pi = photoionisationRate(nHI, cell.R[RID::TAU], cell.R[RID::DTAU], cell.shellVol, fluid.getStar().photonRate);
-				double A_ci = collisionalIonisationRate(fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]));
-				double A_rr = recombinationRateCoefficient(fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]));
-				double fracRate = HIIfracRate(A_pi, A_ci, A_rr, nH, cell.Q[UID::HII]);
-				if (fracRate != 0.0)
-					dt4 = K4*1.0/fabs(fracRate); // timestep criterion [Mackey 2012].
+				double fracRate = HIIfracRate(rates.A_pi, rates.A_ci, rates.alphaB, nH, cell.Q[UID::HII]);
+				if (fracRate != 0.0) {
+					if (K3 != 0.0)
+						dt3 = K3*std::max(0.05, 1.0 - cell.Q[UID::HII])/std::fabs(fracRate);
+					if (K4 != 0.0)
+						dt4 = K4*1.0/fabs(fracRate); // timestep criterion [Mackey 2012].
+				}
 			}
 
-			dt = std::min(dt, std::min(dt_max, std::min(dtc, std::min(dt1, std::min(dt2, std::min(dt3, dt4))))));
+			// The first criterion to give a cell's smallest time step is the one reported, as is the first cell to give dt.
+			const double dtCell = std::min(dt_max, std::min(dtc, std::min(dt1, std::min(dt2, std::min(dt3, dt4)))));
+			if (dtCell < dt) {
+				timeStepLimiter.cellID = cellID;
+				if (dtCell == dtc)
+					timeStepLimiter.criterion = TimeStepCriterion::HEATING;
+				else if (dtCell == dt1)
+					timeStepLimiter.criterion = TimeStepCriterion::K1;
+				else if (dtCell == dt3)
+					timeStepLimiter.criterion = TimeStepCriterion::K3;
+				else
+					timeStepLimiter.criterion = TimeStepCriterion::K4;
+			}
+			dt = std::min(dt, dtCell);
 
 			if (dt == 0.0 || dt != dt || std::isinf(dt))
 				throw std::runtime_error("Radiation::calculateTimeStep(): invalid timestep: " + std::to_string(dt));
 		}
+		isFirstTimeStep = false;
 	}
 	return dt;
 }
 
-void Radiation::updateTauSC(bool average, GridCell& cell, Fluid& fluid, double dist2) const {
-	Grid& grid = fluid.getGrid();
+/**
+ * @brief Interpolates the optical depth to a cell from the optical depths through its neighbours [Mellema et. al. 2006].
+ *
+ * Each neighbour is weighted by its geometric weight over its optical depth (at least tau0). The weighted sum is
+ * normalised by a single division at the end rather than a division per neighbour.
+ * @param neighbours Indices of the neighbours, negative for a neighbour outside the Grid.
+ * @param weights Weights of the neighbours.
+ * @param column Called as column(int index) for the optical depth from the source through the far side of a neighbour.
+ */
+template <class Column>
+double Radiation::interpolateTau(const std::array<int, 4>& neighbours, const std::array<double, 4>& weights, Column column) const {
+	// In 1D the ray only crosses the neighbour towards the source, whose weight is 1, so the optical depth is a running
+	// sum along the ray.
+	if (m_consts->nd == 1)
+		return neighbours[0] >= 0 ? column(neighbours[0]) : 0.0;
+	double tau[4] = {0.0, 0.0, 0.0, 0.0};
+	for (int i = 0; i < 4; ++i)
+		if (neighbours[i] >= 0)
+			tau[i] = column(neighbours[i]);
+	double w_raga[4];
+	for (int i = 0; i < 4; ++i)
+		w_raga[i] = weights[i]/std::max(tau0, tau[i]);
+	double sum_w = 0, newtau = 0;
+	for (int i = 0; i < 4; ++i) {
+		sum_w += w_raga[i];
+		newtau += w_raga[i]*tau[i];
+	}
+	return newtau/sum_w;
+}
+
+/**
+ * @brief Interpolates the optical depth to a cell as above, from the neighbours given by its RayGeometry.
+ * @param ray The cell's RayGeometry.
+ * @param weights The weights of the neighbours (see Grid::neighbourWeights).
+ * @param grid The Grid.
+ * @param column Called as column(int cellID).
+ */
+template <class Column>
+double Radiation::interpolateTau(const RayGeometry& ray, const std::array<double, 4>& weights, const Grid& grid, Column column) const {
+	std::array<int, 4> neighbours;
+	for (int i = 0; i < 4; ++i)
+		neighbours[i] = grid.cellExists(ray.neighbourIDs[i]) ? ray.neighbourIDs[i] : -1;
+	return interpolateTau(neighbours, weights, column);
+}
+
+/**
+ * @brief Gathers the neighbours and column densities of every cell into m_columns, ready for a ray trace of the
+ * Star (see sweepColumnDensities).
+ *
+ * The cells are given slots in the order they are traced, so the gathers of interpolateTau stay within a few pages of
+ * the arrays rather than striding across the GridCells, whose storage order follows the Grid.
+ */
+void Radiation::gatherColumns(Grid& grid) const {
+	const std::vector<RayTile>& tiles = grid.getRayTiles();
+	const int ncells = (int)grid.getCells().size();
+	std::vector<int>& tileStarts = m_columns.tileStarts;
+	tileStarts.assign(tiles.size() + 1, 0);
+	for (unsigned int itile = 0; itile < tiles.size(); ++itile)
+		tileStarts[itile + 1] = tileStarts[itile] + (int)tiles[itile].nonWindIDs.size();
+
+	std::vector<int>& slots = m_columns.slots;
+	slots.assign(ncells, -1);
+	Parallel::forEach(0, tiles.size(), [&](int itile) {
+		const std::vector<int>& nonWindIDs = tiles[itile].nonWindIDs;
+		for (unsigned int i = 0; i < nonWindIDs.size(); ++i)
+			slots[nonWindIDs[i]] = tileStarts[itile] + i;
+	});
+	int next = tileStarts.back();
+	for (int& slot : slots)
+		if (slot < 0)
+			slot = next++;
+
+	// A neighbour outside the Grid reads the zero columns of the last slot, as the optical depth it was taken to have.
+	m_columns.neighbours.resize(ncells);
+	m_columns.columns.resize(ncells + 1);
+	m_columns.columns[ncells] = std::array<double, 2>{{ 0, 0 }};
+	Parallel::forEach(0, ncells, [&](int id) {
+		const RayGeometry& ray = grid.getRayGeometry(id);
+		const int slot = slots[id];
+		for (int i = 0; i < 4; ++i)
+			m_columns.neighbours[slot][i] = grid.cellExists(ray.neighbourIDs[i]) ? slots[ray.neighbourIDs[i]] : ncells;
+		storeColumns(grid.getCell(id));
+	});
+}
+
+/**
+ * @brief Copies the optical depths through the far side of a cell to its slot in m_columns.
+ */
+void Radiation::storeColumns(const GridCell& cell) const {
+	std::array<double, 2>& columns = m_columns.columns[m_columns.slots[cell.id]];
+	columns[0] = cell.R[RID::TAU] + cell.R[RID::DTAU];
+	columns[1] = cell.R[RID::TAU_A] + cell.R[RID::DTAU_A];
+}
+
+/**
+ * @brief Interpolates the instantaneous or time averaged optical depth to a cell from the columns its neighbours left in
+ * m_columns.
+ * @param weights The weights of the neighbours (see Grid::neighbourWeights).
+ * @param dist2 Squared distance of the cell from the Star (cell widths squared).
+ */
+void Radiation::updateTauSC(bool average, GridCell& cell, const std::array<double, 4>& weights, double dist2) const {
 	if(dist2 > 0.95){
-		double tau[4] = {0.0, 0.0, 0.0, 0.0};
-		double w_raga[4];
-		for(int i = 0; i < 4; ++i) {
-			if (grid.cellExists(cell.neighbourIDs[i]))
-				tau[i] = grid.getCell(cell.neighbourIDs[i]).R[average ? RID::TAU_A : RID::TAU]+grid.getCell(cell.neighbourIDs[i]).R[average ? RID::DTAU_A : RID::DTAU];
-			w_raga[i] = cell.neighbourWeights[i]/std::max(tau0, tau[i]);
-		}
-		double sum_w = w_raga[0]+w_raga[1]+w_raga[2]+w_raga[3];
-		double newtau = 0.0;
-		for(int i = 0; i < 4; ++i){
-			w_raga[i] = w_raga[i] / sum_w;
-			newtau += w_raga[i] * tau[i];
-		}
-		cell.R[average ? RID::TAU_A : RID::TAU] = newtau;
+		const int slot = m_columns.slots[cell.id];
+		const int icolumn = average ? 1 : 0;
+		cell.R[average ? RID::TAU_A : RID::TAU] = interpolateTau(m_columns.neighbours[slot], weights,
+			[&](int neighbourSlot) { return m_columns.columns[neighbourSlot][icolumn]; });
 	}
 	else
 		cell.R[average ? RID::TAU_A : RID::TAU] = 0;
 }
 
+/**
+ * @brief Interpolates both the instantaneous and the time averaged optical depths to a cell, as updateTauSC, in one
+ * pass on the serial critical path of the trace.
+ *
+ * The two columns of each neighbour are read together and the weights of both are taken in one loop of eight, with no
+ * branch for the neighbours outside the Grid, which read the zero columns of the last slot of m_columns.
+ * @param weights The weights of the neighbours (see Grid::neighbourWeights).
+ * @param dist2 Squared distance of the cell from the Star (cell widths squared).
+ */
+void Radiation::updateTausSC(GridCell& cell, const std::array<double, 4>& weights, double dist2) const {
+	if (!(dist2 > 0.95)) {
+		cell.R[RID::TAU] = 0;
+		cell.R[RID::TAU_A] = 0;
+		return;
+	}
+	const std::array<int, 4>& neighbours = m_columns.neighbours[m_columns.slots[cell.id]];
+	const std::array<double, 2>* columns = m_columns.columns.data();
+	if (m_consts->nd == 1) {
+		cell.R[RID::TAU] = columns[neighbours[0]][0];
+		cell.R[RID::TAU_A] = columns[neighbours[0]][1];
+		return;
+	}
+	double tau[2][4], w_raga[2][4];
+	for (int i = 0; i < 4; ++i) {
+		tau[0][i] = columns[neighbours[i]][0];
+		tau[1][i] = columns[neighbours[i]][1];
+	}
+	for (int k = 0; k < 2; ++k)
+		for (int i = 0; i < 4; ++i)
+			w_raga[k][i] = weights[i]/std::max(tau0, tau[k][i]);
+	double sum_w[2] = {0.0, 0.0}, newtau[2] = {0.0, 0.0};
+	for (int k = 0; k < 2; ++k) {
+		for (int i = 0; i < 4; ++i) {
+			sum_w[k] += w_raga[k][i];
+			newtau[k] += w_raga[k][i]*tau[k][i];
+		}
+	}
+	cell.R[RID::TAU] = newtau[0]/sum_w[0];
+	cell.R[RID::TAU_A] = newtau[1]/sum_w[1];
+}
+
+/**
+ * @brief Ray traces the optical depths from every RaySource of the Fluid and sums the photoionisation rates they give
+ * each cell, at its HII fraction and at its time averaged HII fraction.
+ *
+ * The sources are traced one after the other through the same optical depth buffers and the ray geometry of each cell
+ * is recomputed as it is traced, so the memory used does not grow with the number of sources. The HII fraction solves
+ * (see update_HIIfrac) add the summed rates to the Star's and hold them fixed.
+ * @param fluid The Fluid.
+ */
+void Radiation::traceSources(Fluid& fluid) const {
+	Grid& grid = fluid.getGrid();
+	const std::size_t ncells = grid.getCells().size();
+	m_sourceRates.assign(ncells, 0);
+	m_sourceRatesAvg.assign(ncells, 0);
+	for (const RaySource& source : fluid.getSources()) {
+		const Star& star = source.star;
+		m_sourceColumns.assign(ncells, 0);
+		m_sourceColumnsAvg.assign(ncells, 0);
+		fluid.sweepRayTiles(star, source.tiles, SendID::RADIATION_MSG,
+			[&](GridCell& ghost, PartitionManager& partition) {
+				m_sourceColumns[ghost.id] = partition.getRecvItem();
+				m_sourceColumnsAvg[ghost.id] = partition.getRecvItem();
+			},
+			[&](const RayTile& tile) {
+				Parallel::forEachLevel(tile.nonWindLevels, [&](int i) {
+					const GridCell& cell = grid.getCell(tile.nonWindIDs[i]);
+					RayGeometry ray;
+					grid.calculateNearestNeighbours(cell.id, star.xc, ray);
+					ray.ds = cellPathLength(cell.xc, star.xc, grid.dx);
+					double dist2 = 0, r_sqrd = 0;
+					for (int idim = 0; idim < m_consts->nd; ++idim) {
+						double d = cell.xc[idim] - star.xc[idim];
+						dist2 += d*d;
+						r_sqrd += d*d*grid.dx[idim]*grid.dx[idim];
+					}
+					ray.shellVol = shellVolume(ray.ds, r_sqrd);
+					double tau = 0, tau_avg = 0;
+					if (dist2 > 0.95) {
+						const std::array<double, 4> weights = grid.neighbourWeights(cell.xc, star.xc);
+						tau = interpolateTau(ray, weights, grid, [&](int neighbourID) { return m_sourceColumns[neighbourID]; });
+						tau_avg = interpolateTau(ray, weights, grid, [&](int neighbourID) { return m_sourceColumnsAvg[neighbourID]; });
+					}
+					double nH = massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass;
+					double nHI = (1.0 - cell.Q[UID::HII])*nH;
+					double nHI_avg = (1.0 - cell.R[RID::HII_A])*nH;
+					double dtau = calc_dtau(nHI, ray.ds);
+					double dtau_avg = calc_dtau(nHI_avg, ray.ds);
+					m_sourceRates[cell.id] += photoionisationRate(nHI, tau, dtau, ray.shellVol, star.photonRate);
+					m_sourceRatesAvg[cell.id] += photoionisationRate(nHI_avg, tau_avg, dtau_avg, ray.shellVol, star.photonRate);
+					m_sourceColumns[cell.id] = tau + dtau;
+					m_sourceColumnsAvg[cell.id] = tau_avg + dtau_avg;
+				});
+			},
+			[&](const GridCell& cell, PartitionManager& partition) {
+				partition.addSendItem(m_sourceColumns[cell.id]);
+				partition.addSendItem(m_sourceColumnsAvg[cell.id]);
+			});
+	}
+}
+
 void Radiation::update_HIIfrac(double dt, GridCell& cell, Fluid& fluid) const {
 	Grid& grid = fluid.getGrid();
 	Star& star = fluid.getStar();
+	const RayGeometry& ray = grid.getRayGeometry(cell.id);
+	// Rates of the extra sources (see traceSources), at the HII fractions the scheme evaluates the optical depths at.
+	const std::vector<double>& sourceRates = scheme == Scheme::IMPLICIT ? m_sourceRatesAvg : m_sourceRates;
+	const double A_src = sourceRates.empty() ? 0 : sourceRates[cell.id];
 
 	if(!isStar(cell, star)){
 		double n_H = massFractionH * cell.Q[UID::DEN] / m_consts->hydrogenMass;
 		double A_pi = 0;
 		double HII = cell.Q[UID::HII];
 		double HII_avg = HII;
-		double T = fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]);
-		double alphaB = recombinationRateCoefficient(T);
-		double A_ci = collisionalIonisationRate(T);
+		// The HII fraction of the cell is still the one preTimeStepCalculations found (see transferRadiationDecoupled).
+		const CellRates rates = m_cellRatesCurrent ? m_cellRates[cell.id] :
+				cellRates(cell, fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]), fluid);
+		double alphaB = rates.alphaB;
+		double A_ci = rates.A_ci;
+		if ((scheme == Scheme::IMPLICIT || scheme == Scheme::IMPLICIT2) && ionisedSkips > 0 &&
+				cell.id < (int)m_equilibriumSkips.size() && m_equilibriumSkips[cell.id] > 0) {
+			--m_equilibriumSkips[cell.id];
+			cell.R[RID::HII_A] = HII;
+			return;
+		}
 		if (scheme == Scheme::IMPLICIT || scheme == Scheme::IMPLICIT2) {
+			auto notConverging = [&]() -> std::string {
+				std::stringstream out;
+				out << "Radiation::calculate_HIIfrac: implicit method not converging.\n";
+				out << "temperature = " << fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]) << '\n';
+				out << "A_pi = " << A_pi << '\n';
+				out << "alphaB = " << alphaB << '\n';
+				out << "hii_dot = " << HIIfracRate(A_pi, A_ci, alphaB, n_H, cell.Q[UID::HII]) << '\n';
+				out << printInfo();
+				out << cell.printInfo();
+				out << ray.printInfo();
+				if (cell.R[RID::TAU] != cell.R[RID::TAU]) {
+					out << "Radiation::calculate_HIIfrac(): tau is NaN.\n";
+					for (int neighbourID : ray.neighbourIDs) {
+						if (grid.cellExists(neighbourID))
+							out << grid.getCell(neighbourID).printInfo();
+					}
+				}
+				return out.str();
+			};
 			double convergence2 = 1.0e-3;
 			double convergence_frac = 1.0e-5;
 			double HII_avg_old;
 			int niter = 0;
 			int miter = 0;
+			int iterations = 0; // All of the iterations, across the restarts counted by miter.
 			bool converged = false;
 			//HII_avg = cell.R[ihiita];
 			double tau_avg = cell.R[RID::TAU_A];
 			if (scheme == Scheme::IMPLICIT2) tau_avg = cell.R[RID::TAU];
+			const PhotoRate photo = photoRate(tau_avg, ray, fluid.getStar().photonRate);
+			// The rates of a neutral cell shielded from the star hardly depend on its time averaged HII fraction, so a single
+			// update with the rates at its current HII fraction stands in for the solve.
+			if (neutralTolerance > 0 && HII < neutralTolerance) {
+				A_pi = photoionisationRate(photo, (1.0-HII)*n_H) + A_src;
+				double nHII_aB = HII*n_H*alphaB;
+				double nHII_Aci = HII*n_H*A_ci;
+				if (dt*(A_pi + nHII_aB + nHII_Aci) < neutralTolerance) {
+					doric(dt, HII_avg, HII, A_pi, nHII_aB, nHII_Aci);
+					converged = true;
+				}
+			}
+			// Deep in the HII region a cell sits at ionisation equilibrium, so if its HII fraction hardly changes at the rates
+			// of its current one, a single update with those rates stands in for the solve, and the next ionisedSkips
+			// updates keep the HII fraction as it is. Each update changes the neutral fraction by less than ionisedTolerance
+			// of itself when the cell is checked, so a cell leaves the fast path within ionisedSkips updates of the front or
+			// a density change reaching it.
+			if (ionisedTolerance > 0 && !converged && 1.0 - HII < ionisedTolerance) {
+				A_pi = photoionisationRate(photo, (1.0-HII)*n_H) + A_src;
+				if (dt*std::abs(HIIfracRate(A_pi, A_ci, alphaB, n_H, HII)) < ionisedTolerance*(1.0 - HII)) {
+					doric(dt, HII_avg, HII, A_pi, HII*n_H*alphaB, HII*n_H*A_ci);
+					if (ionisedSkips > 0 && cell.id < (int)m_equilibriumSkips.size())
+						m_equilibriumSkips[cell.id] = ionisedSkips;
+					converged = true;
+				}
+			}
+			// Deep in the shadow of the Star, with no other source lighting the cell, the photoionisation is negligible.
+			if (shadowTau > 0 && !converged && tau_avg > shadowTau && A_src == 0 &&
+					shadowedHIIfrac(dt, n_H, alphaB, A_ci, HII_avg, HII)) {
+				++m_shadowedCounts[Parallel::threadID()];
+				converged = true;
+			}
+			if (hiiSolver == HIISolver::NEWTON && !converged) {
+				niter = solveHIIavgNewton(dt, n_H, alphaB, A_ci, photo, A_src, HII_avg, HII, A_pi);
+				if (niter == 0 || HII != HII)
+					throw std::runtime_error(notConverging());
+				iterations = niter;
+				converged = true;
+			}
 			while (!converged){
 				niter++;
+				iterations++;
 				HII_avg_old = HII_avg;
 				HII = cell.Q[UID::HII];
-				double dtau_avg = (1.0-HII_avg)*n_H*photoIonCrossSection*cell.ds;
-				//double T = temperature(cell.Q[ipre], cell.Q[iden], HII_avg);
-				double nHI = (1.0-HII_avg)*n_H;
-				A_pi = photoionisationRate(nHI, tau_avg, dtau_avg, cell.shellVol, fluid.getStar().photonRate);
+				A_pi = photoionisationRate(photo, (1.0-HII_avg)*n_H) + A_src;
 				double nHII_aB = HII_avg*n_H*alphaB;
 				double nHII_Aci = HII_avg*n_H*A_ci;
 
@@ -409,35 +1157,20 @@ void Radiation::update_HIIfrac(double dt, GridCell& cell, Fluid& fluid) const {
 
 				if ((fabs((HII_avg-HII_avg_old)/HII_avg) < convergence2 || (HII_avg < convergence_frac) || A_pi == 0))
 					converged = true;
-				if (niter > 10000 && miter > 5) {
-					Logger::Instance().print<SeverityType::WARNING>(
-							"Radiation::calculate_HIIfrac: slow iteration: HII_avg = ", HII_avg, ", HII_avg_old = ", HII_avg_old, ", HII = ", HII, '\n'
-					);
-				}
 				if (niter > 10005) {
 					miter++;
 					niter = 0;
 					HII_avg = 0.5*(HII_avg + HII_avg_old);
 				}
-				if (miter > 5  || HII != HII) {
-					std::stringstream out;
-					out << "Radiation::calculate_HIIfrac: implicit method not converging.\n";
-					out << "temperature = " << fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]) << '\n';
-					out << "A_pi = " << A_pi << '\n';
-					out << "alphaB = " << alphaB << '\n';
-					out << "hii_dot = " << HIIfracRate(A_pi, A_ci, alphaB, n_H, cell.Q[UID::HII]) << '\n';
-					out << printInfo();
-					out << cell.printInfo();
-					if (cell.R[RID::TAU] != cell.R[RID::TAU]) {
-						out << "Radiation::calculate_HIIfrac(): tau is NaN.\n";
-						for (int neighbourID : cell.neighbourIDs) {
-							if (grid.cellExists(neighbourID))
-								out << grid.getCell(neighbourID).printInfo();
-						}
-					}
-					throw std::runtime_error(out.str());
-				}
+				if (miter > 5  || HII != HII)
+					throw std::runtime_error(notConverging());
 			}
+			if (iterations > SLOW_ITERATIONS)
+				m_slowIterations.record(iterations, cell.xc);
+			if (iterationStats)
+				recordIterations(iterations);
+			if (grid.countsWork())
+				grid.getWork(cell.id)[WID::HII_ITERATIONS] += iterations;
 			cell.R[RID::HII_A] = HII_avg;
 		}
 		else if (scheme == Scheme::EXPLICIT){
@@ -445,7 +1178,7 @@ void Radiation::update_HIIfrac(double dt, GridCell& cell, Fluid& fluid) const {
 			tau = cell.R[RID::TAU];
 			dtau = cell.R[RID::DTAU];
 			double nHI = (1.0-HII)*(massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass);
-			A_pi = photoionisationRate(nHI, tau, dtau, cell.shellVol, fluid.getStar().photonRate);
+			A_pi = photoionisationRate(nHI, tau, dtau, ray.shellVol, fluid.getStar().photonRate) + A_src;
 			double nHII_aB = HII_avg*n_H*alphaB;
 			double nHII_Aci = HII_avg*n_H*A_ci;
 			//set_HIIfrac(HII+dt*HIIfracDot(A_pi, HII) );
@@ -477,212 +1210,780 @@ void Radiation::update_HIIfrac(double dt, GridCell& cell, Fluid& fluid) const {
 	}
 }
 
-void Radiation::rayTrace(Fluid& fluid) const {
+/**
+ * @brief Calculates the instantaneous column densities of the cells in a RayTile, threading over the cells of each
+ * dependency level.
+ *
+ * Scheme::IMPLICIT2 and Scheme::EXPLICIT read nothing but the instantaneous optical depths, so the time averaged ones are
+ * left to traceAveragedColumns.
+ * @param tile The RayTile.
+ * @param fluid The Fluid.
+ */
+void Radiation::rayTrace(const RayTile& tile, Fluid& fluid) const {
 	Grid& grid = fluid.getGrid();
-	if (fluid.getStar().on) {
-		for (int cellID : grid.getOrderedIndices("CausalWind")) {
-			GridCell& cell = grid.getCell(cellID);
+	Parallel::forEach(0, tile.windIDs.size(), [&](int i) {
+		GridCell& cell = grid.getCell(tile.windIDs[i]);
 
-			cell.R[RID::TAU] = 0;
-			cell.R[RID::TAU_A] = 0;
-			cell.R[RID::DTAU] = 0;
-			cell.R[RID::DTAU_A] = 0;
-			cell.Q[UID::HII] = 1;
-			cell.R[RID::HII_A] = 1;
-		}
-		bool average = true;
-		/** Causally loop over cells in grid */
-		for (int cellID : grid.getOrderedIndices("CausalNonWind")) {
-			GridCell& cell = grid.getCell(cellID);
+		cell.R[RID::TAU] = 0;
+		cell.R[RID::TAU_A] = 0;
+		cell.R[RID::DTAU] = 0;
+		cell.R[RID::DTAU_A] = 0;
+		cell.Q[UID::HII] = 1;
+		cell.R[RID::HII_A] = 1;
+		storeColumns(cell);
+	});
+	/** Causally loop over cells in grid */
+	Parallel::forEachLevel(tile.nonWindLevels, [&](int i) {
+		int cellID = tile.nonWindIDs[i];
+		GridCell& cell = grid.getCell(cellID);
+		const RayGeometry& ray = grid.getRayGeometry(cellID);
 
-			double dist2 = 0;
-			for (int i = 0; i < m_consts->nd; ++i)
-				dist2 += (cell.xc[i] - fluid.getStar().xc[i])*(cell.xc[i] - fluid.getStar().xc[i]);
-			/** Calculate column densities */
-			updateTauSC(average==false, cell, fluid, dist2);
-			double nH = massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass;
-			cell.R[RID::DTAU] = calc_dtau((1.0 - cell.Q[UID::HII])*nH, cell.ds);
-			cell.R[RID::DTAU_A] = calc_dtau((1.0 - cell.R[RID::HII_A])*nH, cell.ds);
-		}
+		/** Calculate column densities */
+		updateTauSC(false, cell, grid.neighbourWeights(cell.xc, fluid.getStar().xc), ray.dist2);
+		double nH = massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass;
+		cell.R[RID::DTAU] = calc_dtau((1.0 - cell.Q[UID::HII])*nH, ray.ds);
+		storeColumns(cell);
+	});
+}
+
+/**
+ * @brief Ray traces the time averaged column densities (TAU_A and DTAU_A) from the time averaged HII fractions of the
+ * last step, for the schemes that do not trace them every step, so a restart file holds both. Collective.
+ *
+ * Scheme::IMPLICIT traces both every step, so there is nothing to do for it, nor while the Star is off.
+ * @param fluid The Fluid.
+ */
+void Radiation::traceAveragedColumns(Fluid& fluid) const {
+	if (scheme == Scheme::IMPLICIT || !fluid.getStar().on)
+		return;
+	Grid& grid = fluid.getGrid();
+	sweepColumnDensities(fluid, false,
+		[](GridCell& ghost, PartitionManager& partition) {
+			ghost.R[RID::DTAU_A] = partition.getRecvItem();
+			ghost.R[RID::TAU_A] = partition.getRecvItem();
+		},
+		[&](const RayTile& tile) {
+			for (int id : tile.windIDs) {
+				GridCell& cell = grid.getCell(id);
+				cell.R[RID::TAU_A] = 0;
+				cell.R[RID::DTAU_A] = 0;
+				storeColumns(cell);
+			}
+			Parallel::forEachLevel(tile.nonWindLevels, [&](int i) {
+				GridCell& cell = grid.getCell(tile.nonWindIDs[i]);
+				const RayGeometry& ray = grid.getRayGeometry(cell.id);
+				updateTauSC(true, cell, grid.neighbourWeights(cell.xc, fluid.getStar().xc), ray.dist2);
+				double nH = massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass;
+				cell.R[RID::DTAU_A] = calc_dtau((1.0 - cell.R[RID::HII_A])*nH, ray.ds);
+				storeColumns(cell);
+			});
+		},
+		[](const GridCell& cell, PartitionManager& partition) {
+			partition.addSendItem(cell.R[RID::DTAU_A]);
+			partition.addSendItem(cell.R[RID::TAU_A]);
+		});
+}
+
+/**
+ * @brief Ray traces the column densities of the Grid a RayTile at a time (see Fluid::sweepRayTiles), also tracing those
+ * of Thermodynamics if fused with it (see fuseColumnDensities).
+ *
+ * Fused, the column densities of both are calculated in one traversal of the causal order and share one message per
+ * tile and processor boundary, rather than each making a sweep of its own.
+ * @param fluid The Fluid.
+ * @param fuse Whether to trace the column densities of Thermodynamics, if fused with it.
+ * @param unpack Reads the radiation column densities of a ghost cell.
+ * @param trace Traces the radiation column densities of a tile.
+ * @param pack Adds the radiation column densities of a cell to a message.
+ */
+template <class Unpack, class Trace, class Pack>
+void Radiation::sweepColumnDensities(Fluid& fluid, bool fuse, Unpack unpack, Trace trace, Pack pack) const {
+	sweepColumnDensities(fluid, fuse, unpack, trace, pack, [](const RayTile&) {});
+}
+
+/**
+ * @brief Ray traces the column densities as above, finishing each tile once they have been sent (see
+ * Fluid::sweepRayTiles).
+ * @param finish Called as finish(const RayTile& tile).
+ */
+template <class Unpack, class Trace, class Pack, class Finish>
+void Radiation::sweepColumnDensities(Fluid& fluid, bool fuse, Unpack unpack, Trace trace, Pack pack, Finish finish) const {
+	// The traces read the columns of the neighbours from m_columns, which the ghost cells join as they are received.
+	gatherColumns(fluid.getGrid());
+	const Thermodynamics* thermodynamics = fuse ? m_thermodynamics : nullptr;
+	if (thermodynamics == nullptr) {
+		fluid.sweepRayTiles(fluid.getStar(), fluid.getGrid().getRayTiles(), SendID::RADIATION_MSG,
+			[&](GridCell& ghost, PartitionManager& partition) {
+				unpack(ghost, partition);
+				storeColumns(ghost);
+			},
+			trace, pack, finish);
+		return;
 	}
+	fluid.sweepRayTiles(fluid.getStar(), fluid.getGrid().getRayTiles(), SendID::RADIATION_MSG,
+		[&](GridCell& ghost, PartitionManager& partition) {
+			unpack(ghost, partition);
+			storeColumns(ghost);
+			Thermodynamics::unpackColumnDensities(ghost, partition);
+		},
+		[&](const RayTile& tile) {
+			thermodynamics->rayTrace(tile, fluid);
+			trace(tile);
+		},
+		[&](const GridCell& cell, PartitionManager& partition) {
+			pack(cell, partition);
+			Thermodynamics::packColumnDensities(cell, partition);
+		},
+		finish);
+	fluid.getGrid().hasColumnDensities = true;
+	fluid.getGrid().hasTracedColumnDensities = true;
 }
 
 void Radiation::transferRadiation2(double dt, Fluid& fluid) const {
-	MPIW& mpihandler = MPIW::Instance();
 	Grid& grid = fluid.getGrid();
 	Star& star = fluid.getStar();
 
 	if (star.on) {
-		PartitionManager& partition = grid.getPartitionManager();
-		/** Wait for column densities */
-		if (star.core != Star::Location::HERE) {
-			int source = star.core == Star::Location::LEFT ? mpihandler.rank - 1 : mpihandler.rank + 1;
-			partition.recvData(source, SendID::RADIATION_MSG);
-
-			for (GridCell& ghost : grid.getIterable(star.core == Star::Location::LEFT ? "LeftPartitionCells" : "RightPartitionCells")) {
+		if (!fluid.getSources().empty())
+			traceSources(fluid);
+		/** Calculate column densities, a tile at a time so they are passed on to the processors further from the star as
+		 * soon as possible */
+		sweepColumnDensities(fluid, true,
+			[](GridCell& ghost, PartitionManager& partition) {
 				ghost.R[RID::DTAU] = partition.getRecvItem();
 				ghost.R[RID::TAU] = partition.getRecvItem();
-			}
-		}
-		/** Calculate column densities */
-		rayTrace(fluid);
-		/** Send column densities to processor on left */
-		if (!(mpihandler.getRank() == 0 || star.core == Star::Location::LEFT)) {
-			for (GridCell& ghost : grid.getIterable("LeftPartitionCells")) {
-				GridCell& cell = grid.right(0, ghost);
-				partition.addSendItem(cell.R[RID::DTAU]);
-				partition.addSendItem(cell.R[RID::TAU]);
-			}
-			int destination = mpihandler.rank - 1;
-			partition.sendData(destination, SendID::RADIATION_MSG);
-		}
-		/** Send column densities to processor on right */
-		if (!(mpihandler.getRank() == mpihandler.nProcessors()-1 || star.core == Star::Location::RIGHT)) {
-			for (GridCell& ghost : grid.getIterable("RightPartitionCells")) {
-				GridCell& cell = grid.left(0, ghost);
+			},
+			[&](const RayTile& tile) { rayTrace(tile, fluid); },
+			[](const GridCell& cell, PartitionManager& partition) {
 				partition.addSendItem(cell.R[RID::DTAU]);
 				partition.addSendItem(cell.R[RID::TAU]);
-			}
-			int destination = mpihandler.rank + 1;
-			partition.sendData(destination, SendID::RADIATION_MSG);
-		}
-		for (int cellID : grid.getOrderedIndices("CausalNonWind")) {
+			});
+		for (int cellID : grid.getOrderedIndices(CellOrder::CAUSAL_NON_WIND)) {
 			GridCell& cell = grid.getCell(cellID);
 			update_HIIfrac(dt, cell, fluid);
 		}
 	}
 	else {
-		double HII_dummy = 0, HII;
-		for (GridCell& cell : grid.getIterable("GridCells")) {
-			HII = cell.Q[UID::HII];
-			HII_dummy = HII;
-			double n_H = massFractionH*cell.Q[UID::DEN] / m_consts->hydrogenMass;
-			double T = fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]);
-			double nHII_aB = HII*n_H*recombinationRateCoefficient(T);
-			double nHII_Aci = HII*n_H*collisionalIonisationRate(T);
-			doric(dt, HII, HII_dummy, 0, nHII_aB, nHII_Aci);
-			cell.Q[UID::HII] = HII;
-		}
+		recombineCells(dt, fluid, CellRange::GRID_CELLS);
 	}
 }
 
-void Radiation::transferRadiation(double dt, Fluid& fluid) const {
-	MPIW& mpihandler = MPIW::Instance();
+/**
+ * @brief Updates the HII fractions of a range of cells by recombination and collisional ionisation alone, as they are
+ * while the Star is off, with a single doricBatch.
+ *
+ * The cells are left with their time averaged HII fractions, as the cell by cell doric updates this replaced left them.
+ */
+void Radiation::recombineCells(double dt, Fluid& fluid, CellRange range) const {
 	Grid& grid = fluid.getGrid();
-	Star& star = fluid.getStar();
+	GridCellVector& cells = grid.getCells();
+	FieldLooper fields = grid.getFieldIterable(range);
+	const int first = fields.first();
+	const int n = fields.last() - first;
+	std::vector<double> Api(n, 0), nHII_aB(n), nHII_Aci(n), HII_avg(n), HII(n);
+	Parallel::forEach(0, n, [&](int i) {
+		const GridCell& cell = cells[first + i];
+		HII[i] = cell.Q[UID::HII];
+		double n_H = massFractionH*cell.Q[UID::DEN] / m_consts->hydrogenMass;
+		double T = fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]);
+		nHII_aB[i] = HII[i]*n_H*recombinationRateCoefficient(T);
+		nHII_Aci[i] = HII[i]*n_H*collisionalIonisationRate(T);
+	});
+	doricBatch(n, dt, Api.data(), nHII_aB.data(), nHII_Aci.data(), HII_avg.data(), HII.data());
+	Parallel::forEach(0, n, [&](int i) { cells[first + i].Q[UID::HII] = HII_avg[i]; });
+}
 
-	if (fluid.getStar().on) {
-		PartitionManager& partition = grid.getPartitionManager();
-		partition.resetBuffer();
-		/** Wait for column densities */
-		if (fluid.getStar().core != Star::Location::HERE) {
-			int source = star.core == Star::Location::LEFT ? mpihandler.rank - 1 : mpihandler.rank + 1;
-			partition.recvData(source, SendID::RADIATION_MSG);
-
-			for (GridCell& ghost : grid.getIterable(star.core == Star::Location::LEFT ? "LeftPartitionCells" : "RightPartitionCells")) {
-				ghost.R[RID::DTAU] = partition.getRecvItem();
-				ghost.R[RID::TAU] = partition.getRecvItem();
-				ghost.R[RID::DTAU_A] = partition.getRecvItem();
-				ghost.R[RID::TAU_A] = partition.getRecvItem();
-			}
+/**
+ * @brief Reads the instantaneous and time averaged column densities of a ghost cell sent by packColumnDensities.
+ */
+static void unpackColumnDensities(GridCell& ghost, PartitionManager& partition) {
+	ghost.R[RID::DTAU] = partition.getRecvItem();
+	ghost.R[RID::TAU] = partition.getRecvItem();
+	ghost.R[RID::DTAU_A] = partition.getRecvItem();
+	ghost.R[RID::TAU_A] = partition.getRecvItem();
+}
+
+static void packColumnDensities(const GridCell& cell, PartitionManager& partition) {
+	partition.addSendItem(cell.R[RID::DTAU]);
+	partition.addSendItem(cell.R[RID::TAU]);
+	partition.addSendItem(cell.R[RID::DTAU_A]);
+	partition.addSendItem(cell.R[RID::TAU_A]);
+}
+
+/**
+ * @brief Links the cells of the coarse copy of the Fluid to the Fluid's (see CoarseTrace) and finds the ray geometry of
+ * the coarse cells, after the copy's Grid or Star has been rebuilt.
+ */
+void Radiation::linkCoarseCells(Fluid& fluid) const {
+	Grid& grid = fluid.getGrid();
+	Grid& coarseGrid = m_coarse.fluid->getGrid();
+	const Star& coarseStar = m_coarse.fluid->getStar();
+	const int nd = m_consts->nd;
+	int nsub = 1;
+	for (int idim = 0; idim < nd; ++idim)
+		nsub *= coarseFactor;
+
+	FieldLooper fields = coarseGrid.getFieldIterable(CellRange::GRID_CELLS);
+	const int first = fields.first();
+	m_coarse.fineIDs.assign((fields.last() - first)*nsub, -1);
+	Parallel::forEach(first, fields.last(), [&](int id) {
+		const GridCell& coarseCell = coarseGrid.getCell(id);
+		for (int isub = 0; isub < nsub; ++isub) {
+			std::array<int, 3> c{{ 0, 0, 0 }};
+			for (int idim = 0, rest = isub; idim < nd; ++idim, rest /= coarseFactor)
+				c[idim] = (int)std::floor(coarseCell.xc[idim])*coarseFactor + rest%coarseFactor;
+			m_coarse.fineIDs[(id - first)*nsub + isub] = grid.locate(c[0], c[1], c[2]);
 		}
-		/** Causal ray tracing and integrating for HII fraction */
-		for (int cellID : grid.getOrderedIndices("CausalWind")) {
-			GridCell& cell = grid.getCell(cellID);
-			cell.R[RID::TAU] = 0;
-			cell.R[RID::TAU_A] = 0;
-			cell.R[RID::DTAU] = 0;
-			cell.R[RID::DTAU_A] = 0;
-			cell.Q[UID::HII] = 1;
-			cell.R[RID::HII_A] = 1;
+	});
+
+	m_coarse.coarseIDs.assign(grid.getCells().size(), -1);
+	m_coarse.farIDs.clear();
+	for (int cellID : grid.getOrderedIndices(CellOrder::CAUSAL_NON_WIND)) {
+		const GridCell& cell = grid.getCell(cellID);
+		std::array<int, 3> c{{ 0, 0, 0 }};
+		for (int idim = 0; idim < nd; ++idim)
+			c[idim] = (int)std::floor(cell.xc[idim])/coarseFactor;
+		if (grid.getRayGeometry(cellID).dist2 > coarseRadius*coarseRadius) {
+			m_coarse.coarseIDs[cellID] = coarseGrid.locate(c[0], c[1], c[2]);
+			m_coarse.farIDs.push_back(cellID);
 		}
-		bool average = true;
-		for (int cellID : grid.getOrderedIndices("CausalNonWind")) {
-			GridCell& cell = grid.getCell(cellID);
+	}
 
-			double dist2 = 0;
-			for (int i = 0; i < m_consts->nd; ++i)
-				dist2 += (cell.xc[i] - fluid.getStar().xc[i])*(cell.xc[i] - fluid.getStar().xc[i]);
-			updateTauSC(average==false, cell, fluid, dist2);
-			updateTauSC(average==true, cell, fluid, dist2);
-			update_HIIfrac(dt, cell, fluid);
+	coarseGrid.calculateNearestNeighbours(coarseStar.xc);
+	for (GridCell& cell : coarseGrid.getIterable(CellRange::GRID_CELLS))
+		coarseGrid.getRayGeometry(cell.id).ds = cellPathLength(cell.xc, coarseStar.xc, coarseGrid.dx);
+}
+
+/**
+ * @brief Ray traces the optical depths of the cells further than coarseRadius from the Star on a copy of the Fluid with
+ * coarseFactor times fewer cells along each side.
+ *
+ * The neutral hydrogen densities of the fine cells, at their HII and time averaged HII fractions, are averaged onto
+ * their coarse cells, which are traced in causal order like the Grid (see Fluid::sweepRayTiles). Each far cell is then
+ * given the optical depths of its coarse cell up to where it starts along the ray. A cell nearer the Star than
+ * coarseRadius only reads the column densities of cells nearer still, so the near cells can still be traced at full
+ * resolution afterwards, while the far cells are left out of that trace. The copy is rebuilt with the Grid (e.g. after a
+ * repartition) and its Star placed again whenever the Star moves into another cell. Collective.
+ * @param fluid The Fluid.
+ */
+void Radiation::traceCoarse(Fluid& fluid) const {
+	if (m_coarse.fluid == nullptr)
+		m_coarse.fluid = std::make_shared<Fluid>();
+	Fluid& coarse = *m_coarse.fluid;
+	const bool rebuilt = fluid.getGridBuilds() != m_coarse.gridBuilds;
+	if (rebuilt) {
+		coarse.coarsenGrid(fluid, coarseFactor);
+		m_coarse.gridBuilds = fluid.getGridBuilds();
+	}
+	if (rebuilt || fluid.getStarPlacements() != m_coarse.starPlacements) {
+		coarse.coarsenStar(fluid, coarseFactor);
+		m_coarse.starPlacements = fluid.getStarPlacements();
+		linkCoarseCells(fluid);
+	}
+
+	Grid& grid = fluid.getGrid();
+	Grid& coarseGrid = coarse.getGrid();
+	const Star& star = fluid.getStar();
+	const Star& coarseStar = coarse.getStar();
+	FieldLooper fields = coarseGrid.getFieldIterable(CellRange::GRID_CELLS);
+	const int first = fields.first();
+	const int nsub = (int)m_coarse.fineIDs.size()/(fields.last() - first);
+	Parallel::forEach(first, fields.last(), [&](int id) {
+		double nHI = 0, nHI_avg = 0;
+		for (int isub = 0; isub < nsub; ++isub) {
+			const GridCell& cell = grid.getCell(m_coarse.fineIDs[(id - first)*nsub + isub]);
 			double nH = massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass;
-			cell.R[RID::DTAU] = calc_dtau((1.0 - cell.Q[UID::HII])*nH, cell.ds);
-			cell.R[RID::DTAU_A] = calc_dtau((1.0 - cell.R[RID::HII_A])*nH, cell.ds);
+			nHI += (1.0 - cell.Q[UID::HII])*nH/nsub;
+			nHI_avg += (1.0 - cell.R[RID::HII_A])*nH/nsub;
 		}
-		/** Send column densities to processor on left */
-		if (!(mpihandler.getRank() == 0 || fluid.getStar().core == Star::Location::LEFT)) {
-			for (GridCell& ghost : grid.getIterable("LeftPartitionCells")) {
-				GridCell& cell = grid.right(0, ghost);
-				partition.addSendItem(cell.R[RID::DTAU]);
-				partition.addSendItem(cell.R[RID::TAU]);
-				partition.addSendItem(cell.R[RID::DTAU_A]);
-				partition.addSendItem(cell.R[RID::TAU_A]);
-			}
-			int destination = mpihandler.rank - 1;
-			partition.sendData(destination, SendID::RADIATION_MSG);
+		GridCell& coarseCell = coarseGrid.getCell(id);
+		const double ds = coarseGrid.getRayGeometry(id).ds;
+		coarseCell.R[RID::DTAU] = calc_dtau(nHI, ds);
+		coarseCell.R[RID::DTAU_A] = calc_dtau(nHI_avg, ds);
+	});
+
+	coarse.sweepRayTiles(SendID::RADIATION_MSG, unpackColumnDensities,
+		[&](const RayTile& tile) {
+			Parallel::forEach(0, tile.windIDs.size(), [&](int i) {
+				GridCell& cell = coarseGrid.getCell(tile.windIDs[i]);
+				cell.R[RID::TAU] = 0;
+				cell.R[RID::TAU_A] = 0;
+				cell.R[RID::DTAU] = 0;
+				cell.R[RID::DTAU_A] = 0;
+			});
+			Parallel::forEachLevel(tile.nonWindLevels, [&](int i) {
+				GridCell& cell = coarseGrid.getCell(tile.nonWindIDs[i]);
+				double dist2 = 0;
+				for (int idim = 0; idim < m_consts->nd; ++idim)
+					dist2 += (cell.xc[idim] - coarseStar.xc[idim])*(cell.xc[idim] - coarseStar.xc[idim]);
+				cell.R[RID::TAU] = 0;
+				cell.R[RID::TAU_A] = 0;
+				if (dist2 > 0.95) {
+					const RayGeometry& ray = coarseGrid.getRayGeometry(cell.id);
+					const std::array<double, 4> weights = coarseGrid.neighbourWeights(cell.xc, coarseStar.xc);
+					cell.R[RID::TAU] = interpolateTau(ray, weights, coarseGrid, [&](int neighbourID) {
+						const GridCell& neighbour = coarseGrid.getCell(neighbourID);
+						return neighbour.R[RID::TAU] + neighbour.R[RID::DTAU];
+					});
+					cell.R[RID::TAU_A] = interpolateTau(ray, weights, coarseGrid, [&](int neighbourID) {
+						const GridCell& neighbour = coarseGrid.getCell(neighbourID);
+						return neighbour.R[RID::TAU_A] + neighbour.R[RID::DTAU_A];
+					});
+				}
+			});
+		},
+		packColumnDensities);
+
+	// The fraction of the coarse cell's path before the fine cell starts, from their distances to their Stars.
+	Parallel::forEach(0, m_coarse.farIDs.size(), [&](int i) {
+		GridCell& cell = grid.getCell(m_coarse.farIDs[i]);
+		const GridCell& coarseCell = coarseGrid.getCell(m_coarse.coarseIDs[cell.id]);
+		double r_sqrd = 0, coarse_r_sqrd = 0;
+		for (int idim = 0; idim < m_consts->nd; ++idim) {
+			double d = (cell.xc[idim] - star.xc[idim])*grid.dx[idim];
+			double dc = (coarseCell.xc[idim] - coarseStar.xc[idim])*coarseGrid.dx[idim];
+			r_sqrd += d*d;
+			coarse_r_sqrd += dc*dc;
 		}
-		/** Send column densities to processor on right */
-		if (!(mpihandler.getRank() == mpihandler.nProcessors()-1 || fluid.getStar().core == Star::Location::RIGHT)) {
-			for (GridCell& ghost : grid.getIterable("RightPartitionCells")) {
-				GridCell& cell = grid.left(0, ghost);
-				partition.addSendItem(cell.R[RID::DTAU]);
-				partition.addSendItem(cell.R[RID::TAU]);
-				partition.addSendItem(cell.R[RID::DTAU_A]);
-				partition.addSendItem(cell.R[RID::TAU_A]);
-			}
-			int destination = mpihandler.rank + 1;
-			partition.sendData(destination, SendID::RADIATION_MSG);
+		const double ds = grid.getRayGeometry(cell.id).ds;
+		const double coarse_ds = coarseGrid.getRayGeometry(coarseCell.id).ds;
+		double s = 0;
+		if (coarse_ds > 0)
+			s = ((std::sqrt(r_sqrd) - 0.5*ds) - (std::sqrt(coarse_r_sqrd) - 0.5*coarse_ds))/coarse_ds;
+		s = std::max(0.0, std::min(1.0, s));
+		cell.R[RID::TAU] = coarseCell.R[RID::TAU] + s*coarseCell.R[RID::DTAU];
+		cell.R[RID::TAU_A] = coarseCell.R[RID::TAU_A] + s*coarseCell.R[RID::DTAU_A];
+	});
+}
+
+/**
+ * @brief Whether a cell takes its optical depths from the coarse trace (see traceCoarse).
+ */
+bool Radiation::isCoarse(int cellID) const {
+	return coarseFactor > 1 && m_coarse.coarseIDs[cellID] >= 0;
+}
+
+/**
+ * @brief Coupled implicit scheme, which solves the HII fractions of each RayTile as it is traced.
+ * @param dt Time step.
+ * @param fluid The Fluid.
+ * @param finishTile Called on each tile once its column densities have been sent, if the Star is on (may be empty).
+ */
+void Radiation::transferRadiation(double dt, Fluid& fluid, const std::function<void(const RayTile&)>& finishTile) const {
+	Grid& grid = fluid.getGrid();
+
+	if (fluid.getStar().on) {
+		// The extra sources are traced at the HII fractions the step starts from, before the Star's trace and solve.
+		if (!fluid.getSources().empty())
+			traceSources(fluid);
+		// The far cells read nothing but the coarse optical depths, so they are solved all at once ahead of the sweep.
+		if (coarseFactor > 1) {
+			traceCoarse(fluid);
+			Parallel::forEach(0, m_coarse.farIDs.size(), [&](int i) {
+				GridCell& cell = grid.getCell(m_coarse.farIDs[i]);
+				update_HIIfrac(dt, cell, fluid);
+				double nH = massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass;
+				double ds = grid.getRayGeometry(cell.id).ds;
+				cell.R[RID::DTAU] = calc_dtau((1.0 - cell.Q[UID::HII])*nH, ds);
+				cell.R[RID::DTAU_A] = calc_dtau((1.0 - cell.R[RID::HII_A])*nH, ds);
+			});
 		}
+		/** Causal ray tracing and integrating for HII fraction, a tile at a time so the column densities are passed on to
+		 * the processors further from the star as soon as possible */
+		sweepColumnDensities(fluid, true, unpackColumnDensities,
+			[&](const RayTile& tile) {
+				Parallel::forEach(0, tile.windIDs.size(), [&](int i) {
+					GridCell& cell = grid.getCell(tile.windIDs[i]);
+					cell.R[RID::TAU] = 0;
+					cell.R[RID::TAU_A] = 0;
+					cell.R[RID::DTAU] = 0;
+					cell.R[RID::DTAU_A] = 0;
+					cell.Q[UID::HII] = 1;
+					cell.R[RID::HII_A] = 1;
+					storeColumns(cell);
+				});
+				// The cells of a dependency level only read column densities from earlier levels.
+				Parallel::forEachLevel(tile.nonWindLevels, [&](int i) {
+					int cellID = tile.nonWindIDs[i];
+					if (isCoarse(cellID))
+						return;
+					GridCell& cell = grid.getCell(cellID);
+					const RayGeometry& ray = grid.getRayGeometry(cellID);
+
+					const std::array<double, 4> weights = grid.neighbourWeights(cell.xc, fluid.getStar().xc);
+					updateTausSC(cell, weights, ray.dist2);
+					update_HIIfrac(dt, cell, fluid);
+					double nH = massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass;
+					double ds = ray.ds;
+					cell.R[RID::DTAU] = calc_dtau((1.0 - cell.Q[UID::HII])*nH, ds);
+					cell.R[RID::DTAU_A] = calc_dtau((1.0 - cell.R[RID::HII_A])*nH, ds);
+					storeColumns(cell);
+				});
+			},
+			packColumnDensities,
+			[&](const RayTile& tile) {
+				if (finishTile)
+					finishTile(tile);
+			});
 	}
 	else {
-		double HII_dummy = 0, HII;
-		for (GridCell& cell : grid.getIterable("AllCells")) {
-			HII = cell.Q[UID::HII];
-			HII_dummy = HII;
-			double n_H = massFractionH*cell.Q[UID::DEN] / m_consts->hydrogenMass;
-			double T = fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]);
-			double nHII_aB = HII*n_H*recombinationRateCoefficient(T);
-			double nHII_Aci = HII*n_H*collisionalIonisationRate(T);
-			doric(dt, HII, HII_dummy, 0, nHII_aB, nHII_Aci);
-			cell.Q[UID::HII] = HII;
+		// The ghost cells are refilled from the core cells before the next hydrodynamic sweep reads them.
+		recombineCells(dt, fluid, CellRange::GRID_CELLS);
+	}
+}
+
+/**
+ * @brief Ray traces the optical depths of a 1D Grid from the Star as running sums, with a single collective in place of
+ * the relay of the column densities from processor to processor. Collective.
+ *
+ * In 1D every ray runs along x, so the optical depth to a cell is the sum of the DTAU of the cells between it and the
+ * Star, back to the nearest cell that starts the sum afresh: a wind cell, which is reset to no optical depth, or a cell
+ * next to the Star. Every processor sums its own cells on each side of the Star outwards, the sums are gathered, and
+ * each processor starts its running sums from those of the processors between it and the Star, so the trace no longer
+ * waits for the processors nearer the Star one after the other. The optical depths are the same as those of the sweep
+ * but for the rounding of the sums carried across processors.
+ * @param fluid The Fluid.
+ */
+void Radiation::traceRadial(Fluid& fluid) const {
+	Grid& grid = fluid.getGrid();
+	std::vector<bool> isWind(grid.getCells().size(), false);
+	for (const RayTile& tile : grid.getRayTiles())
+		for (int id : tile.windIDs)
+			isWind[id] = true;
+
+	// The cells on each side of the Star, outwards from it. A cell level with the Star is on both sides.
+	const double xs = fluid.getStar().xc[0];
+	std::array<std::vector<int>, 2> sides;
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		if (cell.xc[0] <= xs)
+			sides[0].push_back(cell.id);
+		if (cell.xc[0] >= xs)
+			sides[1].push_back(cell.id);
+	}
+	std::sort(sides[0].begin(), sides[0].end(), [&](int a, int b) { return grid.getCell(a).xc[0] > grid.getCell(b).xc[0]; });
+	std::sort(sides[1].begin(), sides[1].end(), [&](int a, int b) { return grid.getCell(a).xc[0] < grid.getCell(b).xc[0]; });
+
+	// Runs along a side from the optical depths through the cell before it, returning those through its last cell and
+	// whether the sum started afresh.
+	auto run = [&](const std::vector<int>& ids, std::array<double, 2> tau, bool write, bool& isRestarted) {
+		isRestarted = false;
+		for (int id : ids) {
+			GridCell& cell = grid.getCell(id);
+			if (isWind[id]) {
+				if (write) {
+					cell.R[RID::TAU] = 0;
+					cell.R[RID::TAU_A] = 0;
+					cell.R[RID::DTAU] = 0;
+					cell.R[RID::DTAU_A] = 0;
+					cell.Q[UID::HII] = 1;
+					cell.R[RID::HII_A] = 1;
+				}
+				tau = {{ 0, 0 }};
+				isRestarted = true;
+				continue;
+			}
+			const double dx = cell.xc[0] - xs;
+			if (!(dx*dx > 0.95)) {
+				tau = {{ 0, 0 }};
+				isRestarted = true;
+			}
+			if (write) {
+				cell.R[RID::TAU] = tau[0];
+				cell.R[RID::TAU_A] = tau[1];
+			}
+			tau[0] += cell.R[RID::DTAU];
+			tau[1] += cell.R[RID::DTAU_A];
+		}
+		return tau;
+	};
+
+	// Each processor's x coordinate and, for each side, whether its sum starts afresh and its two sums.
+	MPIW& mpihandler = MPIW::Instance();
+	std::vector<double> local = {(double)mpihandler.getCoords()[0]};
+	for (int side = 0; side < 2; ++side) {
+		bool isRestarted = false;
+		const std::array<double, 2> tau = run(sides[side], {{ 0, 0 }}, false, isRestarted);
+		local.insert(local.end(), {isRestarted ? 1.0 : 0.0, tau[0], tau[1]});
+	}
+	const int stride = (int)local.size();
+	const std::vector<double> all = mpihandler.allGather(local);
+	const int nprocs = (int)all.size()/stride;
+	std::vector<int> order(nprocs);
+	for (int i = 0; i < nprocs; ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int a, int b) { return all[a*stride] < all[b*stride]; });
+
+	const int coord = mpihandler.getCoords()[0];
+	for (int side = 0; side < 2; ++side) {
+		// The processors between this one and the Star, nearest the Star first.
+		std::array<double, 2> tau = {{ 0, 0 }};
+		for (int k = 0; k < nprocs; ++k) {
+			const double* block = &all[order[side == 0 ? nprocs - 1 - k : k]*stride];
+			if (side == 0 ? block[0] <= coord : block[0] >= coord)
+				break;
+			const double* sums = block + 1 + 3*side;
+			if (sums[0] != 0)
+				tau = {{ 0, 0 }};
+			tau[0] += sums[1];
+			tau[1] += sums[2];
+		}
+		bool isRestarted = false;
+		run(sides[side], tau, true, isRestarted);
+	}
+}
+
+/**
+ * @brief Implicit scheme with the ray trace decoupled from the ionisation solve.
+ *
+ * Each iteration first ray traces the column densities using the optical depths of every cell's current HII fraction
+ * estimate (the previous step's on the first iteration), then solves every cell's implicit HII fraction update
+ * independently, which is shared out between threads. The HII fractions start from the same value every iteration.
+ * The iterations stop after decoupledIterations, or once no HII fraction changes by more than decoupledTolerance between
+ * iterations. A single iteration lags the optical depths by a step relative to Radiation::transferRadiation.
+ * @param dt Time step.
+ * @param fluid The Fluid.
+ */
+void Radiation::transferRadiationDecoupled(double dt, Fluid& fluid) const {
+	Grid& grid = fluid.getGrid();
+	if (!fluid.getStar().on) {
+		transferRadiation(dt, fluid, std::function<void(const RayTile&)>());
+		return;
+	}
+
+	const std::vector<int>& nonWindIDs = grid.getOrderedIndices(CellOrder::CAUSAL_NON_WIND);
+	std::vector<double> HII_start(nonWindIDs.size()), HII_last(nonWindIDs.size()), HII_change(nonWindIDs.size(), 0);
+	for (unsigned int i = 0; i < nonWindIDs.size(); ++i)
+		HII_start[i] = HII_last[i] = grid.getCell(nonWindIDs[i]).Q[UID::HII];
+
+	for (int iter = 0; iter < decoupledIterations; ++iter) {
+		// The extra sources are traced again every iteration, at the latest HII fractions.
+		if (!fluid.getSources().empty())
+			traceSources(fluid);
+		if (coarseFactor > 1)
+			traceCoarse(fluid);
+		// The density does not change between iterations, so the column densities of Thermodynamics are traced once,
+		// and after that a 1D Grid is traced by running sums.
+		if (m_consts->nd == 1 && coarseFactor == 1 && (iter > 0 || m_thermodynamics == nullptr))
+			traceRadial(fluid);
+		else {
+			sweepColumnDensities(fluid, iter == 0, unpackColumnDensities,
+				[&](const RayTile& tile) {
+					Parallel::forEach(0, tile.windIDs.size(), [&](int i) {
+						GridCell& cell = grid.getCell(tile.windIDs[i]);
+						cell.R[RID::TAU] = 0;
+						cell.R[RID::TAU_A] = 0;
+						cell.R[RID::DTAU] = 0;
+						cell.R[RID::DTAU_A] = 0;
+						cell.Q[UID::HII] = 1;
+						cell.R[RID::HII_A] = 1;
+						storeColumns(cell);
+					});
+					Parallel::forEachLevel(tile.nonWindLevels, [&](int i) {
+						if (isCoarse(tile.nonWindIDs[i]))
+							return;
+						GridCell& cell = grid.getCell(tile.nonWindIDs[i]);
+						const std::array<double, 4> weights = grid.neighbourWeights(cell.xc, fluid.getStar().xc);
+						updateTausSC(cell, weights, grid.getRayGeometry(cell.id).dist2);
+						storeColumns(cell);
+					});
+				},
+				packColumnDensities);
 		}
+
+		// The solves are independent and may throw, so they go through Parallel::forEach rather than a reduction.
+		Parallel::forEach(0, nonWindIDs.size(), [&](int i) {
+			GridCell& cell = grid.getCell(nonWindIDs[i]);
+			cell.Q[UID::HII] = HII_start[i];
+			update_HIIfrac(dt, cell, fluid);
+			double nH = massFractionH*cell.Q[UID::DEN]/m_consts->hydrogenMass;
+			double ds = grid.getRayGeometry(cell.id).ds;
+			cell.R[RID::DTAU] = calc_dtau((1.0 - cell.Q[UID::HII])*nH, ds);
+			cell.R[RID::DTAU_A] = calc_dtau((1.0 - cell.R[RID::HII_A])*nH, ds);
+			HII_change[i] = std::abs(cell.Q[UID::HII] - HII_last[i]);
+			HII_last[i] = cell.Q[UID::HII];
+		});
+		double change = HII_change.empty() ? 0 : *std::max_element(HII_change.begin(), HII_change.end());
+		if (decoupledTolerance > 0 && MPIW::Instance().maximum(change) <= decoupledTolerance)
+			break;
 	}
 }
 
 void Radiation::updateSourceTerms(double dt, Fluid& fluid) const {
 	Grid& grid = fluid.getGrid();
 	if (fluid.getStar().on) {
-		for (GridCell& cell : grid.getIterable("GridCells")) {
-			if (coupling == Coupling::TWO_TEMP_ISOTHERMAL) {
-				double HII_new = cell.Q[UID::HII];
-				double mu_inv_new = massFractionH*(HII_new + 1.0) + (1.0 - massFractionH)*0.25;
-				double T_new = THI + (THII-THI)*HII_new;
-				double pre_new = m_consts->specificGasConstant*mu_inv_new*cell.Q[UID::DEN]*T_new;
+		GridCellVector& cells = grid.getCells();
+		FieldLooper fields = grid.getFieldIterable(CellRange::GRID_CELLS);
+		Parallel::forEach(fields.first(), fields.last(), [&](int id) { addSourceTerms(dt, cells[id]); });
+	}
+}
 
-				double ke = 0.0;
-				for (int dim = 0; dim < m_consts->nd; ++dim)
-					ke += 0.5*cell.U[UID::VEL+dim]*cell.U[UID::VEL+dim]/cell.U[UID::DEN];
+/**
+ * @brief updateSourceTerms(dt, fluid) restricted to the cells of a RayTile.
+ */
+void Radiation::updateSourceTerms(double dt, Fluid& fluid, const RayTile& tile) const {
+	Grid& grid = fluid.getGrid();
+	if (fluid.getStar().on) {
+		for (const std::vector<int>* cellIDs : { &tile.windIDs, &tile.nonWindIDs })
+			Parallel::forEach(0, (int)cellIDs->size(), [&](int i) { addSourceTerms(dt, grid.getCell((*cellIDs)[i])); });
+	}
+}
 
+/**
+ * @brief Brings the HII fractions of the Grid to the static photoionisation equilibrium of the Star on the density
+ * field as it is, e.g. the Stromgren sphere of a star switching on in a cloud, instead of following the R-type front.
+ *
+ * Each iteration takes a radiation step of length dt, long against the recombination times, so that the implicit
+ * update leaves each cell at the equilibrium of the optical depths of the cells before it, then sets the temperatures
+ * to the new HII fractions. With the two temperature coupling they are those of THI and THII; with the non-equilibrium
+ * coupling the ionised share of each cell is at THII and the rest at the cell's initial temperature (the net heating
+ * rate, which has no metal line cooling, would leave the ionised gas far hotter than it settles at), while without
+ * coupling the initial temperatures are kept. The iterations stop once no HII fraction has changed by more than
+ * tolerance, as the temperatures and recombination rates settle. Collective.
+ * @param dt Length of each radiation step.
+ * @param fluid The Fluid, whose primitive variables are left up to date.
+ * @param maxIterations Most iterations.
+ * @param tolerance Largest change of an HII fraction in the last iteration at which the equilibrium is reached.
+ * @return Iterations taken.
+ */
+int Radiation::solveEquilibrium(double dt, Fluid& fluid, int maxIterations, double tolerance) const {
+	Grid& grid = fluid.getGrid();
+	fluid.updatePrimitives();
+	std::vector<double> initialT(grid.getCells().size(), 0);
+	std::vector<double> previous(grid.getCells().size(), 0);
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS))
+		initialT[cell.id] = cell.getTemperature();
+	double change = 0;
+	int iteration = 0;
+	while (iteration < maxIterations) {
+		++iteration;
+		fluid.updatePrimitives();
+		preTimeStepCalculations(fluid);
+		for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS))
+			previous[cell.id] = cell.Q[UID::HII];
+		integrate(dt, fluid);
+		change = 0;
+		std::vector<GridCell*> cells;
+		for (GridCell& cell : grid.getIterable(CellRange::GRID_CELLS))
+			cells.push_back(&cell);
+		Parallel::forEach(0, (int)cells.size(), [&](int i) {
+			GridCell& cell = *cells[i];
+			const double HII = cell.Q[UID::HII];
+			double T = initialT[cell.id];
+			if (coupling == Coupling::TWO_TEMP_ISOTHERMAL)
+				T = THI + (THII - THI)*HII;
+			else if (coupling == Coupling::NON_EQUILIBRIUM)
+				T += (THII - T)*HII;
+			const double mu_inv = massFractionH*(HII + 1.0) + (1.0 - massFractionH)*0.25;
+			cell.Q[UID::PRE] = m_consts->specificGasConstant*mu_inv*cell.Q[UID::DEN]*T;
+		});
+		for (const GridCell* cell : cells)
+			change = std::max(change, std::abs(cell->Q[UID::HII] - previous[cell->id]));
+		fluid.globalUfromQ();
+		change = MPIW::Instance().maximum(change);
+		if (change <= tolerance)
+			break;
+	}
+	fluid.updatePrimitives();
+	std::ostringstream out;
+	out << "Radiation::solveEquilibrium: " << iteration << " iterations, last change in HII fraction " << change << ".\n";
+	Logger::Instance().print<SeverityType::NOTICE>(out.str());
+	return iteration;
+}
 
-				double E_new = pre_new/(cell.heatCapacityRatio-1.0) + ke;
+/**
+ * @brief Adds the change in the energy, HII and advected fractions of a cell over the HII fraction update to its rates of change.
+ */
+void Radiation::addSourceTerms(double dt, GridCell& cell) const {
+	if (coupling == Coupling::TWO_TEMP_ISOTHERMAL) {
+		double HII_new = cell.Q[UID::HII];
+		double mu_inv_new = massFractionH*(HII_new + 1.0) + (1.0 - massFractionH)*0.25;
+		double T_new = THI + (THII-THI)*HII_new;
+		double pre_new = m_consts->specificGasConstant*mu_inv_new*cell.Q[UID::DEN]*T_new;
 
-				cell.UDOT[UID::PRE] += (E_new-cell.U[UID::PRE])/dt;
-			}
-			else if (coupling == Coupling::NON_EQUILIBRIUM) {
-				cell.UDOT[UID::PRE] += cell.R[RID::HEAT];
-			}
+		double ke = 0.0;
+		for (int dim = 0; dim < m_consts->nd; ++dim)
+			ke += 0.5*cell.U[UID::VEL+dim]*cell.U[UID::VEL+dim]/cell.U[UID::DEN];
 
-			cell.UDOT[UID::HII] += (cell.Q[UID::HII]*cell.Q[UID::DEN] - cell.U[UID::HII])/dt;
-			cell.UDOT[UID::ADV] += (cell.Q[UID::ADV]*cell.Q[UID::DEN] - cell.U[UID::ADV])/dt;
-		}
+
+		double E_new = pre_new/(cell.heatCapacityRatio-1.0) + ke;
+
+		cell.UDOT[UID::PRE] += (E_new-cell.U[UID::PRE])/dt;
+	}
+	else if (coupling == Coupling::NON_EQUILIBRIUM && implicitHeating) {
+		// dp/dt = (gamma - 1)*heat(T), linearised about the start of the step and integrated exactly (exponential Euler).
+		// A heating rate that falls with the temperature relaxes the energy towards equilibrium instead of overshooting.
+		const double gm1 = cell.heatCapacityRatio - 1.0;
+		const double mu_inv = massFractionH*(cell.Q[UID::HII] + 1.0) + (1.0 - massFractionH)*0.25;
+		const double temp2pre = mu_inv*m_consts->specificGasConstant*cell.Q[UID::DEN];
+		const double J = std::min(0.0, gm1*m_cellRates[cell.id].dHeatdT/temp2pre);
+		double dE = (J*dt < -1.0e-8) ? cell.R[RID::HEAT]*std::expm1(J*dt)/J : cell.R[RID::HEAT]*dt;
+		// Nor may it cool the gas below its minimum temperature.
+		dE = std::max(dE, std::min(0.0, (cell.T_min*temp2pre - cell.Q[UID::PRE])/gm1));
+		cell.UDOT[UID::PRE] += dE/dt;
 	}
+	else if (coupling == Coupling::NON_EQUILIBRIUM) {
+		cell.UDOT[UID::PRE] += cell.R[RID::HEAT];
+	}
+
+	cell.UDOT[UID::HII] += (cell.Q[UID::HII]*cell.Q[UID::DEN] - cell.U[UID::HII])/dt;
+	cell.UDOT[UID::ADV] += (cell.Q[UID::ADV]*cell.Q[UID::DEN] - cell.U[UID::ADV])/dt;
 }
 
 bool Radiation::isStar(const GridCell& cell, const Star& star) const {
 	return ((int)cell.xc[0] == (int)star.xc[0] && (int)cell.xc[1] == (int)star.xc[1] && (int)cell.xc[2] == star.xc[2]);
 }
 
+/**
+ * @brief Adds a solve taking niter iterations to the calling thread's iteration histogram.
+ */
+void Radiation::recordIterations(int niter) const {
+	int bin = 0;
+	while (bin < N_ITERATION_BINS - 1 && (1 << bin) < niter)
+		++bin;
+	++m_iterationCounts[Parallel::threadID()][bin];
+}
+
+/**
+ * @brief Number of HII fraction updates this processor has made in closed form in the shadow of the Star (see
+ * shadowedHIIfrac) since the last call.
+ */
+long Radiation::takeShadowedCount() const {
+	long count = 0;
+	for (long& threadCount : m_shadowedCounts) {
+		count += threadCount;
+		threadCount = 0;
+	}
+	return count;
+}
+
+/**
+ * @brief Sums the iteration histograms of every thread and processor and logs them from the root processor.
+ */
+void Radiation::printIterationStats() const {
+	std::stringstream out;
+	out << "Radiation::integrate: HII solver iterations:";
+	for (int bin = 0; bin < N_ITERATION_BINS; ++bin) {
+		double count = 0;
+		for (const IterationHistogram& counts : m_iterationCounts)
+			count += counts[bin];
+		count = MPIW::Instance().sum(count);
+		if (count == 0)
+			continue;
+		if (bin == 0)
+			out << " 1:";
+		else if (bin == N_ITERATION_BINS - 1)
+			out << " >" << (1 << (bin - 1)) << ':';
+		else if (bin == 1)
+			out << " 2:";
+		else
+			out << ' ' << (1 << (bin - 1)) + 1 << '-' << (1 << bin) << ':';
+		out << (long)count;
+	}
+	out << '\n';
+	if (MPIW::Instance().getRank() == 0)
+		Logger::Instance().print<SeverityType::NOTICE>(out.str());
+}
+
 std::string Radiation::printInfo() const {
 	std::stringstream out;
 
@@ -697,6 +1998,7 @@ std::string Radiation::printInfo() const {
 	out << "THI = " << THI << "\n";
 	out << "THII = " << THII << "\n";
 	out << "scheme = " << (int)scheme << "\n";
+	out << "hiiSolver = " << (int)hiiSolver << "\n";
 	out << "massFractionH = " << massFractionH << "\n";
 	out << "heatingAmplification = " << heatingAmplification << "\n";
 	out << "collisions_on = " << collisions_on << "\n";
@@ -8,20 +8,29 @@
 #ifndef RADIATION_HPP_
 #define RADIATION_HPP_
 
+#include <array>
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "Torch/Common.hpp"
 #include "Torch/Constants.hpp"
+#include "IO/WarningTally.hpp"
 #include "Integrator.hpp"
 #include "SplineData.hpp"
 
 class GridCell;
 class Fluid;
+class Grid;
+class RayTile;
 class RadiationParameters;
+class RayGeometry;
 class Star;
 class StarParameters;
 class Converter;
+class Thermodynamics;
+enum class CellRange : unsigned int;
 
 /**
  * @class Radiation
@@ -39,12 +48,21 @@ public:
 
 	void initialise(std::shared_ptr<Constants> c, RadiationParameters rp);
 	void initField(Fluid& fluid) const;
+	void fuseColumnDensities(const Thermodynamics* thermodynamics);
+	bool fusesColumnDensities(const Thermodynamics& thermodynamics) const;
 
 	virtual void preTimeStepCalculations(Fluid& fluid) const;
 	virtual double calculateTimeStep(double dt_max, Fluid& fluid) const;
 	virtual void integrate(double dt, Fluid& fluid) const;
 	virtual void updateSourceTerms(double dt, Fluid& fluid) const;
 
+	// Tile at a time steps, which let the cooling of the traced tiles overlap with the sweep (see Torch::radiationCoolingSubSteps).
+	void integrate(double dt, Fluid& fluid, const std::function<void(const RayTile&)>& finishTile) const;
+	void updateSourceTerms(double dt, Fluid& fluid, const RayTile& tile) const;
+	int solveEquilibrium(double dt, Fluid& fluid, int maxIterations, double tolerance) const;
+	long takeShadowedCount() const;
+	void traceAveragedColumns(Fluid& fluid) const;
+
 	double K1 = 0;
 	double K2 = 0;
 	double K3 = 0;
@@ -54,46 +72,185 @@ public:
 	double m_alphaB = 0;
 	bool collisions_on = false;
 	Coupling coupling = Coupling::OFF;
+	bool implicitHeating = false; //!< Integrate the NON_EQUILIBRIUM heating with an exponential integrator instead of limiting the time step by it.
 	double heatingAmplification = 0;
 	double massFractionH = 1.0;
 	double minX = 0;
 	double photoIonCrossSection = 0;
 	Scheme scheme = Scheme::IMPLICIT;
+	int decoupledIterations = 0; //!< Maximum number of iterations of the decoupled implicit scheme (0 for the coupled scheme).
+	double decoupledTolerance = 0; //!< Change in HII fraction below which the decoupled iterations stop early.
+	double neutralTolerance = 0; //!< HII fraction, and product of the time step and total rate, below which a cell takes a single update instead of the implicit solve (0 never does).
+	double shadowTau = 0; //!< Optical depth from the Star beyond which a cell's photoionisation is dropped and its HII fraction updated in closed form (0 never is).
+	double ionisedTolerance = 0; //!< Neutral fraction, and change in it over the time step relative to itself, below which a cell takes a single update instead of the implicit solve (0 never does).
+	int ionisedSkips = 0; //!< Updates a cell found at ionisation equilibrium (see ionisedTolerance) keeps its HII fraction for before it is checked again.
+	int coarseFactor = 1; //!< Cells along each side of a cell of the coarse copy of the Grid the far cells are traced on (1 for none, see traceCoarse).
+	double coarseRadius = 0; //!< Distance from the Star (cell widths) beyond which the cells take their optical depths from the coarse copy.
+	int photonGroups = 0; //!< Number of frequency bins of the Star's spectrum (0 for grey, see initPhotonGroups).
+	HIISolver hiiSolver = HIISolver::FIXED_POINT;
+	bool iterationStats = false; //!< Log a histogram of the implicit HII fraction solver iteration counts every step.
 	double tau0 = 0;
+	mutable bool isFirstTimeStep = true; //!< Whether calculateTimeStep has yet to estimate the recombination time of a cell (cleared when restarting).
 
 	std::string printInfo() const;
 private:
+	friend class KernelBenchmarks; //!< Times doric and doricBatch (see bench.cpp).
+
+	static const int MAX_PHOTON_GROUPS = 16;
+	static const int SLOW_ITERATIONS = 10000; //!< Iterations of an HII fraction solve beyond which its cell is warned about.
+	static const int N_ITERATION_BINS = 16; //!< Bin b > 0 counts solves taking (2^(b-1), 2^b] iterations, the last bin any more.
+	using IterationHistogram = std::array<long, N_ITERATION_BINS>;
+
 	std::shared_ptr<Constants> m_consts = nullptr;
+	const Thermodynamics* m_thermodynamics = nullptr; //!< Thermodynamics whose column densities are traced in the same sweep (see fuseColumnDensities).
+	mutable std::vector<IterationHistogram> m_iterationCounts; //!< Per thread histograms of the solver iteration counts this step.
+	mutable std::vector<long> m_shadowedCounts; //!< Per thread counts of the shadowed updates since the last takeShadowedCount.
+	mutable WarningTally m_slowIterations{"Radiation::update_HIIfrac: slow iteration", "niter"}; //!< Cells whose HII fraction solve took over SLOW_ITERATIONS iterations this step.
 	std::unique_ptr<LinearSplineData> m_recombinationHII_CoolingRates = nullptr; //!< Hummer (1994) hydrogen recombination cooling rates.
 	std::unique_ptr<LinearSplineData> m_recombinationHII_RecombRates = nullptr; //!< Hummer (1994) hydrogen recombination rates.
+	std::unique_ptr<UniformLogTable> m_recombinationCoolingTable = nullptr; //!< m_recombinationHII_CoolingRates resampled for O(1) lookups.
+	std::unique_ptr<UniformLogTable> m_recombinationRateTable = nullptr; //!< m_recombinationHII_RecombRates resampled for O(1) lookups.
+	mutable std::vector<double> m_sourceRates; //!< Summed photoionisation rate of the Fluid's RaySources in each cell (see traceSources).
+	mutable std::vector<double> m_sourceRatesAvg; //!< m_sourceRates at the time averaged HII fractions.
+	mutable std::vector<double> m_sourceColumns; //!< Optical depth from the RaySource being traced through the far side of each cell.
+	mutable std::vector<double> m_sourceColumnsAvg; //!< m_sourceColumns at the time averaged HII fractions.
+
+	/**
+	 * @brief The frequency bins of the Star's ionising spectrum (see initPhotonGroups), one entry per bin.
+	 */
+	struct PhotonGroups {
+		std::vector<double> fraction; //!< Share of the ionising photons.
+		std::vector<double> crossSection; //!< Mean photoionisation cross-section over photoIonCrossSection, the ratio of its optical depths to the grey ones.
+		std::vector<double> excessEnergy; //!< Mean energy above the ionisation threshold (code units).
+	};
+	PhotonGroups m_groups;
+
+	/**
+	 * @brief Sums over the PhotonGroups of a cell (see sumPhotonGroups), each term weighted by the bin's photon share.
+	 */
+	struct GroupSums {
+		double absorbed; //!< Share of the photons reaching the cell that it absorbs, exp(-tau)(1 - exp(-dtau)) when grey.
+		double dAbsorbed; //!< Derivative of absorbed by the cell's grey optical depth.
+		double heating; //!< absorbed weighted by the excess energy of each bin.
+	};
+
+	/**
+	 * @brief The parts of a cell's photoionisation rate that stay fixed while its HII fraction is solved for (see
+	 * photoRate), so that each iteration only evaluates the absorption through the cell.
+	 */
+	struct PhotoRate {
+		double tau; //!< Optical depth to the cell.
+		double flux; //!< photonRate/shellVol, times exp(-tau) when grey: the photons reaching the cell per unit time and volume (0 if shellVol is).
+		double crossSectionDs; //!< photoIonCrossSection*ds, the optical depth through the cell per neutral hydrogen number density.
+	};
+
+	/**
+	 * @brief Temperature and rate coefficients of a non-wind cell, at the state preTimeStepCalculations found it in.
+	 */
+	struct CellRates {
+		double T; //!< Gas temperature.
+		double alphaB; //!< Recombination rate coefficient.
+		double A_ci; //!< Collisional ionisation rate coefficient.
+		double A_pi; //!< Photoionisation rate of the Star and the extra sources.
+		double dHeatdT; //!< Derivative of the net heating rate (GridCell::R[RID::HEAT]) by the temperature, if implicitHeating.
+	};
+	mutable std::vector<CellRates> m_cellRates; //!< CellRates of each non-wind cell, indexed by cell ID.
+	mutable bool m_cellRatesCurrent = false; //!< Whether m_cellRates still holds the state of the cells (cleared by integrate).
+	mutable std::vector<int> m_equilibriumSkips; //!< Updates each cell has left to keep its HII fraction at equilibrium for, indexed by cell ID (see ionisedSkips).
+
+	/**
+	 * @brief The neighbours and column densities of the Star's ray trace, stored in the order the cells are traced (see
+	 * gatherColumns).
+	 *
+	 * The non-wind cells of the RayTiles take the first slots, tile after tile in the order they are traced, so the
+	 * cells of a tile and the neighbours they read sit together in memory. Every other cell follows, then a last slot
+	 * whose columns are always zero, which stands in for the neighbours outside the Grid so that the traces need not
+	 * check for them.
+	 */
+	struct CausalColumns {
+		std::vector<int> slots; //!< Slot of every cell, indexed by cell ID.
+		std::vector<int> tileStarts; //!< First slot of each RayTile's non-wind cells, and one past the last.
+		std::vector<std::array<int, 4>> neighbours; //!< Slots of the neighbours of each traced cell (the last slot for none), see RayGeometry::neighbourIDs.
+		std::vector<std::array<double, 2>> columns; //!< TAU + DTAU and TAU_A + DTAU_A of each slot, the optical depths through its far side.
+	};
+	mutable CausalColumns m_columns;
+
+	/**
+	 * @brief The coarse copy of the Fluid the cells far from the Star are ray traced on (see traceCoarse), and the links
+	 * between its cells and the Fluid's.
+	 */
+	struct CoarseTrace {
+		std::shared_ptr<Fluid> fluid; //!< The coarse copy, built on the first trace.
+		int gridBuilds = -1; //!< Fluid::getGridBuilds of the fine Fluid when the copy was built.
+		int starPlacements = -1; //!< Fluid::getStarPlacements of the fine Fluid when the copy's Star was placed.
+		std::vector<int> fineIDs; //!< The fine cells of each core coarse cell, coarseFactor^nd of them in a row, in the order of the coarse cell IDs.
+		std::vector<int> coarseIDs; //!< The coarse cell of each far fine cell (-1 for the rest), indexed by cell ID.
+		std::vector<int> farIDs; //!< The non-wind core cells further than coarseRadius from the Star.
+	};
+	mutable CoarseTrace m_coarse;
 
 	// Initialisation methods.
 	int getRayPlane(Vec3& xc, Vec3& xs) const;
-	double cellPathLength(Vec3& xc, Vec3& sc, Vec3& dx) const;
+	double cellPathLength(const Vec3& xc, const Vec3& sc, const Vec3& dx) const;
 	double shellVolume(double ds, double r_sqrd) const;
 	void initRecombinationHummer(const Converter& converter);
+	void initRateTables(int size, bool check);
+	void initPhotonGroups(int ngroups, double temperature);
 
 
 	// Calculation methods.
 	void doric(const double dt, double& HII_avg, double& HII, double Api, double nHII_aB, double nHII_Aci) const;
+	void doricBatch(int n, double dt, const double* Api, const double* nHII_aB, const double* nHII_Aci, double* HII_avg, double* HII) const;
+	bool shadowedHIIfrac(double dt, double n_H, double alphaB, double A_ci, double& HII_avg, double& HII) const;
+	double doricDerivative(double dt, double HII_avg, double HII, double Api, double dApi, double nH_aB, double nH_Aci) const;
+	int solveHIIavgNewton(double dt, double n_H, double alphaB, double A_ci, const PhotoRate& photo, double A_src,
+			double& HII_avg, double& HII, double& A_pi) const;
 	double recombinationRateCoefficient(double T) const;
 	double recombinationCoolingRate(double nH, double HIIFRAC, double T) const;
 	double collisionalIonisationRate(double T) const;
 	double photoionisationRate(double nHI, double T, double delT, double shellVol, double photonRate) const;
+	PhotoRate photoRate(double tau, const RayGeometry& ray, double photonRate) const;
+	double photoionisationRate(const PhotoRate& photo, double nHI) const;
+	double photoionisationRateDerivative(const PhotoRate& photo, double HII, double nH) const;
+	GroupSums sumPhotonGroups(double T, double delT) const;
+	double meanExcessEnergy(const GridCell& cell, const Star& star) const;
 	double HIIfracRate(double A_pi, double A_ci, double A_rr, double nH, double frac) const;
 	double calc_dtau(double nHI, double ds) const;
+	CellRates cellRates(const GridCell& cell, double T, Fluid& fluid) const;
+	double netHeatingRate(const GridCell& cell, double n_H, double A_pi, double excessEnergy, double T) const;
 
 	// Update methods.
-	void updateTauSC(bool average, GridCell& cell, Fluid& fluid, double dist2) const;
+	template <class Column>
+	double interpolateTau(const std::array<int, 4>& neighbours, const std::array<double, 4>& weights, Column column) const;
+	template <class Column>
+	double interpolateTau(const RayGeometry& ray, const std::array<double, 4>& weights, const Grid& grid, Column column) const;
+	void gatherColumns(Grid& grid) const;
+	void storeColumns(const GridCell& cell) const;
+	void updateTauSC(bool average, GridCell& cell, const std::array<double, 4>& weights, double dist2) const;
+	void updateTausSC(GridCell& cell, const std::array<double, 4>& weights, double dist2) const;
+	void traceSources(Fluid& fluid) const;
+	void linkCoarseCells(Fluid& fluid) const;
+	void traceCoarse(Fluid& fluid) const;
+	void traceRadial(Fluid& fluid) const;
+	bool isCoarse(int cellID) const;
 	void update_HIIfrac(double dt, GridCell& cell, Fluid& fluid) const;
+	void recombineCells(double dt, Fluid& fluid, CellRange range) const;
 
 	// Integration methods.
-	void transferRadiation(double dt, Fluid& fluid) const;
-	void rayTrace(Fluid& fluid) const;
+	template <class Unpack, class Trace, class Pack, class Finish>
+	void sweepColumnDensities(Fluid& fluid, bool fuse, Unpack unpack, Trace trace, Pack pack, Finish finish) const;
+	template <class Unpack, class Trace, class Pack>
+	void sweepColumnDensities(Fluid& fluid, bool fuse, Unpack unpack, Trace trace, Pack pack) const;
+	void transferRadiation(double dt, Fluid& fluid, const std::function<void(const RayTile&)>& finishTile) const;
+	void transferRadiationDecoupled(double dt, Fluid& fluid) const;
+	void rayTrace(const RayTile& tile, Fluid& fluid) const;
 	void transferRadiation2(double dt, Fluid& fluid) const;
 
 	// Misc. methods.
 	bool isStar(const GridCell& cell, const Star& star) const;
+	void addSourceTerms(double dt, GridCell& cell) const;
+	void recordIterations(int niter) const;
+	void printIterationStats() const;
 };
 
 #endif // RADIATION_HPP_
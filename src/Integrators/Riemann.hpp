@@ -1,5 +1,5 @@
-/** Provides the RiemannSolver base abstract class and HartenLaxLeerSolver, HartenLaxLeerContactSolver and
- * RotatedHartenLaxLeerSolver subclasses.
+/** Provides the RiemannSolver base abstract class and HartenLaxLeerSolver, HartenLaxLeerContactSolver,
+ * RotatedHartenLaxLeerSolver and AdaptiveHartenLaxLeerSolver subclasses.
  *
  * @file Riemann.hpp
  *
@@ -18,15 +18,22 @@
  * @class RiemannSolver
  *
  * @brief A base class for solving the Riemann problem.
+ *
+ * solve() handles a single face. solveBatch() handles n faces stored contiguously, so that a whole pencil of faces costs
+ * one virtual call. The default solveBatch() simply calls solve() for each face.
  */
 class RiemannSolver {
 public:
 	RiemannSolver(int nd);
 	virtual ~RiemannSolver() { };
 	virtual void solve(FluidArray& F, const FluidArray& Q_l, const FluidArray& Q_r, double a_l2, double a_r2, double gamma, int dim) const = 0;
+	virtual void solveBatch(int n, FluidArray* F, const FluidArray* Q_l, const FluidArray* Q_r, const double* a_l2, const double* a_r2, const double* gamma, int dim) const;
 	int getNumberDimensions() const;
+	void setCheckFluxes(bool checkFluxes);
+	bool isCheckingFluxes() const;
 private:
 	int m_ND;
+	bool m_checkFluxes = true; //!< Test every batch of fluxes for NaNs (only needed at CheckLevel::PARANOID).
 };
 
 /**
@@ -38,6 +45,8 @@ class HartenLaxLeerContactSolver : public RiemannSolver {
 public:
 	HartenLaxLeerContactSolver(int nd);
 	virtual void solve(FluidArray& F, const FluidArray& Q_l, const FluidArray& Q_r, double a_l2, double a_r2, double gamma, int dim) const;
+	virtual void solveBatch(int n, FluidArray* F, const FluidArray* Q_l, const FluidArray* Q_r, const double* a_l2, const double* a_r2, const double* gamma, int dim) const;
+	void calcFlux(FluidArray& F, const FluidArray& Q_l, const FluidArray& Q_r, double a_l2, double a_r2, double gamma, int dim) const;
 };
 
 /**
@@ -49,6 +58,8 @@ class HartenLaxLeerSolver : public RiemannSolver {
 public:
 	HartenLaxLeerSolver(int nd);
 	virtual void solve(FluidArray& F, const FluidArray& Q_l, const FluidArray& Q_r, double a_l2, double a_r2, double gamma, int dim) const;
+	virtual void solveBatch(int n, FluidArray* F, const FluidArray* Q_l, const FluidArray* Q_r, const double* a_l2, const double* a_r2, const double* gamma, int dim) const;
+	void calcFlux(FluidArray& F, const FluidArray& Q_l, const FluidArray& Q_r, double a_l2, double a_r2, double gamma, int dim) const;
 };
 
 /**
@@ -60,11 +71,38 @@ class RotatedHartenLaxLeerSolver : public RiemannSolver {
 public:
 	RotatedHartenLaxLeerSolver(int nd);
 	virtual void solve(FluidArray& F, const FluidArray& Q_l, const FluidArray& Q_r, double a_l2, double a_r2, double gamma, int dim) const;
+	virtual void solveBatch(int n, FluidArray* F, const FluidArray* Q_l, const FluidArray* Q_r, const double* a_l2, const double* a_r2, const double* gamma, int dim) const;
+	void calcFlux(FluidArray& F, const FluidArray& Q_l, const FluidArray& Q_r, double a_l2, double a_r2, double gamma, int dim) const;
 private:
 	HartenLaxLeerContactSolver m_hllc;
 	HartenLaxLeerSolver m_hll;
 };
 
+/**
+ * @class AdaptiveHartenLaxLeerSolver
+ *
+ * @brief RiemannSolver subclass that solves the faces at shocks with a RotatedHartenLaxLeerSolver, whose HLL part
+ * damps the carbuncle and odd-even decoupling of grid aligned shocks, and the rest with the cheaper
+ * HartenLaxLeerContactSolver.
+ *
+ * A face is at a shock if the flow is converging across it and either its pressure or its normal velocity jumps by
+ * more than SHOCK_JUMP of the smaller pressure or sound speed either side. solveBatch() solves the whole batch with
+ * the HLLC solver's batch and then solves the faces at shocks again with the rotated solver.
+ */
+class AdaptiveHartenLaxLeerSolver : public RiemannSolver {
+public:
+	static constexpr double SHOCK_JUMP = 0.5; //!< Relative jump across a converging face that marks it as a shock.
+
+	AdaptiveHartenLaxLeerSolver(int nd);
+	virtual void solve(FluidArray& F, const FluidArray& Q_l, const FluidArray& Q_r, double a_l2, double a_r2, double gamma, int dim) const;
+	virtual void solveBatch(int n, FluidArray* F, const FluidArray* Q_l, const FluidArray* Q_r, const double* a_l2, const double* a_r2, const double* gamma, int dim) const;
+	void calcFlux(FluidArray& F, const FluidArray& Q_l, const FluidArray& Q_r, double a_l2, double a_r2, double gamma, int dim) const;
+	static bool isShock(const FluidArray& Q_l, const FluidArray& Q_r, double a_l2, double a_r2, int dim);
+private:
+	HartenLaxLeerContactSolver m_hllc;
+	RotatedHartenLaxLeerSolver m_rotated;
+};
+
 /**
  * @class RiemannSolverFactory
  *
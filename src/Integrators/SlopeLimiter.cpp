@@ -3,6 +3,8 @@
 #include <cmath>
 #include <stdexcept>
 
+#include "Misc/CpuDispatch.hpp"
+
 inline double minmod(double a, double b) {
 	if (a*b > 0)
 		return std::abs(a) < std::abs(b) ? a : b;
@@ -17,23 +19,15 @@ inline double maxmod(double a, double b) {
 		return 0;
 }
 
-double MinmodLimiter::calculate(double a, double b) const {
-	return minmod(a, b);
-}
-
-double MaxmodLimiter::calculate(double a, double b) const {
-	return maxmod(a, b);
-}
-
-double MonotonisedCentralLimiter::calculate(double a, double b) const {
+inline double monotonisedCentral(double a, double b) {
 	return minmod((a+b)/2.0, minmod(2.0*a, 2.0*b));
 }
 
-double SuperbeeLimiter::calculate(double a, double b) const {
+inline double superbee(double a, double b) {
 	return maxmod(minmod(b, 2.0*a), minmod(2.0*b, a));
 }
 
-double LeerLimiter::calculate(double a, double b) const {
+inline double leer(double a, double b) {
 	if (b == 0)
 		return 0;
 	else {
@@ -42,17 +36,86 @@ double LeerLimiter::calculate(double a, double b) const {
 	}
 }
 
-double OspreLimiter::calculate(double a, double b) const {
+inline double ospre(double a, double b) {
 	if (a*b <= 1.0e-30)
 		return 0;
 	else
 		return 1.5*b*(a*a + a*b)/(a*a + a*b + b*b);
 }
 
-double AlbadaLimiter::calculate(double a, double b) const {
+inline double albada(double a, double b) {
 	return a*b <= 1.0e-30 ? 0 : a*b*(a + b) / (a*a + b*b);
 }
 
+/**
+ * @brief Applies the limiter function f to n pairs of differences.
+ *
+ * f is a template parameter so that it is inlined into the loop body, which is compiled for each instruction set of
+ * TORCH_KERNEL_CLONES.
+ */
+template <double (*f)(double, double)>
+TORCH_KERNEL_CLONES
+void limitArray(const double* dl, const double* dr, double* slope, std::size_t n) {
+	for (std::size_t i = 0; i < n; ++i)
+		slope[i] = f(dl[i], dr[i]);
+}
+
+double MinmodLimiter::calculate(double a, double b) const {
+	return minmod(a, b);
+}
+
+void MinmodLimiter::limit(const double* dl, const double* dr, double* slope, std::size_t n) const {
+	limitArray<minmod>(dl, dr, slope, n);
+}
+
+double MaxmodLimiter::calculate(double a, double b) const {
+	return maxmod(a, b);
+}
+
+void MaxmodLimiter::limit(const double* dl, const double* dr, double* slope, std::size_t n) const {
+	limitArray<maxmod>(dl, dr, slope, n);
+}
+
+double MonotonisedCentralLimiter::calculate(double a, double b) const {
+	return monotonisedCentral(a, b);
+}
+
+void MonotonisedCentralLimiter::limit(const double* dl, const double* dr, double* slope, std::size_t n) const {
+	limitArray<monotonisedCentral>(dl, dr, slope, n);
+}
+
+double SuperbeeLimiter::calculate(double a, double b) const {
+	return superbee(a, b);
+}
+
+void SuperbeeLimiter::limit(const double* dl, const double* dr, double* slope, std::size_t n) const {
+	limitArray<superbee>(dl, dr, slope, n);
+}
+
+double LeerLimiter::calculate(double a, double b) const {
+	return leer(a, b);
+}
+
+void LeerLimiter::limit(const double* dl, const double* dr, double* slope, std::size_t n) const {
+	limitArray<leer>(dl, dr, slope, n);
+}
+
+double OspreLimiter::calculate(double a, double b) const {
+	return ospre(a, b);
+}
+
+void OspreLimiter::limit(const double* dl, const double* dr, double* slope, std::size_t n) const {
+	limitArray<ospre>(dl, dr, slope, n);
+}
+
+double AlbadaLimiter::calculate(double a, double b) const {
+	return albada(a, b);
+}
+
+void AlbadaLimiter::limit(const double* dl, const double* dr, double* slope, std::size_t n) const {
+	limitArray<albada>(dl, dr, slope, n);
+}
+
 std::unique_ptr<SlopeLimiter> SlopeLimiterFactory::create(std::string type) {
 	if (type.compare("monotonised_central") == 0)
 		return std::unique_ptr<SlopeLimiter>(new MonotonisedCentralLimiter());
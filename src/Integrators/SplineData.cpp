@@ -1,5 +1,6 @@
 #include "SplineData.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <stdexcept>
 #include <iostream>
@@ -149,3 +150,70 @@ double LogSplineData::interpolate(double x) const {
 		rate = splint(m_x, m_y, m_y2, x);
 	return rate;
 }
+
+/**
+ * @brief Samples f at n points equally spaced in log10(x) from xmin to xmax inclusive.
+ * @param f The exact function, also used for arguments outside [xmin, xmax).
+ * @param xmin Smallest tabulated argument.
+ * @param xmax Largest tabulated argument.
+ * @param n Number of tabulated points.
+ * @param interp Interpolation between the points.
+ */
+UniformLogTable::UniformLogTable(std::function<double(double)> f, double xmin, double xmax, int n, Interpolation interp)
+: m_exact(std::move(f))
+, m_interp(interp)
+, m_n(n)
+{
+	if (n < 2 || !(xmin > 0) || !(xmax > xmin))
+		throw std::runtime_error("UniformLogTable::Constructor: need at least 2 points and 0 < xmin < xmax.");
+	m_logMin = std::log10(xmin);
+	m_step = (std::log10(xmax) - m_logMin)/(n - 1);
+	m_invStep = 1.0/m_step;
+	m_y.resize(n + 2);
+	for (int k = 1; k < n + 1; ++k)
+		m_y[k] = m_exact(std::pow(10.0, m_logMin + (k - 1)*m_step));
+	// The end points are extrapolated rather than sampled so that any kink in f just outside the table is not smeared into it.
+	if (n > 2) {
+		m_y[0] = 3.0*(m_y[1] - m_y[2]) + m_y[3];
+		m_y[n + 1] = 3.0*(m_y[n] - m_y[n - 1]) + m_y[n - 2];
+	}
+	else {
+		m_y[0] = 2.0*m_y[1] - m_y[2];
+		m_y[n + 1] = 2.0*m_y[n] - m_y[n - 1];
+	}
+}
+
+/**
+ * @brief Interpolates the function at x[i] into y[i] for every i in [0, n).
+ */
+void UniformLogTable::interpolate(const double* x, double* y, int n) const {
+	for (int i = 0; i < n; ++i)
+		y[i] = interpolate(x[i]);
+}
+
+/**
+ * @brief Evaluates the exact function the table was sampled from.
+ */
+double UniformLogTable::exact(double x) const {
+	return m_exact(x);
+}
+
+/**
+ * @brief Cross-checks the table against the exact function.
+ * @param samplesPerInterval Number of points compared in each table interval.
+ * @return Largest relative difference between the interpolated and exact values.
+ */
+double UniformLogTable::maxRelativeError(int samplesPerInterval) const {
+	double maxError = 0;
+	for (int i = 0; i < m_n - 1; ++i) {
+		for (int s = 0; s < samplesPerInterval; ++s) {
+			double x = std::pow(10.0, m_logMin + (i + (s + 0.5)/samplesPerInterval)*m_step);
+			double exactValue = m_exact(x);
+			double error = std::abs(interpolate(x) - exactValue);
+			if (exactValue != 0)
+				error /= std::abs(exactValue);
+			maxError = std::max(maxError, error);
+		}
+	}
+	return maxError;
+}
@@ -1,4 +1,4 @@
-/** Provides the SplineData class.
+/** Provides the SplineData and UniformLogTable classes.
  *
  * @file SplineData.hpp
  *
@@ -8,6 +8,8 @@
 #ifndef SPLINEDATA_HPP_
 #define SPLINEDATA_HPP_
 
+#include <cmath>
+#include <functional>
 #include <utility>
 #include <vector>
 
@@ -23,6 +25,8 @@ public:
 	virtual ~SplineData() {};
 
 	virtual double interpolate(double x) const = 0;
+	double getMinX() const { return m_x.front(); } //!< Smallest tabulated argument; the data is extrapolated below it.
+	double getMaxX() const { return m_x.back(); } //!< Largest tabulated argument; the data is extrapolated above it.
 	static std::vector<double> spline(const std::vector<double>& x, const std::vector<double>& f, double yp1, double ypn);
 	static double splint(const std::vector<double>& x, const std::vector<double>& f, const std::vector<double>& f2, double x2);
 protected:
@@ -49,6 +53,66 @@ public:
 	virtual double interpolate(double x) const;
 };
 
+/**
+ * @class UniformLogTable
+ *
+ * @brief Samples a function once onto points equally spaced in log10(x), so that it is interpolated with an O(1) index
+ * lookup instead of the bisection in SplineData::splint.
+ *
+ * Interpolation is linear or cubic (Catmull-Rom) in log10(x). Arguments outside the table, and NaNs, are passed on to
+ * the exact function, so the extrapolation of the function it was built from is kept. The function must be smooth over
+ * [xmin, xmax] (e.g. a SplineData between its first and last points) for the cubic interpolation to be accurate.
+ */
+class UniformLogTable {
+public:
+	enum class Interpolation : unsigned int {LINEAR, CUBIC};
+
+	UniformLogTable(std::function<double(double)> f, double xmin, double xmax, int n, Interpolation interp = Interpolation::CUBIC);
+
+	double interpolate(double x) const;
+	double interpolateLog(double logx) const;
+	void interpolate(const double* x, double* y, int n) const;
+	double exact(double x) const;
+	double maxRelativeError(int samplesPerInterval = 16) const;
+private:
+	std::function<double(double)> m_exact;
+	Interpolation m_interp;
+	int m_n = 0;
+	double m_logMin = 0;
+	double m_step = 0;
+	double m_invStep = 0;
+	std::vector<double> m_y; //!< m_y[k] = f(10^(logMin + (k-1)*step)) for k in [0, n + 1], extrapolated one point beyond each end for the cubic stencil.
+
+	double evaluate(double u) const;
+	bool inTable(double u) const { return u >= 0.0 && u < m_n - 1; }
+};
 
+/**
+ * @brief Interpolates the table at a position u (in table intervals) that is known to be inside it.
+ */
+inline double UniformLogTable::evaluate(double u) const {
+	int i = static_cast<int>(u);
+	double w = u - i;
+	const double* y = &m_y[i + 1];
+	if (m_interp == Interpolation::LINEAR)
+		return y[0] + w*(y[1] - y[0]);
+	return y[0] + 0.5*w*((y[1] - y[-1]) + w*((2.0*y[-1] - 5.0*y[0] + 4.0*y[1] - y[2]) + w*(3.0*(y[0] - y[1]) + y[2] - y[-1])));
+}
+
+/**
+ * @brief Interpolates the function at x.
+ */
+inline double UniformLogTable::interpolate(double x) const {
+	double u = (std::log10(x) - m_logMin)*m_invStep;
+	return inTable(u) ? evaluate(u) : m_exact(x);
+}
+
+/**
+ * @brief Interpolates the function at 10^logx, for callers that already have the logarithm of the argument.
+ */
+inline double UniformLogTable::interpolateLog(double logx) const {
+	double u = (logx - m_logMin)*m_invStep;
+	return inTable(u) ? evaluate(u) : m_exact(std::pow(10.0, logx));
+}
 
 #endif // SPLINEDATA_HPP_
@@ -2,8 +2,12 @@
 
 #include <bits/forward_list.h>
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <complex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <utility>
 #include <iostream>
 
@@ -11,7 +15,11 @@
 #include "Fluid/Grid.hpp"
 #include "Fluid/GridCell.hpp"
 #include "Fluid/Star.hpp"
+#include "IO/Logger.hpp"
 #include "MPI/MPI_Wrapper.hpp"
+#include "Misc/CpuDispatch.hpp"
+#include "Misc/Parallel.hpp"
+#include "Misc/Profiler.hpp"
 #include "Torch/Common.hpp"
 #include "Torch/Constants.hpp"
 #include "Torch/Converter.hpp"
@@ -25,10 +33,17 @@ void Thermodynamics::initialise(std::shared_ptr<Constants> c, ThermoParameters t
 	m_consts = std::move(c);
 
 	m_isSubcycling = tp.thermoSubcycling;
+	m_stiffSubsteps = tp.stiffSubsteps;
+	m_substepStats = tp.substepStats;
+	if (m_stiffSubsteps < 0)
+		throw std::runtime_error("Thermodynamics::initialise: stiff_substeps(=" + std::to_string(m_stiffSubsteps) + ") must not be negative.");
 	m_thermoHII_Switch = tp.thermoHII_Switch;
 	m_heatingAmplification = tp.heatingAmplification;
 	m_massFractionH = tp.massFractionH;
 	m_minTempInitialState = tp.minTempInitialState;
+	if (tp.columnDensityTolerance < 0)
+		throw std::runtime_error("Thermodynamics::initialise: column_density_tolerance(=" + std::to_string(tp.columnDensityTolerance) + ") must not be negative.");
+	m_columnDensityTolerance = tp.columnDensityTolerance;
 
 	m_z0 = 5.0e-4;
 	m_excessEnergy = m_consts->converter.toCodeUnits(m_consts->converter.EV_2_ERGS(5), 1, 2, -2);
@@ -54,6 +69,9 @@ void Thermodynamics::initialise(std::shared_ptr<Constants> c, ThermoParameters t
 
 	initCollisionalExcitationHI(m_consts->converter);
 	initRecombinationHII(m_consts->converter);
+	initRateTables(tp.rateTableSize, tp.rateTableCheck);
+	initCoolingTable(tp.coolingTableSize);
+	m_chemistry.initialise(m_consts->converter, m_massFractionH, m_consts->hydrogenMass, tp.chemistrySteps);
 }
 
 void Thermodynamics::initCollisionalExcitationHI(const Converter& converter) {
@@ -99,13 +117,92 @@ void Thermodynamics::initRecombinationHII(const Converter& converter) {
 	m_recombinationHII_CoolingRates = std::unique_ptr<LinearSplineData>(new LinearSplineData(dataPairs));
 }
 
+/**
+ * @brief Resamples the cooling rate splines onto uniform log(T) tables over their data ranges (if size > 0).
+ * @param size Number of points in each table.
+ * @param check Log the largest difference between each table and its spline.
+ */
+void Thermodynamics::initRateTables(int size, bool check) {
+	if (size <= 0)
+		return;
+	const LogSplineData* cxhi = m_collisionalExcitationHI_CoolingRates.get();
+	const LinearSplineData* recomb = m_recombinationHII_CoolingRates.get();
+	m_collisionalExcitationHI_Table = std::unique_ptr<UniformLogTable>(new UniformLogTable(
+			[cxhi](double T) { return cxhi->interpolate(std::log10(T)); },
+			std::pow(10.0, cxhi->getMinX()), std::pow(10.0, cxhi->getMaxX()), size));
+	m_recombinationHII_Table = std::unique_ptr<UniformLogTable>(new UniformLogTable(
+			[recomb](double T) { return recomb->interpolate(T); }, recomb->getMinX(), recomb->getMaxX(), size));
+	if (check && MPIW::Instance().getRank() == 0) {
+		Logger::Instance().print<SeverityType::NOTICE>("Thermodynamics::initRateTables: max. relative error: collisional excitation = ",
+				m_collisionalExcitationHI_Table->maxRelativeError(), ", recombination cooling = ", m_recombinationHII_Table->maxRelativeError(), '\n');
+	}
+}
+
+/**
+ * @brief Tabulates the terms of the cooling rate (see Thermodynamics::coolingRate) that only depend on T against log10(T)
+ * (if size > 0), and logs how well the tables reproduce the rate.
+ *
+ * The ionised metal line and collisional ionisation equilibrium cooling are ne^2 times a function of T, and the neutral
+ * metal line cooling and collisional excitation of HI are ne*nn times one, so the tables hold the two functions and the
+ * density and HII fraction are taken exactly. The neutral and molecular line cooling depends on nH through its excitation
+ * temperature and costs no more to calculate than a lookup would, so it is left exact. The tables span 10 K to 10^9 K
+ * and temperatures outside them are calculated exactly.
+ *
+ * The errors are measured half way between the points over a grid of densities from 10^-4 to 10^8 cm^-3 and HII
+ * fractions, relative to the cooling rate plus the cosmic ray heating, the smallest heating of a cell: a rate that is
+ * lost in the heating is of no consequence however badly it is tabulated.
+ * @param size Points along log10(T).
+ */
+void Thermodynamics::initCoolingTable(int size) {
+	m_ionisedCoolingTable.reset();
+	m_mixedCoolingTable.reset();
+	if (size <= 0)
+		return;
+	if (size < 2)
+		throw std::runtime_error("Thermodynamics::initCoolingTable: the cooling table needs at least 2 points.");
+	std::unique_ptr<UniformLogTable> ionised(new UniformLogTable([this](double T) {
+		return ionisedMetalLineCooling(1.0, T) + collisionalIonisationEquilibriumCooling(1.0, T);
+	}, 1.0e1, 1.0e9, size));
+	std::unique_ptr<UniformLogTable> mixed(new UniformLogTable([this](double T) {
+		return neutralMetalLineCooling(1.0, 1.0, T) + 4.0*collisionalExcitationHI(1.0, 0.5, T);
+	}, 1.0e1, 1.0e9, size));
+
+	if (MPIW::Instance().getRank() == 0) {
+		const Converter& converter = m_consts->converter;
+		const std::array<double, 9> fractions = {{ 0, 1.0e-4, 1.0e-2, 0.1, 0.5, 0.9, 0.99, 0.9999, 1 }};
+		const double log10_nHmin = std::log10(converter.toCodeUnits(1.0e-4, 0, -3, 0));
+		double maxError = 0, sumError = 0;
+		long samples = 0;
+		for (int j = 0; j <= 48; ++j) {
+			const double nH = std::pow(10.0, log10_nHmin + 0.25*j);
+			for (int i = 0; i < size - 1; ++i) {
+				const double log10_T = 1.0 + 8.0*(i + 0.5)/(size - 1), T = std::pow(10.0, log10_T);
+				const double ionisedTerm = ionised->interpolateLog(log10_T), mixedTerm = mixed->interpolateLog(log10_T);
+				for (double HIIFRAC : fractions) {
+					const double exact = coolingRate(nH, HIIFRAC, T);
+					const double tabulated = nH*nH*(HIIFRAC*HIIFRAC*ionisedTerm + HIIFRAC*(1.0 - HIIFRAC)*mixedTerm)
+							+ neutralMolecularLineCooling(nH, HIIFRAC, T);
+					const double error = std::abs(tabulated - exact)/(exact + cosmicRayHeating(nH));
+					maxError = std::max(maxError, error);
+					sumError += error;
+					++samples;
+				}
+			}
+		}
+		Logger::Instance().print<SeverityType::NOTICE>("Thermodynamics::initCoolingTable: ", size,
+				" point cooling tables, max. relative error = ", maxError, ", mean = ", sumError/samples, '\n');
+	}
+	m_ionisedCoolingTable = std::move(ionised);
+	m_mixedCoolingTable = std::move(mixed);
+}
+
 void Thermodynamics::initialiseMinTempField(Fluid& fluid) const {
 	if (m_minTempInitialState) {
-		for (GridCell& cell : fluid.getGrid().getIterable("GridCells"))
+		for (GridCell& cell : fluid.getGrid().getIterable(CellRange::GRID_CELLS))
 			cell.T_min = fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]);
 	}
 	else {
-		for (GridCell& cell : fluid.getGrid().getIterable("GridCells"))
+		for (GridCell& cell : fluid.getGrid().getIterable(CellRange::GRID_CELLS))
 			cell.T_min = m_T_min;
 	}
 }
@@ -154,7 +251,7 @@ double Thermodynamics::neutralMolecularLineCooling(const double nH, const double
  * @return Collisional excitation cooling rate of HI.
  */
 double Thermodynamics::collisionalExcitationHI(const double nH, const double HIIFRAC, const double T) const {
-	double rate = m_collisionalExcitationHI_CoolingRates->interpolate(std::log10(T));
+	double rate = m_collisionalExcitationHI_Table ? m_collisionalExcitationHI_Table->interpolate(T) : m_collisionalExcitationHI_CoolingRates->interpolate(std::log10(T));
 
 	return HIIFRAC*(1.0-HIIFRAC)*nH*nH*std::exp((2.302585093*rate)-((T/m_cxhi_damp)*(T/m_cxhi_damp)));
 	//return HIIFRAC*(1.0-HIIFRAC)*nH*nH*rate*std::exp(-(T/m_cxhi_damp)*(T/m_cxhi_damp));
@@ -169,11 +266,92 @@ double Thermodynamics::collisionalExcitationHI(const double nH, const double HII
  * @return Recombination cooling rate of HII.
  */
 double Thermodynamics::recombinationHII(const double nH, const double HIIFRAC, const double T) const {
-	double rate = m_recombinationHII_CoolingRates->interpolate(T);
+	double rate = m_recombinationHII_Table ? m_recombinationHII_Table->interpolate(T) : m_recombinationHII_CoolingRates->interpolate(T);
 
 	return HIIFRAC*HIIFRAC*nH*nH*m_consts->boltzmannConst*T*rate;
 }
 
+/**
+ * @brief Calculates the factors of the cooling terms that only depend on the density and HII fraction of a cell.
+ * @param nH Hydrogen number density.
+ * @param HIIFRAC Fraction of hydrogen gas that is ionised.
+ * @return The factors multiplying the temperature dependence of each term in Thermodynamics::coolingRate.
+ */
+Thermodynamics::CoolingCoefficients Thermodynamics::coolingCoefficients(const double nH, const double HIIFRAC) const {
+	double ne = nH*HIIFRAC;
+	double nn = nH*(1.0-HIIFRAC);
+	CoolingCoefficients coeffs;
+	coeffs.imlc = m_imlc*m_z0*ne*ne;
+	coeffs.nmlc = m_nmlc*m_z0*ne*nn;
+	coeffs.cxhi = HIIFRAC*(1.0-HIIFRAC)*nH*nH;
+	coeffs.ciec = m_ciec*ne*ne*m_z0;
+	coeffs.nmc = m_nmc*(1.0-HIIFRAC)*(1.0-HIIFRAC)*std::pow(nH, 1.6);
+	coeffs.T0 = 70.0 + 220.0*std::pow(nH/m_n0, 0.2);
+	coeffs.ne2 = ne*ne;
+	return coeffs;
+}
+
+/**
+ * @brief Calculates the total cooling rate from ionised and neutral metal lines, collisional excitation of HI, collisional
+ * ionisation equilibrium and neutral/molecular lines in one pass.
+ *
+ * Equal to the sum of Thermodynamics::ionisedMetalLineCooling, neutralMetalLineCooling, collisionalExcitationHI,
+ * collisionalIonisationEquilibriumCooling and neutralMolecularLineCooling, but 1/T and log(T) are only calculated once and
+ * the powers of T are taken from log(T). With cooling tables (Thermodynamics::initCoolingTable) the terms that only depend
+ * on T are interpolated instead.
+ * @param coeffs The cell's CoolingCoefficients.
+ * @param T Gas temperature.
+ * @return Cooling rate (positive for cooling).
+ */
+double Thermodynamics::coolingRate(const CoolingCoefficients& coeffs, const double T) const {
+	const double inv_T = 1.0/T;
+	const double log_T = std::log(T);
+	const double log10_T = 0.4342944819032518*log_T;
+
+	double rate = 0;
+	if (m_ionisedCoolingTable) {
+		rate = coeffs.ne2*m_ionisedCoolingTable->interpolateLog(log10_T) + coeffs.cxhi*m_mixedCoolingTable->interpolateLog(log10_T);
+		rate += coeffs.nmc*std::sqrt(T)*std::exp(-coeffs.T0*inv_T);
+		return rate;
+	}
+
+	rate = coeffs.imlc*std::exp(-m_T1*inv_T - (m_T2*inv_T)*(m_T2*inv_T));
+	rate += coeffs.nmlc*std::exp(-m_T3*inv_T - (m_T4*inv_T)*(m_T4*inv_T));
+
+	double cxhi = m_collisionalExcitationHI_Table ? m_collisionalExcitationHI_Table->interpolateLog(log10_T) : m_collisionalExcitationHI_CoolingRates->interpolate(log10_T);
+	rate += coeffs.cxhi*std::exp((2.302585093*cxhi)-((T/m_cxhi_damp)*(T/m_cxhi_damp)));
+
+	if (T > m_ciec_minT) {
+		// (1.0e-5*T)^1.63 = exp(1.63*(log(T) - 5*log(10))).
+		double cie_rate = coeffs.ciec*std::exp(-0.63*log_T)*(1.0-std::exp(-std::exp(1.63*(log_T - 11.512925464970229))));
+		rate += cie_rate*std::min(1.0, (T-5.0e4)/(2.0e4));
+	}
+
+	rate += coeffs.nmc*std::sqrt(T)*std::exp(-coeffs.T0*inv_T);
+	return rate;
+}
+
+/**
+ * @brief Calculates the total cooling rate of gas (see Thermodynamics::coolingRate(const CoolingCoefficients&, double)).
+ * @param nH Hydrogen number density.
+ * @param HIIFRAC Fraction of hydrogen gas that is ionised.
+ * @param T Gas temperature.
+ * @return Cooling rate (positive for cooling).
+ */
+double Thermodynamics::coolingRate(const double nH, const double HIIFRAC, const double T) const {
+	return coolingRate(coolingCoefficients(nH, HIIFRAC), T);
+}
+
+/**
+ * @brief Calculates rates[i] = coolingRate(nH[i], HIIFRAC[i], T[i]) for every i in [0, n), compiled for each instruction
+ * set of TORCH_KERNEL_CLONES.
+ */
+TORCH_KERNEL_CLONES
+void Thermodynamics::coolingRates(const int n, const double* nH, const double* HIIFRAC, const double* T, double* rates) const {
+	for (int i = 0; i < n; ++i)
+		rates[i] = coolingRate(coolingCoefficients(nH[i], HIIFRAC[i]), T[i]);
+}
+
 //FUV heating (Henney et al. 2009, eq. A3)
 double Thermodynamics::farUltraVioletHeating(const double nH, const double Av_FUV, const double F_FUV) const {
 	return m_fuvh_a*nH*F_FUV*std::exp(-1.9*Av_FUV)/(m_fuvh_b +m_fuvh_c*F_FUV*std::exp(-1.9*Av_FUV)/nH);
@@ -216,31 +394,73 @@ double Thermodynamics::softLanding(const double rate, const double T, const doub
  * @param fluid The fluid.
  */
 void Thermodynamics::preTimeStepCalculations(Fluid& fluid) const {
-	if (fluid.getStar().on)
+	if (fluid.getStar().on && !fluid.getGrid().hasColumnDensities && !reuseColumnDensities(fluid))
 		rayTrace(fluid);
+	if (m_thermoHII_Switch > 0)
+		collectActiveCells(fluid, fluid.getGrid().getOrderedIndices(CellOrder::CAUSAL_NON_WIND), m_activeIDs);
+	heatingRates(fluid, activeCells(fluid));
+}
 
+/**
+ * @brief Collects the cells of cellIDs at or above the thermo switch (GridCell::Q[UID::ADV] >= thermoHII_Switch) into
+ * active, so that the cooling sweeps skip the cells switched off, which early on are most of the Grid.
+ *
+ * A cell has its heating rates and diagnostics zeroed once, when it is first found switched off, and is left alone
+ * after that; the sweeps used to zero them every step.
+ */
+void Thermodynamics::collectActiveCells(Fluid& fluid, const std::vector<int>& cellIDs, std::vector<int>& active) const {
 	Grid& grid = fluid.getGrid();
+	// A rebuilt Grid gives its cells new IDs, even if it has as many of them.
+	if (m_isSwitchedOff.size() != grid.getCells().size() || m_switchedOffRebuilds != grid.rebuilds) {
+		m_isSwitchedOff.assign(grid.getCells().size(), false);
+		m_switchedOffRebuilds = grid.rebuilds;
+	}
+	// Sized for every cell at once, so the collections do not grow as the cells switch on.
+	active.reserve(cellIDs.size());
+	active.clear();
+	for (int cellID : cellIDs) {
+		GridCell& cell = grid.getCell(cellID);
+		if (cell.Q[UID::ADV] >= m_thermoHII_Switch) {
+			active.push_back(cellID);
+			m_isSwitchedOff[cellID] = false;
+		}
+		else if (!m_isSwitchedOff[cellID]) {
+			grid.getHeating(cellID).fill(0);
+			cell.T[TID::RATE] = cell.T[TID::HEAT] = 0;
+			m_isSwitchedOff[cellID] = true;
+		}
+	}
+}
+
+/**
+ * @brief The CausalNonWind cells heated and cooled this step, as found by the last preTimeStepCalculations.
+ */
+const std::vector<int>& Thermodynamics::activeCells(Fluid& fluid) const {
+	if (m_thermoHII_Switch > 0)
+		return m_activeIDs;
+	return fluid.getGrid().getOrderedIndices(CellOrder::CAUSAL_NON_WIND);
+}
 
-	for (int cellID : grid.getOrderedIndices("CausalNonWind")) {
+/**
+ * @brief Calculates the heating and cooling rates of some of the non-wind cells, whose column densities are up to date.
+ */
+void Thermodynamics::heatingRates(Fluid& fluid, const std::vector<int>& cellIDs) const {
+	Grid& grid = fluid.getGrid();
+	Parallel::forEach(0, (int)cellIDs.size(), [&](int i) {
+		const int cellID = cellIDs[i];
 		GridCell& cell = grid.getCell(cellID);
 
 		if (cell.Q[UID::ADV] < m_thermoHII_Switch) {
 			cell.T[TID::RATE] = 0;
-			continue;
+			return;
 		}
 		double nH = m_massFractionH*cell.Q[UID::DEN] / m_consts->hydrogenMass;
 		double HIIFRAC = cell.Q[UID::HII];
-		double ne = nH*(HIIFRAC); //Ionised hydrogen no. density.
-		double nn = nH*(1.0-HIIFRAC); //Neutral hydrogen no. density.
-		double T = fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]);
+		double T = cell.getTemperature();
 
-		double rsqrd = 0;
 		double F_FUV = 0;
-		if (fluid.getStar().on) {
-			for (int id = 0; id < m_consts->nd; ++id)
-				rsqrd += (cell.xc[id]-fluid.getStar().xc[id])*(cell.xc[id]-fluid.getStar().xc[id])*grid.dx[id]*grid.dx[id];
-			F_FUV = fluxFUV(0.5*fluid.getStar().photonRate, rsqrd);
-		}
+		if (fluid.getStar().on)
+			F_FUV = fluxFUV(0.5*fluid.getStar().photonRate, grid.getRayGeometry(cellID).rsqrd);
 		double tau = cell.T[TID::COL_DEN];
 		double Av_FUV = 1.086*m_consts->dustExtinctionCrossSection*tau; //!< Visual band optical extinction in magnitudes.
 
@@ -252,183 +472,388 @@ void Thermodynamics::preTimeStepCalculations(Fluid& fluid) const {
 
 		cell.T[TID::HEAT] = rate;
 
-		rate -= ionisedMetalLineCooling(ne, T);
-		rate -= neutralMetalLineCooling(ne, nn, T);
-		rate -= collisionalExcitationHI(nH, HIIFRAC, T);
-		rate -= collisionalIonisationEquilibriumCooling(ne, T);
-		rate -= neutralMolecularLineCooling(nH, HIIFRAC, T);
+		rate -= coolingRate(nH, HIIFRAC, T);
 		rate = softLanding(rate, T, cell.T_min);
 
 		cell.T[TID::RATE] = m_heatingAmplification*rate;
-	}
+	});
+}
+
+/**
+ * @brief Number of cooling subcycles a cell needs after its first step, which has length dti, to integrate over dt.
+ * @param dt Time step.
+ * @param dti Length of the first subcycle.
+ */
+int Thermodynamics::subcycleCount(const double dt, const double dti) const {
+	if (!(dt > dti))
+		return 0;
+	double dtdti = dt/dti;
+	int nsteps = dtdti - (int)dtdti > 0 ? (int)(dtdti + 1.0) : (int)(dtdti + 0.5);
+	// A step has already been made.
+	return nsteps - 1;
 }
 
+/**
+ * @brief Heating rate of a cell at temperature T during its subcycles (the heating terms do not change with T).
+ */
+double Thermodynamics::subcycleRate(const CoolingCoefficients& coeffs, const GridCell& cell, const double T) const {
+	return m_heatingAmplification*softLanding(cell.T[TID::HEAT] - coolingRate(coeffs, T), T, cell.T_min);
+}
+
+/**
+ * @brief Integrates the cooling of every cell the thermo switch leaves on (see Thermodynamics::activeCells) over dt.
+ *
+ * The number of subcycles every cell needs is found first, and the cells that need any are then shared out between the
+ * threads most expensive first, so a few very stiff cells do not hold up the rest of the loop. Cells needing more than
+ * stiffSubsteps forward Euler subcycles are integrated with stiffSubsteps exponential Euler steps instead (see
+ * Thermodynamics::subcycle).
+ * @param dt Time step.
+ * @param fluid The Fluid.
+ */
 void Thermodynamics::integrate(double dt, Fluid& fluid) const {
+	ScopedTimer timer(ProfileID::THERMO_INTEGRATE, fluid.getGrid().getIterable(CellRange::GRID_CELLS).size());
+	subcycleCells(dt, fluid, activeCells(fluid));
+	integrateChemistry(dt, fluid, activeCells(fluid));
+}
+
+/**
+ * @brief Whether coolTile can stand in for a step of the whole Grid, which it cannot while the histogram of every
+ * cell's subcycle count is logged.
+ */
+bool Thermodynamics::canCoolTiles() const {
+	return !m_substepStats;
+}
+
+/**
+ * @brief Equivalent of preTimeStepCalculations(fluid), integrate(dt, fluid) and updateSourceTerms(dt, fluid)
+ * restricted to the non-wind cells of a RayTile, whose column densities must already have been traced.
+ *
+ * The cells of a tile are independent, so cooling the Grid a tile at a time gives the same state as a step of the whole
+ * Grid once every tile has been cooled.
+ * @param dt Time step.
+ * @param fluid The Fluid.
+ * @param tile The RayTile.
+ */
+void Thermodynamics::coolTile(double dt, Fluid& fluid, const RayTile& tile) const {
+	if (m_thermoHII_Switch > 0)
+		collectActiveCells(fluid, tile.nonWindIDs, m_tileActiveIDs);
+	const std::vector<int>& cellIDs = (m_thermoHII_Switch > 0) ? m_tileActiveIDs : tile.nonWindIDs;
+	heatingRates(fluid, cellIDs);
+	subcycleCells(dt, fluid, cellIDs);
+	integrateChemistry(dt, fluid, cellIDs);
+	addSourceTerms(fluid, cellIDs);
+}
+
+/**
+ * @brief Integrates the cooling of some of the non-wind cells over dt, adding their subcycles to the work of their
+ * columns for the LoadBalancer (and to their own work counters, if the Grid counts work).
+ */
+void Thermodynamics::subcycleCells(double dt, Fluid& fluid, const std::vector<int>& cellIDs) const {
 	if (!m_isSubcycling)
 		return;
 
 	Grid& grid = fluid.getGrid();
 
-	for (int cellID : grid.getOrderedIndices("CausalNonWind")) {
-		GridCell& cell = grid.getCell(cellID);
+	std::vector<int>& counts = m_subcycleCounts;
+	std::vector<int>& order = m_subcycleOrder;
+	// Sized for the whole Grid, so that neither grows as more cells are cooled.
+	counts.reserve(grid.getCells().size());
+	order.reserve(grid.getCells().size());
+	counts.assign(cellIDs.size(), 0);
+	Parallel::forEach(0, (int)cellIDs.size(), [&](int i) {
+		const GridCell& cell = grid.getCell(cellIDs[i]);
+		if (cell.Q[UID::ADV] >= m_thermoHII_Switch)
+			counts[i] = subcycleCount(dt, std::abs(0.10*cell.U[UID::PRE] / cell.T[TID::RATE]));
+	});
+	if (m_substepStats)
+		printSubstepStats(counts);
+	auto cost = [&](int i) -> int { return (m_stiffSubsteps > 0) ? std::min(counts[i], m_stiffSubsteps) : counts[i]; };
+
+	// The LoadBalancer weighs each column of cells by its subcycles as well as its cells.
+	for (unsigned int i = 0; i < cellIDs.size(); ++i) {
+		if (counts[i] > 0)
+			grid.columnWork[(int)grid.getCell(cellIDs[i]).xc[0] - grid.coreOffset[0]] += cost(i);
+	}
 
-		if (cell.Q[UID::ADV] < m_thermoHII_Switch) {
-			for (int i = 0; i < HID::N; ++i)
-				cell.H[i] = 0;
-			cell.T[TID::RATE] = 0;
-			continue;
-		}
-		double nH = m_massFractionH*cell.Q[UID::DEN] / m_consts->hydrogenMass;
-		double HIIFRAC = cell.Q[UID::HII];
-		double ne = nH*(HIIFRAC); //Ionised hydrogen no. density.
-		double nn = nH*(1.0-HIIFRAC); //Neutral hydrogen no. density.
+	// The cells needing subcycles go last, most expensive first. Ties keep their order, as std::stable_sort would
+	// without its temporary buffer.
+	order.resize(cellIDs.size());
+	for (unsigned int i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int a, int b) { return cost(a) > cost(b) || (cost(a) == cost(b) && a < b); });
+	int nsubcycled = std::count_if(counts.begin(), counts.end(), [](int count) { return count > 0; });
+
+	auto integrateCell = [&](int i) {
+		const int cellID = cellIDs[i];
+		subcycle(dt, counts[i], grid.getCell(cellID), grid.getHeating(cellID));
+		if (grid.countsWork())
+			grid.getWork(cellID)[WID::COOLING_SUBSTEPS] += cost(i);
+	};
+	Parallel::forEachDynamic(0, nsubcycled, [&](int k) { integrateCell(order[k]); });
+	Parallel::forEach(nsubcycled, (int)order.size(), [&](int k) { integrateCell(order[k]); });
+}
 
-		double dti = std::abs(0.10*cell.U[UID::PRE] / cell.T[TID::RATE]);
+/**
+ * @brief Integrates the molecular abundances of some of the non-wind cells over dt (see Chemistry), adding their steps
+ * to the work of their columns for the LoadBalancer, and logs the mean abundances with the subcycle statistics.
+ */
+void Thermodynamics::integrateChemistry(double dt, Fluid& fluid, const std::vector<int>& cellIDs) const {
+	if (!m_chemistry.isOn())
+		return;
 
-		// Pressure changes over subcycle therefore temperature does, affecting cooling rate.
-		double mu_inv = m_massFractionH*(cell.Q[UID::HII] + 1.0) + (1.0 - m_massFractionH)*0.25;
-		double pre2temp = 1.0/(mu_inv*m_consts->specificGasConstant*cell.Q[UID::DEN]);
-		double temp2pre = (mu_inv*m_consts->specificGasConstant*cell.Q[UID::DEN]);
-		double rate2dpre = std::min(dt, dti)*(cell.heatCapacityRatio - 1.0);
-		double dpre2rate = 1.0/rate2dpre;
+	Grid& grid = fluid.getGrid();
+	const Star& star = fluid.getStar();
+	// fluxFUV is in code units over the Habing flux in photons cm-2 s-1.
+	const double habing = m_consts->converter.toCodeUnits(1.0, 0.0, -2.0, -1.0);
+	m_chemistry.integrate(dt, fluid, cellIDs, [&](const GridCell& cell, double& G0, double& Av) {
+		G0 = star.on ? fluxFUV(0.5*star.photonRate, grid.getRayGeometry(cell.id).rsqrd)/habing : 0;
+		Av = 1.086*m_consts->dustExtinctionCrossSection*cell.T[TID::COL_DEN];
+	});
+
+	for (int cellID : cellIDs)
+		grid.columnWork[(int)grid.getCell(cellID).xc[0] - grid.coreOffset[0]] += m_chemistry.getSteps();
+
+	if (m_substepStats) {
+		Chemistry::Abundances mean = m_chemistry.meanAbundances(fluid, cellIDs);
+		Logger::Instance().print<SeverityType::NOTICE>("Thermodynamics::integrate: mean abundances: H2 ", mean[SID::H2],
+				", CO ", mean[SID::CO], ".\n");
+	}
+}
 
-		double pressure = cell.Q[UID::PRE] + cell.T[TID::RATE] * rate2dpre;
-		double subcycleT = pressure*pre2temp;
-		// Fix pressure and temperature and heating rate.
+/**
+ * @brief Integrates the cooling of a cell over dt, in nsteps forward Euler subcycles after the first step. If nsteps is
+ * more than stiffSubsteps (and stiffSubsteps is not 0) the subcycles are replaced with stiffSubsteps exponential Euler
+ * steps over the same interval, which stay stable however stiff the cooling is.
+ * @param dt Time step.
+ * @param nsteps Number of subcycles after the first step (see Thermodynamics::subcycleCount).
+ * @param cell The GridCell.
+ * @param heating The cell's heating diagnostics.
+ */
+void Thermodynamics::subcycle(const double dt, const int nsteps, GridCell& cell, HeatArray& heating) const {
+	if (cell.Q[UID::ADV] < m_thermoHII_Switch) {
+		heating.fill(0);
+		cell.T[TID::RATE] = 0;
+		return;
+	}
+	double nH = m_massFractionH*cell.Q[UID::DEN] / m_consts->hydrogenMass;
+	double HIIFRAC = cell.Q[UID::HII];
+
+	double dti = std::abs(0.10*cell.U[UID::PRE] / cell.T[TID::RATE]);
+
+	// Pressure changes over subcycle therefore temperature does, affecting cooling rate.
+	double mu_inv = m_massFractionH*(cell.Q[UID::HII] + 1.0) + (1.0 - m_massFractionH)*0.25;
+	double pre2temp = 1.0/(mu_inv*m_consts->specificGasConstant*cell.Q[UID::DEN]);
+	double temp2pre = (mu_inv*m_consts->specificGasConstant*cell.Q[UID::DEN]);
+	double rate2dpre = std::min(dt, dti)*(cell.heatCapacityRatio - 1.0);
+	double dpre2rate = 1.0/rate2dpre;
+
+	double pressure = cell.Q[UID::PRE] + cell.T[TID::RATE] * rate2dpre;
+	double subcycleT = pressure*pre2temp;
+	// Fix pressure and temperature and heating rate.
+	auto applyFloors = [&]() {
 		if (pressure < m_consts->pfloor || subcycleT < cell.T_min) {
 			double pfloor = std::max(cell.T_min*temp2pre, m_consts->pfloor);
 			subcycleT = pfloor*pre2temp;
 			pressure = pfloor;
 		}
-
-		if (dt > dti) {
-			double dtdti = dt/dti;
-			// Number of subcycle steps and cooling step.
-			int nsteps = dtdti - (int)dtdti > 0 ? (int)(dtdti + 1.0) : (int)(dtdti + 0.5);
-			dti = dt / nsteps;
-			// A step has already been made.
-			--nsteps;
-
-			// Subcycling.
+	};
+	applyFloors();
+
+	if (nsteps > 0) {
+		// Only the temperature changes between subcycles.
+		const CoolingCoefficients coeffs = coolingCoefficients(nH, HIIFRAC);
+		if (m_stiffSubsteps > 0 && nsteps > m_stiffSubsteps) {
+			// Exponential Euler: dp/ds = rate(p) linearised about the start of each step and integrated exactly.
+			double h = nsteps*rate2dpre/m_stiffSubsteps;
+			for (int i = 0; i < m_stiffSubsteps; ++i) {
+				double rate = subcycleRate(coeffs, cell, subcycleT);
+				double dT = 1.0e-4*subcycleT;
+				double J = pre2temp*(subcycleRate(coeffs, cell, subcycleT + dT) - rate)/dT;
+				double Jh = J*h;
+				pressure += (std::abs(Jh) > 1.0e-8) ? rate*std::expm1(Jh)/J : rate*h;
+				subcycleT = pressure*pre2temp;
+				applyFloors();
+			}
+		}
+		else {
 			for (int i = 0; i < nsteps; ++i) {
-				double subcycleRate = cell.T[TID::HEAT];
-				subcycleRate -= ionisedMetalLineCooling(ne, subcycleT);
-				subcycleRate -= neutralMetalLineCooling(ne, nn, subcycleT);
-				subcycleRate -= collisionalExcitationHI(nH, HIIFRAC, subcycleT);
-				subcycleRate -= collisionalIonisationEquilibriumCooling(ne, subcycleT);
-				subcycleRate -= neutralMolecularLineCooling(nH, HIIFRAC, subcycleT);
-				subcycleRate = m_heatingAmplification*softLanding(subcycleRate, subcycleT, cell.T_min);
-
 				// Update pressure and total heating rate.
-				pressure += subcycleRate*rate2dpre;
+				pressure += subcycleRate(coeffs, cell, subcycleT)*rate2dpre;
 				subcycleT = pressure*pre2temp;
-				// Fix pressure and temperature and heating rate.
-				if (pressure < m_consts->pfloor || subcycleT < cell.T_min) {
-					double pfloor = std::max(cell.T_min*temp2pre, m_consts->pfloor);
-					subcycleT = pfloor*pre2temp;
-					pressure = pfloor;
-				}
+				applyFloors();
 			}
 		}
+	}
+
+	cell.T[TID::RATE] = (pressure - cell.Q[UID::PRE]) * dpre2rate;
+	heating[HID::TOT] = cell.T[TID::RATE];
+}
 
-		cell.T[TID::RATE] = (pressure - cell.Q[UID::PRE]) * dpre2rate;
-		cell.H[HID::TOT] = cell.T[TID::RATE];
+/**
+ * @brief Sums a histogram of the cooling subcycle counts over the processors and logs it from the root processor.
+ * @param counts Number of subcycles after the first step of every cell.
+ */
+void Thermodynamics::printSubstepStats(const std::vector<int>& counts) const {
+	// Bin b > 0 counts cells taking (2^(b-1), 2^b] subcycles in all, the last bin any more.
+	const int nbins = 16;
+	std::array<double, nbins> histogram;
+	histogram.fill(0);
+	for (int count : counts) {
+		int bin = 0;
+		while (bin < nbins - 1 && (1 << bin) < count + 1)
+			++bin;
+		++histogram[bin];
+	}
+
+	std::stringstream out;
+	out << "Thermodynamics::integrate: cooling subcycles:";
+	for (int bin = 0; bin < nbins; ++bin) {
+		double count = MPIW::Instance().sum(histogram[bin]);
+		if (count == 0)
+			continue;
+		if (bin == 0)
+			out << " 1:";
+		else if (bin == nbins - 1)
+			out << " >" << (1 << (bin - 1)) << ':';
+		else if (bin == 1)
+			out << " 2:";
+		else
+			out << ' ' << (1 << (bin - 1)) + 1 << '-' << (1 << bin) << ':';
+		out << (long)count;
 	}
+	if (m_stiffSubsteps > 0)
+		out << " (exponential above " << m_stiffSubsteps + 1 << ')';
+	out << '\n';
+	if (MPIW::Instance().getRank() == 0)
+		Logger::Instance().print<SeverityType::NOTICE>(out.str());
 }
 
+/**
+ * @brief Interpolates the column density to a cell from those through its neighbours, as Radiation::updateTauSC does
+ * the optical depth, with the neighbours outside the Grid or with no column left out.
+ *
+ * The weights are taken with selects rather than branches and normalised by a single division at the end.
+ */
 void Thermodynamics::updateColDen(GridCell& cell, Fluid& fluid, const double dist2) const {
 	Grid& grid = fluid.getGrid();
+	const RayGeometry& ray = grid.getRayGeometry(cell.id);
 	if (dist2 > 0.95*0.95) {
+		const std::array<double, 4> weights = grid.neighbourWeights(cell.xc, fluid.getStar().xc);
 		double colden[4] = {0.0, 0.0, 0.0, 0.0};
-		double w_raga[4];
-		for(int i = 0; i < 4; ++i) {
-			if (cell.neighbourIDs[i] != -1)
-				colden[i] = grid.getCell(cell.neighbourIDs[i]).T[TID::COL_DEN]+grid.getCell(cell.neighbourIDs[i]).T[TID::DCOL_DEN];
-			w_raga[i] = colden[i] == 0 ? 0 : cell.neighbourWeights[i]/colden[i];
+		for (int i = 0; i < 4; ++i) {
+			if (ray.neighbourIDs[i] != -1) {
+				const GridCell& neighbour = grid.getCell(ray.neighbourIDs[i]);
+				colden[i] = neighbour.T[TID::COL_DEN] + neighbour.T[TID::DCOL_DEN];
+			}
 		}
-		double sum_w = w_raga[0]+w_raga[1]+w_raga[2]+w_raga[3];
-
-		double newcolden = 0.0;
-		for (int i = 0; i < 4 && sum_w != 0; ++i) {
-			w_raga[i] = w_raga[i]/sum_w;
+		double w_raga[4];
+		for (int i = 0; i < 4; ++i)
+			w_raga[i] = colden[i] == 0 ? 0 : weights[i]/(colden[i] == 0 ? 1 : colden[i]);
+		double sum_w = 0, newcolden = 0;
+		for (int i = 0; i < 4; ++i) {
+			sum_w += w_raga[i];
 			newcolden += w_raga[i]*colden[i];
 		}
-		cell.T[TID::COL_DEN] = newcolden;
-		cell.T[TID::DCOL_DEN] = (cell.Q[UID::DEN] / m_consts->hydrogenMass)*cell.ds;
+		cell.T[TID::COL_DEN] = sum_w != 0 ? newcolden/sum_w : 0;
+		cell.T[TID::DCOL_DEN] = (cell.Q[UID::DEN] / m_consts->hydrogenMass)*ray.ds;
 	}
 	else {
 		cell.T[TID::COL_DEN] = 0;
-		cell.T[TID::DCOL_DEN] = (cell.Q[UID::DEN] / m_consts->hydrogenMass)*cell.ds;
+		cell.T[TID::DCOL_DEN] = (cell.Q[UID::DEN] / m_consts->hydrogenMass)*ray.ds;
 	}
 }
 
-void Thermodynamics::rayTrace(Fluid& fluid) const {
-	MPIW& mpihandler = MPIW::Instance();
+/**
+ * @brief Calculates the column densities of the cells in a RayTile. The cells of each dependency level are shared out
+ * between threads.
+ * @param tile The RayTile.
+ * @param fluid The Fluid.
+ */
+void Thermodynamics::rayTrace(const RayTile& tile, Fluid& fluid) const {
 	Grid& grid = fluid.getGrid();
-	Star& star = fluid.getStar();
-	PartitionManager& partition = grid.getPartitionManager();
-	partition.resetBuffer();
+	if (m_columnDensityTolerance > 0 && m_tracedDensities.size() != grid.getCells().size())
+		m_tracedDensities.assign(grid.getCells().size(), 0);
+	// The cells of a dependency level only read column densities from earlier levels.
+	auto trace = [&](int cellID) {
+		GridCell& cell = grid.getCell(cellID);
+		updateColDen(cell, fluid, grid.getRayGeometry(cellID).dist2);
+		if (m_columnDensityTolerance > 0)
+			m_tracedDensities[cellID] = cell.Q[UID::DEN];
+	};
+	Parallel::forEachLevel(tile.windLevels, [&](int i) { trace(tile.windIDs[i]); });
+	Parallel::forEachLevel(tile.nonWindLevels, [&](int i) { trace(tile.nonWindIDs[i]); });
+}
 
-	if (fluid.getStar().core != Star::Location::HERE) {
-		int source = (star.core == Star::Location::LEFT) ? mpihandler.rank - 1 : mpihandler.rank + 1;
-		partition.recvData(source, SendID::THERMO_MSG);
+/**
+ * @brief Reads the column densities of a ghost cell sent by packColumnDensities.
+ */
+void Thermodynamics::unpackColumnDensities(GridCell& ghost, PartitionManager& partition) {
+	ghost.T[TID::COL_DEN] = partition.getRecvItem();
+	ghost.T[TID::DCOL_DEN] = partition.getRecvItem();
+}
 
-		for (GridCell& ghost : grid.getIterable(star.core == Star::Location::LEFT ? "LeftPartitionCells" : "RightPartitionCells")) {
-			ghost.T[TID::COL_DEN] = partition.getRecvItem();
-			ghost.T[TID::DCOL_DEN] = partition.getRecvItem();
-		}
-	}
-	for (int cellID : grid.getOrderedIndices("CausalWind")) {
-		GridCell& cell = grid.getCell(cellID);
+void Thermodynamics::packColumnDensities(const GridCell& cell, PartitionManager& partition) {
+	partition.addSendItem(cell.T[TID::COL_DEN]);
+	partition.addSendItem(cell.T[TID::DCOL_DEN]);
+}
 
-		double dist2 = 0;
-		for (int i = 0; i < m_consts->nd; ++i)
-			dist2 += (cell.xc[i] - fluid.getStar().xc[i])*(cell.xc[i] - fluid.getStar().xc[i]);
-		updateColDen(cell, fluid, dist2);
-	}
-	for (int cellID : grid.getOrderedIndices("CausalNonWind")) {
-		GridCell& cell = grid.getCell(cellID);
+/**
+ * @brief Calculates the column densities of every cell, a RayTile at a time so they are passed on to the processors
+ * further from the star as soon as possible (see Fluid::sweepRayTiles).
+ * @param fluid The Fluid.
+ */
+void Thermodynamics::rayTrace(Fluid& fluid) const {
+	fluid.sweepRayTiles(SendID::THERMO_MSG, unpackColumnDensities,
+		[&](const RayTile& tile) { rayTrace(tile, fluid); },
+		packColumnDensities);
+	fluid.getGrid().hasColumnDensities = true;
+	fluid.getGrid().hasTracedColumnDensities = true;
+}
 
-		double dist2 = 0;
-		for (int i = 0; i < m_consts->nd; ++i)
-			dist2 += (cell.xc[i] - fluid.getStar().xc[i])*(cell.xc[i] - fluid.getStar().xc[i]);
-		updateColDen(cell, fluid, dist2);
-	}
-	// Send column densities to processor on left.
-	if(!(mpihandler.getRank() == 0 || fluid.getStar().core == Star::Location::LEFT)) {
-		for (GridCell& ghost : grid.getIterable("LeftPartitionCells")) {
-			GridCell& cell = grid.right(0, ghost);
-			partition.addSendItem(cell.T[TID::COL_DEN]);
-			partition.addSendItem(cell.T[TID::DCOL_DEN]);
-		}
-		int destination = mpihandler.rank - 1;
-		partition.sendData(destination, SendID::THERMO_MSG);
-	}
-	// Send column densities to processor on right.
-	if(!(mpihandler.getRank() == mpihandler.nProcessors()-1 || fluid.getStar().core == Star::Location::RIGHT)) {
-		for (GridCell& ghost : grid.getIterable("RightPartitionCells")) {
-			GridCell& cell = grid.left(0, ghost);
-			partition.addSendItem(cell.T[TID::COL_DEN]);
-			partition.addSendItem(cell.T[TID::DCOL_DEN]);
-		}
-		int destination = mpihandler.rank + 1;
-		partition.sendData(destination, SendID::THERMO_MSG);
-	}
+/**
+ * @brief Marks the column densities of the last ray trace as up to date, without tracing them again, if no cell's
+ * density has changed by more than m_columnDensityTolerance relative to its density then, e.g. over the hydrodynamic
+ * half-step between the Strang sub-steps of the cooling. Collective.
+ * @param fluid The Fluid.
+ * @return Whether the column densities were reused.
+ */
+bool Thermodynamics::reuseColumnDensities(Fluid& fluid) const {
+	Grid& grid = fluid.getGrid();
+	if (m_columnDensityTolerance <= 0 || !grid.hasTracedColumnDensities || m_tracedDensities.size() != grid.getCells().size())
+		return false;
+	double change = 0;
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS))
+		change = std::max(change, std::abs(cell.Q[UID::DEN] - m_tracedDensities[cell.id])/m_tracedDensities[cell.id]);
+	if (MPIW::Instance().maximum(change) > m_columnDensityTolerance)
+		return false;
+	grid.hasColumnDensities = true;
+	return true;
 }
 
+/**
+ * @brief Fills the heating diagnostics of every non-wind cell with the separate heating and cooling terms.
+ *
+ * The column densities the last step's cooling was found with are used as they are, so a checkpoint costs no ray trace
+ * (a relay over every processor) unless there has been none since the cells or the star last changed, e.g. while the
+ * cooling is off.
+ * @param fluid The Fluid.
+ */
 void Thermodynamics::fillHeatingArrays(Fluid& fluid) {
-	if (fluid.getStar().on)
+	if (!THERMO_BUILT || !fluid.getGrid().storesRayData())
+		return;
+	if (fluid.getStar().on && !fluid.getGrid().hasTracedColumnDensities)
 		rayTrace(fluid);
 
 	Grid& grid = fluid.getGrid();
-
-	for (int cellID : grid.getOrderedIndices("CausalNonWind")) {
+	const std::vector<int>& cellIDs = grid.getOrderedIndices(CellOrder::CAUSAL_NON_WIND);
+	Parallel::forEach(0, (int)cellIDs.size(), [&](int i) {
+		const int cellID = cellIDs[i];
 		GridCell& cell = grid.getCell(cellID);
+		HeatArray& heating = grid.getHeating(cellID);
 
 		if (cell.Q[UID::ADV] < m_thermoHII_Switch) {
-			for (int i = 0; i < HID::N; ++i)
-				cell.H[i] = 0;
-			continue;
+			heating.fill(0);
+			return;
 		}
 
 		double nH = m_massFractionH*cell.Q[UID::DEN] / m_consts->hydrogenMass;
@@ -436,50 +861,54 @@ void Thermodynamics::fillHeatingArrays(Fluid& fluid) {
 		double ne = HIIFRAC*nH;
 		double nn = (1.0 - HIIFRAC)*nH;
 		double T = cell.temperature(m_massFractionH, m_consts->specificGasConstant);
-		double rsqrd = 0;
 		double F_FUV = 0;
-		if (fluid.getStar().on) {
-			for (int id = 0; id < m_consts->nd; ++id)
-				rsqrd += (cell.xc[id]-fluid.getStar().xc[id])*(cell.xc[id]-fluid.getStar().xc[id])*grid.dx[id]*grid.dx[id];
-			F_FUV = fluxFUV(0.5*fluid.getStar().photonRate, rsqrd);
-		}
+		if (fluid.getStar().on)
+			F_FUV = fluxFUV(0.5*fluid.getStar().photonRate, grid.getRayGeometry(cellID).rsqrd);
 		double tau = cell.T[TID::COL_DEN];
 		double Av_FUV = 1.086*m_consts->dustExtinctionCrossSection*tau; //!< Visual band optical extinction in magnitudes.
 
-		cell.H[HID::FUVH] = farUltraVioletHeating(nH, Av_FUV, F_FUV);
-		cell.H[HID::IRH] = infraRedHeating(nH, Av_FUV, F_FUV);
-		cell.H[HID::CRH] = cosmicRayHeating(nH);
+		heating[HID::FUVH] = farUltraVioletHeating(nH, Av_FUV, F_FUV);
+		heating[HID::IRH] = infraRedHeating(nH, Av_FUV, F_FUV);
+		heating[HID::CRH] = cosmicRayHeating(nH);
 
-		cell.H[HID::IMLC] = -ionisedMetalLineCooling(ne, T);
-		cell.H[HID::NMLC] = -neutralMetalLineCooling(ne, nn, T);
-		cell.H[HID::CEHI] = -collisionalExcitationHI(nH, HIIFRAC, T);
-		cell.H[HID::CIEC] = -collisionalIonisationEquilibriumCooling(ne, T);
-		cell.H[HID::NMC] = -neutralMolecularLineCooling(nH, HIIFRAC, T);
+		heating[HID::IMLC] = -ionisedMetalLineCooling(ne, T);
+		heating[HID::NMLC] = -neutralMetalLineCooling(ne, nn, T);
+		heating[HID::CEHI] = -collisionalExcitationHI(nH, HIIFRAC, T);
+		heating[HID::CIEC] = -collisionalIonisationEquilibriumCooling(ne, T);
+		heating[HID::NMC] = -neutralMolecularLineCooling(nH, HIIFRAC, T);
 
-		cell.H[HID::TOT] += cell.H[HID::RHII] + cell.H[HID::EUVH];
-	}
+		heating[HID::TOT] += heating[HID::RHII] + heating[HID::EUVH];
+	});
 }
 
 double Thermodynamics::calculateTimeStep(double dt_max, Fluid& fluid) const {
 	Grid& grid = fluid.getGrid();
-	double dt = dt_max;
-	for (GridCell& cell : grid.getCells()) {
-		if (cell.T[TID::RATE] != 0) {
-			double frac = m_isSubcycling ? 1.0 : 0.1;
-			double dti = std::abs(frac*cell.U[UID::PRE]/cell.T[TID::RATE]);
-			if (dti < dt) {
-				dt = dti;
-			}
-		}
-	}
-	return dt;
+	const GridCellVector& cells = grid.getCells();
+	const double frac = m_isSubcycling ? 1.0 : 0.1;
+	const Parallel::Extremum coolest = Parallel::minimumLocation(0, (int)cells.size(), dt_max, [&](int id) -> double {
+		const GridCell& cell = cells[id];
+		if (cell.T[TID::RATE] != 0)
+			return std::abs(frac*cell.U[UID::PRE]/cell.T[TID::RATE]);
+		return dt_max;
+	});
+	timeStepLimiter.criterion = (coolest.index >= 0) ? TimeStepCriterion::COOLING : TimeStepCriterion::MAX;
+	timeStepLimiter.cellID = coolest.index;
+	return coolest.value;
 }
 
 void Thermodynamics::updateSourceTerms(double dt, Fluid& fluid) const {
+	addSourceTerms(fluid, activeCells(fluid));
+}
+
+/**
+ * @brief Adds the heating and cooling rates of some of the non-wind cells to their rates of change of energy.
+ */
+void Thermodynamics::addSourceTerms(Fluid& fluid, const std::vector<int>& cellIDs) const {
 	Grid& grid = fluid.getGrid();
-	for (int cellID : grid.getOrderedIndices("CausalNonWind")) {
+	Parallel::forEach(0, (int)cellIDs.size(), [&](int i) {
+		const int cellID = cellIDs[i];
 		GridCell& cell = grid.getCell(cellID);
 		cell.UDOT[UID::PRE] += cell.T[TID::RATE];
 		cell.T[TID::RATE] = cell.T[TID::HEAT] = 0;
-	}
+	});
 }
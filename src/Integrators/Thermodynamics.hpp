@@ -11,14 +11,18 @@
 #include <memory>
 #include <vector>
 
+#include "Chemistry.hpp"
 #include "Integrator.hpp"
 #include "SplineData.hpp"
+#include "Torch/Common.hpp"
 
 class Converter;
 class Star;
 class Fluid;
 class GridCell;
 class MPIW;
+class PartitionManager;
+class RayTile;
 class ThermoParameters;
 class Constants;
 
@@ -42,9 +46,50 @@ public:
 	void initialiseMinTempField(Fluid& fluid) const;
 
 	void fillHeatingArrays(Fluid& fluid);
+
+	// Tile at a time steps, overlapped with the radiation sweep (see Torch::radiationCoolingSubSteps).
+	bool canCoolTiles() const;
+	void coolTile(double dt, Fluid& fluid, const RayTile& tile) const;
+
+	// Column densities, also traced by Radiation in its own sweep when the two are fused.
+	void rayTrace(const RayTile& tile, Fluid& fluid) const;
+	static void unpackColumnDensities(GridCell& ghost, PartitionManager& partition);
+	static void packColumnDensities(const GridCell& cell, PartitionManager& partition);
+
+	double coolingRate(const double nH, const double HIIFRAC, const double T) const;
+	void coolingRates(const int n, const double* nH, const double* HIIFRAC, const double* T, double* rates) const;
 private:
+	friend class KernelBenchmarks; //!< Times the cooling functions (see bench.cpp).
+
+	/**
+	 * @brief The temperature independent factors of the cooling terms of a cell, which stay fixed over its subcycles.
+	 */
+	struct CoolingCoefficients {
+		double imlc = 0; //!< Factor of the ionised metal line cooling.
+		double nmlc = 0; //!< Factor of the neutral metal line cooling.
+		double cxhi = 0; //!< Factor of the HI collisional excitation cooling.
+		double ciec = 0; //!< Factor of the collisional ionisation equilibrium cooling.
+		double nmc = 0; //!< Factor of the neutral and molecular line cooling.
+		double T0 = 0; //!< Excitation temperature of the neutral and molecular line cooling.
+		double ne2 = 0; //!< Square of the electron number density, the factor of the ionised cooling table.
+	};
+
+	CoolingCoefficients coolingCoefficients(const double nH, const double HIIFRAC) const;
+	double coolingRate(const CoolingCoefficients& coeffs, const double T) const;
+	double subcycleRate(const CoolingCoefficients& coeffs, const GridCell& cell, const double T) const;
+	int subcycleCount(const double dt, const double dti) const;
+	void subcycle(const double dt, const int nsteps, GridCell& cell, HeatArray& heating) const;
+	void printSubstepStats(const std::vector<int>& counts) const;
+	void collectActiveCells(Fluid& fluid, const std::vector<int>& cellIDs, std::vector<int>& active) const;
+	const std::vector<int>& activeCells(Fluid& fluid) const;
+	void heatingRates(Fluid& fluid, const std::vector<int>& cellIDs) const;
+	void subcycleCells(double dt, Fluid& fluid, const std::vector<int>& cellIDs) const;
+	void integrateChemistry(double dt, Fluid& fluid, const std::vector<int>& cellIDs) const;
+	void addSourceTerms(Fluid& fluid, const std::vector<int>& cellIDs) const;
 	void initCollisionalExcitationHI(const Converter& scale);
 	void initRecombinationHII(const Converter& scale);
+	void initRateTables(int size, bool check);
+	void initCoolingTable(int size);
 	double fluxFUV(const double Q_FUV, const double dist_sqrd) const;
 	double collisionalExcitationHI(const double nH, const double HIIFRAC, const double T) const;
 	double recombinationHII(const double nH, const double HIIFRAC, const double T) const;
@@ -59,12 +104,24 @@ private:
 
 	void updateColDen(GridCell& cell, Fluid& fluid, const double dist2) const;
 	void rayTrace(Fluid& fluid) const;
+	bool reuseColumnDensities(Fluid& fluid) const;
 
 	std::shared_ptr<Constants> m_consts = nullptr;
 
 	bool m_isSubcycling = false;
+	int m_stiffSubsteps = 0; //!< Cells needing more subcycles than this take this many exponential Euler steps (0 never does).
+	bool m_substepStats = false; //!< Log a histogram of the subcycle counts every step.
+	Chemistry m_chemistry; //!< Molecular abundances of the cells the thermo switch leaves on.
 	bool m_minTempInitialState = false;
-	double m_thermoHII_Switch = 0;
+	double m_thermoHII_Switch = 0; //!< Cells whose GridCell::Q[UID::ADV] is below this are neither heated nor cooled.
+	mutable std::vector<int> m_activeIDs; //!< The CausalNonWind cells at or above m_thermoHII_Switch, collected by preTimeStepCalculations.
+	double m_columnDensityTolerance = 0; //!< Largest relative change in a density since the last ray trace at which its column densities are reused (0 never reuses them).
+	mutable std::vector<double> m_tracedDensities; //!< Density of each cell when its column densities were last traced, indexed by cell ID.
+	mutable std::vector<int> m_tileActiveIDs; //!< The cells of the last tile cooled by coolTile at or above m_thermoHII_Switch.
+	mutable std::vector<int> m_subcycleCounts; //!< Subcycles of each cell of the last subcycleCells.
+	mutable std::vector<int> m_subcycleOrder; //!< Order the last subcycleCells integrated its cells in.
+	mutable std::vector<char> m_isSwitchedOff; //!< Whether each cell's heating was zeroed when it fell below m_thermoHII_Switch.
+	mutable int m_switchedOffRebuilds = 0; //!< Grid::rebuilds when m_isSwitchedOff was last cleared.
 	double m_heatingAmplification = 1.0; //!< Heating amplification/reduction hack.
 	double m_coolingFloorTemperature = 300;
 	double m_massFractionH = 0;
@@ -103,6 +160,10 @@ private:
 
 	std::unique_ptr<LogSplineData> m_collisionalExcitationHI_CoolingRates;
 	std::unique_ptr<LinearSplineData> m_recombinationHII_CoolingRates;
+	std::unique_ptr<UniformLogTable> m_collisionalExcitationHI_Table; //!< m_collisionalExcitationHI_CoolingRates resampled for O(1) lookups.
+	std::unique_ptr<UniformLogTable> m_recombinationHII_Table; //!< m_recombinationHII_CoolingRates resampled for O(1) lookups.
+	std::unique_ptr<UniformLogTable> m_ionisedCoolingTable; //!< Ionised metal line and collisional ionisation equilibrium cooling over ne^2.
+	std::unique_ptr<UniformLogTable> m_mixedCoolingTable; //!< Neutral metal line cooling and collisional excitation of HI over ne*nn.
 };
 
 #endif // THERMODYNAMICS_HPP_
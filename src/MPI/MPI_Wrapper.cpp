@@ -1,17 +1,90 @@
 #include "MPI_Wrapper.hpp"
 
+#include "Misc/Profiler.hpp"
+
 #include <stdlib.h>
+#include <algorithm>
+#include <climits>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <sstream>
+#include <stdexcept>
+#include <vector>
 
 #include <mpi.h>
 
+/**
+ * @brief The arguments of a neighbourhood alltoall, kept for as long as it may be in flight.
+ */
+struct NeighbourExchange {
+	MPI_Comm graph = MPI_COMM_NULL; //!< Distributed graph of the processor and its neighbours.
+	bool useTypes = false; //!< Whether the exchange is an alltoallw of datatypes rather than an alltoallv of doubles.
+	void* send = nullptr;
+	void* recv = nullptr;
+	std::vector<int> sendCounts, recvCounts;
+	std::vector<int> sendDispls, recvDispls; //!< Offsets of the blocks in doubles (alltoallv).
+	std::vector<MPI_Aint> byteDispls; //!< Offsets of the blocks in bytes, all zero (alltoallw).
+	std::vector<MPI_Datatype> sendTypes, recvTypes;
+};
+
+struct MPIW::Handles {
+	MPI_Comm comm = MPI_COMM_WORLD; //!< Processes of this processor's group, which all other messages are passed through.
+	MPI_Comm cartesian = MPI_COMM_NULL;
+	MPI_Comm node = MPI_COMM_NULL; //!< Processes that share memory with this one.
+	std::vector<MPI_Request> requests;
+	std::vector<MPI_Request> persistent; //!< Persistent requests, which live until MPI is finalised.
+	std::vector<int> started; //!< Persistent requests started since the last waitAll.
+	std::vector<MPI_Datatype> types; //!< Committed derived datatypes.
+	MPI_Win tasks = MPI_WIN_NULL; //!< Exposes the task counter of the first processor to the groups.
+	int taskCounter = 0; //!< Next task of the queue shared by the groups (first processor only).
+	std::vector<MPI_Request> ioRequests; //!< Sends of output to the I/O processor still in flight.
+	std::vector<std::vector<char>> ioMessages; //!< Buffers of the sends in ioRequests.
+	std::vector<MPI_Request> partnerRequests; //!< Sends to the partner processor still in flight (see postPartner).
+	std::vector<std::vector<double>> partnerMessages; //!< Buffers of the sends in partnerRequests.
+	std::vector<MPI_Request> logRequests; //!< Sends of log messages still in flight (see postLog).
+	std::vector<std::vector<char>> logMessages; //!< Buffers of the sends in logRequests.
+	MPI_Win relayData = MPI_WIN_NULL; //!< Exposes the receive regions of the one-sided relay (see createRelay).
+	MPI_Win relaySignals = MPI_WIN_NULL; //!< Exposes the signal slots of the one-sided relay.
+	double* relayBase = nullptr; //!< This processor's receive regions.
+	long long* signalBase = nullptr; //!< This processor's signal slots.
+	std::vector<NeighbourExchange> neighbourExchanges; //!< Neighbourhood collectives, which live until freePersistent.
+	MPI_Datatype taggedType = MPI_DATATYPE_NULL; //!< A double and the tag of its reduction (see sumAndMaximum).
+	MPI_Op sumOrMax = MPI_OP_NULL; //!< Sums or takes the maximum of each tagged double.
+};
+
+/**
+ * @brief Reduces pairs of doubles, a value and a tag that is 0 for a sum and 1 for a maximum, into inout. MPI may hand
+ * the operation any run of the elements, so each carries its own tag.
+ */
+static void reduceSumOrMax(void* in, void* inout, int* len, MPI_Datatype*) {
+	const double* a = static_cast<const double*>(in);
+	double* b = static_cast<double*>(inout);
+	for (int i = 0; i < *len; ++i) {
+		if (a[2*i + 1] == 0)
+			b[2*i] += a[2*i];
+		else
+			b[2*i] = std::max(b[2*i], a[2*i]);
+	}
+}
+
 /**
  * @brief MPIHandler constructor.
- * Initializes the MPI environment.
+ * Initializes the MPI environment, unless a program Torch is embedded in (see TorchAPI.h) already has, in which case it
+ * is left to that program to finalise. Only the main thread makes MPI calls, the OpenMP threads are confined to the
+ * per cell sweeps between them. The processes are also split by the node whose memory they share.
  */
-MPIW::MPIW(int* argc, char*** argv) {
-	MPI_Init(argc, argv);
+MPIW::MPIW(int* argc, char*** argv)
+: m_handles(new Handles())
+{
+	int provided = 0;
+	int initialised = 0;
+	MPI_Initialized(&initialised);
+	if (initialised)
+		MPI_Query_thread(&provided);
+	else
+		MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided);
+	m_ownsMPI = !initialised;
 	int name_length = 0;
 	char cname[MPI_MAX_PROCESSOR_NAME];
 	MPI_Get_processor_name(cname, &name_length);
@@ -19,9 +92,405 @@ MPIW::MPIW(int* argc, char*** argv) {
 	proc_name = name;
 	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 	MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+	m_worldRank = rank;
+	m_worldSize = nproc;
+	m_threadsFunneled = provided >= MPI_THREAD_FUNNELED;
+	// MPI only guarantees tags up to 32767, so the channels past those the library allows wrap around (see messageTag).
+	int* tagUpperBound = nullptr;
+	int found = 0;
+	MPI_Comm_get_attr(MPI_COMM_WORLD, MPI_TAG_UB, &tagUpperBound, &found);
+	m_tagChannels = std::max(1, ((found ? *tagUpperBound : 32767) + 1)/(int)SendID::N);
+	splitNodes();
 }
+
+/**
+ * @brief The MPI tag of a message with a channel (sub-tag), which keeps to the largest tag of the MPI library (MPI_TAG_UB).
+ *
+ * The channels wrap around past the last one the tags can hold, so messages whose channels differ by a multiple of the
+ * number of channels, e.g. those of the RayTiles of a grid with very many tiles (see Fluid::sweepRayTiles), share a tag.
+ * Such messages between two processors are still told apart by their order, as MPI does not let them overtake each
+ * other, as long as they are received in the order they were sent.
+ */
+int MPIW::messageTag(SendID tag, int channel) const {
+	return (int)tag + (int)SendID::N*(channel%m_tagChannels);
+}
+
+/**
+ * @brief Splits the processes of the group by the node whose memory they share.
+ */
+void MPIW::splitNodes() {
+	if (m_handles->node != MPI_COMM_NULL)
+		MPI_Comm_free(&m_handles->node);
+	MPI_Comm_split_type(m_handles->comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &m_handles->node);
+	MPI_Comm_rank(m_handles->node, &m_nodeRank);
+	MPI_Comm_size(m_handles->node, &m_nodeSize);
+	MPI_Allreduce(&rank, &m_nodeLeader, 1, MPI_INT, MPI_MIN, m_handles->node);
+	int leader = (m_nodeRank == 0) ? 1 : 0;
+	MPI_Allreduce(&leader, &m_nNodes, 1, MPI_INT, MPI_SUM, m_handles->comm);
+}
+
 MPIW::~MPIW() {
-	MPI_Finalize();
+	// A program Torch is embedded in may have finalised MPI itself, freeing everything.
+	int finalised = 0;
+	MPI_Finalized(&finalised);
+	if (finalised)
+		return;
+	if (m_handles->tasks != MPI_WIN_NULL)
+		MPI_Win_free(&m_handles->tasks);
+	freeRelay();
+	waitIO();
+	waitPartner();
+	for (MPI_Request& request : m_handles->persistent)
+		MPI_Request_free(&request);
+	for (NeighbourExchange& exchange : m_handles->neighbourExchanges)
+		MPI_Comm_free(&exchange.graph);
+	for (MPI_Datatype& type : m_handles->types)
+		MPI_Type_free(&type);
+	if (m_handles->sumOrMax != MPI_OP_NULL)
+		MPI_Op_free(&m_handles->sumOrMax);
+	if (m_handles->taggedType != MPI_DATATYPE_NULL)
+		MPI_Type_free(&m_handles->taggedType);
+	if (m_handles->cartesian != MPI_COMM_NULL)
+		MPI_Comm_free(&m_handles->cartesian);
+	if (m_handles->node != MPI_COMM_NULL)
+		MPI_Comm_free(&m_handles->node);
+	if (m_handles->comm != MPI_COMM_WORLD)
+		MPI_Comm_free(&m_handles->comm);
+	if (m_ownsMPI)
+		MPI_Finalize();
+}
+
+/**
+ * @brief Splits the processors into groups of consecutive ranks that run separate simulations. Collective.
+ *
+ * Afterwards every other method works within this processor's group: getRank() and nProcessors() are the rank in and
+ * size of the group, and the collectives and file operations only involve its processors. The groups take tasks from
+ * one queue with nextTask(). May only be called once, before any simulation is set up.
+ * @param ngroups Number of groups, between 1 and the number of processors, or 0 for a group of each processor.
+ */
+void MPIW::splitGroups(int ngroups) {
+	if (m_handles->comm != MPI_COMM_WORLD)
+		throw std::runtime_error("MPIW::splitGroups: the processors are already split into groups or I/O processors.");
+	if (ngroups == 0)
+		ngroups = m_worldSize;
+	if (ngroups < 1 || ngroups > m_worldSize)
+		throw std::runtime_error("MPIW::splitGroups: cannot split " + std::to_string(m_worldSize) + " processors into "
+				+ std::to_string(ngroups) + " groups.");
+	if (m_handles->cartesian != MPI_COMM_NULL)
+		MPI_Comm_free(&m_handles->cartesian);
+	m_nGroups = ngroups;
+	m_group = (int)(((long long)m_worldRank*ngroups)/m_worldSize);
+	MPI_Comm_split(MPI_COMM_WORLD, m_group, m_worldRank, &m_handles->comm);
+	MPI_Comm_rank(m_handles->comm, &rank);
+	MPI_Comm_size(m_handles->comm, &nproc);
+	splitNodes();
+
+	const MPI_Aint size = (m_worldRank == 0) ? sizeof(int) : 0;
+	MPI_Win_create(&m_handles->taskCounter, size, sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD, &m_handles->tasks);
+}
+
+/**
+ * @brief Sets processors aside to write the output of the others. Collective.
+ *
+ * Afterwards the compute processors form the group every other method works within, as after splitGroups, and the I/O
+ * processors form a group of their own. Each compute processor hands its output to one I/O processor with postIO and
+ * carries on, and the I/O processors take it with receiveIO and write it with writeParts. May only be called once,
+ * instead of splitGroups, before any simulation is set up.
+ * @param clients Number of compute processors served by each I/O processor: every clients + 1 consecutive ranks end
+ * with an I/O processor. -1 sets aside the last processor of each node to serve the rest of its node.
+ * @exception std::runtime_error Thrown if the processors are already split, clients is below -1 or 0, or a node (or the
+ * whole program) has a single processor to split.
+ */
+void MPIW::splitIO(int clients) {
+	if (m_handles->comm != MPI_COMM_WORLD)
+		throw std::runtime_error("MPIW::splitIO: the processors are already split into groups or I/O processors.");
+	if (clients < -1 || clients == 0)
+		throw std::runtime_error("MPIW::splitIO: io_clients(=" + std::to_string(clients) + ") must be positive or -1.");
+
+	int server = m_worldRank, tooFew = 0;
+	if (clients < 0) {
+		MPI_Allreduce(&m_worldRank, &server, 1, MPI_INT, MPI_MAX, m_handles->node);
+		tooFew = (m_nodeSize < 2) ? 1 : 0;
+	}
+	else {
+		const int block = clients + 1;
+		server = std::min(m_worldSize - 1, (m_worldRank/block)*block + clients);
+		// A lone processor left over at the end joins the block before it.
+		if (m_worldRank == m_worldSize - 1 && m_worldRank%block == 0 && m_worldRank > 0)
+			server = m_worldRank - 1;
+		tooFew = (m_worldSize < 2) ? 1 : 0;
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &tooFew, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	if (tooFew != 0)
+		throw std::runtime_error("MPIW::splitIO: every node needs at least 2 processors to set one aside for I/O.");
+
+	std::vector<int> servers(m_worldSize);
+	MPI_Allgather(&server, 1, MPI_INT, servers.data(), 1, MPI_INT, MPI_COMM_WORLD);
+	m_ioServer = server;
+	if (isIOServer())
+		m_nIOClients = (int)std::count(servers.begin(), servers.end(), m_worldRank) - 1;
+	int nservers = isIOServer() ? 1 : 0;
+	MPI_Allreduce(MPI_IN_PLACE, &nservers, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+	m_nCompute = m_worldSize - nservers;
+
+	MPI_Comm_split(MPI_COMM_WORLD, isIOServer() ? 1 : 0, m_worldRank, &m_handles->comm);
+	MPI_Comm_rank(m_handles->comm, &rank);
+	MPI_Comm_size(m_handles->comm, &nproc);
+	splitNodes();
+}
+
+/**
+ * @brief Whether this processor is an I/O processor (see splitIO).
+ */
+bool MPIW::isIOServer() const {
+	return m_ioServer == m_worldRank;
+}
+
+/**
+ * @brief Whether this processor hands its output to an I/O processor (see splitIO).
+ */
+bool MPIW::hasIOServer() const {
+	return m_ioServer >= 0 && !isIOServer();
+}
+
+/**
+ * @brief Gets the number of compute processors this I/O processor serves.
+ */
+int MPIW::nIOClients() const {
+	return m_nIOClients;
+}
+
+/**
+ * @brief Gets the number of compute processors (all of them unless some are set aside by splitIO).
+ */
+int MPIW::nComputeProcessors() const {
+	return isIOServer() ? m_nCompute : nproc;
+}
+
+/**
+ * @brief Starts sending a message to this processor's I/O processor and returns at once. The message is kept until the
+ * send completes, which is checked by the next postIO and waited for by waitIO.
+ * @param message Message, taken over by the call.
+ */
+void MPIW::postIO(std::vector<char>&& message) {
+	ScopedTimer timer(ProfileID::MPI_WRITE);
+	for (std::size_t i = 0; i < m_handles->ioRequests.size();) {
+		int done = 0;
+		MPI_Test(&m_handles->ioRequests[i], &done, MPI_STATUS_IGNORE);
+		if (done != 0) {
+			m_handles->ioRequests.erase(m_handles->ioRequests.begin() + i);
+			m_handles->ioMessages.erase(m_handles->ioMessages.begin() + i);
+		}
+		else
+			++i;
+	}
+	m_handles->ioMessages.push_back(std::move(message));
+	m_handles->ioRequests.push_back(MPI_REQUEST_NULL);
+	std::vector<char>& buffer = m_handles->ioMessages.back();
+	MPI_Isend(buffer.data(), (int)buffer.size(), MPI_BYTE, m_ioServer, (int)SendID::IO_MSG, MPI_COMM_WORLD, &m_handles->ioRequests.back());
+}
+
+/**
+ * @brief Receives the next message from any of the compute processors this I/O processor serves, waiting for one.
+ */
+std::vector<char> MPIW::receiveIO() const {
+	MPI_Status status;
+	MPI_Probe(MPI_ANY_SOURCE, (int)SendID::IO_MSG, MPI_COMM_WORLD, &status);
+	int count = 0;
+	MPI_Get_count(&status, MPI_BYTE, &count);
+	std::vector<char> message(count);
+	MPI_Recv(message.data(), count, MPI_BYTE, status.MPI_SOURCE, (int)SendID::IO_MSG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	return message;
+}
+
+/**
+ * @brief Waits for every message started by postIO to be sent.
+ */
+void MPIW::waitIO() {
+	if (!m_handles->ioRequests.empty())
+		MPI_Waitall((int)m_handles->ioRequests.size(), m_handles->ioRequests.data(), MPI_STATUSES_IGNORE);
+	m_handles->ioRequests.clear();
+	m_handles->ioMessages.clear();
+}
+
+/**
+ * @brief Pairs every processor with the next, the first of each pair integrating the hydrodynamics and the second
+ * tracing the radiation for it. Collective.
+ *
+ * Afterwards the processors of each kind form the group every other method works within, as after splitGroups, with
+ * the partners at the same rank of their groups so that both decompose the Grid alike. The partners pass their states
+ * to each other with postPartner and receivePartner. Neighbouring ranks are usually placed on the same node, where the
+ * states are copied through shared memory. May only be called once, instead of splitGroups or splitIO, before any
+ * simulation is set up.
+ * @exception std::runtime_error Thrown if the processors are already split or cannot be paired.
+ */
+void MPIW::splitRadiation() {
+	if (m_handles->comm != MPI_COMM_WORLD)
+		throw std::runtime_error("MPIW::splitRadiation: the processors are already split into groups or I/O processors.");
+	if (m_worldSize%2 != 0)
+		throw std::runtime_error("MPIW::splitRadiation: radiation_processors needs an even number of processors(="
+				+ std::to_string(m_worldSize) + "), half of them tracing the radiation.");
+	m_isRadiationServer = (m_worldRank%2 == 1);
+	m_partner = m_isRadiationServer ? m_worldRank - 1 : m_worldRank + 1;
+	MPI_Comm_split(MPI_COMM_WORLD, m_isRadiationServer ? 1 : 0, m_worldRank, &m_handles->comm);
+	MPI_Comm_rank(m_handles->comm, &rank);
+	MPI_Comm_size(m_handles->comm, &nproc);
+	splitNodes();
+}
+
+/**
+ * @brief Whether this processor traces the radiation for its partner (see splitRadiation).
+ */
+bool MPIW::isRadiationServer() const {
+	return m_isRadiationServer;
+}
+
+/**
+ * @brief Whether this processor has its radiation traced by its partner (see splitRadiation).
+ */
+bool MPIW::hasRadiationServer() const {
+	return m_partner >= 0 && !m_isRadiationServer;
+}
+
+/**
+ * @brief Starts sending a message to this processor's partner and returns at once. The message is kept until the send
+ * completes, which is checked by the next postPartner and waited for by waitPartner.
+ * @param message Message, taken over by the call.
+ */
+void MPIW::postPartner(std::vector<double>&& message) {
+	for (std::size_t i = 0; i < m_handles->partnerRequests.size();) {
+		int done = 0;
+		MPI_Test(&m_handles->partnerRequests[i], &done, MPI_STATUS_IGNORE);
+		if (done != 0) {
+			m_handles->partnerRequests.erase(m_handles->partnerRequests.begin() + i);
+			m_handles->partnerMessages.erase(m_handles->partnerMessages.begin() + i);
+		}
+		else
+			++i;
+	}
+	m_handles->partnerMessages.push_back(std::move(message));
+	m_handles->partnerRequests.push_back(MPI_REQUEST_NULL);
+	std::vector<double>& buffer = m_handles->partnerMessages.back();
+	MPI_Isend(buffer.data(), (int)buffer.size(), MPI_DOUBLE, m_partner, (int)SendID::PARTNER_MSG, MPI_COMM_WORLD,
+			&m_handles->partnerRequests.back());
+}
+
+/**
+ * @brief Receives the next message from this processor's partner, waiting for it.
+ */
+std::vector<double> MPIW::receivePartner() const {
+	ScopedTimer timer(ProfileID::MPI_PARTNER);
+	MPI_Status status;
+	MPI_Probe(m_partner, (int)SendID::PARTNER_MSG, MPI_COMM_WORLD, &status);
+	int count = 0;
+	MPI_Get_count(&status, MPI_DOUBLE, &count);
+	std::vector<double> message(count);
+	MPI_Recv(message.data(), count, MPI_DOUBLE, m_partner, (int)SendID::PARTNER_MSG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	return message;
+}
+
+/**
+ * @brief Waits for every message started by postPartner to be sent.
+ */
+void MPIW::waitPartner() {
+	if (!m_handles->partnerRequests.empty())
+		MPI_Waitall((int)m_handles->partnerRequests.size(), m_handles->partnerRequests.data(), MPI_STATUSES_IGNORE);
+	m_handles->partnerRequests.clear();
+	m_handles->partnerMessages.clear();
+}
+
+/**
+ * @brief Collectively writes a file made of the parts of every compute processor in compute rank order, each part
+ * handed to this processor by its compute processor. Called by the I/O processors (see splitIO), each with the parts
+ * of the processors it serves; the parts of consecutive ranks are written together. Any existing file is overwritten.
+ * @param filename Name of the file.
+ * @param ranks Compute rank of each part.
+ * @param parts Parts, in ascending order of rank.
+ */
+void MPIW::writeParts(const std::string& filename, const std::vector<int>& ranks, const std::vector<std::vector<char>>& parts) const {
+	ScopedTimer timer(ProfileID::MPI_WRITE);
+	std::vector<long long> sizes(nComputeProcessors() + 1, 0);
+	for (std::size_t i = 0; i < parts.size(); ++i)
+		sizes[ranks[i] + 1] = (long long)parts[i].size();
+	MPI_Allreduce(MPI_IN_PLACE, sizes.data(), (int)sizes.size(), MPI_LONG_LONG, MPI_SUM, m_handles->comm);
+	for (std::size_t i = 1; i < sizes.size(); ++i)
+		sizes[i] += sizes[i - 1];
+
+	MPI_File thefile;
+	if (MPI_File_open(m_handles->comm, (char*)filename.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &thefile) != MPI_SUCCESS)
+		throw std::runtime_error("MPIW::writeParts: unable to open " + filename + ".");
+	MPI_File_set_size(thefile, 0);
+	for (std::size_t first = 0; first < parts.size();) {
+		std::size_t last = first + 1;
+		while (last < parts.size() && ranks[last] == ranks[last - 1] + 1)
+			++last;
+		std::vector<char> run;
+		for (std::size_t i = first; i < last; ++i)
+			run.insert(run.end(), parts[i].begin(), parts[i].end());
+		MPI_File_write_at(thefile, (MPI_Offset)sizes[ranks[first]], run.data(), (int)run.size(), MPI_BYTE, MPI_STATUS_IGNORE);
+		first = last;
+	}
+	MPI_File_close(&thefile);
+}
+
+/**
+ * @brief Takes the next task from the queue shared by the groups. Collective over the group.
+ *
+ * The root processor of the group atomically increments a counter held by the first processor, so a group that
+ * finishes early carries on with the next task while the others are still busy. Without groups the tasks are simply
+ * counted.
+ * @return Index of the task, counting from 0 over all groups.
+ */
+int MPIW::nextTask() {
+	int task = 0;
+	if (m_handles->tasks == MPI_WIN_NULL)
+		task = m_tasksTaken++;
+	else {
+		if (rank == 0) {
+			const int one = 1;
+			MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, m_handles->tasks);
+			MPI_Fetch_and_op(&one, &task, MPI_INT, 0, 0, MPI_SUM, m_handles->tasks);
+			MPI_Win_unlock(0, m_handles->tasks);
+		}
+		ScopedTimer timer(ProfileID::MPI_BROADCAST);
+		MPI_Bcast(&task, 1, MPI_INT, 0, m_handles->comm);
+	}
+	return task;
+}
+
+/**
+ * @brief Gets the index of this processor's group (0 unless the processors were split by splitGroups).
+ */
+int MPIW::groupIndex() const {
+	return m_group;
+}
+
+/**
+ * @brief Gets the number of groups the processors are split into.
+ */
+int MPIW::nGroups() const {
+	return m_nGroups;
+}
+
+/**
+ * @brief Gets the rank of the processor in MPI_COMM_WORLD.
+ */
+int MPIW::worldRank() const {
+	return m_worldRank;
+}
+
+/**
+ * @brief Gets the number of processors in MPI_COMM_WORLD.
+ */
+int MPIW::nWorldProcessors() const {
+	return m_worldSize;
+}
+
+/**
+ * @brief Gets the Fortran handle (MPI_Comm_c2f) of the group's communicator, for libraries that take an MPI_Comm.
+ */
+int MPIW::communicator() const {
+	return (int)MPI_Comm_c2f(m_handles->comm);
 }
 
 /**
@@ -58,6 +527,98 @@ std::string MPIW::cname() const {
 	return os.str();
 }
 
+/**
+ * @brief Arranges the processors in a 3D Cartesian topology.
+ *
+ * Ranks are not reordered, so a processor has the same rank in the topology as in its group and all other messages
+ * can still be passed through the group's communicator.
+ * @param dims Number of processors along each dimension, zero to let MPI choose. Filled in on return.
+ * @param periodic Whether the processors wrap around along each dimension.
+ */
+void MPIW::createCartesian(std::array<int, 3>& dims, const std::array<bool, 3>& periodic) {
+	int fixed = 1;
+	for (int dim : dims) {
+		if (dim < 0)
+			throw std::runtime_error("MPIW::createCartesian: negative number of processors along a dimension.");
+		fixed *= (dim > 0) ? dim : 1;
+	}
+	if (nproc%fixed != 0)
+		throw std::runtime_error("MPIW::createCartesian: " + std::to_string(nproc) + " processors cannot be split into the requested decomposition.");
+	MPI_Dims_create(nproc, 3, dims.data());
+
+	int periods[3];
+	for (int i = 0; i < 3; ++i)
+		periods[i] = periodic[i] ? 1 : 0;
+	if (m_handles->cartesian != MPI_COMM_NULL)
+		MPI_Comm_free(&m_handles->cartesian);
+	MPI_Cart_create(m_handles->comm, 3, dims.data(), periods, 0, &m_handles->cartesian);
+	MPI_Cart_coords(m_handles->cartesian, rank, 3, m_coords.data());
+	m_dims = dims;
+}
+
+/**
+ * @brief Whether the OpenMP threads may run while the main thread makes MPI calls (MPI_THREAD_FUNNELED or better).
+ */
+bool MPIW::threadsFunneled() const {
+	return m_threadsFunneled;
+}
+
+/**
+ * @brief Gets the rank of this process among the processes that share its node's memory.
+ */
+int MPIW::nodeRank() const {
+	return m_nodeRank;
+}
+
+/**
+ * @brief Gets the number of processes that share this node's memory.
+ */
+int MPIW::nodeSize() const {
+	return m_nodeSize;
+}
+
+/**
+ * @brief Gets the rank in the group of the first process on this node.
+ */
+int MPIW::nodeLeader() const {
+	return m_nodeLeader;
+}
+
+/**
+ * @brief Gets the number of shared memory nodes the program runs on.
+ */
+int MPIW::nNodes() const {
+	return m_nNodes;
+}
+
+/**
+ * @brief Gets the number of processors along each dimension of the Cartesian topology.
+ */
+const std::array<int, 3>& MPIW::getDims() const {
+	return m_dims;
+}
+
+/**
+ * @brief Gets the coordinates of this processor in the Cartesian topology.
+ */
+const std::array<int, 3>& MPIW::getCoords() const {
+	return m_coords;
+}
+
+/**
+ * @brief Gets the rank of a neighbouring processor in the Cartesian topology.
+ * @param dim Dimension to look along.
+ * @param displacement Number of processors to step along dim (negative steps to the left).
+ * @return Rank of the neighbour, or -1 if there is none.
+ */
+int MPIW::neighbour(int dim, int displacement) const {
+	if (m_handles->cartesian == MPI_COMM_NULL)
+		throw std::runtime_error("MPIW::neighbour: Cartesian topology has not been created.");
+	int source, destination;
+	MPI_Cart_shift(m_handles->cartesian, dim, displacement, &source, &destination);
+	return destination == MPI_PROC_NULL ? -1 : destination;
+}
+
 /**
  * @brief Sends packet to another processor.
  * @param S Message to send.
@@ -66,29 +627,405 @@ std::string MPIW::cname() const {
  * @param tag Message identification tag.
  */
 void MPIW::send(double* S, int count, int destination, SendID tag) const {
-	MPI_Send((void*)S, count, MPI_DOUBLE, destination, (int)tag, MPI_COMM_WORLD);
+	MPI_Send((void*)S, count, MPI_DOUBLE, destination, (int)tag, m_handles->comm);
 }
 void MPIW::send(int* S, int count, int destination, SendID tag) const {
-	MPI_Send(S, count, MPI_INT, destination, (int)tag, MPI_COMM_WORLD);
+	MPI_Send(S, count, MPI_INT, destination, (int)tag, m_handles->comm);
 }
-void MPIW::receive(double* R, int count, int source, SendID tag) const {
+/**
+ * @brief Receives a packet of at most count doubles from another processor.
+ * @param channel Message sub-tag (see postSend).
+ * @return Number of doubles received.
+ */
+int MPIW::receive(double* R, int count, int source, SendID tag, int channel) const {
 	MPI_Status status;
-	MPI_Recv((void*)R, count, MPI_DOUBLE, source, (int)tag, MPI_COMM_WORLD, &status);
+	MPI_Recv((void*)R, count, MPI_DOUBLE, source, messageTag(tag, channel), m_handles->comm, &status);
+	int received = 0;
+	MPI_Get_count(&status, MPI_DOUBLE, &received);
+	return received;
 }
 void MPIW::receive(int* R, int count, int source, SendID tag) const {
 	MPI_Status status;
-	MPI_Recv(R, count, MPI_INT, source, (int)tag, MPI_COMM_WORLD, &status);
+	MPI_Recv(R, count, MPI_INT, source, (int)tag, m_handles->comm, &status);
+}
+
+/**
+ * @brief Starts a non-blocking send, which completes in the next call to waitAll.
+ *
+ * The buffer must not be touched until then. Messages between the same pair of processors with the same tag are
+ * told apart by their channel (e.g. the face of the Grid the data is destined for).
+ * @param S Message to send.
+ * @param count Number of data.
+ * @param destination Rank of receiving processor.
+ * @param tag Message identification tag.
+ * @param channel Message sub-tag.
+ */
+void MPIW::postSend(double* S, int count, int destination, SendID tag, int channel) {
+	m_handles->requests.push_back(MPI_REQUEST_NULL);
+	MPI_Isend((void*)S, count, MPI_DOUBLE, destination, messageTag(tag, channel), m_handles->comm, &m_handles->requests.back());
+}
+void MPIW::postSend(int* S, int count, int destination, SendID tag, int channel) {
+	m_handles->requests.push_back(MPI_REQUEST_NULL);
+	MPI_Isend(S, count, MPI_INT, destination, messageTag(tag, channel), m_handles->comm, &m_handles->requests.back());
+}
+
+/**
+ * @brief Starts a non-blocking receive, the data is in R after the next call to waitAll.
+ * @see postSend
+ */
+void MPIW::postReceive(double* R, int count, int source, SendID tag, int channel) {
+	m_handles->requests.push_back(MPI_REQUEST_NULL);
+	MPI_Irecv((void*)R, count, MPI_DOUBLE, source, messageTag(tag, channel), m_handles->comm, &m_handles->requests.back());
+}
+
+/**
+ * @brief Waits for every send and receive started with postSend, postReceive and start to complete.
+ */
+void MPIW::waitAll() {
+	// Waiting on a copy of a persistent request leaves the request itself allocated for the next start.
+	for (int request : m_handles->started)
+		m_handles->requests.push_back(m_handles->persistent[request]);
+	if (!m_handles->requests.empty())
+		MPI_Waitall((int)m_handles->requests.size(), m_handles->requests.data(), MPI_STATUSES_IGNORE);
+	m_handles->requests.clear();
+	m_handles->started.clear();
 }
 
-void MPIW::exchange(double* send_buffer, double* receive_buffer, int count, int destination, SendID tag) const {
-	if (rank%2 == 0 || (nproc == 2 && tag == SendID::PERIODIC_MSG && rank == 1)) {
-		send(send_buffer, count, destination, tag);
-		receive(receive_buffer, count, destination, tag);
+/**
+ * @brief Sets how often progress calls into MPI.
+ * @param seconds Time between the calls, 0 for never.
+ * @exception std::runtime_error Thrown if seconds is negative.
+ */
+void MPIW::setProgressInterval(double seconds) {
+	if (seconds < 0)
+		throw std::runtime_error("MPIW::setProgressInterval: interval(=" + std::to_string(seconds) + ") must not be negative.");
+	m_progressInterval = seconds;
+	m_lastProgress = 0;
+}
+
+/**
+ * @brief Tests the sends, receives and exchanges started with postSend, postReceive, start and startNeighbourExchange,
+ * if the interval set by setProgressInterval has passed since it last did, so the MPI library moves them on while the
+ * processor computes. Main thread only.
+ *
+ * Many MPI libraries only progress messages inside calls into the library, so a rendezvous send or a neighbourhood
+ * collective started before a long loop would otherwise not move until the waitAll after it, and nothing overlaps. The
+ * loops that overlap with communication call this between their tiles or pencils. The requests are left for waitAll,
+ * which returns at once for any that have completed. With no requests outstanding but a one-sided relay open, an
+ * MPI_Iprobe lets the library serve the puts of the other processors.
+ */
+void MPIW::progress() {
+	if (m_progressInterval <= 0)
+		return;
+	const double now = MPI_Wtime();
+	if (now - m_lastProgress < m_progressInterval)
+		return;
+	m_lastProgress = now;
+
+	int flag = 0;
+	if (!m_handles->requests.empty())
+		MPI_Testall((int)m_handles->requests.size(), m_handles->requests.data(), &flag, MPI_STATUSES_IGNORE);
+	if (!m_handles->started.empty()) {
+		// As in waitAll, a copy of a persistent request is tested, which leaves the request itself allocated.
+		std::vector<MPI_Request> started;
+		started.reserve(m_handles->started.size());
+		for (int request : m_handles->started)
+			started.push_back(m_handles->persistent[request]);
+		MPI_Testall((int)started.size(), started.data(), &flag, MPI_STATUSES_IGNORE);
 	}
-	else {
-		receive(receive_buffer, count, destination, tag);
-		send(send_buffer, count, destination, tag);
+	else if (m_handles->requests.empty() && hasRelay())
+		MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, m_handles->comm, &flag, MPI_STATUS_IGNORE);
+}
+
+/**
+ * @brief Creates a datatype describing the same fields of a list of cells stored in one array, so that they can be sent
+ * and received without being copied into a buffer.
+ * @param cellSize Size of one cell in bytes.
+ * @param fieldOffsets Offset in bytes of each block of doubles from the start of a cell.
+ * @param fieldLengths Number of doubles in each block.
+ * @param cellIDs Indices of the cells in the array, in message order.
+ * @return Handle of the datatype.
+ */
+int MPIW::createCellType(std::size_t cellSize, const std::vector<std::ptrdiff_t>& fieldOffsets, const std::vector<int>& fieldLengths, const std::vector<int>& cellIDs) {
+	if (fieldOffsets.size() != fieldLengths.size())
+		throw std::runtime_error("MPIW::createCellType: number of field offsets and lengths differ.");
+	std::vector<MPI_Aint> displacements(fieldOffsets.begin(), fieldOffsets.end());
+	std::vector<MPI_Datatype> fieldTypes(fieldOffsets.size(), MPI_DOUBLE);
+	std::vector<int> lengths(fieldLengths);
+	std::vector<int> ids(cellIDs);
+
+	MPI_Datatype fields, cell, cells;
+	MPI_Type_create_struct((int)lengths.size(), lengths.data(), displacements.data(), fieldTypes.data(), &fields);
+	MPI_Type_create_resized(fields, 0, (MPI_Aint)cellSize, &cell);
+	MPI_Type_create_indexed_block((int)ids.size(), 1, ids.data(), cell, &cells);
+	MPI_Type_commit(&cells);
+	MPI_Type_free(&cell);
+	MPI_Type_free(&fields);
+
+	m_handles->types.push_back(cells);
+	return (int)m_handles->types.size() - 1;
+}
+
+/**
+ * @brief Sets up a send that can be started repeatedly with start, without being re-posted each time.
+ *
+ * The buffer and count are fixed for the lifetime of the request.
+ * @return Handle of the request.
+ * @see postSend
+ */
+int MPIW::createPersistentSend(double* S, int count, int destination, SendID tag, int channel) {
+	m_handles->persistent.push_back(MPI_REQUEST_NULL);
+	MPI_Send_init((void*)S, count, MPI_DOUBLE, destination, messageTag(tag, channel), m_handles->comm, &m_handles->persistent.back());
+	return (int)m_handles->persistent.size() - 1;
+}
+
+/**
+ * @brief Sets up a persistent send of one item of a datatype made by createCellType.
+ * @param S Start of the array the datatype indexes into.
+ * @param datatype Handle of the datatype.
+ */
+int MPIW::createPersistentSend(void* S, int datatype, int destination, SendID tag, int channel) {
+	m_handles->persistent.push_back(MPI_REQUEST_NULL);
+	MPI_Send_init(S, 1, m_handles->types[datatype], destination, messageTag(tag, channel), m_handles->comm, &m_handles->persistent.back());
+	return (int)m_handles->persistent.size() - 1;
+}
+
+/**
+ * @brief Sets up a receive that can be started repeatedly with start.
+ * @see createPersistentSend
+ */
+int MPIW::createPersistentReceive(double* R, int count, int source, SendID tag, int channel) {
+	m_handles->persistent.push_back(MPI_REQUEST_NULL);
+	MPI_Recv_init((void*)R, count, MPI_DOUBLE, source, messageTag(tag, channel), m_handles->comm, &m_handles->persistent.back());
+	return (int)m_handles->persistent.size() - 1;
+}
+
+int MPIW::createPersistentReceive(void* R, int datatype, int source, SendID tag, int channel) {
+	m_handles->persistent.push_back(MPI_REQUEST_NULL);
+	MPI_Recv_init(R, 1, m_handles->types[datatype], source, messageTag(tag, channel), m_handles->comm, &m_handles->persistent.back());
+	return (int)m_handles->persistent.size() - 1;
+}
+
+/**
+ * @brief Starts a persistent request, which completes in the next call to waitAll.
+ * @param request Handle of the request.
+ */
+void MPIW::start(int request) {
+	MPI_Start(&m_handles->persistent[request]);
+	m_handles->started.push_back(request);
+}
+
+/**
+ * @brief Creates the distributed graph of this processor and its neighbours, which a neighbourhood exchange is made
+ * over. Collective.
+ *
+ * The neighbours are both the sources and the destinations of the graph, in the given order, and the graph may be
+ * reordered by neither MPI nor its ranks.
+ */
+static MPI_Comm createNeighbourGraph(MPI_Comm comm, const std::vector<int>& neighbours) {
+	std::vector<int> ranks(neighbours);
+	MPI_Comm graph;
+	MPI_Dist_graph_create_adjacent(comm, (int)ranks.size(), ranks.data(), MPI_UNWEIGHTED, (int)ranks.size(), ranks.data(),
+			MPI_UNWEIGHTED, MPI_INFO_NULL, 0, &graph);
+	return graph;
+}
+
+/**
+ * @brief Sets up an exchange of one item of a datatype made by createCellType with each neighbouring processor, as a
+ * single neighbourhood collective that can be started repeatedly with startNeighbourExchange. Collective.
+ *
+ * Every processor must set up its neighbourhood exchanges in the same order, including those with no neighbours.
+ * @param neighbours Ranks of the neighbouring processors, each listed once.
+ * @param base Start of the array the datatypes index into.
+ * @param sendTypes Handle of the datatype sent to each neighbour.
+ * @param recvTypes Handle of the datatype received from each neighbour.
+ * @return Handle of the exchange.
+ */
+int MPIW::createNeighbourExchange(const std::vector<int>& neighbours, void* base, const std::vector<int>& sendTypes,
+		const std::vector<int>& recvTypes) {
+	if (sendTypes.size() != neighbours.size() || recvTypes.size() != neighbours.size())
+		throw std::runtime_error("MPIW::createNeighbourExchange: need one send and one receive datatype per neighbour.");
+	NeighbourExchange exchange;
+	exchange.graph = createNeighbourGraph(m_handles->comm, neighbours);
+	exchange.useTypes = true;
+	exchange.send = base;
+	exchange.recv = base;
+	exchange.sendCounts.assign(neighbours.size(), 1);
+	exchange.recvCounts.assign(neighbours.size(), 1);
+	exchange.byteDispls.assign(neighbours.size(), 0);
+	for (unsigned int i = 0; i < neighbours.size(); ++i) {
+		exchange.sendTypes.push_back(m_handles->types[sendTypes[i]]);
+		exchange.recvTypes.push_back(m_handles->types[recvTypes[i]]);
+	}
+	m_handles->neighbourExchanges.push_back(std::move(exchange));
+	return (int)m_handles->neighbourExchanges.size() - 1;
+}
+
+/**
+ * @brief Sets up an exchange of a block of doubles with each neighbouring processor, as a single neighbourhood
+ * collective that can be started repeatedly with startNeighbourExchange. Collective.
+ *
+ * The blocks are consecutive in the send and receive buffers, in the order of the neighbours. Every processor must set
+ * up its neighbourhood exchanges in the same order, including those with no neighbours.
+ * @param neighbours Ranks of the neighbouring processors, each listed once.
+ * @param S Send buffer, which must outlive the exchange.
+ * @param sendCounts Number of doubles sent to each neighbour.
+ * @param R Receive buffer, which must outlive the exchange.
+ * @param recvCounts Number of doubles received from each neighbour.
+ * @return Handle of the exchange.
+ */
+int MPIW::createNeighbourExchange(const std::vector<int>& neighbours, double* S, const std::vector<int>& sendCounts,
+		double* R, const std::vector<int>& recvCounts) {
+	if (sendCounts.size() != neighbours.size() || recvCounts.size() != neighbours.size())
+		throw std::runtime_error("MPIW::createNeighbourExchange: need one send and one receive count per neighbour.");
+	NeighbourExchange exchange;
+	exchange.graph = createNeighbourGraph(m_handles->comm, neighbours);
+	exchange.send = S;
+	exchange.recv = R;
+	exchange.sendCounts = sendCounts;
+	exchange.recvCounts = recvCounts;
+	for (unsigned int i = 0, sendTotal = 0, recvTotal = 0; i < neighbours.size(); ++i) {
+		exchange.sendDispls.push_back(sendTotal);
+		exchange.recvDispls.push_back(recvTotal);
+		sendTotal += sendCounts[i];
+		recvTotal += recvCounts[i];
+	}
+	m_handles->neighbourExchanges.push_back(std::move(exchange));
+	return (int)m_handles->neighbourExchanges.size() - 1;
+}
+
+/**
+ * @brief Starts a neighbourhood exchange, which completes in the next waitAll. Collective.
+ *
+ * Every processor must start its neighbourhood exchanges in the same order.
+ * @param exchange Handle of the exchange.
+ */
+void MPIW::startNeighbourExchange(int exchange) {
+	NeighbourExchange& e = m_handles->neighbourExchanges[exchange];
+	m_handles->requests.push_back(MPI_REQUEST_NULL);
+	if (e.useTypes)
+		MPI_Ineighbor_alltoallw(e.send, e.sendCounts.data(), e.byteDispls.data(), e.sendTypes.data(),
+				e.recv, e.recvCounts.data(), e.byteDispls.data(), e.recvTypes.data(), e.graph, &m_handles->requests.back());
+	else
+		MPI_Ineighbor_alltoallv(e.send, e.sendCounts.data(), e.sendDispls.data(), MPI_DOUBLE,
+				e.recv, e.recvCounts.data(), e.recvDispls.data(), MPI_DOUBLE, e.graph, &m_handles->requests.back());
+}
+
+/**
+ * @brief Sets up the windows of the one-sided relay, which passes data between processors by putting it straight into
+ * the memory of the receiving processor and then raising a signal there, with no matching receive. Collective.
+ *
+ * Every processor exposes dataCount doubles to receive data in and signalCount signal slots, all zero to begin with.
+ * The windows stay open to every processor (a passive target epoch) until freeRelay.
+ * @param dataCount Number of doubles of the receive regions.
+ * @param signalCount Number of signal slots.
+ * @exception std::runtime_error Thrown if the relay is already set up.
+ */
+void MPIW::createRelay(long long dataCount, long long signalCount) {
+	if (hasRelay())
+		throw std::runtime_error("MPIW::createRelay: the relay is already set up.");
+	MPI_Win_allocate((MPI_Aint)(dataCount*sizeof(double)), sizeof(double), MPI_INFO_NULL, m_handles->comm,
+			&m_handles->relayBase, &m_handles->relayData);
+	MPI_Win_allocate((MPI_Aint)(signalCount*sizeof(long long)), sizeof(long long), MPI_INFO_NULL, m_handles->comm,
+			&m_handles->signalBase, &m_handles->relaySignals);
+	std::fill(m_handles->relayBase, m_handles->relayBase + dataCount, 0.0);
+	std::fill(m_handles->signalBase, m_handles->signalBase + signalCount, 0LL);
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, m_handles->relayData);
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, m_handles->relaySignals);
+	// No processor may raise a signal before every processor has cleared its slots.
+	MPI_Barrier(m_handles->comm);
+}
+
+/**
+ * @brief Whether the one-sided relay is set up (see createRelay).
+ */
+bool MPIW::hasRelay() const {
+	return m_handles->relayData != MPI_WIN_NULL;
+}
+
+/**
+ * @brief Gets this processor's receive regions of the one-sided relay, which hold the data put by the other processors
+ * once relayWait has seen their signals.
+ */
+const double* MPIW::relayBuffer() const {
+	return m_handles->relayBase;
+}
+
+/**
+ * @brief Starts putting data into the receive regions of another processor. The data arrives by the time the next
+ * relaySignal to the same processor returns, so the buffer may be reused after that.
+ * @param data Data to put.
+ * @param count Number of doubles.
+ * @param target Rank of the receiving processor.
+ * @param offset Offset in the target's receive regions, in doubles.
+ */
+void MPIW::relayPut(const double* data, int count, int target, long long offset) {
+	if (count > 0)
+		MPI_Put(data, count, MPI_DOUBLE, target, (MPI_Aint)offset, count, MPI_DOUBLE, m_handles->relayData);
+}
+
+/**
+ * @brief Raises a signal slot of another processor to value, once every relayPut to it has arrived.
+ * @param value New value of the slot, which must not be less than its last one.
+ * @param target Rank of the processor.
+ * @param offset Index of the slot.
+ */
+void MPIW::relaySignal(long long value, int target, long long offset) {
+	MPI_Win_flush(target, m_handles->relayData);
+	MPI_Accumulate(&value, 1, MPI_LONG_LONG, target, (MPI_Aint)offset, 1, MPI_LONG_LONG, MPI_REPLACE, m_handles->relaySignals);
+	MPI_Win_flush(target, m_handles->relaySignals);
+}
+
+/**
+ * @brief Waits until one of this processor's signal slots reaches a value.
+ * @param offset Index of the slot.
+ * @param value Value to wait for.
+ * @return Value of the slot, which the data put before it was raised can be read at.
+ */
+long long MPIW::relayWait(long long offset, long long value) {
+	long long current = 0;
+	for (;;) {
+		MPI_Fetch_and_op(nullptr, &current, MPI_LONG_LONG, rank, (MPI_Aint)offset, MPI_NO_OP, m_handles->relaySignals);
+		MPI_Win_flush(rank, m_handles->relaySignals);
+		if (current >= value)
+			break;
 	}
+	// Make the data put by the other processor visible to this one's loads.
+	MPI_Win_sync(m_handles->relayData);
+	return current;
+}
+
+/**
+ * @brief Closes the windows of the one-sided relay, if it is set up. Collective.
+ */
+void MPIW::freeRelay() {
+	if (!hasRelay())
+		return;
+	MPI_Win_unlock_all(m_handles->relayData);
+	MPI_Win_unlock_all(m_handles->relaySignals);
+	MPI_Win_free(&m_handles->relayData);
+	MPI_Win_free(&m_handles->relaySignals);
+	m_handles->relayBase = nullptr;
+	m_handles->signalBase = nullptr;
+}
+
+/**
+ * @brief Frees every persistent request and derived datatype, e.g. before the Grid that set them up is rebuilt. None of
+ * the requests may be active, i.e. every start must have been waited for.
+ */
+void MPIW::freePersistent() {
+	if (!m_handles->started.empty())
+		throw std::runtime_error("MPIW::freePersistent: persistent requests still active.");
+	freeRelay();
+	for (MPI_Request& request : m_handles->persistent)
+		MPI_Request_free(&request);
+	for (NeighbourExchange& exchange : m_handles->neighbourExchanges)
+		MPI_Comm_free(&exchange.graph);
+	for (MPI_Datatype& type : m_handles->types)
+		MPI_Type_free(&type);
+	m_handles->persistent.clear();
+	m_handles->neighbourExchanges.clear();
+	m_handles->types.clear();
 }
 
 void MPIW::write(char* filename, void* inputbuffer, int ncols, int nrows, int buffsize, BuffType btype) const {
@@ -107,7 +1044,7 @@ void MPIW::write(char* filename, void* inputbuffer, int ncols, int nrows, int bu
 		typesize = sizeof(double);
 	}
 	MPI_File thefile;
-	MPI_File_open(MPI_COMM_WORLD, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &thefile);
+	MPI_File_open(m_handles->comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &thefile);
 	std::string datarep = "native";
 	if (rank == 0) {
 		MPI_File_set_view(thefile, 0, MPI_INT, MPI_INT, (char*)datarep.c_str(), MPI_INFO_NULL);
@@ -121,56 +1058,573 @@ void MPIW::write(char* filename, void* inputbuffer, int ncols, int nrows, int bu
 	MPI_File_close(&thefile);
 }
 
+/**
+ * @brief Collectively writes the root processor's header followed by every processor's block in rank order, starting at
+ * byte start of a file, which is first emptied if truncate is set.
+ * @return Total number of bytes written.
+ */
+static long long writeBlocks(MPI_Comm comm, const std::string& filename, int rank, const std::vector<char>& header, const void* data, int count,
+		MPI_Datatype type, int typeSize, MPI_Offset start = 0, bool truncate = true) {
+	long long localCount = count;
+	long long precedingCount = 0, totalCount = 0;
+	MPI_Exscan(&localCount, &precedingCount, 1, MPI_LONG_LONG, MPI_SUM, comm);
+	MPI_Allreduce(&localCount, &totalCount, 1, MPI_LONG_LONG, MPI_SUM, comm);
+	if (rank == 0)
+		precedingCount = 0;
+
+	MPI_File thefile;
+	if (MPI_File_open(comm, (char*)filename.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &thefile) != MPI_SUCCESS)
+		throw std::runtime_error("MPIW::writeOrdered: unable to open " + filename + ".");
+	if (truncate)
+		MPI_File_set_size(thefile, 0);
+	if (rank == 0 && !header.empty())
+		MPI_File_write_at(thefile, start, (void*)header.data(), (int)header.size(), MPI_BYTE, MPI_STATUS_IGNORE);
+	MPI_Offset offset = start + (MPI_Offset)header.size() + precedingCount*(MPI_Offset)typeSize;
+	MPI_File_write_at_all(thefile, offset, (void*)data, count, type, MPI_STATUS_IGNORE);
+	MPI_File_close(&thefile);
+	return (long long)header.size() + totalCount*typeSize;
+}
+
+/**
+ * @brief Collectively writes a file made of a header followed by every processor's block of data in rank order.
+ * Only the root processor's header is written, the other processors' blocks start at header.size() plus the total
+ * size of the blocks of the lower ranks. Any existing file is overwritten.
+ * @param filename Name of the file.
+ * @param header Bytes at the start of the file (only used by the root processor, but must be the same size on all).
+ * @param data This processor's block.
+ * @param count Number of doubles in this processor's block.
+ */
+void MPIW::writeOrdered(const std::string& filename, const std::vector<char>& header, const double* data, int count) const {
+	ScopedTimer timer(ProfileID::MPI_WRITE);
+	writeBlocks(m_handles->comm, filename, rank, header, data, count, MPI_DOUBLE, sizeof(double));
+}
+
+/**
+ * @brief Collectively writes a file made of a header followed by every processor's block of bytes in rank order.
+ * @see MPIW::writeOrdered(const std::string&, const std::vector<char>&, const double*, int) const
+ * @param filename Name of the file.
+ * @param header Bytes at the start of the file (only used by the root processor, but must be the same size on all).
+ * @param data This processor's block.
+ * @param count Number of bytes in this processor's block.
+ */
+void MPIW::writeOrdered(const std::string& filename, const std::vector<char>& header, const char* data, int count) const {
+	ScopedTimer timer(ProfileID::MPI_WRITE);
+	writeBlocks(m_handles->comm, filename, rank, header, data, count, MPI_BYTE, 1);
+}
+
+/**
+ * @brief Collectively writes a header followed by every processor's block of bytes in rank order into a file from
+ * byte start on, leaving the rest of the file as it is (the file is made if it does not exist).
+ * @see MPIW::writeOrdered(const std::string&, const std::vector<char>&, const char*, int) const
+ * @param filename Name of the file.
+ * @param start Offset in bytes of the header.
+ * @param header Bytes before the blocks (only used by the root processor, but must be the same size on all).
+ * @param data This processor's block.
+ * @param count Number of bytes in this processor's block.
+ * @return Total number of bytes written, the header included.
+ */
+long long MPIW::writeOrderedAt(const std::string& filename, long long start, const std::vector<char>& header, const char* data, int count) const {
+	ScopedTimer timer(ProfileID::MPI_WRITE);
+	return writeBlocks(m_handles->comm, filename, rank, header, data, count, MPI_BYTE, 1, (MPI_Offset)start, false);
+}
+
+/**
+ * @brief Writes a file made of a header followed by the cells of a grid in x-fastest order, each processor of comm
+ * writing the cells of its own box of the grid. Collective over comm.
+ * @param commRank Rank of this processor in comm, the first of which writes the header.
+ */
+static void writeSubarray(MPI_Comm comm, int commRank, const std::string& filename, const std::vector<char>& header,
+		const char* data, int cellBytes, const std::array<int, 3>& ncells, const std::array<int, 3>& boxCells,
+		const std::array<int, 3>& boxOffset) {
+	// MPI_ORDER_C puts the last dimension fastest, so the dimensions are reversed.
+	int sizes[3], subsizes[3], starts[3];
+	for (int i = 0; i < 3; ++i) {
+		sizes[i] = ncells[2 - i];
+		subsizes[i] = boxCells[2 - i];
+		starts[i] = boxOffset[2 - i];
+	}
+	MPI_Datatype cellType, boxType;
+	MPI_Type_contiguous(cellBytes, MPI_BYTE, &cellType);
+	MPI_Type_commit(&cellType);
+	MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, cellType, &boxType);
+	MPI_Type_commit(&boxType);
+
+	MPI_File thefile;
+	if (MPI_File_open(comm, (char*)filename.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &thefile) != MPI_SUCCESS)
+		throw std::runtime_error("MPIW::writeBox: unable to open " + filename + ".");
+	MPI_File_set_size(thefile, 0);
+	if (commRank == 0 && !header.empty())
+		MPI_File_write_at(thefile, 0, (void*)header.data(), (int)header.size(), MPI_BYTE, MPI_STATUS_IGNORE);
+	MPI_File_set_view(thefile, (MPI_Offset)header.size(), cellType, boxType, (char*)"native", MPI_INFO_NULL);
+	MPI_File_write_all(thefile, (void*)data, boxCells[0]*boxCells[1]*boxCells[2], cellType, MPI_STATUS_IGNORE);
+	MPI_File_close(&thefile);
+	MPI_Type_free(&boxType);
+	MPI_Type_free(&cellType);
+}
+
+/**
+ * @brief Collectively writes a file made of a header followed by the cells of a grid in x-fastest order, each processor
+ * writing the cells of its own box of the grid. Any existing file is overwritten.
+ * @param filename Name of the file.
+ * @param header Bytes at the start of the file (only used by the root processor, but must be the same size on all).
+ * @param data This processor's cells, in x-fastest order within its box.
+ * @param cellBytes Number of bytes per cell.
+ * @param ncells Number of cells of the grid along each dimension.
+ * @param boxCells Number of cells of this processor's box along each dimension.
+ * @param boxOffset Grid coordinates of the corner of this processor's box.
+ */
+void MPIW::writeBox(const std::string& filename, const std::vector<char>& header, const char* data, int cellBytes,
+		const std::array<int, 3>& ncells, const std::array<int, 3>& boxCells, const std::array<int, 3>& boxOffset) const {
+	ScopedTimer timer(ProfileID::MPI_WRITE);
+	writeSubarray(m_handles->comm, rank, filename, header, data, cellBytes, ncells, boxCells, boxOffset);
+}
+
+/**
+ * @brief Writes a file like MPIW::writeBox, but only the processors whose boxes hold cells open it, so a small region of
+ * the grid costs only the processors it overlaps. Collective, though the others return once the writers are chosen.
+ * @param filename Name of the file.
+ * @param header Bytes at the start of the file (only used by the first writer, but must be the same size on all).
+ * @param data This processor's cells, in x-fastest order within its box.
+ * @param cellBytes Number of bytes per cell.
+ * @param ncells Number of cells of the region along each dimension.
+ * @param boxCells Number of cells of this processor's box along each dimension (a zero for none).
+ * @param boxOffset Coordinates of the corner of this processor's box in the region.
+ */
+void MPIW::writeRegion(const std::string& filename, const std::vector<char>& header, const char* data, int cellBytes,
+		const std::array<int, 3>& ncells, const std::array<int, 3>& boxCells, const std::array<int, 3>& boxOffset) const {
+	ScopedTimer timer(ProfileID::MPI_WRITE);
+	const bool hasCells = boxCells[0] > 0 && boxCells[1] > 0 && boxCells[2] > 0;
+	MPI_Comm writers;
+	MPI_Comm_split(m_handles->comm, hasCells ? 0 : MPI_UNDEFINED, rank, &writers);
+	if (writers == MPI_COMM_NULL)
+		return;
+	int writerRank = 0;
+	MPI_Comm_rank(writers, &writerRank);
+	try {
+		writeSubarray(writers, writerRank, filename, header, data, cellBytes, ncells, boxCells, boxOffset);
+	}
+	catch (...) {
+		MPI_Comm_free(&writers);
+		throw;
+	}
+	MPI_Comm_free(&writers);
+}
+
+/**
+ * @brief Collectively reads a whole file into every processor.
+ * @param filename Name of the file.
+ * @return The contents of the file.
+ */
+std::vector<char> MPIW::readAll(const std::string& filename) const {
+	MPI_File thefile;
+	if (MPI_File_open(m_handles->comm, (char*)filename.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &thefile) != MPI_SUCCESS)
+		throw std::runtime_error("MPIW::readAll: unable to open " + filename + ".");
+	MPI_Offset size = 0;
+	MPI_File_get_size(thefile, &size);
+	std::vector<char> contents(size);
+	// MPI counts are ints, so large files are read in pieces.
+	const MPI_Offset chunk = 1 << 30;
+	for (MPI_Offset offset = 0; offset < size; offset += chunk) {
+		int n = (int)std::min(chunk, size - offset);
+		MPI_File_read_at_all(thefile, offset, contents.data() + offset, n, MPI_BYTE, MPI_STATUS_IGNORE);
+	}
+	MPI_File_close(&thefile);
+	return contents;
+}
+
+/**
+ * @brief Reads a small file on one processor and sends its contents to all of them, so that only one processor opens it.
+ * Collective.
+ * @param filename Name of the file.
+ * @param source Processor that reads the file.
+ * @return The contents of the file.
+ */
+std::string MPIW::broadcastFile(const std::string& filename, int source) const {
+	std::string contents;
+	int found = 1;
+	if (rank == source) {
+		std::ifstream file(filename, std::ios::binary);
+		found = (bool)file;
+		if (found)
+			contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	{
+		ScopedTimer timer(ProfileID::MPI_BROADCAST);
+		MPI_Bcast(&found, 1, MPI_INT, source, m_handles->comm);
+	}
+	if (!found)
+		throw std::runtime_error("MPIW::broadcastFile: unable to open " + filename + ".");
+	broadcastString(contents, source);
+	return contents;
+}
+
+/**
+ * @brief Reads size bytes of a file starting at offset onto the end of a buffer, in pieces small enough for the int
+ * counts of MPI. Not collective.
+ */
+static void appendBytes(MPI_File thefile, MPI_Offset offset, MPI_Offset size, std::vector<char>& bytes) {
+	std::size_t start = bytes.size();
+	bytes.resize(start + size);
+	const MPI_Offset chunk = 1 << 30;
+	for (MPI_Offset done = 0; done < size; done += chunk) {
+		int n = (int)std::min(chunk, size - done);
+		MPI_File_read_at(thefile, offset + done, bytes.data() + start + done, n, MPI_BYTE, MPI_STATUS_IGNORE);
+	}
+}
+
+/**
+ * @brief Collectively reads a text file, giving each processor a contiguous block of whole lines.
+ *
+ * The bytes from offset onwards are split evenly between the processors, and each processor takes the lines that start
+ * in its share, so every line is read by exactly one processor and the blocks are in rank order.
+ * @param filename Name of the file.
+ * @param offset Position of the first line to read (e.g. the end of a header).
+ * @return This processor's lines, which is empty if none of them starts in its share.
+ */
+std::vector<char> MPIW::readLines(const std::string& filename, long long offset) const {
+	MPI_File thefile;
+	if (MPI_File_open(m_handles->comm, (char*)filename.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &thefile) != MPI_SUCCESS)
+		throw std::runtime_error("MPIW::readLines: unable to open " + filename + ".");
+	MPI_Offset size = 0;
+	MPI_File_get_size(thefile, &size);
+	MPI_Offset span = std::max((MPI_Offset)0, size - offset);
+	MPI_Offset begin = offset + span*rank/nproc;
+	MPI_Offset end = offset + span*(rank + 1)/nproc;
+
+	std::vector<char> bytes;
+	if (begin < end) {
+		// The byte before the share shows whether a line starts at its first byte.
+		MPI_Offset first = (begin > offset) ? begin - 1 : begin;
+		appendBytes(thefile, first, end - first, bytes);
+		std::size_t start = (begin > offset) ? 1 : 0;
+		while (start > 0 && start < bytes.size() && bytes[start - 1] != '\n')
+			++start;
+
+		// The last line starting in the share ends at the first newline from its last byte on.
+		std::size_t stop = std::max<std::size_t>(start, bytes.size() - 1);
+		MPI_Offset next = end;
+		while (stop < bytes.size() && bytes[stop] != '\n') {
+			++stop;
+			if (stop == bytes.size() && next < size) {
+				MPI_Offset n = std::min((MPI_Offset)(1 << 16), size - next);
+				appendBytes(thefile, next, n, bytes);
+				next += n;
+			}
+		}
+		if (start < (std::size_t)(end - first))
+			bytes = std::vector<char>(bytes.begin() + start, bytes.begin() + std::min(stop + 1, bytes.size()));
+		else
+			bytes.clear();
+	}
+	MPI_File_close(&thefile);
+	return bytes;
+}
+
+/**
+ * @brief Splits a text held by one processor into contiguous blocks of whole lines of roughly equal size, and sends one
+ * block to each processor in rank order.
+ * @param text The text, only used by the source processor.
+ * @param source Rank of the processor holding the text.
+ * @return This processor's block.
+ */
+std::vector<char> MPIW::scatterLines(const std::vector<char>& text, int source) const {
+	std::vector<int> counts(nproc, 0), displs(nproc, 0);
+	if (rank == source) {
+		std::vector<std::size_t> starts(nproc + 1, text.size());
+		for (int r = 1; r < nproc; ++r) {
+			std::size_t q = std::max(starts[r - 1], (std::size_t)((unsigned long long)text.size()*r/nproc));
+			while (q > 0 && q < text.size() && text[q - 1] != '\n')
+				++q;
+			starts[r] = q;
+		}
+		starts[0] = 0;
+		for (int r = 0; r < nproc; ++r) {
+			if (starts[r + 1] - starts[r] > (std::size_t)INT_MAX || starts[r] > (std::size_t)INT_MAX)
+				throw std::runtime_error("MPIW::scatterLines: text is too large to scatter.");
+			counts[r] = (int)(starts[r + 1] - starts[r]);
+			displs[r] = (int)starts[r];
+		}
+	}
+	int count = 0;
+	MPI_Scatter(counts.data(), 1, MPI_INT, &count, 1, MPI_INT, source, m_handles->comm);
+	std::vector<char> block(count);
+	MPI_Scatterv((void*)text.data(), counts.data(), displs.data(), MPI_BYTE, block.data(), count, MPI_BYTE, source, m_handles->comm);
+	return block;
+}
+
+/**
+ * @brief Gathers the same number of ints from every processor onto every processor.
+ * @param local This processor's ints.
+ * @return The ints of every processor in rank order.
+ */
+std::vector<int> MPIW::allGather(const std::vector<int>& local) const {
+	std::vector<int> all(local.size()*nproc);
+	MPI_Allgather((void*)local.data(), (int)local.size(), MPI_INT, all.data(), (int)local.size(), MPI_INT, m_handles->comm);
+	return all;
+}
+
+/**
+ * @brief Gathers the same number of doubles from every processor onto every processor.
+ * @param local This processor's doubles.
+ * @return The doubles of every processor in rank order.
+ */
+std::vector<double> MPIW::allGather(const std::vector<double>& local) const {
+	std::vector<double> all(local.size()*nproc);
+	MPI_Allgather((void*)local.data(), (int)local.size(), MPI_DOUBLE, all.data(), (int)local.size(), MPI_DOUBLE, m_handles->comm);
+	return all;
+}
+
+/**
+ * @brief Sends a block of doubles from every processor to every processor.
+ * @param outgoing Block for each processor, indexed by rank.
+ * @return The blocks sent to this processor, concatenated in the rank order of their senders.
+ */
+std::vector<double> MPIW::exchange(const std::vector<std::vector<double>>& outgoing) const {
+	if ((int)outgoing.size() != nproc)
+		throw std::runtime_error("MPIW::exchange: need one block per processor.");
+	std::vector<int> sendCounts(nproc), sendDispls(nproc), recvCounts(nproc), recvDispls(nproc);
+	long long sendTotal = 0;
+	for (int r = 0; r < nproc; ++r) {
+		sendCounts[r] = (int)outgoing[r].size();
+		sendDispls[r] = (int)sendTotal;
+		sendTotal += outgoing[r].size();
+	}
+	MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, m_handles->comm);
+	long long recvTotal = 0;
+	for (int r = 0; r < nproc; ++r) {
+		recvDispls[r] = (int)recvTotal;
+		recvTotal += recvCounts[r];
+	}
+	if (sendTotal > INT_MAX || recvTotal > INT_MAX)
+		throw std::runtime_error("MPIW::exchange: too much data to exchange at once.");
+
+	std::vector<double> sendBuffer;
+	sendBuffer.reserve(sendTotal);
+	for (const std::vector<double>& block : outgoing)
+		sendBuffer.insert(sendBuffer.end(), block.begin(), block.end());
+	std::vector<double> received(recvTotal);
+	MPI_Alltoallv(sendBuffer.data(), sendCounts.data(), sendDispls.data(), MPI_DOUBLE,
+			received.data(), recvCounts.data(), recvDispls.data(), MPI_DOUBLE, m_handles->comm);
+	return received;
+}
+
 /**
  * @brief Changes x to the minimum x passed in by all processors.
  * @param x A value to be changed to minimum across all processors.
  */
 double MPIW::minimum(double& x) const {
+	ScopedTimer timer(ProfileID::MPI_REDUCE);
 	double result;
-	MPI_Allreduce(&x, &result, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+	MPI_Allreduce(&x, &result, 1, MPI_DOUBLE, MPI_MIN, m_handles->comm);
 	return result; 
 }
 
+/**
+ * @brief Finds the minimum of each element of an array over all processors, in a single reduction.
+ * @param x This processor's array, which must be the same size on every processor.
+ * @return The minima, the same on every processor.
+ */
+std::vector<double> MPIW::minimum(const std::vector<double>& x) const {
+	ScopedTimer timer(ProfileID::MPI_REDUCE);
+	std::vector<double> result(x.size());
+	MPI_Allreduce((void*)x.data(), result.data(), (int)x.size(), MPI_DOUBLE, MPI_MIN, m_handles->comm);
+	return result;
+}
+
+/**
+ * @brief Finds the minimum of each element of an array over all processors and the processor it came from, in a
+ * single MPI_MINLOC reduction.
+ * @param x This processor's array, which must be the same size on every processor.
+ * @param ranks Set to the rank of the processor holding each minimum (the lowest one if several do).
+ * @return The minima, the same on every processor.
+ */
+std::vector<double> MPIW::minimum(const std::vector<double>& x, std::vector<int>& ranks) const {
+	std::vector<double> result(x.size());
+	ranks.resize(x.size());
+	minimum((int)x.size(), x.data(), result.data(), ranks.data());
+	return result;
+}
+
+/**
+ * @brief Finds the minimum of each of n values over all processors and the processor it came from, as above, into
+ * arrays of the caller's, allocating nothing for up to minlocBufferSize values (for the reductions of every step).
+ * @param n Number of values, the same on every processor.
+ * @param x This processor's values.
+ * @param result Set to the minima, the same on every processor.
+ * @param ranks Set to the rank of the processor holding each minimum (the lowest one if several do).
+ */
+void MPIW::minimum(int n, const double* x, double* result, int* ranks) const {
+	ScopedTimer timer(ProfileID::MPI_REDUCE);
+	// The layout of MPI_DOUBLE_INT.
+	struct DoubleInt {
+		double value;
+		int rank;
+	};
+	DoubleInt buffer[2*minlocBufferSize];
+	std::vector<DoubleInt> large;
+	DoubleInt* local = buffer;
+	if (n > minlocBufferSize) {
+		large.resize(2*n);
+		local = large.data();
+	}
+	DoubleInt* global = local + n;
+	for (int i = 0; i < n; ++i) {
+		local[i].value = x[i];
+		local[i].rank = rank;
+	}
+	MPI_Allreduce(local, global, n, MPI_DOUBLE_INT, MPI_MINLOC, m_handles->comm);
+	for (int i = 0; i < n; ++i) {
+		result[i] = global[i].value;
+		ranks[i] = global[i].rank;
+	}
+}
+
+/**
+ * @brief Finds the maximum of each element of an array over all processors, in a single reduction.
+ * @param x This processor's array, which must be the same size on every processor.
+ * @return The maxima, the same on every processor.
+ */
+std::vector<double> MPIW::maximum(const std::vector<double>& x) const {
+	ScopedTimer timer(ProfileID::MPI_REDUCE);
+	std::vector<double> result(x.size());
+	MPI_Allreduce((void*)x.data(), result.data(), (int)x.size(), MPI_DOUBLE, MPI_MAX, m_handles->comm);
+	return result;
+}
+
 /**
  * @brief Changes x to the maximum x passed in by all processors.
  * @param x A value to be changed to maximum across all processors.
  */
 double MPIW::maximum(double& x) const {
+	ScopedTimer timer(ProfileID::MPI_REDUCE);
 	double result;
-	MPI_Allreduce(&x, &result, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	MPI_Allreduce(&x, &result, 1, MPI_DOUBLE, MPI_MAX, m_handles->comm);
 	return result;
 }
 
 double MPIW::sum(double& x) const {
+	ScopedTimer timer(ProfileID::MPI_REDUCE);
 	double result;
-	MPI_Allreduce(&x, &result, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	MPI_Allreduce(&x, &result, 1, MPI_DOUBLE, MPI_SUM, m_handles->comm);
+	return result;
+}
+
+/**
+ * @brief Sums each element of an array over all processors.
+ * @param x This processor's array, which must be the same size on every processor.
+ * @return The sums, the same on every processor.
+ */
+std::vector<double> MPIW::sum(const std::vector<double>& x) const {
+	ScopedTimer timer(ProfileID::MPI_REDUCE);
+	std::vector<double> result(x.size());
+	MPI_Allreduce((void*)x.data(), result.data(), (int)x.size(), MPI_DOUBLE, MPI_SUM, m_handles->comm);
 	return result;
 }
 
+/**
+ * @brief Sums the first nsums elements of an array and finds the maximum of the rest over all processors, in a single
+ * reduction. A minimum is the maximum of the negated values.
+ * @param x This processor's array, which must be the same size on every processor.
+ * @param nsums Number of leading elements that are summed.
+ * @return The sums followed by the maxima, the same on every processor.
+ */
+std::vector<double> MPIW::sumAndMaximum(const std::vector<double>& x, std::size_t nsums) const {
+	ScopedTimer timer(ProfileID::MPI_REDUCE);
+	if (m_handles->sumOrMax == MPI_OP_NULL) {
+		MPI_Type_contiguous(2, MPI_DOUBLE, &m_handles->taggedType);
+		MPI_Type_commit(&m_handles->taggedType);
+		MPI_Op_create(reduceSumOrMax, 1, &m_handles->sumOrMax);
+	}
+	std::vector<double> local(2*x.size()), global(2*x.size());
+	for (std::size_t i = 0; i < x.size(); ++i) {
+		local[2*i] = x[i];
+		local[2*i + 1] = i < nsums ? 0 : 1;
+	}
+	MPI_Allreduce(local.data(), global.data(), (int)x.size(), m_handles->taggedType, m_handles->sumOrMax, m_handles->comm);
+	std::vector<double> result(x.size());
+	for (std::size_t i = 0; i < x.size(); ++i)
+		result[i] = global[2*i];
+	return result;
+}
+
+/**
+ * @brief Sends a batch of log messages to another processor of the group without waiting. The message is kept until
+ * the send completes, which is checked by the next postLog and waited for by waitLog.
+ * @param message Message, taken over by the call.
+ * @param destination Rank of the processor that writes the log.
+ */
+void MPIW::postLog(std::vector<char>&& message, int destination) {
+	for (std::size_t i = 0; i < m_handles->logRequests.size();) {
+		int done = 0;
+		MPI_Test(&m_handles->logRequests[i], &done, MPI_STATUS_IGNORE);
+		if (done != 0) {
+			m_handles->logRequests.erase(m_handles->logRequests.begin() + i);
+			m_handles->logMessages.erase(m_handles->logMessages.begin() + i);
+		}
+		else
+			++i;
+	}
+	m_handles->logMessages.push_back(std::move(message));
+	m_handles->logRequests.push_back(MPI_REQUEST_NULL);
+	std::vector<char>& buffer = m_handles->logMessages.back();
+	MPI_Isend(buffer.data(), (int)buffer.size(), MPI_BYTE, destination, (int)SendID::LOG_MSG, m_handles->comm, &m_handles->logRequests.back());
+}
+
+/**
+ * @brief Receives the next batch of log messages sent to this processor by postLog, from any processor of the group.
+ * @param message Set to the batch.
+ * @param wait Whether to wait for a batch if none has arrived.
+ * @return Whether a batch was received.
+ */
+bool MPIW::receiveLog(std::vector<char>& message, bool wait) const {
+	MPI_Status status;
+	int found = 1;
+	if (wait)
+		MPI_Probe(MPI_ANY_SOURCE, (int)SendID::LOG_MSG, m_handles->comm, &status);
+	else
+		MPI_Iprobe(MPI_ANY_SOURCE, (int)SendID::LOG_MSG, m_handles->comm, &found, &status);
+	if (found == 0)
+		return false;
+	int count = 0;
+	MPI_Get_count(&status, MPI_BYTE, &count);
+	message.resize(count);
+	MPI_Recv(message.data(), count, MPI_BYTE, status.MPI_SOURCE, (int)SendID::LOG_MSG, m_handles->comm, MPI_STATUS_IGNORE);
+	return true;
+}
+
+/**
+ * @brief Waits for every batch started by postLog to be sent.
+ */
+void MPIW::waitLog() {
+	if (!m_handles->logRequests.empty())
+		MPI_Waitall((int)m_handles->logRequests.size(), m_handles->logRequests.data(), MPI_STATUSES_IGNORE);
+	m_handles->logRequests.clear();
+	m_handles->logMessages.clear();
+}
+
 /**
  * @brief Forces processors to stop here until all processors reach this point.
  */
 void MPIW::barrier() const {
-	MPI_Barrier(MPI_COMM_WORLD);
+	ScopedTimer timer(ProfileID::MPI_BARRIER);
+	MPI_Barrier(m_handles->comm);
 }
 
 void MPIW::broadcastBoolean(bool msg, int source) const {
-	MPI_Bcast(&msg, 1, MPI_INT, source, MPI_COMM_WORLD);
+	ScopedTimer timer(ProfileID::MPI_BROADCAST);
+	MPI_Bcast(&msg, 1, MPI_INT, source, m_handles->comm);
 }
 
 void MPIW::broadcastString(std::string& msg, int source) const {
-	int length;
+	ScopedTimer timer(ProfileID::MPI_BROADCAST);
+	int length = 0;
 	if (rank == source)
 		length = msg.size();
-	MPI_Bcast(&length, 1, MPI_INT, source, MPI_COMM_WORLD);
-	char* cmsg;
-	if (rank == source)
-		cmsg = (char*) msg.c_str();
-	else
-		cmsg = (char*) malloc(sizeof(char)*(length + 1));
-	MPI_Bcast(cmsg, length, MPI_CHAR, source, MPI_COMM_WORLD);
+	MPI_Bcast(&length, 1, MPI_INT, source, m_handles->comm);
 	if (rank != source)
-		msg = std::string(cmsg);
+		msg.assign(length, '\0');
+	if (length > 0)
+		MPI_Bcast(&msg[0], length, MPI_CHAR, source, m_handles->comm);
 }
 
 void MPIW::serial(const std::function<void()>& f) {
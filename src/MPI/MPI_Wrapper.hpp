@@ -8,12 +8,16 @@
 #ifndef MPIHANDLER_HPP_
 #define MPIHANDLER_HPP_
 
+#include <array>
+#include <cstddef>
 #include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 enum class SendID : unsigned int {PARTITION_MSG, RADIATION_MSG, THERMO_MSG, PRINT2D_MSG,
 	CFL_COLLECT, CFL_BROADCAST, PRINTIF_NEXT_MSG, PRINTIF_FOUND_MSG,
-	PRINTIF_IF_MSG, PRINTSTARBENCH_MSG, PRINT_HEATING_MSG, PERIODIC_MSG};
+	PRINTIF_IF_MSG, PRINTSTARBENCH_MSG, PRINT_HEATING_MSG, PERIODIC_MSG, GRAVITY_MSG, IO_MSG, TRACER_MSG, LOG_MSG, PARTNER_MSG, N};
 enum BuffType {INTEGER, FLOAT, DOUBLE}; //!< buffer data types.
 
 /**
@@ -30,8 +34,8 @@ public:
 	static MPIW& Instance() {
 		return Instance(0, 0);
 	}
-	int rank = 0; //!< Rank of the process.
-	int nproc = 1; //!< Number of processors running this program.
+	int rank = 0; //!< Rank of the process in its group.
+	int nproc = 1; //!< Number of processors in the group (all those running this program unless split by splitGroups).
 	std::string proc_name = ""; //!< Name of the processor.
 
 	~MPIW();
@@ -42,28 +46,149 @@ public:
 	std::string pname() const;
 	std::string cname() const;
 
+	// Groups of processors that run separate simulations.
+	void splitGroups(int ngroups);
+	int nextTask();
+	int groupIndex() const;
+	int nGroups() const;
+	int worldRank() const;
+	int nWorldProcessors() const;
+	int communicator() const;
+
+	// Dedicated I/O processors.
+	void splitIO(int clients);
+	bool isIOServer() const;
+	bool hasIOServer() const;
+	int nIOClients() const;
+	int nComputeProcessors() const;
+	void postIO(std::vector<char>&& message);
+	std::vector<char> receiveIO() const;
+	void waitIO();
+	void writeParts(const std::string& filename, const std::vector<int>& ranks, const std::vector<std::vector<char>>& parts) const;
+
+	// Dedicated radiation processors.
+	void splitRadiation();
+	bool isRadiationServer() const;
+	bool hasRadiationServer() const;
+	void postPartner(std::vector<double>&& message);
+	std::vector<double> receivePartner() const;
+	void waitPartner();
+
+	// Node topology and threading.
+	bool threadsFunneled() const;
+	int nodeRank() const;
+	int nodeSize() const;
+	int nodeLeader() const;
+	int nNodes() const;
+
+	// Cartesian topology.
+	void createCartesian(std::array<int, 3>& dims, const std::array<bool, 3>& periodic);
+	const std::array<int, 3>& getDims() const;
+	const std::array<int, 3>& getCoords() const;
+	int neighbour(int dim, int displacement) const;
+
 	// Message passing methods.
 	void send(double* S, int count, int destination, SendID tag) const;
 	void send(int* S, int count, int destination, SendID tag) const;
-	void receive(double* R, int count, int source, SendID tag) const;
+	int receive(double* R, int count, int source, SendID tag, int channel = 0) const;
 	void receive(int* R, int count, int source, SendID tag) const;
-	void exchange(double* send_buffer, double* receive_buffer, int count, int destination, SendID tag) const;
+	void postSend(double* S, int count, int destination, SendID tag, int channel = 0);
+	void postSend(int* S, int count, int destination, SendID tag, int channel = 0);
+	void postReceive(double* R, int count, int source, SendID tag, int channel = 0);
+	void waitAll();
+	void setProgressInterval(double seconds);
+	void progress();
+
+	// Persistent communication.
+	int createCellType(std::size_t cellSize, const std::vector<std::ptrdiff_t>& fieldOffsets, const std::vector<int>& fieldLengths, const std::vector<int>& cellIDs);
+	int createPersistentSend(double* S, int count, int destination, SendID tag, int channel = 0);
+	int createPersistentSend(void* S, int datatype, int destination, SendID tag, int channel = 0);
+	int createPersistentReceive(double* R, int count, int source, SendID tag, int channel = 0);
+	int createPersistentReceive(void* R, int datatype, int source, SendID tag, int channel = 0);
+	void start(int request);
+	int createNeighbourExchange(const std::vector<int>& neighbours, void* base, const std::vector<int>& sendTypes, const std::vector<int>& recvTypes);
+	int createNeighbourExchange(const std::vector<int>& neighbours, double* S, const std::vector<int>& sendCounts, double* R, const std::vector<int>& recvCounts);
+	void startNeighbourExchange(int exchange);
+	void freePersistent();
+
+	// One-sided relay.
+	void createRelay(long long dataCount, long long signalCount);
+	bool hasRelay() const;
+	const double* relayBuffer() const;
+	void relayPut(const double* data, int count, int target, long long offset);
+	void relaySignal(long long value, int target, long long offset);
+	long long relayWait(long long offset, long long value);
+	void freeRelay();
 	void barrier() const;
+	void postLog(std::vector<char>&& message, int destination);
+	bool receiveLog(std::vector<char>& message, bool wait) const;
+	void waitLog();
 	void broadcastBoolean(bool msg, int source) const;
 	void broadcastString(std::string& msg, int source) const;
 
 	// Output.
 	void write(char* filename, void* inputbuffer, int ncols, int nrows, int buffsize, BuffType btype) const;
+	void writeOrdered(const std::string& filename, const std::vector<char>& header, const double* data, int count) const;
+	void writeOrdered(const std::string& filename, const std::vector<char>& header, const char* data, int count) const;
+	long long writeOrderedAt(const std::string& filename, long long start, const std::vector<char>& header, const char* data, int count) const;
+	void writeBox(const std::string& filename, const std::vector<char>& header, const char* data, int cellBytes,
+			const std::array<int, 3>& ncells, const std::array<int, 3>& boxCells, const std::array<int, 3>& boxOffset) const;
+	void writeRegion(const std::string& filename, const std::vector<char>& header, const char* data, int cellBytes,
+			const std::array<int, 3>& ncells, const std::array<int, 3>& boxCells, const std::array<int, 3>& boxOffset) const;
+	std::vector<char> readAll(const std::string& filename) const;
+	std::string broadcastFile(const std::string& filename, int source) const;
+	std::vector<char> readLines(const std::string& filename, long long offset) const;
+	std::vector<char> scatterLines(const std::vector<char>& text, int source) const;
+
+	// Collective data exchange.
+	std::vector<int> allGather(const std::vector<int>& local) const;
+	std::vector<double> allGather(const std::vector<double>& local) const;
+	std::vector<double> exchange(const std::vector<std::vector<double>>& outgoing) const;
 
 	// Misc. methods.
 	double minimum(double& x) const;
+	std::vector<double> minimum(const std::vector<double>& x) const;
+	std::vector<double> minimum(const std::vector<double>& x, std::vector<int>& ranks) const;
+	void minimum(int n, const double* x, double* result, int* ranks) const;
 	double maximum(double& x) const;
+	std::vector<double> maximum(const std::vector<double>& x) const;
 	double sum(double& x) const;
+	std::vector<double> sum(const std::vector<double>& x) const;
+	std::vector<double> sumAndMaximum(const std::vector<double>& x, std::size_t nsums) const;
 
 	void serial(const std::function<void()>& f);
 	void abort();
 
 private:
+	struct Handles;
+	std::unique_ptr<Handles> m_handles; //!< Cartesian communicator, outstanding non-blocking requests, persistent requests and derived datatypes.
+	std::array<int, 3> m_dims = std::array<int, 3>{{ 1, 1, 1 }}; //!< Number of processors along each dimension.
+	std::array<int, 3> m_coords = std::array<int, 3>{{ 0, 0, 0 }}; //!< Coordinates of this processor in the Cartesian topology.
+	bool m_ownsMPI = true; //!< Whether MPI was initialised by this MPIW, which then finalises it.
+	bool m_threadsFunneled = false; //!< Whether the MPI library lets OpenMP threads run alongside MPI calls made by the main thread.
+	int m_nodeRank = 0; //!< Rank of the process among those sharing its node's memory.
+	int m_nodeSize = 1; //!< Number of processes sharing this node's memory.
+	int m_nodeLeader = 0; //!< Rank in the group of the first process on this node.
+	int m_nNodes = 1; //!< Number of shared memory nodes the program runs on.
+	int m_worldRank = 0; //!< Rank of the process in MPI_COMM_WORLD.
+	int m_worldSize = 1; //!< Number of processors running this program.
+	int m_group = 0; //!< Index of this processor's group.
+	int m_nGroups = 1; //!< Number of groups.
+	int m_tasksTaken = 0; //!< Tasks taken by nextTask without groups.
+	int m_ioServer = -1; //!< World rank of the I/O processor this processor hands its output to (-1 for none, itself if it is one).
+	int m_nIOClients = 0; //!< Number of processors an I/O processor serves.
+	int m_nCompute = 1; //!< Number of processors that are not I/O processors.
+	int m_partner = -1; //!< World rank of the processor this one exchanges its state with (see splitRadiation), -1 for none.
+	bool m_isRadiationServer = false; //!< Whether this processor traces the radiation for its partner.
+	double m_progressInterval = 0; //!< Seconds between the calls into MPI made by progress (0 for none).
+	double m_lastProgress = 0; //!< MPI_Wtime of the last call into MPI made by progress.
+	int m_tagChannels = 1; //!< Number of channels a message tag can hold under MPI_TAG_UB (see messageTag).
+
+	static const int minlocBufferSize = 8; //!< Values the MPI_MINLOC reduction of minimum(n, ...) holds on the stack.
+
+	void splitNodes();
+	int messageTag(SendID tag, int channel) const;
+
     MPIW(int* argc, char*** argv);
     MPIW(MPIW const&);
     void operator=(MPIW const&);
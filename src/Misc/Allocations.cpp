@@ -0,0 +1,86 @@
+#include "Allocations.hpp"
+
+#ifdef TORCH_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<long long> allocations(0);
+thread_local bool isExcluded = false; //!< Whether the allocations of this thread are left out (see Allocations::excludeThread).
+
+void* allocate(std::size_t size) {
+	if (!isExcluded)
+		allocations.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+}
+
+void* operator new(std::size_t size) {
+	void* p = allocate(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+bool Allocations::isCounted() {
+	return true;
+}
+
+long long Allocations::count() {
+	return allocations.load(std::memory_order_relaxed);
+}
+
+void Allocations::excludeThread() {
+	isExcluded = true;
+}
+#else
+bool Allocations::isCounted() {
+	return false;
+}
+
+long long Allocations::count() {
+	return 0;
+}
+
+void Allocations::excludeThread() {
+}
+#endif
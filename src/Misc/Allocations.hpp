@@ -0,0 +1,27 @@
+/**
+ * Provides the heap allocation count of a TORCH_COUNT_ALLOCATIONS build.
+ * @file Allocations.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef ALLOCATIONS_HPP_
+#define ALLOCATIONS_HPP_
+
+/**
+ * @brief Counts the heap allocations of every thread of this processor, so the allocations of a step can be found as
+ * the difference of the counts before and after it (see Torch::writePerformance).
+ *
+ * A build with TORCH_COUNT_ALLOCATIONS replaces the global operator new with one that counts each call before it calls
+ * malloc. Without it the count stays 0 and isCounted is false. The background threads that format and write the
+ * output and log alongside the steps call excludeThread, so that only the allocations of the steps are counted.
+ */
+namespace Allocations {
+
+bool isCounted();
+long long count();
+void excludeThread();
+
+}
+
+#endif // ALLOCATIONS_HPP_
@@ -0,0 +1,149 @@
+#include "Benchmark.hpp"
+#include "CpuDispatch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <limits>
+#include <thread>
+
+#include <unistd.h>
+
+namespace {
+
+std::string escapeJSON(const std::string& text) {
+	std::string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		if (c >= 0 && c < 0x20)
+			escaped += ' ';
+		else
+			escaped += c;
+	}
+	return escaped;
+}
+
+}
+
+/**
+ * @param minTime Shortest run timed (s).
+ * @param repetitions Number of runs timed, the fastest being reported.
+ */
+BenchmarkSuite::BenchmarkSuite(double minTime, int repetitions)
+: m_minTime(minTime)
+, m_repetitions(std::max(1, repetitions))
+{
+}
+
+/**
+ * @brief Adds a benchmark.
+ * @param name Name of the benchmark, e.g. Kernel/variant.
+ * @param items Number of items the kernel processes each time it is called.
+ * @param kernel Runs the kernel over its data once.
+ */
+void BenchmarkSuite::add(const std::string& name, long items, std::function<void()> kernel) {
+	m_benchmarks.push_back(Benchmark{name, items, kernel});
+}
+
+/**
+ * @brief Runs the benchmarks whose names contain a filter.
+ * @param filter Substring of the names of the benchmarks to run (empty for all).
+ * @param log Stream the result of each benchmark is printed to as it finishes.
+ */
+void BenchmarkSuite::run(const std::string& filter, std::ostream& log) {
+	char line[160];
+	std::snprintf(line, sizeof(line), "%-56s %14s %14s %12s %14s\n", "benchmark", "time (ns)", "cpu (ns)", "iterations",
+			"items/s");
+	log << line;
+	for (Benchmark& benchmark : m_benchmarks) {
+		if (!filter.empty() && benchmark.name.find(filter) == std::string::npos)
+			continue;
+		Result result;
+		result.name = benchmark.name;
+		result.realTime = std::numeric_limits<double>::max();
+		long iterations = 1;
+		for (int irep = 0; irep < m_repetitions; ++irep) {
+			while (true) {
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				std::clock_t cpuStart = std::clock();
+				for (long i = 0; i < iterations; ++i)
+					benchmark.kernel();
+				std::clock_t cpuStop = std::clock();
+				double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				// Grow the run until it is long enough to time, then keep its length for the other repetitions.
+				if (elapsed < m_minTime && iterations < std::numeric_limits<long>::max()/2) {
+					iterations *= 2;
+					continue;
+				}
+				double realTime = 1.0e9*elapsed/iterations;
+				if (realTime < result.realTime) {
+					result.iterations = iterations;
+					result.realTime = realTime;
+					result.cpuTime = 1.0e9*(double)(cpuStop - cpuStart)/CLOCKS_PER_SEC/iterations;
+					result.itemsPerSecond = 1.0e9*benchmark.items/realTime;
+				}
+				break;
+			}
+		}
+		std::snprintf(line, sizeof(line), "%-56s %14.1f %14.1f %12ld %14.4g\n", result.name.c_str(), result.realTime,
+				result.cpuTime, result.iterations, result.itemsPerSecond);
+		log << line << std::flush;
+		m_results.push_back(result);
+	}
+}
+
+/**
+ * @brief Writes the context of the run (machine, compiler, date) and the results of the benchmarks run so far.
+ */
+void BenchmarkSuite::writeJSON(std::ostream& out) const {
+	char date[64] = "";
+	std::time_t now = std::time(nullptr);
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+	char host[256] = "";
+	if (gethostname(host, sizeof(host) - 1) != 0)
+		host[0] = '\0';
+#if defined(__VERSION__)
+	const std::string compiler = __VERSION__;
+#else
+	const std::string compiler = "unknown";
+#endif
+#if defined(NDEBUG)
+	const std::string buildType = "release";
+#else
+	const std::string buildType = "debug";
+#endif
+
+	out << "{\n";
+	out << "  \"context\": {\n";
+	out << "    \"date\": \"" << date << "\",\n";
+	out << "    \"host_name\": \"" << escapeJSON(host) << "\",\n";
+	out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+	out << "    \"compiler\": \"" << escapeJSON(compiler) << "\",\n";
+	out << "    \"library_build_type\": \"" << buildType << "\",\n";
+	out << "    \"kernel_variant\": \"" << CpuDispatch::kernelVariant() << "\",\n";
+	out << "    \"min_time\": " << m_minTime << ",\n";
+	out << "    \"repetitions\": " << m_repetitions << "\n";
+	out << "  },\n";
+	out << "  \"benchmarks\": [";
+	char value[64];
+	for (std::size_t i = 0; i < m_results.size(); ++i) {
+		const Result& result = m_results[i];
+		out << (i == 0 ? "\n" : ",\n");
+		out << "    {\n";
+		out << "      \"name\": \"" << escapeJSON(result.name) << "\",\n";
+		out << "      \"run_type\": \"iteration\",\n";
+		out << "      \"iterations\": " << result.iterations << ",\n";
+		std::snprintf(value, sizeof(value), "%.6e", result.realTime);
+		out << "      \"real_time\": " << value << ",\n";
+		std::snprintf(value, sizeof(value), "%.6e", result.cpuTime);
+		out << "      \"cpu_time\": " << value << ",\n";
+		out << "      \"time_unit\": \"ns\",\n";
+		std::snprintf(value, sizeof(value), "%.6e", result.itemsPerSecond);
+		out << "      \"items_per_second\": " << value << "\n";
+		out << "    }";
+	}
+	out << "\n  ]\n";
+	out << "}\n";
+}
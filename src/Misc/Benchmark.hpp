@@ -0,0 +1,68 @@
+/** Provides the BenchmarkSuite class.
+ *
+ * @file Benchmark.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef BENCHMARK_HPP_
+#define BENCHMARK_HPP_
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Stops the compiler from optimising away the computation of a value that a benchmark never uses.
+ */
+template <typename T>
+inline void doNotOptimise(const T& value) {
+#if defined(__GNUC__)
+	asm volatile("" : : "m"(value) : "memory");
+#else
+	const volatile T* sink = &value;
+	(void)sink;
+#endif
+}
+
+/**
+ * @class BenchmarkSuite
+ *
+ * @brief Times kernels on synthetic data and writes the results as JSON, in the format of Google Benchmark's
+ * --benchmark_format=json so that the same tools can compare runs across commits, compilers and machines.
+ *
+ * Each benchmark is a function that runs its kernel once over its data, processing a fixed number of items (states,
+ * slopes, cells, ...). The number of iterations is doubled until a run lasts at least the minimum time, and the fastest
+ * of a few such runs is reported, as the time per iteration and the items per second.
+ */
+class BenchmarkSuite {
+public:
+	struct Result {
+		std::string name;
+		long iterations = 0;
+		double realTime = 0; //!< Wall clock time per iteration (ns).
+		double cpuTime = 0; //!< Processor time per iteration (ns).
+		double itemsPerSecond = 0;
+	};
+
+	BenchmarkSuite(double minTime, int repetitions);
+
+	void add(const std::string& name, long items, std::function<void()> kernel);
+	void run(const std::string& filter, std::ostream& log);
+	void writeJSON(std::ostream& out) const;
+
+private:
+	struct Benchmark {
+		std::string name;
+		long items;
+		std::function<void()> kernel;
+	};
+
+	double m_minTime; //!< Shortest run timed (s).
+	int m_repetitions; //!< Number of runs timed, the fastest being reported.
+	std::vector<Benchmark> m_benchmarks;
+	std::vector<Result> m_results;
+};
+
+#endif // BENCHMARK_HPP_
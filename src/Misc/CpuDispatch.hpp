@@ -0,0 +1,49 @@
+/**
+ * Provides TORCH_KERNEL_CLONES, which compiles the hot kernels for several instruction sets, and reports the one
+ * they run with.
+ * @file CpuDispatch.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef CPUDISPATCH_HPP_
+#define CPUDISPATCH_HPP_
+
+/**
+ * @brief Compiles a function once for AVX-512, once for AVX2 and once for the baseline instruction set, and picks the
+ * variant the CPU supports the first time it is called (GCC's target_clones, resolved through CPUID).
+ *
+ * Only GCC on x86-64 Linux is supported, and only when Torch is built with TORCH_MULTIVERSION; otherwise the macro is
+ * empty and the function is compiled once for the flags of the build. Virtual functions cannot be cloned, so they call
+ * a cloned function that holds their loop. Torch is built with -ffp-contract=off alongside, so every variant gives the
+ * same results.
+ */
+#if defined(TORCH_MULTIVERSION) && defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define TORCH_HAS_KERNEL_CLONES
+#define TORCH_KERNEL_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define TORCH_KERNEL_CLONES
+#endif
+
+namespace CpuDispatch {
+
+/**
+ * @brief Name of the variant of the TORCH_KERNEL_CLONES kernels this CPU runs: "avx512f", "avx2", "default", or
+ * "native" if the kernels are only compiled once.
+ */
+inline const char* kernelVariant() {
+#ifdef TORCH_HAS_KERNEL_CLONES
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return "avx512f";
+	if (__builtin_cpu_supports("avx2"))
+		return "avx2";
+	return "default";
+#else
+	return "native";
+#endif
+}
+
+}
+
+#endif // CPUDISPATCH_HPP_
@@ -0,0 +1,97 @@
+/**
+ * Provides the FirstTouchAllocator, which places large arrays of cells in the memory of the threads that sweep them.
+ * @file FirstTouchAllocator.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef FIRSTTOUCHALLOCATOR_HPP_
+#define FIRSTTOUCHALLOCATOR_HPP_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "Parallel.hpp"
+
+namespace FirstTouch {
+
+const std::size_t pageSize = 4096; //!< Size of the pages the operating system maps (bytes).
+const std::size_t hugePageSize = 2*1024*1024; //!< Size of the transparent huge pages of x86-64 Linux (bytes).
+const std::size_t minTouchedSize = 64*pageSize; //!< Smallest allocation placed page by page; smaller ones use operator new.
+
+/**
+ * @brief Whether allocations of at least one huge page are aligned to huge pages and advised to be backed by them.
+ */
+inline bool& hugePages() {
+	static bool on = false;
+	return on;
+}
+
+/**
+ * @brief Allocates the pages of a large array and touches them with the threads of a static Parallel::forEach over it.
+ *
+ * Linux maps a page to the NUMA node of the thread that first writes to it, so the page holding an element is placed
+ * with the thread that Parallel::forEach gives that element to, whatever thread then constructs the elements.
+ * @exception std::bad_alloc Thrown if the memory cannot be allocated.
+ */
+inline void* allocate(std::size_t bytes) {
+	if (bytes < minTouchedSize)
+		return ::operator new(bytes);
+	const bool huge = hugePages() && bytes >= hugePageSize;
+	void* p = nullptr;
+	if (posix_memalign(&p, huge ? hugePageSize : pageSize, bytes) != 0)
+		throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+	if (huge)
+		madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+	char* bytePtr = static_cast<char*>(p);
+	Parallel::forEach(0, (int)((bytes + pageSize - 1)/pageSize), [&](int page) {
+		bytePtr[page*pageSize] = 0;
+	});
+	return p;
+}
+
+inline void deallocate(void* p, std::size_t bytes) {
+	if (bytes < minTouchedSize)
+		::operator delete(p);
+	else
+		std::free(p);
+}
+
+}
+
+/**
+ * @class FirstTouchAllocator
+ *
+ * @brief Allocator of the std::vectors of GridCells and GridJoins, whose large allocations are touched in parallel by
+ * FirstTouch::allocate so every thread's cells are in its own NUMA node's memory.
+ */
+template <class T>
+class FirstTouchAllocator {
+public:
+	using value_type = T;
+	template <class U> struct rebind { using other = FirstTouchAllocator<U>; };
+
+	FirstTouchAllocator() { }
+	template <class U> FirstTouchAllocator(const FirstTouchAllocator<U>&) { }
+
+	T* allocate(std::size_t n) {
+		return static_cast<T*>(FirstTouch::allocate(n*sizeof(T)));
+	}
+	void deallocate(T* ptr, std::size_t n) {
+		FirstTouch::deallocate(ptr, n*sizeof(T));
+	}
+};
+
+template <class T, class U>
+bool operator==(const FirstTouchAllocator<T>&, const FirstTouchAllocator<U>&) { return true; }
+template <class T, class U>
+bool operator!=(const FirstTouchAllocator<T>&, const FirstTouchAllocator<U>&) { return false; }
+
+#endif // FIRSTTOUCHALLOCATOR_HPP_
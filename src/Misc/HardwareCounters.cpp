@@ -0,0 +1,119 @@
+#include "HardwareCounters.hpp"
+
+#include "Parallel.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const int HardwareCounters::N;
+
+#ifdef __linux__
+
+namespace {
+
+const std::uint64_t EVENTS[HardwareCounters::N] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_REFERENCES,
+	PERF_COUNT_HW_CACHE_MISSES
+};
+
+int openEvent(std::uint64_t config, int groupFD) {
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.disabled = groupFD == -1 ? 1 : 0;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFD, 0);
+}
+
+}
+
+HardwareCounters::~HardwareCounters() {
+	for (int fd : m_fds)
+		close(fd);
+}
+
+/**
+ * @brief Starts the counters on every OpenMP thread.
+ * @return An empty string, or why the counters are unavailable (e.g. no access to perf events), in which case none
+ * are left open.
+ */
+std::string HardwareCounters::open() {
+	int nthreads = Parallel::maxThreads();
+	std::vector<int> fds(N*nthreads, -1);
+	std::vector<int> errors(nthreads, 0);
+	// Every thread opens its own group, as a perf event counts the thread that opened it.
+	Parallel::forEach(0, nthreads, [&](int) {
+		int t = Parallel::threadID();
+		for (int ic = 0; ic < N; ++ic) {
+			fds[N*t + ic] = openEvent(EVENTS[ic], ic == 0 ? -1 : fds[N*t]);
+			if (fds[N*t + ic] == -1) {
+				errors[t] = errno;
+				return;
+			}
+		}
+		ioctl(fds[N*t], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(fds[N*t], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	});
+	for (int t = 0; t < nthreads; ++t) {
+		if (errors[t] != 0 || fds[N*t] == -1) {
+			for (int fd : fds)
+				if (fd != -1)
+					close(fd);
+			return std::string("perf_event_open failed: ") + std::strerror(errors[t] != 0 ? errors[t] : EINVAL);
+		}
+	}
+	m_fds = fds;
+	for (int t = 0; t < nthreads; ++t)
+		m_leaders.push_back(fds[N*t]);
+	return "";
+}
+
+/**
+ * @brief The events counted so far, summed over the threads.
+ */
+HardwareCounters::Counts HardwareCounters::read() const {
+	Counts counts = Counts();
+	std::uint64_t values[3 + N];
+	for (int fd : m_leaders) {
+		if (::read(fd, values, sizeof(values)) != (ssize_t)sizeof(values))
+			continue;
+		// {number of events, time enabled, time running, counts...}
+		double scale = values[2] > 0 ? (double)values[1]/values[2] : 0;
+		for (int ic = 0; ic < N; ++ic)
+			counts[ic] += scale*values[3 + ic];
+	}
+	return counts;
+}
+
+#else
+
+HardwareCounters::~HardwareCounters() {
+}
+
+std::string HardwareCounters::open() {
+	return "hardware counters are only supported on Linux";
+}
+
+HardwareCounters::Counts HardwareCounters::read() const {
+	return Counts();
+}
+
+#endif
+
+bool HardwareCounters::isOpen() const {
+	return !m_leaders.empty();
+}
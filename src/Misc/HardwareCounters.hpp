@@ -0,0 +1,49 @@
+/** Provides the HardwareCounters class.
+ *
+ * @file HardwareCounters.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef HARDWARECOUNTERS_HPP_
+#define HARDWARECOUNTERS_HPP_
+
+#include <array>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The hardware events counted by HardwareCounters.
+ */
+enum class CounterID : unsigned int {CYCLES, INSTRUCTIONS, CACHE_REFERENCES, CACHE_MISSES, N};
+
+/**
+ * @class HardwareCounters
+ *
+ * @brief CPU performance counters (through Linux perf events) for every thread of this processor.
+ *
+ * open() creates a group of counters on each OpenMP thread, counting user space events only, so the counts of the
+ * threads running a parallel loop can be read from the thread that started it. The cache events count the last level
+ * cache, so CACHE_MISSES times the cache line size estimates the memory traffic. Each group is scaled for any time the
+ * kernel multiplexed it off the hardware.
+ */
+class HardwareCounters {
+public:
+	static const int N = (int)CounterID::N;
+	typedef std::array<double, N> Counts;
+
+	HardwareCounters() { };
+	~HardwareCounters();
+	HardwareCounters(const HardwareCounters&) = delete;
+	HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+	std::string open();
+	bool isOpen() const;
+	Counts read() const;
+
+private:
+	std::vector<int> m_fds; //!< The counters of each thread's group, the group leader first.
+	std::vector<int> m_leaders; //!< File descriptor of the group leader of each thread.
+};
+
+#endif // HARDWARECOUNTERS_HPP_
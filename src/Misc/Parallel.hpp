@@ -0,0 +1,298 @@
+/**
+ * Provides thin wrappers around OpenMP for threading the per-cell sweeps.
+ * @file Parallel.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef PARALLEL_HPP_
+#define PARALLEL_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/**
+ * @brief Threading helpers. All of them fall back to serial loops when Torch is built without OpenMP.
+ *
+ * Loop bodies must only write to data owned by their iteration (e.g. a single GridCell). An exception thrown by any
+ * iteration is caught, the remaining iterations still run, and the first exception caught is rethrown on the calling
+ * thread once the loop has finished.
+ */
+namespace Parallel {
+
+/**
+ * @brief Maximum number of threads a parallel loop may use.
+ */
+inline int maxThreads() {
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+/**
+ * @brief Sets the number of threads the parallel loops started from now on use.
+ *
+ * The per-thread arrays are sized by maxThreads() when the components are initialised, so this must not exceed the
+ * maxThreads() of the run at that time.
+ */
+inline void setThreads(int nthreads) {
+#ifdef _OPENMP
+	omp_set_num_threads(nthreads);
+#else
+	(void)nthreads;
+#endif
+}
+
+/**
+ * @brief ID of the calling thread within the current parallel loop, in [0, maxThreads()).
+ */
+inline int threadID() {
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+/**
+ * @brief Lists the CPUs each thread may run on, as ranges such as "0-3,8", indexed by thread ID.
+ *
+ * A thread that is pinned lists a single CPU. The lists are empty where the affinity cannot be read.
+ */
+inline std::vector<std::string> threadCPUs() {
+	std::vector<std::string> cpus(maxThreads());
+#ifdef __linux__
+#pragma omp parallel
+	{
+		cpu_set_t mask;
+		CPU_ZERO(&mask);
+		std::string list;
+		if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+			for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+				if (!CPU_ISSET(cpu, &mask))
+					continue;
+				int last = cpu;
+				while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &mask))
+					++last;
+				list += (list.empty() ? "" : ",") + std::to_string(cpu) + ((last > cpu) ? "-" + std::to_string(last) : "");
+				cpu = last;
+			}
+		}
+		cpus[threadID()] = list;
+	}
+#endif
+	return cpus;
+}
+
+/**
+ * @brief Smallest level of forEachLevel split over the threads; starting and joining the threads of a parallel loop
+ * costs more than running a few cells on the calling thread.
+ */
+const int minLevelSize = 32;
+
+/**
+ * @brief Calls f(i) for every i in [first, last), split statically over the available threads.
+ */
+template <class Func>
+void forEach(int first, int last, Func f) {
+	std::exception_ptr error = nullptr;
+#pragma omp parallel for schedule(static)
+	for (int i = first; i < last; ++i) {
+		try {
+			f(i);
+		}
+		catch (...) {
+#pragma omp critical(torch_parallel_error)
+			if (error == nullptr)
+				error = std::current_exception();
+		}
+	}
+	if (error != nullptr)
+		std::rethrow_exception(error);
+}
+
+/**
+ * @brief Calls f(i) for every i in [first, last), handing the iterations out to the threads one at a time as they become
+ * free.
+ *
+ * For loops whose iterations vary a lot in cost. Ordering the iterations most expensive first balances the threads best.
+ */
+template <class Func>
+void forEachDynamic(int first, int last, Func f) {
+	std::exception_ptr error = nullptr;
+#pragma omp parallel for schedule(dynamic)
+	for (int i = first; i < last; ++i) {
+		try {
+			f(i);
+		}
+		catch (...) {
+#pragma omp critical(torch_parallel_error)
+			if (error == nullptr)
+				error = std::current_exception();
+		}
+	}
+	if (error != nullptr)
+		std::rethrow_exception(error);
+}
+
+/**
+ * @brief Calls f(i) for every i in [levels.front(), levels.back()) one level at a time, where level l is
+ * [levels[l], levels[l + 1]).
+ *
+ * The iterations within a level are split over the threads, and a level only starts once the previous one has
+ * finished, so an iteration may read anything written by the levels before it (e.g. a wavefront sweep). The threads
+ * are started once for the whole sweep and wait for each other at the end of every level, rather than being started
+ * and joined level by level. Levels of fewer than minLevelSize iterations, such as the single cell levels of a 1D
+ * sweep, are run by one thread, and a sweep with no larger level runs on the calling thread alone.
+ */
+template <class Func>
+void forEachLevel(const std::vector<int>& levels, Func f) {
+	if (levels.size() < 2)
+		return;
+	std::exception_ptr error = nullptr;
+	auto call = [&](int i) {
+		try {
+			f(i);
+		}
+		catch (...) {
+#pragma omp critical(torch_parallel_error)
+			if (error == nullptr)
+				error = std::current_exception();
+		}
+	};
+	bool isThreaded = false;
+	for (std::size_t l = 0; l + 1 < levels.size(); ++l)
+		isThreaded = isThreaded || levels[l + 1] - levels[l] >= minLevelSize;
+	if (!isThreaded) {
+		for (int i = levels.front(); i < levels.back(); ++i)
+			call(i);
+	}
+	else {
+#pragma omp parallel
+		for (std::size_t l = 0; l + 1 < levels.size(); ++l) {
+			if (levels[l + 1] - levels[l] >= minLevelSize) {
+#pragma omp for schedule(static)
+				for (int i = levels[l]; i < levels[l + 1]; ++i)
+					call(i);
+			}
+			else {
+#pragma omp single
+				for (int i = levels[l]; i < levels[l + 1]; ++i)
+					call(i);
+			}
+		}
+	}
+	if (error != nullptr)
+		std::rethrow_exception(error);
+}
+
+/**
+ * @brief Returns the minimum of init and f(i) for every i in [first, last).
+ *
+ * The result does not depend on the number of threads.
+ */
+template <class Func>
+double minimum(int first, int last, double init, Func f) {
+	double result = init;
+#pragma omp parallel for schedule(static) reduction(min:result)
+	for (int i = first; i < last; ++i)
+		result = std::min(result, f(i));
+	return result;
+}
+
+/**
+ * @brief Returns the maximum of init and f(i) for every i in [first, last).
+ *
+ * The result does not depend on the number of threads.
+ */
+template <class Func>
+double maximum(int first, int last, double init, Func f) {
+	double result = init;
+#pragma omp parallel for schedule(static) reduction(max:result)
+	for (int i = first; i < last; ++i)
+		result = std::max(result, f(i));
+	return result;
+}
+
+/**
+ * @brief An extreme value of a loop and the iteration that gave it (-1 if no iteration went past the initial value).
+ */
+struct Extremum {
+	double value;
+	int index;
+};
+
+namespace detail {
+
+/**
+ * @brief Returns the most extreme of init and f(i) for every i in [first, last), where x is more extreme than y if
+ * beyond(x, y), along with the smallest i that gives it. The result does not depend on the number of threads.
+ */
+template <class Func, class Beyond>
+Extremum extremum(int first, int last, double init, Func f, Beyond beyond) {
+	Extremum result = {init, -1};
+#pragma omp parallel
+	{
+		Extremum local = {init, -1};
+#pragma omp for schedule(static) nowait
+		for (int i = first; i < last; ++i) {
+			const double x = f(i);
+			if (beyond(x, local.value)) {
+				local.value = x;
+				local.index = i;
+			}
+		}
+#pragma omp critical(torch_parallel_extremum)
+		if (beyond(local.value, result.value) || (local.value == result.value && local.index >= 0 &&
+				(result.index < 0 || local.index < result.index)))
+			result = local;
+	}
+	return result;
+}
+
+}
+
+/**
+ * @brief Returns the minimum of init and f(i) for every i in [first, last), and the first i that gives it.
+ */
+template <class Func>
+Extremum minimumLocation(int first, int last, double init, Func f) {
+	return detail::extremum(first, last, init, f, [](double x, double y) { return x < y; });
+}
+
+/**
+ * @brief Returns the maximum of init and f(i) for every i in [first, last), and the first i that gives it.
+ */
+template <class Func>
+Extremum maximumLocation(int first, int last, double init, Func f) {
+	return detail::extremum(first, last, init, f, [](double x, double y) { return x > y; });
+}
+
+/**
+ * @brief Returns the sum of f(i) for every i in [first, last).
+ */
+template <class Func>
+int count(int first, int last, Func f) {
+	int result = 0;
+#pragma omp parallel for schedule(static) reduction(+:result)
+	for (int i = first; i < last; ++i)
+		result += f(i);
+	return result;
+}
+
+}
+
+#endif // PARALLEL_HPP_
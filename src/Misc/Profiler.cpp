@@ -0,0 +1,202 @@
+#include "Profiler.hpp"
+
+#include "IO/Logger.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const char* REGION_NAMES[(int)ProfileID::N] = {
+	"Torch::fullStep",
+	"Hydrodynamics::calcFluxes",
+	"Grid::applyBCs (pack)",
+	"Grid::applyBCs (MPI wait)",
+	"Grid::applyBCs (unpack)",
+	"Radiation::transferRadiation",
+	"Thermodynamics::integrate",
+	"Gravity::solve",
+	"Fluid::sweepRayTiles (receive)",
+	"Fluid::sweepRayTiles (trace)",
+	"Fluid::sweepRayTiles (send wait)",
+	"DataPrinter::print2D",
+	"DataPrinter::printCheckpoint",
+	"DataPrinter::printRestart",
+	"DataPrinter::flush",
+	"DataPrinter::printAnalysis",
+	"SliceRenderer::render",
+	"MPIW::minimum/maximum/sum",
+	"MPIW::barrier",
+	"MPIW::broadcast",
+	"MPIW::writeOrdered",
+	"MPIW::receivePartner"
+};
+
+const int NC = HardwareCounters::N;
+const int NFIELDS = 4 + NC; //!< Inclusive time, self time, calls, cells and each hardware count.
+const double CACHE_LINE_SIZE = 64; //!< Bytes moved by a last level cache miss.
+
+}
+
+const int Profiler::N;
+
+Profiler::ThreadData* Profiler::registerThread() {
+	std::lock_guard<std::mutex> lock(m_threadsMutex);
+	m_threads.emplace_back(new ThreadData());
+	m_threads.back()->tid = (int)m_threads.size() - 1;
+	return m_threads.back().get();
+}
+
+/**
+ * @brief Starts the hardware counters on every thread, to be read around the regions timed on the calling thread.
+ *
+ * Logs a warning and carries on without them if they are unavailable.
+ */
+void Profiler::enableCounters() {
+	std::string error = m_counters.open();
+	if (!error.empty()) {
+		Logger::Instance().print<SeverityType::WARNING>("Profiler::enableCounters: hardware counters are unavailable (",
+				error, ").\n");
+		return;
+	}
+	m_countingThread = &threadData();
+}
+
+/**
+ * @brief Appends the time spent in each region since the last report to a file and starts a new interval. Collective.
+ *
+ * The times of all threads are summed, then reduced to the minimum, mean and maximum over the processors; a large
+ * spread between them points at a load imbalance. The file is written by the master processor.
+ * @param filename Name of the profile file.
+ * @param label Description of the interval, e.g. the checkpoint it ends at.
+ * @exception std::runtime_error Thrown if the file cannot be opened.
+ */
+void Profiler::report(const std::string& filename, const std::string& label) {
+	MPIW& mpihandler = MPIW::Instance();
+	// The fields of each region, a block of N per field.
+	std::vector<double> local(NFIELDS*N, 0);
+	{
+		std::lock_guard<std::mutex> lock(m_threadsMutex);
+		for (std::unique_ptr<ThreadData>& thread : m_threads) {
+			for (int id = 0; id < N; ++id) {
+				local[id] += thread->seconds[id];
+				local[N + id] += thread->self[id];
+				local[2*N + id] += thread->calls[id];
+				local[3*N + id] += thread->cells[id];
+				for (int ic = 0; ic < NC; ++ic)
+					local[(4 + ic)*N + id] += thread->counts[id][ic];
+			}
+			thread->seconds.fill(0);
+			thread->self.fill(0);
+			thread->calls.fill(0);
+			thread->cells.fill(0);
+			thread->counts.fill(HardwareCounters::Counts());
+		}
+	}
+	std::vector<double> all = mpihandler.allGather(local);
+	if (mpihandler.getRank() != 0)
+		return;
+
+	std::ofstream out(filename, std::ios::app);
+	if (!out)
+		throw std::runtime_error("Profiler::report: unable to open " + filename + ".");
+	const int nproc = mpihandler.nProcessors();
+	long steps = (long)all[2*N + (int)ProfileID::STEP];
+	// The mean over the processors of a field of a region.
+	auto mean = [&](int field, int id) {
+		double sum = 0;
+		for (int iproc = 0; iproc < nproc; ++iproc)
+			sum += all[NFIELDS*N*iproc + field*N + id];
+		return sum/nproc;
+	};
+	long nsteps = std::max(1L, steps);
+	char line[192];
+	std::snprintf(line, sizeof(line), "# %s: %ld steps on %d processors.\n", label.c_str(), steps, nproc);
+	out << line;
+	std::snprintf(line, sizeof(line), "# %-32s %10s %12s %12s %12s %12s %14s\n", "region", "max calls", "min (s)", "mean (s)",
+			"max (s)", "self (s)", "per step (ms)");
+	out << line;
+	for (int id = 0; id < N; ++id) {
+		double tmin = all[id], tmax = all[id], calls = 0;
+		for (int iproc = 0; iproc < nproc; ++iproc) {
+			double t = all[NFIELDS*N*iproc + id];
+			tmin = std::min(tmin, t);
+			tmax = std::max(tmax, t);
+			calls = std::max(calls, all[NFIELDS*N*iproc + 2*N + id]);
+		}
+		double tmean = mean(0, id);
+		std::snprintf(line, sizeof(line), "  %-32s %10ld %12.4e %12.4e %12.4e %12.4e %14.4e\n", REGION_NAMES[id], (long)calls,
+				tmin, tmean, tmax, mean(1, id), 1.0e3*tmean/nsteps);
+		out << line;
+	}
+
+	if (m_counters.isOpen()) {
+		// Means over the processors, the per cell counts only for the regions timed with a cell count.
+		std::snprintf(line, sizeof(line), "# %-32s %8s %14s %14s %12s %14s\n", "region", "IPC", "cycles/cell",
+				"instr./cell", "LLC miss (%)", "memory (GB/s)");
+		out << line;
+		for (int id = 0; id < N; ++id) {
+			double t = mean(0, id), cells = mean(3, id);
+			double cycles = mean(4 + (int)CounterID::CYCLES, id);
+			double instructions = mean(4 + (int)CounterID::INSTRUCTIONS, id);
+			double references = mean(4 + (int)CounterID::CACHE_REFERENCES, id);
+			double misses = mean(4 + (int)CounterID::CACHE_MISSES, id);
+			if (cycles <= 0)
+				continue;
+			std::snprintf(line, sizeof(line), "  %-32s %8.3f %14.4g %14.4g %12.3f %14.4g\n", REGION_NAMES[id],
+					instructions/cycles, cells > 0 ? cycles/cells : 0.0, cells > 0 ? instructions/cells : 0.0,
+					references > 0 ? 100*misses/references : 0.0, t > 0 ? 1.0e-9*CACHE_LINE_SIZE*misses/t : 0.0);
+			out << line;
+		}
+	}
+	out << '\n';
+}
+
+/**
+ * @brief Starts recording every timed region for the trace, after synchronising the processors so their trace clocks
+ * start together. Collective.
+ */
+void Profiler::startTrace() {
+	MPIW::Instance().barrier();
+	std::lock_guard<std::mutex> lock(m_threadsMutex);
+	for (std::unique_ptr<ThreadData>& thread : m_threads)
+		thread->events.clear();
+	m_traceOrigin = std::chrono::steady_clock::now();
+	m_isTracing.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Stops recording and writes the regions recorded since startTrace() by every processor as a Chrome trace.
+ * Collective.
+ * @param filename Name of the trace file.
+ */
+void Profiler::writeTrace(const std::string& filename) {
+	m_isTracing.store(false, std::memory_order_relaxed);
+	MPIW& mpihandler = MPIW::Instance();
+	const int rank = mpihandler.getRank();
+
+	// Events are in microseconds; each processor is a process and each thread a track.
+	std::string text = rank == 0 ? "" : ",\n";
+	char line[256];
+	std::snprintf(line, sizeof(line), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"rank %d\"}}",
+			rank, rank);
+	text += line;
+	{
+		std::lock_guard<std::mutex> lock(m_threadsMutex);
+		for (std::unique_ptr<ThreadData>& thread : m_threads) {
+			for (const TraceEvent& event : thread->events) {
+				std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"torch\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+						REGION_NAMES[(int)event.id], 1.0e6*event.start, 1.0e6*event.duration, rank, thread->tid);
+				text += line;
+			}
+			thread->events.clear();
+		}
+	}
+	if (rank == mpihandler.nProcessors() - 1)
+		text += "\n]\n";
+
+	mpihandler.writeOrdered(filename, std::vector<char>{'[', '\n'}, text.data(), (int)text.size());
+}
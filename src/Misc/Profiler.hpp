@@ -0,0 +1,172 @@
+/** Provides the Profiler and ScopedTimer classes.
+ *
+ * @file Profiler.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef PROFILER_HPP_
+#define PROFILER_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "HardwareCounters.hpp"
+
+class ScopedTimer;
+
+/**
+ * @brief The timed regions of a simulation step (see Profiler).
+ */
+enum class ProfileID : unsigned int {STEP, HYDRO_FLUXES, BCS_PACK, BCS_WAIT, BCS_UNPACK, RADIATION_TRANSFER,
+	THERMO_INTEGRATE, GRAVITY, RAY_RECV, RAY_TILE, RAY_SEND_WAIT, PRINT_2D, PRINT_CHECKPOINT, PRINT_RESTART, PRINT_FLUSH,
+	PRINT_ANALYSIS, PRINT_RENDER, MPI_REDUCE, MPI_BARRIER, MPI_BROADCAST, MPI_WRITE, MPI_PARTNER, N};
+
+/**
+ * @class Profiler
+ *
+ * @brief A singleton that accumulates the time spent in each ProfileID region on this processor.
+ *
+ * Regions are timed by ScopedTimer objects and may nest, so each region has an inclusive time and a self time (the time
+ * not spent in the regions nested inside it). Every thread that times a region adds to its own accumulators, which are
+ * only summed by report(), so timing a region takes no locks. A timer costs two reads of the monotonic steady_clock,
+ * so the Profiler is always on.
+ *
+ * Hardware counters (see HardwareCounters) can be enabled too. They are then read around every region timed on the
+ * thread that enabled them, counting the events of all threads, and the report gives the instructions per cycle,
+ * the events per cell updated (for regions timed with a cell count) and the memory traffic estimated from the last level
+ * cache misses.
+ *
+ * At each checkpoint report() reduces the totals since the previous report to the minimum, mean and maximum over the
+ * processors and appends them to the profile file. Between startTrace() and writeTrace() every timed region is also
+ * recorded as an event, and writeTrace() writes the events of all processors as a Chrome trace (JSON array format,
+ * which chrome://tracing and Perfetto open), with a process per processor and a track per thread.
+ *
+ * report(), startTrace() and writeTrace() must be called while no other thread is timing a region.
+ */
+class Profiler {
+public:
+	static const int N = (int)ProfileID::N;
+
+	/**
+	 * @brief A region recorded for the trace.
+	 */
+	struct TraceEvent {
+		ProfileID id;
+		double start; //!< Time since startTrace() (s).
+		double duration; //!< Time spent in the region (s).
+	};
+
+	/**
+	 * @brief The accumulators of a thread.
+	 */
+	struct ThreadData {
+		int tid = 0; //!< Index of the thread in the order it first timed a region.
+		std::array<double, N> seconds = std::array<double, N>(); //!< Inclusive time in each region since the last report (s).
+		std::array<double, N> total = std::array<double, N>(); //!< Inclusive time in each region since the start of the run, which report() keeps (s).
+		std::array<double, N> self = std::array<double, N>(); //!< Self time in each region since the last report (s).
+		std::array<long, N> calls = std::array<long, N>(); //!< Number of times each region was entered since the last report.
+		std::array<double, N> cells = std::array<double, N>(); //!< Cells updated by each region since the last report.
+		std::array<HardwareCounters::Counts, N> counts = std::array<HardwareCounters::Counts, N>(); //!< Hardware events in each region since the last report.
+		ScopedTimer* current = nullptr; //!< Innermost region being timed on this thread.
+		std::vector<TraceEvent> events; //!< Regions recorded since startTrace().
+	};
+
+	static Profiler& Instance() {
+		static Profiler instance;
+		return instance;
+	}
+	static ThreadData& threadData() {
+		static thread_local ThreadData* data = nullptr;
+		if (data == nullptr)
+			data = Instance().registerThread();
+		return *data;
+	}
+
+	bool isTracing() const { return m_isTracing.load(std::memory_order_relaxed); }
+	std::chrono::steady_clock::time_point traceOrigin() const { return m_traceOrigin; }
+	bool isCounting(const ThreadData& thread) const { return &thread == m_countingThread; }
+	HardwareCounters::Counts readCounters() const { return m_counters.read(); }
+
+	void enableCounters();
+
+	void report(const std::string& filename, const std::string& label);
+	void startTrace();
+	void writeTrace(const std::string& filename);
+
+private:
+	std::mutex m_threadsMutex; //!< Guards m_threads while a thread registers.
+	std::vector<std::unique_ptr<ThreadData>> m_threads;
+	std::atomic<bool> m_isTracing{false};
+	std::chrono::steady_clock::time_point m_traceOrigin;
+	HardwareCounters m_counters;
+	const ThreadData* m_countingThread = nullptr; //!< Thread whose regions the hardware counters are read around.
+
+	ThreadData* registerThread();
+
+	Profiler() { };
+	Profiler(Profiler const&);
+	void operator=(Profiler const&);
+};
+
+/**
+ * @class ScopedTimer
+ *
+ * @brief Adds the time between its construction and destruction to a region of the Profiler, on the calling thread.
+ *
+ * The number of cells the region updates may be given, to normalise the hardware counts per cell.
+ */
+class ScopedTimer {
+public:
+	explicit ScopedTimer(ProfileID id, long cells = 0)
+	: m_id(id)
+	, m_thread(Profiler::threadData())
+	, m_parent(m_thread.current)
+	, m_isCounting(Profiler::Instance().isCounting(m_thread))
+	{
+		m_thread.current = this;
+		m_thread.cells[(unsigned int)id] += cells;
+		if (m_isCounting)
+			m_startCounts = Profiler::Instance().readCounters();
+		m_start = std::chrono::steady_clock::now();
+	}
+	~ScopedTimer() {
+		std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double>(stop - m_start).count();
+		unsigned int id = (unsigned int)m_id;
+		Profiler& profiler = Profiler::Instance();
+		if (m_isCounting) {
+			HardwareCounters::Counts counts = profiler.readCounters();
+			for (int ic = 0; ic < HardwareCounters::N; ++ic)
+				m_thread.counts[id][ic] += counts[ic] - m_startCounts[ic];
+		}
+		m_thread.current = m_parent;
+		m_thread.seconds[id] += elapsed;
+		m_thread.total[id] += elapsed;
+		m_thread.self[id] += elapsed - m_children;
+		++m_thread.calls[id];
+		if (m_parent != nullptr)
+			m_parent->m_children += elapsed;
+		if (profiler.isTracing() && m_start >= profiler.traceOrigin()) {
+			double start = std::chrono::duration<double>(m_start - profiler.traceOrigin()).count();
+			m_thread.events.push_back(Profiler::TraceEvent{m_id, start, elapsed});
+		}
+	}
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+private:
+	ProfileID m_id;
+	Profiler::ThreadData& m_thread;
+	ScopedTimer* m_parent;
+	bool m_isCounting; //!< Whether the hardware counters are read around this region.
+	HardwareCounters::Counts m_startCounts;
+	std::chrono::steady_clock::time_point m_start;
+	double m_children = 0; //!< Time spent in the regions nested inside this one (s).
+};
+
+#endif // PROFILER_HPP_
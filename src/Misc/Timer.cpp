@@ -3,8 +3,8 @@
 #include <sstream>
 
 Timer::Timer()
-: m_startTicks(std::chrono::system_clock::now())
-, m_pausedTicks(std::chrono::system_clock::now())
+: m_startTicks(std::chrono::steady_clock::now())
+, m_pausedTicks(std::chrono::steady_clock::now())
 , m_pausedDuration(Duration::zero())
 , m_isPaused(false)
 , m_isStarted(false)
@@ -16,7 +16,7 @@ void Timer::start() {
 	m_isStarted = true;
 	m_isPaused = false;
 
-	m_startTicks = std::chrono::system_clock::now();
+	m_startTicks = std::chrono::steady_clock::now();
 	m_pausedTicks = m_startTicks;
 	m_pausedDuration = Duration::zero();
 }
@@ -30,7 +30,7 @@ void Timer::pause() {
 	//If the timer is running and isn't already paused
 	if ( m_isStarted && !m_isPaused ) {
 		m_isPaused = true;
-		m_pausedTicks = std::chrono::system_clock::now();
+		m_pausedTicks = std::chrono::steady_clock::now();
 	}
 }
 
@@ -38,7 +38,7 @@ void Timer::unpause() {
 	//If the timer is running and paused
 	if ( m_isStarted && m_isPaused ) {
 		m_isPaused = false;
-		m_pausedDuration += std::chrono::system_clock::now() - m_pausedTicks;
+		m_pausedDuration += std::chrono::steady_clock::now() - m_pausedTicks;
 	}
 }
 
@@ -49,7 +49,7 @@ double Timer::getTicks() {
 		if ( m_isPaused )
 			dur = m_pausedTicks - m_startTicks - m_pausedDuration;
 		else
-			dur = std::chrono::system_clock::now() - m_startTicks - m_pausedDuration;
+			dur = std::chrono::steady_clock::now() - m_startTicks - m_pausedDuration;
 	}
 
 	return dur.count();
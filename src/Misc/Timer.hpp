@@ -12,7 +12,7 @@
 #include <string>
 
 class Timer {
-	using TimePoint = typename std::chrono::time_point<std::chrono::system_clock>;
+	using TimePoint = typename std::chrono::time_point<std::chrono::steady_clock>;
 	using Duration = typename std::chrono::duration<double>;
     public:
 		Timer();
@@ -0,0 +1,189 @@
+#include "Autotuner.hpp"
+
+#include "IO/FileManagement.hpp"
+#include "IO/Logger.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+/**
+ * @param trialSteps Steps timed with each value of each knob (0 turns the tuning off).
+ * @param cacheFile File the chosen settings are read from and written to.
+ * @param key Description of the run, which the cached settings must match to be used.
+ * @exception std::runtime_error Thrown if trialSteps is negative.
+ */
+void Autotuner::initialise(int trialSteps, const std::string& cacheFile, const std::string& key) {
+	if (trialSteps < 0)
+		throw std::runtime_error("Autotuner::initialise: autotune_steps(=" + std::to_string(trialSteps) + ") must not be negative.");
+	m_trialSteps = trialSteps;
+	m_cacheFile = cacheFile;
+	m_key = key;
+	m_knobs.clear();
+}
+
+/**
+ * @brief Adds an option to tune. Knobs are tuned in the order they are added.
+ * @param name Name of the option, as in the parameter file.
+ * @param values Values to try, the configured one first. Repeats are ignored.
+ * @param set Applies a value, between steps.
+ */
+void Autotuner::addKnob(const std::string& name, const std::vector<int>& values, const Setter& set) {
+	Knob knob;
+	knob.name = name;
+	for (int value : values)
+		if (std::find(knob.values.begin(), knob.values.end(), value) == knob.values.end())
+			knob.values.push_back(value);
+	knob.set = set;
+	m_key += " " + name;
+	for (int value : knob.values)
+		m_key += (value == knob.values.front() ? " " : ",") + std::to_string(value);
+	m_knobs.push_back(knob);
+}
+
+/**
+ * @brief Applies the cached settings if they were chosen for this run, or else starts tuning. Collective.
+ */
+void Autotuner::start() {
+	m_isTuning = false;
+	if (m_trialSteps == 0 || m_knobs.empty())
+		return;
+	if (readCache()) {
+		Logger::Instance().print<SeverityType::NOTICE>("Autotuner::start: ", describe(), " from ", m_cacheFile, ".\n");
+		return;
+	}
+	m_isTuning = true;
+	m_knob = 0;
+	nextKnob();
+}
+
+/**
+ * @brief Whether the steps are still being timed.
+ */
+bool Autotuner::isTuning() const {
+	return m_isTuning;
+}
+
+/**
+ * @brief Applies the value of the knob being tuned that the next step is timed with.
+ */
+void Autotuner::beginStep() {
+	if (!m_isTuning)
+		return;
+	const Knob& knob = m_knobs[m_knob];
+	knob.set(knob.values[m_trial%knob.values.size()]);
+}
+
+/**
+ * @brief Records the time of the step begun by beginStep and, once every value of the knob has had its trial steps,
+ * chooses the fastest. Collective.
+ * @param seconds Wall clock time of the step on this processor (s).
+ */
+void Autotuner::endStep(double seconds) {
+	if (!m_isTuning)
+		return;
+	Knob& knob = m_knobs[m_knob];
+	const int nvalues = (int)knob.values.size();
+	double& time = m_times[m_trial%nvalues];
+	time = std::min(time, seconds);
+	if (++m_trial < m_trialSteps*nvalues)
+		return;
+
+	// Every processor reaches the end of the knob at the same step.
+	m_times = MPIW::Instance().maximum(m_times);
+	knob.best = std::min_element(m_times.begin(), m_times.end()) - m_times.begin();
+	knob.set(knob.values[knob.best]);
+	std::ostringstream msg;
+	msg << "Autotuner::endStep: " << knob.name << " " << knob.values[knob.best] << " (";
+	for (int i = 0; i < nvalues; ++i)
+		msg << (i > 0 ? ", " : "") << knob.values[i] << " " << m_times[i] << " s";
+	msg << " per step).\n";
+	Logger::Instance().print<SeverityType::NOTICE>(msg.str());
+	++m_knob;
+	nextKnob();
+}
+
+/**
+ * @brief Moves on to the next knob with a choice to make, or finishes if there is none.
+ */
+void Autotuner::nextKnob() {
+	while (m_knob < m_knobs.size() && m_knobs[m_knob].values.size() < 2)
+		++m_knob;
+	if (m_knob == m_knobs.size()) {
+		finish();
+		return;
+	}
+	m_trial = 0;
+	m_times.assign(m_knobs[m_knob].values.size(), std::numeric_limits<double>::infinity());
+}
+
+/**
+ * @brief Logs the chosen settings and writes them to the cache file.
+ */
+void Autotuner::finish() {
+	m_isTuning = false;
+	Logger::Instance().print<SeverityType::NOTICE>("Autotuner::finish: ", describe(), ", cached in ", m_cacheFile, ".\n");
+	if (MPIW::Instance().getRank() != 0)
+		return;
+	FileManagement::makeDirectoryPath(m_cacheFile.substr(0, m_cacheFile.find_last_of('/')));
+	std::ofstream file(m_cacheFile);
+	file << m_key << "\n";
+	for (const Knob& knob : m_knobs)
+		file << knob.name << " " << knob.values[knob.best] << "\n";
+	if (!file)
+		Logger::Instance().print<SeverityType::WARNING>("Autotuner::finish: unable to write ", m_cacheFile, ".\n");
+}
+
+/**
+ * @brief Applies the settings of the cache file if its key is that of this run and it has a valid value of every knob.
+ * Collective.
+ */
+bool Autotuner::readCache() {
+	std::string contents;
+	MPIW& mpihandler = MPIW::Instance();
+	if (mpihandler.getRank() == 0) {
+		std::ifstream file(m_cacheFile);
+		if (file)
+			contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	mpihandler.broadcastString(contents, 0);
+
+	std::istringstream lines(contents);
+	std::string key;
+	if (!std::getline(lines, key) || key != m_key)
+		return false;
+	std::map<std::string, int> cached;
+	std::string name;
+	int value = 0;
+	while (lines >> name >> value)
+		cached[name] = value;
+	std::vector<int> best;
+	for (const Knob& knob : m_knobs) {
+		auto it = cached.find(knob.name);
+		if (it == cached.end())
+			return false;
+		auto found = std::find(knob.values.begin(), knob.values.end(), it->second);
+		if (found == knob.values.end())
+			return false;
+		best.push_back(found - knob.values.begin());
+	}
+	for (unsigned int i = 0; i < m_knobs.size(); ++i) {
+		m_knobs[i].best = best[i];
+		m_knobs[i].set(m_knobs[i].values[best[i]]);
+	}
+	return true;
+}
+
+/**
+ * @brief Lists the chosen value of every knob.
+ */
+std::string Autotuner::describe() const {
+	std::string text;
+	for (const Knob& knob : m_knobs)
+		text += (text.empty() ? "" : ", ") + knob.name + " " + std::to_string(knob.values[knob.best]);
+	return text;
+}
@@ -0,0 +1,64 @@
+/** Provides the Autotuner class.
+ *
+ * @file Autotuner.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef AUTOTUNER_HPP_
+#define AUTOTUNER_HPP_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @class Autotuner
+ *
+ * @brief Chooses the fastest settings of the performance options that can change between steps (the threads per
+ * processor, the hydrodynamic tile size, the fused updates...) by timing the first steps of the run under each.
+ *
+ * Every option, or knob, lists the values it may take with the configured one first, and is tuned in turn with the
+ * others held at their best so far. The trial steps of a knob cycle through its values, trialSteps times each, so the
+ * changing cost of the early steps is spread over all of them. A value's time is the fastest of its steps on the
+ * slowest processor, and the knob is left at the value with the shortest time. The trial steps are steps of the run,
+ * since the options change how a step is computed rather than what it computes (though the fused and separate updates
+ * may fix the cells at the floors differently).
+ *
+ * The choice is logged and written to a cache file along with a key describing the run, e.g. its grid and processors,
+ * and a later run with the same key applies the cached settings without tuning.
+ */
+class Autotuner {
+public:
+	typedef std::function<void(int)> Setter; //!< Applies a value of a knob.
+
+	void initialise(int trialSteps, const std::string& cacheFile, const std::string& key);
+	void addKnob(const std::string& name, const std::vector<int>& values, const Setter& set);
+	void start();
+	bool isTuning() const;
+	void beginStep();
+	void endStep(double seconds);
+
+private:
+	struct Knob {
+		std::string name;
+		std::vector<int> values; //!< Values to try, the configured one first.
+		Setter set;
+		int best = 0; //!< Index of the fastest value found, or of the configured one before it is tuned.
+	};
+	std::vector<Knob> m_knobs;
+	int m_trialSteps = 0; //!< Steps timed with each value of a knob (0 for no tuning).
+	std::string m_cacheFile; //!< File the chosen settings are cached in.
+	std::string m_key; //!< Description of the run that the cached settings apply to.
+	bool m_isTuning = false;
+	unsigned int m_knob = 0; //!< Knob being tuned.
+	int m_trial = 0; //!< Trial steps taken of the knob.
+	std::vector<double> m_times; //!< Fastest step so far with each value of the knob (s).
+
+	bool readCache();
+	void nextKnob();
+	void finish();
+	std::string describe() const;
+};
+
+#endif // AUTOTUNER_HPP_
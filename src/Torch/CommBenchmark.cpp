@@ -0,0 +1,157 @@
+#include "CommBenchmark.hpp"
+
+#include "Fluid/Fluid.hpp"
+#include "IO/Logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+/**
+ * @brief Replays the communication of a Fluid, whose Grid has been initialised.
+ */
+CommBenchmark::CommBenchmark(Fluid& fluid)
+: m_fluid(fluid)
+{ }
+
+/**
+ * @brief Times every class of message and writes the results. Collective.
+ * @param repetitions Number of times each class is replayed.
+ * @param filename File the root processor writes the table of results to.
+ * @exception std::runtime_error Thrown if repetitions is not positive.
+ */
+void CommBenchmark::run(int repetitions, const std::string& filename) {
+	if (repetitions < 1)
+		throw std::runtime_error("CommBenchmark::run: comm-bench(=" + std::to_string(repetitions) + ") must be positive.");
+	std::vector<MessageClass> classes;
+	classes.push_back(timeHalo(repetitions));
+	// Radiation relays the optical depths and their time averages, Thermodynamics the column densities and their increments.
+	classes.push_back(timeRelay("radiation relay", SendID::RADIATION_MSG, 4, repetitions));
+	classes.push_back(timeRelay("thermodynamics relay", SendID::THERMO_MSG, 2, repetitions));
+	classes.push_back(timeReduction(repetitions));
+	report(classes, filename);
+}
+
+/**
+ * @brief Times the halo exchange of the hydrodynamic variables, Grid::applyBCs.
+ */
+CommBenchmark::MessageClass CommBenchmark::timeHalo(int repetitions) {
+	Grid& grid = m_fluid.getGrid();
+	MessageClass halo;
+	halo.name = "hydro halo";
+	halo.messages = grid.getHydroHalo().getMessageCount();
+	halo.bytes = grid.getHydroHalo().getSendCount()*(long)sizeof(double);
+	MPIW& mpihandler = MPIW::Instance();
+	for (int i = 0; i < repetitions; ++i) {
+		mpihandler.barrier();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		grid.applyBCs();
+		halo.seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return halo;
+}
+
+/**
+ * @brief Times a relay of the column densities from the Star across the Grid, a Fluid::sweepRayTiles that traces
+ * nothing and packs itemsPerCell zeros for every cell next to a boundary.
+ */
+CommBenchmark::MessageClass CommBenchmark::timeRelay(const std::string& name, SendID tag, int itemsPerCell, int repetitions) {
+	Grid& grid = m_fluid.getGrid();
+	const Star& star = m_fluid.getStar();
+	MessageClass relay;
+	relay.name = name;
+	const std::vector<Bound>& boundaries = grid.getBoundaries();
+	for (const RayTile& tile : grid.getRayTiles()) {
+		for (unsigned int ib = 0; ib < boundaries.size(); ++ib) {
+			if (star.isDownstream(boundaries[ib])) {
+				++relay.messages;
+				relay.bytes += (long)tile.ghostIDs[ib].size()*itemsPerCell*(long)sizeof(double);
+			}
+		}
+	}
+	MPIW& mpihandler = MPIW::Instance();
+	for (int i = 0; i < repetitions; ++i) {
+		mpihandler.barrier();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		m_fluid.sweepRayTiles(tag,
+			[&](GridCell&, PartitionManager& partition) {
+				for (int item = 0; item < itemsPerCell; ++item)
+					partition.getRecvItem();
+			},
+			[](const RayTile&) {},
+			[&](const GridCell&, PartitionManager& partition) {
+				for (int item = 0; item < itemsPerCell; ++item)
+					partition.addSendItem(0);
+			});
+		relay.seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return relay;
+}
+
+/**
+ * @brief Times the reduction of the CFL time step to its minimum over the processors.
+ */
+CommBenchmark::MessageClass CommBenchmark::timeReduction(int repetitions) {
+	MessageClass reduction;
+	reduction.name = "CFL allreduce";
+	reduction.messages = 1;
+	reduction.bytes = sizeof(double);
+	MPIW& mpihandler = MPIW::Instance();
+	double dt = 1;
+	for (int i = 0; i < repetitions; ++i) {
+		mpihandler.barrier();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		dt = mpihandler.minimum(dt);
+		reduction.seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return reduction;
+}
+
+/**
+ * @brief Writes, on the root processor, the messages and bytes per repetition, latency, mean time and bandwidth of every
+ * class of message to the file and the log. Collective.
+ */
+void CommBenchmark::report(const std::vector<MessageClass>& classes, const std::string& filename) const {
+	MPIW& mpihandler = MPIW::Instance();
+	const int nproc = mpihandler.nProcessors();
+	std::vector<std::string> lines;
+	char line[192];
+	std::snprintf(line, sizeof(line), "# %d repetitions on %d processors.\n", (int)classes[0].seconds.size(), nproc);
+	lines.push_back(line);
+	std::snprintf(line, sizeof(line), "# %-22s %12s %14s %12s %12s %12s %14s\n", "class", "max messages", "max bytes",
+			"latency (s)", "mean (s)", "max (s)", "bandwidth (GB/s)");
+	lines.push_back(line);
+	for (const MessageClass& c : classes) {
+		// Each repetition takes as long as its slowest processor.
+		const std::vector<double> seconds = mpihandler.maximum(c.seconds);
+		const std::vector<double> counts = mpihandler.allGather(std::vector<double>{ (double)c.messages, (double)c.bytes });
+		double messages = 0, bytes = 0, totalBytes = 0;
+		for (int iproc = 0; iproc < nproc; ++iproc) {
+			messages = std::max(messages, counts[2*iproc]);
+			bytes = std::max(bytes, counts[2*iproc + 1]);
+			totalBytes += counts[2*iproc + 1];
+		}
+		double tmin = seconds[0], tmax = seconds[0], tmean = 0;
+		for (double t : seconds) {
+			tmin = std::min(tmin, t);
+			tmax = std::max(tmax, t);
+			tmean += t/seconds.size();
+		}
+		std::snprintf(line, sizeof(line), "  %-22s %12ld %14ld %12.4e %12.4e %12.4e %14.4e\n", c.name.c_str(), (long)messages,
+				(long)bytes, tmin, tmean, tmax, tmean > 0 ? 1.0e-9*totalBytes/tmean : 0.0);
+		lines.push_back(line);
+	}
+	if (mpihandler.getRank() != 0)
+		return;
+
+	std::ofstream out(filename);
+	if (!out)
+		throw std::runtime_error("CommBenchmark::report: unable to open " + filename + ".");
+	std::string table;
+	for (const std::string& l : lines)
+		table += l;
+	out << table;
+	Logger::Instance().print<SeverityType::NOTICE>("Communication benchmark (see ", filename, "):\n", table);
+}
@@ -0,0 +1,56 @@
+/** Provides the CommBenchmark class.
+ *
+ * @file CommBenchmark.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef COMMBENCHMARK_HPP_
+#define COMMBENCHMARK_HPP_
+
+#include <string>
+#include <vector>
+
+#include "MPI/MPI_Wrapper.hpp"
+
+class Fluid;
+
+/**
+ * @class CommBenchmark
+ *
+ * @brief Replays the communication of a step over the real decomposition of a Grid, without any of the physics, to
+ * time the network apart from the computation (torch --comm-bench).
+ *
+ * Each class of message is replayed through the same code as a step: the halo exchange of the hydrodynamic variables
+ * (Grid::applyBCs), the relays of the radiation and thermodynamics column densities between processors (a
+ * Fluid::sweepRayTiles with no tracing, packing as many doubles per cell as the real sweeps) and the reduction of the
+ * CFL time step. Each repetition starts after a barrier and is timed on every processor. A repetition takes as long as
+ * its slowest processor, so the latency of a class is the shortest of those times and its bandwidth the bytes all the
+ * processors send in a repetition over their mean.
+ */
+class CommBenchmark {
+public:
+	CommBenchmark(Fluid& fluid);
+
+	void run(int repetitions, const std::string& filename);
+
+private:
+	/**
+	 * @brief The messages of one class and the time each repetition took.
+	 */
+	struct MessageClass {
+		std::string name;
+		long messages = 0; //!< Messages this processor sends per repetition.
+		long bytes = 0; //!< Bytes this processor sends per repetition.
+		std::vector<double> seconds; //!< Time of each repetition on this processor (s).
+	};
+
+	Fluid& m_fluid;
+
+	MessageClass timeHalo(int repetitions);
+	MessageClass timeRelay(const std::string& name, SendID tag, int itemsPerCell, int repetitions);
+	MessageClass timeReduction(int repetitions);
+	void report(const std::vector<MessageClass>& classes, const std::string& filename) const;
+};
+
+#endif // COMMBENCHMARK_HPP_
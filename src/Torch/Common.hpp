@@ -20,28 +20,78 @@ class GridJoin;
 template <class T, size_t ROW, size_t COL>
 using Array2D = std::array<std::array<T, COL>, ROW>;
 
+/**
+ * Most dimensions a Grid can have, which is the number of velocity components of the fluid state (FluidArray) and of
+ * the gravitational force density (GravArray). A build with TORCH_MAX_DIMENSIONS=2 runs 1D and 2D problems with one
+ * fewer fluid variable in every cell and in every flux, instead of a velocity component that is always zero.
+ */
+#ifndef TORCH_MAX_DIMENSIONS
+#define TORCH_MAX_DIMENSIONS 3
+#endif
+
+/**
+ * Whether the radiative transfer and the heating and cooling are built, which they are unless TORCH is built with
+ * TORCH_NO_RADIATION or TORCH_NO_THERMO (TORCH_WITH_RADIATION=OFF or TORCH_WITH_THERMO=OFF in CMake). Without them
+ * the cells have no radiation (RadArray) or thermodynamic (ThermoArray) variables, RID::N or TID::N being 0, so a build
+ * for hydrodynamics alone holds and moves only the variables it uses. The integrators are still compiled, but cannot
+ * be turned on.
+ */
+#ifdef TORCH_NO_RADIATION
+constexpr bool RADIATION_BUILT = false;
+#else
+constexpr bool RADIATION_BUILT = true;
+#endif
+#ifdef TORCH_NO_THERMO
+constexpr bool THERMO_BUILT = false;
+#else
+constexpr bool THERMO_BUILT = true;
+#endif
+
 struct UID {
-	enum ID {DEN, PRE, HII, ADV, VEL, N=7};
+	enum ID {DEN, PRE, HII, ADV, VEL, N=VEL+TORCH_MAX_DIMENSIONS};
 };
 struct RID {
-	enum ID {HII_A, TAU, TAU_A, DTAU, DTAU_A, HEAT, N};
+	enum ID {HII_A, TAU, TAU_A, DTAU, DTAU_A, HEAT, N=RADIATION_BUILT ? HEAT+1 : 0};
 };
 struct TID {
-	enum ID {COL_DEN, DCOL_DEN, HEAT, RATE, N};
+	enum ID {COL_DEN, DCOL_DEN, HEAT, RATE, N=THERMO_BUILT ? RATE+1 : 0};
 };
 struct HID {
 	enum ID {IMLC, NMLC, RHII, CEHI, CIEC, NMC, EUVH, FUVH, IRH, CRH, TOT, N};
 };
+struct SID {
+	enum ID {H2, CO, N}; //!< Molecular species of the chemistry network (see Chemistry).
+};
+struct WID {
+	enum ID {HII_ITERATIONS, COOLING_SUBSTEPS, DEN_FLOOR, PRE_FLOOR, TEMP_FLOOR, N}; //!< Per-cell work counters (see Grid::countsWork).
+};
 
 enum class Geometry : unsigned int {CARTESIAN, CYLINDRICAL, SPHERICAL};
 enum class Condition : unsigned int {FREE, REFLECTING, OUTFLOW, INFLOW, PERIODIC, PARTITION};
 enum class Scheme : unsigned int {IMPLICIT, IMPLICIT2, EXPLICIT};
+enum class HIISolver : unsigned int {FIXED_POINT, NEWTON}; //!< Root finder for the time averaged HII fraction of the implicit schemes.
 enum class Coupling : unsigned int {TWO_TEMP_ISOTHERMAL, NON_EQUILIBRIUM, OFF};
+enum class CheckLevel : unsigned int {OFF, CHECKPOINT, STEP, PARANOID}; //!< How often the Fluid state is checked for invalid values.
+enum class SnapshotFormat : unsigned int {TEXT, BINARY, HDF5}; //!< File format of the data2D snapshots.
+enum class SnapshotPrecision : unsigned int {FLOAT64, FLOAT32, QUANTISED}; //!< Storage of the values of the binary snapshots.
+enum class GravityModel : unsigned int {FIELD, NONE, POINT_MASS, ISOTHERMAL_SPHERE, UNIFORM}; //!< Source of the external gravitational force (see GravityField).
+
+/**
+ * Storage type of the cold per-cell data that only the ray tracers and diagnostics read (RayGeometry, HeatArray), which
+ * is single precision if TORCH is built with TORCH_SINGLE_PRECISION_STORAGE. It is always computed in double.
+ */
+#ifdef TORCH_SINGLE_PRECISION_STORAGE
+using StorageReal = float;
+#else
+using StorageReal = double;
+#endif
 
 using FluidArray = std::array<double, UID::N>;
 using RadArray = std::array<double, RID::N>;
 using ThermoArray = std::array<double, TID::N>;
-using HeatArray = std::array<double, HID::N>;
+using HeatArray = std::array<StorageReal, HID::N>;
+using WorkArray = std::array<unsigned int, WID::N>;
+using GravArray = std::array<double, TORCH_MAX_DIMENSIONS>;
 using Vec3 = std::array<double, 3>;
 using Coords = std::array<int, 3>;
 
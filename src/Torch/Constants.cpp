@@ -22,6 +22,26 @@ Constants::Constants() {
 	couplingParser.enumMap["neq"] = Coupling::NON_EQUILIBRIUM;
 	couplingParser.enumMap["off"] = Coupling::OFF;
 	couplingParser.enumMap["default"] = Coupling::OFF;
+
+	checkLevelParser.enumMap["off"] = CheckLevel::OFF;
+	checkLevelParser.enumMap["checkpoint"] = CheckLevel::CHECKPOINT;
+	checkLevelParser.enumMap["step"] = CheckLevel::STEP;
+	checkLevelParser.enumMap["paranoid"] = CheckLevel::PARANOID;
+	checkLevelParser.enumMap["default"] = CheckLevel::STEP;
+
+	snapshotFormatParser.enumMap["text"] = SnapshotFormat::TEXT;
+	snapshotFormatParser.enumMap["binary"] = SnapshotFormat::BINARY;
+	snapshotFormatParser.enumMap["hdf5"] = SnapshotFormat::HDF5;
+	snapshotFormatParser.enumMap["default"] = SnapshotFormat::TEXT;
+	snapshotPrecisionParser.enumMap["float64"] = SnapshotPrecision::FLOAT64;
+	snapshotPrecisionParser.enumMap["float32"] = SnapshotPrecision::FLOAT32;
+	snapshotPrecisionParser.enumMap["quantised"] = SnapshotPrecision::QUANTISED;
+
+	gravityModelParser.enumMap["field"] = GravityModel::FIELD;
+	gravityModelParser.enumMap["none"] = GravityModel::NONE;
+	gravityModelParser.enumMap["point_mass"] = GravityModel::POINT_MASS;
+	gravityModelParser.enumMap["isothermal_sphere"] = GravityModel::ISOTHERMAL_SPHERE;
+	gravityModelParser.enumMap["uniform"] = GravityModel::UNIFORM;
 }
 
 void Constants::initialise() {
@@ -31,6 +51,7 @@ void Constants::initialise() {
 	rydbergEnergy = converter.toCodeUnits(converter.EV_2_ERGS(13.6), 1, 2, -2);
 	dustExtinctionCrossSection = converter.toCodeUnits(5.0e-22, 0, 2, 0);
 	pi = 3.14159265359;
+	gravitationalConst = converter.toCodeUnits(6.674e-8, -1, 3, -2);
 
 	voronov_A = converter.toCodeUnits(2.91e-8, 0, 3, -1);
 	voronov_X = 0.232;
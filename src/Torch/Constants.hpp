@@ -65,11 +65,13 @@ public:
 	double dustExtinctionCrossSection = 0; //!< Dust Extinction Cross Section (Baldwin et. al. 1991) [cm2 H-1].
 	double hydrogenMass = 0; //!< Mass of hydrogen in g.
 	double pi = 0; //!< PI.
+	double gravitationalConst = 0; //!< Gravitational Constant.
 
 	int nd = 3; //!< Number of Dimensions.
 	double dfloor = 0;
 	double pfloor = 0;
 	double tfloor = 0;
+	CheckLevel checkLevel = CheckLevel::STEP; //!< How often the Fluid state is validated (see Torch::checkValues).
 
 	//Voronov (1997,ADANDT,65,1).
 	double voronov_A = 0; //!< Constant A from Voronov (1997,ADANDT,65,1).
@@ -82,6 +84,10 @@ public:
 	EnumParser<Condition> conditionParser;
 	EnumParser<Scheme> schemeParser;
 	EnumParser<Coupling> couplingParser;
+	EnumParser<CheckLevel> checkLevelParser;
+	EnumParser<SnapshotFormat> snapshotFormatParser;
+	EnumParser<SnapshotPrecision> snapshotPrecisionParser;
+	EnumParser<GravityModel> gravityModelParser;
 
 
 private:
@@ -5,13 +5,14 @@
 
 
 Converter::Converter() : M(MO_2_G(1.0)), L(PC_2_CM(14.6)), T(YR_2_S(10000.0)) {
-
+	updateFactors();
 }
 
 void Converter::set_mass_length_time(const double mass, const double length, const double time) {
 	M = (mass > 0) ? mass : M;
 	L = (length > 0) ? length : L;
 	T = (time > 0) ? time : T;
+	updateFactors();
 }
 
 void Converter::set_rho_pressure_time(const double rho, const double pressure, const double time) {
@@ -22,6 +23,7 @@ void Converter::set_rho_pressure_time(const double rho, const double pressure, c
 	T = time_0;
 	M = std::sqrt((pressure_0/rho_0)*pressure_0*pressure_0)*T*T*T;
 	L = std::sqrt(pressure_0/rho_0)*T;
+	updateFactors();
 }
 
 double Converter::toCodeUnits(const double val, const double mass_index, const double length_index, const double time_index) const {
@@ -32,6 +34,59 @@ double Converter::fromCodeUnits(const double val, const double mass_index, const
 	return convertCodeUnits(val, mass_index, length_index, time_index, false);
 }
 
+/**
+ * @brief The conversion factors of the quantity of dimensions mass^mass_index length^length_index time^time_index.
+ */
+UnitFactor Converter::factor(const double mass_index, const double length_index, const double time_index) const {
+	UnitFactor f;
+	f.toCode = convertCodeUnits(1.0, mass_index, length_index, time_index, true);
+	f.fromCode = convertCodeUnits(1.0, mass_index, length_index, time_index, false);
+	return f;
+}
+
+void Converter::updateFactors() {
+	m_mass = factor(1, 0, 0);
+	m_length = factor(0, 1, 0);
+	m_time = factor(0, 0, 1);
+	m_density = factor(1, -3, 0);
+	m_pressure = factor(1, -1, -2);
+	m_velocity = factor(0, 1, -1);
+	m_forceDensity = factor(1, -2, -2);
+	m_heatingRate = factor(1, -1, -3);
+}
+
+const UnitFactor& Converter::mass() const {
+	return m_mass;
+}
+
+const UnitFactor& Converter::length() const {
+	return m_length;
+}
+
+const UnitFactor& Converter::time() const {
+	return m_time;
+}
+
+const UnitFactor& Converter::density() const {
+	return m_density;
+}
+
+const UnitFactor& Converter::pressure() const {
+	return m_pressure;
+}
+
+const UnitFactor& Converter::velocity() const {
+	return m_velocity;
+}
+
+const UnitFactor& Converter::forceDensity() const {
+	return m_forceDensity;
+}
+
+const UnitFactor& Converter::heatingRate() const {
+	return m_heatingRate;
+}
+
 double Converter::convertCodeUnits(const double val, const double mass_index, const double length_index, const double time_index,
 		const bool& to_code_units) const {
 	double MM, LL, TT;
@@ -9,11 +9,23 @@
 #ifndef CONVERTER_HPP_
 #define CONVERTER_HPP_
 
+/**
+ * @brief Conversion factors between code units and cgs units of one quantity.
+ */
+struct UnitFactor {
+	double toCode = 1; //!< Code units per cgs unit.
+	double fromCode = 1; //!< cgs units per code unit.
+};
+
 /**
  * @class Converter
  *
  * @brief Converts values to/from code units from/to cgs real units.
  *
+ * The factors of the quantities converted per cell (density, pressure, velocity and so on) are precomputed whenever the
+ * code units are set, so converting a value is one multiplication, e.g. x*converter.density().fromCode. toCodeUnits
+ * and fromCodeUnits convert any other combination of mass, length and time.
+ *
  * @version 0.8, 24/11/2014
  */
 class Converter {
@@ -24,6 +36,15 @@ public:
 	double toCodeUnits(const double val, const double mass_index, const double length_index, const double time_index) const;
 	double fromCodeUnits(const double val, const double mass_index, const double length_index, const double time_index) const;
 
+	const UnitFactor& mass() const;
+	const UnitFactor& length() const;
+	const UnitFactor& time() const;
+	const UnitFactor& density() const;
+	const UnitFactor& pressure() const;
+	const UnitFactor& velocity() const;
+	const UnitFactor& forceDensity() const;
+	const UnitFactor& heatingRate() const;
+
 	double EV_2_ERGS(double val_in_ev) const;
 	double ERG_2_EV(double val_in_yr) const;
 	double YR_2_S(double val_in_yr) const;
@@ -33,6 +54,14 @@ public:
 	double MO_2_G(double val_in_yr) const;
 private:
 	double M = 0, L = 0, T = 0;
+	UnitFactor m_mass, m_length, m_time; //!< g, cm and s.
+	UnitFactor m_density; //!< g cm^-3.
+	UnitFactor m_pressure; //!< dyn cm^-2, as well as energy densities.
+	UnitFactor m_velocity; //!< cm s^-1.
+	UnitFactor m_forceDensity; //!< dyn cm^-3, of the gravitational force on each cell.
+	UnitFactor m_heatingRate; //!< erg cm^-3 s^-1.
+	UnitFactor factor(const double mass_index, const double length_index, const double time_index) const;
+	void updateFactors();
 	double convertCodeUnits(const double val, const double mass_index, const double length_index, const double time_index, const bool& from) const;
 };
 
@@ -0,0 +1,245 @@
+#include "IOBenchmark.hpp"
+
+#include "Fluid/Fluid.hpp"
+#include "IO/DataPrinter.hpp"
+#include "IO/DataReader.hpp"
+#include "IO/FileManagement.hpp"
+#include "IO/Logger.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+#include "Torch/Constants.hpp"
+#include "Torch/Parameters.hpp"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+/**
+ * @param fluid The Fluid, whose Grid has been initialised.
+ * @param consts The run's Constants.
+ * @param directory Directory the snapshots of each backend are written under.
+ * @param variables Variables of the binary and HDF5 snapshots (see DataPrinter::initialiseSnapshots).
+ * @param compressionLevel zlib level of the gzipped text.
+ */
+IOBenchmark::IOBenchmark(Fluid& fluid, std::shared_ptr<Constants> consts, const std::string& directory,
+		const std::string& variables, int compressionLevel)
+: m_fluid(fluid)
+, m_consts(std::move(consts))
+, m_directory(directory)
+, m_variables(variables)
+, m_compressionLevel(compressionLevel)
+{ }
+
+/**
+ * @brief Writes and reads back the snapshots of every backend and writes the results. Collective.
+ * @param snapshots Number of snapshots written by each backend.
+ * @param filename File the root processor writes the table of results to.
+ * @exception std::runtime_error Thrown if snapshots is not positive.
+ */
+void IOBenchmark::run(int snapshots, const std::string& filename) {
+	if (snapshots < 1)
+		throw std::runtime_error("IOBenchmark::run: io-bench(=" + std::to_string(snapshots) + ") must be positive.");
+	Grid& grid = m_fluid.getGrid();
+	m_initial.assign(grid.getCells().size(), FluidArray());
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS))
+		std::copy(std::begin(cell.Q), std::end(cell.Q), m_initial[cell.id].begin());
+	std::vector<Result> results;
+	for (const Backend& backend : backends())
+		results.push_back(time(backend, snapshots));
+	report(results, filename);
+}
+
+/**
+ * @brief The backends built into this TORCH.
+ */
+std::vector<IOBenchmark::Backend> IOBenchmark::backends() const {
+	std::vector<Backend> list;
+	Backend text;
+	text.name = "text";
+	list.push_back(text);
+	text.name = "text async";
+	text.async = true;
+	list.push_back(text);
+	Backend binary;
+	binary.name = "binary float64";
+	binary.format = SnapshotFormat::BINARY;
+	list.push_back(binary);
+	binary.name = "binary float32";
+	binary.precision = SnapshotPrecision::FLOAT32;
+	list.push_back(binary);
+	binary.name = "binary deltas";
+	binary.precision = SnapshotPrecision::FLOAT64;
+	binary.keyframeEvery = 4;
+	list.push_back(binary);
+#ifdef TORCH_HDF5
+	Backend hdf5;
+	hdf5.name = "hdf5";
+	hdf5.format = SnapshotFormat::HDF5;
+	hdf5.readable = false;
+	list.push_back(hdf5);
+#endif
+	return list;
+}
+
+/**
+ * @brief Fills the cells within a sphere about the centre of the grid, of radius growing with the snapshot to half the
+ * grid's diagonal at the last, with waves and a little noise about their initial state, the rest being left as they are.
+ */
+void IOBenchmark::fill(int snapshot, int snapshots) {
+	Grid& grid = m_fluid.getGrid();
+	const int nd = m_consts->nd;
+	double halfDiagonal2 = 0;
+	for (int idim = 0; idim < nd; ++idim)
+		halfDiagonal2 += 0.25*grid.ncells[idim]*grid.ncells[idim];
+	const double radius2 = halfDiagonal2*std::pow((snapshot + 1.0)/snapshots, 2);
+	const double phase = 0.3*snapshot;
+	for (GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		double r2 = 0, x = 0;
+		for (int idim = 0; idim < nd; ++idim) {
+			const double d = cell.xc[idim] + 0.5 - 0.5*grid.ncells[idim];
+			r2 += d*d;
+			x += (idim + 1)*cell.xc[idim];
+		}
+		if (r2 > radius2)
+			continue;
+		// A hash of the cell and snapshot, so the noise does not repeat between them.
+		std::uint32_t h = (std::uint32_t)cell.id*2654435761u ^ (std::uint32_t)(snapshot + 1)*40503u;
+		h ^= h >> 15;
+		h *= 2246822519u;
+		h ^= h >> 13;
+		const double noise = 1.0e-3*(2.0*(h & 0xffff)/65535.0 - 1.0);
+		const double wave = std::sin(0.05*x + phase);
+		const FluidArray& initial = m_initial[cell.id];
+		cell.Q[UID::DEN] = initial[UID::DEN]*(1.0 + 0.5*wave + noise);
+		cell.Q[UID::PRE] = initial[UID::PRE]*(1.0 + 0.5*wave + noise);
+		cell.Q[UID::HII] = cell.Q[UID::ADV] = 0.5 + 0.5*wave;
+		const double soundSpeed = std::sqrt(cell.Q[UID::PRE]/cell.Q[UID::DEN]);
+		for (int idim = 0; idim < nd; ++idim)
+			cell.Q[UID::VEL + idim] = soundSpeed*wave*(1.0 + noise*(idim + 1));
+	}
+	m_fluid.globalUfromQ();
+}
+
+/**
+ * @brief Writes the snapshots of a backend to a directory of its own, emptied first, and reads them back.
+ */
+IOBenchmark::Result IOBenchmark::time(const Backend& backend, int snapshots) {
+	MPIW& mpihandler = MPIW::Instance();
+	Grid& grid = m_fluid.getGrid();
+	Result result;
+	result.name = backend.name;
+	result.snapshots = snapshots;
+	std::string directory = m_directory + "/" + backend.name;
+	std::replace(directory.begin(), directory.end(), ' ', '_');
+	if (mpihandler.getRank() == 0) {
+		if (FileManagement::makeDirectoryPath(directory) != 0)
+			throw std::runtime_error("IOBenchmark::time: unable to create " + directory + ".");
+		FileManagement::deleteFileContents(directory);
+	}
+	mpihandler.barrier();
+
+	std::vector<std::string> names;
+	{
+		DataPrinter printer;
+		printer.initialise(m_consts, directory, backend.format, backend.async, m_compressionLevel);
+		printer.initialiseSnapshots(m_variables, backend.precision, backend.keyframeEvery, 0);
+		const std::string extension = backend.format == SnapshotFormat::TEXT ? ".txt.gz" : ".tsnp";
+		for (int i = 0; i < snapshots; ++i) {
+			char suffix[16];
+			std::snprintf(suffix, sizeof(suffix), "%06d", i);
+			names.push_back(directory + "/data2D_" + suffix + extension);
+			fill(i, snapshots);
+			mpihandler.barrier();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			printer.print2D(suffix, grid.currentTime + i, grid);
+			result.writeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		printer.flush();
+		result.writeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	mpihandler.barrier();
+
+	if (backend.readable) {
+		result.readSeconds = 0;
+		for (const std::string& name : names) {
+			mpihandler.barrier();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			DataReader::readGrid(name, DataReader::readDataParameters(name), m_fluid);
+			result.readSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+	if (mpihandler.getRank() == 0)
+		countFiles(directory, result);
+	return result;
+}
+
+/**
+ * @brief Counts the files in a directory and their bytes.
+ */
+void IOBenchmark::countFiles(const std::string& directory, Result& result) const {
+	DIR* dir = opendir(directory.c_str());
+	if (dir == nullptr)
+		throw std::runtime_error("IOBenchmark::countFiles: unable to open " + directory + ".");
+	for (struct dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+		struct stat st;
+		if (stat((directory + "/" + entry->d_name).c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+			++result.files;
+			result.bytes += st.st_size;
+		}
+	}
+	closedir(dir);
+}
+
+/**
+ * @brief Writes, on the root processor, the files and bytes of every backend, the shortest, mean and longest time any
+ * processor took to write them, the write throughput, and the same for reading them back, to the file and the log.
+ * Collective.
+ */
+void IOBenchmark::report(const std::vector<Result>& results, const std::string& filename) const {
+	MPIW& mpihandler = MPIW::Instance();
+	const int nproc = mpihandler.nProcessors();
+	std::vector<std::string> lines;
+	char line[256];
+	std::snprintf(line, sizeof(line), "# %d snapshots of %d x %d x %d cells on %d processors.\n", results[0].snapshots,
+			m_fluid.getGrid().ncells[0], m_fluid.getGrid().ncells[1], m_fluid.getGrid().ncells[2], nproc);
+	lines.push_back(line);
+	std::snprintf(line, sizeof(line), "# %-16s %8s %13s %13s %13s %13s %13s %13s %13s\n", "backend", "files", "MB",
+			"write min (s)", "write mean", "write max", "write (MB/s)", "read max (s)", "read (MB/s)");
+	lines.push_back(line);
+	for (const Result& r : results) {
+		const std::vector<double> seconds = mpihandler.allGather(std::vector<double>{ r.writeSeconds, r.readSeconds });
+		double wmin = seconds[0], wmax = seconds[0], wmean = 0, rmax = seconds[1];
+		for (int iproc = 0; iproc < nproc; ++iproc) {
+			wmin = std::min(wmin, seconds[2*iproc]);
+			wmax = std::max(wmax, seconds[2*iproc]);
+			wmean += seconds[2*iproc]/nproc;
+			rmax = std::max(rmax, seconds[2*iproc + 1]);
+		}
+		const double megabytes = 1.0e-6*r.bytes;
+		if (r.readSeconds < 0)
+			std::snprintf(line, sizeof(line), "  %-16s %8ld %13.4e %13.4e %13.4e %13.4e %13.4e %13s %13s\n", r.name.c_str(),
+					r.files, megabytes, wmin, wmean, wmax, wmax > 0 ? megabytes/wmax : 0.0, "-", "-");
+		else
+			std::snprintf(line, sizeof(line), "  %-16s %8ld %13.4e %13.4e %13.4e %13.4e %13.4e %13.4e %13.4e\n", r.name.c_str(),
+					r.files, megabytes, wmin, wmean, wmax, wmax > 0 ? megabytes/wmax : 0.0, rmax, rmax > 0 ? megabytes/rmax : 0.0);
+		lines.push_back(line);
+	}
+	if (mpihandler.getRank() != 0)
+		return;
+
+	std::ofstream out(filename);
+	if (!out)
+		throw std::runtime_error("IOBenchmark::report: unable to open " + filename + ".");
+	std::string table;
+	for (const std::string& l : lines)
+		table += l;
+	out << table;
+	Logger::Instance().print<SeverityType::NOTICE>("I/O benchmark (see ", filename, "):\n", table);
+}
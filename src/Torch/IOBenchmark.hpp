@@ -0,0 +1,84 @@
+/** Provides the IOBenchmark class.
+ *
+ * @file IOBenchmark.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef IOBENCHMARK_HPP_
+#define IOBENCHMARK_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Torch/Common.hpp"
+
+class Constants;
+class Fluid;
+
+/**
+ * @class IOBenchmark
+ *
+ * @brief Writes and reads back synthetic snapshots of the real decomposition of a Grid through every output format
+ * built, without any of the physics, to choose the output settings for a filesystem before running on it (torch
+ * --io-bench).
+ *
+ * Each backend is a DataPrinter set up as a run would set it up: gzipped text, written as the steps go or in the
+ * background (through the I/O processors if the run has io_clients), binary snapshots in float64 and float32, binary
+ * keyframes and deltas, and HDF5 if TORCH is built with it. Before each snapshot the cells of a sphere about the centre
+ * of the grid, which grows from one snapshot to the next, are filled with smooth fields with a little noise about the
+ * initial conditions, so the compression and the deltas see data like a run's. The snapshots of a backend are written
+ * to a directory of their own and then read back with DataReader::readGrid, for the formats it reads.
+ *
+ * Every processor times its own writes and reads, after a barrier. The throughput is the bytes on disk over the time of
+ * the slowest processor, and the files created, read from the directory afterwards, count the metadata operations of
+ * the filesystem.
+ */
+class IOBenchmark {
+public:
+	IOBenchmark(Fluid& fluid, std::shared_ptr<Constants> consts, const std::string& directory, const std::string& variables,
+			int compressionLevel);
+
+	void run(int snapshots, const std::string& filename);
+
+private:
+	/**
+	 * @brief An output format and the settings of its DataPrinter.
+	 */
+	struct Backend {
+		std::string name;
+		SnapshotFormat format = SnapshotFormat::TEXT;
+		SnapshotPrecision precision = SnapshotPrecision::FLOAT64;
+		bool async = false; //!< Format and compress the text in the background (see AsyncWriter).
+		int keyframeEvery = 1; //!< Snapshots from one keyframe to the next (1 writes them all in full).
+		bool readable = true; //!< Whether DataReader reads the format back.
+	};
+
+	/**
+	 * @brief The timings of a backend on this processor and its files.
+	 */
+	struct Result {
+		std::string name;
+		int snapshots = 0;
+		double writeSeconds = 0; //!< Time this processor spent writing the snapshots, waiting for the background ones (s).
+		double readSeconds = -1; //!< Time this processor spent reading them back (s), negative if they were not.
+		long files = 0; //!< Files in the backend's directory.
+		double bytes = 0; //!< Bytes of the files.
+	};
+
+	Fluid& m_fluid;
+	std::shared_ptr<Constants> m_consts;
+	std::string m_directory; //!< Directory the snapshots of each backend are written under.
+	std::string m_variables; //!< Variables of the binary and HDF5 snapshots.
+	int m_compressionLevel = 6; //!< zlib level of the gzipped text.
+	std::vector<FluidArray> m_initial; //!< Primitive variables of each cell before the first fill, indexed by cell ID.
+
+	std::vector<Backend> backends() const;
+	void fill(int snapshot, int snapshots);
+	Result time(const Backend& backend, int snapshots);
+	void countFiles(const std::string& directory, Result& result) const;
+	void report(const std::vector<Result>& results, const std::string& filename) const;
+};
+
+#endif // IOBENCHMARK_HPP_
@@ -0,0 +1,415 @@
+#include "ParameterFile.hpp"
+
+#include "IO/FileManagement.hpp"
+#include "IO/GatheredLogPolicy.hpp"
+#include "IO/Logger.hpp"
+#include "IO/ParseLua.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+
+#include "selene/include/selene.h"
+
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+/**
+ * @brief Runs the parameter script in a new Lua state and, for an ensemble member, merges the member's table of
+ * parameters into the Parameters table.
+ *
+ * A member that does not set its own Integration output_directory writes to member_<index> inside the
+ * output_directory of the parameter file.
+ * @param member Index of the ensemble member, or -1 for none.
+ */
+std::unique_ptr<lua_State, void(*)(lua_State*)> loadParameters(const std::string& text, const std::string& filename, int member) {
+	// Create new Lua state and load the lua libraries
+	std::unique_ptr<lua_State, void(*)(lua_State*)> rawState(luaL_newstate(), lua_close);
+	if (rawState == nullptr)
+		throw std::runtime_error("ParseParameters: unable to create a lua state.");
+	luaL_openlibs(rawState.get());
+
+	if (!loadLuaText(rawState.get(), text, filename))
+		throw std::runtime_error("ParseParameters: could not open lua file: " + filename + "\n");
+	if (member >= 0) {
+		const std::string merge =
+			"local function merge(dst, src)\n"
+			"	for k, v in pairs(src) do\n"
+			"		if type(v) == 'table' and type(dst[k]) == 'table' and k ~= 'extra_sources' and k ~= 'regions' then merge(dst[k], v) else dst[k] = v end\n"
+			"	end\n"
+			"end\n"
+			"local member = Ensemble.members[" + std::to_string(member + 1) + "]\n"
+			"local dir = Parameters.Integration.output_directory\n"
+			"merge(Parameters, member)\n"
+			"if Parameters.Integration.output_directory == dir then\n"
+			"	Parameters.Integration.output_directory = dir .. '/member_" + std::to_string(member + 1) + "'\n"
+			"end\n";
+		if (luaL_dostring(rawState.get(), merge.c_str()) != 0)
+			throw std::runtime_error("ParseParameters: could not apply ensemble member " + std::to_string(member + 1) + " of " + filename + ".\n");
+	}
+	return rawState;
+}
+
+}
+
+/**
+ * @brief Reads the optional Ensemble table of the parameter file.
+ * @param ngroups Set to the number of groups the processors are split into (Ensemble groups, 1 by default, 0 for a group
+ * of each processor).
+ * @param nthreads Set to the number of OpenMP threads each member runs with (Ensemble threads, 0 to leave the number
+ * as it is, which is the default unless groups is 0, when it is 1).
+ * @return Number of ensemble members (0 without an Ensemble table).
+ */
+int parseEnsemble(const std::string& text, const std::string& paramfilename, int& ngroups, int& nthreads) {
+	std::unique_ptr<lua_State, void(*)(lua_State*)> rawState = loadParameters(text, paramfilename, -1);
+	if (luaL_dostring(rawState.get(), "return type(Ensemble) == 'table' and type(Ensemble.members) == 'table' and #Ensemble.members or 0") != 0)
+		throw std::runtime_error("ParseParameters: unable to read the Ensemble table of " + paramfilename + ".\n");
+	const int nmembers = (int)lua_tonumber(rawState.get(), -1);
+	lua_settop(rawState.get(), 0);
+	if (nmembers > 0) {
+		sel::State luaState{rawState.get()};
+		ngroups = 1;
+		parseLuaVariable(luaState["Ensemble"]["groups"], ngroups);
+		nthreads = ngroups == 0 ? 1 : 0;
+		parseLuaVariable(luaState["Ensemble"]["threads"], nthreads);
+		if (ngroups < 0)
+			throw std::runtime_error("ParseParameters: Ensemble.groups(=" + std::to_string(ngroups) + ") must be >= 0.\n");
+		if (nthreads < 0)
+			throw std::runtime_error("ParseParameters: Ensemble.threads(=" + std::to_string(nthreads) + ") must be >= 0.\n");
+	}
+	return nmembers;
+}
+
+/**
+ * @brief Reads Integration.io_clients of the parameter file, the number of processors served by each I/O processor.
+ * @return io_clients (0 for no I/O processors).
+ */
+int parseIOClients(const std::string& text, const std::string& paramfilename) {
+	std::unique_ptr<lua_State, void(*)(lua_State*)> rawState = loadParameters(text, paramfilename, -1);
+	sel::State luaState{rawState.get()};
+	int ioClients = 0;
+	parseLuaVariable(luaState["Parameters"]["Integration"]["io_clients"], ioClients);
+	return ioClients;
+}
+
+/**
+ * @brief Reads Integration.radiation_processors of the parameter file, whether every other processor traces the radiation
+ * for the one before it.
+ * @return radiation_processors (false by default).
+ */
+bool parseRadiationProcessors(const std::string& text, const std::string& paramfilename) {
+	std::unique_ptr<lua_State, void(*)(lua_State*)> rawState = loadParameters(text, paramfilename, -1);
+	sel::State luaState{rawState.get()};
+	bool radiationProcessors = false;
+	parseLuaVariable(luaState["Parameters"]["Integration"]["radiation_processors"], radiationProcessors);
+	return radiationProcessors;
+}
+
+/**
+ * @brief Reads Integration.output_directory of the parameter file, for an ensemble member if member is not -1.
+ */
+std::string parseOutputDirectory(const std::string& text, const std::string& paramfilename, int member) {
+	std::string outputDir = "";
+	std::unique_ptr<lua_State, void(*)(lua_State*)> rawState = loadParameters(text, paramfilename, member);
+	sel::State luaState{rawState.get()};
+	parseLuaVariable(luaState["Parameters"]["Integration"]["output_directory"], outputDir);
+
+	return outputDir;
+}
+
+/**
+ * @brief Reads Integration.log_files of the parameter file, for an ensemble member if member is not -1.
+ * @return log_files ("single" by default).
+ */
+std::string parseLogFiles(const std::string& text, const std::string& paramfilename, int member) {
+	std::string logFiles = "single";
+	std::unique_ptr<lua_State, void(*)(lua_State*)> rawState = loadParameters(text, paramfilename, member);
+	sel::State luaState{rawState.get()};
+	parseLuaVariable(luaState["Parameters"]["Integration"]["log_files"], logFiles);
+	return logFiles;
+}
+
+/**
+ * @brief Reads Integration.restart_file of the parameter file, for an ensemble member if member is not -1.
+ * @return restart_file (empty for a run that does not restart).
+ */
+std::string parseRestartFile(const std::string& text, const std::string& paramfilename, int member) {
+	std::string restartFile = "";
+	std::unique_ptr<lua_State, void(*)(lua_State*)> rawState = loadParameters(text, paramfilename, member);
+	sel::State luaState{rawState.get()};
+	parseLuaVariable(luaState["Parameters"]["Integration"]["restart_file"], restartFile);
+	return restartFile;
+}
+
+/**
+ * @brief Reads the parameters of a run from the parameter file, for an ensemble member if member is not -1.
+ * @param p The parameters, in the units of the parameter file (see TorchParameters::initialise).
+ */
+void parseParameters(const std::string& text, const std::string& filename, int member, TorchParameters& p) {
+	std::unique_ptr<lua_State, void(*)(lua_State*)> rawState = loadParameters(text, filename, member);
+	sel::State luaState{rawState.get()};
+	parseLuaVariable(luaState["Parameters"]["Integration"]["density_scale"], p.dscale);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["pressure_scale"], p.pscale);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["time_scale"], p.tscale);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["spatial_order"], p.spatialOrder);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["temporal_order"], p.temporalOrder);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["simulation_time"], p.tmax);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["dt_growth"], p.dtGrowth);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["radiation_on"], p.radiation_on);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["cooling_on"], p.cooling_on);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["debug"], p.debug);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["fused_updates"], p.fusedUpdates);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["overlap_cooling"], p.overlapCooling);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["autotune_steps"], p.autotuneSteps);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["rad_subcycles"], p.radSubcycles);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["equilibrium_iterations"], p.equilibriumIterations);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["equilibrium_tolerance"], p.equilibriumTolerance);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["rate_table_size"], p.rateTableSize);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["rate_table_check"], p.rateTableCheck);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["check_level"], p.checkLevel);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["initial_conditions"], p.initialConditions);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["restart_file"], p.restartFile);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["setup_cache"], p.setupCache);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["stage_directory"], p.stageDirectory);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["restart_every"], p.restartEvery);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["restart_refine"], p.restartRefine);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["trigger_ionised_mass"], p.triggerIonisedMass);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["trigger_front_cells"], p.triggerFrontCells);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["trigger_max_density"], p.triggerMaxDensity);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["trigger_min_interval"], p.triggerMinInterval);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["steady_every"], p.steadyEvery);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["steady_tolerance"], p.steadyTolerance);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["steady_checks"], p.steadyChecks);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["max_steps"], p.maxSteps);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["wall_time"], p.wallTime);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["restart_interval"], p.restartInterval);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["restart_compression"], p.restartCompression);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["telemetry_every"], p.telemetryEvery);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["telemetry_address"], p.telemetryAddress);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["trace_steps"], p.traceSteps);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["hardware_counters"], p.hardwareCounters);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["snapshot_format"], p.snapshotFormat);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["snapshot_variables"], p.snapshotVariables);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["snapshot_precision"], p.snapshotPrecision);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["snapshot_keyframe_every"], p.snapshotKeyframeEvery);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["snapshot_delta_tolerance"], p.snapshotDeltaTolerance);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["async_output"], p.asyncOutput);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["pack_output"], p.packOutput);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["compression_level"], p.compressionLevel);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["ncheckpoints"], p.ncheckpoints);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["snapshot_every"], p.snapshotEvery);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["work_counters"], p.workCounters);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["analysis_on"], p.analysisOn);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["analysis_profile_bins"], p.analysisProfileBins);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["analysis_slice"], p.analysisSlice);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["analysis_library"], p.analysisLibrary);
+	for (int i = 1; exists(luaState["Parameters"]["Integration"]["regions"][i]["lower_x"]); ++i) {
+		RegionParameters region;
+		const char* axes[3] = {"x", "y", "z"};
+		for (int idim = 0; idim < 3; ++idim) {
+			const std::string lower = std::string("lower_") + axes[idim], upper = std::string("upper_") + axes[idim];
+			if (exists(luaState["Parameters"]["Integration"]["regions"][i][lower.c_str()]))
+				parseLuaVariable(luaState["Parameters"]["Integration"]["regions"][i][lower.c_str()], region.lower[idim]);
+			if (exists(luaState["Parameters"]["Integration"]["regions"][i][upper.c_str()]))
+				parseLuaVariable(luaState["Parameters"]["Integration"]["regions"][i][upper.c_str()], region.upper[idim]);
+		}
+		if (exists(luaState["Parameters"]["Integration"]["regions"][i]["units"]))
+			parseLuaVariable(luaState["Parameters"]["Integration"]["regions"][i]["units"], region.units);
+		if (exists(luaState["Parameters"]["Integration"]["regions"][i]["relative_to_star"]))
+			parseLuaVariable(luaState["Parameters"]["Integration"]["regions"][i]["relative_to_star"], region.relativeToStar);
+		if (exists(luaState["Parameters"]["Integration"]["regions"][i]["every"]))
+			parseLuaVariable(luaState["Parameters"]["Integration"]["regions"][i]["every"], region.every);
+		if (exists(luaState["Parameters"]["Integration"]["regions"][i]["variables"]))
+			parseLuaVariable(luaState["Parameters"]["Integration"]["regions"][i]["variables"], region.variables);
+		p.regions.push_back(region);
+	}
+	parseLuaVariable(luaState["Parameters"]["Integration"]["preview_every"], p.previewEvery);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["preview_factor"], p.previewFactor);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["time_averages"], p.timeAverages);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["time_average_variances"], p.timeAverageVariances);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["render_every"], p.renderEvery);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["render_variables"], p.renderVariables);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["tracers_per_cell"], p.tracersPerCell);
+	parseLuaVariable(luaState["Parameters"]["Integration"]["tracer_every"], p.tracerEvery);
+
+	parseLuaVariable(luaState["Parameters"]["Grid"]["no_dimensions"], p.nd);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["no_cells_x"], p.ncells[0]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["no_cells_y"], p.ncells[1]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["no_cells_z"], p.ncells[2]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["no_procs_x"], p.nprocs[0]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["no_procs_y"], p.nprocs[1]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["no_procs_z"], p.nprocs[2]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["halo_datatypes"], p.haloDatatypes);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["halo_collective"], p.haloCollective);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["halo_single_precision"], p.haloSinglePrecision);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["halo_precision_check"], p.haloPrecisionCheck);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["ray_tile_size"], p.rayTileSize);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["one_sided_relay"], p.oneSidedRelay);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["mpi_progress_interval"], p.mpiProgressInterval);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["huge_pages"], p.hugePages);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["brick_size"], p.brickSize);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["memory_check"], p.memoryCheck);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["star_slab_ratio"], p.starSlabRatio);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["rebalance_every"], p.rebalanceEvery);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["rebalance_threshold"], p.rebalanceThreshold);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["refinement_every"], p.refinementEvery);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["refinement_block_size"], p.refinementBlockSize);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["refinement_gradient"], p.refinementGradient);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["refinement_hii"], p.refinementHII);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["side_length"], p.sideLength);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["geometry"], p.geometry);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["left_boundary_condition_x"], p.leftBC[0]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["left_boundary_condition_y"], p.leftBC[1]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["left_boundary_condition_z"], p.leftBC[2]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["right_boundary_condition_x"], p.rightBC[0]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["right_boundary_condition_y"], p.rightBC[1]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["right_boundary_condition_z"], p.rightBC[2]);
+
+	parseLuaVariable(luaState["Parameters"]["Grid"]["Patch"]["filename"], p.patchfilename);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["Patch"]["offset_x"], p.patchoffset[0]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["Patch"]["offset_y"], p.patchoffset[1]);
+	parseLuaVariable(luaState["Parameters"]["Grid"]["Patch"]["offset_z"], p.patchoffset[2]);
+
+	parseLuaVariable(luaState["Parameters"]["Setup"]["name"], p.setupName);
+	parseLuaVariable(luaState["Parameters"]["Setup"]["library"], p.setupLibrary);
+	parseLuaVariable(luaState["Parameters"]["Setup"]["number_density"], p.setupNumberDensity);
+	parseLuaVariable(luaState["Parameters"]["Setup"]["temperature"], p.setupTemperature);
+	parseLuaVariable(luaState["Parameters"]["Setup"]["hii_fraction"], p.setupHIIFraction);
+	parseLuaVariable(luaState["Parameters"]["Setup"]["core_radius"], p.setupCoreRadius);
+	parseLuaVariable(luaState["Parameters"]["Setup"]["power_index"], p.setupPowerIndex);
+	parseLuaVariable(luaState["Parameters"]["Setup"]["offset"], p.setupOffset);
+
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gamma"], p.heatCapacityRatio);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["density_floor"], p.dfloor);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["pressure_floor"], p.pfloor);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["temperature_floor"], p.tfloor);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["riemann_solver"], p.riemannSolver);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["slope_limiter"], p.slopeLimiter);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["tile_size"], p.hydroTileSize);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["skip_quiescent"], p.skipQuiescent);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["cfl"], p.cfl);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["ssp_stages"], p.sspStages);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["fallback_substeps"], p.fallbackSubsteps);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_every"], p.gravityEvery);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_tolerance"], p.gravityTolerance);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_max_cycles"], p.gravityMaxCycles);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_model"], p.gravityModel);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_mass"], p.gravityMass);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_dispersion"], p.gravityDispersion);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_centre_x"], p.gravityCentre[0]);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_centre_y"], p.gravityCentre[1]);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_centre_z"], p.gravityCentre[2]);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_softening"], p.gravitySoftening);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_acceleration_x"], p.gravityAcceleration[0]);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_acceleration_y"], p.gravityAcceleration[1]);
+	parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gravity_acceleration_z"], p.gravityAcceleration[2]);
+
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["K1"], p.K1);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["K2"], p.K2);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["K3"], p.K3);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["K4"], p.K4);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["photoion_cross_section"], p.photoIonCrossSection);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["case_b_recombination_coeff"], p.alphaB);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["tau_0"], p.tau0);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["minimum_hii_fraction"], p.minX);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["temperature_hi"], p.THI);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["temperature_hii"], p.THII);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["mass_fraction_hydrogen"], p.massFractionH);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["collisions_on"], p.collisions_on);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["coupling"], p.rt_coupling);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["implicit_heating"], p.rt_implicitHeating);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["integration_scheme"], p.rt_scheme);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["decoupled_iterations"], p.rt_decoupledIterations);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["decoupled_tolerance"], p.rt_decoupledTolerance);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["neutral_tolerance"], p.rt_neutralTolerance);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["shadow_tau"], p.rt_shadowTau);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["ionised_tolerance"], p.rt_ionisedTolerance);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["ionised_skips"], p.rt_ionisedSkips);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["coarse_factor"], p.rt_coarseFactor);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["coarse_radius"], p.rt_coarseRadius);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["photon_groups"], p.rt_photonGroups);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["spectrum_temperature"], p.rt_spectrumTemperature);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["hii_solver"], p.rt_hiiSolver);
+	parseLuaVariable(luaState["Parameters"]["Radiation"]["iteration_stats"], p.rt_iterationStats);
+
+	parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["thermo_hii_switch"], p.thermoHII_Switch);
+	parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["heating_amplification"], p.heatingAmplification);
+	parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["thermo_subcycling"], p.thermoSubcycling);
+	parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["stiff_substeps"], p.thermoStiffSubsteps);
+	parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["substep_stats"], p.thermoSubstepStats);
+	parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["chemistry_steps"], p.thermoChemistrySteps);
+	parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["cooling_table_size"], p.coolingTableSize);
+	parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["column_density_tolerance"], p.columnDensityTolerance);
+	parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["min_temp_initial_state"], p.minTempInitialState);
+
+	parseLuaVariable(luaState["Parameters"]["Star"]["on"], p.star_on);
+	parseLuaVariable(luaState["Parameters"]["Star"]["cell_position_x"], p.star_position[0]);
+	parseLuaVariable(luaState["Parameters"]["Star"]["cell_position_y"], p.star_position[1]);
+	parseLuaVariable(luaState["Parameters"]["Star"]["cell_position_z"], p.star_position[2]);
+	parseLuaVariable(luaState["Parameters"]["Star"]["snap_to_face_left_x"], p.faceSnap[0]);
+	parseLuaVariable(luaState["Parameters"]["Star"]["snap_to_face_left_y"], p.faceSnap[1]);
+	parseLuaVariable(luaState["Parameters"]["Star"]["snap_to_face_left_z"], p.faceSnap[2]);
+	parseLuaVariable(luaState["Parameters"]["Star"]["photon_energy"], p.photonEnergy);
+	parseLuaVariable(luaState["Parameters"]["Star"]["photon_rate"], p.photonRate);
+	parseLuaVariable(luaState["Parameters"]["Star"]["wind_radius_in_cells"], p.windCellRadius);
+	parseLuaVariable(luaState["Parameters"]["Star"]["wind_subsamples"], p.windSubsamples);
+	parseLuaVariable(luaState["Parameters"]["Star"]["wind_boundary"], p.windBoundary);
+	parseLuaVariable(luaState["Parameters"]["Star"]["mass_loss_rate"], p.massLossRate);
+	parseLuaVariable(luaState["Parameters"]["Star"]["wind_velocity"], p.windVelocity);
+	parseLuaVariable(luaState["Parameters"]["Star"]["wind_temperature"], p.windTemperature);
+	parseLuaVariable(luaState["Parameters"]["Star"]["velocity_x"], p.starVelocity[0]);
+	parseLuaVariable(luaState["Parameters"]["Star"]["velocity_y"], p.starVelocity[1]);
+	parseLuaVariable(luaState["Parameters"]["Star"]["velocity_z"], p.starVelocity[2]);
+	for (int i = 1; exists(luaState["Parameters"]["Star"]["extra_sources"][i]["photon_rate"]); ++i) {
+		SourceParameters source;
+		parseLuaVariable(luaState["Parameters"]["Star"]["extra_sources"][i]["cell_position_x"], source.position[0]);
+		parseLuaVariable(luaState["Parameters"]["Star"]["extra_sources"][i]["cell_position_y"], source.position[1]);
+		parseLuaVariable(luaState["Parameters"]["Star"]["extra_sources"][i]["cell_position_z"], source.position[2]);
+		parseLuaVariable(luaState["Parameters"]["Star"]["extra_sources"][i]["photon_rate"], source.photonRate);
+		p.extraSources.push_back(source);
+	}
+
+	Logger::Instance().print<SeverityType::NOTICE>("Star is on: ", p.star_on, '\n');
+	if (!p.extraSources.empty())
+		Logger::Instance().print<SeverityType::NOTICE>("Extra ionising sources: ", p.extraSources.size(), '\n');
+}
+
+/**
+ * @brief Empties the output directory of a run, copies the parameter and setup files into it and starts the log files
+ * in its log directory. Collective.
+ *
+ * A run carrying on from a restart file keeps what the directory holds, the restart file it reads and the output of the
+ * run that wrote it among them, and only starts the log files afresh.
+ * @param logFiles "single" to gather every processor's log into log/torch.log, "node" for a file per node or "rank" for
+ * a file per processor (see GatheredLogPolicy).
+ * @param isRestarting Whether the run carries on from a restart file (restart_file).
+ * @exception std::runtime_error Thrown if logFiles is none of these.
+ */
+void openOutputDirectory(const std::string& outputDirectory, const std::string& paramFile, const std::string& setupFile,
+		const std::string& logFiles, bool isRestarting) {
+	if (logFiles != "single" && logFiles != "node" && logFiles != "rank")
+		throw std::runtime_error("openOutputDirectory: log_files(=" + logFiles + ") must be single, node or rank.");
+	MPIW& mpihandler = MPIW::Instance();
+	if (mpihandler.getRank() == 0) {
+		FileManagement::makeDirectoryPath(outputDirectory);
+		if (!isRestarting)
+			FileManagement::deleteFileContents(outputDirectory);
+		FileManagement::makeDirectoryPath(outputDirectory + "/log");
+		if (!isRestarting)
+			FileManagement::deleteFileContents(outputDirectory + "/log");
+		FileManagement::copyConfigFile(setupFile, outputDirectory);
+		FileManagement::copyConfigFile(paramFile, outputDirectory);
+	}
+
+	mpihandler.barrier();
+
+	std::unique_ptr<LogPolicyInterface> fileLogPolicy;
+	if (logFiles == "rank") {
+		fileLogPolicy = std::unique_ptr<AsyncLogPolicy>(new AsyncLogPolicy(std::unique_ptr<FileLogPolicy>(
+			  new FileLogPolicy(outputDirectory + "/log/torch.log" + std::to_string(mpihandler.getRank()))
+		  )));
+	}
+	else
+		fileLogPolicy = std::unique_ptr<GatheredLogPolicy>(new GatheredLogPolicy(outputDirectory + "/log", logFiles == "node"));
+	fileLogPolicy->setLogLevel(SeverityType::NOTICE);
+	Logger::Instance().registerLogPolicy("file", std::move(fileLogPolicy));
+}
@@ -0,0 +1,25 @@
+/** Provides the functions that read a Lua parameter file into TorchParameters.
+ *
+ * @file ParameterFile.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef PARAMETERFILE_HPP_
+#define PARAMETERFILE_HPP_
+
+#include <string>
+
+#include "Parameters.hpp"
+
+int parseEnsemble(const std::string& text, const std::string& paramfilename, int& ngroups, int& nthreads);
+int parseIOClients(const std::string& text, const std::string& paramfilename);
+bool parseRadiationProcessors(const std::string& text, const std::string& paramfilename);
+std::string parseOutputDirectory(const std::string& text, const std::string& paramfilename, int member);
+std::string parseLogFiles(const std::string& text, const std::string& paramfilename, int member);
+std::string parseRestartFile(const std::string& text, const std::string& paramfilename, int member);
+void parseParameters(const std::string& text, const std::string& filename, int member, TorchParameters& p);
+void openOutputDirectory(const std::string& outputDirectory, const std::string& paramFile, const std::string& setupFile,
+		const std::string& logFiles, bool isRestarting = false);
+
+#endif // PARAMETERFILE_HPP_
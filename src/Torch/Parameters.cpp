@@ -9,6 +9,8 @@
 void TorchParameters::initialise(std::shared_ptr<Constants>& consts) {
 	tmax = consts->converter.toCodeUnits(tmax, 0, 0, 1);
 	dt_max = tmax/10.0;
+	triggerMinInterval = consts->converter.toCodeUnits(triggerMinInterval, 0, 0, 1);
+	steadyTolerance = consts->converter.toCodeUnits(steadyTolerance, 0, 0, -1);
 	sideLength = consts->converter.toCodeUnits(sideLength, 0, 1, 0);
 	if (geometry.compare("spherical") == 0 || geometry.compare("cylindrical") == 0)
 		leftBC[0] = "reflecting";
@@ -18,8 +20,19 @@ void TorchParameters::initialise(std::shared_ptr<Constants>& consts) {
 	pfloor =  0.1*consts->specificGasConstant*dfloor*tfloor;
 	photonEnergy = consts->converter.toCodeUnits(photonEnergy, 1, 2, -2); // Source photon energy (erg/scale).
 	photonRate = consts->converter.toCodeUnits(photonRate, 0, 0, -1); // Source photon Luminosity (s^-1/scale).
+	for (SourceParameters& source : extraSources)
+		source.photonRate = consts->converter.toCodeUnits(source.photonRate, 0, 0, -1);
 	massLossRate = consts->converter.toCodeUnits(massLossRate, 1, 0, -1); // Wind mass loss rate (g.s-1/scale).
 	windVelocity = consts->converter.toCodeUnits(windVelocity, 0, 1, -1); // Wind velocity (cm.s-1/scale).
+	for (double& v : starVelocity)
+		v = consts->converter.toCodeUnits(v, 0, 1, -1); // Star velocity (cm.s-1/scale).
+	gravityMass = consts->converter.toCodeUnits(gravityMass, 1, 0, 0);
+	gravityDispersion = consts->converter.toCodeUnits(gravityDispersion, 0, 1, -1);
+	for (double& x : gravityCentre)
+		x = consts->converter.toCodeUnits(x, 0, 1, 0);
+	gravitySoftening = consts->converter.toCodeUnits(gravitySoftening, 0, 1, 0);
+	for (double& g : gravityAcceleration)
+		g = consts->converter.toCodeUnits(g, 0, 1, -2);
 
 	const size_t len = outputDirectory.size();
 	if ( outputDirectory[len-1] == '\\' || outputDirectory[len-1] == '/' )
@@ -33,6 +46,20 @@ GridParameters TorchParameters::getGridParameters() {
 	std::copy(std::begin(rightBC), std::end(rightBC), std::begin(gpar.rightBC));
 
 	gpar.ncells = ncells;
+	gpar.nprocs = nprocs;
+	gpar.haloDatatypes = haloDatatypes;
+	gpar.haloCollective = haloCollective;
+	gpar.haloSinglePrecision = haloSinglePrecision;
+	gpar.haloPrecisionCheck = haloPrecisionCheck;
+	gpar.rayTileSize = rayTileSize;
+	gpar.oneSidedRelay = oneSidedRelay;
+	gpar.hugePages = hugePages;
+	gpar.brickSize = brickSize;
+	gpar.memoryCheck = memoryCheck;
+	gpar.starSlabRatio = starSlabRatio;
+	gpar.workCounters = workCounters;
+	gpar.rayData = radiation_on || cooling_on;
+	gpar.gravityField = gravityModel.compare("field") == 0;
 	gpar.sideLength = sideLength;
 	gpar.spatialOrder = spatialOrder;
 	return gpar;
@@ -57,10 +84,25 @@ RadiationParameters TorchParameters::getRadiationParameters() {
 	rpar.alphaB = alphaB;
 	rpar.collisions_on = collisions_on;
 	rpar.coupling = rt_coupling;
+	rpar.implicitHeating = rt_implicitHeating;
 	rpar.heatingAmplification = heatingAmplification;
 	rpar.scheme = rt_scheme;
+	rpar.decoupledIterations = rt_decoupledIterations;
+	rpar.decoupledTolerance = rt_decoupledTolerance;
+	rpar.neutralTolerance = rt_neutralTolerance;
+	rpar.shadowTau = rt_shadowTau;
+	rpar.ionisedTolerance = rt_ionisedTolerance;
+	rpar.ionisedSkips = rt_ionisedSkips;
+	rpar.coarseFactor = rt_coarseFactor;
+	rpar.coarseRadius = rt_coarseRadius;
+	rpar.photonGroups = rt_photonGroups;
+	rpar.spectrumTemperature = rt_spectrumTemperature;
+	rpar.hiiSolver = rt_hiiSolver;
+	rpar.iterationStats = rt_iterationStats;
 	rpar.photoIonCrossSection = photoIonCrossSection;
 	rpar.massFractionH = massFractionH;
+	rpar.rateTableSize = rateTableSize;
+	rpar.rateTableCheck = rateTableCheck;
 
 	return rpar;
 }
@@ -71,7 +113,14 @@ ThermoParameters TorchParameters::getThermoParameters() {
 	tpar.heatingAmplification = heatingAmplification;
 	tpar.massFractionH = massFractionH;
 	tpar.thermoSubcycling = thermoSubcycling;
+	tpar.stiffSubsteps = thermoStiffSubsteps;
+	tpar.substepStats = thermoSubstepStats;
+	tpar.chemistrySteps = thermoChemistrySteps;
 	tpar.minTempInitialState = minTempInitialState;
+	tpar.rateTableSize = rateTableSize;
+	tpar.rateTableCheck = rateTableCheck;
+	tpar.coolingTableSize = coolingTableSize;
+	tpar.columnDensityTolerance = columnDensityTolerance;
 
 	return tpar;
 }
@@ -87,9 +136,26 @@ StarParameters TorchParameters::getStarParameters() {
 		spar.photonEnergy = photonEnergy;
 		spar.photonRate = photonRate;
 		spar.windCellRadius = windCellRadius;
+		spar.windSubsamples = windSubsamples;
+		spar.windBoundary = windBoundary;
 		spar.windTemperature = windTemperature;
 		spar.windVelocity = windVelocity;
+		spar.extraSources = extraSources;
+		spar.velocity = starVelocity;
 	}
 
 	return spar;
 }
+
+SetupParameters TorchParameters::getSetupParameters() {
+	SetupParameters spar;
+	spar.name = setupName;
+	spar.library = setupLibrary;
+	spar.numberDensity = setupNumberDensity;
+	spar.temperature = setupTemperature;
+	spar.hiiFraction = setupHIIFraction;
+	spar.coreRadius = setupCoreRadius;
+	spar.powerIndex = setupPowerIndex;
+	spar.offset = setupOffset;
+	return spar;
+}
@@ -13,6 +13,7 @@
 #include <array>
 #include <memory>
 #include <string>
+#include <vector>
 
 class Constants;
 
@@ -21,14 +22,74 @@ struct GridParameters;
 struct RadiationParameters;
 struct ThermoParameters;
 struct StarParameters;
+struct SetupParameters;
+
+/**
+ * @brief An ionising source besides the star, which has no wind and shares the star's photon energy.
+ */
+struct SourceParameters {
+	std::array<int, 3> position = std::array<int, 3>{{ 0, 0, 0 }}; //!< Grid coordinates of the cell holding the source.
+	double photonRate = 0; //!< Ionising photon rate (s-1 in the parameter file, code units after TorchParameters::initialise).
+};
+
+/**
+ * @brief A box of the grid written as a binary snapshot of its own every few steps (see DataPrinter::printRegions).
+ */
+struct RegionParameters {
+	std::array<double, 3> lower = std::array<double, 3>{{ 0, 0, 0 }}; //!< Lower corner of the box.
+	std::array<double, 3> upper = std::array<double, 3>{{ 0, 0, 0 }}; //!< Upper corner of the box.
+	std::string units = "cells"; //!< Units of the corners [cells, cm].
+	bool relativeToStar = false; //!< The corners are measured from the cell of the star.
+	int every = 1; //!< Steps between the outputs.
+	std::string variables = ""; //!< Variables written, e.g. "den,hii" (empty for all).
+};
 
 struct TorchParameters {
 	std::string setupFile = "";
+	std::string setupScript = ""; //!< Contents of setupFile, read by the root processor and sent to the rest.
 	std::string initialConditions = "";
+	std::string restartFile = ""; //!< Restart file to carry on from (overrides initialConditions and setupFile).
+	std::string setupCache = ""; //!< Directory of the cache of set up cells (see SetupCache), empty for none.
+	std::string stageDirectory = ""; //!< Node-local directory the snapshots and restart files are staged in (see OutputStaging), empty for none.
+	int restartEvery = 0; //!< Write a restart file every restartEvery checkpoints (0 for never).
+	int restartRefine = 1; //!< Cells along each side of a cell of the restart file's grid (see DataReader::prolongRestart).
+	double triggerIonisedMass = 0; //!< Fractional change of the ionised mass that triggers an output between checkpoints (0 for none).
+	double triggerFrontCells = 0; //!< Number of cells the ionisation front moves by that triggers an output (0 for none).
+	double triggerMaxDensity = 0; //!< Fractional change of the largest density that triggers an output (0 for none).
+	double triggerMinInterval = 0; //!< Least simulation time between outputs triggered by change (s).
+	int steadyEvery = 0; //!< Steps between the checks for a steady state (0 for never, see SteadyStateMonitor).
+	double steadyTolerance = 0; //!< Relative change of the density and HII fraction per unit time below which the solution is steady (s-1).
+	int steadyChecks = 3; //!< Number of checks in a row that must find the solution steady before the run stops.
+	bool hardwareCounters = false; //!< Read CPU hardware counters around the profiled regions (see HardwareCounters).
+	int telemetryEvery = 100; //!< Log the throughput, time step and memory use every telemetryEvery steps (0 for never).
+	std::string telemetryAddress = ""; //!< host:port the root processor sends each telemetry packet to over UDP (empty for none).
+	int maxSteps = 0; //!< Stop after this many steps (0 for no limit), e.g. to time a fixed amount of work.
+	double wallTime = 0; //!< Wall clock time the run may take (s), which it writes a restart file and stops within (0 for no limit).
+	double restartInterval = 0; //!< Wall clock time between restart files (s, 0 for none besides those of restartEvery).
+	bool restartCompression = false; //!< Compress the records of the restart files losslessly (see RestartCodec).
+	int traceSteps = 0; //!< Number of steps at the start of the run recorded in the Chrome trace log/trace.json (0 for none).
 	int nd = 0; //!< Number of dimensions.
 	double sideLength = 0; //!< The side length of the simulation line/square/cube.
 	std::array<int, 3> ncells = std::array<int, 3>{{ 0, 0, 0 }}; //!< Array holding the number of grid cells along each dimension.
 	std::array<int, 3> coreCells = std::array<int, 3>{{ 0, 0, 0 }}; //!< Array holding the number of grid cells along in each dimension in each processor.
+	std::array<int, 3> nprocs = std::array<int, 3>{{ 0, 1, 1 }}; //!< Number of processors the grid is split between along each dimension (0 lets MPI choose).
+	bool haloDatatypes = true; //!< Exchange ghost cells straight from the GridCells through MPI datatypes instead of packing buffers.
+	bool haloCollective = false; //!< Exchange ghost cells with every neighbouring processor in one MPI neighbourhood collective.
+	bool haloSinglePrecision = false; //!< Send the hydrodynamic variables of the ghost cells as floats.
+	bool haloPrecisionCheck = false; //!< Log the rounding of the first single precision halo exchange.
+	int rayTileSize = 16; //!< Number of cells along each side of the tiles the ray tracers pipeline between processors (0 turns pipelining off).
+	bool oneSidedRelay = false; //!< Pass the ray tracers' column densities between processors through MPI windows instead of messages.
+	double mpiProgressInterval = 0; //!< Microseconds between the calls into MPI of the loops that overlap with communication (0 for none, see MPIW::progress).
+	bool hugePages = false; //!< Back the arrays of GridCells and GridJoins with transparent huge pages (see FirstTouch::hugePages).
+	int brickSize = 0; //!< Number of cells along each side of the bricks the GridCells are stored in (0 for x fastest, see Grid::flatIndex).
+	bool memoryCheck = true; //!< Abort before the Grid is built if it would not fit in the memory of the nodes (see Grid::checkMemory).
+	double starSlabRatio = 1; //!< Width of the x slab furthest from the star over that of the slab holding it (1 for slabs of equal width).
+	int rebalanceEvery = 0; //!< Steps between the checks of the load balance of the x slabs of the Grid (0 for never, see LoadBalancer).
+	double rebalanceThreshold = 1.1; //!< Largest ratio of the slowest processor's work to the mean before the Grid is repartitioned.
+	int refinementEvery = 0; //!< Steps between the estimates of the saving of an adaptive mesh (0 for never, see RefinementEstimator).
+	int refinementBlockSize = 16; //!< Number of cells along each side of the blocks the RefinementEstimator flags.
+	double refinementGradient = 0.1; //!< Largest relative jump in density or pressure across a cell left unrefined.
+	double refinementHII = 0.05; //!< Ionisation fractions between this and one minus it are refined.
 	std::array<std::string, 3> leftBC = std::array<std::string, 3>{{ "free", "free", "free" }}; //!< Array of left boundary conditions for each dimension.
 	std::array<std::string, 3> rightBC = std::array<std::string, 3>{{ "free", "free", "free" }}; //!< Array of right boundary conditions for each dimension.
 	std::string geometry = "cartesian"; //!< The GEOMETRY of the grid [CARTESIAN, CYLINDRICAL, SPHERICAL].
@@ -36,20 +97,89 @@ struct TorchParameters {
 	std::string patchfilename = "";
 	std::array<int, 3> patchoffset = std::array<int, 3>{{ 0, 0, 0 }};
 
+	std::string setupName = "lua"; //!< Initial condition setup [lua, uniform, powerlaw_cloud, plugin].
+	std::string setupLibrary = ""; //!< Shared object of the plugin setup.
+	double setupNumberDensity = 0; //!< Hydrogen number density of the medium, or of the cloud at the star (cm^-3).
+	double setupTemperature = 0; //!< Temperature (K).
+	double setupHIIFraction = 0; //!< HII fraction.
+	double setupCoreRadius = 0; //!< Core radius of the power-law cloud (cm).
+	double setupPowerIndex = 0; //!< Power-law index of the cloud's density profile.
+	double setupOffset = 0; //!< Distance of the cloud's centre from the star along y (cm).
+
 	std::string riemannSolver = "hll";
 	std::string slopeLimiter = "falle";
+	int hydroTileSize = 0; //!< Number of cells along each side of the tiles the hydrodynamic fluxes are swept in (0 sweeps whole pencils).
+	bool skipQuiescent = false; //!< Skip the hydrodynamic tiles of a uniform state, whose fluxes cancel.
+	double cfl = 0.5; //!< Fraction of the time a signal takes to cross a cell that the hydrodynamic time step may be.
+	int sspStages = 0; //!< Stages of the strong stability preserving Runge-Kutta hydrodynamic steps (2 or 3, 0 for those of temporalOrder).
+	int fallbackSubsteps = 2; //!< First order sub-steps retaking a hydrodynamic step that left invalid cells (0 to stop the run instead).
+	int gravityEvery = 0; //!< Number of steps between the solves of the self-gravity of the gas (0 for none).
+	double gravityTolerance = 1.0e-6; //!< Largest residual of a self-gravity solve, relative to the largest source term.
+	int gravityMaxCycles = 20; //!< Most multigrid V-cycles of a self-gravity solve.
+	std::string gravityModel = "field"; //!< External gravitational field [field, none, point_mass, isothermal_sphere, uniform].
+	double gravityMass = 0; //!< Mass of the point_mass gravity model.
+	double gravityDispersion = 0; //!< Velocity dispersion of the isothermal_sphere gravity model.
+	std::array<double, 3> gravityCentre = std::array<double, 3>{{ 0, 0, 0 }}; //!< Position of the point mass or the centre of the isothermal sphere.
+	double gravitySoftening = 0; //!< Softening length of the point_mass and isothermal_sphere gravity models.
+	std::array<double, 3> gravityAcceleration = std::array<double, 3>{{ 0, 0, 0 }}; //!< Acceleration of the uniform gravity model.
 	std::string rt_scheme = "implicit";  //!< Ionisation fraction integration scheme.
+	int rt_decoupledIterations = 0; //!< Maximum number of ray trace/ionisation solve iterations of the decoupled implicit scheme (0 for the coupled scheme).
+	double rt_decoupledTolerance = 0; //!< Largest change in any HII fraction at which the decoupled iterations stop early (0 to always run them all).
+	double rt_neutralTolerance = 0; //!< HII fraction, and product of the time step and total rate, below which a cell takes a single update instead of the implicit solve (0 never does).
+	double rt_shadowTau = 0; //!< Optical depth from the Star beyond which the HII fraction of a cell is updated without photoionisation, in closed form (0 never is).
+	double rt_ionisedTolerance = 0; //!< Neutral fraction, and change in it over the time step relative to itself, below which a cell takes a single update instead of the implicit solve (0 never does).
+	int rt_ionisedSkips = 0; //!< Updates a cell found at ionisation equilibrium (see rt_ionisedTolerance) keeps its HII fraction for before it is checked again.
+	int rt_coarseFactor = 1; //!< Cells of the Grid along each side of a cell of the coarse copy the far cells are ray traced on (1 for none).
+	double rt_coarseRadius = 0; //!< Distance from the Star (cell widths) beyond which the cells take their optical depths from the coarse copy.
+	int rt_photonGroups = 0; //!< Number of frequency bins the Star's ionising spectrum is split into (0 for the grey photon_energy).
+	double rt_spectrumTemperature = 0; //!< Temperature of the black body spectrum split into the photon groups (K).
+	std::string rt_hiiSolver = "fixed_point"; //!< Root finder for the time averaged HII fraction ("fixed_point" or "newton").
+	bool rt_iterationStats = false; //!< Log a histogram of the HII fraction solver iteration counts every step.
 	std::string rt_coupling = "off";
+	bool rt_implicitHeating = false; //!< Integrate the photoheating of the neq coupling over each radiation step with an exponential integrator, so it does not limit the time step.
 
 	int spatialOrder = 0;
-	int temporalOrder = 0;
+	int temporalOrder = 2;
 	double tmax = 0;
 	double dt_max = 0;
+	double dtGrowth = 2; //!< Largest factor the time step may grow by from one step to the next.
 	bool radiation_on = false;
 	bool cooling_on = false;
 	bool debug = true;
+	bool fusedUpdates = true; //!< Fuse the update, fix and conversion sweeps of a (sub-)step into single passes.
+	bool overlapCooling = true; //!< Cool each ray tile as soon as the radiation sub-step has solved it, when a cooling sub-step follows.
+	int autotuneSteps = 0; //!< Steps timed with each candidate setting at the start of the run (0 for no tuning, see Autotuner).
+	int radSubcycles = 0; //!< Most radiation and cooling sub-steps taken within a hydrodynamic step of their own time step (0 or 1 for one each).
+	int equilibriumIterations = 0; //!< Most iterations of the photoionisation equilibrium the run starts from (0 to start from the initial conditions).
+	double equilibriumTolerance = 1.0e-4; //!< Change in HII fraction below which the equilibrium iterations stop.
+	int rateTableSize = 2048; //!< Number of points in the uniform log(T) tables the rate splines are resampled onto (0 uses the splines).
+	bool rateTableCheck = false; //!< Log the largest relative difference between each rate table and its spline.
+	std::string checkLevel = "step"; //!< How often the state is checked for invalid values [off, checkpoint, step, paranoid].
 	std::string outputDirectory = "tmp/";
+	std::string snapshotFormat = "text"; //!< File format of the data2D snapshots [text, binary].
+	std::string snapshotVariables = ""; //!< Variables of the binary snapshots, e.g. "den,hii" (empty for all).
+	std::string snapshotPrecision = "float64"; //!< Storage of the values of the binary snapshots [float64, float32, quantised].
+	int snapshotKeyframeEvery = 1; //!< Binary data2D snapshots from one written in full to the next, the others written as deltas.
+	double snapshotDeltaTolerance = 0; //!< Largest change of a value left out of the delta snapshots, relative to its variable's largest magnitude.
+	int compressionLevel = 6; //!< zlib level (0-9) of the gzipped text output.
+	bool asyncOutput = false; //!< Format and compress the text output on background threads, writing it at the next checkpoint.
+	bool packOutput = false; //!< Append the data2D and heating text files of the checkpoints to one container file each.
 	int ncheckpoints = 100;
+	int snapshotEvery = 1; //!< Write the data2D and heating snapshots every snapshotEvery checkpoints (and at the end).
+	bool workCounters = false; //!< Count the work of every cell and write it with the snapshots (see DataPrinter::printCheckpoint).
+	bool analysisOn = false; //!< Append the in-situ reductions of the Grid to analysis.txt at every checkpoint.
+	int analysisProfileBins = 0; //!< Number of radial bins of the profiles written at every checkpoint (0 for none).
+	bool analysisSlice = false; //!< Write the plane of cells through the Star of 3D grids at every checkpoint.
+	std::string analysisLibrary = ""; //!< Shared object of an analysis plug-in called at every checkpoint (see AnalysisHook).
+	std::vector<RegionParameters> regions; //!< Boxes of the grid written at their own cadence.
+	int previewEvery = 0; //!< Steps between the downsampled previews of the Grid (0 for none, see DataPrinter::printPreview).
+	int previewFactor = 4; //!< Cells along each dimension averaged into a cell of the previews.
+	std::string timeAverages = ""; //!< Variables averaged over time and written at every checkpoint (none if empty, see DataPrinter::printTimeAverages).
+	bool timeAverageVariances = false; //!< Write the variances about the time averages too.
+	int renderEvery = 0; //!< Render a PNG image of the slice through the Grid every renderEvery steps (0 for never, see SliceRenderer).
+	std::string renderVariables = "den,hii,temperature"; //!< Variables rendered, out of den, pre, hii and temperature.
+	int tracersPerCell = 0; //!< Tracer particles seeded in every cell at the start of the run (0 for none, see TracerParticles).
+	int tracerEvery = 10; //!< Steps between the samples of the tracer particles written to tracers.tpk.
 
 	double dfloor = 0;
 	double pfloor = 0;
@@ -73,16 +203,25 @@ struct TorchParameters {
 	bool star_on = false;
 	std::array<int, 3> star_position = std::array<int, 3>{{ 0, 0, 0 }};
 	std::array<bool, 3> faceSnap = std::array<bool, 3>{{ false, false, false }};
+	std::array<double, 3> starVelocity = std::array<double, 3>{{ 0, 0, 0 }}; //!< Velocity the star moves through the grid with.
 	double photonEnergy = 0;
 	double photonRate = 0;
 	double massLossRate = 0;
 	double windVelocity = 0;
 	double windTemperature = 0;
 	int windCellRadius = 0;
+	int windSubsamples = 0; //!< Sample points along each dimension of a wind cell weighting its share of the wind (0 for equal shares).
+	bool windBoundary = false; //!< Hold the wind cells at the state of the free wind as an internal boundary instead of injecting the wind into them.
+	std::vector<SourceParameters> extraSources; //!< Ionising sources ray traced alongside the star.
 
 	double thermoHII_Switch = 0;
 	double heatingAmplification = 1.0; //!< Heating amplification/reduction hack.
 	bool thermoSubcycling = true;
+	int thermoStiffSubsteps = 0; //!< Cells needing more cooling subcycles than this take this many exponential steps instead (0 never does).
+	bool thermoSubstepStats = false; //!< Log a histogram of the cooling subcycle counts every step.
+	int thermoChemistrySteps = 0; //!< ROS2 steps of the H2 and CO network per time step (0 for no chemistry).
+	int coolingTableSize = 0; //!< Points of the tables of the cooling terms against log10(T) (0 calculates them exactly).
+	double columnDensityTolerance = 0; //!< Reuse the column densities of the cooling traced since the last step while no density has changed by more than this fraction (0 always traces them).
 	bool minTempInitialState = false;
 
 	double massFractionH = 0; //!< Mass fraction of hydrogen.
@@ -94,6 +233,7 @@ struct TorchParameters {
 	RadiationParameters getRadiationParameters();
 	ThermoParameters getThermoParameters();
 	StarParameters getStarParameters();
+	SetupParameters getSetupParameters();
 };
 
 struct FluidParameters {
@@ -103,6 +243,22 @@ struct FluidParameters {
 
 struct GridParameters {
 	std::array<int, 3> ncells; //!< Array holding the number of grid cells along each dimension.
+	std::array<int, 3> nprocs; //!< Number of processors the grid is split between along each dimension (0 lets MPI choose).
+	bool haloDatatypes; //!< Exchange ghost cells straight from the GridCells through MPI datatypes instead of packing buffers.
+	bool haloCollective; //!< Exchange ghost cells with every neighbouring processor in one MPI neighbourhood collective.
+	bool haloSinglePrecision; //!< Send the hydrodynamic variables of the ghost cells as floats.
+	bool haloPrecisionCheck; //!< Log the rounding of the first single precision halo exchange.
+	int rayTileSize; //!< Number of cells along each side of the tiles the ray tracers pipeline between processors (0 turns pipelining off).
+	bool oneSidedRelay; //!< Pass the ray tracers' column densities between processors through MPI windows instead of messages.
+	bool hugePages; //!< Back the arrays of GridCells and GridJoins with transparent huge pages.
+	int brickSize; //!< Number of cells along each side of the bricks the GridCells are stored in (0 for x fastest).
+	bool memoryCheck; //!< Abort before the GridCells are allocated if they would not fit in the memory of the nodes.
+	bool workCounters; //!< Count the HII fraction iterations, cooling subcycles and floors applied in every cell.
+	bool rayData; //!< Store the ray geometry and heating rates of every cell, which only radiation and cooling use.
+	bool gravityField; //!< Store the gravitational force density of every cell, which only the FIELD gravity model uses.
+	std::vector<int> xEdges; //!< Left edges of the processor blocks along x, then ncells[0] (empty for blocks of equal width, see LoadBalancer).
+	double starSlabRatio; //!< Width of the x slab furthest from the star over that of the star's slab, when xEdges is empty.
+	int starColumn = -1; //!< Grid coordinate of the star along x (-1 without a star).
 	int spatialOrder;
 	double sideLength; //!< The side length of the simulation line/square/cube.
 	std::array<std::string, 3> leftBC; //!< Array of left boundary conditions for each dimension.
@@ -130,10 +286,25 @@ struct RadiationParameters {
 	double THI = 0; //!< Temperature fix for fully neutral gas.
 	double THII = 0; //!< Temperature fix for fully ionized gas.
 	std::string scheme = "implicit";  //!< Ionization fraction integration scheme.
+	int decoupledIterations = 0; //!< Maximum number of ray trace/ionisation solve iterations of the decoupled implicit scheme (0 for the coupled scheme).
+	double decoupledTolerance = 0; //!< Largest change in any HII fraction at which the decoupled iterations stop early (0 to always run them all).
+	double neutralTolerance = 0; //!< HII fraction, and product of the time step and total rate, below which a cell takes a single update instead of the implicit solve (0 never does).
+	double shadowTau = 0; //!< Optical depth from the Star beyond which the HII fraction of a cell is updated without photoionisation, in closed form (0 never is).
+	double ionisedTolerance = 0; //!< Neutral fraction, and change in it over the time step relative to itself, below which a cell takes a single update instead of the implicit solve (0 never does).
+	int ionisedSkips = 0; //!< Updates a cell found at ionisation equilibrium (see ionisedTolerance) keeps its HII fraction for before it is checked again.
+	int coarseFactor = 1; //!< Cells of the Grid along each side of a cell of the coarse copy the far cells are ray traced on (1 for none).
+	double coarseRadius = 0; //!< Distance from the Star (cell widths) beyond which the cells take their optical depths from the coarse copy.
+	int photonGroups = 0; //!< Number of frequency bins the Star's ionising spectrum is split into (0 for the grey photon_energy).
+	double spectrumTemperature = 0; //!< Temperature of the black body spectrum split into the photon groups (K).
+	std::string hiiSolver = "fixed_point"; //!< Root finder for the time averaged HII fraction ("fixed_point" or "newton").
+	bool iterationStats = false; //!< Log a histogram of the HII fraction solver iteration counts every step.
 	double massFractionH = 0; //!< Mass fraction of hydrogen.
 	double heatingAmplification = 0;
 	bool collisions_on = false; //!< Include collisional ionizations.
 	std::string coupling = "off";
+	bool implicitHeating = false; //!< Integrate the photoheating of the neq coupling with an exponential integrator instead of limiting the time step by it.
+	int rateTableSize = 0; //!< Number of points in the uniform log(T) tables the rate splines are resampled onto (0 uses the splines).
+	bool rateTableCheck = false; //!< Log the largest relative difference between each rate table and its spline.
 };
 
 struct ThermoParameters {
@@ -141,20 +312,41 @@ struct ThermoParameters {
 	double heatingAmplification = 1.0; //!< Heating amplification/reduction hack.
 	double massFractionH = 0;
 	bool thermoSubcycling = true;
+	int stiffSubsteps = 0; //!< Cells needing more cooling subcycles than this take this many exponential steps instead (0 never does).
+	bool substepStats = false; //!< Log a histogram of the cooling subcycle counts every step.
+	int chemistrySteps = 0; //!< ROS2 steps of the H2 and CO network per time step (0 for no chemistry).
 	bool minTempInitialState = false;
+	int rateTableSize = 0; //!< Number of points in the uniform log(T) tables the rate splines are resampled onto (0 uses the splines).
+	bool rateTableCheck = false; //!< Log the largest relative difference between each rate table and its spline.
+	int coolingTableSize = 0; //!< Points of the tables of the cooling terms against log10(T) (0 calculates them exactly).
+	double columnDensityTolerance = 0; //!< Reuse the column densities of the cooling traced since the last step while no density has changed by more than this fraction (0 always traces them).
 };
 
 struct StarParameters {
 	bool on = false;
 	std::array<int, 3> position = std::array<int, 3>{{ 0, 0, 0 }};
 	std::array<bool, 3> faceSnap = std::array<bool, 3>{{ false, false, false }};
+	std::array<double, 3> velocity = std::array<double, 3>{{ 0, 0, 0 }}; //!< Velocity of the star, which is at position at time 0.
 	double photonEnergy = 0;
 	double photonRate = 0;
 	int windCellRadius = 0;
+	int windSubsamples = 0; //!< Sample points along each dimension of a wind cell weighting its share of the wind (0 for equal shares).
+	bool windBoundary = false; //!< Hold the wind cells at the state of the free wind as an internal boundary instead of injecting the wind into them.
 	double massLossRate = 0;
 	double windVelocity = 0;
 	double windTemperature = 0;
+	std::vector<SourceParameters> extraSources; //!< Ionising sources ray traced alongside the star.
 };
 
+struct SetupParameters {
+	std::string name = "lua";
+	std::string library = "";
+	double numberDensity = 0;
+	double temperature = 0;
+	double hiiFraction = 0;
+	double coreRadius = 0;
+	double powerIndex = 0;
+	double offset = 0;
+};
 
 #endif // PARAMETERS_H_
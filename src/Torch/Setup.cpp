@@ -0,0 +1,143 @@
+#include "Setup.hpp"
+
+#include "Misc/Parallel.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+#include <dlfcn.h>
+
+#include "selene/include/selene.h"
+
+namespace {
+
+// The setups work in cgs units, as the Lua setup scripts do.
+const double HYDROGEN_MASS = 1.674e-24; //!< Mass of hydrogen (g).
+const double SPECIFIC_GAS_CONSTANT = 8.314462e7; //!< Specific gas constant (erg g^-1 K^-1).
+
+}
+
+UniformSetup::UniformSetup(const SetupParameters& sp) {
+	if (sp.numberDensity <= 0 || sp.temperature <= 0)
+		throw std::runtime_error("UniformSetup: number_density and temperature must be positive.");
+	m_density = sp.numberDensity*HYDROGEN_MASS;
+	m_pressure = SPECIFIC_GAS_CONSTANT*(1 + sp.hiiFraction)*sp.numberDensity*HYDROGEN_MASS*sp.temperature;
+	m_hii = sp.hiiFraction;
+}
+
+void UniformSetup::fill(SetupBlock& block) const {
+	for (int i = 0; i < block.n; ++i) {
+		block.den[i] = m_density;
+		block.pre[i] = m_pressure;
+		block.hii[i] = m_hii;
+	}
+}
+
+PowerLawCloudSetup::PowerLawCloudSetup(const SetupParameters& sp) {
+	if (sp.numberDensity <= 0 || sp.temperature <= 0 || sp.coreRadius <= 0)
+		throw std::runtime_error("PowerLawCloudSetup: number_density, temperature and core_radius must be positive.");
+	m_coreRadius2 = sp.coreRadius*sp.coreRadius;
+	m_powerIndex = sp.powerIndex;
+	m_offset = sp.offset;
+	m_centreDensity = sp.numberDensity*std::pow(1 + sp.offset*sp.offset/m_coreRadius2, sp.powerIndex);
+	m_pressure = SPECIFIC_GAS_CONSTANT*sp.numberDensity*HYDROGEN_MASS*sp.temperature;
+	m_hii = sp.hiiFraction;
+}
+
+void PowerLawCloudSetup::fill(SetupBlock& block) const {
+	Parallel::forEach(0, block.n, [&](int i) {
+		double dy = m_offset + (block.star[1] - block.y[i]);
+		double r2 = block.x[i]*block.x[i] + dy*dy;
+		block.den[i] = m_centreDensity*HYDROGEN_MASS*std::pow(1 + r2/m_coreRadius2, -m_powerIndex);
+		block.pre[i] = m_pressure;
+		block.hii[i] = m_hii;
+	});
+}
+
+PluginSetup::PluginSetup(const std::string& library) {
+	m_handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (m_handle == nullptr)
+		throw std::runtime_error("PluginSetup: unable to load " + library + ": " + dlerror());
+	m_setup = reinterpret_cast<void (*)(SetupBlock*)>(dlsym(m_handle, "torch_setup"));
+	if (m_setup == nullptr) {
+		dlclose(m_handle);
+		throw std::runtime_error("PluginSetup: " + library + " does not export torch_setup.");
+	}
+}
+
+PluginSetup::~PluginSetup() {
+	if (m_handle != nullptr)
+		dlclose(m_handle);
+}
+
+void PluginSetup::fill(SetupBlock& block) const {
+	m_setup(&block);
+}
+
+LuaBlockSetup::LuaBlockSetup(lua_State* luaState)
+: m_luaState(luaState)
+{
+}
+
+void LuaBlockSetup::fill(SetupBlock& block) const {
+	const int nvalues = 9;
+	double* outputs[nvalues] = {block.den, block.pre, block.hii, block.vel[0], block.vel[1], block.vel[2],
+			block.grav[0], block.grav[1], block.grav[2]};
+	const double* coords[3] = {block.x, block.y, block.z};
+	const char* axes[3] = {"x", "y", "z"};
+
+	lua_getglobal(m_luaState, "initialise_block");
+	for (int i = 0; i < 3; ++i) {
+		lua_createtable(m_luaState, block.n, 0);
+		for (int j = 0; j < block.n; ++j) {
+			lua_pushnumber(m_luaState, coords[i][j]);
+			lua_rawseti(m_luaState, -2, j + 1);
+		}
+	}
+	lua_createtable(m_luaState, 0, 3);
+	for (int i = 0; i < 3; ++i) {
+		lua_pushnumber(m_luaState, block.star[i]);
+		lua_setfield(m_luaState, -2, axes[i]);
+	}
+
+	if (lua_pcall(m_luaState, 4, nvalues, 0) != LUA_OK) {
+		std::string error = lua_tostring(m_luaState, -1) != nullptr ? lua_tostring(m_luaState, -1) : "unknown error";
+		lua_pop(m_luaState, 1);
+		throw std::runtime_error("LuaBlockSetup::fill: initialise_block failed: " + error);
+	}
+
+	for (int k = 0; k < nvalues; ++k) {
+		int index = k - nvalues;
+		if (!lua_istable(m_luaState, index) || (int)lua_rawlen(m_luaState, index) != block.n) {
+			lua_pop(m_luaState, nvalues);
+			throw std::runtime_error("LuaBlockSetup::fill: initialise_block must return nine arrays with a value per cell.");
+		}
+		for (int j = 0; j < block.n; ++j) {
+			lua_rawgeti(m_luaState, index, j + 1);
+			int isNumber = 0;
+			outputs[k][j] = lua_tonumberx(m_luaState, -1, &isNumber);
+			lua_pop(m_luaState, 1);
+			if (!isNumber) {
+				lua_pop(m_luaState, nvalues);
+				throw std::runtime_error("LuaBlockSetup::fill: initialise_block returned a value that is not a number.");
+			}
+		}
+	}
+	lua_pop(m_luaState, nvalues);
+}
+
+/**
+ * @brief Creates the built-in setup or plug-in chosen by SetupParameters::name.
+ * @param sp The setup's parameters.
+ * @return The setup (the Lua setups are made by Torch::setUpLua).
+ */
+std::unique_ptr<SetupProvider> SetupFactory::create(const SetupParameters& sp) {
+	if (sp.name.compare("uniform") == 0)
+		return std::unique_ptr<SetupProvider>(new UniformSetup(sp));
+	else if (sp.name.compare("powerlaw_cloud") == 0)
+		return std::unique_ptr<SetupProvider>(new PowerLawCloudSetup(sp));
+	else if (sp.name.compare("plugin") == 0)
+		return std::unique_ptr<SetupProvider>(new PluginSetup(sp.library));
+	else
+		throw std::runtime_error("SetupFactory::create: unknown setup: " + sp.name + "\n");
+}
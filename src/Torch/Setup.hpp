@@ -0,0 +1,129 @@
+/** Provides the SetupProvider abstract base class, the built-in initial condition setups and SetupFactory.
+ *
+ * @file Setup.hpp
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef SETUP_HPP_
+#define SETUP_HPP_
+
+#include <memory>
+#include <string>
+
+#include "Parameters.hpp"
+
+struct lua_State;
+
+/**
+ * @brief Coordinates of a block of cells and the arrays their initial conditions are written to, all in cgs units.
+ *
+ * Each array holds a value per cell. This is also the interface of setup plug-ins (see PluginSetup).
+ */
+struct SetupBlock {
+	int n; //!< Number of cells in the block.
+	const double* x; //!< x coordinate of each cell centre (cm).
+	const double* y; //!< y coordinate of each cell centre (cm).
+	const double* z; //!< z coordinate of each cell centre (cm).
+	double star[3]; //!< Position of the Star (cm).
+	double* den; //!< Density (g cm^-3).
+	double* pre; //!< Pressure (dyne cm^-2).
+	double* hii; //!< HII fraction.
+	double* vel[3]; //!< Velocity components (cm s^-1).
+	double* grav[3]; //!< Gravitational acceleration components (cm s^-2).
+};
+
+/**
+ * @class SetupProvider
+ *
+ * @brief A base class for filling in the initial conditions of blocks of cells (see Torch::setUpBlocks).
+ *
+ * Every output array is zeroed before fill() is called, so a setup only needs to write the values it sets.
+ */
+class SetupProvider {
+public:
+	virtual ~SetupProvider() { };
+	virtual void fill(SetupBlock& block) const = 0;
+};
+
+/**
+ * @class UniformSetup
+ *
+ * @brief A uniform medium at rest.
+ */
+class UniformSetup : public SetupProvider {
+public:
+	UniformSetup(const SetupParameters& sp);
+	void fill(SetupBlock& block) const;
+private:
+	double m_density = 0;
+	double m_pressure = 0;
+	double m_hii = 0;
+};
+
+/**
+ * @class PowerLawCloudSetup
+ *
+ * @brief A cloud at rest in pressure equilibrium, with a density falling off as (1 + r^2/rc^2)^-alpha from its centre.
+ *
+ * The centre lies on the axis x = 0, a distance offset from the Star along y, and the hydrogen number density at the Star
+ * is numberDensity. This is the problem set up by the default config/torch-setup.lua, cell for cell: the distance leaves
+ * out z, so a 3D grid holds a cylinder along z, and the pressure is that of the neutral gas at temperature whatever the
+ * hiiFraction.
+ */
+class PowerLawCloudSetup : public SetupProvider {
+public:
+	PowerLawCloudSetup(const SetupParameters& sp);
+	void fill(SetupBlock& block) const;
+private:
+	double m_centreDensity = 0;
+	double m_pressure = 0;
+	double m_hii = 0;
+	double m_coreRadius2 = 0;
+	double m_powerIndex = 0;
+	double m_offset = 0;
+};
+
+/**
+ * @class PluginSetup
+ *
+ * @brief Initial conditions computed by a shared object, which is loaded for the lifetime of this object.
+ *
+ * The shared object must export a function with C linkage, void torch_setup(SetupBlock* block), that fills in a block.
+ */
+class PluginSetup : public SetupProvider {
+public:
+	PluginSetup(const std::string& library);
+	~PluginSetup();
+	PluginSetup(const PluginSetup&) = delete;
+	PluginSetup& operator=(const PluginSetup&) = delete;
+	void fill(SetupBlock& block) const;
+private:
+	void* m_handle = nullptr;
+	void (*m_setup)(SetupBlock*) = nullptr;
+};
+
+/**
+ * @class LuaBlockSetup
+ *
+ * @brief Initial conditions computed by the initialise_block(xs, ys, zs, star) function of a Lua setup script.
+ *
+ * xs, ys and zs are arrays of the cell coordinates and star is a table with the fields x, y and z. The function returns
+ * nine arrays: the density, pressure, HII fraction, three velocity components and three gravitational acceleration
+ * components of each cell, as returned by initialise for a single cell. The tables are built with the Lua C API,
+ * avoiding a call per cell.
+ */
+class LuaBlockSetup : public SetupProvider {
+public:
+	LuaBlockSetup(lua_State* luaState);
+	void fill(SetupBlock& block) const;
+private:
+	lua_State* m_luaState = nullptr;
+};
+
+class SetupFactory {
+public:
+	static std::unique_ptr<SetupProvider> create(const SetupParameters& sp);
+};
+
+#endif // SETUP_HPP_
@@ -1,21 +1,57 @@
 #include "Torch.hpp"
+#include "CommBenchmark.hpp"
+#include "IOBenchmark.hpp"
 #include "Constants.hpp"
 #include "Fluid/GridCell.hpp"
+#include "Fluid/GridStatistics.hpp"
 #include "IO/ProgressBar.hpp"
 #include "IO/Logger.hpp"
 #include "IO/Checkpointer.hpp"
 #include "IO/DataReader.hpp"
+#include "IO/ParseLua.hpp"
+#include "IO/OutputStaging.hpp"
+#include "IO/Restart.hpp"
+#include "IO/SetupCache.hpp"
+#include "Setup.hpp"
+#include "Misc/Allocations.hpp"
+#include "Misc/CpuDispatch.hpp"
+#include "Misc/Parallel.hpp"
+#include "Misc/Profiler.hpp"
 #include "Misc/Timer.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <iostream>
 #include <assert.h>
 #include <cmath>
+#include <csignal>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
 
 #include "selene/include/selene.h"
 
+namespace {
+
+const char* componentNames[3] = {"hydro", "rad", "thermo"}; //!< Log names of the components, by ComponentID.
+
+volatile std::sig_atomic_t stopSignal = 0; //!< Set by a SIGTERM or SIGUSR1, after which Torch::run stops gracefully.
+
+/**
+ * @brief Asks the run to stop after the step it is taking. A second signal of the same kind ends the process at once.
+ */
+void onStopSignal(int sig) {
+	stopSignal = 1;
+	std::signal(sig, SIG_DFL);
+}
+
+}
+
 int stepIDFromFilename(const std::string& filename) {
 	std::size_t lastindex = filename.find_last_of(".");
 	std::string rawname = (lastindex != std::string::npos) ? filename.substr(0, lastindex) : filename;
@@ -27,6 +63,7 @@ int stepIDFromFilename(const std::string& filename) {
 }
 
 void Torch::initialise(TorchParameters p) {
+	m_wallClock.start();
 	consts = std::make_shared<Constants>();
 
 	// Initialise the scalings (scaling physical units to code units (to reduce chance of arithmetic underflow/overflow). 
@@ -37,7 +74,36 @@ void Torch::initialise(TorchParameters p) {
 
 	// Read grid geometry from initial conditions data file if one exists to set up initial grid data structure.
 	DataParameters datap;
-	if (p.initialConditions.compare("") != 0) {
+	RestartHeader restart;
+	const bool isRestarting = p.restartFile.compare("") != 0;
+	if (isRestarting) {
+		restart = DataReader::readRestartHeader(p.restartFile);
+		const std::array<double, 3> scales = {{ consts->converter.fromCodeUnits(1.0, 1, 0, 0),
+			consts->converter.fromCodeUnits(1.0, 0, 1, 0), consts->converter.fromCodeUnits(1.0, 0, 0, 1) }};
+		for (int i = 0; i < 3; ++i) {
+			if (std::abs(scales[i] - restart.scales[i]) > 1.0e-12*std::abs(scales[i]))
+				throw std::runtime_error("Torch::initialise: the scales of the code units differ from those of " + p.restartFile + ".");
+		}
+		p.ncells = restart.ncells;
+		p.sideLength = restart.sideLength;
+		p.nd = restart.nd;
+		if (p.restartRefine < 1)
+			throw std::runtime_error("Torch::initialise: restart_refine(=" + std::to_string(p.restartRefine) + ") must be positive.");
+		if (p.restartRefine > 1) {
+			// Every length given in cells is scaled with the grid, the star moving to the fine cell at (or just past) the centre of its coarse one.
+			const int factor = p.restartRefine;
+			for (int i = 0; i < p.nd; ++i) {
+				p.ncells[i] *= factor;
+				if (!(p.faceSnap[i] && p.star_position[i] == 0))
+					p.star_position[i] = p.star_position[i]*factor + factor/2;
+				for (SourceParameters& source : p.extraSources)
+					source.position[i] = source.position[i]*factor + factor/2;
+			}
+			p.windCellRadius *= factor;
+			p.rt_coarseRadius *= factor;
+		}
+	}
+	else if (p.initialConditions.compare("") != 0) {
 		datap = DataReader::readDataParameters(p.initialConditions);
 		p.ncells = datap.ncells;
 		p.sideLength = consts->converter.toCodeUnits(datap.sideLength, 0, 1, 0);
@@ -49,17 +115,122 @@ void Torch::initialise(TorchParameters p) {
 	consts->dfloor = p.dfloor;
 	consts->pfloor = p.pfloor;
 	consts->tfloor = p.tfloor;
+	consts->checkLevel = consts->checkLevelParser.parseEnum(p.checkLevel);
+	if (p.mpiProgressInterval < 0)
+		throw std::runtime_error("Torch::initialise: mpi_progress_interval(=" + std::to_string(p.mpiProgressInterval) + ") must not be negative.");
+	MPIW::Instance().setProgressInterval(1.0e-6*p.mpiProgressInterval);
 
 	// Initialise IO with output directory and consts (which includes unit conversion info).
-	inputOutput.initialise(consts, p.outputDirectory);
+	inputOutput.initialise(consts, p.outputDirectory, consts->snapshotFormatParser.parseEnum(p.snapshotFormat),
+			p.asyncOutput, p.compressionLevel);
+	inputOutput.initialiseSnapshots(p.snapshotVariables, consts->snapshotPrecisionParser.parseEnum(p.snapshotPrecision),
+			p.snapshotKeyframeEvery, p.snapshotDeltaTolerance);
+	inputOutput.initialiseAnalysis(p.analysisOn, p.analysisProfileBins, p.analysisSlice, p.analysisLibrary);
+	// The containers of the run a restart carries on from are kept, so a restarted run packs into files of its own.
+	inputOutput.initialisePacking(p.packOutput, isRestarting ? "_" + std::to_string(restart.steps) : "");
+	inputOutput.initialiseRestarts(p.restartCompression);
+	OutputStaging::Instance().initialise(p.stageDirectory);
+	inputOutput.initialiseRegions(p.regions);
+	inputOutput.initialisePreview(p.previewEvery, p.previewFactor);
+	inputOutput.initialiseTimeAverages(p.timeAverages, p.timeAverageVariances);
+	renderer.initialise(consts, p.outputDirectory, p.renderEvery, p.renderVariables);
+	snapshotEvery = p.snapshotEvery;
+	outputTriggers = std::array<double, 3>{{ p.triggerIonisedMass, p.triggerFrontCells, p.triggerMaxDensity }};
+	triggerMinInterval = p.triggerMinInterval;
+	OutputTrigger(p.triggerIonisedMass, p.triggerFrontCells, p.triggerMaxDensity, p.triggerMinInterval);
+	steadyEvery = p.steadyEvery;
+	steadyTolerance = p.steadyTolerance;
+	steadyChecks = p.steadyChecks;
+	SteadyStateMonitor(steadyEvery, steadyTolerance, steadyChecks);
+	if (snapshotEvery < 1)
+		throw std::runtime_error("Torch::initialise: snapshot_every(=" + std::to_string(snapshotEvery) + ") must be positive.");
+	profileFilename = p.outputDirectory + "/log/profile.txt";
+	traceFilename = p.outputDirectory + "/log/trace.json";
+	perfFilename = p.outputDirectory + "/log/perf.json";
+	commBenchFilename = p.outputDirectory + "/log/comm_bench.txt";
+	ioBenchFilename = p.outputDirectory + "/log/io_bench.txt";
+	ioBenchDirectory = p.outputDirectory + "/io_bench";
+	snapshotVariables = p.snapshotVariables;
+	compressionLevel = p.compressionLevel;
+	traceSteps = p.traceSteps;
+	maxSteps = p.maxSteps;
+	telemetryEvery = p.telemetryEvery;
+	rebalanceEvery = p.rebalanceEvery;
+	if (rebalanceEvery < 0)
+		throw std::runtime_error("Torch::initialise: rebalance_every(=" + std::to_string(rebalanceEvery) + ") must not be negative.");
+	balancer.initialise(p.rebalanceThreshold);
+	refinementEvery = p.refinementEvery;
+	if (refinementEvery < 0)
+		throw std::runtime_error("Torch::initialise: refinement_every(=" + std::to_string(refinementEvery) + ") must not be negative.");
+	refinement.initialise(p.nd, p.refinementBlockSize, p.refinementGradient, p.refinementHII);
+	tracersPerCell = p.tracersPerCell;
+	tracerEvery = p.tracerEvery;
+	if (tracersPerCell < 0)
+		throw std::runtime_error("Torch::initialise: tracers_per_cell(=" + std::to_string(tracersPerCell) + ") must not be negative.");
+	if (tracerEvery < 1)
+		throw std::runtime_error("Torch::initialise: tracer_every(=" + std::to_string(tracerEvery) + ") must be positive.");
+	tracerFilename = p.outputDirectory + "/tracers.tpk";
+	if (telemetryEvery < 0)
+		throw std::runtime_error("Torch::initialise: telemetry_every(=" + std::to_string(telemetryEvery) + ") must not be negative.");
+	if (!p.telemetryAddress.empty() && telemetryEvery > 0 && MPIW::Instance().getRank() == 0)
+		telemetryPublisher.open(p.telemetryAddress);
+	if (maxSteps < 0)
+		throw std::runtime_error("Torch::initialise: max_steps(=" + std::to_string(maxSteps) + ") must not be negative.");
+	wallTime = p.wallTime;
+	restartInterval = p.restartInterval;
+	if (wallTime < 0 || restartInterval < 0)
+		throw std::runtime_error("Torch::initialise: wall_time and restart_interval must not be negative.");
+	if (p.hardwareCounters)
+		Profiler::Instance().enableCounters();
+	reportPlacement();
 
 	// Set up grid data structure using geometry info read in earlier.
+	if (p.nd > TORCH_MAX_DIMENSIONS)
+		throw std::runtime_error("Torch::initialise: no_dimensions(=" + std::to_string(p.nd) + ") must not exceed the TORCH_MAX_DIMENSIONS(=" +
+				std::to_string(TORCH_MAX_DIMENSIONS) + ") of this build.");
 	fluid.initialise(consts, p.getFluidParameters());
 	fluid.initialiseGrid(p.getGridParameters(), p.getStarParameters());
 	fluid.getGrid().currentTime = consts->converter.toCodeUnits(datap.time, 0, 0, 1);
 
 	// Forward hydrodynamics parameters.
 	hydrodynamics.initialise(consts);
+	hydrodynamics.specialise(fluid.getGrid().spatialOrder, fluid.getGrid().geometry);
+	hydrodynamics.setTileSize(p.hydroTileSize);
+	hydrodynamics.setSkipQuiescent(p.skipQuiescent);
+	hydrodynamics.setCFL(p.cfl);
+	if (p.sspStages != 0 && p.sspStages != 2 && p.sspStages != 3)
+		throw std::runtime_error("Torch::initialise: ssp_stages(=" + std::to_string(p.sspStages) + ") must be 0, 2 or 3.");
+	sspStages = p.sspStages;
+	if (p.fallbackSubsteps < 0)
+		throw std::runtime_error("Torch::initialise: fallback_substeps(=" + std::to_string(p.fallbackSubsteps) + ") must not be negative.");
+	fallbackSubsteps = p.fallbackSubsteps;
+	gravityEvery = p.gravityEvery;
+	if (gravityEvery < 0)
+		throw std::runtime_error("Torch::initialise: gravity_every(=" + std::to_string(gravityEvery) + ") must not be negative.");
+	if (gravityEvery > 0) {
+		std::array<Condition, 3> leftBC, rightBC;
+		for (int i = 0; i < 3; ++i) {
+			leftBC[i] = consts->conditionParser.parseEnum(p.leftBC[i]);
+			rightBC[i] = consts->conditionParser.parseEnum(p.rightBC[i]);
+		}
+		gravity.initialise(consts, leftBC, rightBC, p.gravityTolerance, p.gravityMaxCycles);
+	}
+	GravityField gravityField;
+	gravityField.model = consts->gravityModelParser.parseEnum(p.gravityModel);
+	gravityField.nd = p.nd;
+	gravityField.dx = fluid.getGrid().dx;
+	gravityField.centre = p.gravityCentre;
+	gravityField.softening2 = p.gravitySoftening*p.gravitySoftening;
+	gravityField.acceleration = p.gravityAcceleration;
+	if (gravityEvery > 0 && gravityField.model != GravityModel::FIELD)
+		throw std::runtime_error("Torch::initialise: gravity_every(=" + std::to_string(gravityEvery) + ") needs the field gravity_model.");
+	if (p.gravityMass < 0 || p.gravityDispersion < 0 || p.gravitySoftening < 0)
+		throw std::runtime_error("Torch::initialise: gravity_mass, gravity_dispersion and gravity_softening must not be negative.");
+	if (gravityField.model == GravityModel::POINT_MASS)
+		gravityField.strength = consts->gravitationalConst*p.gravityMass;
+	else if (gravityField.model == GravityModel::ISOTHERMAL_SPHERE)
+		gravityField.strength = 2.0*p.gravityDispersion*p.gravityDispersion;
+	hydrodynamics.setGravity(gravityField);
 
 	// Try to set up RiemannSolver and SlopeLimiter with strings passed in parameters.lua - if invalid the default is used and a warning is issued to the log file.
 	try {
@@ -83,48 +254,162 @@ void Torch::initialise(TorchParameters p) {
 
 	// Forward parameters to this object.
 	ncheckpoints = p.ncheckpoints;
+	restartEvery = p.restartEvery;
 	initialConditions = p.initialConditions;
 	radiation_on = p.radiation_on;
 	cooling_on = p.cooling_on;
+	if (radiation_on && !RADIATION_BUILT)
+		throw std::runtime_error("Torch::initialise: radiation_on needs a build with TORCH_WITH_RADIATION.");
+	if (cooling_on && !THERMO_BUILT)
+		throw std::runtime_error("Torch::initialise: cooling_on needs a build with TORCH_WITH_THERMO.");
 	debug = p.debug;
+	fusedUpdates = p.fusedUpdates;
+	overlapCooling = p.overlapCooling;
+	if (p.radSubcycles < 0)
+		throw std::runtime_error("Torch::initialise: rad_subcycles(=" + std::to_string(p.radSubcycles) + ") must not be negative.");
+	radSubcycles = p.radSubcycles;
+	if (p.equilibriumIterations < 0)
+		throw std::runtime_error("Torch::initialise: equilibrium_iterations(=" + std::to_string(p.equilibriumIterations) + ") must not be negative.");
+	equilibriumIterations = p.equilibriumIterations;
+	equilibriumTolerance = p.equilibriumTolerance;
+	// The radiation processors take the radiation and cooling of whole steps alongside the hydrodynamics (see pipelinedStep).
+	if (MPIW::Instance().hasRadiationServer() || MPIW::Instance().isRadiationServer()) {
+		if (!radiation_on)
+			throw std::runtime_error("Torch::initialise: radiation_processors needs the radiation on.");
+		if (radSubcycles > 1)
+			throw std::runtime_error("Torch::initialise: radiation_processors cannot be used with rad_subcycles(=" + std::to_string(radSubcycles) + ").");
+		if (rebalanceEvery > 0)
+			throw std::runtime_error("Torch::initialise: radiation_processors cannot be used with rebalance_every(=" + std::to_string(rebalanceEvery) + ").");
+		if (equilibriumIterations > 0)
+			throw std::runtime_error("Torch::initialise: radiation_processors cannot be used with equilibrium_iterations(=" + std::to_string(equilibriumIterations) + ").");
+	}
 	spatialOrder = p.spatialOrder;
 	temporalOrder = p.temporalOrder;
+	if (p.temporalOrder != 1 && p.temporalOrder != 2)
+		throw std::runtime_error("Torch::initialise: temporal_order(=" + std::to_string(p.temporalOrder) + ") must be 1 or 2.");
 	tmax = p.tmax;
 	dt_max = p.dt_max;
+	if (p.dtGrowth < 1)
+		throw std::runtime_error("Torch::initialise: dt_growth(=" + std::to_string(p.dtGrowth) + ") must be at least 1.");
+	dtGrowth = p.dtGrowth;
 	dfloor = p.dfloor;
 	pfloor = p.pfloor;
 	tfloor = p.tfloor;
 
+	// The options that may change between steps, in the order they are tuned.
+	{
+		const Grid& grid = fluid.getGrid();
+		const int nthreads = Parallel::maxThreads();
+		std::ostringstream key;
+		key << "nd " << p.nd << " cells " << grid.ncells[0] << "x" << grid.ncells[1] << "x" << grid.ncells[2] << " processors "
+				<< MPIW::Instance().nProcessors() << " threads " << nthreads << " radiation " << radiation_on << " cooling " << cooling_on;
+		autotuner.initialise(p.autotuneSteps, p.outputDirectory + "/cache/autotune.txt", key.str());
+		autotuner.addKnob("threads", {nthreads, std::max(nthreads/2, 1), std::max(nthreads/4, 1)}, [](int n) { Parallel::setThreads(n); });
+		// The same candidates on every processor, whatever the size of its block.
+		int longest = 0;
+		for (int i = 0; i < p.nd; ++i)
+			longest = std::max(longest, grid.ncells[i]/MPIW::Instance().getDims()[i]);
+		std::vector<int> tileSizes = {p.hydroTileSize};
+		for (int size : {0, 8, 16, 32})
+			if (size < longest)
+				tileSizes.push_back(size);
+		autotuner.addKnob("tile_size", tileSizes, [this](int size) { hydrodynamics.setTileSize(size); });
+		autotuner.addKnob("fused_updates", {fusedUpdates, !fusedUpdates}, [this](int on) { fusedUpdates = on != 0; });
+		if (radiation_on && cooling_on)
+			autotuner.addKnob("overlap_cooling", {overlapCooling, !overlapCooling}, [this](int on) { overlapCooling = on != 0; });
+	}
+
 	steps = 0;
 	stepCounter = 0;
 
-	if (initialConditions.compare("") != 0) {
+	// A setup evaluated by an earlier run on the same grid is loaded from the cache instead (see SetupCache).
+	std::unique_ptr<SetupCache> setupCache;
+	bool isCached = false;
+	if (!p.setupCache.empty() && !isRestarting && initialConditions.empty() && p.patchfilename.empty() && !p.workCounters &&
+			(p.setupName.compare("lua") != 0 || !p.setupScript.empty())) {
+		setupCache.reset(new SetupCache(p.setupCache, setupKey(p)));
+		isCached = setupCache->load(fluid);
+	}
+
+	m_isRestarted = isRestarting;
+	if (isRestarting) {
+		// The state is restored once the grid geometry has been initialised below.
+		steps = restart.steps;
+		stepCounter = restart.splitPhase;
+		radiation.isFirstTimeStep = false;
+		fluid.getGrid().currentTime = restart.time;
+		fluid.getGrid().deltatime = restart.deltatime/p.restartRefine;
+		m_previousTimeStep = restart.deltatime/p.restartRefine;
+	}
+	else if (isCached)
+		Logger::Instance().print<SeverityType::NOTICE>("Torch::initialise: Grid loaded from the setup cache ", setupCache->getEntry(), "\n");
+	else if (initialConditions.compare("") != 0) {
 		DataReader::readGrid(initialConditions, datap, fluid);
 		Logger::Instance().print<SeverityType::NOTICE>("Torch::initialise: Grid read from file: ", initialConditions, "\n");
 		stepstart = stepIDFromFilename(initialConditions);
 	}
-	else {
+	else if (p.setupName.compare("lua") == 0) {
 		// Set up initial grid state using the setup.lua file.
-		setUpLua(p.setupFile);
+		setUpLua(p.setupFile, p.setupScript);
 	}
-	if (p.patchfilename.compare("") != 0)
-		DataReader::patchGrid(p.patchfilename, p.patchoffset, fluid);
+	else {
+		setUpBlocks(*SetupFactory::create(p.getSetupParameters()));
+		Logger::Instance().print<SeverityType::NOTICE>("Torch::initialise: Grid set up by the ", p.setupName, " setup.\n");
+	}
+	if (!isRestarting && !isCached) {
+		if (p.patchfilename.compare("") != 0)
+			DataReader::patchGrid(p.patchfilename, p.patchoffset, consts->converter, fluid);
 
-	// Initialise the minimum temperature of cells given the initial temperature field if this is turned on in the parameters.lua file.
-	thermodynamics.initialiseMinTempField(fluid);
+		// Initialise the minimum temperature of cells given the initial temperature field if this is turned on in the parameters.lua file.
+		thermodynamics.initialiseMinTempField(fluid);
 
-	// Convert cell data to code units, fix any broken primitive variables and calculate the conservative variables.
-	toCodeUnits();
-	fluid.fixPrimitives();
-	fluid.globalUfromQ();
+		// Convert cell data to code units, fix any broken primitive variables and calculate the conservative variables.
+		toCodeUnits();
+		fluid.fixPrimitives();
+		fluid.globalUfromQ();
+	}
 
+	// A moving star starts wherever its track has taken it by the start time.
+	fluid.moveStar(fluid.getGrid().currentTime);
 	// Initialise the path lengths, shell volumes, and nearest neighbour weights for use with the radiative transfer.
-	radiation.initField(fluid);
+	if (!isCached)
+		radiation.initField(fluid);
+	if (setupCache && !isCached)
+		setupCache->store(fluid);
+
+	// Restored after Radiation::initField, which resets the optical depths.
+	if (isRestarting) {
+		if (p.restartRefine > 1) {
+			DataReader::prolongRestart(p.restartFile, p.restartRefine, fluid);
+			Logger::Instance().print<SeverityType::NOTICE>("Torch::initialise: restarting from ", p.restartFile, " at step ", steps,
+				", refined ", p.restartRefine, " times along each dimension\n");
+		}
+		else {
+			DataReader::readRestart(p.restartFile, fluid);
+			Logger::Instance().print<SeverityType::NOTICE>("Torch::initialise: restarting from ", p.restartFile, " at step ", steps, "\n");
+		}
+	}
+
+	// A setup's gravitational field that is zero everywhere is dropped, so the cells neither store nor read it.
+	if (gravityField.model == GravityModel::FIELD && gravityEvery == 0) {
+		double largest = 0;
+		const Grid& grid = fluid.getGrid();
+		for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+			for (double f : grid.getGravity(cell.id))
+				largest = std::max(largest, std::abs(f));
+		}
+		if (MPIW::Instance().maximum(largest) == 0) {
+			fluid.storeGravity(false);
+			gravityField.model = GravityModel::NONE;
+			hydrodynamics.setGravity(gravityField);
+			Logger::Instance().print<SeverityType::NOTICE>("Torch::initialise: the gravitational field is zero, so it is not stored.\n");
+		}
+	}
 
 	// Warn the user if the reverse shock of the star is within or close to the injection radius.
 	if (p.star_on && p.windCellRadius > 0) {
 		Star& star = fluid.getStar();
-		if (star.core == Star::Location::HERE) {
+		if (star.isHere()) {
 			Grid& grid = fluid.getGrid();
 
 			double edot = 0.5 * star.massLossRate * star.windVelocity * star.windVelocity;
@@ -140,17 +425,27 @@ void Torch::initialise(TorchParameters p) {
 		}
 	}
 
+	// The heat capacity ratios are set by now and are not exchanged with the hydrodynamic variables.
+	fluid.initialiseHeatCapacityRatios();
+
+	// Wind cells held as an internal boundary start at the state of the free wind.
+	if (fluid.getStar().on && fluid.getStar().windBoundary && !isRestarting)
+		fluid.getStar().fixDensityPressure(fluid.getGrid());
+
 	Logger::Instance().print<SeverityType::NOTICE>("Torch::initialise: initial setup complete.\n");
 }
 
 void Torch::toCodeUnits() {
-	for (GridCell& cell : fluid.getGrid().getIterable("GridCells")) {
+	for (GridCell& cell : fluid.getGrid().getIterable(CellRange::GRID_CELLS)) {
 		cell.Q[UID::DEN] = consts->converter.toCodeUnits(cell.Q[UID::DEN], 1, -3, 0);
 		cell.Q[UID::PRE] = consts->converter.toCodeUnits(cell.Q[UID::PRE], 1, -1, -2);
 		for (int idim = 0; idim < consts->nd; ++idim)
 			cell.Q[UID::VEL+idim] = consts->converter.toCodeUnits(cell.Q[UID::VEL+idim], 0, 1, -1);
+		if (!fluid.getGrid().storesGravity())
+			continue;
+		GravArray& force = fluid.getGrid().getGravity(cell.id);
 		for (int idim = 0; idim < consts->nd; ++idim)
-			cell.GRAV[idim] = consts->converter.toCodeUnits(cell.GRAV[idim], 1, -2, -2);
+			force[idim] = consts->converter.toCodeUnits(force[idim], 1, -2, -2);
 	}
 }
 
@@ -170,7 +465,7 @@ void Torch::setUp(std::string filename) {
 			myfile >> ignore >> ignore >> ignore;
 		}
 
-		for (GridCell& cell : fluid.getGrid().getIterable("GridCells")) {
+		for (GridCell& cell : fluid.getGrid().getIterable(CellRange::GRID_CELLS)) {
 			for (int idim = 0; idim < consts->nd; ++idim)
 				myfile >> ignore;
 
@@ -189,42 +484,183 @@ void Torch::setUp(std::string filename) {
 	Logger::Instance().print<SeverityType::NOTICE>("Torch::setUp(", filename, ") complete.\n");
 }
 
-void Torch::setUpLua(std::string filename) {
-	MPIW& mpihandler = MPIW::Instance();
+/**
+ * @brief Sets the initial conditions of this processor's GridCells from a Lua setup script.
+ *
+ * If the script defines initialise_block it is called on blocks of cells at once (see LuaBlockSetup), otherwise
+ * initialise(x, y, z, xs, ys, zs) is called for every cell and returns its density, pressure, HII fraction, three
+ * velocity components and three gravitational acceleration components. Every processor has its own Lua state, so they
+ * all run the script at the same time.
+ * @param filename The setup script.
+ * @param script Contents of the setup script, which is read from filename if empty.
+ */
+void Torch::setUpLua(const std::string& filename, const std::string& script) {
 	Grid& grid = fluid.getGrid();
 
 	Logger::Instance().print<SeverityType::NOTICE>("Reading lua config file: " + filename + "\n");
 
-	mpihandler.serial([&] () {
-		// Create new Lua state and load the lua libraries
-		sel::State luaState{true};
-		bool hasLoaded = luaState.Load(filename);
+	// Create new Lua state and load the lua libraries
+	std::unique_ptr<lua_State, void(*)(lua_State*)> rawState(luaL_newstate(), lua_close);
+	if (rawState == nullptr)
+		throw std::runtime_error("Torch::setUpLua: unable to create a lua state.");
+	luaL_openlibs(rawState.get());
+	sel::State luaState{rawState.get()};
+	bool hasLoaded = false;
+	if (script.empty())
+		hasLoaded = luaState.Load(filename);
+	else
+		hasLoaded = loadLuaText(rawState.get(), script, filename);
+
+	if (!hasLoaded)
+		throw std::runtime_error("Torch::setUpLua: could not open lua file: " + filename + '\n');
+	if (!luaState.CheckNil("initialise_block")) {
+		setUpBlocks(LuaBlockSetup(rawState.get()));
+		return;
+	}
+	const double length = consts->converter.length().fromCode;
+	for (GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+		std::array<double, 3> xc, xs;
+		for (int i = 0; i < 3; ++i) {
+			xc[i] = cell.xc[i]*grid.dx[i]*length;
+			xs[i] = fluid.getStar().xc[i]*grid.dx[i]*length;
+		}
 
-		if (!hasLoaded)
-			throw std::runtime_error("Torch::setUpLua: could not open lua file: " + filename + '\n');
-		else {
-			for (GridCell& cell : grid.getIterable("GridCells")) {
-				std::array<double, 3> xc, xs;
-				for (int i = 0; i < 3; ++i) {
-					xc[i] = consts->converter.fromCodeUnits(cell.xc[i]*grid.dx[i], 0, 1, 0);
-					xs[i] = consts->converter.fromCodeUnits(fluid.getStar().xc[i]*grid.dx[i], 0, 1, 0);
-				}
-
-				sel::tie(cell.Q[UID::DEN],
-						cell.Q[UID::PRE],
-						cell.Q[UID::HII],
-						cell.Q[UID::VEL],
-						cell.Q[UID::VEL+1],
-						cell.Q[UID::VEL+2],
-						cell.GRAV[0],
-						cell.GRAV[1],
-						cell.GRAV[2])
-					= luaState["initialise"](xc[0], xc[1], xc[2], xs[0], xs[1], xs[2]);
-
-				cell.heatCapacityRatio = fluid.heatCapacityRatio;
+		Vec3 vel, grav;
+		sel::tie(cell.Q[UID::DEN],
+				cell.Q[UID::PRE],
+				cell.Q[UID::HII],
+				vel[0],
+				vel[1],
+				vel[2],
+				grav[0],
+				grav[1],
+				grav[2])
+			= luaState["initialise"](xc[0], xc[1], xc[2], xs[0], xs[1], xs[2]);
+		for (int i = 0; i < TORCH_MAX_DIMENSIONS; ++i)
+			cell.Q[UID::VEL+i] = vel[i];
+		// Only the field gravity model reads the setup's gravitational field.
+		if (grid.storesGravity()) {
+			for (int i = 0; i < TORCH_MAX_DIMENSIONS; ++i)
+				grid.getGravity(cell.id)[i] = grav[i];
+		}
+
+		cell.heatCapacityRatio = fluid.heatCapacityRatio;
+	}
+}
+
+/**
+ * @brief Describes everything the cells depend on once they are set up, converted to code units, fixed at the floors and
+ * given their ray geometry, as the key of the SetupCache: the build, the setup and its script, the grid and its
+ * processor blocks, the units, the floors, the gas and the star's position.
+ */
+std::string Torch::setupKey(const TorchParameters& p) const {
+	const Grid& grid = fluid.getGrid();
+	const Star& star = fluid.getStar();
+	std::ostringstream key;
+	key << std::setprecision(17);
+	key << "build " << TORCH_MAX_DIMENSIONS << " " << sizeof(StorageReal) << " " << RADIATION_BUILT << " " << THERMO_BUILT
+			<< " " << RestartHeader::recordSize << "\n";
+	key << "grid " << p.nd << " " << grid.ncells[0] << " " << grid.ncells[1] << " " << grid.ncells[2] << " " << grid.sideLength
+			<< " " << p.geometry << " " << grid.spatialOrder << " " << p.brickSize << " " << grid.storesRayData() << " "
+			<< grid.storesGravity() << "\n";
+	key << "processors " << MPIW::Instance().nProcessors();
+	for (int i = 0; i < 3; ++i)
+		key << " " << MPIW::Instance().getDims()[i];
+	for (int edge : grid.xEdges)
+		key << " " << edge;
+	key << "\n";
+	key << "units " << consts->converter.fromCodeUnits(1.0, 1, 0, 0) << " " << consts->converter.fromCodeUnits(1.0, 0, 1, 0) << " "
+			<< consts->converter.fromCodeUnits(1.0, 0, 0, 1) << "\n";
+	key << "gas " << fluid.heatCapacityRatio << " " << fluid.massFractionH << " " << consts->dfloor << " " << consts->pfloor << " "
+			<< consts->tfloor << " " << p.minTempInitialState << " " << p.photoIonCrossSection << "\n";
+	key << "star " << star.on << " " << star.xc[0] << " " << star.xc[1] << " " << star.xc[2] << " " << star.velocity[0] << " "
+			<< star.velocity[1] << " " << star.velocity[2] << " " << grid.currentTime << "\n";
+	key << "setup " << p.setupName << " " << p.setupLibrary << " " << p.setupNumberDensity << " " << p.setupTemperature << " "
+			<< p.setupHIIFraction << " " << p.setupCoreRadius << " " << p.setupPowerIndex << " " << p.setupOffset << "\n";
+	struct stat st;
+	if (!p.setupLibrary.empty() && stat(p.setupLibrary.c_str(), &st) == 0)
+		key << "library " << st.st_size << " " << st.st_mtime << "\n";
+	key << "script " << p.setupFile << "\n" << p.setupScript;
+	return key.str();
+}
+
+/**
+ * @brief Sets the initial conditions of this processor's GridCells a block of cells at a time.
+ * @param setup Fills in each block (see SetupProvider).
+ */
+void Torch::setUpBlocks(const SetupProvider& setup) {
+	const int blockSize = 1 << 14;
+	Grid& grid = fluid.getGrid();
+
+	std::vector<GridCell*> cells;
+	for (GridCell& cell : grid.getIterable(CellRange::GRID_CELLS))
+		cells.push_back(&cell);
+
+	const double length = consts->converter.length().fromCode;
+	std::array<std::vector<double>, 3> coords;
+	std::vector<std::vector<double>> values(9);
+	for (std::size_t first = 0; first < cells.size(); first += blockSize) {
+		int n = (int)std::min<std::size_t>(blockSize, cells.size() - first);
+		SetupBlock block;
+		block.n = n;
+		for (int i = 0; i < 3; ++i) {
+			coords[i].resize(n);
+			for (int j = 0; j < n; ++j)
+				coords[i][j] = cells[first + j]->xc[i]*grid.dx[i]*length;
+			block.star[i] = consts->converter.fromCodeUnits(fluid.getStar().xc[i]*grid.dx[i], 0, 1, 0);
+		}
+		for (std::vector<double>& value : values)
+			value.assign(n, 0);
+		block.x = coords[0].data();
+		block.y = coords[1].data();
+		block.z = coords[2].data();
+		block.den = values[0].data();
+		block.pre = values[1].data();
+		block.hii = values[2].data();
+		for (int i = 0; i < 3; ++i) {
+			block.vel[i] = values[3 + i].data();
+			block.grav[i] = values[6 + i].data();
+		}
+
+		setup.fill(block);
+
+		for (int j = 0; j < n; ++j) {
+			GridCell& cell = *cells[first + j];
+			cell.Q[UID::DEN] = block.den[j];
+			cell.Q[UID::PRE] = block.pre[j];
+			cell.Q[UID::HII] = block.hii[j];
+			for (int i = 0; i < TORCH_MAX_DIMENSIONS; ++i)
+				cell.Q[UID::VEL+i] = block.vel[i][j];
+			if (grid.storesGravity()) {
+				for (int i = 0; i < TORCH_MAX_DIMENSIONS; ++i)
+					grid.getGravity(cell.id)[i] = block.grav[i][j];
 			}
+			cell.heatCapacityRatio = fluid.heatCapacityRatio;
 		}
-	});
+	}
+}
+
+/**
+ * @brief Peak resident memory of this process (MiB).
+ */
+static double peakMemory() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+	return usage.ru_maxrss/(1024.0*1024.0);
+#else
+	return usage.ru_maxrss/1024.0;
+#endif
+}
+
+/**
+ * @brief Time this processor has spent in the integrators, less the time it spent there waiting for other processors (s).
+ */
+static double busySeconds() {
+	const Profiler::ThreadData& thread = Profiler::threadData();
+	auto total = [&](ProfileID id) { return thread.total[(unsigned int)id]; };
+	return total(ProfileID::HYDRO_FLUXES) + total(ProfileID::RADIATION_TRANSFER) + total(ProfileID::THERMO_INTEGRATE)
+			- total(ProfileID::BCS_WAIT) - total(ProfileID::RAY_RECV) - total(ProfileID::RAY_SEND_WAIT);
 }
 
 static std::string formatSuffix(int i) {
@@ -237,102 +673,388 @@ static std::string formatSuffix(int i) {
 	return header.str();
 }
 
+/**
+ * @brief Replays the communication of a step over the Grid set up by initialise, without any of the physics, and
+ * writes the latency and bandwidth of each class of message to log/comm_bench.txt (see CommBenchmark). Collective.
+ * @param repetitions Number of times each class of message is replayed.
+ */
+void Torch::benchmarkCommunication(int repetitions) {
+	CommBenchmark(fluid).run(repetitions, commBenchFilename);
+}
+
+/**
+ * @brief Writes synthetic snapshots of the Grid set up by initialise through every output format, without any of the
+ * physics, reads them back, and writes the throughput and time of each processor to log/io_bench.txt (see IOBenchmark).
+ * The snapshots are left in io_bench in the output directory. Collective.
+ * @param snapshots Number of snapshots written in each format.
+ */
+void Torch::benchmarkIO(int snapshots) {
+	IOBenchmark(fluid, consts, ioBenchDirectory, snapshotVariables, compressionLevel).run(snapshots, ioBenchFilename);
+}
+
+/**
+ * @brief Lists the active components and prepares them for the first step, once, whether the solution is marched by
+ * run or advance.
+ */
+void Torch::startComponents() {
+	if (m_isStarted)
+		return;
+	m_isStarted = true;
+	activeComponents.push_back(ComponentID::HYDRO);
+	if (cooling_on)
+		activeComponents.push_back(ComponentID::THERMO);
+	if (radiation_on)
+		activeComponents.push_back(ComponentID::RAD);
+	// The radiation sweeps trace the column densities of the cooling too, sparing it a sweep after each radiation step.
+	radiation.fuseColumnDensities((radiation_on && cooling_on) ? &thermodynamics : nullptr);
+	thermodynamics.fillHeatingArrays(fluid);
+}
+
 void Torch::run() {
 	MPIW& mpihandler = MPIW::Instance();
 
+	// A radiation processor only takes the radiation and cooling of its partner's steps, which writes the output.
+	if (mpihandler.isRadiationServer()) {
+		serveRadiation();
+		return;
+	}
+
 	double initTime = fluid.getGrid().currentTime;
 
-	fluid.globalQfromU();
-	fluid.fixPrimitives();
+	fluid.updatePrimitives();
 
 	Logger::Instance().print<SeverityType::NOTICE>("Marching solution...\n");
 	ProgressBar progBar(tmax - initTime, 1000);
 
 	Checkpointer checkpointer(tmax, ncheckpoints);
 	checkpointer.update(initTime);
+	WallClockLimit wallClock(wallTime, restartInterval);
+	OutputTrigger outputTrigger(outputTriggers[0], outputTriggers[1], outputTriggers[2], triggerMinInterval);
+	int ntriggered = 0;
+	SteadyStateMonitor steadyState(steadyEvery, steadyTolerance, steadyChecks);
+	bool isSteady = false;
+	std::signal(SIGTERM, onStopSignal);
+#ifdef SIGUSR1
+	std::signal(SIGUSR1, onStopSignal);
+#endif
+
+	// A new run may start from the photoionisation equilibrium of its initial density field instead of following the
+	// R-type ionisation front through thousands of short steps.
+	if (!m_isRestarted && radiation_on && equilibriumIterations > 0 && fluid.getStar().on)
+		radiation.solveEquilibrium(tmax - initTime, fluid, equilibriumIterations, equilibriumTolerance);
+
+	// The run that wrote a restart file has already written the output of the checkpoint it carries on from.
+	if (!m_isRestarted) {
+		inputOutput.print2D(formatSuffix(checkpointer.getCount()), initTime, fluid.getGrid());
+		inputOutput.printAnalysis(formatSuffix(checkpointer.getCount()), radiation, fluid);
+	}
+	if (outputTrigger.isOn())
+		outputTrigger.outputWritten(initTime, inputOutput.measureChange(fluid));
+
+	startComponents();
+	autotuner.start();
+	if (mpihandler.hasRadiationServer())
+		mergeRadiationResult();
+
+	// The particles are not kept in restart files, so a restarted run seeds them afresh into a file of its own.
+	if (tracersPerCell > 0) {
+		if (m_isRestarted)
+			tracerFilename = tracerFilename.substr(0, tracerFilename.size() - 4) + "_" + std::to_string(steps) + ".tpk";
+		tracers.seed(fluid.getGrid(), consts->nd, tracersPerCell);
+		tracerPack.reset(new FrameContainer(tracerFilename));
+		tracers.write(*tracerPack, "step" + std::to_string(steps), fluid, consts->converter);
+		Logger::Instance().print<SeverityType::NOTICE>("Torch::run: ", tracers.count(), " tracer particles, sampled every ",
+				tracerEvery, " steps to ", tracerFilename, "\n");
+	}
 
-	inputOutput.print2D(formatSuffix(checkpointer.getCount()), initTime, fluid.getGrid());
-
-	activeComponents.push_back(ComponentID::HYDRO);
-	if (cooling_on)
-		activeComponents.push_back(ComponentID::THERMO);
-	if (radiation_on)
-		activeComponents.push_back(ComponentID::RAD);
-
-	bool isFinalPrintOn = false;
+	bool isFinalPrintOn = (checkpointer.getCount() != ncheckpoints);
 
-	thermodynamics.fillHeatingArrays(fluid);
+	long traceEnd = steps + traceSteps;
+	if (traceSteps > 0)
+		Profiler::Instance().startTrace();
 
-	while (fluid.getGrid().currentTime < tmax && !m_isQuitting) {
+	const long runStart = steps;
+	mpihandler.barrier();
+	Timer runTimer;
+	runTimer.start();
+	long telemetryStart = steps;
+	double telemetryTime = 0;
+	// The heap allocations of the steps after the first, which sizes the buffers the later steps reuse.
+	long long steadyAllocations = 0;
+	m_busySeconds = busySeconds();
+	while (fluid.getGrid().currentTime < tmax && !m_isQuitting && !isSteady && (maxSteps == 0 || steps - runStart < maxSteps)) {
 		// Find the time until the next data snapshot. Print if it has passed.
 		double dt_nextCheckpoint = dt_max;
 
 		bool print_now = checkpointer.update(fluid.getGrid().currentTime, dt_nextCheckpoint);
 
 		if (print_now) {
-			thermodynamics.fillHeatingArrays(fluid);
-			inputOutput.printHeating(formatSuffix(checkpointer.getCount()),
-									 fluid.getGrid().currentTime,
-									 fluid.getGrid());
-
-			inputOutput.print2D(formatSuffix(checkpointer.getCount()), 
-											   fluid.getGrid().currentTime,
-											   fluid.getGrid());
+			// Finish writing the previous checkpoint's output first.
+			inputOutput.flush();
+			checkValues("checkpoint", CheckLevel::CHECKPOINT);
+			// The analysis is small enough for every checkpoint, the full snapshots can be rarer, but the last is always written.
+			if (checkpointer.getCount() % snapshotEvery == 0 || checkpointer.getCount() == ncheckpoints)
+				printSnapshots(formatSuffix(checkpointer.getCount()));
+			inputOutput.printAnalysis(formatSuffix(checkpointer.getCount()), radiation, fluid);
+			inputOutput.printTimeAverages(formatSuffix(checkpointer.getCount()), fluid.getGrid().currentTime, fluid);
+			if (outputTrigger.isOn())
+				outputTrigger.outputWritten(fluid.getGrid().currentTime, inputOutput.measureChange(fluid));
+			ntriggered = 0;
+			if (steps > runStart)
+				logTimeStepLimiter();
 			isFinalPrintOn = (checkpointer.getCount() != ncheckpoints);
+			if (restartEvery > 0 && checkpointer.getCount() % restartEvery == 0)
+				writeRestart(formatSuffix(checkpointer.getCount()), checkpointer.getCount(), wallClock);
+			Profiler::Instance().report(profileFilename, "Checkpoint " + std::to_string(checkpointer.getCount()));
 		}
+		else if (outputTrigger.isWaitOver(fluid.getGrid().currentTime)) {
+			// A change big enough between checkpoints writes the output too, named after the checkpoint before it.
+			const std::array<double, 3> measures = inputOutput.measureChange(fluid);
+			if (outputTrigger.isTriggered(measures)) {
+				const std::string name = formatSuffix(checkpointer.getCount()) + "_e" + std::to_string(++ntriggered);
+				inputOutput.flush();
+				printSnapshots(name);
+				inputOutput.printAnalysis(name, radiation, fluid);
+				outputTrigger.outputWritten(fluid.getGrid().currentTime, measures);
+			}
+		}
+
+		// Whether to write a restart file or stop after this step is agreed by the processors in calculateTimeStep.
+		const double elapsed = m_wallClock.getTicks();
+		m_isStopping = stopSignal != 0 || wallClock.isStopDue(elapsed);
+		m_isRestartDue = wallClock.isRestartDue(elapsed);
+
+		// The self-gravity of the state the step starts from, held for the next gravityEvery steps.
+		if (gravityEvery > 0 && (steps - runStart) % gravityEvery == 0)
+			gravity.solve(fluid.getGrid());
 
 		// Perform full integration time-step of all physics sub-problems.
-		fluid.getGrid().deltatime = fullStep(dt_nextCheckpoint);
+		{
+			ScopedTimer timer(ProfileID::STEP);
+			autotuner.beginStep();
+			const double stepStart = runTimer.getTicks();
+			const long long allocationsStart = Allocations::count();
+			fluid.getGrid().deltatime = fullStep(dt_nextCheckpoint);
+			if (steps > runStart)
+				steadyAllocations += Allocations::count() - allocationsStart;
+			autotuner.endStep(runTimer.getTicks() - stepStart);
+		}
 		fluid.getGrid().currentTime += fluid.getGrid().deltatime;
 		++steps;
+		if (fluid.moveStar(fluid.getGrid().currentTime))
+			radiation.initField(fluid);
+		checkValues("step " + std::to_string(steps), CheckLevel::STEP);
+		if (tracerPack) {
+			tracers.advect(fluid.getGrid(), fluid.getGrid().deltatime);
+			if ((steps - runStart) % tracerEvery == 0)
+				tracers.write(*tracerPack, "step" + std::to_string(steps), fluid, consts->converter);
+		}
+		if (renderer.isDue(steps))
+			renderer.render(fluid);
+		inputOutput.printRegions(steps, fluid.getGrid().currentTime, fluid);
+		inputOutput.printPreview(steps, fluid.getGrid().currentTime, fluid);
+		inputOutput.accumulateTimeAverages(fluid.getGrid().deltatime, radiation, fluid);
+		if (Profiler::Instance().isTracing() && steps == traceEnd)
+			Profiler::Instance().writeTrace(traceFilename);
+		if (telemetryEvery > 0 && (steps - runStart) % telemetryEvery == 0) {
+			logTelemetry(steps - telemetryStart, runTimer.getTicks() - telemetryTime);
+			telemetryStart = steps;
+			telemetryTime = runTimer.getTicks();
+		}
+		if (steadyState.isDue(steps - runStart) && steadyState.update(fluid)) {
+			// The final output is written after the loop, as at the end time.
+			isSteady = true;
+			Logger::Instance().print<SeverityType::NOTICE>("Torch::run: steady state at step ", steps, ", relative rate of change ",
+					consts->converter.fromCodeUnits(steadyState.getRate(), 0, 0, -1), " s-1.\n");
+		}
+		if (rebalanceEvery > 0 && (steps - runStart) % rebalanceEvery == 0)
+			rebalance();
+		if (refinementEvery > 0 && (steps - runStart) % refinementEvery == 0)
+			estimateRefinement();
+		wallClock.stepTaken(m_wallClock.getTicks() - elapsed);
+		if (m_isStopping || m_isRestartDue)
+			writeRestart("step" + std::to_string(steps), checkpointer.getCount(), wallClock);
+		if (m_isStopping)
+			Logger::Instance().print<SeverityType::NOTICE>("Torch::run: stopping at step ", steps, " for ",
+					stopSignal != 0 ? "a stop signal" : "the wall clock limit", ", carry on from restart_step", steps, ".trst\n");
 
 		if (progBar.timeToUpdate()) {
 			progBar.update(fluid.getGrid().currentTime - initTime);
 			Logger::Instance().print<SeverityType::INFO>(progBar.getFullString(), "\r");
 		}
+		Logger::Instance().collect();
+	}
+	if (mpihandler.hasRadiationServer()) {
+		mpihandler.postPartner(std::vector<double>{fluid.getGrid().currentTime, 0, 1});
+		mpihandler.waitPartner();
 	}
 
-	if (isFinalPrintOn) {
+	mpihandler.barrier();
+	runTimer.pause();
+	double runSeconds = runTimer.getTicks();
+	writePerformance(steps - runStart, runSeconds, steps - runStart > 1 ? (double)steadyAllocations/(steps - runStart - 1) : 0);
+	if (m_fallbackSteps > 0)
+		Logger::Instance().print<SeverityType::NOTICE>("Torch::run: ", m_fallbackSteps, " hydrodynamic steps retaken at first order for ",
+				m_fallbackCells, " invalid cells.\n");
+
+	if (isFinalPrintOn && !m_isStopping) {
 		inputOutput.print2D(formatSuffix(ncheckpoints), fluid.getGrid().currentTime, fluid.getGrid());
+		inputOutput.printAnalysis(formatSuffix(ncheckpoints), radiation, fluid);
+		inputOutput.printTimeAverages(formatSuffix(ncheckpoints), fluid.getGrid().currentTime, fluid);
 	}
+	inputOutput.flush();
+	OutputStaging::Instance().finish();
+	if (Profiler::Instance().isTracing())
+		Profiler::Instance().writeTrace(traceFilename);
+	Profiler::Instance().report(profileFilename, "End of run");
 
 	mpihandler.barrier();
 	progBar.end();
 	Logger::Instance().print<SeverityType::NOTICE>(progBar.getFinalString(), '\n');
 }
 
+/**
+ * @brief Marches the solution on by a time, for a program Torch is embedded in (see TorchAPI.h). Collective.
+ *
+ * Unlike run, nothing is written: the checkpoints, restart files and telemetry are left to the caller, which reads and
+ * changes the state between calls through getField and the Star setters.
+ * @param dt Time to march on by (s).
+ * @exception std::runtime_error Thrown if the time step collapses before the time is reached.
+ */
+void Torch::advance(double dt) {
+	startComponents();
+	Grid& grid = fluid.getGrid();
+	const double tend = grid.currentTime + consts->converter.toCodeUnits(dt, 0, 0, 1);
+	while (grid.currentTime < tend) {
+		if (gravityEvery > 0 && steps % gravityEvery == 0)
+			gravity.solve(grid);
+		{
+			ScopedTimer timer(ProfileID::STEP);
+			grid.deltatime = fullStep(std::min(dt_max, tend - grid.currentTime));
+		}
+		if (m_isQuitting)
+			throw std::runtime_error("Torch::advance: the time step collapsed at step " + std::to_string(steps) + ".");
+		grid.currentTime += grid.deltatime;
+		++steps;
+		if (fluid.moveStar(grid.currentTime))
+			radiation.initField(fluid);
+		checkValues("step " + std::to_string(steps), CheckLevel::STEP);
+		Logger::Instance().collect();
+	}
+}
+
+/**
+ * @brief Gets the simulation time (s).
+ */
+double Torch::getTime() const {
+	return consts->converter.fromCodeUnits(fluid.getGrid().currentTime, 0, 0, 1);
+}
+
+/**
+ * @brief Gets a view of a primitive variable of this processor's core cells, in place and in code units.
+ *
+ * The cells are in the order of their IDs (see Grid::flatIndex). The view lasts until the Grid is rebuilt (e.g. by a
+ * load balance). A caller that writes through it calls fieldsChanged before the next advance.
+ */
+CellFieldView Torch::getField(UID::ID id) {
+	GridCellVector& cells = fluid.getGrid().getCells();
+	FieldLooper fields = fluid.getGrid().getFieldIterable(CellRange::GRID_CELLS);
+	CellFieldView view;
+	view.size = fields.last() - fields.first();
+	view.stride = sizeof(GridCell);
+	view.data = view.size > 0 ? &cells[fields.first()].Q[id] : nullptr;
+	return view;
+}
+
+/**
+ * @brief Brings the conserved variables up to date with primitive variables changed through getField.
+ */
+void Torch::fieldsChanged() {
+	fluid.globalUfromQ();
+}
+
+Fluid& Torch::getFluid() {
+	return fluid;
+}
+
+const Fluid& Torch::getFluid() const {
+	return fluid;
+}
+
+/**
+ * @brief Gets the ionising photon rate (s-1) and wind mass loss rate (g s-1) of the Star.
+ */
+void Torch::getStarRates(double& photonRate, double& massLossRate) const {
+	photonRate = consts->converter.fromCodeUnits(fluid.getStar().photonRate, 0, 0, -1);
+	massLossRate = consts->converter.fromCodeUnits(fluid.getStar().massLossRate, 1, 0, -1);
+}
+
+/**
+ * @brief Changes the ionising photon rate (s-1) and wind mass loss rate (g s-1) of the Star. Collective.
+ */
+void Torch::setStarRates(double photonRate, double massLossRate) {
+	fluid.setStarRates(consts->converter.toCodeUnits(photonRate, 0, 0, -1), consts->converter.toCodeUnits(massLossRate, 1, 0, -1));
+}
+
+/**
+ * @brief Gets the Grid coordinates of the cell the Star is in.
+ */
+std::array<int, 3> Torch::getStarPosition() const {
+	const Star& star = fluid.getStar();
+	return std::array<int, 3>{{ (int)std::floor(star.xc[0]), (int)std::floor(star.xc[1]), (int)std::floor(star.xc[2]) }};
+}
+
+/**
+ * @brief Moves the Star to another cell and rebuilds the ray geometry around it. Collective.
+ * @param position Grid coordinates of the cell.
+ */
+void Torch::setStarPosition(const std::array<int, 3>& position) {
+	const int placements = fluid.getStarPlacements();
+	fluid.setStarPosition(position);
+	if (fluid.getStarPlacements() != placements)
+		radiation.initField(fluid);
+}
+
 double Torch::calculateTimeStep() {
-	static bool first_time = true;
-	double dt;
-	if (first_time) {
-		dt = dt_max*1.0e-20;
-		first_time = false;
+	// The time steps of the components and the quit flag are reduced over the processors together, in one collective
+	// that also finds the processor limiting each component (see logTimeStepLimiter).
+	std::array<double, 6> local;
+	local.fill(m_isQuitting ? 0.0 : 1.0);
+	local[4] = m_isStopping ? 0.0 : 1.0;
+	local[5] = m_isRestartDue ? 0.0 : 1.0;
+	local[(unsigned int)ComponentID::HYDRO] = hydrodynamics.calculateTimeStep(dt_max, fluid);
+	if (MPIW::Instance().hasRadiationServer()) {
+		// Found by the radiation processor from the state it left at the end of the last step (see serveRadiation).
+		local[(unsigned int)ComponentID::RAD] = m_partnerTimeSteps[0];
+		local[(unsigned int)ComponentID::THERMO] = cooling_on ? m_partnerTimeSteps[1] : local[0];
 	}
 	else {
-		double dt_hydro = hydrodynamics.calculateTimeStep(dt_max, fluid);
-		double dt_rad = dt_hydro;
-		double dt_thermo = dt_hydro;
-		if (radiation_on)
-			dt_rad = radiation.calculateTimeStep(dt_max, fluid);
-		if (cooling_on)
-			dt_thermo = thermodynamics.calculateTimeStep(dt_max, fluid);
-		dt = std::min(std::min(dt_hydro, dt_rad), dt_thermo);
-
-		if (debug) {
-			double thyd = 100.0*dt_hydro/tmax;
-			thyd = MPIW::Instance().minimum(thyd);
-			double trad = 100.0*dt_rad/tmax;
-			trad = MPIW::Instance().minimum(trad);
-			double ttherm = 100.0*dt_thermo/tmax;
-			ttherm = MPIW::Instance().minimum(ttherm);
-
-			if (thyd <= 1.0e-6 || thyd <= 1.0e-6 || thyd <= 1.0e-6) {
-				Logger::Instance().print<SeverityType::ERROR>("Integration deltas are too small.\n");
-				m_isQuitting = true;
-			}
-		}
+		local[(unsigned int)ComponentID::RAD] = radiation_on ? radiation.calculateTimeStep(dt_max, fluid) : local[0];
+		local[(unsigned int)ComponentID::THERMO] = cooling_on ? thermodynamics.calculateTimeStep(dt_max, fluid) : local[0];
+	}
+	std::array<double, 6> global;
+	std::array<int, 6> ranks;
+	MPIW::Instance().minimum((int)local.size(), local.data(), global.data(), ranks.data());
+	std::copy(global.begin(), global.begin() + 3, m_componentTimeSteps.begin());
+	std::copy(ranks.begin(), ranks.begin() + 3, m_componentLimitRanks.begin());
+	m_isStopping = global[4] == 0;
+	m_isRestartDue = global[5] == 0;
+	m_isQuitting = global[3] == 0 || m_isStopping;
+	double dt = *std::min_element(m_componentTimeSteps.begin(), m_componentTimeSteps.end());
+	// The radiation and cooling subcycle within the hydrodynamic step (see multiRateStep).
+	if (isMultiRate()) {
+		const double fast = std::min(m_componentTimeSteps[(unsigned int)ComponentID::RAD], m_componentTimeSteps[(unsigned int)ComponentID::THERMO]);
+		dt = std::min(m_componentTimeSteps[(unsigned int)ComponentID::HYDRO], radSubcycles*fast);
+	}
+	// The first step is the smallest the limiters allow on the initial state, from which the steps grow gradually.
+	if (m_previousTimeStep > 0)
+		dt = std::min(dt, dtGrowth*m_previousTimeStep);
+	m_previousTimeStep = dt;
+
+	if (debug && 100.0*dt/tmax <= 1.0e-6) {
+		Logger::Instance().print<SeverityType::ERROR>("Integration deltas are too small.\n");
+		m_isQuitting = true;
 	}
-	dt = MPIW::Instance().minimum(dt);
 	inputOutput.reduceToPrint(fluid.getGrid().currentTime, dt);
 	fluid.getGrid().deltatime = dt;
 	return dt;
@@ -350,45 +1072,173 @@ Integrator& Torch::getComponent(ComponentID id) {
 }
 
 void Torch::subStep(double dt, bool hasCalculatedHeatFlux, Integrator& comp) {
-	checkValues(comp.getComponentName() + "before");
+	if (&comp == &hydrodynamics && fallbackSubsteps > 0 && !m_isGuarded) {
+		guardHydroStep(dt, hasCalculatedHeatFlux, [&](double h, bool hasCalculated) { subStep(h, hasCalculated, comp); });
+		return;
+	}
+	if (&comp == &hydrodynamics && sspStages > 0) {
+		rungeKuttaStep(dt, hasCalculatedHeatFlux);
+		return;
+	}
+	checkValues(comp.componentName, CheckLevel::PARANOID, "before");
+	// Only the hydrodynamics changes the density, which the column densities are traced through.
+	if (&comp == &hydrodynamics)
+		fluid.getGrid().hasColumnDensities = false;
 	if (!hasCalculatedHeatFlux) {
-		fluid.globalQfromU();
-		fluid.fixPrimitives();
+		// With fused updates the previous sub-step ended with Fluid::advanceAndFix, which leaves Q up to date.
+		if (fusedUpdates)
+			fluid.updatePrimitives();
+		else {
+			fluid.globalQfromU();
+			fluid.fixPrimitives();
+		}
 		comp.preTimeStepCalculations(fluid);
 	}
 	comp.integrate(dt, fluid);
 	comp.updateSourceTerms(dt, fluid);
-	fluid.advSolution(dt);
-	fluid.fixSolution();
-	checkValues(comp.getComponentName() + " after");
+	if (fusedUpdates)
+		fluid.advanceAndFix(dt);
+	else {
+		fluid.advSolution(dt);
+		fluid.fixSolution();
+	}
+	checkValues(comp.componentName, CheckLevel::PARANOID, "after");
 }
 
+/**
+ * @brief Takes a hydrodynamic step, with a predictor of half the step first if temporalOrder is 2.
+ *
+ * The fused predictor leaves the conserved variables alone and only sets the primitive variables the corrector's fluxes
+ * are found from, so only the separate sweeps keep a copy of the conserved variables in GridCell::W.
+ * @param dt Time step.
+ * @param hasCalculatedHeatFlux Whether the primitive variables and precalculations are already up to date.
+ */
 void Torch::hydroStep(double dt, bool hasCalculatedHeatFlux) {
-	checkValues("hydro before");
-	fluid.globalWfromU();
+	if (fallbackSubsteps > 0 && !m_isGuarded) {
+		guardHydroStep(dt, hasCalculatedHeatFlux, [&](double h, bool hasCalculated) { hydroStep(h, hasCalculated); });
+		return;
+	}
+	if (sspStages > 0) {
+		rungeKuttaStep(dt, hasCalculatedHeatFlux);
+		return;
+	}
+	checkValues("hydro before", CheckLevel::PARANOID);
+	fluid.getGrid().hasColumnDensities = false;
+	const bool predict = (temporalOrder == 2);
+	if (predict && !fusedUpdates)
+		fluid.globalWfromU();
 	if (!hasCalculatedHeatFlux) {
 		fluid.globalQfromU();
 		fluid.fixPrimitives();
 		hydrodynamics.preTimeStepCalculations(fluid);
 	}
-	hydrodynamics.integrate(dt, fluid);
-	hydrodynamics.updateSourceTerms(dt, fluid);
+	if (predict) {
+		hydrodynamics.integrate(dt, fluid);
+		hydrodynamics.updateSourceTerms(dt, fluid);
 
-	fluid.advSolution(dt/2.0);
-	fluid.fixSolution();
+		if (fusedUpdates)
+			fluid.predictPrimitives(dt/2.0);
+		else {
+			fluid.advSolution(dt/2.0);
+			fluid.fixSolution();
 
-	// Corrector.
-	fluid.globalQfromU();
-	fluid.globalUfromW();
+			// Corrector.
+			fluid.globalQfromU();
+			fluid.globalUfromW();
+		}
+	}
 	hydrodynamics.integrate(dt, fluid);
 	hydrodynamics.updateSourceTerms(dt, fluid);
-	fluid.advSolution(dt);
-	fluid.fixSolution();
+	if (fusedUpdates)
+		fluid.advanceAndFix(dt);
+	else {
+		fluid.advSolution(dt);
+		fluid.fixSolution();
+	}
+}
+
+/**
+ * @brief Takes a hydrodynamic step and, if it leaves any invalid cells (see Fluid::countInvalidCells) on any processor,
+ * takes it again from the state it started from as fallbackSubsteps sub-steps at first order with the HLL solver (see
+ * Hydrodynamics::setFallback), which keep the density and pressure positive for a small enough time step. Collective.
+ *
+ * Most steps only cost a copy of the conserved variables and a sum over the processors of the invalid cells.
+ * @param dt Time step.
+ * @param hasCalculatedHeatFlux Whether the primitive variables and precalculations are already up to date.
+ * @param step Takes a hydrodynamic step of its first argument (hydroStep or subStep).
+ * @exception std::runtime_error Thrown if the retaken step leaves invalid cells too.
+ */
+void Torch::guardHydroStep(double dt, bool hasCalculatedHeatFlux, const std::function<void(double, bool)>& step) {
+	m_isGuarded = true;
+	fluid.saveConserved();
+	step(dt, hasCalculatedHeatFlux);
+	double ninvalid = fluid.countInvalidCells();
+	ninvalid = MPIW::Instance().sum(ninvalid);
+	if (ninvalid > 0) {
+		++m_fallbackSteps;
+		m_fallbackCells += (long)ninvalid;
+		Logger::Instance().print<SeverityType::WARNING>("Torch::guardHydroStep: ", (long)ninvalid, " invalid cells at step ", steps,
+				", retaking the hydrodynamic step at first order in ", fallbackSubsteps, " sub-steps.\n");
+		fluid.restoreConserved();
+		hydrodynamics.setFallback(true);
+		for (int i = 0; i < fallbackSubsteps; ++i)
+			step(dt/fallbackSubsteps, false);
+		hydrodynamics.setFallback(false);
+		// Checked whatever the check level, as there is nothing left to fall back to.
+		checkValues("hydro fallback", CheckLevel::OFF);
+	}
+	m_isGuarded = false;
+}
+
+/**
+ * @brief Takes a hydrodynamic step as a strong stability preserving Runge-Kutta step of sspStages stages (Shu & Osher 1988).
+ *
+ * Every stage takes a forward Euler step of dt from the state the last one left, then averages it with the state the
+ * step started from, which is kept in GridCell::W: by 1/2 after the second of two stages and by 3/4 and 1/3 after the
+ * second and third of three. So the steps take no more storage than the predictor-corrector's and are stable up to a
+ * CFL number of 1.
+ * @param dt Time step.
+ * @param hasCalculatedHeatFlux Whether the primitive variables and precalculations are already up to date.
+ */
+void Torch::rungeKuttaStep(double dt, bool hasCalculatedHeatFlux) {
+	static const double weights[2][3] = {{ 0, 0.5, 0 }, { 0, 0.75, 1.0/3.0 }};
+	checkValues("hydro before", CheckLevel::PARANOID);
+	fluid.getGrid().hasColumnDensities = false;
+	fluid.globalWfromU();
+	for (int stage = 0; stage < sspStages; ++stage) {
+		if (stage > 0 || !hasCalculatedHeatFlux) {
+			if (fusedUpdates)
+				fluid.updatePrimitives();
+			else {
+				fluid.globalQfromU();
+				fluid.fixPrimitives();
+			}
+		}
+		hydrodynamics.integrate(dt, fluid);
+		hydrodynamics.updateSourceTerms(dt, fluid);
+		if (fusedUpdates)
+			fluid.advanceAndFix(dt);
+		else {
+			fluid.advSolution(dt);
+			fluid.fixSolution();
+		}
+		const double weight = weights[sspStages - 2][stage];
+		if (weight > 0)
+			fluid.blendWithW(weight);
+	}
+	checkValues("hydro after", CheckLevel::PARANOID);
 }
 
 double Torch::fullStep(double dt_nextCheckPoint) {
-	fluid.globalQfromU();
-	fluid.fixPrimitives();
+	if (MPIW::Instance().hasRadiationServer())
+		return pipelinedStep(dt_nextCheckPoint);
+	// With fused updates the conversion is skipped unless something besides the last step changed the conserved variables.
+	if (fusedUpdates)
+		fluid.updatePrimitives();
+	else {
+		fluid.globalQfromU();
+		fluid.fixPrimitives();
+	}
 	if (cooling_on)
 		thermodynamics.preTimeStepCalculations(fluid);
 	if (radiation_on)
@@ -402,44 +1252,621 @@ double Torch::fullStep(double dt_nextCheckPoint) {
 		hydroStep(dt, true);
 		return dt;
 	}
+	if (isMultiRate()) {
+		multiRateStep(dt);
+		return dt;
+	}
 
 	stepCounter = (stepCounter+1)%ncomps;
 
+	// The Strang split sequence of sub-steps: each component for half the step, the last for all of it, then back again.
+	// There are at most three components, so at most five sub-steps.
+	std::array<ComponentID, 5> sequence;
+	std::array<double, 5> timeSteps;
+	int nsubsteps = 0;
 	for (int i = 0; i < ncomps; ++i) {
 		double h = (i == ncomps-1) ? 1.0 : 0.5;
-		subStep(h*dt, i == 0, getComponent(activeComponents[(i+stepCounter)%ncomps]));
+		sequence[nsubsteps] = activeComponents[(i+stepCounter)%ncomps];
+		timeSteps[nsubsteps++] = h*dt;
 	}
-
 	for (int i = ncomps-2; i >= 0; --i) {
-		subStep(dt/2.0, false, getComponent(activeComponents[(i+stepCounter)%ncomps]));
+		sequence[nsubsteps] = activeComponents[(i+stepCounter)%ncomps];
+		timeSteps[nsubsteps++] = dt/2.0;
+	}
+
+	const bool overlap = canOverlapCooling();
+	for (int k = 0; k < nsubsteps; ++k) {
+		if (overlap && k + 1 < nsubsteps && sequence[k] == ComponentID::RAD && sequence[k+1] == ComponentID::THERMO) {
+			radiationCoolingSubSteps(timeSteps[k], k == 0, timeSteps[k+1]);
+			++k;
+		}
+		else
+			subStep(timeSteps[k], k == 0, getComponent(sequence[k]));
 	}
 
 	return dt;
 }
 
-void Torch::checkValues(std::string componentname) {
-	bool error = false;
-	for (GridCell& cell : fluid.getGrid().getIterable("GridCells")) {
-		for (int i = 0; i < UID::N; ++i) {
-			if (cell.U[i] != cell.U[i] || std::isinf(cell.U[i]) || cell.Q[UID::DEN] == 0 || cell.Q[UID::PRE] == 0) {
-				error = true;
-				break;
-			}
+/**
+ * @brief Takes a step with the radiation and cooling left to the radiation processor (see MPIW::splitRadiation), which
+ * takes them alongside the hydrodynamic step rather than after it.
+ *
+ * The state the step starts from is handed to the radiation processor, which takes a radiation sub-step of dt/2, a
+ * cooling one of dt and another radiation one of dt/2 from it while this processor takes the hydrodynamic step of dt.
+ * The changes the radiation and cooling made, per unit mass, are then added to the state the hydrodynamics left (see
+ * mergeRadiationResult). The components are thus split side by side, to first order in dt, instead of one after the
+ * other, and the radiation and cooling time steps are those of the state the radiation processor left at the end of
+ * the last step, which the growth of the time step (dt_growth) keeps close to the state the step starts from. The
+ * step takes as long as the slower of the two processors rather than both together.
+ * @param dt_nextCheckPoint Time until the next checkpoint, which the step may not pass.
+ * @return The time step.
+ */
+double Torch::pipelinedStep(double dt_nextCheckPoint) {
+	if (fusedUpdates)
+		fluid.updatePrimitives();
+	else {
+		fluid.globalQfromU();
+		fluid.fixPrimitives();
+	}
+	const double dt = std::min(dt_nextCheckPoint, calculateTimeStep());
+
+	Grid& grid = fluid.getGrid();
+	std::vector<double> state = {grid.currentTime, dt, 0};
+	for (const GridCell& cell : grid.getIterable(CellRange::GRID_CELLS))
+		state.insert(state.end(), std::begin(cell.U), std::end(cell.U));
+	MPIW::Instance().postPartner(std::move(state));
+
+	hydroStep(dt, true);
+	mergeRadiationResult();
+	return dt;
+}
+
+/**
+ * @brief Takes the radiation and cooling of the steps of this radiation processor's partner (see pipelinedStep) until
+ * the partner stops.
+ *
+ * Each step starts with a message from the partner holding the time, the time step, whether to stop and the conserved
+ * variables of each core cell, the cells of both processors being the same. The state is held in GridCell::W while
+ * the sub-steps are taken, and the result is returned by radiationResult.
+ */
+void Torch::serveRadiation() {
+	MPIW& mpihandler = MPIW::Instance();
+	Grid& grid = fluid.getGrid();
+	startComponents();
+	const bool overlap = canOverlapCooling();
+
+	fluid.globalWfromU();
+	mpihandler.postPartner(radiationResult());
+	for (std::vector<double> state = mpihandler.receivePartner(); state[2] == 0; state = mpihandler.receivePartner()) {
+		grid.currentTime = state[0];
+		const double dt = grid.deltatime = state[1];
+		if (fluid.moveStar(grid.currentTime))
+			radiation.initField(fluid);
+		std::size_t k = 3;
+		for (GridCell& cell : grid.getIterable(CellRange::GRID_CELLS)) {
+			std::copy(state.begin() + k, state.begin() + k + UID::N, std::begin(cell.W));
+			k += UID::N;
+		}
+		fluid.globalUfromW();
+		grid.hasColumnDensities = false;
+
+		if (overlap)
+			radiationCoolingSubSteps(dt/2.0, false, dt);
+		else {
+			subStep(dt/2.0, false, radiation);
+			if (cooling_on)
+				subStep(dt, false, thermodynamics);
+		}
+		subStep(dt/2.0, false, radiation);
+		checkValues("radiation processor", CheckLevel::STEP);
+		mpihandler.postPartner(radiationResult());
+	}
+	mpihandler.waitPartner();
+}
+
+/**
+ * @brief The message a radiation processor returns to its partner at the end of a step (see serveRadiation).
+ *
+ * It holds the radiation and cooling time steps of the state the step has left, with the criterion and cell that
+ * limited each, then for each core cell the change of its conserved variables per unit mass since GridCell::W, its
+ * radiation variables (GridCell::R) and its thermodynamic ones (GridCell::T).
+ */
+std::vector<double> Torch::radiationResult() {
+	fluid.updatePrimitives();
+	if (cooling_on)
+		thermodynamics.preTimeStepCalculations(fluid);
+	radiation.preTimeStepCalculations(fluid);
+	const double dtRadiation = radiation.calculateTimeStep(dt_max, fluid);
+	const double dtCooling = cooling_on ? thermodynamics.calculateTimeStep(dt_max, fluid) : dt_max;
+	const TimeStepLimiter& radiationLimiter = radiation.getTimeStepLimiter();
+	const TimeStepLimiter& coolingLimiter = thermodynamics.getTimeStepLimiter();
+	std::vector<double> result = {dtRadiation, dtCooling, (double)radiationLimiter.criterion, (double)radiationLimiter.cellID,
+		(double)coolingLimiter.criterion, (double)coolingLimiter.cellID};
+	for (const GridCell& cell : fluid.getGrid().getIterable(CellRange::GRID_CELLS)) {
+		for (int i = 0; i < UID::N; ++i)
+			result.push_back((cell.U[i] - cell.W[i])/cell.W[UID::DEN]);
+		result.insert(result.end(), std::begin(cell.R), std::end(cell.R));
+		result.insert(result.end(), std::begin(cell.T), std::end(cell.T));
+	}
+	return result;
+}
+
+/**
+ * @brief Receives the result of the radiation processor's step (see radiationResult) and adds the changes it made to
+ * the state of this processor, per unit mass so that they apply to the mass the hydrodynamics has moved into each cell.
+ */
+void Torch::mergeRadiationResult() {
+	const std::vector<double> result = MPIW::Instance().receivePartner();
+	m_partnerTimeSteps = std::array<double, 2>{{ result[0], result[1] }};
+	TimeStepLimiter limiter;
+	limiter.criterion = (TimeStepCriterion)(int)result[2];
+	limiter.cellID = (int)result[3];
+	radiation.setTimeStepLimiter(limiter);
+	limiter.criterion = (TimeStepCriterion)(int)result[4];
+	limiter.cellID = (int)result[5];
+	thermodynamics.setTimeStepLimiter(limiter);
+	std::size_t k = 6;
+	for (GridCell& cell : fluid.getGrid().getIterable(CellRange::GRID_CELLS)) {
+		const double den = cell.U[UID::DEN];
+		for (int i = 0; i < UID::N; ++i)
+			cell.U[i] += den*result[k + i];
+		k += UID::N;
+		std::copy(result.begin() + k, result.begin() + k + RID::N, std::begin(cell.R));
+		k += RID::N;
+		std::copy(result.begin() + k, result.begin() + k + TID::N, std::begin(cell.T));
+		k += TID::N;
+	}
+	fluid.fixSolution();
+}
+
+/**
+ * @brief Whether the radiation and cooling subcycle within the hydrodynamic steps (see multiRateStep).
+ */
+bool Torch::isMultiRate() const {
+	return radSubcycles > 1 && (radiation_on || cooling_on);
+}
+
+/**
+ * @brief Brings the primitive variables and the rates of the radiation and cooling up to date and finds the time step
+ * they allow over all the processors. Collective.
+ * @return The smaller of the radiation and cooling time steps.
+ */
+double Torch::fastTimeStep() {
+	fluid.updatePrimitives();
+	double dt = dt_max;
+	if (cooling_on) {
+		thermodynamics.preTimeStepCalculations(fluid);
+		dt = std::min(dt, thermodynamics.calculateTimeStep(dt_max, fluid));
+	}
+	if (radiation_on) {
+		radiation.preTimeStepCalculations(fluid);
+		dt = std::min(dt, radiation.calculateTimeStep(dt_max, fluid));
+	}
+	return MPIW::Instance().minimum(dt);
+}
+
+/**
+ * @brief Takes a step of dt with the radiation and cooling subcycled at their own time step within it.
+ *
+ * Half a hydrodynamic step is followed by radiation and cooling sub-steps spanning dt and by the other half of the
+ * hydrodynamic step. Only the hydrodynamics moves mass, so the density is frozen while the radiation and cooling
+ * subcycle. Each subcycle splits what is left of dt into equal sub-steps no longer than the time step found from the
+ * state it starts from, and takes the first of them: a radiation sub-step followed by a cooling one, overlapped if
+ * they can be (see radiationCoolingSubSteps).
+ * @param dt Time step of the hydrodynamics, at most rad_subcycles radiation and cooling time steps at its start.
+ */
+void Torch::multiRateStep(double dt) {
+	subStep(dt/2.0, true, hydrodynamics);
+
+	const bool overlap = canOverlapCooling();
+	double remaining = dt;
+	while (remaining > 0) {
+		const int n = std::max(1, (int)std::ceil(remaining/fastTimeStep()*(1.0 - 1.0e-12)));
+		const double h = (n == 1) ? remaining : remaining/n;
+		if (overlap)
+			radiationCoolingSubSteps(h, true, h);
+		else {
+			if (radiation_on)
+				subStep(h, true, radiation);
+			if (cooling_on)
+				subStep(h, !radiation_on, thermodynamics);
 		}
-		if (error)
+		remaining = (n == 1) ? 0 : remaining - h;
+	}
+
+	subStep(dt/2.0, false, hydrodynamics);
+}
+
+/**
+ * @brief Whether a radiation sub-step and the cooling sub-step after it can be taken together, a ray tile at a time
+ * (see radiationCoolingSubSteps).
+ *
+ * Needs the fused updates, which leave the primitive variables of each tile up to date, the column densities of the
+ * cooling traced in the radiation sweep and no per sub-step checks or logs that read the whole Grid in between.
+ */
+bool Torch::canOverlapCooling() const {
+	return overlapCooling && fusedUpdates && radiation_on && cooling_on && consts->checkLevel < CheckLevel::PARANOID
+			&& radiation.fusesColumnDensities(thermodynamics) && thermodynamics.canCoolTiles();
+}
+
+/**
+ * @brief Takes a radiation sub-step and the cooling sub-step that follows it, overlapping the cooling with the radiation
+ * sweep.
+ *
+ * Equivalent to subStep(dtRadiation, hasCalculatedHeatFlux, radiation) followed by subStep(dtCooling, false,
+ * thermodynamics), but each ray tile has its radiation source terms added and is advanced, cooled and advanced again as
+ * soon as its HII fractions have been solved and its column densities sent (see Radiation::integrate). The cooling of a
+ * tile only reads and writes the tile's own cells, and the ray tracing of the tiles further from the star only reads the
+ * column densities, which the cooling leaves alone, so the state is the same as taking the sub-steps one after the
+ * other. The cooling of the tiles then fills the time a processor would spend waiting for the column densities of its
+ * next tile from the processors nearer the star.
+ * @param dtRadiation Time step of the radiation sub-step.
+ * @param hasCalculatedHeatFlux Whether the heating rates of the radiation are already up to date.
+ * @param dtCooling Time step of the cooling sub-step.
+ */
+void Torch::radiationCoolingSubSteps(double dtRadiation, bool hasCalculatedHeatFlux, double dtCooling) {
+	if (!hasCalculatedHeatFlux) {
+		fluid.updatePrimitives();
+		radiation.preTimeStepCalculations(fluid);
+	}
+	Parallel::Extremum fastestCell = {0, -1};
+	auto finishTile = [&](const RayTile& tile) {
+		radiation.updateSourceTerms(dtRadiation, fluid, tile);
+		fluid.advanceAndFix(dtRadiation, tile);
+		thermodynamics.coolTile(dtCooling, fluid, tile);
+		const Parallel::Extremum rate = fluid.advanceAndFix(dtCooling, tile);
+		if (rate.value > fastestCell.value)
+			fastestCell = rate;
+	};
+	// Passed by reference, so the std::function does not copy the lambda to the heap.
+	radiation.integrate(dtRadiation, fluid, std::cref(finishTile));
+	if (fluid.getStar().on && !fluid.getGrid().hasColumnDensities)
+		throw std::runtime_error("Torch::radiationCoolingSubSteps: the radiation sweep did not trace the column densities of the cooling.");
+	fluid.finishTileUpdates(fastestCell);
+}
+
+/**
+ * @brief Throws if any GridCell holds an invalid state, provided the configured check level is at least level.
+ *
+ * The state is first tested with a single reduction over the grid (Fluid::countInvalidCells); the detailed diagnostic is
+ * only built once that test has tripped.
+ * @param componentname Name of the component (or stage) reported in the error message.
+ * @param level Check level at which this check is enabled.
+ * @param stage Stage of the component reported after its name (e.g. "before"), so that the name is only put together
+ * for the error message.
+ * @exception std::runtime_error Thrown if a GridCell has a NaN or infinite conserved variable or zero density or pressure.
+ */
+void Torch::checkValues(const std::string& componentname, CheckLevel level, const char* stage) {
+	if (level > consts->checkLevel || fluid.countInvalidCells() == 0)
+		return;
+
+	std::stringstream ss;
+	ss << '\n' << componentname << (stage[0] != '\0' ? " " : "") << stage << " produced an error.\n";
+	for (const GridCell& cell : fluid.getGrid().getIterable(CellRange::GRID_CELLS)) {
+		if (!fluid.isValid(cell)) {
+			ss << cell.printInfo();
 			break;
+		}
 	}
-	if (error) {
-		std::stringstream ss;
-		for (GridCell& cell : fluid.getGrid().getIterable("GridCells")) {
-			if (std::abs(cell.Q[UID::VEL+0]) > 1e50 || std::abs(cell.Q[UID::VEL+1]) > 1e50) {
-				ss << '\n' << componentname << " produced an error.\n";
-				cell.printInfo();
-			}
+	ss << '\n';
+	throw std::runtime_error(ss.str());
+}
+
+/**
+ * @brief Logs where this processor and its OpenMP threads run: its node, its rank among the processors on the node,
+ * the instruction set its kernels were dispatched to (see TORCH_KERNEL_CLONES) and the CPUs each thread may use.
+ *
+ * Warns when the processors and threads on a node outnumber its CPUs, or when threads are used with an MPI library
+ * that does not support MPI_THREAD_FUNNELED. Threads that are free to move between CPUs lose their caches (and, across
+ * NUMA domains, their memory) when they move, so unpinned threads are pointed to the binding options.
+ */
+void Torch::reportPlacement() const {
+	MPIW& mpihandler = MPIW::Instance();
+	const int nthreads = Parallel::maxThreads();
+	const std::vector<std::string> cpus = Parallel::threadCPUs();
+
+	std::ostringstream os;
+	os << "Torch::reportPlacement: " << mpihandler.pname() << ", processor " << mpihandler.getRank() << " is "
+			<< mpihandler.nodeRank() << " of " << mpihandler.nodeSize() << " on its node (" << mpihandler.nNodes()
+			<< " nodes), " << CpuDispatch::kernelVariant() << " kernels, " << nthreads << " threads on cpus";
+	bool pinned = true;
+	for (std::size_t i = 0; i < cpus.size(); ++i) {
+		os << ' ' << i << ":" << (cpus[i].empty() ? "?" : cpus[i]);
+		pinned = pinned && !cpus[i].empty() && cpus[i].find_first_of(",-") == std::string::npos;
+	}
+	Logger::Instance().print<SeverityType::NOTICE>(os.str(), '\n');
+
+	if (nthreads > 1 && !mpihandler.threadsFunneled())
+		Logger::Instance().print<SeverityType::WARNING>("Torch::reportPlacement: the MPI library does not support "
+				"MPI_THREAD_FUNNELED, run with OMP_NUM_THREADS=1.\n");
+	const int ncpus = (int)std::thread::hardware_concurrency();
+	if (mpihandler.nodeRank() == 0 && ncpus > 0 && mpihandler.nodeSize()*nthreads > ncpus) {
+		Logger::Instance().print<SeverityType::WARNING>("Torch::reportPlacement: ", mpihandler.nodeSize(),
+				" processors of ", nthreads, " threads oversubscribe the ", ncpus, " cpus of ", mpihandler.pname(), ".\n");
+	}
+	if (mpihandler.getRank() == 0 && nthreads > 1 && !pinned) {
+		Logger::Instance().print<SeverityType::NOTICE>("Torch::reportPlacement: the threads are not pinned, set "
+				"OMP_PROC_BIND=close OMP_PLACES=cores and place a processor per NUMA domain (e.g. mpirun --map-by numa:PE=",
+				nthreads, " --bind-to core).\n");
+	}
+}
+
+/**
+ * @brief The active component allowing the smallest time step at the last step.
+ *
+ * The time steps of the components are already the minima over all processors (see calculateTimeStep).
+ */
+ComponentID Torch::limitingComponent() const {
+	const std::array<double, 3>& dts = m_componentTimeSteps;
+	ComponentID limiter = ComponentID::HYDRO;
+	if (radiation_on && dts[(unsigned int)ComponentID::RAD] < dts[(unsigned int)limiter])
+		limiter = ComponentID::RAD;
+	if (cooling_on && dts[(unsigned int)ComponentID::THERMO] < dts[(unsigned int)limiter])
+		limiter = ComponentID::THERMO;
+	return limiter;
+}
+
+/**
+ * @brief Logs the component, criterion and cell that limited the last time step. Collective, with a single reduction.
+ *
+ * e.g. "Torch::logTimeStepLimiter: step 4000, dt = 3.2e+06 s, limited by rad (k3) in cell (41, 17, 0) of processor 1".
+ * The reduction of calculateTimeStep finds the processor allowing the smallest time step of each component, which
+ * alone knows the criterion and cell that limited it.
+ */
+void Torch::logTimeStepLimiter() {
+	const char* criterionNames[(unsigned int)TimeStepCriterion::N] = {"dt_max", "cfl", "heating", "k1", "k3", "k4", "cooling"};
+	const ComponentID component = limitingComponent();
+	const int owner = m_componentLimitRanks[(unsigned int)component];
+	MPIW& mpihandler = MPIW::Instance();
+
+	// The criterion, whether a cell limited it and the cell's grid coordinates, from the limiting processor.
+	std::vector<double> limit(5, 0);
+	if (mpihandler.getRank() == owner) {
+		const TimeStepLimiter& limiter = getComponent(component).getTimeStepLimiter();
+		limit[0] = (double)limiter.criterion;
+		if (limiter.cellID >= 0) {
+			limit[1] = 1;
+			for (int dim = 0; dim < 3; ++dim)
+				limit[2 + dim] = std::floor(fluid.getGrid().getCell(limiter.cellID).xc[dim]);
+		}
+	}
+	limit = mpihandler.sum(limit);
+
+	std::ostringstream cell;
+	if (limit[1] != 0)
+		cell << " in cell (" << (int)limit[2] << ", " << (int)limit[3] << ", " << (int)limit[4] << ")";
+	Logger::Instance().print<SeverityType::NOTICE>("Torch::logTimeStepLimiter: step ", steps,
+			", dt = ", consts->converter.fromCodeUnits(m_componentTimeSteps[(unsigned int)component], 0, 0, 1),
+			" s, limited by ", componentNames[(unsigned int)component], " (", criterionNames[(int)limit[0]], ")", cell.str(),
+			" of processor ", owner, '\n');
+}
+
+/**
+ * @brief Logs a line of key=value pairs with the throughput of the last nsteps steps, the current time step, the
+ * component limiting it and the peak memory use. Collective, with a single gather and a GridStatistics reduction.
+ *
+ * e.g. "telemetry step=2000 time=1.5e+10 dt=3.2e+06 limiter=rad steps_per_s=41.3 cell_updates_per_s=2.48e+06
+ * hydro_lts_speedup=3.7 rss_mib=212.4 max_rss_mib=215.0". The limiter is the component allowing the smallest time step
+ * over all processors, so a run slowed down by a collapse of the radiation time step shows up as limiter=rad with a
+ * falling dt. hydro_lts_speedup is the factor by which local time stepping on power of two bins of the cells' CFL time
+ * steps would cut the hydrodynamic cell updates of steps of the smallest CFL time step, whatever limits dt (see
+ * Hydrodynamics::localTimeStepUpdates), and shadowed_per_step the
+ * HII fraction updates made in closed form in the shadow of the Star per step (see Radiation::takeShadowedCount).
+ * The ionised mass and highest temperature of the Grid follow, then the time the slowest processor has spent in each
+ * component since the run started.
+ *
+ * The root processor also sends the line as a JSON object to the telemetry_address, if there is one, without waiting
+ * (see TelemetryPublisher).
+ * @param nsteps Number of steps since the last telemetry line.
+ * @param seconds Wall clock time they took (s).
+ */
+void Torch::logTelemetry(long nsteps, double seconds) const {
+	const Grid& grid = fluid.getGrid();
+	GridStatistics stats;
+	const int ionisedMass = stats.add(GridStatistics::Reduction::SUM, [](const GridCell& cell) {
+		return cell.Q[UID::HII]*cell.Q[UID::DEN]*cell.vol;
+	});
+	const int maxTemperature = stats.add(GridStatistics::Reduction::MAX, [&](const GridCell& cell) {
+		return fluid.calcTemperature(cell.Q[UID::HII], cell.Q[UID::PRE], cell.Q[UID::DEN]);
+	});
+	stats.compute(grid);
+	const Profiler::ThreadData& thread = Profiler::threadData();
+	const int N = 7;
+	const double dtHydro = m_componentTimeSteps[(unsigned int)ComponentID::HYDRO];
+	std::vector<double> local = {seconds, peakMemory(), hydrodynamics.localTimeStepUpdates(dtHydro, fluid),
+			(double)radiation.takeShadowedCount(), thread.total[(unsigned int)ProfileID::HYDRO_FLUXES],
+			thread.total[(unsigned int)ProfileID::RADIATION_TRANSFER], thread.total[(unsigned int)ProfileID::THERMO_INTEGRATE]};
+	std::vector<double> all = MPIW::Instance().allGather(local);
+
+	double maxSeconds = 0, maxRSS = 0, ltsUpdates = 0, shadowed = 0;
+	std::array<double, 3> componentSeconds = std::array<double, 3>{{ 0, 0, 0 }};
+	for (std::size_t iproc = 0; iproc < all.size()/N; ++iproc) {
+		maxSeconds = std::max(maxSeconds, all[N*iproc]);
+		maxRSS = std::max(maxRSS, all[N*iproc + 1]);
+		ltsUpdates += all[N*iproc + 2];
+		shadowed += all[N*iproc + 3];
+		for (int ic = 0; ic < 3; ++ic)
+			componentSeconds[ic] = std::max(componentSeconds[ic], all[N*iproc + 4 + ic]);
+	}
+	const ComponentID limiter = limitingComponent();
+
+	double cells = (double)grid.ncells[0]*grid.ncells[1]*grid.ncells[2];
+	double stepsPerSecond = maxSeconds > 0 ? nsteps/maxSeconds : 0;
+	const std::vector<std::pair<std::string, double>> values = {
+		{ "time", consts->converter.fromCodeUnits(grid.currentTime, 0, 0, 1) },
+		{ "dt", consts->converter.fromCodeUnits(grid.deltatime, 0, 0, 1) },
+		{ "steps_per_s", stepsPerSecond },
+		{ "cell_updates_per_s", cells*stepsPerSecond },
+		{ "hydro_lts_speedup", ltsUpdates > 0 ? cells/ltsUpdates : 1 },
+		{ "shadowed_per_step", nsteps > 0 ? shadowed/nsteps : 0 },
+		{ "rss_mib", local[1] },
+		{ "max_rss_mib", maxRSS },
+		{ "ionised_mass_g", consts->converter.fromCodeUnits(stats.get(ionisedMass), 1, 0, 0) },
+		{ "max_temperature_k", stats.get(maxTemperature) },
+		{ "hydro_s", componentSeconds[0] },
+		{ "rad_s", componentSeconds[1] },
+		{ "thermo_s", componentSeconds[2] }
+	};
+
+	// The limiter follows the time step in the log line.
+	std::ostringstream line, packet;
+	line << "telemetry step=" << steps;
+	packet << std::setprecision(10) << "{\"step\": " << steps << ", \"limiter\": \"" << componentNames[(unsigned int)limiter] << '"';
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		line << ' ' << values[i].first << '=' << values[i].second;
+		if (values[i].first == "dt")
+			line << " limiter=" << componentNames[(unsigned int)limiter];
+		packet << ", \"" << values[i].first << "\": " << values[i].second;
+	}
+	packet << "}\n";
+	Logger::Instance().print<SeverityType::NOTICE>(line.str(), '\n');
+	telemetryPublisher.publish(packet.str());
+}
+
+/**
+ * @brief Logs how many blocks of the Grid a block-structured adaptive mesh would refine and the cells it would save
+ * (see RefinementEstimator). Collective.
+ */
+void Torch::estimateRefinement() {
+	refinement.estimate(fluid.getGrid());
+	Logger::Instance().print<SeverityType::NOTICE>("Torch::estimateRefinement: step ", steps, ", ", refinement.getFlaggedCount(),
+			" of ", refinement.getBlockCount(), " blocks of ", refinement.getBlockSize(), " cells need refining, a two level mesh would hold ",
+			refinement.getCellRatio(), " of the cells of the uniformly refined Grid, with a Morton partition imbalance of ",
+			refinement.getMortonImbalance(), ".\n");
+}
+
+/**
+ * @brief Moves the edges of the processors' x slabs if their work has become unbalanced (see LoadBalancer), carrying
+ * the state of every core GridCell over to the processor that now holds it. Collective.
+ *
+ * The cells are moved as the records of a restart file, so the run carries on exactly as it would have done.
+ */
+void Torch::rebalance() {
+	double busy = busySeconds();
+	std::vector<int> xEdges = balancer.partition(fluid.getGrid(), busy - m_busySeconds, fluid.getGrid().spatialOrder + 1);
+	m_busySeconds = busy;
+	if (xEdges.empty())
+		return;
+
+	MPIW& mpihandler = MPIW::Instance();
+	Timer timer;
+	timer.start();
+	const int recordSize = RestartHeader::recordSize;
+	std::vector<double> records;
+	for (const GridCell& cell : fluid.getGrid().getIterable(CellRange::GRID_CELLS)) {
+		records.resize(records.size() + recordSize);
+		RestartHeader::pack(fluid.getGrid(), cell, &records[records.size() - recordSize]);
+	}
+
+	fluid.repartitionGrid(xEdges);
+	fluid.moveStar(fluid.getGrid().currentTime);
+	// Resets the optical depths, which the records restore.
+	radiation.initField(fluid);
+
+	// Only the x slabs change, so every cell moves to the processor in its new slab with the same y and z block.
+	Grid& grid = fluid.getGrid();
+	const int nslabs = (int)xEdges.size() - 1;
+	std::vector<int> slabRanks(nslabs);
+	for (int islab = 0; islab < nslabs; ++islab)
+		slabRanks[islab] = mpihandler.neighbour(0, islab - mpihandler.getCoords()[0]);
+	std::vector<double> received;
+	{
+		std::vector<std::vector<double>> outgoing(mpihandler.nProcessors());
+		for (std::size_t r = 0; r < records.size(); r += recordSize) {
+			const int islab = std::upper_bound(xEdges.begin(), xEdges.end(), RestartHeader::coordinates(&records[r])[0]) - xEdges.begin() - 1;
+			std::vector<double>& block = outgoing[slabRanks[islab]];
+			block.insert(block.end(), records.begin() + r, records.begin() + r + recordSize);
 		}
-		ss << '\n';
-		throw std::runtime_error(ss.str());
+		std::vector<double>().swap(records);
+		received = mpihandler.exchange(outgoing);
+	}
+
+	if ((int)(received.size()/recordSize) != grid.getIterable(CellRange::GRID_CELLS).size())
+		throw std::runtime_error("Torch::rebalance: received " + std::to_string(received.size()/recordSize) + " cells for a block of " + std::to_string(grid.getIterable(CellRange::GRID_CELLS).size()) + ".");
+	for (std::size_t r = 0; r < received.size(); r += recordSize) {
+		const std::array<int, 3> xc = RestartHeader::coordinates(&received[r]);
+		int cellID = grid.locate(xc[0], xc[1], xc[2]);
+		if (cellID == -1)
+			throw std::runtime_error("Torch::rebalance: received a cell outside this processor's block.");
+		RestartHeader::unpack(&received[r], grid, grid.getCell(cellID));
 	}
+	fluid.initialiseHeatCapacityRatios();
+	if (tracerPack)
+		tracers.redistribute(grid);
+	timer.pause();
+
+	Logger::Instance().print<SeverityType::NOTICE>("Torch::rebalance: step ", steps, ", imbalance ", balancer.getImbalance(),
+			" (predicted ", balancer.getPredictedImbalance(), " after), moved the x slabs in ", timer.getTicks(),
+			" s, this processor now has columns ", grid.coreOffset[0], " to ", grid.coreOffset[0] + grid.coreCells[0] - 1, ".\n");
+}
+
+/**
+ * @brief Writes the throughput of the steps taken by this run and the peak memory use of the processors to the
+ * performance file (see scripts/perf), and logs them. Collective.
+ *
+ * A TORCH_COUNT_ALLOCATIONS build also writes the most heap allocations a processor made per step in Torch::fullStep,
+ * the first step aside, which should be 0.
+ * @param nsteps Number of steps taken.
+ * @param seconds Wall clock time they took (s).
+ * @param allocationsPerStep Heap allocations this processor made per step after the first (see Allocations).
+ * @exception std::runtime_error Thrown if the file cannot be opened.
+ */
+void Torch::writePerformance(long nsteps, double seconds, double allocationsPerStep) const {
+	MPIW& mpihandler = MPIW::Instance();
+	double rss = peakMemory();
+	double totalRSS = rss;
+	double maxRSS = mpihandler.maximum(rss);
+	totalRSS = mpihandler.sum(totalRSS);
+	allocationsPerStep = mpihandler.maximum(allocationsPerStep);
+	if (mpihandler.getRank() != 0)
+		return;
+
+	const std::array<int, 3>& ncells = fluid.getGrid().ncells;
+	double cells = (double)ncells[0]*ncells[1]*ncells[2];
+	double updatesPerSecond = seconds > 0 ? cells*nsteps/seconds : 0;
+	std::ofstream out(perfFilename);
+	if (!out)
+		throw std::runtime_error("Torch::writePerformance: unable to open " + perfFilename + ".");
+	out << "{\n";
+	out << "  \"processors\": " << mpihandler.nProcessors() << ",\n";
+	out << "  \"threads\": " << Parallel::maxThreads() << ",\n";
+	out << "  \"cells\": " << (long)cells << ",\n";
+	out << "  \"steps\": " << nsteps << ",\n";
+	out << "  \"seconds\": " << seconds << ",\n";
+	out << "  \"cell_updates_per_second\": " << updatesPerSecond << ",\n";
+	out << "  \"max_rss_mib\": " << maxRSS << ",\n";
+	if (Allocations::isCounted())
+		out << "  \"allocations_per_step\": " << allocationsPerStep << ",\n";
+	out << "  \"total_rss_mib\": " << totalRSS << "\n";
+	out << "}\n";
+	Logger::Instance().print<SeverityType::NOTICE>("Torch::run: ", nsteps, " steps in ", seconds, " s (", updatesPerSecond,
+			" cell updates/s), peak memory ", maxRSS, " MiB per processor.\n");
+	if (Allocations::isCounted())
+		Logger::Instance().print<SeverityType::NOTICE>("Torch::run: ", allocationsPerStep, " heap allocations per step.\n");
 }
 
+/**
+ * @brief Writes a restart file of the state at the end of the last step and tells the WallClockLimit how long it took.
+ * Collective.
+ * @param name Suffix of the restart file's name.
+ * @param checkpoint Checkpoint count the run carries on from.
+ * @param wallClock The WallClockLimit of the run.
+ */
+void Torch::writeRestart(const std::string& name, int checkpoint, WallClockLimit& wallClock) {
+	const double start = m_wallClock.getTicks();
+	if (radiation_on)
+		radiation.traceAveragedColumns(fluid);
+	inputOutput.printRestart(name, fluid.getGrid(), steps, checkpoint, stepCounter, m_previousTimeStep);
+	const double end = m_wallClock.getTicks();
+	wallClock.restartWritten(end, end - start);
+}
 
+/**
+ * @brief Writes the data2D, heating and work snapshots of the current state, with name as the suffix of their files.
+ */
+void Torch::printSnapshots(const std::string& name) {
+	thermodynamics.fillHeatingArrays(fluid);
+	inputOutput.printCheckpoint(name, fluid.getGrid().currentTime, fluid.getGrid());
+	if (fluid.getGrid().countsWork())
+		fluid.getGrid().resetWork();
+}
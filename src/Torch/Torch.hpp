@@ -10,25 +10,50 @@
 #ifndef TORCH_HPP_
 #define TORCH_HPP_
 
+#include <array>
+#include <cstddef>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "Fluid/Fluid.hpp"
+#include "Fluid/LoadBalancer.hpp"
+#include "Fluid/RefinementEstimator.hpp"
+#include "Fluid/TracerParticles.hpp"
+#include "Integrators/Gravity.hpp"
 #include "Integrators/Hydro.hpp"
 #include "Integrators/Radiation.hpp"
 #include "Integrators/Riemann.hpp"
 #include "Integrators/SlopeLimiter.hpp"
 #include "Integrators/Thermodynamics.hpp"
 #include "IO/DataPrinter.hpp"
+#include "IO/FrameContainer.hpp"
+#include "IO/SliceRenderer.hpp"
+#include "IO/TelemetryPublisher.hpp"
+#include "Misc/Timer.hpp"
+#include "Autotuner.hpp"
 #include "Parameters.hpp"
 
 //#include "Star.hpp"
 
 class Constants;
+class SetupProvider;
+class WallClockLimit;
 
 enum class ComponentID : unsigned int {HYDRO, RAD, THERMO};
 
+/**
+ * @brief One variable of a processor's core cells, in place in the GridCells.
+ */
+struct CellFieldView {
+	double* data = nullptr; //!< The variable of the first cell.
+	std::ptrdiff_t stride = 0; //!< Bytes from one cell's variable to the next's.
+	int size = 0; //!< Number of cells.
+
+	double& operator[](int i) const { return *reinterpret_cast<double*>(reinterpret_cast<char*>(data) + i*stride); }
+};
+
 /**
  * @class Torch
  *
@@ -40,19 +65,41 @@ class Torch {
 public:
 	void initialise(TorchParameters tparams);
 	void run();
+	void benchmarkCommunication(int repetitions);
+	void benchmarkIO(int snapshots);
 
 	void setRiemannSolver(std::unique_ptr<RiemannSolver> riemannSolver);
 	void setSlopeLimiter(std::unique_ptr<SlopeLimiter> slopeLimiter);
 
 	bool isQuitting();
 	TorchParameters getRemapParameters();
+
+	// Coupling to a program Torch is embedded in (see TorchAPI.h).
+	void advance(double dt);
+	double getTime() const;
+	CellFieldView getField(UID::ID id);
+	void fieldsChanged();
+	Fluid& getFluid();
+	const Fluid& getFluid() const;
+	void getStarRates(double& photonRate, double& massLossRate) const;
+	void setStarRates(double photonRate, double massLossRate);
+	std::array<int, 3> getStarPosition() const;
+	void setStarPosition(const std::array<int, 3>& position);
 private:
 	std::shared_ptr<Constants> consts = nullptr;
 	DataPrinter inputOutput; //!< Module for input/output.
+	SliceRenderer renderer; //!< Renders the frames of a movie every few steps.
+	TelemetryPublisher telemetryPublisher; //!< Sends the telemetry of the root processor to a monitor, if it is open.
 	Fluid fluid;
 	Hydrodynamics hydrodynamics;
 	Radiation radiation;
 	Thermodynamics thermodynamics;
+	Gravity gravity; //!< Self-gravity of the gas.
+	LoadBalancer balancer; //!< Chooses the x slabs of the Grid each processor simulates.
+	RefinementEstimator refinement; //!< Estimates the saving of an adaptive mesh over the Grid.
+	TracerParticles tracers; //!< Passive particles that follow the gas.
+	Autotuner autotuner; //!< Chooses the fastest threads, tile size and kernel variants over the first steps of the run.
+	std::unique_ptr<FrameContainer> tracerPack; //!< Container the samples of the tracer particles are appended to, if they are on.
 
 	TorchParameters remapParameters;
 	std::string initialConditions = "";
@@ -60,8 +107,18 @@ private:
 	bool radiation_on = false;
 	bool cooling_on = false;
 	bool debug = false;
+	bool fusedUpdates = true; //!< Use the fused Fluid::advanceAndFix/predictPrimitives passes instead of separate sweeps.
+	bool overlapCooling = true; //!< Cool the ray tiles during the radiation sweep of a radiation sub-step followed by a cooling one.
+	int radSubcycles = 0; //!< Most radiation and cooling sub-steps taken within a hydrodynamic step (0 or 1 for one each, see multiRateStep).
+	int equilibriumIterations = 0; //!< Most iterations of the photoionisation equilibrium a new run starts from (see Radiation::solveEquilibrium).
+	double equilibriumTolerance = 0; //!< Change in HII fraction below which the equilibrium iterations stop.
 	unsigned int spatialOrder = 0;
-	unsigned int temporalOrder = 0;
+	unsigned int temporalOrder = 2; //!< 1 for a single forward Euler hydrodynamic step, 2 for a predictor-corrector one.
+	int sspStages = 0; //!< Stages of the SSP Runge-Kutta hydrodynamic (sub-)steps, 2 or 3 (0 for those of temporalOrder, see rungeKuttaStep).
+	int fallbackSubsteps = 2; //!< First order sub-steps retaking a hydrodynamic step that left invalid cells (0 for none, see guardHydroStep).
+	bool m_isGuarded = false; //!< Whether a hydrodynamic step is being taken within guardHydroStep.
+	long m_fallbackSteps = 0; //!< Hydrodynamic steps retaken at first order.
+	long m_fallbackCells = 0; //!< Invalid cells over all the processors that the retaken steps had.
 	double tmax = 0;
 	double dt_max = 0;
 	double dfloor = 0;
@@ -72,18 +129,78 @@ private:
 	int stepCounter = 0;
 	int m_customPrintID = 0;
 	int ncheckpoints = 0;
+	int restartEvery = 0; //!< Write a restart file every restartEvery checkpoints (0 for never).
+	int snapshotEvery = 1; //!< Write the data2D and heating snapshots every snapshotEvery checkpoints (and at the end).
+	std::array<double, 3> outputTriggers = std::array<double, 3>{{ 0, 0, 0 }}; //!< Changes of the ionised mass, front radius and largest density that trigger an output (see OutputTrigger).
+	double triggerMinInterval = 0; //!< Least simulation time between outputs triggered by change.
+	int steadyEvery = 0; //!< Number of steps between the checks for a steady state (0 for none, see SteadyStateMonitor).
+	double steadyTolerance = 0; //!< Relative rate of change below which a check is quiet.
+	int steadyChecks = 3; //!< Number of quiet checks in a row that stop the run.
+	double dtGrowth = 2; //!< Largest factor the time step may grow by from one step to the next.
+	double m_previousTimeStep = 0; //!< Time step allowed at the last calculateTimeStep, before the checkpoints cut it short (0 for none yet).
+	int telemetryEvery = 0; //!< Number of steps between the telemetry lines in the log (0 for none).
+	int rebalanceEvery = 0; //!< Number of steps between the checks of the load balance (0 for none).
+	int refinementEvery = 0; //!< Number of steps between the estimates of the saving of an adaptive mesh (0 for none).
+	int tracersPerCell = 0; //!< Tracer particles seeded in every cell (0 for none).
+	int tracerEvery = 10; //!< Number of steps between the samples of the tracer particles.
+	int gravityEvery = 0; //!< Number of steps between the self-gravity solves (0 for none).
+	double m_busySeconds = 0; //!< Time this processor had spent computing at the last load balance check (s).
+	int maxSteps = 0; //!< Number of steps after which the run stops (0 for no limit).
+	double wallTime = 0; //!< Wall clock time the run may take (s, 0 for no limit), see WallClockLimit.
+	double restartInterval = 0; //!< Wall clock time between restart files (s, 0 for none).
+	Timer m_wallClock; //!< Wall clock time since Torch::initialise started.
+	bool m_isRestarted = false; //!< Whether the run carries on from a restart file.
+	bool m_isStopping = false; //!< Whether the run writes a restart file and stops after this step, agreed by all processors.
+	bool m_isRestartDue = false; //!< Whether a restart file is written after this step, agreed by all processors.
+	int traceSteps = 0; //!< Number of steps at the start of the run recorded in the Chrome trace (0 for none).
+	std::string profileFilename; //!< File the Profiler appends its timings to at every checkpoint.
+	std::string traceFilename; //!< File the Chrome trace of the first traceSteps steps is written to.
+	std::string perfFilename; //!< File the throughput and memory use of the run are written to.
+	std::string tracerFilename; //!< File the samples of the tracer particles are appended to.
+	std::string commBenchFilename; //!< File the timings of benchmarkCommunication are written to.
+	std::string ioBenchFilename; //!< File the timings of benchmarkIO are written to.
+	std::string ioBenchDirectory; //!< Directory the snapshots of benchmarkIO are written under.
+	std::string snapshotVariables; //!< Variables of the binary and HDF5 snapshots, for benchmarkIO.
+	int compressionLevel = 6; //!< zlib level of the gzipped text output, for benchmarkIO.
 
+	std::array<double, 3> m_componentTimeSteps = std::array<double, 3>{{ 0, 0, 0 }}; //!< Last time step of each component (by ComponentID), the minimum over all processors.
+	std::array<int, 3> m_componentLimitRanks = std::array<int, 3>{{ 0, 0, 0 }}; //!< Rank of the processor allowing the last time step of each component.
+	std::array<double, 2> m_partnerTimeSteps = std::array<double, 2>{{ 0, 0 }}; //!< Radiation and cooling time steps found by the radiation processor at the end of the last step (see serveRadiation).
 	bool m_isQuitting = false;
+	bool m_isStarted = false; //!< Whether the components have been prepared for the first step (see startComponents).
 
 	void toCodeUnits();
 	void setUp(std::string filename);
-	void setUpLua(std::string filename);
+	void setUpLua(const std::string& filename, const std::string& script);
+	void setUpBlocks(const SetupProvider& setup);
+	std::string setupKey(const TorchParameters& p) const;
+	void startComponents();
 	double calculateTimeStep();
 	Integrator& getComponent(ComponentID id);
 	void hydroStep(double dt, bool hasCalculatedHeatFlux);
+	void guardHydroStep(double dt, bool hasCalculatedHeatFlux, const std::function<void(double, bool)>& step);
+	void rungeKuttaStep(double dt, bool hasCalculatedHeatFlux);
 	void subStep(double dt, bool hasCalculatedHeatFlux, Integrator& comp);
+	bool canOverlapCooling() const;
+	void radiationCoolingSubSteps(double dtRadiation, bool hasCalculatedHeatFlux, double dtCooling);
 	double fullStep(double dt_nextCheckPoint);
-	void checkValues(std::string componentname);
+	double pipelinedStep(double dt_nextCheckPoint);
+	void serveRadiation();
+	std::vector<double> radiationResult();
+	void mergeRadiationResult();
+	bool isMultiRate() const;
+	double fastTimeStep();
+	void multiRateStep(double dt);
+	void checkValues(const std::string& componentname, CheckLevel level, const char* stage = "");
+	void logTelemetry(long nsteps, double seconds) const;
+	ComponentID limitingComponent() const;
+	void logTimeStepLimiter();
+	void reportPlacement() const;
+	void rebalance();
+	void estimateRefinement();
+	void writePerformance(long nsteps, double seconds, double allocationsPerStep) const;
+	void writeRestart(const std::string& name, int checkpoint, WallClockLimit& wallClock);
+	void printSnapshots(const std::string& name);
 };
 
 #endif // TORCH_HPP_
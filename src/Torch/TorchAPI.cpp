@@ -0,0 +1,110 @@
+#include "TorchAPI.h"
+
+#include "ParameterFile.hpp"
+#include "Torch.hpp"
+#include "IO/Logger.hpp"
+#include "MPI/MPI_Wrapper.hpp"
+
+#include <exception>
+#include <memory>
+#include <string>
+
+struct TorchInstance {
+	Torch torch;
+};
+
+namespace {
+
+static_assert(sizeof(GridCell)%sizeof(double) == 0, "torch_field: the stride of a view must be a whole number of doubles.");
+
+/**
+ * @brief Runs a call of the interface, logging an exception instead of letting it through to C.
+ * @return 0, or -1 if the call threw.
+ */
+template <class Call>
+int guard(const char* name, Call call) {
+	try {
+		call();
+		return 0;
+	}
+	catch (std::exception& e) {
+		Logger::Instance().print<SeverityType::ERROR>(name, ": ", e.what(), '\n');
+		return -1;
+	}
+}
+
+}
+
+TorchInstance* torch_create(const char* paramfile, const char* setupfile) {
+	std::unique_ptr<TorchInstance> instance(new TorchInstance());
+	const int status = guard("torch_create", [&]() {
+		MPIW& mpihandler = MPIW::Instance();
+		TorchParameters tpars;
+		const std::string paramText = mpihandler.broadcastFile(paramfile, 0);
+		tpars.setupScript = mpihandler.broadcastFile(setupfile, 0);
+		tpars.outputDirectory = parseOutputDirectory(paramText, paramfile, -1);
+		openOutputDirectory(tpars.outputDirectory, paramfile, setupfile, parseLogFiles(paramText, paramfile, -1),
+				!parseRestartFile(paramText, paramfile, -1).empty());
+		parseParameters(paramText, paramfile, -1, tpars);
+		tpars.setupFile = setupfile;
+		instance->torch.initialise(tpars);
+	});
+	return status == 0 ? instance.release() : nullptr;
+}
+
+void torch_destroy(TorchInstance* torch) {
+	delete torch;
+	Logger::Instance().collect(true);
+	MPIW::Instance().freePersistent();
+}
+
+int torch_advance(TorchInstance* torch, double dt) {
+	return guard("torch_advance", [&]() { torch->torch.advance(dt); });
+}
+
+double torch_time(const TorchInstance* torch) {
+	return torch->torch.getTime();
+}
+
+void torch_block(const TorchInstance* torch, int offset[3], int cells[3]) {
+	const Grid& grid = torch->torch.getFluid().getGrid();
+	for (int i = 0; i < 3; ++i) {
+		offset[i] = grid.coreOffset[i];
+		cells[i] = grid.coreCells[i];
+	}
+}
+
+double* torch_field(TorchInstance* torch, int variable, long* stride, int* size) {
+	if (variable < 0 || variable >= UID::N) {
+		Logger::Instance().print<SeverityType::ERROR>("torch_field: variable(=", variable, ") is not a variable of this build.\n");
+		return nullptr;
+	}
+	const CellFieldView view = torch->torch.getField((UID::ID)variable);
+	*stride = view.stride/(long)sizeof(double);
+	*size = view.size;
+	return view.data;
+}
+
+void torch_fields_changed(TorchInstance* torch) {
+	torch->torch.fieldsChanged();
+}
+
+void torch_get_star_rates(const TorchInstance* torch, double* photon_rate, double* mass_loss_rate) {
+	torch->torch.getStarRates(*photon_rate, *mass_loss_rate);
+}
+
+int torch_set_star_rates(TorchInstance* torch, double photon_rate, double mass_loss_rate) {
+	return guard("torch_set_star_rates", [&]() { torch->torch.setStarRates(photon_rate, mass_loss_rate); });
+}
+
+void torch_get_star_position(const TorchInstance* torch, int position[3]) {
+	const std::array<int, 3> cell = torch->torch.getStarPosition();
+	for (int i = 0; i < 3; ++i)
+		position[i] = cell[i];
+}
+
+int torch_set_star_position(TorchInstance* torch, const int position[3]) {
+	return guard("torch_set_star_position", [&]() {
+		torch->torch.setStarPosition(std::array<int, 3>{{ position[0], position[1], position[2] }});
+	});
+}
@@ -0,0 +1,59 @@
+/** Provides the C interface for embedding Torch in another program, e.g. an N-body or stellar evolution code.
+ *
+ * @file TorchAPI.h
+ *
+ * @author Harrison Steggles
+ */
+
+#ifndef TORCHAPI_H_
+#define TORCHAPI_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief A simulation set up from a parameter file, which the calling program marches on and exchanges state with in
+ * the same process. Every function is collective over the processors unless it says otherwise.
+ *
+ * Torch initialises MPI if the calling program has not, and otherwise leaves it to the calling program to finalise.
+ * The functions returning int return 0 on success and -1 on failure, whose reason is written to the log.
+ */
+typedef struct TorchInstance TorchInstance;
+
+/** Primitive variables of a cell, the variable argument of torch_field. */
+enum TorchVariable { TORCH_DEN, TORCH_PRE, TORCH_HII, TORCH_ADV, TORCH_VEL_X, TORCH_VEL_Y, TORCH_VEL_Z };
+
+/** Sets up the simulation of a parameter and setup file as torch --paramfile --setupfile would (NULL on failure). */
+TorchInstance* torch_create(const char* paramfile, const char* setupfile);
+/** Frees a simulation. */
+void torch_destroy(TorchInstance* torch);
+
+/** Marches the solution on by dt seconds, writing no output. */
+int torch_advance(TorchInstance* torch, double dt);
+/** Simulation time (s). Not collective. */
+double torch_time(const TorchInstance* torch);
+
+/** Grid coordinates of this processor's first core cell and its number of core cells along each dimension. Not collective. */
+void torch_block(const TorchInstance* torch, int offset[3], int cells[3]);
+/**
+ * Pointer to a variable of this processor's first core cell, in code units, with the variable of the i-th at
+ * [i*stride] and size cells in all, in the order of their IDs. Not collective. The pointer lasts until the grid is
+ * rebalanced (rebalance_every), and after writing through it call torch_fields_changed before torch_advance.
+ */
+double* torch_field(TorchInstance* torch, int variable, long* stride, int* size);
+/** Brings the conserved variables up to date with variables written through torch_field. Not collective. */
+void torch_fields_changed(TorchInstance* torch);
+
+/** Ionising photon rate (s-1) and wind mass loss rate (g s-1) of the star. Not collective. */
+void torch_get_star_rates(const TorchInstance* torch, double* photon_rate, double* mass_loss_rate);
+int torch_set_star_rates(TorchInstance* torch, double photon_rate, double mass_loss_rate);
+/** Grid coordinates of the cell the star is in. Not collective. */
+void torch_get_star_position(const TorchInstance* torch, int position[3]);
+int torch_set_star_position(TorchInstance* torch, const int position[3]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TORCHAPI_H_
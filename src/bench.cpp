@@ -0,0 +1,327 @@
+/**
+ * @file bench.cpp
+ *
+ * Micro-benchmarks of the kernels of the integrators on synthetic states. Writes the results as JSON, see BenchmarkSuite.
+ */
+
+#include "Fluid/GridCell.hpp"
+#include "Integrators/Radiation.hpp"
+#include "Integrators/Riemann.hpp"
+#include "Integrators/SlopeLimiter.hpp"
+#include "Integrators/SplineData.hpp"
+#include "Integrators/Thermodynamics.hpp"
+#include "Misc/Benchmark.hpp"
+#include "Torch/Constants.hpp"
+#include "Torch/Parameters.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int NSTATES = 4096; //!< Number of states, cells or slopes each kernel is timed over.
+const int ND = TORCH_MAX_DIMENSIONS;
+const double GAMMA = 1.67;
+
+/**
+ * @brief Synthetic primitive states in code units, with their sound speeds squared.
+ */
+struct States {
+	std::vector<FluidArray> Q;
+	std::vector<double> a2;
+	std::vector<double> gamma;
+
+	States(std::mt19937& rng) : Q(NSTATES), a2(NSTATES), gamma(NSTATES, GAMMA) {
+		std::uniform_real_distribution<double> logUniform(-1, 1), unit(0, 1), velocity(-1, 1);
+		for (int i = 0; i < NSTATES; ++i) {
+			Q[i][UID::DEN] = std::pow(10.0, logUniform(rng));
+			Q[i][UID::PRE] = std::pow(10.0, logUniform(rng));
+			Q[i][UID::HII] = unit(rng);
+			Q[i][UID::ADV] = unit(rng);
+			for (int dim = 0; dim < ND; ++dim)
+				Q[i][UID::VEL+dim] = velocity(rng);
+			a2[i] = GAMMA*Q[i][UID::PRE]/Q[i][UID::DEN];
+		}
+	}
+};
+
+void showUsage() {
+	std::cout << "torch_bench [--filter=<substring>] [--min_time=<seconds>] [--repetitions=<n>] [--out=<file.json>]\n";
+	std::cout << "Times the kernels whose names contain the filter and writes the results to the JSON file (bench.json by default).\n";
+}
+
+}
+
+/**
+ * @class KernelBenchmarks
+ *
+ * @brief Adds the benchmarks of the kernels, including the private kernels of Radiation and Thermodynamics.
+ */
+class KernelBenchmarks {
+public:
+	static void addRiemannSolvers(BenchmarkSuite& suite, const States& left, const States& right);
+	static void addSlopeLimiters(BenchmarkSuite& suite, std::mt19937& rng);
+	static void addConversions(BenchmarkSuite& suite, const States& states);
+	static void addSplines(BenchmarkSuite& suite, std::mt19937& rng);
+	static void addRadiation(BenchmarkSuite& suite, std::shared_ptr<const Radiation> radiation, std::mt19937& rng);
+	static void addThermodynamics(BenchmarkSuite& suite, std::shared_ptr<const Thermodynamics> thermo, const Constants& consts,
+			std::mt19937& rng);
+};
+
+void KernelBenchmarks::addRiemannSolvers(BenchmarkSuite& suite, const States& left, const States& right) {
+	for (const std::string name : {"HLL", "HLLC", "RotatedHLLC", "AdaptiveHLLC"}) {
+		std::shared_ptr<RiemannSolver> solver(RiemannSolverFactory::create(name, ND).release());
+		solver->setCheckFluxes(false);
+		std::shared_ptr<std::vector<FluidArray>> F = std::make_shared<std::vector<FluidArray>>(NSTATES);
+		suite.add("RiemannSolver::solve/" + name, NSTATES, [=, &left, &right]() {
+			for (int i = 0; i < NSTATES; ++i)
+				solver->solve((*F)[i], left.Q[i], right.Q[i], left.a2[i], right.a2[i], GAMMA, i%ND);
+			doNotOptimise((*F)[NSTATES - 1]);
+		});
+		suite.add("RiemannSolver::solveBatch/" + name, NSTATES, [=, &left, &right]() {
+			solver->solveBatch(NSTATES, F->data(), left.Q.data(), right.Q.data(), left.a2.data(), right.a2.data(),
+					left.gamma.data(), 0);
+			doNotOptimise((*F)[NSTATES - 1]);
+		});
+	}
+}
+
+void KernelBenchmarks::addSlopeLimiters(BenchmarkSuite& suite, std::mt19937& rng) {
+	std::shared_ptr<std::vector<double>> dl = std::make_shared<std::vector<double>>(NSTATES);
+	std::shared_ptr<std::vector<double>> dr = std::make_shared<std::vector<double>>(NSTATES);
+	std::shared_ptr<std::vector<double>> slope = std::make_shared<std::vector<double>>(NSTATES);
+	std::normal_distribution<double> difference(0, 1);
+	for (int i = 0; i < NSTATES; ++i) {
+		(*dl)[i] = difference(rng);
+		(*dr)[i] = difference(rng);
+	}
+	for (const std::string name : {"monotonised_central", "superbee", "minmod", "maxmod", "leer", "ospre", "albada"}) {
+		std::shared_ptr<SlopeLimiter> limiter(SlopeLimiterFactory::create(name).release());
+		suite.add("SlopeLimiter::calculate/" + name, NSTATES, [=]() {
+			for (int i = 0; i < NSTATES; ++i)
+				(*slope)[i] = limiter->calculate((*dl)[i], (*dr)[i]);
+			doNotOptimise((*slope)[NSTATES - 1]);
+		});
+		suite.add("SlopeLimiter::limit/" + name, NSTATES, [=]() {
+			limiter->limit(dl->data(), dr->data(), slope->data(), NSTATES);
+			doNotOptimise((*slope)[NSTATES - 1]);
+		});
+	}
+}
+
+void KernelBenchmarks::addConversions(BenchmarkSuite& suite, const States& states) {
+	std::shared_ptr<std::vector<FluidArray>> U = std::make_shared<std::vector<FluidArray>>(NSTATES);
+	std::shared_ptr<std::vector<FluidArray>> out = std::make_shared<std::vector<FluidArray>>(NSTATES);
+	for (int i = 0; i < NSTATES; ++i)
+		UfromQ((*U)[i], states.Q[i], GAMMA, ND);
+	suite.add("UfromQ", NSTATES, [=, &states]() {
+		for (int i = 0; i < NSTATES; ++i)
+			UfromQ((*out)[i], states.Q[i], GAMMA, ND);
+		doNotOptimise((*out)[NSTATES - 1]);
+	});
+	suite.add("QfromU", NSTATES, [=]() {
+		for (int i = 0; i < NSTATES; ++i)
+			QfromU((*out)[i], (*U)[i], GAMMA, ND);
+		doNotOptimise((*out)[NSTATES - 1]);
+	});
+	suite.add("FfromQ", NSTATES, [=, &states]() {
+		for (int i = 0; i < NSTATES; ++i)
+			FfromQ((*out)[i], states.Q[i], GAMMA, ND, i%ND);
+		doNotOptimise((*out)[NSTATES - 1]);
+	});
+}
+
+void KernelBenchmarks::addSplines(BenchmarkSuite& suite, std::mt19937& rng) {
+	// A rate falling as a power of the temperature, tabulated like the Hummer (1994) rates.
+	const int npoints = 26;
+	std::vector<std::pair<double, double>> linearData, logData;
+	for (int k = 0; k < npoints; ++k) {
+		double T = std::pow(10.0, 2 + 4.0*k/(npoints - 1));
+		double rate = 1.0e-20*std::pow(T/1.0e4, -0.7)*std::exp(-T/1.0e6);
+		linearData.push_back(std::make_pair(T, rate));
+		logData.push_back(std::make_pair(std::log10(T), std::log10(rate)));
+	}
+	std::shared_ptr<LinearSplineData> linear = std::make_shared<LinearSplineData>(linearData);
+	std::shared_ptr<LogSplineData> logarithmic = std::make_shared<LogSplineData>(logData);
+	std::shared_ptr<UniformLogTable> table = std::make_shared<UniformLogTable>(
+			[linear](double T) { return linear->interpolate(T); }, 1.0e2, 1.0e6, 2048);
+
+	std::shared_ptr<std::vector<double>> T = std::make_shared<std::vector<double>>(NSTATES);
+	std::shared_ptr<std::vector<double>> logT = std::make_shared<std::vector<double>>(NSTATES);
+	std::shared_ptr<std::vector<double>> out = std::make_shared<std::vector<double>>(NSTATES);
+	std::uniform_real_distribution<double> logUniform(2, 6);
+	for (int i = 0; i < NSTATES; ++i) {
+		(*logT)[i] = logUniform(rng);
+		(*T)[i] = std::pow(10.0, (*logT)[i]);
+	}
+	suite.add("SplineData::interpolate/linear", NSTATES, [=]() {
+		for (int i = 0; i < NSTATES; ++i)
+			(*out)[i] = linear->interpolate((*T)[i]);
+		doNotOptimise((*out)[NSTATES - 1]);
+	});
+	suite.add("SplineData::interpolate/log", NSTATES, [=]() {
+		for (int i = 0; i < NSTATES; ++i)
+			(*out)[i] = logarithmic->interpolate((*logT)[i]);
+		doNotOptimise((*out)[NSTATES - 1]);
+	});
+	suite.add("UniformLogTable::interpolate", NSTATES, [=]() {
+		table->interpolate(T->data(), out->data(), NSTATES);
+		doNotOptimise((*out)[NSTATES - 1]);
+	});
+}
+
+void KernelBenchmarks::addRadiation(BenchmarkSuite& suite, std::shared_ptr<const Radiation> radiation, std::mt19937& rng) {
+	// Rates in units of 1/dt spanning the optically thin, equilibrium and frozen regimes of doric.
+	std::shared_ptr<std::vector<double>> Api = std::make_shared<std::vector<double>>(NSTATES);
+	std::shared_ptr<std::vector<double>> nH_aB = std::make_shared<std::vector<double>>(NSTATES);
+	std::shared_ptr<std::vector<double>> nH_Aci = std::make_shared<std::vector<double>>(NSTATES);
+	std::shared_ptr<std::vector<double>> HII0 = std::make_shared<std::vector<double>>(NSTATES);
+	std::shared_ptr<std::vector<double>> HII = std::make_shared<std::vector<double>>(NSTATES);
+	std::uniform_real_distribution<double> logUniform(-10, 3), unit(0, 1);
+	for (int i = 0; i < NSTATES; ++i) {
+		(*Api)[i] = std::pow(10.0, logUniform(rng));
+		(*nH_aB)[i] = std::pow(10.0, logUniform(rng));
+		(*nH_Aci)[i] = 1.0e-3*(*nH_aB)[i];
+		(*HII0)[i] = unit(rng);
+	}
+	suite.add("Radiation::doric", NSTATES, [=]() {
+		const double dt = 1.0;
+		for (int i = 0; i < NSTATES; ++i) {
+			double HII_avg = 0, HII_new = (*HII0)[i];
+			radiation->doric(dt, HII_avg, HII_new, (*Api)[i], (*nH_aB)[i], (*nH_Aci)[i]);
+			(*HII)[i] = HII_new + HII_avg;
+		}
+		doNotOptimise((*HII)[NSTATES - 1]);
+	});
+	std::shared_ptr<std::vector<double>> HII_avg = std::make_shared<std::vector<double>>(NSTATES);
+	suite.add("Radiation::doricBatch", NSTATES, [=]() {
+		const double dt = 1.0;
+		*HII = *HII0;
+		radiation->doricBatch(NSTATES, dt, Api->data(), nH_aB->data(), nH_Aci->data(), HII_avg->data(), HII->data());
+		doNotOptimise((*HII)[NSTATES - 1] + (*HII_avg)[NSTATES - 1]);
+	});
+}
+
+void KernelBenchmarks::addThermodynamics(BenchmarkSuite& suite, std::shared_ptr<const Thermodynamics> thermo,
+		const Constants& consts, std::mt19937& rng) {
+	std::shared_ptr<std::vector<double>> nH = std::make_shared<std::vector<double>>(NSTATES);
+	std::shared_ptr<std::vector<double>> HIIFRAC = std::make_shared<std::vector<double>>(NSTATES);
+	std::shared_ptr<std::vector<double>> T = std::make_shared<std::vector<double>>(NSTATES);
+	std::shared_ptr<std::vector<double>> rates = std::make_shared<std::vector<double>>(NSTATES);
+	std::uniform_real_distribution<double> logDensity(0, 5), logTemperature(2, 5), unit(0, 1);
+	for (int i = 0; i < NSTATES; ++i) {
+		(*nH)[i] = consts.converter.toCodeUnits(std::pow(10.0, logDensity(rng)), 0, -3, 0);
+		(*HIIFRAC)[i] = unit(rng);
+		(*T)[i] = std::pow(10.0, logTemperature(rng));
+	}
+
+	suite.add("Thermodynamics::coolingRate", NSTATES, [=]() {
+		for (int i = 0; i < NSTATES; ++i)
+			(*rates)[i] = thermo->coolingRate((*nH)[i], (*HIIFRAC)[i], (*T)[i]);
+		doNotOptimise((*rates)[NSTATES - 1]);
+	});
+	suite.add("Thermodynamics::coolingRates", NSTATES, [=]() {
+		thermo->coolingRates(NSTATES, nH->data(), HIIFRAC->data(), T->data(), rates->data());
+		doNotOptimise((*rates)[NSTATES - 1]);
+	});
+	suite.add("Thermodynamics::ionisedMetalLineCooling", NSTATES, [=]() {
+		for (int i = 0; i < NSTATES; ++i)
+			(*rates)[i] = thermo->ionisedMetalLineCooling((*nH)[i]*(*HIIFRAC)[i], (*T)[i]);
+		doNotOptimise((*rates)[NSTATES - 1]);
+	});
+	suite.add("Thermodynamics::neutralMetalLineCooling", NSTATES, [=]() {
+		for (int i = 0; i < NSTATES; ++i)
+			(*rates)[i] = thermo->neutralMetalLineCooling((*nH)[i]*(*HIIFRAC)[i], (*nH)[i]*(1 - (*HIIFRAC)[i]), (*T)[i]);
+		doNotOptimise((*rates)[NSTATES - 1]);
+	});
+	suite.add("Thermodynamics::collisionalExcitationHI", NSTATES, [=]() {
+		for (int i = 0; i < NSTATES; ++i)
+			(*rates)[i] = thermo->collisionalExcitationHI((*nH)[i], (*HIIFRAC)[i], (*T)[i]);
+		doNotOptimise((*rates)[NSTATES - 1]);
+	});
+	suite.add("Thermodynamics::recombinationHII", NSTATES, [=]() {
+		for (int i = 0; i < NSTATES; ++i)
+			(*rates)[i] = thermo->recombinationHII((*nH)[i], (*HIIFRAC)[i], (*T)[i]);
+		doNotOptimise((*rates)[NSTATES - 1]);
+	});
+	suite.add("Thermodynamics::collisionalIonisationEquilibriumCooling", NSTATES, [=]() {
+		for (int i = 0; i < NSTATES; ++i)
+			(*rates)[i] = thermo->collisionalIonisationEquilibriumCooling((*nH)[i]*(*HIIFRAC)[i], (*T)[i]);
+		doNotOptimise((*rates)[NSTATES - 1]);
+	});
+	suite.add("Thermodynamics::neutralMolecularLineCooling", NSTATES, [=]() {
+		for (int i = 0; i < NSTATES; ++i)
+			(*rates)[i] = thermo->neutralMolecularLineCooling((*nH)[i], (*HIIFRAC)[i], (*T)[i]);
+		doNotOptimise((*rates)[NSTATES - 1]);
+	});
+}
+
+int main(int argc, char** argv) {
+	std::string filter = "";
+	std::string outFile = "bench.json";
+	double minTime = 0.1;
+	int repetitions = 3;
+	for (int iarg = 1; iarg < argc; ++iarg) {
+		std::string arg = argv[iarg];
+		std::size_t eq = arg.find('=');
+		std::string key = arg.substr(0, eq), value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+		if (key.compare("--filter") == 0)
+			filter = value;
+		else if (key.compare("--min_time") == 0)
+			minTime = std::stod(value);
+		else if (key.compare("--repetitions") == 0)
+			repetitions = std::stoi(value);
+		else if (key.compare("--out") == 0)
+			outFile = value;
+		else {
+			showUsage();
+			return key.compare("--help") == 0 ? 0 : 1;
+		}
+	}
+
+	try {
+		// The code units and rate tables of config/torch-config.lua.
+		TorchParameters p;
+		p.dscale = 1.0e-20;
+		p.pscale = 1.0e-28;
+		p.tscale = 1.0e11;
+		p.alphaB = 2.59e-13;
+		p.photoIonCrossSection = 6.3e-18;
+		p.massFractionH = 1.0;
+		p.thermoHII_Switch = 1.0e-2;
+		std::shared_ptr<Constants> consts = std::make_shared<Constants>();
+		consts->initialise_DPT(p.dscale, p.pscale, p.tscale);
+		p.initialise(consts);
+		std::shared_ptr<Radiation> radiation = std::make_shared<Radiation>();
+		radiation->initialise(consts, p.getRadiationParameters());
+		std::shared_ptr<Thermodynamics> thermo = std::make_shared<Thermodynamics>();
+		thermo->initialise(consts, p.getThermoParameters());
+
+		std::mt19937 rng(20141124);
+		States left(rng), right(rng);
+		BenchmarkSuite suite(minTime, repetitions);
+		KernelBenchmarks::addRiemannSolvers(suite, left, right);
+		KernelBenchmarks::addSlopeLimiters(suite, rng);
+		KernelBenchmarks::addConversions(suite, left);
+		KernelBenchmarks::addSplines(suite, rng);
+		KernelBenchmarks::addRadiation(suite, radiation, rng);
+		KernelBenchmarks::addThermodynamics(suite, thermo, *consts, rng);
+
+		suite.run(filter, std::cout);
+		std::ofstream out(outFile);
+		if (!out)
+			throw std::runtime_error("torch_bench: unable to open " + outFile + ".");
+		suite.writeJSON(out);
+	}
+	catch (std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
@@ -3,22 +3,22 @@
  */
 
 #include "Torch/Torch.hpp"
+#include "Torch/ParameterFile.hpp"
 #include "MPI/MPI_Wrapper.hpp"
+#include "IO/AsyncWriter.hpp"
 #include "IO/DataPrinter.hpp"
 #include "IO/Logger.hpp"
-#include "IO/ParseLua.hpp"
-#include "IO/FileManagement.hpp"
-
-#include "selene/include/selene.h"
+#include "Misc/Parallel.hpp"
 
 #include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <memory>
 
-std::string parseOutputDirectory(const std::string& paramfilename);
-void parseParameters(const std::string& filename, TorchParameters& p);
+void runMember(const std::string& paramFile, const std::string& paramText, const std::string& setupFile,
+		const std::string& setupText, int member, int commBench, int ioBench);
 void showUsage();
 
 int main (int argc, char** argv) {
@@ -27,9 +27,11 @@ int main (int argc, char** argv) {
 	bool silent = mpihandler.getRank() != 0;
 	std::string paramFile = "config/torch-config.lua";
 	std::string setupFile = "config/torch-setup.lua";
+	int commBench = 0;
+	int ioBench = 0;
 
 	// Parse parameters
-	if (argc > 4) {
+	if (argc > 6) {
 		showUsage();
 		return 0;
 	}
@@ -39,6 +41,8 @@ int main (int argc, char** argv) {
 			std::string prefix1("--paramfile=");
 			std::string prefix2("--setupfile=");
 			std::string prefix3("-s");
+			std::string prefix4("--comm-bench=");
+			std::string prefix5("--io-bench=");
 
 			if (!arg.compare(0, prefix1.size(), prefix1))
 				paramFile = arg.substr(prefix1.size()).c_str();
@@ -46,6 +50,10 @@ int main (int argc, char** argv) {
 				setupFile = arg.substr(prefix2.size()).c_str();
 			else if (!arg.compare(0, prefix3.size(), prefix3))
 				silent = true;
+			else if (!arg.compare(0, prefix4.size(), prefix4))
+				commBench = std::atoi(arg.substr(prefix4.size()).c_str());
+			else if (!arg.compare(0, prefix5.size(), prefix5))
+				ioBench = std::atoi(arg.substr(prefix5.size()).c_str());
 			else {
 				showUsage();
 				return 0;
@@ -53,160 +61,120 @@ int main (int argc, char** argv) {
 		}
 	}
 
-	std::unique_ptr<LogPolicyInterface> consoleLogPolicy 
-		= std::unique_ptr<ConsoleLogPolicy>(new ConsoleLogPolicy());
+	std::unique_ptr<LogPolicyInterface> consoleLogPolicy
+		= std::unique_ptr<AsyncLogPolicy>(new AsyncLogPolicy(std::unique_ptr<ConsoleLogPolicy>(new ConsoleLogPolicy())));
 	consoleLogPolicy->setLogLevel(silent ? SeverityType::ERROR : SeverityType::DEBUG);
 	Logger::Instance().registerLogPolicy("console", std::move(consoleLogPolicy));
 
-	TorchParameters tpars;
+	// The root processor reads the scripts and sends them to the rest, which parse them from memory.
+	std::string paramText, setupText;
+	int nmembers = 0, ngroups = 1, nthreads = 0, ioClients = 0;
 
 	try {
-		mpihandler.serial([&] () {
-			tpars.outputDirectory = parseOutputDirectory(paramFile);
-		});
-
-		if (mpihandler.getRank() == 0) {
-			FileManagement::makeDirectoryPath(tpars.outputDirectory);
-			FileManagement::deleteFileContents(tpars.outputDirectory);
-			FileManagement::makeDirectoryPath(tpars.outputDirectory + "/log");
-			FileManagement::deleteFileContents(tpars.outputDirectory + "/log");
-			FileManagement::copyConfigFile(setupFile, tpars.outputDirectory);
-			FileManagement::copyConfigFile(paramFile, tpars.outputDirectory);
+		paramText = mpihandler.broadcastFile(paramFile, 0);
+		setupText = mpihandler.broadcastFile(setupFile, 0);
+		nmembers = parseEnsemble(paramText, paramFile, ngroups, nthreads);
+		ioClients = parseIOClients(paramText, paramFile);
+		if (ioClients != 0 && nmembers > 0)
+			throw std::runtime_error("ParseParameters: io_clients cannot be used with an Ensemble table.\n");
+		// Every other processor traces the radiation for the one before it (see Torch::pipelinedStep).
+		if (parseRadiationProcessors(paramText, paramFile)) {
+			if (ioClients != 0 || nmembers > 0 || commBench != 0 || ioBench != 0)
+				throw std::runtime_error("ParseParameters: radiation_processors cannot be used with io_clients, an Ensemble table, --comm-bench or --io-bench.\n");
+			mpihandler.splitRadiation();
+		}
+		// The I/O processors write the output of the others until the run is over.
+		if (ioClients != 0)
+			mpihandler.splitIO(ioClients);
+		if (mpihandler.isIOServer()) {
+			AsyncWriter::serve();
+			return 0;
 		}
-
-		mpihandler.barrier();
-
-		std::unique_ptr<LogPolicyInterface> fileLogPolicy 
-			= std::unique_ptr<FileLogPolicy>(
-				  new FileLogPolicy(tpars.outputDirectory + "/log/torch.log" + std::to_string(mpihandler.getRank()))
-			  );
-		fileLogPolicy->setLogLevel(SeverityType::NOTICE);
-		Logger::Instance().registerLogPolicy("file", std::move(fileLogPolicy));
 	}
 	catch (std::exception& e) {
 		Logger::Instance().print<SeverityType::FATAL_ERROR>(e.what());
 		mpihandler.abort();
 	}
 
-	try {
-		mpihandler.serial([&] () {
-			parseParameters( paramFile, tpars);
-			tpars.setupFile = setupFile;
-		});
-
-		Torch torch;
-		torch.initialise(tpars);
-		torch.run();
+	if (nmembers == 0) {
+		runMember(paramFile, paramText, setupFile, setupText, -1, commBench, ioBench);
+		if (mpihandler.hasIOServer())
+			AsyncWriter::stopServer();
 	}
-	catch (std::exception& e) {
-		Logger::Instance().print<SeverityType::FATAL_ERROR>(e.what());
-		std::cout << "See " << tpars.outputDirectory << "/log/torch.log* for more details." << std::endl;
-		MPIW::Instance().abort();
+	else {
+		// Each group of processors runs ensemble members off a shared queue until none are left.
+		try {
+			mpihandler.splitGroups(ngroups);
+		}
+		catch (std::exception& e) {
+			Logger::Instance().print<SeverityType::FATAL_ERROR>(e.what());
+			mpihandler.abort();
+		}
+		// Members of small problems run best as many small groups, each with a core of its own.
+		if (nthreads > 0)
+			Parallel::setThreads(nthreads);
+		for (int member = mpihandler.nextTask(); member < nmembers; member = mpihandler.nextTask()) {
+			Logger::Instance().print<SeverityType::NOTICE>("Ensemble member ", member + 1, " of ", nmembers, " runs on group ",
+					mpihandler.groupIndex(), " of ", mpihandler.nGroups(), ".\n");
+			runMember(paramFile, paramText, setupFile, setupText, member, commBench, ioBench);
+		}
 	}
 
 	return 0;
 }
 
-std::string parseOutputDirectory(const std::string& paramfilename) {
-	std::string fullfilename = paramfilename;
-	std::string outputDir = "";
-	// Create new Lua state and load the lua libraries
-	sel::State luaState{true};
+/**
+ * @brief Sets up and runs one simulation on this processor's group.
+ * @param member Index of the ensemble member to run, or -1 to run the parameter file as it is.
+ * @param commBench Number of times to replay the communication of a step instead of running (0 to run, see
+ * Torch::benchmarkCommunication).
+ * @param ioBench Number of snapshots to write and read back in each output format instead of running (0 to run, see
+ * Torch::benchmarkIO).
+ */
+void runMember(const std::string& paramFile, const std::string& paramText, const std::string& setupFile,
+		const std::string& setupText, int member, int commBench, int ioBench) {
+	MPIW& mpihandler = MPIW::Instance();
+	TorchParameters tpars;
+	tpars.setupScript = setupText;
 
-	if (!luaState.Load(fullfilename)) {
-		throw std::runtime_error("ParseParameters: could not open lua file: " + fullfilename + "\n");
+	try {
+		tpars.outputDirectory = parseOutputDirectory(paramText, paramFile, member);
+		// The radiation processors write nothing, their partners write the output.
+		if (!mpihandler.isRadiationServer())
+			openOutputDirectory(tpars.outputDirectory, paramFile, setupFile, parseLogFiles(paramText, paramFile, member),
+					!parseRestartFile(paramText, paramFile, member).empty());
 	}
-	else {
-		parseLuaVariable(luaState["Parameters"]["Integration"]["output_directory"], outputDir);
+	catch (std::exception& e) {
+		Logger::Instance().print<SeverityType::FATAL_ERROR>(e.what());
+		mpihandler.abort();
 	}
 
-	return outputDir;
-}
-
-void parseParameters(const std::string& filename, TorchParameters& p) {
-	std::string fullfilename = filename;
-	// Create new Lua state and load the lua libraries
-	sel::State luaState{true};
-
-	if (!luaState.Load(fullfilename)) {
-		throw std::runtime_error("ParseParameters: could not open lua file: " + fullfilename + "\n");
+	try {
+		parseParameters(paramText, paramFile, member, tpars);
+		tpars.setupFile = setupFile;
+
+		{
+			Torch torch;
+			torch.initialise(tpars);
+			if (commBench != 0)
+				torch.benchmarkCommunication(commBench);
+			else if (ioBench != 0)
+				torch.benchmarkIO(ioBench);
+			else
+				torch.run();
+		}
+		Logger::Instance().collect(true);
+		mpihandler.freePersistent();
 	}
-	else {
-		parseLuaVariable(luaState["Parameters"]["Integration"]["density_scale"], p.dscale);
-		parseLuaVariable(luaState["Parameters"]["Integration"]["pressure_scale"], p.pscale);
-		parseLuaVariable(luaState["Parameters"]["Integration"]["time_scale"], p.tscale);
-		parseLuaVariable(luaState["Parameters"]["Integration"]["spatial_order"], p.spatialOrder);
-		parseLuaVariable(luaState["Parameters"]["Integration"]["temporal_order"], p.temporalOrder);
-		parseLuaVariable(luaState["Parameters"]["Integration"]["simulation_time"], p.tmax);
-		parseLuaVariable(luaState["Parameters"]["Integration"]["radiation_on"], p.radiation_on);
-		parseLuaVariable(luaState["Parameters"]["Integration"]["cooling_on"], p.cooling_on);
-		parseLuaVariable(luaState["Parameters"]["Integration"]["debug"], p.debug);
-		parseLuaVariable(luaState["Parameters"]["Integration"]["initial_conditions"], p.initialConditions);
-		parseLuaVariable(luaState["Parameters"]["Integration"]["ncheckpoints"], p.ncheckpoints);
-
-		parseLuaVariable(luaState["Parameters"]["Grid"]["no_dimensions"], p.nd);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["no_cells_x"], p.ncells[0]);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["no_cells_y"], p.ncells[1]);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["no_cells_z"], p.ncells[2]);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["side_length"], p.sideLength);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["geometry"], p.geometry);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["left_boundary_condition_x"], p.leftBC[0]);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["left_boundary_condition_y"], p.leftBC[1]);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["left_boundary_condition_z"], p.leftBC[2]);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["right_boundary_condition_x"], p.rightBC[0]);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["right_boundary_condition_y"], p.rightBC[1]);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["right_boundary_condition_z"], p.rightBC[2]);
-
-		parseLuaVariable(luaState["Parameters"]["Grid"]["Patch"]["filename"], p.patchfilename);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["Patch"]["offset_x"], p.patchoffset[0]);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["Patch"]["offset_y"], p.patchoffset[1]);
-		parseLuaVariable(luaState["Parameters"]["Grid"]["Patch"]["offset_z"], p.patchoffset[2]);
-
-		parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["gamma"], p.heatCapacityRatio);
-		parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["density_floor"], p.dfloor);
-		parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["pressure_floor"], p.pfloor);
-		parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["temperature_floor"], p.tfloor);
-		parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["riemann_solver"], p.riemannSolver);
-		parseLuaVariable(luaState["Parameters"]["Hydrodynamics"]["slope_limiter"], p.slopeLimiter);
-
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["K1"], p.K1);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["K2"], p.K2);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["K3"], p.K3);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["K4"], p.K4);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["photoion_cross_section"], p.photoIonCrossSection);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["case_b_recombination_coeff"], p.alphaB);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["tau_0"], p.tau0);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["minimum_hii_fraction"], p.minX);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["temperature_hi"], p.THI);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["temperature_hii"], p.THII);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["mass_fraction_hydrogen"], p.massFractionH);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["collisions_on"], p.collisions_on);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["coupling"], p.rt_coupling);
-		parseLuaVariable(luaState["Parameters"]["Radiation"]["integration_scheme"], p.rt_scheme);
-
-		parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["thermo_hii_switch"], p.thermoHII_Switch);
-		parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["heating_amplification"], p.heatingAmplification);
-		parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["thermo_subcycling"], p.thermoSubcycling);
-		parseLuaVariable(luaState["Parameters"]["Thermodynamics"]["min_temp_initial_state"], p.minTempInitialState);
-
-		parseLuaVariable(luaState["Parameters"]["Star"]["on"], p.star_on);
-		parseLuaVariable(luaState["Parameters"]["Star"]["cell_position_x"], p.star_position[0]);
-		parseLuaVariable(luaState["Parameters"]["Star"]["cell_position_y"], p.star_position[1]);
-		parseLuaVariable(luaState["Parameters"]["Star"]["cell_position_z"], p.star_position[2]);
-		parseLuaVariable(luaState["Parameters"]["Star"]["snap_to_face_left_x"], p.faceSnap[0]);
-		parseLuaVariable(luaState["Parameters"]["Star"]["snap_to_face_left_y"], p.faceSnap[1]);
-		parseLuaVariable(luaState["Parameters"]["Star"]["snap_to_face_left_z"], p.faceSnap[2]);
-		parseLuaVariable(luaState["Parameters"]["Star"]["photon_energy"], p.photonEnergy);
-		parseLuaVariable(luaState["Parameters"]["Star"]["photon_rate"], p.photonRate);
-		parseLuaVariable(luaState["Parameters"]["Star"]["wind_radius_in_cells"], p.windCellRadius);
-		parseLuaVariable(luaState["Parameters"]["Star"]["mass_loss_rate"], p.massLossRate);
-		parseLuaVariable(luaState["Parameters"]["Star"]["wind_velocity"], p.windVelocity);
-		parseLuaVariable(luaState["Parameters"]["Star"]["wind_temperature"], p.windTemperature);
-
-		Logger::Instance().print<SeverityType::NOTICE>("Star is on: ", p.star_on, '\n');
+	catch (std::exception& e) {
+		Logger::Instance().print<SeverityType::FATAL_ERROR>(e.what());
+		std::cout << "See " << tpars.outputDirectory << "/log/torch.log* for more details." << std::endl;
+		MPIW::Instance().abort();
 	}
 }
 
 void showUsage() {
-	std::cout << "torch [--paramfile=<filename>] [--setupfile=<filename>]" << std::endl;
+	std::cout << "torch [--paramfile=<filename>] [--setupfile=<filename>] [-s] [--comm-bench=<n>] [--io-bench=<n>]" << std::endl;
+	std::cout << "--comm-bench=<n> sets up the run, then replays the communication of a step n times without the physics." << std::endl;
+	std::cout << "--io-bench=<n> sets up the run, then writes and reads back n synthetic snapshots in each output format." << std::endl;
 }